@@ -0,0 +1,52 @@
+#ifndef SCHEDULE_H
+/*
+ * File: schedule.h
+ * Description: Report schedule on the RTC. A node starts out reporting every
+ *              period with +-50% jitter, so that a fleet powered up together
+ *              spreads out, until the gateway assigns it a TDMA slot in an ACK
+ *              payload (CONTROL_TYPE_SLOT, see gateway/inc/proto/control.h).
+ *              The slot message carries the delay from the frame it answers to
+ *              the node's slot; from then on the node reports exactly every
+ *              period, and a later slot message re-times it when its crystal
+ *              has drifted.
+ *
+ *              Times are RTC ms as returned by RTC_GetMs.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t period_ms;
+    uint32_t next_ms;  // Next report
+    uint32_t frame_ms; // Start of the attempt that delivered the last frame
+    uint32_t rng;
+    uint16_t slot;
+    bool slotted;
+} Schedule_t;
+
+void Schedule_Init(Schedule_t *sched, uint32_t period_ms, uint32_t seed, uint32_t now_ms);
+
+// Report due at next_ms is going out: moves next_ms on by a period
+void Schedule_Advance(Schedule_t *sched);
+
+// Frame acknowledged; tx_ms is when the acknowledged attempt started (first
+// attempt plus ARC_CNT retry rounds)
+void Schedule_FrameSent(Schedule_t *sched, uint32_t tx_ms);
+
+// ACK payload from the gateway. 0 if it was a slot message and was applied.
+int Schedule_HandleControl(Schedule_t *sched, const uint8_t *payload, uint8_t len, uint32_t now_ms);
+
+// Until the next report, for RTC_SetWakeup; 0 if due
+uint32_t Schedule_MsUntilNext(const Schedule_t *sched, uint32_t now_ms);
+
+#endif // SCHEDULE_H
@@ -0,0 +1,71 @@
+#ifndef TIMESYNC_H
+/*
+ * File: timesync.h
+ * Description: Clock discipline for the node's LSE-based RTC. The node asks
+ *              for the gateway's time by setting FRAME_FLAG_TIME_REQ in a
+ *              report; the ACK payload (CONTROL_TYPE_TIME, see
+ *              gateway/inc/proto/control.h) carries the gateway time at which
+ *              that frame arrived, which the node pairs with its own RTC
+ *              reading for the same moment.
+ *
+ *              The first sample, or one too far off to slew, steps the RTC.
+ *              After that the RTC is never stepped: each sample gives the
+ *              offset and, against the previous one, the rate the RTC gained
+ *              at the calibration in force, so the crystal's own error is
+ *              estimated and filtered. CALR is set to cancel it plus a slew
+ *              that takes out half the offset over the next interval. The
+ *              interval between samples doubles while the offset stays small,
+ *              up to a sample every 17 minutes, and drops back when it does
+ *              not.
+ *
+ *              Integer arithmetic only, no 64-bit division, and no hardware
+ *              access, so the estimator also runs on the host; the caller
+ *              applies the action with RTC_SetTime and RTC_SetCalibration.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define TIMESYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    bool synced;
+    uint8_t samples;      // Since the last step
+    int32_t cal_steps;    // CALR in force
+    int32_t freq_ppb;     // Crystal error estimate, positive when the RTC runs fast
+    int32_t last_offset;  // ms, gateway minus RTC
+    uint32_t last_local;  // RTC ms of the last sample
+    uint32_t interval_s;  // Until the next sample is wanted
+} TimeSync_t;
+
+typedef struct {
+    uint32_t seconds;     // Gateway time when the frame arrived
+    uint16_t ms;
+    uint32_t local_ms;    // RTC at the same moment: start of the acknowledged attempt plus airtime
+} TimeSample_t;
+
+typedef struct {
+    bool step;            // RTC_SetTime(seconds, ms, RTC_GetMs() - local_ms)
+    bool calibrate;       // RTC_SetCalibration(cal_steps)
+    int32_t cal_steps;
+    int32_t offset_ms;    // Measured, gateway minus RTC
+} TimeSyncAction_t;
+
+void TimeSync_Init(TimeSync_t *ts);
+
+// Whether the next report should set FRAME_FLAG_TIME_REQ
+bool TimeSync_Wanted(const TimeSync_t *ts, uint32_t now_ms);
+
+// ACK payload; 0 with the sample if it is a time message
+int TimeSync_Parse(const uint8_t *payload, uint8_t len, uint32_t local_ms, TimeSample_t *sample);
+
+void TimeSync_Update(TimeSync_t *ts, const TimeSample_t *sample, TimeSyncAction_t *action);
+
+#endif // TIMESYNC_H
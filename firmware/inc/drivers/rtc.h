@@ -0,0 +1,62 @@
+#ifndef RTC_H
+/*
+ * File: rtc.h
+ * Description: RTC on the 32.768 kHz LSE for STM32L4 series. Calendar time is
+ *              read with sub-second resolution (PREDIV_S = 4095, ~0.24 ms) and
+ *              the wake-up timer runs from RTCCLK/16 (~0.49 ms) to wake the
+ *              node from Stop mode for its next report.
+ *
+ *              For the clock discipline the RTC can be set to a time, shifted
+ *              by under a second without losing its phase, and smoothly
+ *              calibrated: CALR adds or masks LSE pulses over each 32 s
+ *              cycle, 0.954 ppm per step, between -487 and +488 ppm.
+ *
+ *              Times are in ms as uint32_t, wrapping every 49.7 days; compare
+ *              them with RTC_Before or by signed difference.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Shift and smooth calibration.
+ *
+ */
+#define RTC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stm32l4xx.h" // Hardware definitions
+
+#define RTC_WAKEUP_MAX_MS 31999 // 16-bit counter at 2048 Hz
+#define RTC_CAL_STEP_PPB 954     // One CALR step, 1e9 / 2^20
+#define RTC_CAL_MIN (-511)
+#define RTC_CAL_MAX 512
+
+// Starts the LSE and the RTC; keeps the calendar if the RTC is already running
+void RTC_Init(void);
+
+// Unix time in ms, modulo 2^32
+uint32_t RTC_GetMs(void);
+uint32_t RTC_GetUnix(void);
+void RTC_SetUnix(uint32_t seconds);
+
+// Set to seconds.ms, as the time was elapsed_ms ago by the RTC
+void RTC_SetTime(uint32_t seconds, uint32_t ms, uint32_t elapsed_ms);
+// Advance (ms > 0) or retard by under a second
+void RTC_Shift(int32_t ms);
+// CALR steps of RTC_CAL_STEP_PPB, positive speeds the RTC up
+void RTC_SetCalibration(int32_t steps);
+
+// Wake-up interrupt in ms, at most RTC_WAKEUP_MAX_MS; returns the delay armed
+uint32_t RTC_SetWakeup(uint32_t ms);
+bool RTC_WakeupPending(void);
+void RTC_ClearWakeup(void);
+
+static inline bool RTC_Before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+#endif // RTC_H
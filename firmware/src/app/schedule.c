@@ -0,0 +1,68 @@
+#include "app/schedule.h"
+
+#include "drivers/rtc.h"
+
+#define CONTROL_TYPE_SLOT 1
+#define CONTROL_SLOT_LEN 12
+#define SLOT_MIN_LEAD_MS 50 // Closer than this and the slot is taken a period later
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t next_rand(Schedule_t *sched) {
+    uint32_t x = sched->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sched->rng = x;
+    return x;
+}
+
+// A period, +-50% until the node has a slot
+static uint32_t interval(Schedule_t *sched) {
+    if (sched->slotted) {
+        return sched->period_ms;
+    }
+    return sched->period_ms / 2 + next_rand(sched) % (sched->period_ms + 1);
+}
+
+void Schedule_Init(Schedule_t *sched, uint32_t period_ms, uint32_t seed, uint32_t now_ms) {
+    sched->period_ms = period_ms;
+    sched->rng = seed ? seed : 0x9E3779B9;
+    sched->slotted = false;
+    sched->slot = 0;
+    sched->frame_ms = now_ms;
+    // First report anywhere in the first period
+    sched->next_ms = now_ms + next_rand(sched) % period_ms;
+}
+
+void Schedule_Advance(Schedule_t *sched) {
+    sched->next_ms += interval(sched);
+}
+
+void Schedule_FrameSent(Schedule_t *sched, uint32_t tx_ms) {
+    sched->frame_ms = tx_ms;
+}
+
+int Schedule_HandleControl(Schedule_t *sched, const uint8_t *payload, uint8_t len, uint32_t now_ms) {
+    if (len < CONTROL_SLOT_LEN || payload[0] != CONTROL_TYPE_SLOT) {
+        return -1;
+    }
+    uint32_t period = get_u32(payload + 4), delay = get_u32(payload + 8);
+    if (period == 0) {
+        return -1;
+    }
+    sched->slot = (uint16_t)(payload[2] | (payload[3] << 8));
+    sched->period_ms = period;
+    sched->slotted = true;
+    sched->next_ms = sched->frame_ms + delay;
+    while (RTC_Before(sched->next_ms, now_ms + SLOT_MIN_LEAD_MS)) {
+        sched->next_ms += period;
+    }
+    return 0;
+}
+
+uint32_t Schedule_MsUntilNext(const Schedule_t *sched, uint32_t now_ms) {
+    return RTC_Before(now_ms, sched->next_ms) ? sched->next_ms - now_ms : 0;
+}
@@ -0,0 +1,102 @@
+#include "app/timesync.h"
+
+#define CONTROL_TYPE_TIME 2
+#define CONTROL_TIME_LEN 8
+
+#define STEP_MS 500          // Offsets beyond this are stepped, not slewed
+#define SETTLED_MS 4         // Within this the sample interval may grow
+#define INTERVAL_MIN_S 64
+#define INTERVAL_MAX_S 1024 // Temperature moves the crystal by up to ~3 ppm an hour
+#define GAIN_MAX_SHIFT 1     // Frequency filter settles at 1/2 per sample; slower lags more than it smooths
+#define CAL_STEP_PPB_X1000 953674 // CALR step, see drivers/rtc.h
+#define CAL_MIN (-511)
+#define CAL_MAX 512
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int32_t cal_to_ppb(int32_t steps) {
+    return steps * CAL_STEP_PPB_X1000 / 1000;
+}
+
+static int32_t ppb_to_cal(int32_t ppb) {
+    int32_t limit = cal_to_ppb(CAL_MAX);
+
+    ppb = ppb > limit ? limit : ppb < -limit ? -limit : ppb;
+    int32_t steps = (ppb * 1000 + (ppb >= 0 ? CAL_STEP_PPB_X1000 / 2 : -CAL_STEP_PPB_X1000 / 2)) / CAL_STEP_PPB_X1000;
+    return steps < CAL_MIN ? CAL_MIN : steps > CAL_MAX ? CAL_MAX : steps;
+}
+
+void TimeSync_Init(TimeSync_t *ts) {
+    ts->synced = false;
+    ts->samples = 0;
+    ts->cal_steps = 0;
+    ts->freq_ppb = 0;
+    ts->last_offset = 0;
+    ts->last_local = 0;
+    ts->interval_s = INTERVAL_MIN_S;
+}
+
+bool TimeSync_Wanted(const TimeSync_t *ts, uint32_t now_ms) {
+    return !ts->synced || now_ms - ts->last_local >= ts->interval_s * 1000;
+}
+
+int TimeSync_Parse(const uint8_t *payload, uint8_t len, uint32_t local_ms, TimeSample_t *sample) {
+    if (len < CONTROL_TIME_LEN || payload[0] != CONTROL_TYPE_TIME) {
+        return -1;
+    }
+    sample->seconds = get_u32(payload + 2);
+    sample->ms = (uint16_t)(payload[6] | (payload[7] << 8));
+    sample->local_ms = local_ms;
+    return sample->ms < 1000 ? 0 : -1;
+}
+
+void TimeSync_Update(TimeSync_t *ts, const TimeSample_t *sample, TimeSyncAction_t *action) {
+    uint32_t gateway_ms = sample->seconds * 1000u + sample->ms;
+    int32_t offset = (int32_t)(gateway_ms - sample->local_ms);
+
+    action->step = false;
+    action->calibrate = false;
+    action->cal_steps = ts->cal_steps;
+    action->offset_ms = offset;
+    if (!ts->synced || offset > STEP_MS || offset < -STEP_MS) {
+        // The RTC reads gateway time from here; the calibration and frequency estimate stay
+        action->step = true;
+        ts->synced = true;
+        ts->samples = 0;
+        ts->last_offset = 0;
+        ts->last_local = gateway_ms;
+        ts->interval_s = INTERVAL_MIN_S;
+        return;
+    }
+    uint32_t dt_s = (sample->local_ms - ts->last_local) / 1000;
+    if (dt_s < INTERVAL_MIN_S / 2) {
+        return; // Too close to the last sample to tell a rate from read noise
+    }
+
+    // Rate the RTC gained at the calibration in force, less the calibration: the crystal alone
+    int32_t rate = (ts->last_offset - offset) * 1000000 / (int32_t)dt_s;
+    int32_t crystal = rate - cal_to_ppb(ts->cal_steps);
+    uint8_t shift = ts->samples < GAIN_MAX_SHIFT ? ts->samples : GAIN_MAX_SHIFT;
+    ts->freq_ppb += (crystal - ts->freq_ppb) / (1 << shift);
+    ts->samples += ts->samples < UINT8_MAX;
+
+    int32_t magnitude = offset < 0 ? -offset : offset;
+    if (magnitude <= SETTLED_MS && ts->samples > GAIN_MAX_SHIFT) {
+        ts->interval_s = ts->interval_s * 2 < INTERVAL_MAX_S ? ts->interval_s * 2 : INTERVAL_MAX_S;
+    } else if (magnitude > 4 * SETTLED_MS) {
+        ts->interval_s = INTERVAL_MIN_S;
+    }
+
+    // Cancel the crystal error and take out half the offset over the next interval
+    int32_t slew = offset * 1000000 / (int32_t)(2 * ts->interval_s);
+    int32_t steps = ppb_to_cal(slew - ts->freq_ppb);
+    ts->last_offset = offset;
+    ts->last_local = sample->local_ms;
+    if (steps != ts->cal_steps) {
+        ts->cal_steps = steps;
+        action->calibrate = true;
+        action->cal_steps = steps;
+    }
+}
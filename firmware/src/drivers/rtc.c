@@ -0,0 +1,171 @@
+#include "drivers/rtc.h"
+
+#define PREDIV_A 7 // CALP needs PREDIV_A >= 3
+#define PREDIV_S 4095
+#define WUT_HZ 2048
+
+static volatile bool wakeup_pending;
+
+static void rtc_unlock(void) {
+    RTC->WPR = 0xCA;
+    RTC->WPR = 0x53;
+}
+
+static void rtc_lock(void) {
+    RTC->WPR = 0xFF;
+}
+
+static uint32_t bcd2(uint32_t v) {
+    return ((v >> 4) & 0xF) * 10 + (v & 0xF);
+}
+
+static uint32_t to_bcd2(uint32_t v) {
+    return ((v / 10) << 4) | (v % 10);
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static uint32_t days_from_civil(uint32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;
+    uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void RTC_Init(void) {
+    RCC->APB1ENR1 |= RCC_APB1ENR1_PWREN;
+    PWR->CR1 |= PWR_CR1_DBP; // Backup domain write access
+
+    if (!(RCC->BDCR & RCC_BDCR_RTCEN)) {
+        RCC->BDCR |= RCC_BDCR_LSEON;
+        while (!(RCC->BDCR & RCC_BDCR_LSERDY));
+        RCC->BDCR = (RCC->BDCR & ~RCC_BDCR_RTCSEL) | RCC_BDCR_RTCSEL_0; // LSE
+        RCC->BDCR |= RCC_BDCR_RTCEN;
+
+        rtc_unlock();
+        RTC->ISR |= RTC_ISR_INIT;
+        while (!(RTC->ISR & RTC_ISR_INITF));
+        RTC->PRER = (PREDIV_A << RTC_PRER_PREDIV_A_Pos) | PREDIV_S;
+        RTC->ISR &= ~RTC_ISR_INIT;
+        rtc_lock();
+    }
+
+    EXTI->IMR1 |= EXTI_IMR1_IM20; // Wake-up timer is EXTI line 20
+    EXTI->RTSR1 |= EXTI_RTSR1_RT20;
+    NVIC_EnableIRQ(RTC_WKUP_IRQn);
+}
+
+// Unix seconds and ms within the second from one consistent read
+static uint32_t read_time(uint32_t *ms) {
+    // Shadow registers are stale until resynchronised after Stop mode; RSF is write-protected
+    rtc_unlock();
+    RTC->ISR &= ~RTC_ISR_RSF;
+    rtc_lock();
+    while (!(RTC->ISR & RTC_ISR_RSF));
+
+    // Reading SSR locks TR and DR until DR is read
+    uint32_t ss = RTC->SSR;
+    uint32_t tr = RTC->TR;
+    uint32_t dr = RTC->DR;
+
+    // SS counts down from PREDIV_S, and past it for a moment after a shift
+    *ms = ss <= PREDIV_S ? (PREDIV_S - ss) * 1000u / (PREDIV_S + 1) : 0;
+    uint32_t days = days_from_civil(2000 + bcd2(dr & 0xFF), bcd2((dr >> 8) & 0x1F), bcd2((dr >> 16) & 0x3F));
+    return days * 86400 + bcd2((tr >> 16) & 0x3F) * 3600 + bcd2((tr >> 8) & 0x7F) * 60 + bcd2(tr & 0x7F);
+}
+
+uint32_t RTC_GetMs(void) {
+    uint32_t ms, secs = read_time(&ms);
+    return secs * 1000u + ms;
+}
+
+uint32_t RTC_GetUnix(void) {
+    uint32_t ms;
+    return read_time(&ms);
+}
+
+void RTC_SetUnix(uint32_t seconds) {
+    uint32_t days = seconds / 86400, rem = seconds % 86400;
+
+    // civil_from_days
+    uint32_t z = days + 719468, era = z / 146097, doe = z - era * 146097;
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100), mp = (5 * doy + 2) / 153;
+    uint32_t d = doy - (153 * mp + 2) / 5 + 1, m = mp < 10 ? mp + 3 : mp - 9;
+    uint32_t y = yoe + era * 400 + (m <= 2);
+
+    rtc_unlock();
+    RTC->ISR |= RTC_ISR_INIT;
+    while (!(RTC->ISR & RTC_ISR_INITF));
+    RTC->TR = (to_bcd2(rem / 3600) << 16) | (to_bcd2(rem / 60 % 60) << 8) | to_bcd2(rem % 60);
+    RTC->DR = (to_bcd2(y - 2000) << 0) | (to_bcd2(m) << 8) | (to_bcd2(d) << 16) | (1 << RTC_DR_WDU_Pos);
+    RTC->ISR &= ~RTC_ISR_INIT;
+    rtc_lock();
+}
+
+void RTC_SetTime(uint32_t seconds, uint32_t ms, uint32_t elapsed_ms) {
+    ms += elapsed_ms;
+    // Setting the calendar restarts the second, the shift puts the ms back
+    RTC_SetUnix(seconds + ms / 1000);
+    if (ms % 1000) {
+        RTC_Shift((int32_t)(ms % 1000));
+    }
+}
+
+void RTC_Shift(int32_t ms) {
+    uint32_t shift;
+
+    if (ms > 0) {
+        // Add a second, take back the rest
+        shift = RTC_SHIFTR_ADD1S | ((uint32_t)(1000 - ms) * (PREDIV_S + 1) / 1000);
+    } else {
+        shift = (uint32_t)(-ms) * (PREDIV_S + 1) / 1000;
+    }
+    while (RTC->ISR & RTC_ISR_SHPF);
+    rtc_unlock();
+    RTC->SHIFTR = shift;
+    rtc_lock();
+}
+
+void RTC_SetCalibration(int32_t steps) {
+    steps = steps < RTC_CAL_MIN ? RTC_CAL_MIN : steps > RTC_CAL_MAX ? RTC_CAL_MAX : steps;
+    // Rate change is 512 * CALP - CALM pulses per 2^20
+    uint32_t calp = steps > 0, calm = calp * 512 - (uint32_t)steps;
+
+    while (RTC->ISR & RTC_ISR_RECALPF);
+    rtc_unlock();
+    RTC->CALR = (calp ? RTC_CALR_CALP : 0) | (calm << RTC_CALR_CALM_Pos);
+    rtc_lock();
+}
+
+uint32_t RTC_SetWakeup(uint32_t ms) {
+    ms = ms > RTC_WAKEUP_MAX_MS ? RTC_WAKEUP_MAX_MS : ms;
+    uint32_t ticks = ms * WUT_HZ / 1000;
+    ticks = ticks ? ticks : 1;
+
+    rtc_unlock();
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    while (!(RTC->ISR & RTC_ISR_WUTWF));
+    RTC->WUTR = ticks - 1;
+    RTC->CR &= ~RTC_CR_WUCKSEL; // RTCCLK / 16
+    RTC->ISR &= ~RTC_ISR_WUTF;
+    RTC->CR |= RTC_CR_WUTIE | RTC_CR_WUTE;
+    rtc_lock();
+    wakeup_pending = false;
+    return ticks * 1000 / WUT_HZ;
+}
+
+bool RTC_WakeupPending(void) {
+    return wakeup_pending;
+}
+
+void RTC_ClearWakeup(void) {
+    wakeup_pending = false;
+}
+
+void RTC_WKUP_IRQHandler(void) {
+    RTC->ISR &= ~RTC_ISR_WUTF;
+    EXTI->PR1 = EXTI_PR1_PIF20;
+    wakeup_pending = true;
+}
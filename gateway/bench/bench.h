@@ -0,0 +1,72 @@
+#ifndef BENCH_H
+/*
+ * File: bench.h
+ * Description: Timing and reporting helpers shared by the gateway benchmarks.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static inline uint64_t Bench_NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*: deterministic across runs so results are comparable
+static inline uint64_t Bench_Rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline double Bench_RandUnit(uint64_t *state) {
+    return (double)(Bench_Rand(state) >> 11) / (double)(1ull << 53);
+}
+
+static inline int Bench_CmpU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts v in place; p in [0, 100]
+static inline uint64_t Bench_Percentile(uint64_t *v, size_t n, double p) {
+    if (n == 0) {
+        return 0;
+    }
+    qsort(v, n, sizeof(*v), Bench_CmpU64);
+    size_t idx = (size_t)(p / 100.0 * (double)(n - 1) + 0.5);
+    return v[idx];
+}
+
+// Scratch directory for benchmark data, removed by Bench_RemoveDir
+static inline char *Bench_TempDir(const char *base, const char *name) {
+    static char path[512];
+    snprintf(path, sizeof(path), "%s/%s.XXXXXX", base ? base : "/tmp", name);
+    return mkdtemp(path);
+}
+
+static inline void Bench_RemoveDir(const char *path) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", path);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "could not remove %s\n", path);
+    }
+}
+
+#endif // BENCH_H
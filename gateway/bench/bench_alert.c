@@ -0,0 +1,157 @@
+/*
+ * File: bench_alert.c
+ * Description: Per-sample cost of the alert rule engine with thousands of
+ *              rules active. Six hours of a fleet reporting every two minutes,
+ *              with battery sags and pressure storms on known nodes, go through
+ *              engines holding 0, a tenth of, all and four times the given
+ *              number of per-node rules, plus two fleet-wide ones. Rule i
+ *              watches node i % nodes with one of
+ *
+ *                  battery < 3.3 V for 1h
+ *                  pressure drop > 3 hPa/3h
+ *                  temperature > 45 degC or temperature < -20 degC
+ *                  humidity avg 1h > 95 %RH for 30m
+ *
+ *              (thresholds nudged per copy), so the alerts raised can be
+ *              checked against the injected events.
+ *
+ *              usage: bench_alert [rules] [nodes]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <math.h>
+
+#include "pipeline/alert.h"
+
+#define INTERVAL_MS 120000
+#define ROUNDS 180 // Six hours
+#define SAG_ROUND 60
+#define STORM_ROUND 90
+#define STORM_ROUNDS 60
+#define SAG_EVERY 100
+#define STORM_EVERY 50
+
+static int run(const Sample_t *samples, size_t total, uint32_t rules, uint32_t nodes) {
+    AlertConfig_t cfg;
+    AlertStats_t st;
+    char text[128], err[128];
+    uint64_t expected = 0;
+
+    Alert_DefaultConfig(&cfg);
+    cfg.expected_series = nodes * FIELD_COUNT;
+    AlertEngine_t *eng = Alert_Create(&cfg);
+    if (!eng) {
+        perror("alert");
+        return 1;
+    }
+    uint64_t start = Bench_NowNs();
+    for (uint32_t i = 0; i < rules; ++i) {
+        uint32_t n = i % nodes, copy = i / nodes / 4;
+        switch (i / nodes % 4) {
+        case 0:
+            snprintf(text, sizeof(text), "node %u battery < %.2f V for 1h", 0x1000 + n, 3.3 + 0.01 * (copy % 4));
+            expected += n % SAG_EVERY == 0;
+            break;
+        case 1:
+            snprintf(text, sizeof(text), "node %u pressure drop > %.1f hPa/3h", 0x1000 + n, 3 + 0.1 * (copy % 8));
+            expected += n % STORM_EVERY == 1;
+            break;
+        case 2:
+            snprintf(text, sizeof(text), "node %u temperature > %u degC or temperature < -20 degC", 0x1000 + n,
+                     45 + copy % 4);
+            break;
+        default:
+            snprintf(text, sizeof(text), "node %u humidity avg 1h > %u %%RH for 30m", 0x1000 + n, 95 - copy % 4);
+            break;
+        }
+        if (Alert_AddRule(eng, text, err, sizeof(err)) < 0) {
+            fprintf(stderr, "%s: %s\n", text, err);
+            return 1;
+        }
+    }
+    if (Alert_AddRule(eng, "battery < 2.9 V", err, sizeof(err)) < 0 ||
+        Alert_AddRule(eng, "temperature change 10m > 15 degC", err, sizeof(err)) < 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    double compile_ms = (double)(Bench_NowNs() - start) / 1e6;
+
+    // A frame of four samples at a time, as the ingest tap hands them over
+    start = Bench_NowNs();
+    for (size_t i = 0; i < total; i += FIELD_COUNT) {
+        Alert_Feed(eng, &samples[i], FIELD_COUNT);
+    }
+    double ns = (double)(Bench_NowNs() - start) / (double)total;
+    Alert_GetStats(eng, &st);
+    printf("%7u %9u %10.1f %10.1f %9.2f %9.2f %7llu %8llu %7llu\n", st.rules, st.instances, compile_ms, ns, 1e3 / ns,
+           (double)st.evaluations / (double)total, (unsigned long long)st.raised, (unsigned long long)expected,
+           (unsigned long long)st.cleared);
+    Alert_Destroy(eng);
+    return st.raised != expected;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rules = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    uint32_t nodes = argc > 2 ? (uint32_t)atoi(argv[2]) : 2500;
+    uint64_t rng = 42;
+    int rc = 0;
+
+    if (nodes < STORM_EVERY || rules < 10) {
+        fprintf(stderr, "usage: %s [rules >= 10] [nodes >= %d]\n", argv[0], STORM_EVERY);
+        return 1;
+    }
+    size_t total = (size_t)nodes * ROUNDS * FIELD_COUNT;
+    Sample_t *samples = malloc(total * sizeof(*samples));
+    uint32_t *order = malloc(nodes * sizeof(*order));
+    if (!samples || !order) {
+        perror("malloc");
+        return 1;
+    }
+    for (uint32_t i = 0; i < nodes; ++i) {
+        order[i] = i;
+    }
+
+    // Storms take 6 hPa off over two hours; sagging batteries drop under 3.3 V and stay there
+    size_t k = 0;
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t i = nodes; i-- > 1;) {
+            uint32_t j = (uint32_t)(Bench_Rand(&rng) % (i + 1)), t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+        for (uint32_t i = 0; i < nodes; ++i) {
+            uint32_t n = order[i];
+            int64_t ts = 1760000000000 + (int64_t)r * INTERVAL_MS + (int64_t)(n % 1000) * 7;
+            double storm = n % STORM_EVERY == 1 && r >= STORM_ROUND
+                               ? 6.0 * (r - STORM_ROUND < STORM_ROUNDS ? r - STORM_ROUND : STORM_ROUNDS) / STORM_ROUNDS
+                               : 0;
+            float temp = (float)(15 + n % 10 + 2 * sin(r / 30.0) + (Bench_RandUnit(&rng) - 0.5) * 0.2);
+            float hum = (float)(60 + n % 20 + (Bench_RandUnit(&rng) - 0.5));
+            float pres = (float)(1000 + n % 20 - storm + (Bench_RandUnit(&rng) - 0.5) * 0.02);
+            float batt = (float)((n % SAG_EVERY == 0 && r >= SAG_ROUND ? 3.25 : 3.6) + (Bench_RandUnit(&rng) - 0.5) * 0.01);
+            samples[k++] = (Sample_t){ts, 0x1000 + n, FIELD_TEMPERATURE, temp};
+            samples[k++] = (Sample_t){ts, 0x1000 + n, FIELD_HUMIDITY, hum};
+            samples[k++] = (Sample_t){ts, 0x1000 + n, FIELD_PRESSURE, pres};
+            samples[k++] = (Sample_t){ts, 0x1000 + n, FIELD_BATTERY, batt};
+        }
+    }
+
+    printf("%u nodes, %zu samples over %d h\n", nodes, total, ROUNDS * INTERVAL_MS / 3600000);
+    printf("%7s %9s %10s %10s %9s %9s %7s %8s %7s\n", "rules", "instances", "compile ms", "ns/sample", "M/s",
+           "evals/smp", "raised", "expected", "cleared");
+    const uint32_t counts[] = {0, rules / 10, rules, rules * 4};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        rc |= run(samples, total, counts[i], nodes);
+    }
+    free(order);
+    free(samples);
+    return rc;
+}
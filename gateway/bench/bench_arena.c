@@ -0,0 +1,130 @@
+/*
+ * File: bench_arena.c
+ * Description: Ingest of a simulated fleet (sim/fleet.h) in batches of
+ *              INGEST_BATCH frames, with the batch scratch state in an arena
+ *              and with a malloc per allocation (arena_bytes 0). Reports
+ *              frames/s, system allocator calls per second, per-batch latency
+ *              percentiles and peak resident memory. Each mode runs in its own
+ *              process so the resident figures do not mix.
+ *
+ *              usage: bench_arena [nodes] [frames] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pipeline/ingest.h"
+#include "sim/fleet.h"
+
+static long max_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+static int run(const char *dir, uint32_t nodes, size_t frames, size_t arena_bytes, bool encrypt) {
+    char path[600];
+    FleetConfig_t fleet_cfg;
+    IngestConfig_t cfg;
+    IngestStats_t st;
+
+    Fleet_DefaultConfig(&fleet_cfg);
+    fleet_cfg.nodes = nodes;
+    fleet_cfg.encrypt = encrypt;
+    fleet_cfg.seed = 42;
+    Fleet_t *fleet = Fleet_Create(&fleet_cfg, 1704067200000LL);
+    Frame_t *input = malloc(frames * sizeof(*input));
+    uint64_t *lat = malloc((frames / INGEST_BATCH + 1) * sizeof(*lat));
+    if (!fleet || !input || !lat) {
+        perror("malloc");
+        return 1;
+    }
+    for (size_t i = 0; i < frames; ++i) {
+        Fleet_Next(fleet, &input[i]);
+    }
+
+    Ingest_DefaultConfig(&cfg);
+    cfg.wal.sync = WAL_SYNC_NONE;
+    cfg.expected_nodes = nodes;
+    cfg.arena_bytes = arena_bytes;
+    snprintf(path, sizeof(path), "%s/%s%s", dir, arena_bytes ? "arena" : "malloc", encrypt ? "-sealed" : "");
+    Ingest_t *ingest = Ingest_Open(path, &cfg);
+    if (!ingest) {
+        perror(path);
+        return 1;
+    }
+    for (uint32_t n = 0; encrypt && n < nodes; ++n) {
+        uint8_t key[16];
+        Fleet_NodeKey(fleet, fleet_cfg.address_base + n, key);
+        Ingest_SetKey(ingest, fleet_cfg.address_base + n, key);
+    }
+
+    size_t batches = 0;
+    uint64_t start = Bench_NowNs();
+    for (size_t i = 0; i < frames; i += INGEST_BATCH) {
+        uint64_t t = Bench_NowNs();
+        Ingest_Frames(ingest, &input[i], frames - i < INGEST_BATCH ? frames - i : INGEST_BATCH);
+        lat[batches++] = Bench_NowNs() - t;
+    }
+    double s = (double)(Bench_NowNs() - start) / 1e9;
+    Ingest_GetStats(ingest, &st);
+
+    printf("%-7s %-6s %11.0f %13.0f %11.1f %8llu %8llu %8llu %10llu %9ld\n", arena_bytes ? "arena" : "malloc",
+           encrypt ? "sealed" : "clear", (double)frames / s, (double)st.scratch_mallocs / s,
+           (double)st.scratch_allocs / (double)batches, (unsigned long long)Bench_Percentile(lat, batches, 50),
+           (unsigned long long)Bench_Percentile(lat, batches, 99),
+           (unsigned long long)Bench_Percentile(lat, batches, 99.9), (unsigned long long)st.scratch_peak,
+           max_rss_kb());
+    if (st.auth_failures > 0 || st.samples == 0) {
+        fprintf(stderr, "%llu samples, %llu auth failures\n", (unsigned long long)st.samples,
+                (unsigned long long)st.auth_failures);
+        return 1;
+    }
+    Ingest_Close(ingest);
+    Fleet_Destroy(fleet);
+    free(input);
+    free(lat);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000;
+    size_t frames = argc > 2 ? (size_t)atoll(argv[2]) : 1000000;
+    char *dir = Bench_TempDir(argc > 3 ? argv[3] : NULL, "bench_arena");
+    IngestConfig_t defaults;
+    int rc = 0;
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    Ingest_DefaultConfig(&defaults);
+    printf("%-7s %-6s %11s %13s %11s %8s %8s %8s %10s %9s\n", "scratch", "frames", "frames/s", "mallocs/s",
+           "allocs/bat", "p50 ns", "p99 ns", "p99.9 ns", "peak bytes", "rss KB");
+    fflush(stdout);
+    for (int encrypt = 0; encrypt < 2; ++encrypt) {
+        for (int mode = 0; mode < 2; ++mode) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                int child = run(dir, nodes, frames, mode == 0 ? 0 : defaults.arena_bytes, encrypt);
+                fflush(stdout);
+                _exit(child);
+            }
+            int status;
+            waitpid(pid, &status, 0);
+            rc |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+    }
+    Bench_RemoveDir(dir);
+    return rc;
+}
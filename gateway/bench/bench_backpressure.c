@@ -0,0 +1,190 @@
+/*
+ * File: bench_backpressure.c
+ * Description: The radio-to-ingest frame queue (common/queue.h) under storage
+ *              stalls, for every queue policy. A radio thread offers a
+ *              simulated fleet's frames at a fixed rate, as gatewayd's receive
+ *              loop does; an ingest thread stores them and every period
+ *              stalls for a while, as a slow disk or a long fsync would.
+ *              Reports how long a push held up the radio thread (p50, p99,
+ *              max) and what became of the frames: stored, refused, evicted
+ *              or spilled.
+ *
+ *              usage: bench_backpressure [rate] [seconds] [stall_ms] [period_ms] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include "common/queue.h"
+#include "pipeline/ingest.h"
+#include "sim/fleet.h"
+
+#define QUEUE_FRAMES 4096
+#define BACKLOG_AGE_MS 60000
+
+typedef struct {
+    Ingest_t *ingest;
+    Queue_t *queue;
+    uint64_t stall_ns;
+    uint64_t period_ns;
+    uint64_t stalls;
+    int stop;
+} Consumer_t;
+
+static void sleep_until(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// As gatewayd: a node time well behind arrival marks a store-and-forward backlog
+static uint8_t priority(const Frame_t *frame) {
+    FrameHeader_t hdr;
+
+    if (Frame_ParseHeader(frame, &hdr) != 0 || !(hdr.flags & FRAME_FLAG_NODE_TIME)) {
+        return 1;
+    }
+    return frame->rx_ts - (int64_t)hdr.node_time * 1000 > BACKLOG_AGE_MS ? 0 : 1;
+}
+
+static void *consumer(void *arg) {
+    Consumer_t *c = arg;
+    Frame_t batch[INGEST_BATCH];
+    uint64_t next_stall = Bench_NowNs() + c->period_ns;
+
+    for (;;) {
+        size_t n = Queue_Pop(c->queue, batch, INGEST_BATCH, 10);
+        if (n == 0 && __atomic_load_n(&c->stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        if (Bench_NowNs() >= next_stall) {
+            sleep_until(Bench_NowNs() + c->stall_ns);
+            next_stall = Bench_NowNs() + c->period_ns;
+            c->stalls++;
+        }
+        if (n > 0) {
+            Ingest_Frames(c->ingest, batch, n);
+        }
+    }
+    return NULL;
+}
+
+static int run(QueuePolicy_t policy, const char *dir, uint32_t rate, double seconds, uint32_t stall_ms,
+               uint32_t period_ms) {
+    char path[600], spill[600];
+    IngestConfig_t ingest_cfg;
+    QueueConfig_t queue_cfg;
+    FleetConfig_t fleet_cfg;
+    QueueStats_t st;
+    IngestStats_t ist;
+
+    Fleet_DefaultConfig(&fleet_cfg);
+    fleet_cfg.nodes = 1000;
+    fleet_cfg.backlog = 0.02;
+    fleet_cfg.seed = 42;
+    Fleet_t *fleet = Fleet_Create(&fleet_cfg, 1704067200000LL);
+
+    Ingest_DefaultConfig(&ingest_cfg);
+    ingest_cfg.wal.sync = WAL_SYNC_NONE;
+    ingest_cfg.expected_nodes = fleet_cfg.nodes;
+    snprintf(path, sizeof(path), "%s/%s", dir, Queue_PolicyName(policy));
+    snprintf(spill, sizeof(spill), "%s/%s.spill", dir, Queue_PolicyName(policy));
+    Queue_DefaultConfig(&queue_cfg);
+    queue_cfg.name = "ingest";
+    queue_cfg.item_size = sizeof(Frame_t);
+    queue_cfg.capacity = QUEUE_FRAMES;
+    queue_cfg.policy = policy;
+    queue_cfg.spill_path = spill;
+
+    Consumer_t c = {
+        .ingest = Ingest_Open(path, &ingest_cfg),
+        .queue = Queue_Create(&queue_cfg),
+        .stall_ns = (uint64_t)stall_ms * 1000000,
+        .period_ns = (uint64_t)period_ms * 1000000,
+    };
+    size_t batches = (size_t)(rate * seconds) / INGEST_BATCH;
+    uint64_t *lat = malloc(batches * sizeof(*lat));
+    pthread_t tid;
+    if (!fleet || !c.ingest || !c.queue || !lat || pthread_create(&tid, NULL, consumer, &c) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    // Each batch is what the receive loop drains in one pass, pushed in runs of one priority
+    uint64_t interval = (uint64_t)INGEST_BATCH * 1000000000ull / rate;
+    uint64_t next = Bench_NowNs();
+    for (size_t b = 0; b < batches; ++b) {
+        Frame_t batch[INGEST_BATCH];
+        uint8_t prio[INGEST_BATCH];
+        for (size_t i = 0; i < INGEST_BATCH; ++i) {
+            Fleet_Next(fleet, &batch[i]);
+            prio[i] = priority(&batch[i]);
+        }
+        sleep_until(next);
+        uint64_t t = Bench_NowNs();
+        for (size_t i = 0; i < INGEST_BATCH;) {
+            size_t j = i + 1;
+            while (j < INGEST_BATCH && prio[j] == prio[i]) {
+                ++j;
+            }
+            Queue_Push(c.queue, &batch[i], j - i, prio[i]);
+            i = j;
+        }
+        lat[b] = Bench_NowNs() - t;
+        // A radio that was held up does not get the time back
+        next = next + interval > Bench_NowNs() ? next + interval : Bench_NowNs();
+    }
+    Queue_GetStats(c.queue, &st);
+    Queue_Close(c.queue);
+    __atomic_store_n(&c.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(tid, NULL);
+    Ingest_GetStats(c.ingest, &ist);
+
+    uint64_t worst = 0;
+    for (size_t b = 0; b < batches; ++b) {
+        worst = lat[b] > worst ? lat[b] : worst;
+    }
+    printf("%-13s %9.1f %9.1f %10.1f %9llu %8llu %8llu %8llu %8llu %7llu\n", Queue_PolicyName(policy),
+           (double)Bench_Percentile(lat, batches, 50) / 1e3, (double)Bench_Percentile(lat, batches, 99) / 1e3,
+           (double)worst / 1e6, (unsigned long long)ist.frames, (unsigned long long)st.dropped,
+           (unsigned long long)st.evicted, (unsigned long long)st.spilled, (unsigned long long)st.high_water,
+           (unsigned long long)c.stalls);
+
+    Ingest_Close(c.ingest);
+    Queue_Destroy(c.queue);
+    Fleet_Destroy(fleet);
+    free(lat);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rate = argc > 1 ? (uint32_t)atoi(argv[1]) : 20000;
+    double seconds = argc > 2 ? atof(argv[2]) : 5.0;
+    uint32_t stall_ms = argc > 3 ? (uint32_t)atoi(argv[3]) : 500;
+    uint32_t period_ms = argc > 4 ? (uint32_t)atoi(argv[4]) : 1500;
+    char *dir = Bench_TempDir(argc > 5 ? argv[5] : NULL, "bench_backpressure");
+    int rc = 0;
+
+    if (!dir || rate < INGEST_BATCH) {
+        fprintf(stderr, "usage: %s [rate] [seconds] [stall_ms] [period_ms] [dir]\n", argv[0]);
+        return 1;
+    }
+    printf("%u frames/s for %.1f s, %u-frame queue, storage stalls of %u ms every %u ms\n", rate, seconds,
+           QUEUE_FRAMES, stall_ms, period_ms);
+    printf("%-13s %9s %9s %10s %9s %8s %8s %8s %8s %7s\n", "policy", "push p50", "p99 us", "max ms", "stored",
+           "refused", "evicted", "spilled", "depth", "stalls");
+    for (int p = QUEUE_BLOCK; p <= QUEUE_SPILL; ++p) {
+        rc |= run((QueuePolicy_t)p, dir, rate, seconds, stall_ms, period_ms);
+        fflush(stdout);
+    }
+    Bench_RemoveDir(dir);
+    return rc;
+}
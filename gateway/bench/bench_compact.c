@@ -0,0 +1,242 @@
+/*
+ * File: bench_compact.c
+ * Description: Space reclaimed and throughput of background compaction, and
+ *              what it does to ingest latency. A store is filled with 40 days
+ *              of raw samples from a fleet reporting every minute, ending now,
+ *              with heads sealed every five minutes as the gateway's
+ *              checkpoints do, so chunks are small. It is then reopened and
+ *              live samples are appended from a thread, timing each call,
+ *              while
+ *
+ *                  none       nothing else runs, for LIVE_S seconds
+ *                  limited    the compactor runs at kb_per_s with the default
+ *                             retention (raw samples 30 days)
+ *                  unlimited  the same without a rate limit
+ *
+ *              each on a freshly filled store. Compaction throughput counts
+ *              the bytes read and written over the time it ran.
+ *
+ *              usage: bench_compact [nodes] [kb_per_s] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <ftw.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "storage/compact.h"
+#include "storage/store.h"
+
+#define DAYS 40
+#define SEGMENT_BYTES (16u << 20)
+#define INTERVAL_MS 60000
+#define SEAL_MS (5 * SERIES_MS_PER_MINUTE)
+#define LIVE_S 3
+#define LIVE_ROUND_US 1000
+#define LIVE_FLUSH_ROUNDS 300
+
+typedef struct {
+    SeriesStore_t *store;
+    uint32_t nodes;
+    int stop;
+    uint64_t *lat;
+    size_t n_lat;
+    size_t cap_lat;
+} Live_t;
+
+static uint64_t dir_bytes;
+static SeriesStoreConfig_t store_cfg;
+
+static int add_file(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)path;
+    (void)ftw;
+    if (type == FTW_F) {
+        dir_bytes += (uint64_t)st->st_size;
+    }
+    return 0;
+}
+
+static uint64_t du(const char *dir) {
+    dir_bytes = 0;
+    nftw(dir, add_file, 16, FTW_PHYS);
+    return dir_bytes;
+}
+
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Sensor-like values: a daily swing, slow drift and readings to a hundredth
+static float reading(uint32_t node, uint8_t field, int64_t ts, uint64_t *rng) {
+    double day = (double)(ts % SERIES_MS_PER_DAY) / (double)SERIES_MS_PER_DAY;
+    double base = field == FIELD_BATTERY ? 3.6 : 10.0 * (field + 1) + node % 10;
+    double swing = field == FIELD_BATTERY ? 0.0 : 4.0 * sin(2 * M_PI * day);
+    return (float)(round((base + swing + (Bench_RandUnit(rng) - 0.5) * 0.2) * 100) / 100);
+}
+
+static int fill(const char *dir, uint32_t nodes, int64_t end, uint64_t *samples) {
+    SeriesStore_t *store = SeriesStore_Open(dir, &store_cfg);
+    uint64_t rng = 11;
+    int rc = 0;
+
+    if (!store) {
+        perror("open");
+        return -1;
+    }
+    *samples = 0;
+    int64_t start = end - DAYS * SERIES_MS_PER_DAY;
+    for (int64_t t = start; t < end && rc == 0; t += INTERVAL_MS) {
+        for (uint32_t n = 0; n < nodes && rc == 0; ++n) {
+            int64_t ts = t + n * 37 + (int64_t)(Bench_Rand(&rng) % 200);
+            for (uint8_t f = 0; f < FIELD_COUNT && rc == 0; ++f) {
+                Sample_t s = {ts, 0x1000 + n, f, reading(n, f, ts, &rng)};
+                rc = SeriesStore_AppendSample(store, &s);
+            }
+        }
+        *samples += (uint64_t)nodes * FIELD_COUNT;
+        if ((t - start + INTERVAL_MS) % SEAL_MS == 0 && rc == 0) {
+            rc = SeriesStore_Flush(store);
+        }
+    }
+    if (rc != 0 || SeriesStore_Flush(store) != 0 || SeriesStore_Sync(store) != 0 || SeriesStore_SaveIndex(store) != 0) {
+        perror("fill");
+        rc = -1;
+    }
+    SeriesStore_Close(store);
+    return rc;
+}
+
+static void *live_thread(void *arg) {
+    Live_t *live = arg;
+    uint64_t rng = 5, rounds = 0;
+    int64_t ts = wall_ms();
+
+    while (!__atomic_load_n(&live->stop, __ATOMIC_ACQUIRE)) {
+        for (uint32_t n = 0; n < live->nodes; ++n) {
+            for (uint8_t f = 0; f < FIELD_COUNT; ++f) {
+                Sample_t s = {ts + n, 0x1000 + n, f, reading(n, f, ts, &rng)};
+                uint64_t start = Bench_NowNs();
+                SeriesStore_AppendSample(live->store, &s);
+                uint64_t ns = Bench_NowNs() - start;
+                if (live->n_lat == live->cap_lat) {
+                    live->cap_lat = live->cap_lat ? live->cap_lat * 2 : 1 << 16;
+                    live->lat = realloc(live->lat, live->cap_lat * sizeof(*live->lat));
+                }
+                live->lat[live->n_lat++] = ns;
+            }
+        }
+        ts += 1000;
+        if (++rounds % LIVE_FLUSH_ROUNDS == 0) {
+            SeriesStore_Flush(live->store);
+        }
+        usleep(LIVE_ROUND_US);
+    }
+    return NULL;
+}
+
+// kb_per_s < 0 runs no compactor
+static int run(const char *base, const char *mode, uint32_t nodes, int64_t kb_per_s) {
+    char *dir = Bench_TempDir(base, "bench_compact");
+    CompactorConfig_t cfg;
+    CompactorStats_t st = {0};
+    uint64_t samples;
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    if (fill(dir, nodes, wall_ms(), &samples) != 0) {
+        Bench_RemoveDir(dir);
+        return 1;
+    }
+    uint64_t before = du(dir);
+    Live_t live = {.store = SeriesStore_Open(dir, &store_cfg), .nodes = nodes};
+    pthread_t thread;
+    if (!live.store || pthread_create(&thread, NULL, live_thread, &live) != 0) {
+        perror("live");
+        SeriesStore_Close(live.store);
+        Bench_RemoveDir(dir);
+        return 1;
+    }
+
+    uint64_t start = Bench_NowNs();
+    if (kb_per_s < 0) {
+        sleep(LIVE_S);
+    } else {
+        Compactor_DefaultConfig(&cfg);
+        cfg.bytes_per_s = (uint64_t)kb_per_s * 1024;
+        cfg.interval_ms = 3600000;
+        Compactor_t *c = Compactor_Start(live.store, &cfg);
+        if (!c) {
+            perror("compactor");
+        }
+        // One pass does everything due
+        while (c) {
+            Compactor_GetStats(c, &st);
+            if (st.passes > 0) {
+                break;
+            }
+            usleep(20000);
+        }
+        Compactor_Stop(c);
+    }
+    double secs = (double)(Bench_NowNs() - start) / 1e9;
+    __atomic_store_n(&live.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    SeriesStore_Close(live.store);
+    uint64_t after = du(dir);
+
+    double busy = st.busy_ns ? (double)st.busy_ns / 1e9 : secs;
+    double mb = (double)(1u << 20);
+    printf("%-9s %9.1f %8.1f %8.1f %9.1f %5llu %5llu %8.2f %8.1f %8.2f %7.2f %7.2f %8.1f\n", mode,
+           (double)samples / 1e6, (double)before / mb, (double)after / mb, (double)st.store.bytes_reclaimed / mb,
+           (unsigned long long)st.store.segments, (unsigned long long)st.store.dropped, secs,
+           (double)(st.store.bytes_read + st.store.bytes_written) / mb / busy,
+           (double)st.store.records_in / 1e6 / busy,
+           (double)Bench_Percentile(live.lat, live.n_lat, 50) / 1e3,
+           (double)Bench_Percentile(live.lat, live.n_lat, 99) / 1e3,
+           (double)Bench_Percentile(live.lat, live.n_lat, 100) / 1e3);
+    if (kb_per_s >= 0) {
+        printf("%9s records %llu in, %llu expired; chunks %llu -> %llu; %.1f s throttled\n", "",
+               (unsigned long long)st.store.records_in, (unsigned long long)st.store.records_expired,
+               (unsigned long long)st.store.chunks_in, (unsigned long long)st.store.chunks_out,
+               (double)st.throttled_ns / 1e9);
+    }
+    free(live.lat);
+    Bench_RemoveDir(dir);
+    return st.errors != 0 || (kb_per_s >= 0 && (st.store.segments == 0 || after >= before));
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 25;
+    int64_t kb_per_s = argc > 2 ? atoll(argv[2]) : 32768;
+    const char *base = argc > 3 ? argv[3] : NULL;
+    int rc = 0;
+
+    if (nodes == 0 || kb_per_s <= 0) {
+        fprintf(stderr, "usage: %s [nodes] [kb_per_s] [dir]\n", argv[0]);
+        return 1;
+    }
+    SeriesStore_DefaultConfig(&store_cfg);
+    store_cfg.segment_bytes = SEGMENT_BYTES;
+    printf("%u nodes, %d days every %d s, sealed every %lld min, %u MB segments\n", nodes, DAYS, INTERVAL_MS / 1000,
+           (long long)(SEAL_MS / SERIES_MS_PER_MINUTE), SEGMENT_BYTES >> 20);
+    printf("%-9s %9s %8s %8s %9s %5s %5s %8s %8s %8s %7s %7s %8s\n", "mode", "Msamples", "MB", "MB after",
+           "reclaimed", "segs", "drop", "secs", "MB/s", "Mrec/s", "p50 us", "p99 us", "max us");
+    rc |= run(base, "none", nodes, -1);
+    rc |= run(base, "limited", nodes, kb_per_s);
+    rc |= run(base, "unlimited", nodes, 0);
+    return rc;
+}
@@ -0,0 +1,142 @@
+/*
+ * File: bench_dedup.c
+ * Description: Duplicate suppression under a fleet-like stream: in-order
+ *              sequence numbers per node with immediate ESB retries, delayed
+ *              store-and-forward resends, local reordering and occasional node
+ *              restarts. Reports the per-frame cost of the window check alone
+ *              and of the whole ingest path, and checks that exactly the
+ *              injected duplicates are dropped.
+ *
+ *              usage: bench_dedup [nodes] [rounds] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Windows looked up through the node registry.
+ *
+ */
+#include "bench.h"
+
+#include "pipeline/dedup.h"
+#include "pipeline/ingest.h"
+#include "registry/registry.h"
+
+typedef struct {
+    uint32_t node;
+    uint16_t seq;
+    uint8_t dup; // Injected copy of an earlier frame
+} Event_t;
+
+typedef struct {
+    Event_t *ev;
+    size_t n;
+    size_t cap;
+    uint64_t dups;
+} Stream_t;
+
+static void push(Stream_t *s, uint32_t node, uint16_t seq, uint8_t dup) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1 << 16;
+        s->ev = realloc(s->ev, s->cap * sizeof(*s->ev));
+        if (!s->ev) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    s->ev[s->n++] = (Event_t){node, seq, dup};
+    s->dups += dup;
+}
+
+static void build_stream(Stream_t *s, uint32_t nodes, uint32_t rounds, uint64_t *rng) {
+    uint16_t *seq = calloc(nodes, sizeof(*seq));
+
+    for (uint32_t r = 0; r < rounds; ++r) {
+        for (uint32_t n = 0; n < nodes; ++n) {
+            double u = Bench_RandUnit(rng);
+            if (u < 0.0005 && seq[n] > 150) {
+                seq[n] = 0; // Node restart
+            }
+            uint16_t cur = seq[n]++;
+            if (u > 0.98) {
+                push(s, n + 1, seq[n]++, 0); // Overtaken by its successor
+            }
+            push(s, n + 1, cur, 0);
+            if (u < 0.08) {
+                push(s, n + 1, cur, 1); // ESB retry after a lost ACK
+            } else if (u < 0.10 && cur > 60 && r > 60) {
+                push(s, n + 1, (uint16_t)(cur - 1 - Bench_Rand(rng) % 50), 1); // Store-and-forward resend
+            }
+        }
+    }
+    // Swap neighbouring frames now and then; both stay inside the window
+    for (size_t i = 0; i + 1 < s->n; i += 7) {
+        if (Bench_RandUnit(rng) < 0.2 && s->ev[i].node != s->ev[i + 1].node) {
+            Event_t t = s->ev[i];
+            s->ev[i] = s->ev[i + 1];
+            s->ev[i + 1] = t;
+        }
+    }
+    free(seq);
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    uint32_t rounds = argc > 2 ? (uint32_t)atoi(argv[2]) : 200;
+    char *dir = Bench_TempDir(argc > 3 ? argv[3] : NULL, "bench_dedup");
+    uint64_t rng = 0xD1B54A32D192ED03ull;
+    Stream_t s = {0};
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    build_stream(&s, nodes, rounds, &rng);
+    printf("%u nodes, %zu frames, %llu injected duplicates\n", nodes, s.n, (unsigned long long)s.dups);
+
+    NodeRegistry_t *registry = Registry_Create(nodes);
+    uint64_t counts[4] = {0};
+    uint64_t start = Bench_NowNs();
+    for (size_t i = 0; i < s.n; ++i) {
+        uint32_t skipped;
+        NodeHot_t *hot = Registry_Hot(registry, Registry_Upsert(registry, s.ev[i].node));
+        counts[DedupWindow_Check(&hot->window, s.ev[i].seq, &skipped)]++;
+    }
+    double ns = (double)(Bench_NowNs() - start) / (double)s.n;
+    printf("window check   %6.1f ns/frame  new %llu late %llu dup %llu reset %llu  %s\n", ns,
+           (unsigned long long)counts[DEDUP_NEW], (unsigned long long)counts[DEDUP_LATE],
+           (unsigned long long)counts[DEDUP_DUPLICATE], (unsigned long long)counts[DEDUP_RESET],
+           counts[DEDUP_DUPLICATE] == s.dups ? "ok" : "MISMATCH");
+    Registry_Destroy(registry);
+
+    IngestConfig_t cfg;
+    Ingest_DefaultConfig(&cfg);
+    cfg.expected_nodes = nodes;
+    Ingest_t *ingest = Ingest_Open(dir, &cfg);
+    if (!ingest) {
+        perror(dir);
+        Bench_RemoveDir(dir);
+        return 1;
+    }
+    int64_t t0 = 1700000000000ll;
+    start = Bench_NowNs();
+    for (size_t i = 0; i < s.n; ++i) {
+        Frame_t frame = {.rx_ts = t0 + (int64_t)(i / nodes) * 60000, .pipe = 1};
+        FrameHeader_t hdr = {.type = FRAME_TYPE_TELEMETRY, .node = s.ev[i].node, .seq = s.ev[i].seq};
+        FrameReading_t r[2] = {{FIELD_TEMPERATURE, 21.5f}, {FIELD_HUMIDITY, 48.0f}};
+        frame.len = (uint8_t)Frame_Encode(frame.payload, &hdr, r, 2);
+        Ingest_Frame(ingest, &frame);
+    }
+    ns = (double)(Bench_NowNs() - start) / (double)s.n;
+    IngestStats_t st;
+    Ingest_GetStats(ingest, &st);
+    printf("full ingest    %6.1f ns/frame  applied %llu dropped %llu late %llu resets %llu  %s\n", ns,
+           (unsigned long long)st.frames, (unsigned long long)st.duplicates, (unsigned long long)st.late,
+           (unsigned long long)st.seq_resets, st.duplicates == s.dups ? "ok" : "MISMATCH");
+    Ingest_Close(ingest);
+    Bench_RemoveDir(dir);
+    free(s.ev);
+    return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * File: bench_downlink.c
+ * Description: Downlink scheduler on the receive path. First, in real time,
+ *              the cost of picking a node's ACK payload while other threads
+ *              enqueue, and of the first pick after 20k OTA chunks land at
+ *              once, with the per-pick drain bounded and unbounded. Then, in
+ *              simulated time, enqueue-to-load latency per priority for a
+ *              fleet reporting every 10 s with time sync, configuration and
+ *              OTA traffic competing for the one ACK payload per frame.
+ *
+ *              On one CPU the producers preempt the receive thread, so the
+ *              real-time maximum is also given over the picks it was not
+ *              switched out of (a VM's steal time still shows in both).
+ *
+ *              usage: bench_downlink [nodes] [seconds]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Worst pick without preemption.
+ *
+ */
+#include "bench.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "radio/downlink.h"
+
+#define PRODUCERS 2
+#define BURST 20000
+#define KIND_TIME 1
+#define KIND_CONFIG 2
+
+typedef struct {
+    DownlinkScheduler_t *sched;
+    uint32_t nodes;
+    uint64_t seed;
+    int *stop;
+} Producer_t;
+
+static void make_msg(DownlinkMsg_t *m, uint32_t node, uint8_t prio, int64_t now_ms) {
+    uint64_t ns = Bench_NowNs();
+
+    memset(m, 0, sizeof(*m));
+    m->node = node;
+    m->prio = prio;
+    m->kind = prio == DOWNLINK_PRIO_TIME ? KIND_TIME : prio == DOWNLINK_PRIO_CONTROL ? KIND_CONFIG : 0;
+    m->len = FRAME_MAX_PAYLOAD;
+    memcpy(m->payload, &ns, sizeof(ns)); // Enqueue time, for the wait on the far side
+    m->deadline_ms = prio == DOWNLINK_PRIO_TIME ? now_ms + 15000 : 0;
+    m->enqueued_ms = now_ms;
+}
+
+// Times the receive thread was switched out for another thread
+static long preemptions(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_nivcsw;
+}
+
+static void *producer(void *arg) {
+    Producer_t *p = arg;
+    DownlinkMsg_t m;
+
+    while (!__atomic_load_n(p->stop, __ATOMIC_RELAXED)) {
+        // About 20k messages/s each, in small bursts
+        for (int i = 0; i < 20; ++i) {
+            uint64_t r = Bench_Rand(&p->seed);
+            make_msg(&m, (uint32_t)(r % p->nodes), (uint8_t)((r >> 32) % DOWNLINK_PRIO_COUNT),
+                     (int64_t)(Bench_NowNs() / 1000000));
+            Downlink_Enqueue(p->sched, &m);
+        }
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static void realtime(uint32_t nodes, double seconds) {
+    DownlinkConfig_t cfg;
+    Downlink_DefaultConfig(&cfg);
+    cfg.expected_nodes = nodes;
+    DownlinkScheduler_t *sched = Downlink_Create(&cfg);
+    int stop = 0;
+    pthread_t tid[PRODUCERS];
+    Producer_t prod[PRODUCERS];
+
+    for (int i = 0; i < PRODUCERS; ++i) {
+        prod[i] = (Producer_t){sched, nodes, 0x9e3779b97f4a7c15ull * (uint64_t)(i + 1), &stop};
+        pthread_create(&tid[i], NULL, producer, &prod[i]);
+    }
+
+    // The receive thread: frames from random nodes, a pick per frame, idle polls in between
+    size_t cap = (size_t)(seconds * 2e6), n_pick = 0, n_wait = 0;
+    uint64_t *pick = malloc(cap * sizeof(*pick)), *wait = malloc(cap * sizeof(*wait));
+    uint64_t rng = 7, end = Bench_NowNs() + (uint64_t)(seconds * 1e9), worst = 0, worst_alone = 0;
+    while (Bench_NowNs() < end && n_pick < cap) {
+        for (int i = 0; i < 100 && n_pick < cap; ++i) {
+            DownlinkMsg_t m;
+            uint32_t node = (uint32_t)(Bench_Rand(&rng) % nodes);
+            long switches = preemptions();
+            uint64_t t0 = Bench_NowNs();
+            int got = Downlink_Next(sched, node, (int64_t)(t0 / 1000000), &m);
+            uint64_t t1 = Bench_NowNs();
+            pick[n_pick++] = t1 - t0;
+            worst = t1 - t0 > worst ? t1 - t0 : worst;
+            if (t1 - t0 > worst_alone && preemptions() == switches) {
+                worst_alone = t1 - t0;
+            }
+            if (got) {
+                uint64_t ns;
+                memcpy(&ns, m.payload, sizeof(ns));
+                wait[n_wait++] = t1 - ns;
+            }
+        }
+        Downlink_Poll(sched, (int64_t)(Bench_NowNs() / 1000000));
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < PRODUCERS; ++i) {
+        pthread_join(tid[i], NULL);
+    }
+
+    DownlinkStats_t st;
+    Downlink_GetStats(sched, &st);
+    printf("%zu picks: p50 %4llu ns p99 %5llu ns p99.99 %7llu ns max %8llu ns, %7llu ns not preempted\n", n_pick,
+           (unsigned long long)Bench_Percentile(pick, n_pick, 50), (unsigned long long)Bench_Percentile(pick, n_pick, 99),
+           (unsigned long long)Bench_Percentile(pick, n_pick, 99.99), (unsigned long long)worst,
+           (unsigned long long)worst_alone);
+    printf("  %llu loaded, queued for p50 %.1f ms p99 %.1f ms; dropped over quota %llu, left %llu\n",
+           (unsigned long long)st.loaded, (double)Bench_Percentile(wait, n_wait, 50) / 1e6,
+           (double)Bench_Percentile(wait, n_wait, 99) / 1e6, (unsigned long long)st.quota_drops,
+           (unsigned long long)st.queued);
+    free(pick);
+    free(wait);
+    Downlink_Destroy(sched);
+}
+
+// First pick after an OTA fan-out lands BURST messages in the inbox at once
+static void burst(uint32_t nodes, uint32_t drain_batch) {
+    DownlinkConfig_t cfg;
+    Downlink_DefaultConfig(&cfg);
+    cfg.expected_nodes = nodes;
+    cfg.drain_batch = drain_batch;
+    DownlinkScheduler_t *sched = Downlink_Create(&cfg);
+    uint64_t rng = 3, worst = 0, total = 0;
+    DownlinkMsg_t m;
+    int rounds = 20;
+
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < BURST; ++i) {
+            make_msg(&m, (uint32_t)(Bench_Rand(&rng) % nodes), DOWNLINK_PRIO_BULK, 0);
+            Downlink_Enqueue(sched, &m);
+        }
+        uint64_t t0 = Bench_NowNs();
+        Downlink_Next(sched, (uint32_t)(Bench_Rand(&rng) % nodes), 0, &m);
+        uint64_t dt = Bench_NowNs() - t0;
+        total += dt;
+        worst = dt > worst ? dt : worst;
+        Downlink_Poll(sched, 0);
+        for (uint32_t i = 0; i < nodes; ++i) {
+            while (Downlink_Next(sched, i, 0, &m) == 1) {
+            }
+        }
+    }
+    char batch[16];
+    snprintf(batch, sizeof(batch), drain_batch == UINT32_MAX ? "all" : "%u", drain_batch);
+    printf("  drain %-4s first pick after the burst: mean %7.1f us max %7.1f us\n", batch,
+           (double)total / rounds / 1e3, (double)worst / 1e3);
+    Downlink_Destroy(sched);
+}
+
+/* --- Simulated fleet --- */
+
+typedef struct {
+    int64_t next_report;
+    uint32_t ota_left; // OTA chunks still to send, fed as the node takes them
+    uint32_t ota_queued;
+} SimNode_t;
+
+static void simulated(uint32_t nodes, double hours) {
+    const int64_t interval = 10000;
+    DownlinkConfig_t cfg;
+    Downlink_DefaultConfig(&cfg);
+    cfg.expected_nodes = nodes;
+    DownlinkScheduler_t *sched = Downlink_Create(&cfg);
+    SimNode_t *sim = calloc(nodes, sizeof(*sim));
+    uint64_t rng = 11;
+    int64_t now = 0, end = (int64_t)(hours * 3600e3);
+    size_t cap = (size_t)((double)nodes * (double)end / (double)interval) + 16, n[DOWNLINK_PRIO_COUNT] = {0};
+    uint64_t *wait[DOWNLINK_PRIO_COUNT];
+
+    for (int p = 0; p < DOWNLINK_PRIO_COUNT; ++p) {
+        wait[p] = malloc(cap * sizeof(uint64_t));
+    }
+    for (uint32_t i = 0; i < nodes; ++i) {
+        sim[i].next_report = (int64_t)(Bench_Rand(&rng) % (uint64_t)interval);
+        sim[i].ota_left = i % 20 == 0 ? 200 : 0; // 5% of the fleet updating
+    }
+
+    // Time sync to every node each minute, configuration pushes to 1% of nodes each minute
+    int64_t next_sync = 0;
+    while (now < end) {
+        if (now >= next_sync) {
+            for (uint32_t i = 0; i < nodes; ++i) {
+                DownlinkMsg_t m = {.node = i, .prio = DOWNLINK_PRIO_TIME, .kind = KIND_TIME, .len = 9,
+                                   .deadline_ms = now + 15000, .enqueued_ms = now};
+                Downlink_Enqueue(sched, &m);
+                if (Bench_Rand(&rng) % 100 == 0) {
+                    m.prio = DOWNLINK_PRIO_CONTROL;
+                    m.kind = KIND_CONFIG;
+                    m.deadline_ms = 0;
+                    Downlink_Enqueue(sched, &m);
+                }
+            }
+            next_sync += 60000;
+        }
+        // Next 100 ms of reports
+        int64_t step_end = now + 100;
+        for (uint32_t i = 0; i < nodes; ++i) {
+            SimNode_t *s = &sim[i];
+            while (s->ota_left > 0 && s->ota_queued < 4) {
+                DownlinkMsg_t m = {.node = i, .prio = DOWNLINK_PRIO_BULK, .len = 32, .enqueued_ms = now};
+                if (Downlink_Enqueue(sched, &m) != 0) {
+                    break;
+                }
+                s->ota_left--;
+                s->ota_queued++;
+            }
+            if (s->next_report >= step_end) {
+                continue;
+            }
+            DownlinkMsg_t m;
+            if (Downlink_Next(sched, i, s->next_report, &m) == 1) {
+                wait[m.prio][n[m.prio]++] = (uint64_t)(s->next_report - m.enqueued_ms);
+                if (m.prio == DOWNLINK_PRIO_BULK) {
+                    s->ota_queued--;
+                }
+            }
+            s->next_report += interval + (int64_t)(Bench_Rand(&rng) % 2001) - 1000;
+        }
+        Downlink_Poll(sched, step_end);
+        now = step_end;
+    }
+
+    DownlinkStats_t st;
+    Downlink_GetStats(sched, &st);
+    static const char *names[] = {"time", "control", "bulk"};
+    printf("%u nodes, %.1f h simulated, one ACK payload per 10 s report:\n", nodes, hours);
+    for (int p = 0; p < DOWNLINK_PRIO_COUNT; ++p) {
+        size_t k = n[p];
+        // Bench_Percentile sorts in place, so the maximum is read after it
+        double p50 = (double)Bench_Percentile(wait[p], k, 50) / 1e3;
+        double p99 = (double)Bench_Percentile(wait[p], k, 99) / 1e3;
+        double max = k ? (double)wait[p][k - 1] / 1e3 : 0.0;
+        printf("  %-8s %8zu loaded, wait p50 %5.1f s p99 %5.1f s max %5.1f s\n", names[p], k, p50, p99, max);
+        free(wait[p]);
+    }
+    printf("  replaced %llu, expired %llu, dropped over quota %llu\n", (unsigned long long)st.replaced,
+           (unsigned long long)st.expired, (unsigned long long)st.quota_drops);
+    free(sim);
+    Downlink_Destroy(sched);
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    double seconds = argc > 2 ? atof(argv[2]) : 2;
+
+    if (nodes == 0 || seconds <= 0) {
+        fprintf(stderr, "usage: %s [nodes] [seconds]\n", argv[0]);
+        return 1;
+    }
+    printf("%u nodes, %d producers at ~20k msg/s each, picks for random nodes:\n", nodes, PRODUCERS);
+    realtime(nodes, seconds);
+    printf("%d message OTA burst:\n", BURST);
+    burst(nodes, 64);
+    burst(nodes, UINT32_MAX);
+    simulated(nodes, 2);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * File: bench_export.c
+ * Description: Export throughput over a one-minute dataset generated on the
+ *              host, by default a year of 100 nodes. Exports the whole store
+ *              to /dev/null as CSV and Parquet with 1, 2 and 4 workers and
+ *              reports rows/s, output size and peak resident memory.
+ *
+ *              usage: bench_export [nodes] [years] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "export/export.h"
+#include "storage/store.h"
+
+#define T0 1704067200000LL // 2024-01-01
+
+// Node readings are fixed point; store them as a frame would carry them
+static float synth_value(uint32_t node, uint8_t field, int64_t minute, uint64_t *rng) {
+    double day = (double)minute / 1440.0;
+    double noise = Bench_RandUnit(rng) - 0.5;
+
+    switch (field) {
+    case FIELD_TEMPERATURE:
+        return (float)(int16_t)lrint((10.0 + 12.0 * sin(2.0 * M_PI * (day - 110.0) / 365.25) +
+                                      6.0 * sin(2.0 * M_PI * (day - 0.375)) + noise + (double)(node % 5)) * 100.0) *
+               0.01f;
+    case FIELD_HUMIDITY:
+        return (float)(int16_t)lrint((65.0 - 15.0 * sin(2.0 * M_PI * (day - 0.375)) + 4.0 * noise) * 100.0) * 0.01f;
+    case FIELD_PRESSURE:
+        return (float)(uint16_t)lrint((1013.0 + 12.0 * sin(2.0 * M_PI * day / 9.0) + noise) * 10.0) * 0.1f;
+    default:
+        return (float)(uint16_t)lrint((3.7 - 0.4 * day / 730.0 + 0.01 * noise) * 1000.0) * 0.001f;
+    }
+}
+
+static long max_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 100;
+    double years = argc > 2 ? atof(argv[2]) : 1.0;
+    char *dir = Bench_TempDir(argc > 3 ? argv[3] : NULL, "bench_export");
+    uint64_t rng = 42;
+    int64_t minutes = (int64_t)(years * 365.0 * 1440.0);
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    SeriesStore_t *store = SeriesStore_Open(dir, NULL);
+    if (!store) {
+        fprintf(stderr, "cannot open store in %s\n", dir);
+        return 1;
+    }
+    uint64_t start = Bench_NowNs();
+    for (int64_t m = 0; m < minutes; ++m) {
+        for (uint32_t n = 1; n <= nodes; ++n) {
+            for (uint8_t f = 0; f < FIELD_COUNT; ++f) {
+                Sample_t s = {
+                    .ts = T0 + m * SERIES_MS_PER_MINUTE + (int64_t)(n % 60) * 1000,
+                    .node = n,
+                    .field = f,
+                    .value = synth_value(n, f, m, &rng),
+                };
+                SeriesStore_AppendSample(store, &s);
+            }
+        }
+    }
+    SeriesStore_Close(store);
+    printf("generated %lld samples (%u nodes, %.1f years) in %.1f s, rss %ld KB\n",
+           (long long)minutes * nodes * FIELD_COUNT, nodes, years, (double)(Bench_NowNs() - start) / 1e9,
+           max_rss_kb());
+
+    SeriesStoreConfig_t store_cfg;
+    SeriesStore_DefaultConfig(&store_cfg);
+    store_cfg.read_only = true;
+    store = SeriesStore_Open(dir, &store_cfg);
+    int out = open("/dev/null", O_WRONLY);
+    if (!store || out < 0) {
+        fprintf(stderr, "cannot reopen store\n");
+        return 1;
+    }
+    long rss_base = max_rss_kb();
+
+    printf("%-8s %7s %12s %10s %9s %9s %12s\n", "format", "threads", "rows/s", "MB/s", "bytes/row", "seconds",
+           "peak rss KB");
+    static const ExportFormat_t formats[] = {EXPORT_CSV, EXPORT_PARQUET};
+    static const uint32_t threads[] = {1, 2, 4};
+    int rc = 0;
+    for (size_t fi = 0; fi < sizeof(formats) / sizeof(formats[0]); ++fi) {
+        for (size_t ti = 0; ti < sizeof(threads) / sizeof(threads[0]); ++ti) {
+            ExportConfig_t cfg;
+            ExportStats_t st;
+            Export_DefaultConfig(&cfg);
+            cfg.format = formats[fi];
+            cfg.threads = threads[ti];
+
+            start = Bench_NowNs();
+            if (Export_Run(store, &cfg, out, &st) != 0) {
+                perror("export");
+                rc = 1;
+                break;
+            }
+            double s = (double)(Bench_NowNs() - start) / 1e9;
+            printf("%-8s %7u %12.0f %10.1f %9.1f %9.2f %12ld\n", Export_FormatName(cfg.format), cfg.threads,
+                   (double)st.rows / s, (double)st.bytes / 1e6 / s, (double)st.bytes / (double)st.rows, s,
+                   max_rss_kb());
+            if (st.rows != (uint64_t)minutes * nodes || st.samples != st.rows * FIELD_COUNT) {
+                fprintf(stderr, "expected %lld rows, exported %llu rows and %llu samples\n",
+                        (long long)minutes * nodes, (unsigned long long)st.rows,
+                        (unsigned long long)st.samples);
+                rc = 1;
+            }
+        }
+    }
+    printf("rss before exporting %ld KB\n", rss_base);
+
+    close(out);
+    SeriesStore_Close(store);
+    Bench_RemoveDir(dir);
+    return rc;
+}
@@ -0,0 +1,106 @@
+/*
+ * File: bench_iowriter.c
+ * Description: Synchronous pwrite against io_uring for the storage writes of
+ *              the ingest path (sealed chunks and WAL batches). Reports write
+ *              system calls per second and the ingest call latency tail.
+ *
+ *              usage: bench_iowriter [frames] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include "pipeline/ingest.h"
+
+#define NODES 2000
+
+static void make_frame(Frame_t *frame, uint32_t i, int64_t t0) {
+    FrameHeader_t hdr = {
+        .type = FRAME_TYPE_TELEMETRY,
+        .flags = FRAME_FLAG_NODE_TIME,
+        .node = i % NODES + 1,
+        .seq = (uint16_t)(i / NODES),
+        .node_time = (uint32_t)(t0 / 1000 + (int64_t)(i / NODES) * 60),
+    };
+    FrameReading_t r[4] = {
+        {FIELD_TEMPERATURE, 15.0f + (float)(i % 211) * 0.05f},
+        {FIELD_HUMIDITY, 50.0f + (float)(i % 17)},
+        {FIELD_PRESSURE, 1005.0f + (float)(i % 7)},
+        {FIELD_BATTERY, 3.1f},
+    };
+    frame->rx_ts = t0;
+    frame->pipe = 1;
+    frame->rpd = 0;
+    frame->len = (uint8_t)Frame_Encode(frame->payload, &hdr, r, 4);
+}
+
+static void run(const char *base, IoBackend_t backend, uint32_t frames) {
+    char *dir = Bench_TempDir(base, "bench_iowriter");
+    IngestConfig_t cfg;
+
+    if (!dir) {
+        perror(base);
+        return;
+    }
+    Ingest_DefaultConfig(&cfg);
+    cfg.store.io_backend = backend;
+    cfg.store.raw_chunk_records = 64; // Many small seals, as with a large fleet
+    cfg.wal.io_backend = backend;
+    cfg.wal.max_delay_us = 1000;
+    Ingest_t *ingest = Ingest_Open(dir, &cfg);
+    uint64_t *lat = malloc(frames * sizeof(*lat));
+    if (!ingest || !lat) {
+        perror(dir);
+        free(lat);
+        Bench_RemoveDir(dir);
+        return;
+    }
+    IoWriterStats_t store0, wal0, store1, wal1;
+    SeriesStore_GetIoStats(Ingest_Store(ingest), &store0);
+    Wal_GetIoStats(Ingest_Wal(ingest), &wal0);
+
+    uint64_t start = Bench_NowNs();
+    for (uint32_t i = 0; i < frames; ++i) {
+        Frame_t frame;
+        make_frame(&frame, i, 1700000000000ll);
+        uint64_t t = Bench_NowNs();
+        Ingest_Frame(ingest, &frame);
+        lat[i] = Bench_NowNs() - t;
+    }
+    SeriesStore_Flush(Ingest_Store(ingest));
+    Wal_WaitDurable(Ingest_Wal(ingest), Wal_LastLsn(Ingest_Wal(ingest)));
+    double secs = (double)(Bench_NowNs() - start) / 1e9;
+    SeriesStore_GetIoStats(Ingest_Store(ingest), &store1);
+    Wal_GetIoStats(Ingest_Wal(ingest), &wal1);
+
+    uint64_t store_calls = store1.syscalls - store0.syscalls;
+    uint64_t wal_calls = wal1.syscalls - wal0.syscalls;
+    uint64_t p50 = Bench_Percentile(lat, frames, 50.0);
+    uint64_t p99 = Bench_Percentile(lat, frames, 99.0);
+    uint64_t p999 = Bench_Percentile(lat, frames, 99.9);
+    printf("%-26s %9.0f %10llu %8llu %9.0f %7.2f %7.2f %7.1f %8.1f %6llu\n", SeriesStore_IoBackend(Ingest_Store(ingest)),
+           frames / secs, (unsigned long long)(store1.writes - store0.writes), (unsigned long long)(store_calls + wal_calls),
+           (double)(store_calls + wal_calls) / secs, (double)p50 / 1e3, (double)p99 / 1e3, (double)p999 / 1e3,
+           (double)lat[frames - 1] / 1e3, (unsigned long long)(store1.space_waits - store0.space_waits));
+    free(lat);
+    Ingest_Close(ingest);
+    Bench_RemoveDir(dir);
+}
+
+int main(int argc, char **argv) {
+    uint32_t frames = argc > 1 ? (uint32_t)atoi(argv[1]) : 500000;
+    const char *base = argc > 2 ? argv[2] : NULL;
+
+    printf("%u frames, %d nodes, WAL group commit 1 ms\n", frames, NODES);
+    printf("%-26s %9s %10s %8s %9s %7s %7s %7s %8s %6s\n", "backend", "frames/s", "chunks", "syscalls", "calls/s",
+           "p50 us", "p99 us", "p999 us", "max us", "waits");
+    run(base, IO_BACKEND_PWRITE, frames);
+    run(base, IO_BACKEND_URING, frames);
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * File: bench_kernels.c
+ * Description: SIMD aggregation kernels against the scalar path on one year
+ *              of one-minute values per node, checking every set agrees with
+ *              the scalar reference.
+ *
+ *              usage: bench_kernels [nodes] [days]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "query/kernels.h"
+
+#define HIST_BINS 64
+#define REPEAT 3
+
+typedef struct {
+    double sum;
+    float min;
+    float max;
+    size_t above;
+    uint32_t bins[HIST_BINS];
+} Result_t;
+
+typedef enum { OP_SUM, OP_MIN_MAX, OP_COUNT_ABOVE, OP_HISTOGRAM, OP_COUNT } Op_t;
+static const char *const op_names[OP_COUNT] = {"sum", "min/max", "count>25C", "histogram"};
+
+// Best of REPEAT runs over every node's column, in ns per value
+static double run_op(const AggKernels_t *k, Op_t op, float **cols, uint32_t nodes, size_t n, Result_t *r) {
+    uint64_t best = UINT64_MAX;
+
+    for (int rep = 0; rep < REPEAT; ++rep) {
+        memset(r, 0, sizeof(*r));
+        uint64_t start = Bench_NowNs();
+        for (uint32_t i = 0; i < nodes; ++i) {
+            float lo, hi;
+            switch (op) {
+            case OP_SUM:
+                r->sum += k->sum(cols[i], n);
+                break;
+            case OP_MIN_MAX:
+                k->min_max(cols[i], n, &lo, &hi);
+                r->min = i == 0 || lo < r->min ? lo : r->min;
+                r->max = i == 0 || hi > r->max ? hi : r->max;
+                break;
+            case OP_COUNT_ABOVE:
+                r->above += k->count_above(cols[i], n, 25.0f);
+                break;
+            default:
+                k->histogram(cols[i], n, -20.0f, 1.0f, r->bins, HIST_BINS);
+                break;
+            }
+        }
+        uint64_t ns = Bench_NowNs() - start;
+        best = ns < best ? ns : best;
+    }
+    return (double)best / ((double)nodes * (double)n);
+}
+
+static bool same_result(Op_t op, const Result_t *a, const Result_t *b) {
+    switch (op) {
+    case OP_SUM:
+        return fabs(a->sum - b->sum) <= 1e-9 * fabs(b->sum);
+    case OP_MIN_MAX:
+        return a->min == b->min && a->max == b->max;
+    case OP_COUNT_ABOVE:
+        return a->above == b->above;
+    default:
+        return memcmp(a->bins, b->bins, sizeof(a->bins)) == 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 100;
+    uint32_t days = argc > 2 ? (uint32_t)atoi(argv[2]) : 365;
+    size_t n = (size_t)days * 1440;
+    uint64_t rng = 7;
+    static const char *const sets[] = {"scalar", "sse2", "avx2", "neon"};
+
+    float **cols = malloc(nodes * sizeof(*cols));
+    for (uint32_t i = 0; i < nodes; ++i) {
+        cols[i] = malloc(n * sizeof(float));
+        for (size_t m = 0; m < n; ++m) {
+            double day = (double)m / 1440.0;
+            cols[i][m] = (float)(10.0 + 12.0 * sin(2.0 * M_PI * (day - 110.0) / 365.25) +
+                                 6.0 * sin(2.0 * M_PI * (day - 0.375)) + Bench_RandUnit(&rng) - 0.5);
+        }
+    }
+    printf("%u nodes x %zu values (%.0f MB), dispatch picks %s\n", nodes, n,
+           (double)nodes * (double)n * sizeof(float) / 1e6, AggKernels_Get()->name);
+
+    for (int op = 0; op < OP_COUNT; ++op) {
+        Result_t ref, r;
+        double scalar_ns = run_op(AggKernels_Scalar(), (Op_t)op, cols, nodes, n, &ref);
+
+        for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); ++s) {
+            const AggKernels_t *k = AggKernels_ByName(sets[s]);
+            if (!k) {
+                continue;
+            }
+            double ns = run_op(k, (Op_t)op, cols, nodes, n, &r);
+            printf("%-10s %-7s %6.3f ns/value  %6.2f GB/s  x%5.2f  %s\n", op_names[op], k->name, ns,
+                   sizeof(float) / ns, scalar_ns / ns, same_result((Op_t)op, &r, &ref) ? "ok" : "MISMATCH");
+        }
+    }
+
+    for (uint32_t i = 0; i < nodes; ++i) {
+        free(cols[i]);
+    }
+    free(cols);
+    return 0;
+}
@@ -0,0 +1,303 @@
+/*
+ * File: bench_mqtt.c
+ * Description: MQTT publisher against a loopback broker stand-in that accepts
+ *              a connection, answers CONNECT and acknowledges QoS 1 messages.
+ *              Each sample's timestamp carries its sequence number, so the
+ *              broker can tell which samples arrived, when, and how often.
+ *
+ *              Reports messages/s and samples/s flat out at QoS 0 and 1,
+ *              offer-to-broker latency at a paced rate, and a run with the
+ *              broker down for a second to exercise reconnect and resend.
+ *
+ *              usage: bench_mqtt [samples] [nodes] [rate_per_s]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "publish/mqtt.h"
+#include "publish/publisher.h"
+
+typedef struct {
+    int listen_fd;
+    uint16_t port;
+    pthread_t thread;
+    int stop;
+    uint64_t down_until_ns; // Stalled until then, then the connection drops
+    uint64_t n_seq;
+    uint64_t *offered_ns; // Written by the producer before the offer
+    uint64_t *arrived_ns; // 0 until first seen
+    uint64_t unique;
+    uint64_t duplicates;
+    uint64_t messages;
+    uint64_t bad;
+} Broker_t;
+
+static void broker_publish(Broker_t *b, const MqttPacket_t *pkt, uint64_t now) {
+    const char *p = (const char *)pkt->payload, *end = p + pkt->payload_len;
+
+    b->messages++;
+    // Every sample is [ts,"field",value]
+    while ((p = memmem(p, (size_t)(end - p), "[", 1)) != NULL) {
+        char *next;
+        unsigned long long seq = strtoull(++p, &next, 10);
+        if (next == p || *next != ',') {
+            continue; // The samples array itself
+        }
+        if (seq >= b->n_seq) {
+            b->bad++;
+        } else if (__atomic_load_n(&b->arrived_ns[seq], __ATOMIC_RELAXED)) {
+            b->duplicates++;
+        } else {
+            __atomic_store_n(&b->arrived_ns[seq], now, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&b->unique, 1, __ATOMIC_RELAXED);
+        }
+        p = next;
+    }
+}
+
+// Serves one connection until it closes or an outage ends
+static void broker_session(Broker_t *b, int fd) {
+    static uint8_t in[2 << 20];
+    uint8_t out[8192];
+    size_t in_len = 0;
+    bool stalled = false;
+
+    while (!__atomic_load_n(&b->stop, __ATOMIC_RELAXED)) {
+        // A hung broker: nothing is read or acknowledged, then it restarts and what was unread is lost
+        if (Bench_NowNs() < __atomic_load_n(&b->down_until_ns, __ATOMIC_RELAXED)) {
+            stalled = true;
+            usleep(20000);
+            continue;
+        }
+        if (stalled) {
+            return;
+        }
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, 20) <= 0) {
+            continue;
+        }
+        ssize_t n = recv(fd, in + in_len, sizeof(in) - in_len, 0);
+        if (n <= 0) {
+            return;
+        }
+        in_len += (size_t)n;
+
+        uint64_t now = Bench_NowNs();
+        size_t off = 0, out_len = 0;
+        MqttPacket_t pkt;
+        int used;
+        while ((used = Mqtt_Parse(in + off, in_len - off, &pkt)) > 0) {
+            off += (size_t)used;
+            if (out_len + 4 > sizeof(out)) {
+                if (send(fd, out, out_len, MSG_NOSIGNAL) != (ssize_t)out_len) {
+                    return;
+                }
+                out_len = 0;
+            }
+            switch (pkt.type) {
+            case MQTT_CONNECT:
+                out_len += Mqtt_EncodeConnack(out + out_len, sizeof(out) - out_len, 0);
+                break;
+            case MQTT_PUBLISH:
+                broker_publish(b, &pkt, now);
+                if ((pkt.flags >> 1) & 3) {
+                    out_len += Mqtt_EncodePuback(out + out_len, sizeof(out) - out_len, pkt.packet_id);
+                }
+                break;
+            case MQTT_PINGREQ:
+                out_len += Mqtt_EncodeSimple(out + out_len, sizeof(out) - out_len, MQTT_PINGRESP);
+                break;
+            case MQTT_DISCONNECT:
+                return;
+            default:
+                break;
+            }
+        }
+        if (used < 0) {
+            b->bad++;
+            return;
+        }
+        memmove(in, in + off, in_len - off);
+        in_len -= off;
+        if (out_len && send(fd, out, out_len, MSG_NOSIGNAL) != (ssize_t)out_len) {
+            return;
+        }
+    }
+}
+
+static void *broker_thread(void *arg) {
+    Broker_t *b = arg;
+
+    while (!__atomic_load_n(&b->stop, __ATOMIC_RELAXED)) {
+        struct pollfd pfd = {.fd = b->listen_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 20) <= 0) {
+            continue;
+        }
+        int fd = accept(b->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        broker_session(b, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static Broker_t *broker_start(uint64_t n_seq) {
+    Broker_t *b = calloc(1, sizeof(*b));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(addr);
+    int one = 1;
+
+    b->n_seq = n_seq;
+    b->offered_ns = calloc(n_seq, sizeof(uint64_t));
+    b->arrived_ns = calloc(n_seq, sizeof(uint64_t));
+    b->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    setsockopt(b->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (!b->offered_ns || !b->arrived_ns || bind(b->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(b->listen_fd, 16) != 0 || getsockname(b->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+        perror("broker");
+        exit(1);
+    }
+    b->port = ntohs(addr.sin_port);
+    pthread_create(&b->thread, NULL, broker_thread, b);
+    return b;
+}
+
+static void broker_stop(Broker_t *b) {
+    __atomic_store_n(&b->stop, 1, __ATOMIC_RELAXED);
+    pthread_join(b->thread, NULL);
+    close(b->listen_fd);
+    free(b->offered_ns);
+    free(b->arrived_ns);
+    free(b);
+}
+
+typedef struct {
+    const char *name;
+    uint8_t qos;
+    uint64_t samples;
+    uint32_t nodes;
+    double rate; // Samples per second, 0 for flat out
+    uint32_t interval_ms;
+    double outage_at_s; // Broker down for outage_s from then, if outage_s > 0
+    double outage_s;
+} Run_t;
+
+static void run(const Run_t *r) {
+    Broker_t *b = broker_start(r->samples);
+    PublisherConfig_t cfg;
+
+    Publisher_DefaultConfig(&cfg);
+    cfg.port = b->port;
+    cfg.qos = r->qos;
+    cfg.interval_ms = r->interval_ms;
+    cfg.queue = 1 << 16;
+    cfg.backoff_min_ms = 50;
+    cfg.backoff_max_ms = 400;
+    Publisher_t *pub = Publisher_Start(&cfg);
+    if (!pub) {
+        perror("publisher");
+        exit(1);
+    }
+    // Let it connect so the first batches do not measure the handshake
+    PublisherStats_t st;
+    do {
+        usleep(1000);
+        Publisher_GetStats(pub, &st);
+    } while (!st.connected);
+
+    uint64_t start = Bench_NowNs();
+    bool outage = r->outage_s > 0;
+    for (uint64_t seq = 0; seq < r->samples; ++seq) {
+        uint64_t now = Bench_NowNs();
+        if (r->rate > 0) {
+            uint64_t due = start + (uint64_t)((double)seq * 1e9 / r->rate);
+            while ((now = Bench_NowNs()) < due) {
+                if (due - now > 200000) {
+                    usleep(100);
+                }
+            }
+        }
+        if (outage && now - start >= (uint64_t)(r->outage_at_s * 1e9)) {
+            __atomic_store_n(&b->down_until_ns, now + (uint64_t)(r->outage_s * 1e9), __ATOMIC_RELAXED);
+            outage = false;
+        }
+        Sample_t s = {
+            .ts = (int64_t)seq, .node = 0x1000 + (uint32_t)(seq % r->nodes), .field = FIELD_TEMPERATURE, .value = 20.5f};
+        b->offered_ns[seq] = now;
+        // Flat out the bench retries instead of dropping, to measure the publisher's rate; each retry still
+        // counts as a drop in the stats
+        while (Publisher_Offer(pub, &s, 1) == 0 && r->rate == 0) {
+            sched_yield();
+        }
+    }
+    uint64_t offered_end = Bench_NowNs();
+
+    // Wait for everything the publisher still holds, up to a grace period
+    uint64_t deadline = Bench_NowNs() + (uint64_t)(r->interval_ms + 5000) * 1000000;
+    while (__atomic_load_n(&b->unique, __ATOMIC_RELAXED) < r->samples && Bench_NowNs() < deadline) {
+        usleep(1000);
+    }
+    uint64_t last = 0;
+    for (uint64_t i = 0; i < r->samples; ++i) {
+        last = b->arrived_ns[i] > last ? b->arrived_ns[i] : last;
+    }
+    Publisher_GetStats(pub, &st);
+    Publisher_Stop(pub);
+
+    uint64_t *lat = malloc(r->samples * sizeof(uint64_t));
+    size_t n_lat = 0;
+    for (uint64_t i = 0; i < r->samples; ++i) {
+        if (b->arrived_ns[i]) {
+            lat[n_lat++] = b->arrived_ns[i] - b->offered_ns[i];
+        }
+    }
+    double secs = (double)(last > offered_end ? last - start : offered_end - start) / 1e9;
+    printf("%-22s qos %u: %8.0f msg/s %9.0f samples/s  latency p50 %7.2f ms p99 %7.2f ms\n", r->name, r->qos,
+           (double)b->messages / secs, (double)b->unique / secs, (double)Bench_Percentile(lat, n_lat, 50) / 1e6,
+           (double)Bench_Percentile(lat, n_lat, 99) / 1e6);
+    printf("%-22s        delivered %llu/%llu, duplicates %llu, dropped %llu samples %llu messages, "
+           "reconnects %llu, resent %llu%s\n",
+           "", (unsigned long long)b->unique, (unsigned long long)r->samples, (unsigned long long)b->duplicates,
+           (unsigned long long)st.dropped_samples, (unsigned long long)st.dropped_messages,
+           (unsigned long long)st.reconnects, (unsigned long long)st.retransmits, b->bad ? "  MALFORMED" : "");
+    free(lat);
+    broker_stop(b);
+}
+
+int main(int argc, char **argv) {
+    uint64_t samples = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+    uint32_t nodes = argc > 2 ? (uint32_t)atoi(argv[2]) : 1000;
+    double rate = argc > 3 ? atof(argv[3]) : 20000;
+    uint64_t paced = (uint64_t)(rate * 3);
+
+    if (samples == 0 || nodes == 0 || rate <= 0) {
+        fprintf(stderr, "usage: %s [samples] [nodes] [rate_per_s]\n", argv[0]);
+        return 1;
+    }
+    // Flat out a batch fills long before the interval; paced, the interval decides latency
+    run(&(Run_t){"flat out", 0, samples, nodes, 0, 100, 0, 0});
+    run(&(Run_t){"flat out", 1, samples, nodes, 0, 100, 0, 0});
+    run(&(Run_t){"paced, 50 ms interval", 1, paced, nodes, rate, 50, 0, 0});
+    run(&(Run_t){"paced, 1 s outage", 1, paced, nodes, rate, 50, 1.0, 1.0});
+    return 0;
+}
@@ -0,0 +1,330 @@
+/*
+ * File: bench_ota.c
+ * Description: OTA rollout. The images are synthetic Cortex-M builds:
+ *              functions of skewed Thumb opcodes, each ending in a literal
+ *              pool that points at other functions. Each release recompiles a
+ *              few functions, grows one and inserts a new one, which moves
+ *              everything after it and so changes every pointer to the moved
+ *              code, as a real relink does. First, delta size and encode and
+ *              apply time per version pair, and the first offer with the
+ *              delta made, then read back after a restart. Then a fleet of
+ *              nodes on two older versions is rolled out to the newest in
+ *              the channel simulator, TDMA telemetry running throughout, with
+ *              whole images and with deltas at several throttle settings,
+ *              and once with requests sent at any time rather than between
+ *              the slots: time until half and all of the fleet run the
+ *              target, and what the transfers cost telemetry.
+ *
+ *              usage: bench_ota [nodes] [max_hours]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "ota/delta.h"
+#include "ota/ota.h"
+#include "proto/control.h"
+#include "sim/netsim.h"
+
+#define MAX_FUNCS 512
+#define FLASH_BASE 0x08000000u
+#define REFS 4
+#define VERSIONS 3
+#define WARMUP_MS (10 * 60 * 1000)
+
+typedef struct {
+    uint16_t id;
+    uint16_t refs[REFS]; // Ids of the functions its literal pool points at
+    uint32_t len;        // Code bytes, even
+    uint64_t seed;
+} Func_t;
+
+typedef struct {
+    Func_t f[MAX_FUNCS];
+    uint32_t n;
+    uint16_t next_id;
+} Program_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} Image_t;
+
+static uint16_t opcode(uint64_t *rng) {
+    // Skewed: a few instructions make up most of the code
+    double u = Bench_RandUnit(rng);
+    uint32_t idx = (uint32_t)(256.0 * u * u * u);
+    return (uint16_t)(idx * 0x9e37u ^ 0x4700u);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static Image_t link_image(const Program_t *p) {
+    uint32_t addr[UINT16_MAX + 1] = {0}, at = 0;
+    Image_t img;
+
+    for (uint32_t i = 0; i < p->n; ++i) {
+        addr[p->f[i].id] = at;
+        at += p->f[i].len + 4 * REFS;
+    }
+    img.len = at;
+    img.data = malloc(at);
+    at = 0;
+    for (uint32_t i = 0; i < p->n; ++i) {
+        const Func_t *f = &p->f[i];
+        uint64_t rng = f->seed;
+        for (uint32_t b = 0; b < f->len; b += 2) {
+            uint16_t op = opcode(&rng);
+            memcpy(img.data + at + b, &op, sizeof(op));
+        }
+        at += f->len;
+        for (int r = 0; r < REFS; ++r, at += 4) {
+            put_u32(img.data + at, (FLASH_BASE + addr[f->refs[r]]) | 1);
+        }
+    }
+    return img;
+}
+
+static void new_func(Program_t *p, Func_t *f, uint64_t *rng) {
+    f->id = p->next_id++;
+    f->len = 64 + 2 * (uint32_t)(Bench_Rand(rng) % 320);
+    f->seed = Bench_Rand(rng);
+    for (int r = 0; r < REFS; ++r) {
+        f->refs[r] = p->n ? p->f[Bench_Rand(rng) % p->n].id : f->id;
+    }
+}
+
+static void first_release(Program_t *p, uint64_t *rng) {
+    memset(p, 0, sizeof(*p));
+    for (int i = 0; i < 300; ++i) {
+        new_func(p, &p->f[p->n], rng);
+        p->n++;
+    }
+}
+
+// Four functions recompiled, one grown, one new one inserted in the middle
+static void next_release(Program_t *p, uint64_t *rng) {
+    for (int i = 0; i < 4; ++i) {
+        p->f[Bench_Rand(rng) % p->n].seed = Bench_Rand(rng);
+    }
+    p->f[Bench_Rand(rng) % p->n].len += 64; // Same seed: the old code with more at the end
+    uint32_t at = p->n / 4 + (uint32_t)(Bench_Rand(rng) % (p->n / 2));
+    Func_t f;
+    new_func(p, &f, rng);
+    memmove(&p->f[at + 1], &p->f[at], (p->n - at) * sizeof(f));
+    p->f[at] = f;
+    p->n++;
+}
+
+static void deltas(const Image_t *img) {
+    static const int pairs[][2] = {{1, 2}, {2, 3}, {1, 3}};
+
+    printf("%-8s %9s %9s %7s %10s %10s\n", "delta", "image", "delta", "ratio", "encode", "apply");
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); ++i) {
+        const Image_t *a = &img[pairs[i][0] - 1], *b = &img[pairs[i][1] - 1];
+        uint8_t *out = malloc(b->len), *d = NULL;
+        size_t len = 0;
+        uint64_t enc = UINT64_MAX, app = UINT64_MAX;
+        for (int rep = 0; rep < 5; ++rep) {
+            free(d);
+            uint64_t t0 = Bench_NowNs();
+            Delta_Encode(a->data, a->len, b->data, b->len, &d, &len);
+            uint64_t t1 = Bench_NowNs();
+            ptrdiff_t n = Delta_Apply(a->data, a->len, d, len, out, b->len);
+            uint64_t t2 = Bench_NowNs();
+            if (n != (ptrdiff_t)b->len || memcmp(out, b->data, b->len) != 0) {
+                fprintf(stderr, "delta %d->%d does not rebuild the image\n", pairs[i][0], pairs[i][1]);
+                exit(1);
+            }
+            enc = t1 - t0 < enc ? t1 - t0 : enc;
+            app = t2 - t1 < app ? t2 - t1 : app;
+        }
+        char name[16];
+        snprintf(name, sizeof(name), "v%d->v%d", pairs[i][0], pairs[i][1]);
+        printf("%-8s %9zu %9zu %6.1fx %8.2f ms %8.3f ms\n", name, b->len, len, (double)b->len / (double)len,
+               (double)enc / 1e6, (double)app / 1e6);
+        free(d);
+        free(out);
+    }
+}
+
+static OtaServer_t *open_server(const char *dir, const OtaConfig_t *cfg, const Image_t *img) {
+    OtaServer_t *ota = Ota_Open(dir, cfg);
+
+    for (int v = 0; ota && v < VERSIONS; ++v) {
+        if (Ota_AddBuild(ota, (uint16_t)(v + 1), img[v].data, img[v].len) != 0) {
+            Ota_Close(ota);
+            return NULL;
+        }
+    }
+    if (!ota || Ota_SetTarget(ota, VERSIONS) != 0) {
+        perror("ota");
+        exit(1);
+    }
+    return ota;
+}
+
+// First offer to a node on v1: the delta is made, or read back from an earlier run
+static void restart(const Image_t *img) {
+    char *dir = Bench_TempDir(NULL, "bench_ota");
+    OtaConfig_t cfg;
+    Ota_DefaultConfig(&cfg);
+
+    for (int run = 0; run < 2; ++run) {
+        OtaServer_t *ota = open_server(dir, &cfg, img);
+        FrameOta_t req = {.version = 1, .fetching = 0, .offset = FRAME_OTA_STATUS};
+        DownlinkMsg_t msg;
+        OtaStats_t st;
+        ControlOtaOffer_t offer;
+        uint64_t t0 = Bench_NowNs();
+        int rc = Ota_Request(ota, 1, &req, 0, &msg);
+        uint64_t dt = Bench_NowNs() - t0;
+        Ota_GetStats(ota, &st);
+        if (rc != 1 || Control_DecodeOtaOffer(msg.payload, msg.len, &offer) != 0) {
+            fprintf(stderr, "no offer\n");
+            exit(1);
+        }
+        printf("first offer %s: %7.2f ms, %u byte %s, deltas made %llu\n", run ? "after restart" : "from scratch ",
+               (double)dt / 1e6, offer.transfer_len, offer.flags & CONTROL_OTA_DELTA ? "delta" : "image",
+               (unsigned long long)st.delta_made);
+        Ota_Close(ota);
+    }
+    Bench_RemoveDir(dir);
+}
+
+typedef struct {
+    const char *name;
+    uint32_t max_active;
+    uint32_t chunk_rate;
+    uint32_t min_saving; // 100: whole images only
+    bool between_slots;
+    bool rollout;
+} Scenario_t;
+
+static void rollout(const Scenario_t *sc, uint32_t nodes, const Image_t *img, const uint16_t *versions,
+                    double max_hours) {
+    char *dir = Bench_TempDir(NULL, "bench_ota");
+    OtaConfig_t ota_cfg;
+    Ota_DefaultConfig(&ota_cfg);
+    ota_cfg.max_active = sc->max_active;
+    ota_cfg.chunk_rate = sc->chunk_rate;
+    ota_cfg.min_saving = sc->min_saving;
+    ota_cfg.slot_ms = sc->between_slots ? 10 : 0;
+    ota_cfg.expected_nodes = nodes;
+    OtaServer_t *ota = open_server(dir, &ota_cfg, img);
+    if (!sc->rollout) {
+        Ota_SetTarget(ota, 0);
+    }
+
+    NetsimConfig_t cfg;
+    Netsim_DefaultConfig(&cfg);
+    cfg.nodes = nodes;
+    cfg.mode = NETSIM_TDMA;
+    cfg.ota = ota;
+    cfg.versions = versions;
+    Netsim_t *sim = Netsim_Create(&cfg);
+    if (!sim) {
+        fprintf(stderr, "netsim: out of memory\n");
+        exit(1);
+    }
+    NetsimStats_t a, b;
+    OtaStats_t st;
+    double half = -1, all = -1, minutes = 0;
+    uint64_t t0 = Bench_NowNs();
+
+    Netsim_Run(sim, WARMUP_MS);
+    Netsim_GetStats(sim, &a);
+    for (;;) {
+        if (Netsim_Run(sim, 60000) != 0) {
+            fprintf(stderr, "netsim: out of memory\n");
+            exit(1);
+        }
+        minutes++;
+        Ota_GetStats(ota, &st);
+        if (half < 0 && st.current * 2 >= nodes) {
+            half = minutes / 60;
+        }
+        if (st.current == nodes || minutes >= max_hours * 60 || (!sc->rollout && minutes >= 60)) {
+            all = st.current == nodes ? minutes / 60 : -1;
+            break;
+        }
+    }
+    Netsim_GetStats(sim, &b);
+
+    uint64_t reports = b.reports - a.reports, delivered = b.delivered - a.delivered;
+    uint64_t attempts = b.attempts - a.attempts, collided = b.collided - a.collided;
+    char h50[16] = "-", h100[16] = "-";
+    if (sc->rollout && half >= 0) {
+        snprintf(h50, sizeof(h50), "%.2f h", half);
+    }
+    if (sc->rollout) {
+        snprintf(h100, sizeof(h100), all >= 0 ? "%.2f h" : "> %.0f h", all >= 0 ? all : max_hours);
+    }
+    printf("%-34s %8s %9s %9.3f%% %8.3f%% %7.2f%% %9llu %9llu %5llu %6.1fs\n", sc->name, h50, h100,
+           100.0 * (double)delivered / (double)reports, 100.0 * (double)collided / (double)attempts,
+           100.0 * (double)(b.busy_us - a.busy_us) / (minutes * 60e6), (unsigned long long)st.chunks,
+           (unsigned long long)st.throttled, (unsigned long long)b.bad_images,
+           (double)(Bench_NowNs() - t0) / 1e9);
+    Netsim_Destroy(sim);
+    Ota_Close(ota);
+    Bench_RemoveDir(dir);
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000;
+    double max_hours = argc > 2 ? atof(argv[2]) : 96;
+
+    if (nodes == 0 || max_hours <= 0) {
+        fprintf(stderr, "usage: %s [nodes] [max_hours]\n", argv[0]);
+        return 1;
+    }
+    static Program_t prog;
+    Image_t img[VERSIONS];
+    uint64_t rng = 42;
+    first_release(&prog, &rng);
+    for (int v = 0; v < VERSIONS; ++v) {
+        if (v > 0) {
+            next_release(&prog, &rng);
+        }
+        img[v] = link_image(&prog);
+    }
+    deltas(img);
+    restart(img);
+
+    // 70% of the fleet two releases behind, the rest one
+    uint16_t *versions = malloc(nodes * sizeof(*versions));
+    for (uint32_t i = 0; i < nodes; ++i) {
+        versions[i] = Bench_Rand(&rng) % 10 < 7 ? 1 : 2;
+    }
+    static const Scenario_t scenarios[] = {
+        {"no rollout", 10, 20, 25, true, false},
+        {"image, 10 x 20 chunk/s", 10, 20, 100, true, true},
+        {"delta, 10 x 20 chunk/s, any time", 10, 20, 25, false, true},
+        {"delta, 10 x 20 chunk/s", 10, 20, 25, true, true},
+        {"delta, 30 x 60 chunk/s", 30, 60, 25, true, true},
+        {"delta, 100 x 200 chunk/s", 100, 200, 25, true, true},
+    };
+    printf("\n%u TDMA nodes every 10 s, v1 70%% and v2 30%% rolled out to v3 (%zu bytes), 24 byte chunks\n", nodes,
+           img[VERSIONS - 1].len);
+    printf("%-34s %8s %9s %10s %9s %8s %9s %9s %5s %7s\n", "active x rate", "half", "all", "telemetry", "collided",
+           "on air", "chunks", "throttled", "bad", "wall");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        rollout(&scenarios[i], nodes, img, versions, max_hours);
+    }
+    for (int v = 0; v < VERSIONS; ++v) {
+        free(img[v].data);
+    }
+    free(versions);
+    return 0;
+}
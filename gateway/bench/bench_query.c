@@ -0,0 +1,291 @@
+/*
+ * File: bench_query.c
+ * Description: Query latency over a multi-year one-minute dataset generated
+ *              on the host. Reports p50/p99 per query shape through the API
+ *              and through the Unix socket service.
+ *
+ *              usage: bench_query [nodes] [years] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Threshold count and histogram shapes.
+ *
+ */
+#include "bench.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "query/query.h"
+#include "query/server.h"
+#include "rollup/rollup.h"
+#include "storage/store.h"
+
+#define QUERIES 400
+#define T0 1704067200000LL // 2024-01-01
+
+static float synth_value(uint32_t node, uint8_t field, int64_t minute, uint64_t *rng) {
+    double day = (double)minute / 1440.0;
+    double season = sin(2.0 * M_PI * (day - 110.0) / 365.25);
+    double daily = sin(2.0 * M_PI * (day - 0.375));
+    double noise = Bench_RandUnit(rng) - 0.5;
+
+    switch (field) {
+    case FIELD_TEMPERATURE:
+        return (float)(10.0 + 12.0 * season + 6.0 * daily + noise + (double)(node % 5));
+    case FIELD_HUMIDITY:
+        return (float)(65.0 - 15.0 * daily + 4.0 * noise);
+    case FIELD_PRESSURE:
+        return (float)(1013.0 + 12.0 * sin(2.0 * M_PI * day / 9.0) + noise);
+    default:
+        return (float)(3.7 - 0.4 * day / 730.0 + 0.01 * noise);
+    }
+}
+
+static int count_point(int64_t ts, float value, void *ctx) {
+    (void)ts;
+    (void)value;
+    (*(uint64_t *)ctx)++;
+    return 0;
+}
+
+static int count_bucket(const SeriesBucket_t *b, void *ctx) {
+    (void)b;
+    (*(uint64_t *)ctx)++;
+    return 0;
+}
+
+typedef enum {
+    SHAPE_LATEST,
+    SHAPE_RAW_1H,
+    SHAPE_RAW_1D,
+    SHAPE_HOURLY_1Y,
+    SHAPE_AGG_1D,
+    SHAPE_AGG_30D,
+    SHAPE_AGG_1Y,
+    SHAPE_AGG_ALL,
+    SHAPE_RAW_30D_FILTER,
+    SHAPE_ABOVE_30D,
+    SHAPE_HIST_30D,
+    SHAPE_COUNT,
+} Shape_t;
+
+static const char *const shape_names[SHAPE_COUNT] = {
+    "latest", "range raw 1h", "range raw 1d", "range 1h buckets 1y", "agg 1d",
+    "agg 30d", "agg 1y", "agg all", "range raw 30d, t>30C", "count t>30C 30d", "histogram 30d",
+};
+
+static void run_shape(QueryEngine_t *q, Shape_t shape, uint32_t nodes, int64_t span, uint64_t *rng) {
+    uint64_t lat[QUERIES];
+    uint64_t results = 0;
+    QueryStats_t st;
+
+    Query_ResetStats(q);
+    for (int i = 0; i < QUERIES; ++i) {
+        uint32_t node = 1 + (uint32_t)(Bench_Rand(rng) % nodes);
+        bool temperature = shape == SHAPE_RAW_30D_FILTER || shape == SHAPE_ABOVE_30D || shape == SHAPE_HIST_30D;
+        uint8_t field = temperature ? FIELD_TEMPERATURE : (uint8_t)(Bench_Rand(rng) % FIELD_COUNT);
+        int64_t len = 0;
+        switch (shape) {
+        case SHAPE_RAW_1H:
+            len = SERIES_MS_PER_HOUR;
+            break;
+        case SHAPE_RAW_1D:
+        case SHAPE_AGG_1D:
+            len = SERIES_MS_PER_DAY;
+            break;
+        case SHAPE_AGG_30D:
+        case SHAPE_RAW_30D_FILTER:
+        case SHAPE_ABOVE_30D:
+        case SHAPE_HIST_30D:
+            len = 30 * SERIES_MS_PER_DAY;
+            break;
+        case SHAPE_HOURLY_1Y:
+        case SHAPE_AGG_1Y:
+            len = 365 * SERIES_MS_PER_DAY;
+            break;
+        default:
+            len = span;
+            break;
+        }
+        if (len > span) {
+            len = span;
+        }
+        int64_t from = T0 + (int64_t)(Bench_Rand(rng) % (uint64_t)(span - len + 1));
+        int64_t to = from + len;
+        QueryFilter_t hot = {.enabled = true, .min = 30.0f, .max = 1e9f};
+        SeriesBucket_t agg;
+        uint32_t bins[40] = {0};
+        uint64_t above;
+        int64_t ts;
+        float value;
+
+        uint64_t start = Bench_NowNs();
+        switch (shape) {
+        case SHAPE_LATEST:
+            results += (uint64_t)Query_Latest(q, node, field, &ts, &value);
+            break;
+        case SHAPE_RAW_1H:
+        case SHAPE_RAW_1D:
+            Query_Range(q, node, field, from, to, NULL, count_point, &results);
+            break;
+        case SHAPE_RAW_30D_FILTER:
+            Query_Range(q, node, field, from, to, &hot, count_point, &results);
+            break;
+        case SHAPE_ABOVE_30D:
+            Query_CountAbove(q, node, field, from, to, 30.0f, &above);
+            results += above;
+            break;
+        case SHAPE_HIST_30D:
+            Query_Histogram(q, node, field, from, to, -20.0f, 2.0f, bins, 40);
+            results += 40;
+            break;
+        case SHAPE_HOURLY_1Y:
+            Query_RangeBuckets(q, node, field, SERIES_RES_1H, from, to, NULL, count_bucket, &results);
+            break;
+        default:
+            Query_Aggregate(q, node, field, from, to, &agg);
+            results += agg.count;
+            break;
+        }
+        lat[i] = Bench_NowNs() - start;
+    }
+    Query_GetStats(q, &st);
+    printf("%-22s p50 %8.1f us  p99 %8.1f us  results/query %9.0f  chunks read %6.1f pruned %6.1f\n",
+           shape_names[shape], Bench_Percentile(lat, QUERIES, 50) / 1e3, Bench_Percentile(lat, QUERIES, 99) / 1e3,
+           (double)results / QUERIES, (double)st.chunks_read / QUERIES, (double)st.chunks_pruned / QUERIES);
+}
+
+static int socket_roundtrip(int fd, const char *req, char *buf, size_t cap) {
+    if (write(fd, req, strlen(req)) < 0) {
+        return -1;
+    }
+    size_t len = 0;
+    long lines = -1;
+    for (;;) {
+        ssize_t n = read(fd, buf + len, cap - 1 - len);
+        if (n <= 0) {
+            return -1;
+        }
+        len += (size_t)n;
+        buf[len] = '\0';
+        char *nl = strchr(buf, '\n');
+        if (!nl) {
+            continue;
+        }
+        if (lines < 0) {
+            lines = strncmp(buf, "OK ", 3) == 0 ? strtol(buf + 3, NULL, 10) : 0;
+        }
+        long seen = 0;
+        for (char *p = buf; (p = strchr(p, '\n')) != NULL; ++p) {
+            seen++;
+        }
+        if (seen >= lines + 1) {
+            return 0;
+        }
+    }
+}
+
+static void run_socket(const char *path, uint32_t nodes, int64_t span, uint64_t *rng) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    uint64_t lat[QUERIES];
+    char buf[4096], req[128];
+
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        return;
+    }
+    int64_t len = span < 365 * SERIES_MS_PER_DAY ? span : 365 * SERIES_MS_PER_DAY;
+    for (int i = 0; i < QUERIES; ++i) {
+        int64_t from = T0 + (int64_t)(Bench_Rand(rng) % (uint64_t)(span - len + 1));
+        snprintf(req, sizeof(req), "AGG %u %u %lld %lld\n", 1 + (uint32_t)(Bench_Rand(rng) % nodes),
+                 (unsigned)(Bench_Rand(rng) % FIELD_COUNT), (long long)from, (long long)(from + len));
+        uint64_t start = Bench_NowNs();
+        if (socket_roundtrip(fd, req, buf, sizeof(buf)) != 0) {
+            fprintf(stderr, "socket query failed\n");
+            break;
+        }
+        lat[i] = Bench_NowNs() - start;
+    }
+    close(fd);
+    printf("%-22s p50 %8.1f us  p99 %8.1f us\n", "socket agg 1y", Bench_Percentile(lat, QUERIES, 50) / 1e3,
+           Bench_Percentile(lat, QUERIES, 99) / 1e3);
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 10;
+    double years = argc > 2 ? atof(argv[2]) : 2.0;
+    char *dir = Bench_TempDir(argc > 3 ? argv[3] : NULL, "bench_query");
+    uint64_t rng = 42;
+    int64_t minutes = (int64_t)(years * 365.0 * 1440.0);
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    SeriesStore_t *store = SeriesStore_Open(dir, NULL);
+    RollupEngine_t *rollup = store ? Rollup_Create(store, NULL) : NULL;
+    if (!rollup) {
+        fprintf(stderr, "cannot open store in %s\n", dir);
+        return 1;
+    }
+    uint64_t start = Bench_NowNs();
+    for (int64_t m = 0; m < minutes; ++m) {
+        for (uint32_t n = 1; n <= nodes; ++n) {
+            for (uint8_t f = 0; f < FIELD_COUNT; ++f) {
+                Sample_t s = {
+                    .ts = T0 + m * SERIES_MS_PER_MINUTE + (int64_t)(n % 60) * 1000,
+                    .node = n,
+                    .field = f,
+                    .value = synth_value(n, f, m, &rng),
+                };
+                SeriesStore_AppendSample(store, &s);
+                Rollup_AddSample(rollup, &s);
+            }
+        }
+    }
+    Rollup_Destroy(rollup);
+    SeriesStore_Close(store);
+    printf("generated %lld samples (%u nodes, %.1f years) in %.1f s\n",
+           (long long)minutes * nodes * FIELD_COUNT, nodes, years, (double)(Bench_NowNs() - start) / 1e9);
+
+    start = Bench_NowNs();
+    store = SeriesStore_Open(dir, NULL);
+    rollup = store ? Rollup_Create(store, NULL) : NULL;
+    if (!rollup) {
+        fprintf(stderr, "cannot reopen store\n");
+        return 1;
+    }
+    printf("reopened in %.1f ms, %llu chunks indexed\n", (double)(Bench_NowNs() - start) / 1e6,
+           (unsigned long long)SeriesStore_ChunkCount(store));
+
+    QueryEngine_t *q = Query_Create(store, rollup);
+    int64_t span = minutes * SERIES_MS_PER_MINUTE;
+    for (int s = 0; s < SHAPE_COUNT; ++s) {
+        run_shape(q, (Shape_t)s, nodes, span, &rng);
+    }
+    Query_Destroy(q);
+
+    char sock[600];
+    snprintf(sock, sizeof(sock), "%s/query.sock", dir);
+    QueryServer_t *server = QueryServer_Start(sock, store, rollup);
+    if (server) {
+        run_socket(sock, nodes, span, &rng);
+        QueryServer_Stop(server);
+    }
+
+    Rollup_Destroy(rollup);
+    SeriesStore_Close(store);
+    Bench_RemoveDir(dir);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * File: bench_registry.c
+ * Description: Node registry lookup cost and restart time. Fills the registry
+ *              with a fleet, measures hit and miss lookups in random order and
+ *              the per-frame path (lookup + duplicate window), then saves a
+ *              snapshot and compares restarting by mapping it against
+ *              rebuilding the table key by key.
+ *
+ *              usage: bench_registry [nodes] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <sys/stat.h>
+
+#include "registry/registry.h"
+
+#define LOOKUPS 4000000
+
+static uint32_t node_address(uint32_t i) {
+    return 0x10000000u + i * 7919u; // Sparse like real addresses
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 50000;
+    char *dir = Bench_TempDir(argc > 2 ? argv[2] : NULL, "bench_registry");
+    uint64_t rng = 0x243F6A8885A308D3ull;
+    char path[600];
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/nodes.snap", dir);
+    uint32_t *order = malloc(LOOKUPS * sizeof(*order));
+    for (uint32_t i = 0; i < LOOKUPS; ++i) {
+        order[i] = (uint32_t)(Bench_Rand(&rng) % nodes);
+    }
+
+    NodeRegistry_t *registry = Registry_Create(1024); // Grows as a live gateway would
+    uint64_t t = Bench_NowNs();
+    for (uint32_t i = 0; i < nodes; ++i) {
+        int32_t slot = Registry_Upsert(registry, node_address(i));
+        Registry_Cold(registry, slot)->fw_version = 0x010200 + i % 3;
+    }
+    printf("%u nodes: insert %.1f ns/node\n", nodes, (double)(Bench_NowNs() - t) / nodes);
+
+    uint64_t sink = 0;
+    t = Bench_NowNs();
+    for (uint32_t i = 0; i < LOOKUPS; ++i) {
+        sink += (uint64_t)Registry_Find(registry, node_address(order[i]));
+    }
+    printf("lookup hit     %6.1f ns\n", (double)(Bench_NowNs() - t) / LOOKUPS);
+    t = Bench_NowNs();
+    for (uint32_t i = 0; i < LOOKUPS; ++i) {
+        sink += (uint64_t)Registry_Find(registry, node_address(order[i]) + 1);
+    }
+    printf("lookup miss    %6.1f ns\n", (double)(Bench_NowNs() - t) / LOOKUPS);
+    t = Bench_NowNs();
+    for (uint32_t i = 0; i < LOOKUPS; ++i) {
+        uint32_t skipped;
+        NodeHot_t *hot = Registry_Hot(registry, Registry_Upsert(registry, node_address(order[i])));
+        sink += DedupWindow_Check(&hot->window, (uint16_t)(hot->frames++), &skipped);
+    }
+    printf("frame path     %6.1f ns  (lookup + duplicate window)\n", (double)(Bench_NowNs() - t) / LOOKUPS);
+
+    t = Bench_NowNs();
+    if (Registry_Save(registry, path) != 0) {
+        perror(path);
+        return 1;
+    }
+    struct stat st;
+    stat(path, &st);
+    printf("save           %6.1f ms  %.1f MB\n", (double)(Bench_NowNs() - t) / 1e6, (double)st.st_size / 1e6);
+    Registry_Destroy(registry);
+
+    t = Bench_NowNs();
+    registry = Registry_Load(path);
+    double load_ms = (double)(Bench_NowNs() - t) / 1e6;
+    if (!registry || Registry_Count(registry) != nodes) {
+        fprintf(stderr, "snapshot did not load\n");
+        return 1;
+    }
+    t = Bench_NowNs();
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < nodes; ++i) {
+        int32_t slot = Registry_Find(registry, node_address(i));
+        found += slot != REGISTRY_NO_SLOT && Registry_Cold(registry, slot)->fw_version == 0x010200 + i % 3;
+    }
+    double touch_ms = (double)(Bench_NowNs() - t) / 1e6;
+    printf("restart mmap   %6.2f ms  + %.2f ms to touch every node (%s)\n", load_ms, touch_ms,
+           found == nodes ? "ok" : "MISMATCH");
+
+    // What a restart costs without the snapshot layout: re-insert every node
+    t = Bench_NowNs();
+    NodeRegistry_t *rebuilt = Registry_Create(1024);
+    for (int32_t s = Registry_Next(registry, REGISTRY_NO_SLOT); s != REGISTRY_NO_SLOT; s = Registry_Next(registry, s)) {
+        int32_t slot = Registry_Upsert(rebuilt, Registry_Node(registry, s));
+        *Registry_Hot(rebuilt, slot) = *Registry_Hot(registry, s);
+        *Registry_Cold(rebuilt, slot) = *Registry_Cold(registry, s);
+    }
+    printf("restart rebuild %5.2f ms\n", (double)(Bench_NowNs() - t) / 1e6);
+
+    Registry_Destroy(rebuilt);
+    Registry_Destroy(registry);
+    Bench_RemoveDir(dir);
+    free(order);
+    return sink == 42 ? 2 : 0;
+}
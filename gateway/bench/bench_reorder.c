@@ -0,0 +1,118 @@
+/*
+ * File: bench_reorder.c
+ * Description: Ingest with the reorder stage at several lateness windows
+ *              under the fleet load generator, with frames delayed past the
+ *              next report and store-and-forward backlogs. Reports ingest
+ *              cost per frame, reorder memory, samples sent down the late
+ *              merge path and how many samples still reached storage out of
+ *              order for their node.
+ *
+ *              usage: bench_reorder [frames] [nodes] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include "pipeline/ingest.h"
+#include "sim/fleet.h"
+
+typedef struct {
+    int64_t *last_ts; // Newest stored timestamp per node
+    uint32_t nodes;
+    uint64_t inversions;
+} OrderCheck_t;
+
+static void check_order(void *ctx, const Sample_t *samples, size_t n) {
+    OrderCheck_t *oc = ctx;
+
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t idx = samples[i].node - 0x1000;
+        if (idx >= oc->nodes) {
+            continue;
+        }
+        if (samples[i].ts < oc->last_ts[idx]) {
+            oc->inversions++;
+        } else {
+            oc->last_ts[idx] = samples[i].ts;
+        }
+    }
+}
+
+static void run(const char *base, uint64_t frames, uint32_t nodes, uint32_t lateness_ms) {
+    char *dir = Bench_TempDir(base, "bench_reorder");
+    FleetConfig_t fc;
+    IngestConfig_t cfg;
+    OrderCheck_t oc = {calloc(nodes, sizeof(int64_t)), nodes, 0};
+
+    if (!dir || !oc.last_ts) {
+        perror("setup");
+        exit(1);
+    }
+    Fleet_DefaultConfig(&fc);
+    fc.nodes = nodes;
+    fc.reorder = 0.05;
+    fc.reorder_max_ms = 25000; // Up to two and a half report intervals
+    fc.backlog = 0.002;
+    fc.backlog_frames = 16;
+    Fleet_t *fleet = Fleet_Create(&fc, 1760000000000);
+    Ingest_DefaultConfig(&cfg);
+    cfg.wal.sync = WAL_SYNC_NONE;
+    cfg.expected_nodes = nodes;
+    cfg.reorder.lateness_ms = lateness_ms;
+    Ingest_t *ingest = Ingest_Open(dir, &cfg);
+    if (!fleet || !ingest || Ingest_AddTap(ingest, check_order, &oc) != 0) {
+        perror(dir);
+        exit(1);
+    }
+
+    ReorderStats_t rs = {0};
+    uint64_t peak_bytes = 0, peak_held = 0;
+    int64_t next_tick = 0;
+    uint64_t start = Bench_NowNs();
+    for (uint64_t i = 0; i < frames; ++i) {
+        Frame_t frame;
+        Fleet_Next(fleet, &frame);
+        Ingest_Frame(ingest, &frame);
+        if (frame.rx_ts >= next_tick) {
+            Ingest_Tick(ingest, frame.rx_ts);
+            next_tick = frame.rx_ts + 1000;
+            if (Ingest_GetReorderStats(ingest, &rs) == 0) {
+                peak_bytes = rs.bytes > peak_bytes ? rs.bytes : peak_bytes;
+                peak_held = rs.held > peak_held ? rs.held : peak_held;
+            }
+        }
+    }
+    double ns = (double)(Bench_NowNs() - start) / (double)frames;
+    IngestStats_t st;
+    Ingest_GetStats(ingest, &st);
+    Ingest_GetReorderStats(ingest, &rs);
+
+    printf("lateness %5.1f s: %6.0f ns/frame, peak %5.1f KB (%llu samples held), late path %6llu, forced %llu, "
+           "out of order in storage %llu\n",
+           lateness_ms / 1e3, ns, (double)peak_bytes / 1024, (unsigned long long)peak_held,
+           (unsigned long long)st.out_of_window, (unsigned long long)rs.forced, (unsigned long long)oc.inversions);
+    Ingest_Close(ingest);
+    Fleet_Destroy(fleet);
+    free(oc.last_ts);
+    Bench_RemoveDir(dir);
+}
+
+int main(int argc, char **argv) {
+    uint64_t frames = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint32_t nodes = argc > 2 ? (uint32_t)atoi(argv[2]) : 10000;
+    const char *base = argc > 3 ? argv[3] : "/dev/shm";
+    static const uint32_t lateness[] = {0, 5000, 15000, 30000, 60000};
+
+    printf("%llu frames from %u nodes reporting every 10 s, 5%% delayed up to 25 s, backlogs of 16\n",
+           (unsigned long long)frames, nodes);
+    for (size_t i = 0; i < sizeof(lateness) / sizeof(lateness[0]); ++i) {
+        run(base, frames, nodes, lateness[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * File: bench_restart.c
+ * Description: Gateway restart time against the size of the series store.
+ *              Fills a store with the given gigabytes of raw samples from a
+ *              fleet, checkpoints its index and then, with the page cache
+ *              dropped before each run, times
+ *
+ *                  scan     reading every segment, as an open without
+ *                           footers or an index checkpoint has to
+ *                  footers  SeriesStore_Open with index.snap removed
+ *                  index    SeriesStore_Open from footers and index.snap
+ *                  ingest   Ingest_Open of the same directory, WAL and
+ *                           final checkpoint included
+ *
+ *              usage: bench_restart [gb ...] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+
+#include "pipeline/ingest.h"
+#include "storage/store.h"
+
+#define NODES 2000
+#define INTERVAL_MS 60000
+#define T0 1704067200000LL // 2024-01-01
+
+typedef struct {
+    uint64_t chunks;
+    uint64_t bytes;
+} ScanCount_t;
+
+static int evict_file(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (type == FTW_F) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+    return 0;
+}
+
+// Everything was synced, so the pages are clean and can be dropped
+static void evict(const char *dir) {
+    nftw(dir, evict_file, 16, FTW_PHYS);
+}
+
+static int count_chunk(const ChunkHeader_t *hdr, const ChunkLocation_t *loc, void *ctx) {
+    ScanCount_t *count = ctx;
+    (void)loc;
+    count->chunks++;
+    count->bytes += Chunk_TotalSize(hdr);
+    return 0;
+}
+
+static int fill(const char *dir, double gb, uint64_t *samples) {
+    SeriesStore_t *store = SeriesStore_Open(dir, NULL);
+    uint64_t target = (uint64_t)(gb * (double)(1ull << 30)), rng = 7;
+    int rc = 0;
+
+    if (!store) {
+        perror("open");
+        return -1;
+    }
+    *samples = 0;
+    for (int64_t ts = T0; rc == 0; ts += INTERVAL_MS) {
+        for (uint32_t n = 0; n < NODES && rc == 0; ++n) {
+            for (uint8_t f = 0; f < FIELD_COUNT && rc == 0; ++f) {
+                Sample_t s = {ts + n, 0x1000 + n, f, (float)(20.0 + Bench_RandUnit(&rng))};
+                rc = SeriesStore_AppendSample(store, &s);
+            }
+        }
+        *samples += NODES * FIELD_COUNT;
+        if (*samples % (NODES * FIELD_COUNT * 100ull) == 0) {
+            StoreMark_t mark;
+            SeriesStore_GetMark(store, &mark);
+            uint64_t written = (mark.segment[SERIES_RES_RAW] - 1) * (64ull << 20) + mark.offset[SERIES_RES_RAW];
+            if (written >= target) {
+                break;
+            }
+        }
+    }
+    if (rc != 0 || SeriesStore_Flush(store) != 0 || SeriesStore_Sync(store) != 0 || SeriesStore_SaveIndex(store) != 0) {
+        perror("fill");
+        rc = -1;
+    }
+    SeriesStore_Close(store);
+    return rc;
+}
+
+static int run(const char *base, double gb) {
+    char *dir = Bench_TempDir(base, "bench_restart");
+    char snap[600], keep[600];
+    uint64_t samples, start;
+    ScanCount_t count = {0};
+    IngestConfig_t cfg;
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    start = Bench_NowNs();
+    if (fill(dir, gb, &samples) != 0) {
+        Bench_RemoveDir(dir);
+        return 1;
+    }
+    double fill_s = (double)(Bench_NowNs() - start) / 1e9;
+    snprintf(snap, sizeof(snap), "%s/index.snap", dir);
+    snprintf(keep, sizeof(keep), "%s/index.keep", dir);
+
+    // Reading all of it, as the open did before segments had footers
+    evict(dir);
+    SeriesStore_t *store = SeriesStore_Open(dir, NULL);
+    start = Bench_NowNs();
+    for (uint8_t r = 0; store && r < SERIES_RES_COUNT; ++r) {
+        SeriesStore_ScanChunks(store, r, count_chunk, &count);
+    }
+    double scan_ms = (double)(Bench_NowNs() - start) / 1e6;
+    SeriesStore_Close(store);
+
+    evict(dir);
+    rename(snap, keep);
+    start = Bench_NowNs();
+    store = SeriesStore_Open(dir, NULL);
+    double footers_ms = (double)(Bench_NowNs() - start) / 1e6;
+    uint64_t footer_chunks = store ? SeriesStore_ChunkCount(store) : 0;
+    SeriesStore_Close(store);
+    rename(keep, snap);
+
+    evict(dir);
+    start = Bench_NowNs();
+    store = SeriesStore_Open(dir, NULL);
+    double index_ms = (double)(Bench_NowNs() - start) / 1e6;
+    uint64_t index_chunks = store ? SeriesStore_ChunkCount(store) : 0;
+    SeriesStore_Close(store);
+
+    evict(dir);
+    Ingest_DefaultConfig(&cfg);
+    cfg.expected_nodes = NODES;
+    start = Bench_NowNs();
+    Ingest_t *ingest = Ingest_Open(dir, &cfg);
+    double ingest_ms = (double)(Bench_NowNs() - start) / 1e6;
+    uint64_t ingest_chunks = ingest ? SeriesStore_ChunkCount(Ingest_Store(ingest)) : 0;
+    Ingest_Close(ingest);
+
+    printf("%5.1f %8.1f %10llu %8.1f %10.1f %10.1f %10.1f %10.1f\n", (double)count.bytes / (double)(1ull << 30),
+           (double)samples / 1e6, (unsigned long long)count.chunks, fill_s, scan_ms, footers_ms, index_ms, ingest_ms);
+    Bench_RemoveDir(dir);
+    if (footer_chunks != count.chunks || index_chunks != count.chunks || ingest_chunks != count.chunks) {
+        fprintf(stderr, "chunk counts differ: scan %llu, footers %llu, index %llu, ingest %llu\n",
+                (unsigned long long)count.chunks, (unsigned long long)footer_chunks,
+                (unsigned long long)index_chunks, (unsigned long long)ingest_chunks);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *base = NULL;
+    double sizes[8] = {1, 10};
+    int n = 2, rc = 0;
+
+    // Numbers are sizes in gigabytes, anything else the directory to work in
+    if (argc > 1) {
+        n = 0;
+        for (int i = 1; i < argc; ++i) {
+            char *end;
+            double gb = strtod(argv[i], &end);
+            if (*end == '\0' && gb > 0 && n < 8) {
+                sizes[n++] = gb;
+            } else {
+                base = argv[i];
+            }
+        }
+        if (n == 0) {
+            sizes[n++] = 1;
+        }
+    }
+    printf("%5s %8s %10s %8s %10s %10s %10s %10s\n", "GB", "Msamples", "chunks", "fill s", "scan ms", "footers ms",
+           "index ms", "ingest ms");
+    for (int i = 0; i < n; ++i) {
+        rc |= run(base, sizes[i]);
+    }
+    return rc;
+}
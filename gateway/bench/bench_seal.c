@@ -0,0 +1,276 @@
+/*
+ * File: bench_seal.c
+ * Description: Verification and decryption of sealed frames from a fleet of
+ *              nodes with their own keys, for every AES backend the CPU has.
+ *              Compares the per-frame path the gateway used to take (key
+ *              schedule from the raw key, then Frame_Unseal) with cached
+ *              expanded keys, and with Frame_UnsealBatch fed from the key
+ *              cache, single threaded and on worker threads. Ends with the
+ *              whole ingest path, one frame at a time against Ingest_Frames.
+ *
+ *              usage: bench_seal [nodes] [frames] [dir]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pipeline/ingest.h"
+#include "pipeline/keycache.h"
+#include "proto/seal.h"
+
+typedef struct {
+    uint32_t nodes;
+    size_t frames;
+    uint8_t (*raw)[AES_KEY_LEN];
+    Frame_t *sealed; // As received
+    uint32_t *node;  // Sender of each frame
+} Fleet_t;
+
+typedef struct {
+    const Fleet_t *fleet;
+    KeyCache_t *cache;
+    size_t from;
+    size_t to;
+    uint64_t failed;
+} Worker_t;
+
+static void build_fleet(Fleet_t *f, uint32_t nodes, size_t frames, uint64_t *rng) {
+    FrameKey_t *keys = malloc(nodes * sizeof(*keys));
+    uint16_t *seq = calloc(nodes, sizeof(*seq));
+
+    f->nodes = nodes;
+    f->frames = frames;
+    f->raw = malloc(nodes * sizeof(*f->raw));
+    f->sealed = malloc(frames * sizeof(*f->sealed));
+    f->node = malloc(frames * sizeof(*f->node));
+    if (!keys || !seq || !f->raw || !f->sealed || !f->node) {
+        perror("malloc");
+        exit(1);
+    }
+    for (uint32_t n = 0; n < nodes; ++n) {
+        for (int i = 0; i < AES_KEY_LEN; ++i) {
+            f->raw[n][i] = (uint8_t)Bench_Rand(rng);
+        }
+        FrameKey_Init(&keys[n], f->raw[n]);
+    }
+    for (size_t i = 0; i < frames; ++i) {
+        uint32_t n = (uint32_t)(Bench_Rand(rng) % nodes);
+        FrameReading_t readings[FRAME_MAX_SEALED_READINGS];
+        // Full reports mostly, some with fewer readings: one and two CMAC blocks
+        size_t count = Bench_RandUnit(rng) < 0.8 ? FRAME_MAX_SEALED_READINGS : 1 + Bench_Rand(rng) % 3;
+        for (size_t r = 0; r < count; ++r) {
+            readings[r] = (FrameReading_t){(uint8_t)(r % FIELD_COUNT), (float)(Bench_Rand(rng) % 2000) * 0.01f};
+        }
+        int64_t rx_ts = 1704067200000LL + (int64_t)i;
+        FrameHeader_t hdr = {.type = FRAME_TYPE_TELEMETRY,
+                             .flags = FRAME_FLAG_NODE_TIME,
+                             .node = 1 + n,
+                             .seq = seq[n]++,
+                             .node_time = (uint32_t)(rx_ts / 1000)};
+        Frame_t *frame = &f->sealed[i];
+        memset(frame, 0, sizeof(*frame));
+        frame->pipe = 1;
+        frame->rx_ts = rx_ts;
+        size_t len = Frame_Encode(frame->payload, &hdr, readings, count);
+        frame->len = (uint8_t)Frame_Seal(frame->payload, len, &keys[n]);
+        f->node[i] = 1 + n;
+    }
+    free(keys);
+    free(seq);
+}
+
+static KeyCache_t *build_cache(const Fleet_t *f) {
+    KeyCache_t *cache = KeyCache_Create(f->nodes);
+
+    for (uint32_t n = 0; cache && n < f->nodes; ++n) {
+        KeyCache_Put(cache, 1 + n, f->raw[n]);
+    }
+    return cache;
+}
+
+// As the gateway did per frame: key schedule and subkeys from the raw key
+static uint64_t unseal_raw(const Fleet_t *f) {
+    uint64_t failed = 0;
+
+    for (size_t i = 0; i < f->frames; ++i) {
+        Frame_t frame = f->sealed[i];
+        FrameKey_t key;
+        FrameKey_Init(&key, f->raw[f->node[i] - 1]);
+        failed += Frame_Unseal(frame.payload, frame.len, &key) < 0;
+    }
+    return failed;
+}
+
+static uint64_t unseal_cached(const Fleet_t *f, KeyCache_t *cache) {
+    uint64_t failed = 0;
+
+    for (size_t i = 0; i < f->frames; ++i) {
+        Frame_t frame = f->sealed[i];
+        FrameKey_t key;
+        bool found;
+        KeyCache_Get(cache, &f->node[i], 1, &key, &found);
+        failed += !found || Frame_Unseal(frame.payload, frame.len, &key) < 0;
+    }
+    return failed;
+}
+
+static uint64_t unseal_batched(const Fleet_t *f, KeyCache_t *cache, size_t from, size_t to) {
+    Frame_t frames[INGEST_BATCH];
+    FrameUnsealJob_t jobs[INGEST_BATCH];
+    FrameKey_t keys[INGEST_BATCH];
+    bool found[INGEST_BATCH];
+    uint64_t failed = 0;
+
+    for (size_t i = from; i < to; i += INGEST_BATCH) {
+        size_t n = to - i < INGEST_BATCH ? to - i : INGEST_BATCH;
+        KeyCache_Get(cache, &f->node[i], n, keys, found);
+        for (size_t j = 0; j < n; ++j) {
+            frames[j] = f->sealed[i + j];
+            jobs[j] = (FrameUnsealJob_t){frames[j].payload, frames[j].len, found[j] ? &keys[j] : NULL, 0};
+        }
+        Frame_UnsealBatch(jobs, n);
+        for (size_t j = 0; j < n; ++j) {
+            failed += jobs[j].result < 0;
+        }
+    }
+    return failed;
+}
+
+static void *worker(void *arg) {
+    Worker_t *w = arg;
+    w->failed = unseal_batched(w->fleet, w->cache, w->from, w->to);
+    return NULL;
+}
+
+static uint64_t unseal_threads(const Fleet_t *f, KeyCache_t *cache, uint32_t threads) {
+    Worker_t w[8];
+    pthread_t tid[8];
+    uint64_t failed = 0;
+
+    for (uint32_t t = 0; t < threads; ++t) {
+        w[t] = (Worker_t){f, cache, f->frames * t / threads, f->frames * (t + 1) / threads, 0};
+        pthread_create(&tid[t], NULL, worker, &w[t]);
+    }
+    for (uint32_t t = 0; t < threads; ++t) {
+        pthread_join(tid[t], NULL);
+        failed += w[t].failed;
+    }
+    return failed;
+}
+
+static void report(const char *backend, const char *mode, uint32_t threads, size_t frames, uint64_t ns,
+                   uint64_t failed, double baseline) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double busy = threads < (uint32_t)cores ? threads : (double)cores;
+    double fps = (double)frames * 1e9 / (double)ns;
+
+    printf("%-8s %-16s %7u %12.0f %14.0f %7.2fx %8.1f", backend, mode, threads, fps, fps / busy,
+           baseline > 0.0 ? fps / busy / baseline : 1.0, (double)ns / (double)frames);
+    printf(failed ? "  FAILED %llu\n" : "\n", (unsigned long long)failed);
+}
+
+static void run_backend(const Fleet_t *f, const char *name) {
+    KeyCache_t *cache = build_cache(f);
+    double baseline;
+    uint64_t start, ns, failed;
+    static const uint32_t threads[] = {1, 2, 4};
+
+    start = Bench_NowNs();
+    failed = unseal_raw(f);
+    ns = Bench_NowNs() - start;
+    baseline = (double)f->frames * 1e9 / (double)ns;
+    report(name, "raw key, 1x1", 1, f->frames, ns, failed, baseline);
+
+    start = Bench_NowNs();
+    failed = unseal_cached(f, cache);
+    report(name, "cached key, 1x1", 1, f->frames, Bench_NowNs() - start, failed, baseline);
+
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+        start = Bench_NowNs();
+        failed = threads[t] == 1 ? unseal_batched(f, cache, 0, f->frames) : unseal_threads(f, cache, threads[t]);
+        report(name, "batched", threads[t], f->frames, Bench_NowNs() - start, failed, baseline);
+    }
+    KeyCache_Destroy(cache);
+}
+
+static void run_ingest(const Fleet_t *f, const char *dir, bool batched) {
+    char path[600];
+    IngestConfig_t cfg;
+    IngestStats_t st;
+
+    Ingest_DefaultConfig(&cfg);
+    cfg.wal.sync = WAL_SYNC_NONE;
+    cfg.expected_nodes = f->nodes;
+    snprintf(path, sizeof(path), "%s/%s", dir, batched ? "batched" : "single");
+    Ingest_t *ingest = Ingest_Open(path, &cfg);
+    if (!ingest) {
+        perror(path);
+        return;
+    }
+    for (uint32_t n = 0; n < f->nodes; ++n) {
+        Ingest_SetKey(ingest, 1 + n, f->raw[n]);
+    }
+    uint64_t start = Bench_NowNs();
+    if (batched) {
+        Ingest_Frames(ingest, f->sealed, f->frames);
+    } else {
+        for (size_t i = 0; i < f->frames; ++i) {
+            Ingest_Frame(ingest, &f->sealed[i]);
+        }
+    }
+    uint64_t ns = Bench_NowNs() - start;
+    Ingest_GetStats(ingest, &st);
+    printf("ingest %-8s %12.0f frames/s %8.1f ns/frame, %llu applied, %llu auth failures\n",
+           batched ? "batched" : "1x1", (double)f->frames * 1e9 / (double)ns, (double)ns / (double)f->frames,
+           (unsigned long long)st.frames, (unsigned long long)st.auth_failures);
+    Ingest_Close(ingest);
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000;
+    size_t frames = argc > 2 ? (size_t)atoll(argv[2]) : 1000000;
+    char *dir = Bench_TempDir(argc > 3 ? argv[3] : NULL, "bench_seal");
+    static const char *const backends[] = {"portable", "aesni", "armv8"};
+    uint64_t rng = 42;
+    Fleet_t fleet;
+
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    printf("%-8s %-16s %7s %12s %14s %8s %8s\n", "backend", "path", "threads", "frames/s", "frames/s/core",
+           "vs raw", "ns/frame");
+    fflush(stdout);
+    // The backend is picked once per process, so each runs in a child that has not encrypted yet
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+        if (!Aes_ByName(backends[b])) {
+            continue;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            setenv("GATEWAY_AES", backends[b], 1);
+            build_fleet(&fleet, nodes, frames, &rng);
+            run_backend(&fleet, Aes_Get()->name);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+
+    build_fleet(&fleet, nodes, frames, &rng);
+    printf("\nwhole ingest path, %s, WAL without sync\n", Aes_Get()->name);
+    run_ingest(&fleet, dir, false);
+    run_ingest(&fleet, dir, true);
+    Bench_RemoveDir(dir);
+    return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * File: bench_stream.c
+ * Description: Live WebSocket fan-out (publish/stream.h) to hundreds of local
+ *              subscribers. A producer offers samples at a fixed rate, as the
+ *              ingest tap would, and times each offer; reader threads parse
+ *              every update and measure how old its first sample is. A few
+ *              extra subscribers connect and never read. Runs once per slow
+ *              subscriber policy and reports delivery latency, encoded versus
+ *              sent bytes (each update is encoded once for all), what became
+ *              of the stalled subscribers, and whether the producer ever
+ *              waited. Dropped subscribers must have lost their connection,
+ *              not just been counted.
+ *
+ *              usage: bench_stream [subscribers] [stalled] [samples_per_s] [seconds]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Checks that dropped subscribers are disconnected.
+ *
+ */
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "publish/stream.h"
+
+#define READERS 4
+#define SUB_BUF (256 * 1024)
+#define LAT_MAX (1 << 20)
+
+typedef struct {
+    int fd;
+    size_t len;
+    uint8_t *buf;
+} Sub_t;
+
+typedef struct {
+    Sub_t *subs;
+    uint32_t n;
+    int stop;
+    uint64_t messages;
+    uint64_t snapshots;
+    uint64_t bytes;
+    uint64_t closed;
+    uint64_t *lat_ms;
+    size_t n_lat;
+} Reader_t;
+
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int subscribe(uint16_t port, int rcvbuf) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    static const char req[] = "GET /stream HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    char reply[512];
+    size_t len = 0;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (rcvbuf > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || send(fd, req, sizeof(req) - 1, 0) < 0) {
+        return -1;
+    }
+    // The reply comes alone: nothing is streamed before the handshake completes
+    while (len < sizeof(reply) - 1) {
+        ssize_t n = recv(fd, reply + len, 1, 0);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        len++;
+        reply[len] = '\0';
+        if (len >= 4 && memcmp(reply + len - 4, "\r\n\r\n", 4) == 0) {
+            break;
+        }
+    }
+    if (strncmp(reply, "HTTP/1.1 101", 12) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Takes the complete frames off the front of s->buf
+static void parse(Reader_t *r, Sub_t *s, int64_t now) {
+    size_t off = 0;
+
+    while (s->len - off >= 2) {
+        const uint8_t *p = s->buf + off;
+        uint64_t len = p[1] & 0x7F;
+        size_t hdr = 2;
+        if (len == 126) {
+            if (s->len - off < 4) {
+                break;
+            }
+            len = (uint64_t)p[2] << 8 | p[3];
+            hdr = 4;
+        } else if (len == 127) {
+            if (s->len - off < 10) {
+                break;
+            }
+            len = 0;
+            for (int i = 0; i < 8; ++i) {
+                len = len << 8 | p[2 + i];
+            }
+            hdr = 10;
+        }
+        if (s->len - off < hdr + len) {
+            break;
+        }
+        const char *json = (const char *)p + hdr;
+        if ((p[0] & 0x0F) == 0x1 && len > 14 && memcmp(json, "{\"samples\":[[", 13) == 0) {
+            // [node,ts,...: the offer time of the update's first sample
+            const char *ts = memchr(json + 13, ',', len - 13);
+            if (ts && r->n_lat < LAT_MAX) {
+                int64_t age = now - strtoll(ts + 1, NULL, 10);
+                r->lat_ms[r->n_lat++] = age > 0 ? (uint64_t)age : 0;
+            }
+            r->messages++;
+        } else if ((p[0] & 0x0F) == 0x1) {
+            r->snapshots++;
+        }
+        off += hdr + len;
+    }
+    memmove(s->buf, s->buf + off, s->len - off);
+    s->len -= off;
+}
+
+static void *reader(void *arg) {
+    Reader_t *r = arg;
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event events[64];
+
+    for (uint32_t i = 0; i < r->n; ++i) {
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = i};
+        epoll_ctl(ep, EPOLL_CTL_ADD, r->subs[i].fd, &ev);
+    }
+    while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+        int n = epoll_wait(ep, events, 64, 50);
+        int64_t now = wall_ms();
+        for (int e = 0; e < n; ++e) {
+            Sub_t *s = &r->subs[events[e].data.u32];
+            ssize_t got = recv(s->fd, s->buf + s->len, SUB_BUF - s->len, MSG_DONTWAIT);
+            if (got <= 0) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, s->fd, NULL);
+                r->closed++;
+                continue;
+            }
+            s->len += (size_t)got;
+            r->bytes += (uint64_t)got;
+            parse(r, s, now);
+        }
+    }
+    close(ep);
+    return NULL;
+}
+
+static int run(StreamSlowPolicy_t slow, uint32_t subs, uint32_t stalled, uint32_t rate, double seconds) {
+    StreamConfig_t cfg;
+    StreamStats_t st;
+    Reader_t readers[READERS];
+    pthread_t tid[READERS];
+    int *stalled_fd = calloc(stalled ? stalled : 1, sizeof(int));
+
+    Stream_DefaultConfig(&cfg);
+    cfg.port = 0;
+    cfg.slow = slow;
+    cfg.max_pending = 256 * 1024;
+    StreamServer_t *server = StreamServer_Start(&cfg);
+    if (!server || !stalled_fd) {
+        perror("stream server");
+        return 1;
+    }
+    uint16_t port = StreamServer_Port(server);
+    for (uint32_t t = 0; t < READERS; ++t) {
+        Reader_t *r = &readers[t];
+        *r = (Reader_t){.n = subs / READERS + (t < subs % READERS)};
+        r->subs = calloc(r->n, sizeof(*r->subs));
+        r->lat_ms = malloc(LAT_MAX * sizeof(*r->lat_ms));
+        for (uint32_t i = 0; i < r->n; ++i) {
+            r->subs[i].buf = malloc(SUB_BUF);
+            if ((r->subs[i].fd = subscribe(port, 0)) < 0) {
+                perror("subscribe");
+                return 1;
+            }
+        }
+        pthread_create(&tid[t], NULL, reader, r);
+    }
+    for (uint32_t i = 0; i < stalled; ++i) {
+        stalled_fd[i] = subscribe(port, 4096);
+    }
+
+    // 1000 nodes, one sample each in turn; ts is the offer time, for the readers
+    uint64_t *offer_ns = malloc((size_t)(rate * seconds + 1) * sizeof(*offer_ns));
+    size_t n_offers = 0;
+    uint64_t interval = 1000000000ull / rate * 64, next = Bench_NowNs(), end = next + (uint64_t)(seconds * 1e9);
+    uint32_t peak_buffers = 0, i = 0;
+    while (Bench_NowNs() < end) {
+        Sample_t batch[64];
+        int64_t now = wall_ms();
+        for (size_t k = 0; k < 64; ++k, ++i) {
+            batch[k] = (Sample_t){.ts = now, .node = 4096 + i % 1000, .field = (uint8_t)(i % FIELD_COUNT),
+                                  .value = (float)(i % 4000) * 0.01f};
+        }
+        uint64_t t = Bench_NowNs();
+        StreamServer_Offer(server, batch, 64);
+        offer_ns[n_offers++] = Bench_NowNs() - t;
+        StreamServer_GetStats(server, &st);
+        peak_buffers = st.buffers > peak_buffers ? st.buffers : peak_buffers;
+        next += interval;
+        while (Bench_NowNs() < next) {
+            usleep(100);
+        }
+    }
+    usleep(300000);
+    StreamServer_GetStats(server, &st);
+    // Dropped subscribers must really be gone: their sockets are cut off once the close frame's linger runs out
+    uint32_t expect_clients = subs + (slow == STREAM_SLOW_DROP ? 0 : stalled);
+    uint64_t wait_end = Bench_NowNs() + 3000000000ull;
+    uint32_t clients = st.clients;
+    while (clients > expect_clients && Bench_NowNs() < wait_end) {
+        usleep(50000);
+        StreamStats_t now;
+        StreamServer_GetStats(server, &now);
+        clients = now.clients;
+    }
+
+    uint64_t messages = 0, bytes = 0, snapshots = 0, closed = 0, *lat = malloc(LAT_MAX * READERS * sizeof(*lat));
+    size_t n_lat = 0;
+    for (uint32_t t = 0; t < READERS; ++t) {
+        __atomic_store_n(&readers[t].stop, 1, __ATOMIC_RELEASE);
+        pthread_join(tid[t], NULL);
+        messages += readers[t].messages;
+        bytes += readers[t].bytes;
+        snapshots += readers[t].snapshots;
+        closed += readers[t].closed;
+        memcpy(lat + n_lat, readers[t].lat_ms, readers[t].n_lat * sizeof(*lat));
+        n_lat += readers[t].n_lat;
+    }
+    uint64_t worst = 0;
+    for (size_t k = 0; k < n_offers; ++k) {
+        worst = offer_ns[k] > worst ? offer_ns[k] : worst;
+    }
+    printf("%-8s %5u %8.0f %9.2f %9.1f %6.1fx %5llu %5llu %8llu %8llu %6llu %7u %8.1f %8.1f\n",
+           slow == STREAM_SLOW_DROP ? "drop" : "coalesce", subs, (double)st.updates / seconds,
+           (double)st.update_bytes / 1e6 / seconds, (double)st.sent_bytes / 1e6 / seconds,
+           (double)st.sent_bytes / (double)(st.update_bytes ? st.update_bytes : 1),
+           (unsigned long long)Bench_Percentile(lat, n_lat, 50), (unsigned long long)Bench_Percentile(lat, n_lat, 99),
+           (unsigned long long)st.coalesced, (unsigned long long)st.dropped_slow,
+           (unsigned long long)st.dropped_samples, peak_buffers, (double)Bench_Percentile(offer_ns, n_offers, 99) / 1e3,
+           (double)worst / 1e3);
+    if (closed > 0 || messages == 0 || snapshots > 0) {
+        fprintf(stderr, "reading subscribers: %llu updates, %llu snapshots, %llu disconnected\n",
+                (unsigned long long)messages, (unsigned long long)snapshots, (unsigned long long)closed);
+    }
+    (void)bytes;
+    int rc = 0;
+    if (clients != expect_clients) {
+        fprintf(stderr, "%u subscribers still connected, expected %u\n", clients, expect_clients);
+        rc = 1;
+    }
+
+    StreamServer_Stop(server);
+    for (uint32_t t = 0; t < READERS; ++t) {
+        for (uint32_t k = 0; k < readers[t].n; ++k) {
+            close(readers[t].subs[k].fd);
+            free(readers[t].subs[k].buf);
+        }
+        free(readers[t].subs);
+        free(readers[t].lat_ms);
+    }
+    for (uint32_t k = 0; k < stalled; ++k) {
+        close(stalled_fd[k]);
+    }
+    free(stalled_fd);
+    free(offer_ns);
+    free(lat);
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    uint32_t subs = argc > 1 ? (uint32_t)atoi(argv[1]) : 400;
+    uint32_t stalled = argc > 2 ? (uint32_t)atoi(argv[2]) : 20;
+    uint32_t rate = argc > 3 ? (uint32_t)atoi(argv[3]) : 40000;
+    double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+    struct rlimit nofile;
+    int rc = 0;
+
+    // Both ends of every connection live in this process
+    getrlimit(RLIMIT_NOFILE, &nofile);
+    nofile.rlim_cur = nofile.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &nofile);
+    if (subs < READERS || rate < 64) {
+        fprintf(stderr, "usage: %s [subscribers] [stalled] [samples_per_s] [seconds]\n", argv[0]);
+        return 1;
+    }
+    printf("%u reading and %u stalled subscribers, %u samples/s for %.1f s\n", subs, stalled, rate, seconds);
+    printf("%-8s %5s %8s %9s %9s %7s %5s %5s %8s %8s %6s %7s %8s %8s\n", "slow", "subs", "upd/s", "enc MB/s",
+           "sent MB/s", "fanout", "p50ms", "p99ms", "coalesce", "dropped", "lost", "buffers", "offer99", "offermax");
+    printf("%-8s %5s %8s %9s %9s %7s %5s %5s %8s %8s %6s %7s %8s %8s\n", "", "", "", "", "", "", "", "", "", "", "",
+           "", "us", "us");
+    rc |= run(STREAM_SLOW_COALESCE, subs, stalled, rate, seconds);
+    rc |= run(STREAM_SLOW_DROP, subs, stalled, rate, seconds);
+    return rc;
+}
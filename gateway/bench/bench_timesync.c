@@ -0,0 +1,192 @@
+/*
+ * File: bench_timesync.c
+ * Description: Node clock discipline against simulated crystals. Each node's
+ *              LSE is off by up to +-20 ppm and follows the tuning-fork
+ *              temperature curve (-0.034 ppm/degC^2 from 25 degC) through a
+ *              daily cycle; the RTC reads in whole ms, the gateway stamps in
+ *              whole ms after up to 2 ms of receive latency, and a tenth of
+ *              the time stamps are lost with their ACK. The node runs the firmware estimator (firmware/src/app/
+ *              timesync.c); the gateway side encodes and stamps the ACK
+ *              payloads as gatewayd does, and timestamps go through
+ *              Frame_Decode as 32-bit ms node time.
+ *
+ *              Compared with setting the clock once and with stepping it to
+ *              the gateway time every hour. Errors are frame timestamps
+ *              against true time over the days after the first.
+ *
+ *              usage: bench_timesync [nodes] [days]
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <math.h>
+
+#include "app/timesync.h"
+#include "proto/control.h"
+#include "proto/frame.h"
+
+#define REPORT_MS 10000
+#define AIRTIME_MS 1.3
+#define ACK_LOSS 0.1
+#define RX_JITTER_MS 2.0 // Gateway receive path latency, uniform
+#define EPOCH_MS 1790000000000.0 // Gateway time at the start
+#define DAY_MS 86400000.0
+
+typedef enum {
+    MODE_ONCE = 0,
+    MODE_HOURLY,
+    MODE_DISCIPLINED,
+} Mode_t;
+
+typedef struct {
+    double local;     // RTC, ms
+    double base_ppb;  // Crystal error at the turnover temperature
+    double phase;     // Daily temperature cycle
+    double cal_ppb;   // CALR in force
+    TimeSync_t sync;
+    double last_step; // MODE_HOURLY
+} Node_t;
+
+static double crystal_ppb(const Node_t *n, double t_ms) {
+    double temp = 15.0 + 10.0 * sin(2.0 * M_PI * t_ms / DAY_MS + n->phase);
+    return n->base_ppb - 34.0 * (temp - 25.0) * (temp - 25.0);
+}
+
+static uint32_t rtc_read(const Node_t *n) {
+    return (uint32_t)(uint64_t)floor(n->local);
+}
+
+// Gateway: a time message stamped with the frame's arrival, as gatewayd loads it
+static int gateway_ack(double rx_true, uint8_t *payload) {
+    ControlTime_t blank = {0};
+    size_t len = Control_EncodeTime(payload, &blank);
+    Control_Stamp(payload, len, (int64_t)floor(rx_true));
+    return (int)len;
+}
+
+static void run(const char *name, Mode_t mode, uint32_t nodes, double days) {
+    Node_t *fleet = calloc(nodes, sizeof(*fleet));
+    uint64_t rng = 42, samples = 0, steps_back = 0, cal_writes = 0;
+    size_t cap = (size_t)(days * 24 * nodes) + 16, n_err = 0;
+    uint64_t *err = malloc(cap * sizeof(*err));
+    double worst_spread = 0, residual = 0;
+    size_t n_residual = 0;
+
+    for (uint32_t i = 0; i < nodes; ++i) {
+        Node_t *n = &fleet[i];
+        n->local = EPOCH_MS - 800e9 + Bench_RandUnit(&rng) * 1e9; // RTC from power-up, years off
+        n->base_ppb = (Bench_RandUnit(&rng) * 2.0 - 1.0) * 20000.0;
+        n->phase = Bench_RandUnit(&rng) * 0.5; // Nodes sit in different spots
+        TimeSync_Init(&n->sync);
+    }
+
+    double t = 0, end = days * DAY_MS;
+    int64_t next_measure = (int64_t)DAY_MS;
+    while (t < end) {
+        for (uint32_t i = 0; i < nodes; ++i) {
+            Node_t *n = &fleet[i];
+            double tx_local = n->local;
+            bool want = mode == MODE_DISCIPLINED ? TimeSync_Wanted(&n->sync, rtc_read(n))
+                      : mode == MODE_HOURLY      ? !n->sync.synced || t - n->last_step >= 3600e3
+                                                 : !n->sync.synced;
+            if (!want || Bench_RandUnit(&rng) < ACK_LOSS) {
+                continue;
+            }
+            uint8_t payload[FRAME_MAX_PAYLOAD];
+            int len = gateway_ack(EPOCH_MS + t + AIRTIME_MS + Bench_RandUnit(&rng) * RX_JITTER_MS, payload);
+            TimeSample_t sample;
+            if (TimeSync_Parse(payload, (uint8_t)len, (uint32_t)(uint64_t)floor(tx_local + AIRTIME_MS), &sample) != 0) {
+                continue;
+            }
+            samples++;
+            double gateway = (double)sample.seconds * 1000.0 + sample.ms;
+            if (mode == MODE_DISCIPLINED) {
+                TimeSyncAction_t act;
+                TimeSync_Update(&n->sync, &sample, &act);
+                if (act.step) {
+                    steps_back += n->sync.samples > 0 && act.offset_ms < 0;
+                    n->local = gateway + (n->local - (tx_local + AIRTIME_MS));
+                }
+                if (act.calibrate) {
+                    cal_writes++;
+                    n->cal_ppb = act.cal_steps * 953.674;
+                }
+            } else {
+                double target = gateway + (n->local - (tx_local + AIRTIME_MS));
+                steps_back += n->sync.synced && target < n->local;
+                n->local = target;
+                n->sync.synced = true;
+                n->last_step = t;
+            }
+        }
+
+        // Advance every RTC a report interval
+        t += REPORT_MS;
+        for (uint32_t i = 0; i < nodes; ++i) {
+            Node_t *n = &fleet[i];
+            double ppb = crystal_ppb(n, t) + n->cal_ppb;
+            n->local += REPORT_MS * (1.0 + ppb * 1e-9);
+            if (t >= DAY_MS) {
+                residual += fabs(ppb);
+                n_residual++;
+            }
+        }
+
+        if (t >= next_measure) {
+            // A frame from every node, time stamped by its RTC, decoded by the gateway
+            double lo = 1e18, hi = -1e18;
+            for (uint32_t i = 0; i < nodes; ++i) {
+                Node_t *n = &fleet[i];
+                FrameHeader_t hdr = {.type = FRAME_TYPE_TELEMETRY, .flags = FRAME_FLAG_NODE_TIME | FRAME_FLAG_TIME_MS,
+                                     .node = i, .node_time = rtc_read(n)};
+                FrameReading_t reading = {FIELD_TEMPERATURE, 20.0f};
+                Frame_t frame = {.rx_ts = (int64_t)(EPOCH_MS + t + AIRTIME_MS)};
+                Sample_t s;
+                frame.len = (uint8_t)Frame_Encode(frame.payload, &hdr, &reading, 1);
+                Frame_Decode(&frame, &s, 1);
+                double e = (double)s.ts - (EPOCH_MS + t);
+                err[n_err++] = (uint64_t)fabs(e);
+                lo = e < lo ? e : lo;
+                hi = e > hi ? e : hi;
+            }
+            worst_spread = hi - lo > worst_spread ? hi - lo : worst_spread;
+            next_measure += 3600000;
+        }
+    }
+
+    uint64_t max = 0;
+    for (size_t i = 0; i < n_err; ++i) {
+        max = err[i] > max ? err[i] : max;
+    }
+    printf("%-12s %6.1f %6llu %6llu %6llu %8.0f %9.2f %9.1f %8llu\n", name, (double)samples / nodes / days,
+           (unsigned long long)Bench_Percentile(err, n_err, 50), (unsigned long long)Bench_Percentile(err, n_err, 99),
+           (unsigned long long)max, worst_spread, residual / (double)n_residual / 1000.0,
+           (double)cal_writes / nodes / days, (unsigned long long)steps_back);
+    free(err);
+    free(fleet);
+}
+
+int main(int argc, char **argv) {
+    uint32_t nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : 100;
+    double days = argc > 2 ? atof(argv[2]) : 7;
+
+    if (nodes == 0 || days <= 1) {
+        fprintf(stderr, "usage: %s [nodes] [days > 1]\n", argv[0]);
+        return 1;
+    }
+    printf("%u nodes, %.0f days, +-20 ppm crystals, 10-30 degC daily, %.0f ms stamp jitter, %.0f%% of stamps lost\n",
+           nodes, days, RX_JITTER_MS, ACK_LOSS * 100);
+    printf("%-12s %6s %6s %6s %6s %8s %9s %9s %8s\n", "", "req/d", "p50 ms", "p99 ms", "max ms", "spread", "rate ppm",
+           "cal/d", "backward");
+    run("set once", MODE_ONCE, nodes, days);
+    run("step hourly", MODE_HOURLY, nodes, days);
+    run("disciplined", MODE_DISCIPLINED, nodes, days);
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * File: bench_wal.c
+ * Description: Ingest throughput at each WAL durability setting, on every
+ *              directory given (tmpfs vs a disk-backed file system shows what
+ *              the fsyncs cost). Reports frames/s, fsyncs, frames per fsync,
+ *              the worst append-to-durable delay and the p99 time an ingest
+ *              call blocks. Then crashes a child mid-stream and checks that
+ *              recovery replays only the tail after the last checkpoint and
+ *              loses no durable frame.
+ *
+ *              usage: bench_wal [frames] [dir...]   (default /dev/shm /tmp)
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include "bench.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pipeline/ingest.h"
+
+#define NODES 1000
+
+typedef struct {
+    const char *name;
+    WalSync_t sync;
+    uint32_t max_delay_us;
+    uint32_t frame_div; // WAL_SYNC_EACH is too slow for the full count
+} Mode_t;
+
+static const Mode_t modes[] = {
+    {"none", WAL_SYNC_NONE, 5000, 1},
+    {"group 10ms", WAL_SYNC_GROUP, 10000, 1},
+    {"group 1ms", WAL_SYNC_GROUP, 1000, 1},
+    {"group 0", WAL_SYNC_GROUP, 0, 1},
+    {"each", WAL_SYNC_EACH, 0, 50},
+};
+
+static void make_frame(Frame_t *frame, uint32_t i, int64_t t0) {
+    uint32_t node = i % NODES;
+    FrameHeader_t hdr = {
+        .type = FRAME_TYPE_TELEMETRY,
+        .flags = FRAME_FLAG_NODE_TIME,
+        .node = node + 1,
+        .seq = (uint16_t)(i / NODES),
+        .node_time = (uint32_t)(t0 / 1000 + (int64_t)(i / NODES) * 60),
+    };
+    FrameReading_t r[4] = {
+        {FIELD_TEMPERATURE, 20.0f + (float)(i % 97) * 0.1f},
+        {FIELD_HUMIDITY, 40.0f + (float)(i % 31)},
+        {FIELD_PRESSURE, 1000.0f + (float)(i % 13)},
+        {FIELD_BATTERY, 3.3f},
+    };
+    frame->rx_ts = t0 + (int64_t)(i / NODES) * 60000;
+    frame->pipe = 1;
+    frame->rpd = 1;
+    frame->len = (uint8_t)Frame_Encode(frame->payload, &hdr, r, 4);
+}
+
+static int count_raw(const ChunkHeader_t *hdr, const ChunkLocation_t *loc, void *ctx) {
+    (void)loc;
+    *(uint64_t *)ctx += hdr->count;
+    return 0;
+}
+
+static void run_mode(const char *base, const Mode_t *mode, uint32_t frames) {
+    char *dir = Bench_TempDir(base, "bench_wal");
+    IngestConfig_t cfg;
+    int64_t t0 = 1700000000000ll;
+
+    if (!dir) {
+        perror(base);
+        return;
+    }
+    Ingest_DefaultConfig(&cfg);
+    cfg.wal.sync = mode->sync;
+    cfg.wal.max_delay_us = mode->max_delay_us;
+    Ingest_t *ingest = Ingest_Open(dir, &cfg);
+    uint64_t *lat = malloc(frames * sizeof(*lat));
+    if (!ingest || !lat) {
+        perror(dir);
+        free(lat);
+        Bench_RemoveDir(dir);
+        return;
+    }
+
+    uint64_t start = Bench_NowNs();
+    for (uint32_t i = 0; i < frames; ++i) {
+        Frame_t frame;
+        make_frame(&frame, i, t0);
+        uint64_t t = Bench_NowNs();
+        Ingest_Frame(ingest, &frame);
+        lat[i] = Bench_NowNs() - t;
+    }
+    Wal_WaitDurable(Ingest_Wal(ingest), Wal_LastLsn(Ingest_Wal(ingest)));
+    double secs = (double)(Bench_NowNs() - start) / 1e9;
+
+    WalStats_t ws;
+    Wal_GetStats(Ingest_Wal(ingest), &ws);
+    printf("%-8s %-11s %9.0f %8llu %10.1f %10.2f %10.1f\n", base, mode->name, frames / secs,
+           (unsigned long long)ws.syncs, ws.syncs ? (double)ws.records / (double)ws.syncs : 0.0,
+           (double)ws.max_delay_ns / 1e6, (double)Bench_Percentile(lat, frames, 99.0) / 1e3);
+    free(lat);
+    Ingest_Close(ingest);
+    Bench_RemoveDir(dir);
+}
+
+// Child ingests, checkpoints halfway and dies without closing anything
+static void run_crash(const char *base, uint32_t frames) {
+    char *dir = Bench_TempDir(base, "bench_wal_crash");
+    int64_t t0 = 1700000000000ll;
+
+    if (!dir) {
+        perror(base);
+        return;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        Ingest_t *ingest = Ingest_Open(dir, NULL);
+        if (!ingest) {
+            _exit(1);
+        }
+        for (uint32_t i = 0; i < frames; ++i) {
+            Frame_t frame;
+            make_frame(&frame, i, t0);
+            Ingest_Frame(ingest, &frame);
+            if (i == frames / 2) {
+                Ingest_Checkpoint(ingest);
+            }
+        }
+        Wal_WaitDurable(Ingest_Wal(ingest), Wal_LastLsn(Ingest_Wal(ingest)));
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+
+    uint64_t start = Bench_NowNs();
+    Ingest_t *ingest = Ingest_Open(dir, NULL);
+    double ms = (double)(Bench_NowNs() - start) / 1e6;
+    if (!ingest || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "crash run failed\n");
+        Ingest_Close(ingest);
+        Bench_RemoveDir(dir);
+        return;
+    }
+    IngestStats_t st;
+    uint64_t raw = 0;
+    Ingest_GetStats(ingest, &st);
+    SeriesStore_Flush(Ingest_Store(ingest));
+    SeriesStore_ScanChunks(Ingest_Store(ingest), SERIES_RES_RAW, count_raw, &raw);
+    printf("%-8s recovery: replayed %llu of %u frames in %.1f ms, raw samples %llu (expected %llu) %s\n", base,
+           (unsigned long long)st.replayed, frames, ms, (unsigned long long)raw, (unsigned long long)frames * 4,
+           raw == (uint64_t)frames * 4 ? "ok" : "MISMATCH");
+    Ingest_Close(ingest);
+    Bench_RemoveDir(dir);
+}
+
+int main(int argc, char **argv) {
+    uint32_t frames = argc > 1 ? (uint32_t)atoi(argv[1]) : 200000;
+    const char *default_dirs[] = {"/dev/shm", "/tmp"};
+    const char **dirs = argc > 2 ? (const char **)argv + 2 : default_dirs;
+    int n_dirs = argc > 2 ? argc - 2 : 2;
+
+    printf("%u frames, %d nodes, 4 readings each\n", frames, NODES);
+    printf("%-8s %-11s %9s %8s %10s %10s %10s\n", "dir", "mode", "frames/s", "fsyncs", "frames/fs", "max ms",
+           "p99 us");
+    for (int d = 0; d < n_dirs; ++d) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+            run_mode(dirs[d], &modes[m], frames / modes[m].frame_div);
+        }
+    }
+    for (int d = 0; d < n_dirs; ++d) {
+        run_crash(dirs[d], frames);
+    }
+    return 0;
+}
@@ -0,0 +1,634 @@
+/*
+ * File: main.c
+ * Description: Gateway daemon. Receives frames, logs them to the WAL, owns the
+ *              series store and rollup engine and serves local queries.
+ *
+ *              usage: gatewayd [-d data_dir] [-q query_socket] [-u udp_port]
+ *                              [-s none|group|each] [-l wal_delay_us]
+ *                              [-c checkpoint_s] [-k keyfile]
+ *                              [-r capture_file] [-m metrics_port]
+ *                              [-P broker_ip:port] [-T topic_prefix] [-a]
+ *                              [-L lateness_ms] [-t slot_ms] [-o version]
+ *                              [-Q policy[:frames]] [-M policy]
+ *                              [-W stream_port] [-A rules_file]
+ *                              [-R raw:1m:1h:1d] [-C compact_kb_per_s]
+ *
+ *              The key file provisions encrypted nodes, one "<node> <32 hex
+ *              digit key>" per line. With -r every received frame is also appended,
+ *              as received, to a capture file for tools/replay. With -m
+ *              metrics are served for Prometheus on 127.0.0.1:<port>/metrics.
+ *              With -P decoded samples are published to an MQTT broker in
+ *              batches on <topic_prefix>/<node>. With -a every series is
+ *              watched for outliers, fast changes and stuck sensors, and
+ *              anomalies are logged and counted. With -L samples are put
+ *              back in timestamp order per node within that much lateness
+ *              before they are stored. With -t every node is assigned its own
+ *              slot_ms transmit slot in the 10 s reporting period, sent down in
+ *              an ACK payload. A node that asks for the time with
+ *              FRAME_FLAG_TIME_REQ gets the receive time of its frame in the
+ *              ACK payload, for its clock discipline. With -o the fleet is
+ *              updated to firmware build <version>, stored with the earlier
+ *              builds in <data_dir>/firmware as fw-<version>.bin; nodes fetch
+ *              it, as a delta where one pays, over FRAME_TYPE_OTA requests.
+ *
+ *              The receive loop only answers nodes and queues their frames;
+ *              an ingest thread logs and stores them, so a storage stall does
+ *              not hold up ACKs. -Q sets what the bounded frame queue does
+ *              when ingest falls behind: block (the default), drop-newest,
+ *              drop-oldest, drop-low-prio (store-and-forward backlogs go
+ *              before live reports) or spill (to <data_dir>/ingest.spill),
+ *              and optionally its size in frames. -M sets the policy of the
+ *              sample ring in front of the MQTT publisher (drop-newest by
+ *              default, spill to <data_dir>/mqtt.spill). With -W decoded
+ *              samples are streamed live to dashboards over WebSocket on
+ *              127.0.0.1:<port>/stream. With -A every sample is checked
+ *              against the alert rules in rules_file (see pipeline/alert.h),
+ *              one per line, and alerts are logged as they are raised and
+ *              cleared. -R sets how many days of each resolution are kept,
+ *              0 for ever (30:365:0:0 by default), and -C the disk bandwidth
+ *              of the background compaction that enforces it and merges and
+ *              packs finished segments (4096 KB/s, 0 turns it off).
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: WAL-backed ingest from the UDP radio stand-in.
+ *   - <18-10-2026>: Node key file.
+ *   - <18-10-2026>: Raw frame capture.
+ *   - <18-10-2026>: Metrics endpoint.
+ *   - <18-10-2026>: MQTT publisher.
+ *   - <18-10-2026>: Anomaly detection.
+ *   - <18-10-2026>: Reorder window.
+ *   - <18-10-2026>: ACK payload downlink.
+ *   - <18-10-2026>: TDMA slot assignment.
+ *   - <18-10-2026>: Time stamps for node clock discipline.
+ *   - <18-10-2026>: OTA distribution.
+ *   - <18-10-2026>: Frames ingested in batches.
+ *   - <18-10-2026>: Bounded frame queue to an ingest thread.
+ *   - <18-10-2026>: WebSocket live stream.
+ *   - <18-10-2026>: Alert rules.
+ *   - <18-10-2026>: Retention and background compaction.
+ *
+ */
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/queue.h"
+#include "metrics/exporter.h"
+#include "metrics/metrics.h"
+#include "ota/ota.h"
+#include "pipeline/alert.h"
+#include "pipeline/anomaly.h"
+#include "pipeline/ingest.h"
+#include "proto/control.h"
+#include "publish/publisher.h"
+#include "publish/stream.h"
+#include "query/server.h"
+#include "radio/capture.h"
+#include "radio/downlink.h"
+#include "radio/slots.h"
+#include "radio/udp.h"
+#include "storage/compact.h"
+
+#define DEFAULT_DATA_DIR "/var/lib/weather-gateway"
+#define DEFAULT_QUERY_SOCKET "/run/weather-gateway/query.sock"
+#define DEFAULT_UDP_PORT 7524
+#define DEFAULT_CHECKPOINT_S 300
+#define TIME_REPLY_DEADLINE_MS 30000 // The node asks again with its next report
+#define DEFAULT_QUEUE_FRAMES 4096
+#define BACKLOG_AGE_MS 60000 // Older node time: a store-and-forward backlog
+#define PRIO_BACKLOG 0
+#define PRIO_LIVE 1
+
+typedef struct {
+    Ingest_t *ingest;
+    Queue_t *queue;
+    int64_t checkpoint_ms;
+    Metric_t checkpoint_time;
+    pthread_t thread;
+    int stop;
+} IngestWorker_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void log_anomaly(void *ctx, const Anomaly_t *a) {
+    (void)ctx;
+    fprintf(stderr, "anomaly: node %u %s %s at %lld: %.2f, expected %.2f (%.2f)\n", a->node,
+            Sample_FieldName((SampleField_t)a->field), Anomaly_KindName((AnomalyKind_t)a->kind), (long long)a->ts,
+            a->value, a->expected, a->score);
+}
+
+static void log_alert(void *ctx, const Alert_t *a) {
+    (void)ctx;
+    fprintf(stderr, "alert %s: node %u %s at %lld: %.2f: %s\n", a->raised ? "raised" : "cleared", a->node,
+            Sample_FieldName((SampleField_t)a->field), (long long)a->ts, a->value, a->text);
+}
+
+// Stamped with the arrival of the frame it goes out with, see Control_Stamp
+static void queue_time(DownlinkScheduler_t *downlink, uint32_t node, int64_t rx_ms) {
+    DownlinkMsg_t msg = {
+        .node = node,
+        .prio = DOWNLINK_PRIO_TIME,
+        .kind = CONTROL_TYPE_TIME,
+        .deadline_ms = rx_ms + TIME_REPLY_DEADLINE_MS,
+        .enqueued_ms = rx_ms,
+    };
+    ControlTime_t blank = {0};
+
+    msg.len = (uint8_t)Control_EncodeTime(msg.payload, &blank);
+    Downlink_Enqueue(downlink, &msg);
+}
+
+// Only frames that carry their own node time can be told apart as backlog
+static uint8_t frame_priority(const FrameHeader_t *hdr, int64_t rx_ms) {
+    int64_t age;
+
+    if (!(hdr->flags & FRAME_FLAG_NODE_TIME)) {
+        return PRIO_LIVE;
+    }
+    if (hdr->flags & FRAME_FLAG_TIME_MS) {
+        age = (int32_t)((uint32_t)rx_ms - hdr->node_time);
+    } else {
+        age = rx_ms - (int64_t)hdr->node_time * 1000;
+    }
+    return age > BACKLOG_AGE_MS ? PRIO_BACKLOG : PRIO_LIVE;
+}
+
+// Stores what the receive loop queues, and owns the periodic ticks and checkpoints
+static void *ingest_worker(void *arg) {
+    IngestWorker_t *w = arg;
+    Frame_t batch[INGEST_BATCH];
+    int64_t next_tick = now_ms() + 1000;
+    int64_t next_checkpoint = now_ms() + w->checkpoint_ms;
+
+    for (;;) {
+        size_t n = Queue_Pop(w->queue, batch, INGEST_BATCH, 100);
+        if (n > 0) {
+            Ingest_Frames(w->ingest, batch, n);
+        } else if (__atomic_load_n(&w->stop, __ATOMIC_ACQUIRE)) {
+            break; // Closed before stop was set, so the queue is drained
+        }
+        int64_t now = now_ms();
+        if (now >= next_tick) {
+            Ingest_Tick(w->ingest, now);
+            next_tick = now + 1000;
+        }
+        if (now >= next_checkpoint) {
+            Ingest_Checkpoint(w->ingest);
+            Metrics_Observe(w->checkpoint_time, (uint64_t)(now_ms() - now) * 1000000);
+            next_checkpoint = now + w->checkpoint_ms;
+        }
+    }
+    return NULL;
+}
+
+// "policy[:capacity]"; -1 if malformed
+static int parse_queue(char *arg, QueueConfig_t *cfg) {
+    char *colon = strchr(arg, ':');
+    if (colon) {
+        *colon = '\0';
+        cfg->capacity = (uint32_t)atoi(colon + 1);
+    }
+    int policy = Queue_PolicyFromName(arg);
+    if (policy < 0 || cfg->capacity == 0) {
+        return -1;
+    }
+    cfg->policy = (QueuePolicy_t)policy;
+    return 0;
+}
+
+// "raw:1m:1h:1d" in days, trailing ones optional; -1 if malformed
+static int parse_retention(const char *arg, CompactorConfig_t *cfg) {
+    const char *p = arg;
+
+    for (int r = 0; r < SERIES_RES_COUNT && *p; ++r) {
+        char *end;
+        long days = strtol(p, &end, 10);
+        if (end == p || days < 0 || (*end != ':' && *end != '\0')) {
+            return -1;
+        }
+        cfg->retention_ms[r] = days * SERIES_MS_PER_DAY;
+        p = *end == ':' ? end + 1 : end;
+    }
+    return *p == '\0' ? 0 : -1;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-d data_dir] [-q query_socket] [-u udp_port] [-s none|group|each] [-l wal_delay_us] "
+            "[-c checkpoint_s] [-k keyfile] [-r capture_file] [-m metrics_port] [-P broker_ip:port] "
+            "[-T topic_prefix] [-a] [-L lateness_ms] [-t slot_ms] [-o version] [-Q policy[:frames]] "
+            "[-M policy] [-W stream_port] [-A rules_file] [-R raw:1m:1h:1d] [-C compact_kb_per_s]\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    const char *data_dir = DEFAULT_DATA_DIR;
+    const char *query_socket = DEFAULT_QUERY_SOCKET;
+    const char *keyfile = NULL;
+    const char *capture_path = NULL;
+    const char *rules_path = NULL;
+    int metrics_port = -1;
+    int stream_port = -1;
+    uint16_t udp_port = DEFAULT_UDP_PORT;
+    int64_t checkpoint_ms = DEFAULT_CHECKPOINT_S * 1000;
+    char *broker = NULL;
+    int detect = 0;
+    uint32_t slot_ms = 0;
+    uint16_t ota_version = 0;
+    IngestConfig_t cfg;
+    PublisherConfig_t pub_cfg;
+    QueueConfig_t queue_cfg;
+    CompactorConfig_t compact_cfg;
+    bool compact = true;
+    char ingest_spill[PATH_MAX], mqtt_spill[PATH_MAX];
+    int opt, policy;
+
+    Ingest_DefaultConfig(&cfg);
+    Publisher_DefaultConfig(&pub_cfg);
+    Queue_DefaultConfig(&queue_cfg);
+    Compactor_DefaultConfig(&compact_cfg);
+    queue_cfg.capacity = DEFAULT_QUEUE_FRAMES;
+    while ((opt = getopt(argc, argv, "d:q:u:s:l:c:k:r:m:P:T:aL:t:o:Q:M:W:A:R:C:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            data_dir = optarg;
+            break;
+        case 'q':
+            query_socket = optarg;
+            break;
+        case 'u':
+            udp_port = (uint16_t)atoi(optarg);
+            break;
+        case 's':
+            if (strcmp(optarg, "none") == 0) {
+                cfg.wal.sync = WAL_SYNC_NONE;
+            } else if (strcmp(optarg, "each") == 0) {
+                cfg.wal.sync = WAL_SYNC_EACH;
+            } else {
+                cfg.wal.sync = WAL_SYNC_GROUP;
+            }
+            break;
+        case 'l':
+            cfg.wal.max_delay_us = (uint32_t)atoi(optarg);
+            break;
+        case 'c':
+            checkpoint_ms = (int64_t)atoi(optarg) * 1000;
+            break;
+        case 'k':
+            keyfile = optarg;
+            break;
+        case 'r':
+            capture_path = optarg;
+            break;
+        case 'm':
+            metrics_port = atoi(optarg);
+            break;
+        case 'P': {
+            broker = optarg;
+            char *colon = strrchr(optarg, ':');
+            if (colon) {
+                *colon = '\0';
+                pub_cfg.port = (uint16_t)atoi(colon + 1);
+            }
+            pub_cfg.host = optarg;
+            break;
+        }
+        case 'T':
+            pub_cfg.topic_prefix = optarg;
+            break;
+        case 'a':
+            detect = 1;
+            break;
+        case 'L':
+            cfg.reorder.lateness_ms = (uint32_t)atoi(optarg);
+            break;
+        case 't':
+            slot_ms = (uint32_t)atoi(optarg);
+            break;
+        case 'o':
+            ota_version = (uint16_t)atoi(optarg);
+            break;
+        case 'Q':
+            if (parse_queue(optarg, &queue_cfg) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'M':
+            if ((policy = Queue_PolicyFromName(optarg)) < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            pub_cfg.ring_policy = (QueuePolicy_t)policy;
+            break;
+        case 'W':
+            stream_port = atoi(optarg);
+            break;
+        case 'A':
+            rules_path = optarg;
+            break;
+        case 'R':
+            if (parse_retention(optarg, &compact_cfg) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'C':
+            compact_cfg.bytes_per_s = (uint64_t)atoi(optarg) * 1024;
+            compact = compact_cfg.bytes_per_s > 0;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    Metrics_t *metrics = NULL;
+    MetricsExporter_t *exporter = NULL;
+    Metric_t received = {.slot = -1}, checkpoint_time = {.slot = -1};
+    if (metrics_port >= 0) {
+        metrics = Metrics_Create();
+        if (!metrics) {
+            perror("metrics");
+            return 1;
+        }
+        received = Metrics_Counter(metrics, "gateway_radio_frames_total", "Frames received from the radio");
+        checkpoint_time = Metrics_Histogram(metrics, "gateway_checkpoint_seconds", "Checkpoint duration", 1e-9);
+        cfg.metrics = metrics;
+        pub_cfg.metrics = metrics;
+        queue_cfg.metrics = metrics;
+        compact_cfg.metrics = metrics;
+    }
+    snprintf(ingest_spill, sizeof(ingest_spill), "%s/ingest.spill", data_dir);
+    snprintf(mqtt_spill, sizeof(mqtt_spill), "%s/mqtt.spill", data_dir);
+    queue_cfg.name = "ingest";
+    queue_cfg.item_size = sizeof(Frame_t);
+    queue_cfg.spill_path = ingest_spill;
+    pub_cfg.spill_path = mqtt_spill;
+
+    Ingest_t *ingest = Ingest_Open(data_dir, &cfg);
+    CaptureWriter_t *capture = NULL;
+    UdpRadio_t *radio = NULL;
+    QueryServer_t *server = NULL;
+    Publisher_t *publisher = NULL;
+    StreamServer_t *stream = NULL;
+    AnomalyDetector_t *detector = NULL;
+    AlertEngine_t *alerts = NULL;
+    DownlinkScheduler_t *downlink = NULL;
+    SlotPlanner_t *slots = NULL;
+    OtaServer_t *ota = NULL;
+    Compactor_t *compactor = NULL;
+    Queue_t *queue = NULL;
+    IngestWorker_t worker = {.ingest = ingest, .checkpoint_ms = checkpoint_ms, .checkpoint_time = checkpoint_time};
+    bool worker_started = false;
+    int rc = 1;
+    if (!ingest) {
+        perror(data_dir);
+        goto out;
+    }
+    if (keyfile) {
+        int keys = Ingest_LoadKeys(ingest, keyfile);
+        if (keys < 0) {
+            perror(keyfile);
+            goto out;
+        }
+        fprintf(stderr, "loaded %d node keys\n", keys);
+    }
+    IngestStats_t stats;
+    Ingest_GetStats(ingest, &stats);
+    if (stats.replayed > 0) {
+        fprintf(stderr, "recovered %llu frames from the WAL\n", (unsigned long long)stats.replayed);
+    }
+    if (broker) {
+        if (!(publisher = Publisher_Start(&pub_cfg)) || Ingest_AddTap(ingest, Publisher_Tap, publisher) != 0) {
+            perror("mqtt publisher");
+            goto out;
+        }
+    }
+    if (stream_port >= 0) {
+        StreamConfig_t stream_cfg;
+        Stream_DefaultConfig(&stream_cfg);
+        stream_cfg.port = (uint16_t)stream_port;
+        stream_cfg.metrics = metrics;
+        if (!(stream = StreamServer_Start(&stream_cfg)) || Ingest_AddTap(ingest, StreamServer_Tap, stream) != 0) {
+            perror("stream server");
+            goto out;
+        }
+        fprintf(stderr, "streaming on ws://127.0.0.1:%u/stream\n", StreamServer_Port(stream));
+    }
+    if (detect) {
+        AnomalyConfig_t anomaly_cfg;
+        Anomaly_DefaultConfig(&anomaly_cfg);
+        anomaly_cfg.expected_series = cfg.expected_nodes * FIELD_COUNT;
+        anomaly_cfg.sink = log_anomaly;
+        anomaly_cfg.metrics = metrics;
+        if (!(detector = Anomaly_Create(&anomaly_cfg)) || Ingest_AddTap(ingest, Anomaly_Tap, detector) != 0) {
+            perror("anomaly detector");
+            goto out;
+        }
+    }
+    if (rules_path) {
+        AlertConfig_t alert_cfg;
+        char err[160];
+        Alert_DefaultConfig(&alert_cfg);
+        alert_cfg.expected_series = cfg.expected_nodes * FIELD_COUNT;
+        alert_cfg.sink = log_alert;
+        alert_cfg.metrics = metrics;
+        if (!(alerts = Alert_Create(&alert_cfg))) {
+            perror("alert rules");
+            goto out;
+        }
+        int rules = Alert_LoadRules(alerts, rules_path, err, sizeof(err));
+        if (rules < 0) {
+            if (errno == EINVAL) {
+                fprintf(stderr, "%s: %s\n", rules_path, err);
+            } else {
+                perror(rules_path);
+            }
+            goto out;
+        }
+        if (Ingest_AddTap(ingest, Alert_Tap, alerts) != 0) {
+            perror("alert rules");
+            goto out;
+        }
+        fprintf(stderr, "loaded %d alert rules\n", rules);
+    }
+    if (capture_path && !(capture = CaptureWriter_Open(capture_path))) {
+        perror(capture_path);
+        goto out;
+    }
+    DownlinkConfig_t downlink_cfg;
+    Downlink_DefaultConfig(&downlink_cfg);
+    downlink_cfg.expected_nodes = cfg.expected_nodes;
+    if (!(downlink = Downlink_Create(&downlink_cfg))) {
+        perror("downlink");
+        goto out;
+    }
+    if (slot_ms) {
+        SlotConfig_t slot_cfg;
+        Slots_DefaultConfig(&slot_cfg);
+        slot_cfg.slot_ms = slot_ms;
+        slot_cfg.tolerance_ms = slot_ms / 5 ? slot_ms / 5 : 1;
+        slot_cfg.expected_nodes = cfg.expected_nodes;
+        slot_cfg.metrics = metrics;
+        if (!(slots = Slots_Create(&slot_cfg))) {
+            perror("slot planner");
+            goto out;
+        }
+    }
+    if (ota_version) {
+        char dir[512];
+        OtaConfig_t ota_cfg;
+        Ota_DefaultConfig(&ota_cfg);
+        ota_cfg.slot_ms = slot_ms;
+        ota_cfg.expected_nodes = cfg.expected_nodes;
+        ota_cfg.metrics = metrics;
+        snprintf(dir, sizeof(dir), "%s/firmware", data_dir);
+        if (!(ota = Ota_Open(dir, &ota_cfg)) || Ota_SetTarget(ota, ota_version) != 0) {
+            perror("ota");
+            goto out;
+        }
+    }
+    if (!(radio = UdpRadio_Open(udp_port))) {
+        perror("udp radio");
+        goto out;
+    }
+    if (compact && !(compactor = Compactor_Start(Ingest_Store(ingest), &compact_cfg))) {
+        perror("compactor");
+        goto out;
+    }
+    if (!(server = QueryServer_Start(query_socket, Ingest_Store(ingest), Ingest_Rollup(ingest)))) {
+        perror(query_socket);
+        goto out;
+    }
+    if (!(queue = Queue_Create(&queue_cfg))) {
+        perror("ingest queue");
+        goto out;
+    }
+    worker.queue = queue;
+    if (pthread_create(&worker.thread, NULL, ingest_worker, &worker) != 0) {
+        perror("ingest thread");
+        goto out;
+    }
+    worker_started = true;
+    if (metrics && !(exporter = MetricsExporter_Start(metrics, (uint16_t)metrics_port))) {
+        perror("metrics endpoint");
+        goto out;
+    }
+
+    int64_t next_tick = now_ms() + 1000;
+    while (running) {
+        Frame_t batch[INGEST_BATCH];
+        uint8_t prio[INGEST_BATCH];
+        size_t n = 0;
+        // Frames queued up behind the first are taken without waiting and ingested together
+        while (n < INGEST_BATCH && UdpRadio_Receive(radio, &batch[n], n == 0 ? 100 : 0) > 0) {
+            Frame_t *frame = &batch[n];
+            Metrics_Inc(received);
+            // First, while the node's poll is on its way: the ACK payload must be loaded before it arrives
+            FrameHeader_t hdr;
+            FrameOta_t req;
+            DownlinkMsg_t msg;
+            int parsed = Frame_ParseHeader(frame, &hdr);
+            if (parsed == 0) {
+                if (hdr.flags & FRAME_FLAG_TIME_REQ) {
+                    queue_time(downlink, hdr.node, frame->rx_ts);
+                }
+                if (hdr.type == FRAME_TYPE_OTA) {
+                    if (ota && Frame_DecodeOta(frame, &req) == 0 &&
+                        Ota_Request(ota, hdr.node, &req, frame->rx_ts, &msg) == 1) {
+                        Downlink_Enqueue(downlink, &msg);
+                    }
+                } else {
+                    if (slots && Slots_Observe(slots, hdr.node, frame->rx_ts, &msg) == 1) {
+                        Downlink_Enqueue(downlink, &msg);
+                    }
+                    if (ota && Ota_Observe(ota, hdr.node, frame->rx_ts, &msg) == 1) {
+                        Downlink_Enqueue(downlink, &msg);
+                    }
+                }
+                if (Downlink_Next(downlink, hdr.node, frame->rx_ts, &msg) == 1) {
+                    Control_Stamp(msg.payload, msg.len, frame->rx_ts);
+                    UdpRadio_SendAck(radio, msg.payload, msg.len);
+                }
+            }
+            prio[n] = parsed == 0 ? frame_priority(&hdr, frame->rx_ts) : PRIO_BACKLOG;
+            if (capture && CaptureWriter_Append(capture, frame) != 0) {
+                perror(capture_path);
+                CaptureWriter_Close(capture);
+                capture = NULL;
+            }
+            // OTA requests carry no samples
+            n += parsed != 0 || hdr.type != FRAME_TYPE_OTA;
+        }
+        // Runs of one priority go in together
+        for (size_t i = 0; i < n;) {
+            size_t j = i + 1;
+            while (j < n && prio[j] == prio[i]) {
+                ++j;
+            }
+            Queue_Push(queue, &batch[i], j - i, prio[i]);
+            i = j;
+        }
+        int64_t now = now_ms();
+        Downlink_Poll(downlink, now);
+        if (now >= next_tick) {
+            if (capture) {
+                CaptureWriter_Flush(capture);
+            }
+            next_tick = now + 1000;
+        }
+    }
+    rc = 0;
+
+out:
+    // Ingest stores what is queued before it goes
+    if (worker_started) {
+        Queue_Close(queue);
+        __atomic_store_n(&worker.stop, 1, __ATOMIC_RELEASE);
+        pthread_join(worker.thread, NULL);
+    }
+    Queue_Destroy(queue);
+    MetricsExporter_Stop(exporter);
+    QueryServer_Stop(server);
+    UdpRadio_Close(radio);
+    Slots_Destroy(slots);
+    Ota_Close(ota);
+    Downlink_Destroy(downlink);
+    CaptureWriter_Close(capture);
+    Compactor_Stop(compactor);
+    // Ingest feeds the publisher and the stream through its taps, so they go last
+    Ingest_Close(ingest);
+    Publisher_Stop(publisher);
+    StreamServer_Stop(stream);
+    Anomaly_Destroy(detector);
+    Alert_Destroy(alerts);
+    Metrics_Destroy(metrics);
+    return rc;
+}
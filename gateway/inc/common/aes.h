@@ -0,0 +1,55 @@
+#ifndef AES_H
+/*
+ * File: aes.h
+ * Description: AES-128 block encryption. Frames only use modes built on the
+ *              forward cipher (CTR, CMAC), so there is no decryption.
+ *
+ *              Besides the portable table version there are AES-NI (x86)
+ *              and ARMv8 Crypto Extension (Pi 3 and later on a 64-bit
+ *              kernel) versions; the best one the CPU supports is picked
+ *              once at run time. All share the standard key schedule, so an
+ *              expanded key works with any of them.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Hardware backends and multi-block encryption.
+ *
+ */
+#define AES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AES_BLOCK_LEN 16
+#define AES_KEY_LEN 16
+
+typedef struct {
+    uint8_t round_keys[176];
+} Aes128_t;
+
+typedef struct {
+    const char *name;
+    void (*encrypt)(const Aes128_t *aes, const uint8_t in[AES_BLOCK_LEN], uint8_t out[AES_BLOCK_LEN]);
+    // out[i] = E(keys[i], in[i]). The blocks are independent, so hardware versions keep several in
+    // flight at once; in and out may be the same array.
+    void (*encrypt_blocks)(const Aes128_t *const *keys, const uint8_t (*in)[AES_BLOCK_LEN],
+                           uint8_t (*out)[AES_BLOCK_LEN], size_t n);
+} AesBackend_t;
+
+void Aes128_Init(Aes128_t *aes, const uint8_t key[AES_KEY_LEN]);
+
+// Through the selected backend
+void Aes128_Encrypt(const Aes128_t *aes, const uint8_t in[AES_BLOCK_LEN], uint8_t out[AES_BLOCK_LEN]);
+void Aes128_EncryptBlocks(const Aes128_t *const *keys, const uint8_t (*in)[AES_BLOCK_LEN],
+                          uint8_t (*out)[AES_BLOCK_LEN], size_t n);
+
+// Best backend for this CPU, or the one named by GATEWAY_AES in the environment
+const AesBackend_t *Aes_Get(void);
+// "portable", "aesni" or "armv8"; NULL if not built in or not supported
+const AesBackend_t *Aes_ByName(const char *name);
+
+#endif // AES_H
@@ -0,0 +1,60 @@
+#ifndef ARENA_H
+/*
+ * File: arena.h
+ * Description: Bump allocator for scratch state that lives exactly as long
+ *              as one batch of frames. Allocations are carved from a block
+ *              in order and never freed one by one; Arena_Reset drops them
+ *              all at once when the batch is stored.
+ *
+ *              A batch that outgrows the block gets extra blocks; at the next
+ *              reset they are replaced by one block as large as the batch
+ *              needed, so a steady load settles on a single block and no
+ *              malloc at all. With block_bytes 0 every allocation is its own
+ *              malloc, freed at reset: the general-purpose allocator, for
+ *              comparison.
+ *
+ *              Not thread-safe: one arena per thread or per batch in flight.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGN 16
+
+typedef struct ArenaBlock ArenaBlock_t;
+
+typedef struct {
+    uint64_t allocs;     // Arena_Alloc calls
+    uint64_t bytes;      // Bytes handed out
+    uint64_t mallocs;    // Blocks taken from the system allocator
+    uint64_t resets;
+    size_t high_water;   // Most bytes one batch used
+    size_t reserved;     // Bytes held in blocks now
+} ArenaStats_t;
+
+typedef struct {
+    ArenaBlock_t *blocks; // Current block first
+    size_t block_bytes;
+    size_t used;          // Bytes of the whole batch so far
+    ArenaStats_t stats;
+} Arena_t;
+
+void Arena_Init(Arena_t *arena, size_t block_bytes); // Allocates nothing until first use
+void Arena_Free(Arena_t *arena);
+
+// ARENA_ALIGN aligned; NULL if the system allocator fails
+void *Arena_Alloc(Arena_t *arena, size_t size);
+
+// Ends the batch: everything allocated since the last reset is gone
+void Arena_Reset(Arena_t *arena);
+
+#endif // ARENA_H
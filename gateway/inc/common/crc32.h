@@ -0,0 +1,23 @@
+#ifndef CRC32_H
+/*
+ * File: crc32.h
+ * Description: CRC-32 (IEEE 802.3) used to detect torn writes in on-disk records.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Slicing-by-8.
+ *
+ */
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pass 0 as crc for a fresh checksum, or a previous result to continue it
+uint32_t Crc32_Update(uint32_t crc, const void *data, size_t len);
+
+#endif // CRC32_H
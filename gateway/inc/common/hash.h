@@ -0,0 +1,41 @@
+#ifndef HASH_H
+/*
+ * File: hash.h
+ * Description: Integer mixing for the gateway's open-addressing tables.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define HASH_H
+
+#include <stdint.h>
+
+// splitmix64 finalizer: sequential node addresses spread over the whole table
+static inline uint64_t Hash_U64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint32_t Hash_RoundUpPow2(uint32_t v) {
+    if (v < 2) {
+        return 2;
+    }
+    v--;
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    return v + 1;
+}
+
+#endif // HASH_H
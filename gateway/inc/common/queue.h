@@ -0,0 +1,103 @@
+#ifndef QUEUE_H
+/*
+ * File: queue.h
+ * Description: Bounded queue of fixed-size items between two pipeline stages,
+ *              such as the radio and ingest, or ingest and the MQTT publisher.
+ *              Memory is fixed at capacity items; what happens to an item
+ *              that does not fit is the queue's policy:
+ *
+ *                  block         the producer waits for room
+ *                  drop-newest   the item is refused
+ *                  drop-oldest   the oldest queued item is dropped for it
+ *                  drop-low-prio the oldest item of the lowest priority
+ *                                queued is dropped for it, if that priority
+ *                                is not above its own; otherwise it is refused
+ *                  spill         the item goes to a spill file, read back in
+ *                                order as the consumer catches up; once the
+ *                                file holds spill_max bytes items are refused
+ *
+ *              Items come out in the order they went in under every policy.
+ *              Priorities (0 lowest, up to QUEUE_PRIORITIES - 1) only matter
+ *              to drop-low-prio. The spill file is scratch space: it is
+ *              truncated on create and removed on destroy, and items in it
+ *              are lost if the process dies, as are those in memory.
+ *
+ *              Any number of producers and consumers; a push or pop of many
+ *              items takes the lock once. With metrics, the queue exports
+ *              gateway_<name>_queue_* counters, its depth and a histogram of
+ *              the time producers were blocked.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metrics/metrics.h"
+
+#define QUEUE_PRIORITIES 4
+
+typedef enum {
+    QUEUE_BLOCK = 0,
+    QUEUE_DROP_NEWEST,
+    QUEUE_DROP_OLDEST,
+    QUEUE_DROP_LOW_PRIO,
+    QUEUE_SPILL,
+} QueuePolicy_t;
+
+typedef struct {
+    const char *name;       // For metric names; [a-z_]
+    size_t item_size;
+    uint32_t capacity;      // Items held in memory
+    QueuePolicy_t policy;
+    const char *spill_path; // QUEUE_SPILL only
+    uint64_t spill_max;     // Bytes
+    void (*notify)(void *ctx); // Optional: called after a push into an empty queue, outside the lock
+    void *notify_ctx;
+    Metrics_t *metrics;     // Optional; must outlive the queue
+} QueueConfig_t;
+
+typedef struct {
+    uint64_t pushed;      // Accepted, spilled ones included
+    uint64_t popped;
+    uint64_t dropped;     // Refused on arrival
+    uint64_t evicted;     // Queued, then dropped to make room
+    uint64_t spilled;     // Written to the spill file
+    uint64_t blocked;     // Pushes that had to wait for room
+    uint64_t blocked_ns;
+    uint32_t depth;       // Items in memory
+    uint32_t high_water;
+    uint64_t spill_depth; // Items in the spill file
+} QueueStats_t;
+
+typedef struct Queue Queue_t;
+
+void Queue_DefaultConfig(QueueConfig_t *cfg);
+
+// NULL with errno set on bad configuration, no memory or no spill file
+Queue_t *Queue_Create(const QueueConfig_t *cfg);
+void Queue_Destroy(Queue_t *queue);
+
+// Items accepted; the rest were dropped. Blocks only under QUEUE_BLOCK.
+size_t Queue_Push(Queue_t *queue, const void *items, size_t n, uint8_t prio);
+
+// Up to max items, oldest first. Waits up to timeout_ms (-1: no limit) while
+// the queue is empty; 0 on timeout, or once closed and drained.
+size_t Queue_Pop(Queue_t *queue, void *out, size_t max, int timeout_ms);
+
+// Wakes everyone: blocked and later pushes drop their items, pops drain what is left
+void Queue_Close(Queue_t *queue);
+
+void Queue_GetStats(Queue_t *queue, QueueStats_t *stats);
+
+const char *Queue_PolicyName(QueuePolicy_t policy);
+int Queue_PolicyFromName(const char *name); // -1 if unknown
+
+#endif // QUEUE_H
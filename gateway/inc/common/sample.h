@@ -0,0 +1,36 @@
+#ifndef SAMPLE_H
+/*
+ * File: sample.h
+ * Description: Decoded sensor sample as it flows through the gateway pipeline.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define SAMPLE_H
+
+#include <stdint.h>
+
+typedef enum {
+    FIELD_TEMPERATURE = 0, // degC
+    FIELD_HUMIDITY,        // %RH
+    FIELD_PRESSURE,        // hPa
+    FIELD_BATTERY,         // V
+    FIELD_COUNT,
+} SampleField_t;
+
+typedef struct {
+    int64_t ts;     // Milliseconds since Unix epoch
+    uint32_t node;  // Node address
+    uint8_t field;  // SampleField_t
+    float value;
+} Sample_t;
+
+const char *Sample_FieldName(SampleField_t field);
+int Sample_FieldFromName(const char *name); // -1 if unknown
+
+#endif // SAMPLE_H
@@ -0,0 +1,117 @@
+#ifndef SERIES_H
+/*
+ * File: series.h
+ * Description: Series identity, resolutions and mergeable rollup buckets.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define SERIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    SERIES_RES_RAW = 0,
+    SERIES_RES_1M,
+    SERIES_RES_1H,
+    SERIES_RES_1D,
+    SERIES_RES_COUNT,
+} SeriesRes_t;
+
+#define SERIES_MS_PER_MINUTE 60000LL
+#define SERIES_MS_PER_HOUR (60LL * SERIES_MS_PER_MINUTE)
+#define SERIES_MS_PER_DAY (24LL * SERIES_MS_PER_HOUR)
+
+// Series are keyed by (node, field, resolution) packed into one word
+typedef uint64_t SeriesKey_t;
+
+static inline SeriesKey_t Series_Key(uint32_t node, uint8_t field, uint8_t res) {
+    return ((uint64_t)node << 16) | ((uint64_t)field << 8) | res;
+}
+static inline uint32_t Series_KeyNode(SeriesKey_t key) { return (uint32_t)(key >> 16); }
+static inline uint8_t Series_KeyField(SeriesKey_t key) { return (uint8_t)(key >> 8); }
+static inline uint8_t Series_KeyRes(SeriesKey_t key) { return (uint8_t)key; }
+
+// Bucket width in milliseconds, 0 for raw
+int64_t Series_ResolutionMs(SeriesRes_t res);
+const char *Series_ResolutionName(SeriesRes_t res);
+int Series_ResolutionFromName(const char *name); // -1 if unknown
+
+// Floor division so pre-epoch timestamps still land in the right bucket
+static inline int64_t Series_BucketStart(int64_t ts, int64_t width) {
+    int64_t q = ts / width;
+    if ((ts % width) != 0 && ts < 0) {
+        --q;
+    }
+    return q * width;
+}
+
+/*
+ * Aggregate of all samples that fell into [start, start + width).
+ * Buckets are mergeable: a late sample for an already persisted bucket is
+ * written as another bucket with the same start and folded in on read.
+ */
+typedef struct {
+    int64_t start;
+    int64_t last_ts;
+    double sum;
+    uint32_t count;
+    float min;
+    float max;
+    float last;
+} SeriesBucket_t;
+
+static inline void SeriesBucket_Init(SeriesBucket_t *b, int64_t start) {
+    b->start = start;
+    b->last_ts = INT64_MIN;
+    b->sum = 0.0;
+    b->count = 0;
+    b->min = 0.0f;
+    b->max = 0.0f;
+    b->last = 0.0f;
+}
+
+static inline void SeriesBucket_Add(SeriesBucket_t *b, int64_t ts, float value) {
+    if (b->count == 0 || value < b->min) {
+        b->min = value;
+    }
+    if (b->count == 0 || value > b->max) {
+        b->max = value;
+    }
+    b->sum += value;
+    b->count++;
+    if (ts >= b->last_ts) {
+        b->last_ts = ts;
+        b->last = value;
+    }
+}
+
+static inline void SeriesBucket_Merge(SeriesBucket_t *dst, const SeriesBucket_t *src) {
+    if (src->count == 0) {
+        return;
+    }
+    if (dst->count == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (dst->count == 0 || src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->sum += src->sum;
+    dst->count += src->count;
+    if (src->last_ts >= dst->last_ts) {
+        dst->last_ts = src->last_ts;
+        dst->last = src->last;
+    }
+}
+
+static inline double SeriesBucket_Mean(const SeriesBucket_t *b) {
+    return b->count ? b->sum / b->count : 0.0;
+}
+
+#endif // SERIES_H
@@ -0,0 +1,73 @@
+#ifndef EXPORT_H
+/*
+ * File: export.h
+ * Description: Bulk export of raw series to CSV or Parquet, streamed from the
+ *              store chunk by chunk. One row per node and timestamp, with a
+ *              column per field:
+ *
+ *                  node, ts, temperature, humidity, pressure, battery
+ *
+ *              ts is Unix milliseconds; a field without a sample at that
+ *              timestamp is empty in CSV and null in Parquet.
+ *
+ *              Worker threads take one node at a time and merge its field
+ *              series in time order, decoding only the chunks that overlap
+ *              the next rows, so chunks of a series that overlap through
+ *              late data still come out sorted. Rows are cut into batches,
+ *              which the workers also encode (CSV text, or a Parquet row
+ *              group) before the calling thread writes them out. A fixed
+ *              pool of batches bounds memory regardless of the data size:
+ *              roughly batches * batch_rows * 130 bytes, plus one node's
+ *              chunk list and a few decoded chunks per worker.
+ *
+ *              Each node's rows come out in time order, in batches of that
+ *              node only; with more than one thread, batches of different
+ *              nodes interleave.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define EXPORT_H
+
+#include <stdint.h>
+
+#include "storage/store.h"
+
+typedef enum {
+    EXPORT_CSV = 0,
+    EXPORT_PARQUET,
+} ExportFormat_t;
+
+typedef struct {
+    ExportFormat_t format;
+    int64_t from;          // Rows with ts in [from, to)
+    int64_t to;
+    const uint32_t *nodes; // NULL: every node in the store
+    uint32_t n_nodes;
+    uint32_t threads;      // Decoding and encoding workers
+    uint32_t batch_rows;   // Rows per batch, and per Parquet row group
+    uint32_t batches;      // Batches in flight
+} ExportConfig_t;
+
+typedef struct {
+    uint64_t rows;
+    uint64_t samples; // Non-empty cells
+    uint64_t chunks;  // Sealed chunks decoded
+    uint64_t batches;
+    uint64_t bytes;   // Written to the output
+} ExportStats_t;
+
+void Export_DefaultConfig(ExportConfig_t *cfg);
+
+// -1 with errno set on a store, memory or write error; stats may be NULL
+int Export_Run(SeriesStore_t *store, const ExportConfig_t *cfg, int fd, ExportStats_t *stats);
+
+const char *Export_FormatName(ExportFormat_t format);
+int Export_FormatFromName(const char *name); // -1 if unknown
+
+#endif // EXPORT_H
@@ -0,0 +1,87 @@
+#ifndef PARQUET_H
+/*
+ * File: parquet.h
+ * Description: Minimal Parquet writer for flat tables of INT32, INT64 and
+ *              FLOAT columns, required or optional. A file is written front
+ *              to back without seeking, so it can go to a pipe:
+ *
+ *                  "PAR1" <row group> ... <footer> <footer len> "PAR1"
+ *
+ *              Each row group holds one uncompressed v1 data page per column.
+ *              Integers are DELTA_BINARY_PACKED, which takes regular
+ *              timestamps and a constant node column down to a few bits a
+ *              row; floats are PLAIN. Optional columns carry RLE definition
+ *              levels. Column chunks carry min/max statistics so readers can
+ *              skip row groups.
+ *
+ *              Column chunks are encoded independently, so several threads
+ *              can encode row groups while one writes them out in any order.
+ *              The writer keeps each row group's metadata for the footer,
+ *              a few hundred bytes per row group.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define PARQUET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    PARQUET_INT32 = 1, // Physical type numbers as in the format
+    PARQUET_INT64 = 2,
+    PARQUET_FLOAT = 4,
+} ParquetType_t;
+
+typedef enum {
+    PARQUET_PLAIN_TYPE = 0,
+    PARQUET_UINT32,       // On INT32
+    PARQUET_TIMESTAMP_MS, // On INT64, Unix milliseconds
+} ParquetLogical_t;
+
+typedef struct {
+    const char *name;
+    uint8_t type;    // ParquetType_t
+    uint8_t logical; // ParquetLogical_t
+    bool optional;
+} ParquetColumn_t;
+
+// One encoded column chunk
+typedef struct {
+    uint64_t size;  // Page header and page
+    uint64_t values;
+    uint64_t nulls;
+    bool has_stats; // False when every value is null or NaN
+    uint8_t min[8]; // PLAIN encoded
+    uint8_t max[8];
+} ParquetChunk_t;
+
+typedef struct ParquetWriter ParquetWriter_t;
+
+// Upper bound on Parquet_EncodeColumn output
+size_t Parquet_ColumnBound(const ParquetColumn_t *col, uint32_t rows);
+
+// values holds one entry per row, int32_t, int64_t or float; present is NULL if every row has a value,
+// else rows without one are skipped. Returns bytes written to out.
+size_t Parquet_EncodeColumn(const ParquetColumn_t *col, const void *values, const uint8_t *present, uint32_t rows,
+                            uint8_t *out, ParquetChunk_t *chunk);
+
+// Writes the leading magic; cols must outlive the writer
+ParquetWriter_t *Parquet_Open(int fd, const ParquetColumn_t *cols, uint32_t n_cols);
+
+// data holds the row group's column chunks back to back, as chunks[] describes them
+int Parquet_WriteRowGroup(ParquetWriter_t *w, const uint8_t *data, const ParquetChunk_t *chunks, uint32_t rows);
+
+// Writes the footer; -1 if it or any earlier write failed. Without it the file is unreadable.
+int Parquet_Finish(ParquetWriter_t *w);
+void Parquet_Free(ParquetWriter_t *w);
+
+uint64_t Parquet_Bytes(const ParquetWriter_t *w);
+
+#endif // PARQUET_H
@@ -0,0 +1,29 @@
+#ifndef METRICS_EXPORTER_H
+/*
+ * File: exporter.h
+ * Description: Minimal HTTP endpoint for Prometheus scrapes, bound to
+ *              127.0.0.1. Answers "GET /metrics" with the registry in text
+ *              exposition format and closes the connection; anything else
+ *              gets a 404. One request at a time from its own thread, so a
+ *              scrape never runs on the ingest path.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define METRICS_EXPORTER_H
+
+#include <stdint.h>
+
+#include "metrics/metrics.h"
+
+typedef struct MetricsExporter MetricsExporter_t;
+
+MetricsExporter_t *MetricsExporter_Start(Metrics_t *metrics, uint16_t port);
+void MetricsExporter_Stop(MetricsExporter_t *exporter);
+
+#endif // METRICS_EXPORTER_H
@@ -0,0 +1,141 @@
+#ifndef METRICS_H
+/*
+ * File: metrics.h
+ * Description: Process metrics without locks on the hot path. Counters and
+ *              histograms live in per-thread shards: each thread increments
+ *              its own slots with plain relaxed loads and stores (no lock
+ *              prefix, no shared cache lines) and a scrape sums the shards.
+ *              Gauges are single values set with relaxed atomics.
+ *
+ *              Histograms are log-linear (HDR style): 8 sub-buckets per power
+ *              of two, so any recorded value is known to within 12.5%, from
+ *              0 to 2^37 (about 137 s in ns). Exported with power-of-two "le"
+ *              bounds, which fall on bucket edges.
+ *
+ *              Metrics are registered at startup and never removed. A name
+ *              may carry labels, e.g. "stage_seconds{stage=\"wal\"}"; metrics
+ *              of one family must be registered together so they export under
+ *              one HELP/TYPE header. Collectors add values that other modules
+ *              already count, such as IngestStats_t, at scrape time.
+ *
+ *              A shard outlives its thread and is reused by the next thread
+ *              that needs one, so counters never go backwards. Destroy the
+ *              registry only after the threads that used it have exited.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define METRICS_MAX 256
+#define METRICS_MAX_SLOTS 8192 // Per shard: a counter takes 1, a histogram METRICS_HIST_SLOTS
+#define METRICS_MAX_COLLECTORS 16
+#define METRICS_HIST_SUB_BITS 3
+#define METRICS_HIST_MAX_EXP 36
+#define METRICS_HIST_BUCKETS ((METRICS_HIST_MAX_EXP - METRICS_HIST_SUB_BITS + 2) << METRICS_HIST_SUB_BITS)
+#define METRICS_HIST_SLOTS (METRICS_HIST_BUCKETS + 1) // Plus the sum
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} MetricType_t;
+
+typedef struct Metrics Metrics_t;
+
+// Handle returned by registration; slot is -1 when registration failed, and
+// updates through such a handle are ignored
+typedef struct {
+    Metrics_t *metrics;
+    int32_t slot;
+} Metric_t;
+
+// Appends lines in exposition format to out at scrape time
+typedef void (*MetricsCollector_t)(void *ctx, FILE *out);
+
+Metrics_t *Metrics_Create(void);
+void Metrics_Destroy(Metrics_t *metrics);
+
+Metric_t Metrics_Counter(Metrics_t *metrics, const char *name, const char *help);
+Metric_t Metrics_Gauge(Metrics_t *metrics, const char *name, const char *help);
+// Values are recorded in ns and exported in seconds when scale is 1e-9
+Metric_t Metrics_Histogram(Metrics_t *metrics, const char *name, const char *help, double scale);
+int Metrics_AddCollector(Metrics_t *metrics, MetricsCollector_t fn, void *ctx);
+void Metrics_RemoveCollector(Metrics_t *metrics, MetricsCollector_t fn, void *ctx);
+
+// Shard of the calling thread, created on first use
+uint64_t *Metrics_ThreadSlots(Metrics_t *metrics);
+
+typedef struct {
+    const Metrics_t *owner;
+    uint64_t *slots;
+} MetricsThreadCache_t;
+
+extern __thread MetricsThreadCache_t metrics_thread_cache;
+
+static inline uint64_t *metrics_slots(Metrics_t *metrics) {
+    if (metrics_thread_cache.owner == metrics) {
+        return metrics_thread_cache.slots;
+    }
+    return Metrics_ThreadSlots(metrics);
+}
+
+// Single writer per slot: the scrape only needs untorn loads, not RMW atomics
+static inline void metrics_bump(uint64_t *slot, uint64_t n) {
+    __atomic_store_n(slot, __atomic_load_n(slot, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t Metrics_HistBucket(uint64_t value) {
+    if (value < (1u << METRICS_HIST_SUB_BITS)) {
+        return (uint32_t)value;
+    }
+    uint32_t exp = 63u - (uint32_t)__builtin_clzll(value);
+    if (exp > METRICS_HIST_MAX_EXP) {
+        return METRICS_HIST_BUCKETS - 1;
+    }
+    uint32_t sub = (uint32_t)(value >> (exp - METRICS_HIST_SUB_BITS)) & ((1u << METRICS_HIST_SUB_BITS) - 1);
+    return ((exp - METRICS_HIST_SUB_BITS + 1) << METRICS_HIST_SUB_BITS) + sub;
+}
+
+static inline void Metrics_Add(Metric_t counter, uint64_t n) {
+    if (counter.slot >= 0) {
+        metrics_bump(&metrics_slots(counter.metrics)[counter.slot], n);
+    }
+}
+
+static inline void Metrics_Inc(Metric_t counter) {
+    Metrics_Add(counter, 1);
+}
+
+static inline void Metrics_Observe(Metric_t hist, uint64_t value) {
+    if (hist.slot >= 0) {
+        uint64_t *slots = metrics_slots(hist.metrics) + hist.slot;
+        metrics_bump(&slots[Metrics_HistBucket(value)], 1);
+        metrics_bump(&slots[METRICS_HIST_BUCKETS], value);
+    }
+}
+
+void Metrics_Set(Metric_t gauge, double value);
+void Metrics_GaugeAdd(Metric_t gauge, double delta);
+
+// Merged over all shards
+uint64_t Metrics_CounterValue(Metric_t counter);
+double Metrics_GaugeValue(Metric_t gauge);
+// Upper bound of the bucket holding quantile q in [0, 1]; 0 if empty
+uint64_t Metrics_Quantile(Metric_t hist, double q);
+
+// Whole registry in Prometheus text exposition format 0.0.4
+int Metrics_Write(Metrics_t *metrics, FILE *out);
+
+// Helpers for collectors
+void Metrics_WriteValue(FILE *out, const char *name, const char *help, MetricType_t type, double value);
+
+#endif // METRICS_H
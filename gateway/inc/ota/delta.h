@@ -0,0 +1,51 @@
+#ifndef DELTA_H
+/*
+ * File: delta.h
+ * Description: Binary delta between two firmware images for OTA transfers.
+ *              A delta is a list of operations that rebuild the new image
+ *              front to back, either copying a run of the old image or
+ *              inserting literal bytes. A node can apply it as the chunks
+ *              arrive, reading its running image and writing the other flash
+ *              bank, so it never has to hold the delta itself.
+ *
+ *                  0xxxxxxx [len]           insert x + 1 literal bytes, which follow
+ *                  1xxxxxxx [len] offset    copy x + DELTA_MIN_MATCH bytes of the old
+ *                                           image from where the last copy ended
+ *                                           plus offset
+ *
+ *              An x of 127 adds a LEB128 length after the op byte; the offset
+ *              is a zigzag LEB128. Copies are addressed relative to where the
+ *              last one ended, so the common cases cost one byte: code that
+ *              is unchanged, and code shifted by an inserted function.
+ *
+ *              The encoder indexes every DELTA_MIN_MATCH-byte window of the
+ *              old image and extends matches greedily. At each position it
+ *              first tries the old image in step with the last copy, so a
+ *              constant or relocated pointer changed in otherwise identical
+ *              code becomes a short insert and a copy that carries on.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DELTA_MIN_MATCH 8
+
+// *out is malloc'd; -1 if out of memory
+int Delta_Encode(const uint8_t *old, size_t old_len, const uint8_t *img, size_t img_len, uint8_t **out,
+                 size_t *out_len);
+
+// Bytes of the new image written to out; -1 with errno EINVAL if the delta is malformed,
+// reaches outside old or does not fit out_cap
+ptrdiff_t Delta_Apply(const uint8_t *old, size_t old_len, const uint8_t *delta, size_t delta_len, uint8_t *out,
+                      size_t out_cap);
+
+#endif // DELTA_H
@@ -0,0 +1,103 @@
+#ifndef OTA_H
+/*
+ * File: ota.h
+ * Description: OTA distribution server. Firmware builds are kept in a
+ *              directory as fw-<version>.bin. Nodes report their running
+ *              version in FRAME_TYPE_OTA frames; while a rollout target is
+ *              set, a node on another version is offered the update in an ACK
+ *              payload and then pulls it chunk by chunk, one FRAME_TYPE_OTA
+ *              request per chunk, so a lost chunk is simply asked for again
+ *              and the server keeps no per-chunk state.
+ *
+ *              The transfer is a delta from the node's running build when one
+ *              is stored and the delta saves at least min_saving percent,
+ *              else the whole image. Deltas are made the first time a node
+ *              on a version asks, saved as delta-<from>-<to>.bin next to the
+ *              builds, and kept in memory up to cache_bytes, least recently
+ *              used out first.
+ *
+ *              The update shares the channel with telemetry, so it is
+ *              throttled twice over. At most max_active nodes fetch at once,
+ *              others wait their turn and are offered the update on a later
+ *              frame. The active nodes are told to space their requests so
+ *              that together they ask for chunk_rate chunks per second, and
+ *              a token bucket at that rate refuses any excess; a refused
+ *              node backs off and asks again. An active node that goes quiet
+ *              for stall_ms gives up its place. With TDMA slots, nodes are
+ *              asked to time their requests between the slots: ESB retries
+ *              after a fixed delay, so a request that hits a report would
+ *              keep hitting it until both are lost.
+ *
+ *              Receive thread only, bar Ota_AddBuild and Ota_SetTarget
+ *              before frames flow.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define OTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metrics/metrics.h"
+#include "proto/frame.h"
+#include "radio/downlink.h"
+
+typedef struct {
+    uint32_t max_active;  // Nodes fetching at once
+    uint32_t chunk_rate;  // Chunks per second, whole fleet
+    uint32_t stall_ms;    // An active node without a request this long gives up its place
+    uint32_t min_saving;  // Percent a delta must save over the whole image
+    uint32_t slot_ms;     // TDMA slot length, 0 if nodes are not slotted
+    size_t cache_bytes;   // Deltas held in memory
+    uint32_t expected_nodes;
+    Metrics_t *metrics;   // Optional
+} OtaConfig_t;
+
+typedef struct {
+    uint64_t offers;
+    uint64_t chunks;
+    uint64_t chunk_bytes;
+    uint64_t throttled;    // Chunk requests refused by the rate limit
+    uint64_t deferred;     // Nodes kept waiting by max_active
+    uint64_t stalled;
+    uint64_t updated;      // Nodes that came back on the target version
+    uint64_t delta_hits;
+    uint64_t delta_misses; // Read back from disk or made
+    uint64_t delta_made;
+    uint64_t delta_ns;     // Spent making deltas
+    uint32_t nodes;
+    uint32_t current;      // On the target, or all nodes without one
+    uint32_t waiting;
+    uint32_t active;
+} OtaStats_t;
+
+typedef struct OtaServer OtaServer_t;
+
+void Ota_DefaultConfig(OtaConfig_t *cfg);
+
+// Loads the builds stored in dir, creating it if needed
+OtaServer_t *Ota_Open(const char *dir, const OtaConfig_t *cfg);
+void Ota_Close(OtaServer_t *ota);
+
+// Stores a build; -1 with errno EEXIST if the version is stored with other contents
+int Ota_AddBuild(OtaServer_t *ota, uint16_t version, const void *image, size_t len);
+const uint8_t *Ota_Build(const OtaServer_t *ota, uint16_t version, size_t *len);
+
+// Rolls the fleet out to version, which must be stored; 0 stops the rollout
+int Ota_SetTarget(OtaServer_t *ota, uint16_t version);
+
+// Every telemetry frame: 1 with an offer in msg when the node's turn has come
+int Ota_Observe(OtaServer_t *ota, uint32_t node, int64_t rx_ms, DownlinkMsg_t *msg);
+
+// A FRAME_TYPE_OTA frame: 1 with an offer or chunk in msg, 0 if nothing to send, -1 if out of memory
+int Ota_Request(OtaServer_t *ota, uint32_t node, const FrameOta_t *req, int64_t rx_ms, DownlinkMsg_t *msg);
+
+void Ota_GetStats(const OtaServer_t *ota, OtaStats_t *stats);
+
+#endif // OTA_H
@@ -0,0 +1,116 @@
+#ifndef ALERT_H
+/*
+ * File: alert.h
+ * Description: User-defined alert rules, compiled once and checked against
+ *              every sample. A rule watches one field, of one node or of all
+ *              of them:
+ *
+ *                  [node <addr>] <test> {and|or <test>} [for <duration>]
+ *                  test     := <field> [<window>] <cmp> <number> [<unit>] [/<duration>]
+ *                  window   := rise|drop|change|avg|min|max [<duration>]
+ *                  cmp      := < <= > >= == !=
+ *                  duration := <number>ms|s|m|min|h|d
+ *
+ *                  node 0x1000 pressure drop > 3 hPa/3h
+ *                  battery < 3.3 V for 1h
+ *                  humidity avg 1h > 95 %RH or humidity < 5 %RH
+ *
+ *              "and" binds tighter than "or". rise and drop compare the
+ *              latest value with the oldest one in the window, change is
+ *              either of them; the duration follows the window word or the
+ *              threshold. Units are checked against the field, and mV
+ *              is converted. With "for" the rule must hold on every sample
+ *              for that long before it fires.
+ *
+ *              A rule compiles to a few fixed-size instructions: fused
+ *              compares of a value or window aggregate against a constant,
+ *              then and/or in postfix. Each window keeps ALERT_WINDOW_BUCKETS
+ *              buckets of first, min, max and sum, so the state per rule and
+ *              node is fixed and a window edge is accurate to a sixteenth of
+ *              its length.
+ *
+ *              Rules are indexed by node and field: a series' rules are
+ *              gathered when it is first seen, so a sample costs one table
+ *              lookup and the rules that name its series. An alert is raised
+ *              when a rule starts holding and cleared when it stops. Samples
+ *              older than the series' last one only update the windows.
+ *
+ *              Not thread-safe; fed from the ingest tap, which serialises it.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define ALERT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sample.h"
+#include "metrics/metrics.h"
+
+#define ALERT_MAX_TESTS 8
+#define ALERT_MAX_WINDOWS 4
+#define ALERT_WINDOW_BUCKETS 16
+
+typedef struct {
+    int64_t ts;
+    uint32_t rule; // As returned by Alert_AddRule
+    uint32_t node;
+    uint8_t field; // SampleField_t
+    bool raised;   // false when the rule stopped holding
+    float value;   // The sample that raised or cleared it
+    const char *text; // The rule as written
+} Alert_t;
+
+typedef void (*AlertSink_t)(void *ctx, const Alert_t *alert);
+
+typedef struct {
+    uint32_t expected_series;
+    AlertSink_t sink; // Optional
+    void *sink_ctx;
+    Metrics_t *metrics; // Optional
+} AlertConfig_t;
+
+typedef struct {
+    uint64_t samples;
+    uint64_t late;
+    uint64_t evaluations; // Rule checks, over all samples
+    uint64_t raised;
+    uint64_t cleared;
+    uint32_t rules;
+    uint32_t series;
+    uint32_t instances; // Rule state for one node, windows included
+} AlertStats_t;
+
+typedef struct AlertEngine AlertEngine_t;
+
+void Alert_DefaultConfig(AlertConfig_t *cfg);
+
+AlertEngine_t *Alert_Create(const AlertConfig_t *cfg);
+void Alert_Destroy(AlertEngine_t *eng);
+
+// Returns the rule id, or -1 with errno EINVAL and the reason in err
+int Alert_AddRule(AlertEngine_t *eng, const char *text, char *err, size_t err_len);
+
+// One rule per line, '#' starts a comment. Returns the rules added, or -1
+// with errno set; a rule that does not compile is reported in err with its line
+int Alert_LoadRules(AlertEngine_t *eng, const char *path, char *err, size_t err_len);
+
+// NULL for an unknown id
+const char *Alert_RuleText(const AlertEngine_t *eng, uint32_t rule);
+
+// Returns the alerts raised and cleared
+size_t Alert_Feed(AlertEngine_t *eng, const Sample_t *samples, size_t n);
+
+// IngestTap_t adaptor, ctx is the engine
+void Alert_Tap(void *ctx, const Sample_t *samples, size_t n);
+
+void Alert_GetStats(const AlertEngine_t *eng, AlertStats_t *stats);
+
+#endif // ALERT_H
@@ -0,0 +1,97 @@
+#ifndef ANOMALY_H
+/*
+ * File: anomaly.h
+ * Description: Streaming anomaly detection per node and field. Each series
+ *              keeps 40 bytes of state in one open-addressing table: an EWMA
+ *              mean and variance, the last value and timestamp, and when the
+ *              value last changed. Every sample is checked for
+ *
+ *                  outlier  |x - mean| > z * std, once past warmup samples
+ *                  rate     |dx| > max_rate * dt + 3 * min_std
+ *                  stuck    the same value for longer than stuck_ms
+ *
+ *              An alert is raised when a check starts failing and not again
+ *              until the series has passed it once, so a broken sensor gives
+ *              one alert rather than one per sample. Samples older than the
+ *              series' last one only update the statistics.
+ *
+ *              Not thread-safe; fed from the ingest tap, which serialises it.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define ANOMALY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sample.h"
+#include "metrics/metrics.h"
+
+typedef enum {
+    ANOMALY_OUTLIER = 0,
+    ANOMALY_RATE,
+    ANOMALY_STUCK,
+    ANOMALY_KIND_COUNT,
+} AnomalyKind_t;
+
+typedef struct {
+    int64_t ts;
+    uint32_t node;
+    uint8_t field; // SampleField_t
+    uint8_t kind;  // AnomalyKind_t
+    float value;
+    float expected; // EWMA mean, or the previous value for rate and stuck
+    float score;    // Deviations from the mean, units per second, or seconds stuck
+} Anomaly_t;
+
+typedef void (*AnomalySink_t)(void *ctx, const Anomaly_t *anomaly);
+
+typedef struct {
+    float min_std;     // Floor under the EWMA deviation, about the sensor's noise
+    float max_rate;    // Units per second, 0 to disable
+    uint32_t stuck_ms; // 0 to disable
+} AnomalyLimits_t;
+
+typedef struct {
+    float alpha;         // EWMA weight of a new sample
+    float z;             // Outlier threshold in deviations
+    uint16_t warmup;     // Samples before outliers are checked
+    uint32_t max_gap_ms; // Rate is not checked across longer gaps
+    AnomalyLimits_t limits[FIELD_COUNT];
+    uint32_t expected_series;
+    AnomalySink_t sink; // Optional
+    void *sink_ctx;
+    Metrics_t *metrics; // Optional
+} AnomalyConfig_t;
+
+typedef struct {
+    uint64_t samples;
+    uint64_t late;
+    uint64_t series;
+    uint64_t alerts[ANOMALY_KIND_COUNT];
+} AnomalyStats_t;
+
+typedef struct AnomalyDetector AnomalyDetector_t;
+
+void Anomaly_DefaultConfig(AnomalyConfig_t *cfg);
+
+AnomalyDetector_t *Anomaly_Create(const AnomalyConfig_t *cfg);
+void Anomaly_Destroy(AnomalyDetector_t *det);
+
+// Returns the alerts raised
+size_t Anomaly_Feed(AnomalyDetector_t *det, const Sample_t *samples, size_t n);
+
+// IngestTap_t adaptor, ctx is the detector
+void Anomaly_Tap(void *ctx, const Sample_t *samples, size_t n);
+
+void Anomaly_GetStats(const AnomalyDetector_t *det, AnomalyStats_t *stats);
+
+const char *Anomaly_KindName(AnomalyKind_t kind);
+
+#endif // ANOMALY_H
@@ -0,0 +1,46 @@
+#ifndef DEDUP_H
+/*
+ * File: dedup.h
+ * Description: Duplicate frame suppression. Enhanced ShockBurst retries and
+ *              store-and-forward resends deliver the same frame more than
+ *              once. Each node keeps a 128-bit window of the sequence numbers
+ *              below the highest one seen, so checking a frame is a bit test
+ *              on state already in the node registry, with no storage access.
+ *
+ *              A frame further than the window behind is taken as a node
+ *              restart (its sequence counter starts over) and resets the
+ *              window.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Window state moved into the node registry.
+ *
+ */
+#define DEDUP_H
+
+#include <stdint.h>
+
+#define DEDUP_WINDOW 128
+
+typedef enum {
+    DEDUP_NEW = 0,   // Newest sequence number so far
+    DEDUP_LATE,      // Older than the newest but not seen before
+    DEDUP_DUPLICATE, // Already seen, drop it
+    DEDUP_RESET,     // Far behind the window: node restarted
+} DedupResult_t;
+
+// All zero is an empty window: bit 0 is set once any frame was seen
+typedef struct {
+    uint64_t bits[2]; // bits[0] bit i: top - i seen; bits[1] bit i: top - 64 - i seen
+    uint16_t top;
+} DedupWindow_t;
+
+// Records seq as seen unless it is a duplicate. skipped gets the number of
+// sequence numbers jumped over by a DEDUP_NEW frame (0 otherwise).
+DedupResult_t DedupWindow_Check(DedupWindow_t *window, uint16_t seq, uint32_t *skipped);
+
+#endif // DEDUP_H
@@ -0,0 +1,137 @@
+#ifndef INGEST_H
+/*
+ * File: ingest.h
+ * Description: Ingest path from received frame to storage. Every frame is
+ *              appended to the WAL before it is decoded into the series store
+ *              and rollup engine, so a crash loses at most the records the WAL
+ *              had not yet synced (bounded by its group commit delay).
+ *              With a reorder lateness set, decoded samples pass through the
+ *              reorder stage (pipeline/reorder.h) on their way to storage.
+ *
+ *              Sealed frames are verified and decrypted before the ingest
+ *              lock is taken, in batches (Frame_UnsealBatch) with expanded
+ *              keys from a per-node key cache (pipeline/keycache.h), so
+ *              threads calling Ingest_Frames do their crypto in parallel and
+ *              only serialise on duplicate checks, WAL and storage. A node
+ *              with a key must seal every frame: a clear one from it is
+ *              rejected before it can touch the node's duplicate window.
+ *
+ *              A batch's scratch state (decrypted copies, crypto jobs, keys
+ *              and decoded samples) comes from a bump arena that is reset
+ *              once the batch is stored, so the steady-state path makes no
+ *              malloc calls. Its samples reach the store, rollup and taps in
+ *              one call.
+ *
+ *              A checkpoint seals and syncs the store and records its end in
+ *              the WAL together with the rollup buckets still in memory, then
+ *              saves the node registry and the store's index. On open the
+ *              store is rewound to the last checkpoint, opened from its index
+ *              and segment footers, the rollup buckets are restored, and only
+ *              the WAL tail after it is replayed, so nothing is applied twice
+ *              and a restart does not read back the data it already indexed.
+ *
+ *                  <dir>/wal/...     WAL segments and checkpoint
+ *                  <dir>/nodes.snap  node registry as of the checkpoint
+ *                  <dir>/index.snap  index of the open segments, likewise
+ *                  <dir>/raw/...     series store
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Duplicate frames dropped before the WAL.
+ *   - <18-10-2026>: Per-node state kept in the node registry.
+ *   - <18-10-2026>: Encrypted frames verified and decrypted before the WAL.
+ *   - <18-10-2026>: Node key files.
+ *   - <18-10-2026>: Stage latency histograms and stats export through metrics.
+ *   - <18-10-2026>: Sample taps for downstream consumers.
+ *   - <18-10-2026>: Optional reorder stage before storage.
+ *   - <18-10-2026>: Batched decryption outside the lock with a key cache.
+ *   - <18-10-2026>: Per-batch scratch arena.
+ *   - <18-10-2026>: Rollup buckets kept in the checkpoint; store index saved with it.
+ *   - <18-10-2026>: Clear frames from nodes with a key rejected.
+ *
+ */
+#define INGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metrics/metrics.h"
+#include "pipeline/reorder.h"
+#include "proto/frame.h"
+#include "registry/registry.h"
+#include "rollup/rollup.h"
+#include "storage/store.h"
+#include "storage/wal.h"
+
+#define INGEST_MAX_TAPS 8
+
+typedef struct Ingest Ingest_t;
+
+// Sees samples as they are stored, under the ingest lock: must not block
+typedef void (*IngestTap_t)(void *ctx, const Sample_t *samples, size_t n);
+
+typedef struct {
+    WalConfig_t wal;
+    SeriesStoreConfig_t store;
+    RollupConfig_t rollup;
+    ReorderConfig_t reorder; // lateness_ms 0 turns the stage off
+    uint32_t expected_nodes; // Initial size of per-node tables
+    size_t arena_bytes;      // Batch scratch block (common/arena.h); 0 mallocs every allocation
+    Metrics_t *metrics;      // Optional; must outlive the ingest
+} IngestConfig_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t samples;
+    uint64_t malformed;
+    uint64_t duplicates;    // Retries and resends dropped by sequence number
+    uint64_t late;          // Out of order but new
+    uint64_t seq_resets;    // Node sequence counters that started over
+    uint64_t auth_failures; // Bad tags, sealed frames from unkeyed nodes, clear ones from keyed nodes
+    uint64_t out_of_window; // Samples older than the reorder window, merged late
+    uint64_t replayed;      // WAL records applied during recovery
+    uint64_t scratch_allocs;  // Batch scratch allocations, from idle arenas
+    uint64_t scratch_mallocs; // Blocks those arenas took from malloc
+    uint64_t scratch_peak;    // Most scratch bytes one batch used
+    uint64_t scratch_reserved;
+} IngestStats_t;
+
+void Ingest_DefaultConfig(IngestConfig_t *cfg);
+
+// Opens WAL, store and rollup under dir and recovers them; cfg may be NULL
+Ingest_t *Ingest_Open(const char *dir, const IngestConfig_t *cfg);
+void Ingest_Close(Ingest_t *ingest); // Checkpoints first
+
+#define INGEST_BATCH 32 // Frames per lock hold and decryption batch
+
+// Logs and applies one frame unless it is a duplicate; does not wait for the WAL sync
+int Ingest_Frame(Ingest_t *ingest, const Frame_t *frame);
+// Ingest_Frame on each frame in order, taking the lock once per INGEST_BATCH; safe from several threads
+int Ingest_Frames(Ingest_t *ingest, const Frame_t *frames, size_t n);
+
+// Frame key for a node's sealed frames (proto/seal.h)
+int Ingest_SetKey(Ingest_t *ingest, uint32_t node, const uint8_t key[16]);
+// Key file with one "<node> <32 hex digits>" per line; keys loaded or -1
+int Ingest_LoadKeys(Ingest_t *ingest, const char *path);
+
+int Ingest_Checkpoint(Ingest_t *ingest); // Releases what the reorder stage holds first
+
+// Once a second: releases reorder buffers of quiet nodes and persists rollup buckets past their grace
+int Ingest_Tick(Ingest_t *ingest, int64_t now_ms);
+
+// Taps see samples as they are stored, after the reorder stage; not called for WAL replay during Ingest_Open
+int Ingest_AddTap(Ingest_t *ingest, IngestTap_t fn, void *ctx);
+
+SeriesStore_t *Ingest_Store(Ingest_t *ingest);
+RollupEngine_t *Ingest_Rollup(Ingest_t *ingest);
+Wal_t *Ingest_Wal(Ingest_t *ingest);
+NodeRegistry_t *Ingest_Registry(Ingest_t *ingest); // Unlocked: only from the thread calling Ingest_Frame
+
+void Ingest_GetStats(Ingest_t *ingest, IngestStats_t *stats);
+int Ingest_GetReorderStats(Ingest_t *ingest, ReorderStats_t *stats); // -1 when the stage is off
+
+#endif // INGEST_H
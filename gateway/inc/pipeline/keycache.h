@@ -0,0 +1,43 @@
+#ifndef KEYCACHE_H
+/*
+ * File: keycache.h
+ * Description: Expanded frame keys per node. The registry keeps each node's
+ *              raw key, which costs a key schedule and a CMAC subkey block
+ *              before every frame could be checked; the cache keeps the
+ *              expanded FrameKey_t instead, derived once when the key is set.
+ *
+ *              The cache has its own lock, so frames can be verified and
+ *              decrypted on any thread without the ingest lock. Lookups copy
+ *              keys out, so a key replaced meanwhile never changes under a
+ *              frame being checked.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define KEYCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "proto/seal.h"
+
+typedef struct KeyCache KeyCache_t;
+
+KeyCache_t *KeyCache_Create(uint32_t expected_nodes);
+void KeyCache_Destroy(KeyCache_t *cache);
+
+// An all-zero key clears the node's key
+int KeyCache_Put(KeyCache_t *cache, uint32_t node, const uint8_t raw[AES_KEY_LEN]);
+
+// keys[i] gets the key of nodes[i] and found[i] whether it has one, under one lock hold
+void KeyCache_Get(KeyCache_t *cache, const uint32_t *nodes, size_t n, FrameKey_t *keys, bool *found);
+
+uint32_t KeyCache_Count(KeyCache_t *cache); // Nodes with a key
+
+#endif // KEYCACHE_H
@@ -0,0 +1,73 @@
+#ifndef REORDER_H
+/*
+ * File: reorder.h
+ * Description: Reorder stage between decoding and storage. Store-and-forward
+ *              backlogs and delayed retries arrive late and out of order;
+ *              each node's samples are held in a bounded min-heap and
+ *              released in timestamp order once they are lateness_ms of event
+ *              time behind the newest sample seen from the node. Storage and
+ *              rollups then see in-order appends in the common case.
+ *
+ *              A sample older than what was already released for its node is
+ *              outside the window and is passed on at once, marked late, for
+ *              the slower merge path (head sorting in the store, correction
+ *              buckets in the rollup). A full heap releases its oldest sample
+ *              early, and Reorder_Tick releases everything a node holds once
+ *              it has sent nothing for hold_ms, so a node that goes quiet
+ *              does not keep its last samples back.
+ *
+ *              Not thread-safe; ingest serialises the calls.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define REORDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sample.h"
+
+// Released samples, in timestamp order per node unless late; non-zero stops the release
+typedef int (*ReorderEmit_t)(void *ctx, const Sample_t *samples, size_t n, bool late);
+
+typedef struct {
+    uint32_t lateness_ms; // Event time a sample waits for older ones
+    uint32_t hold_ms;     // Wall time without frames before a node's samples go out
+    uint32_t per_node;    // Samples held per node
+    uint32_t expected_nodes;
+} ReorderConfig_t;
+
+typedef struct {
+    uint64_t pushed;
+    uint64_t released;
+    uint64_t late;    // Passed on at once, outside the window
+    uint64_t forced;  // Released early by a full heap
+    uint64_t expired; // Released by Reorder_Tick
+    uint64_t held;
+    uint64_t bytes;   // Heaps and node table
+} ReorderStats_t;
+
+typedef struct ReorderBuffer ReorderBuffer_t;
+
+void Reorder_DefaultConfig(ReorderConfig_t *cfg);
+
+ReorderBuffer_t *Reorder_Create(const ReorderConfig_t *cfg, ReorderEmit_t emit, void *ctx);
+void Reorder_Destroy(ReorderBuffer_t *rb); // Drops what is held: flush first
+
+// Samples of one frame; arrival_ms is the gateway receive time
+int Reorder_Push(ReorderBuffer_t *rb, const Sample_t *samples, size_t n, int64_t arrival_ms);
+
+// Release the samples of nodes with no frame in the last hold_ms
+int Reorder_Tick(ReorderBuffer_t *rb, int64_t now_ms);
+int Reorder_Flush(ReorderBuffer_t *rb);
+
+void Reorder_GetStats(const ReorderBuffer_t *rb, ReorderStats_t *stats);
+
+#endif // REORDER_H
@@ -0,0 +1,128 @@
+#ifndef CONTROL_H
+/*
+ * File: control.h
+ * Description: Control messages the gateway sends to nodes in ACK payloads.
+ *              All integers are little-endian.
+ *
+ *                  0  u8   type (CONTROL_TYPE_*)
+ *
+ *              CONTROL_TYPE_SLOT, the node's transmit slot:
+ *
+ *                  1  u8   reserved
+ *                  2  u16  slot
+ *                  4  u32  period, ms
+ *                  8  u32  delay, ms, from the start of the frame this ACK
+ *                          answers to the start of the node's next report
+ *
+ *              The node reports every period from then on. The delay is
+ *              relative so that it holds whatever the node's clock reads.
+ *
+ *              CONTROL_TYPE_TIME, gateway time at the arrival of the frame
+ *              this ACK answers, for the node's clock discipline:
+ *
+ *                  1  u8   reserved
+ *                  2  u32  Unix seconds
+ *                  6  u16  ms
+ *
+ *              CONTROL_TYPE_OTA_OFFER, an update for the node to fetch with
+ *              FRAME_TYPE_OTA requests:
+ *
+ *                  1  u8   flags (CONTROL_OTA_*)
+ *                  2  u16  version the transfer applies to, with CONTROL_OTA_DELTA
+ *                  4  u16  version offered
+ *                  6  u32  transfer length
+ *                  10 u32  image length
+ *                  14 u32  image CRC-32
+ *                  18 u16  ms between the node's chunk requests
+ *                  20 u8   slot length, ms: the node starts each request half a
+ *                          slot after its own slot, between the reports of
+ *                          slotted nodes; 0 when not slotted
+ *
+ *              CONTROL_TYPE_OTA_CHUNK, part of the transfer:
+ *
+ *                  1  u8   reserved
+ *                  2  u16  version offered
+ *                  4  u32  transfer offset
+ *                  8  data, up to CONTROL_OTA_CHUNK_DATA bytes
+ *
+ *              Slot and time messages depend on when they are loaded: a queued slot
+ *              message carries the slot phase, a queued time message nothing
+ *              yet, and Control_Stamp fills them in as the ACK is loaded.
+ *
+ *              The type doubles as the downlink kind: a newer message of a
+ *              type replaces a queued one for the same node.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Time stamps.
+ *   - <18-10-2026>: OTA offers and chunks.
+ *
+ */
+#define CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    CONTROL_TYPE_SLOT = 1,
+    CONTROL_TYPE_TIME,
+    CONTROL_TYPE_OTA_OFFER,
+    CONTROL_TYPE_OTA_CHUNK,
+} ControlType_t;
+
+#define CONTROL_SLOT_LEN 12
+#define CONTROL_TIME_LEN 8
+#define CONTROL_OTA_OFFER_LEN 21
+#define CONTROL_OTA_CHUNK_HEADER 8
+#define CONTROL_OTA_CHUNK_DATA 24
+
+#define CONTROL_OTA_DELTA 0x01 // The transfer is a delta per ota/delta.h, else the whole image
+
+typedef struct {
+    uint16_t slot;
+    uint32_t period_ms;
+    uint32_t delay_ms; // Phase of the slot start in gateway time until stamped
+} ControlSlot_t;
+
+typedef struct {
+    uint32_t seconds;
+    uint16_t ms;
+} ControlTime_t;
+
+typedef struct {
+    uint8_t flags;
+    uint16_t from;
+    uint16_t to;
+    uint32_t transfer_len;
+    uint32_t image_len;
+    uint32_t image_crc;
+    uint16_t pace_ms;
+    uint8_t slot_ms;
+} ControlOtaOffer_t;
+
+typedef struct {
+    uint16_t to;
+    uint32_t offset;
+    uint8_t len;
+    const uint8_t *data;
+} ControlOtaChunk_t;
+
+size_t Control_EncodeSlot(uint8_t *payload, const ControlSlot_t *slot);
+int Control_DecodeSlot(const uint8_t *payload, size_t len, ControlSlot_t *slot);
+size_t Control_EncodeTime(uint8_t *payload, const ControlTime_t *time);
+int Control_DecodeTime(const uint8_t *payload, size_t len, ControlTime_t *time);
+size_t Control_EncodeOtaOffer(uint8_t *payload, const ControlOtaOffer_t *offer);
+int Control_DecodeOtaOffer(const uint8_t *payload, size_t len, ControlOtaOffer_t *offer);
+// Copies chunk->len bytes of data, at most CONTROL_OTA_CHUNK_DATA
+size_t Control_EncodeOtaChunk(uint8_t *payload, const ControlOtaChunk_t *chunk);
+// data points into payload
+int Control_DecodeOtaChunk(const uint8_t *payload, size_t len, ControlOtaChunk_t *chunk);
+
+// Fill in the load-time fields; rx_ms is when the frame the ACK answers arrived
+void Control_Stamp(uint8_t *payload, size_t len, int64_t rx_ms);
+
+#endif // CONTROL_H
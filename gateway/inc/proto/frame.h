@@ -0,0 +1,112 @@
+#ifndef FRAME_H
+/*
+ * File: frame.h
+ * Description: Radio frame as received by the gateway and the telemetry
+ *              payload layout sent by the nodes. Payloads fit the nRF24L01
+ *              32-byte limit; all integers are little-endian.
+ *
+ *              A node whose clock is disciplined to the gateway's sends only
+ *              the low 32 bits of its time in ms; the gateway expands them
+ *              against the receive time, which is good for frames up to 24
+ *              days old.
+ *
+ *                  0  u8   type (FRAME_TYPE_*)
+ *                  1  u8   flags (FRAME_FLAG_*)
+ *                  2  u32  node address
+ *                  6  u16  sequence number
+ *                  8  u32  node time, Unix seconds (valid with FRAME_FLAG_NODE_TIME),
+ *                          or Unix ms modulo 2^32 if FRAME_FLAG_TIME_MS is also set
+ *                  12 n x { u8 field, i16 value / scale }
+ *
+ *              FRAME_TYPE_OTA carries a node's firmware state instead of
+ *              readings, and asks for the next chunk of an update it is
+ *              fetching:
+ *
+ *                  12 u16  running firmware version
+ *                  14 u16  version being fetched, 0 for none
+ *                  16 u32  transfer offset of the chunk wanted, FRAME_OTA_STATUS
+ *                          when only reporting the version
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Encrypted flag.
+ *   - <18-10-2026>: Time request and ms node time flags.
+ *   - <18-10-2026>: OTA frames.
+ *
+ */
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sample.h"
+
+#define FRAME_MAX_PAYLOAD 32
+#define FRAME_HEADER_LEN 12
+#define FRAME_READING_LEN 3
+#define FRAME_MAX_READINGS ((FRAME_MAX_PAYLOAD - FRAME_HEADER_LEN) / FRAME_READING_LEN)
+
+typedef enum {
+    FRAME_TYPE_TELEMETRY = 1,
+    FRAME_TYPE_OTA,
+} FrameType_t;
+
+#define FRAME_OTA_LEN (FRAME_HEADER_LEN + 8)
+#define FRAME_OTA_STATUS UINT32_MAX
+
+#define FRAME_FLAG_NODE_TIME 0x01 // Node clock is synchronised, use its timestamp
+#define FRAME_FLAG_ENCRYPTED 0x02 // Readings sealed per proto/seal.h
+#define FRAME_FLAG_TIME_REQ 0x04  // Node wants the gateway time in its next ACK payload
+#define FRAME_FLAG_TIME_MS 0x08   // Node time is in ms, modulo 2^32
+
+// As received, with link metadata
+typedef struct {
+    int64_t rx_ts;   // Gateway receive time, ms
+    uint8_t pipe;    // nRF24 data pipe
+    uint8_t rpd;     // Received power detector (signal above -64 dBm)
+    uint8_t len;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+} Frame_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t node;
+    uint16_t seq;
+    uint32_t node_time;
+} FrameHeader_t;
+
+typedef struct {
+    uint8_t field;
+    float value;
+} FrameReading_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t fetching;
+    uint32_t offset;
+} FrameOta_t;
+
+// Returns payload length, or 0 if the readings do not fit
+size_t Frame_Encode(uint8_t *payload, const FrameHeader_t *hdr, const FrameReading_t *readings, size_t n);
+
+// 0 on success, -1 if the payload is too short or of unknown type
+int Frame_ParseHeader(const Frame_t *frame, FrameHeader_t *hdr);
+
+// Decoded samples written to out (up to max); -1 on malformed payload or not telemetry
+int Frame_Decode(const Frame_t *frame, Sample_t *out, size_t max);
+
+size_t Frame_EncodeOta(uint8_t *payload, const FrameHeader_t *hdr, const FrameOta_t *ota);
+// -1 unless a well-formed FRAME_TYPE_OTA frame
+int Frame_DecodeOta(const Frame_t *frame, FrameOta_t *ota);
+
+// Fixed-width record used by the WAL and capture files
+#define FRAME_RECORD_MAX (8 + 3 + FRAME_MAX_PAYLOAD)
+size_t Frame_Serialize(const Frame_t *frame, uint8_t *out);
+int Frame_Deserialize(const uint8_t *in, size_t len, Frame_t *frame);
+
+#endif // FRAME_H
@@ -0,0 +1,90 @@
+#ifndef SEAL_H
+/*
+ * File: seal.h
+ * Description: Encrypted telemetry frames. The 12-byte header stays in the
+ *              clear so the gateway can route and deduplicate; the readings
+ *              are encrypted with AES-128-CTR (the header is the nonce) and a
+ *              4-byte AES-CMAC tag over header and ciphertext is appended:
+ *
+ *                  0  header, FRAME_FLAG_ENCRYPTED set
+ *                  12 n x 3 bytes ciphertext
+ *                  .. u8[4] tag
+ *
+ *              Each node has its own 128-bit key.
+ *
+ *              CTR is only safe while no two frames of a node share a nonce,
+ *              and the nonce is the header: type, flags, node, seq and node
+ *              time. The u16 seq wraps and restarts when a node reboots, so
+ *              a sealed frame must carry its node time (FRAME_FLAG_NODE_TIME)
+ *              and a node must never reuse a seq within one tick of its
+ *              clock, a second or a millisecond with FRAME_FLAG_TIME_MS, not
+ *              even across a reboot. Frame_Seal refuses a frame without node
+ *              time and Frame_Unseal rejects one.
+ *
+ *              Receivers also check the node time against their own
+ *              (Frame_SealFresh). That keeps out a node whose clock was lost
+ *              and would repeat old nonces, and bounds how old a replayed
+ *              frame can be; within FRAME_SEAL_MAX_AGE_MS only the duplicate
+ *              window stands in its way.
+ *
+ *              Frame_UnsealBatch checks many frames at once. A frame costs
+ *              three or four dependent AES blocks, too short a chain to keep
+ *              AES hardware busy; across a batch the blocks of different
+ *              frames are interleaved instead, with each frame's own key.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Batched verification and decryption.
+ *   - <18-10-2026>: Node time required in sealed frames; freshness check.
+ *
+ */
+#define SEAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/aes.h"
+#include "proto/frame.h"
+
+#define FRAME_TAG_LEN 4
+#define FRAME_MAX_SEALED_READINGS ((FRAME_MAX_PAYLOAD - FRAME_HEADER_LEN - FRAME_TAG_LEN) / FRAME_READING_LEN)
+
+// How far a sealed frame's node time may be behind the receive time (store-and-forward backlogs) or ahead of it
+#define FRAME_SEAL_MAX_AGE_MS (24 * 3600 * 1000LL)
+#define FRAME_SEAL_MAX_AHEAD_MS (5 * 60 * 1000LL)
+
+// Expanded key: round keys plus the CMAC subkeys, derived once per node
+typedef struct {
+    Aes128_t aes;
+    uint8_t k1[AES_BLOCK_LEN];
+    uint8_t k2[AES_BLOCK_LEN];
+} FrameKey_t;
+
+void FrameKey_Init(FrameKey_t *key, const uint8_t raw[AES_KEY_LEN]);
+
+// Encrypts an encoded frame in place; new length, or 0 if the tag does not fit or the frame has no node time
+size_t Frame_Seal(uint8_t *payload, size_t len, const FrameKey_t *key);
+
+// Verifies and decrypts in place, clearing the flag; plaintext length or -1
+int Frame_Unseal(uint8_t *payload, size_t len, const FrameKey_t *key);
+
+// Whether a sealed frame's node time is within the window around its rx_ts
+bool Frame_SealFresh(const Frame_t *frame);
+
+// One frame of a Frame_UnsealBatch call
+typedef struct {
+    uint8_t *payload;
+    size_t len;
+    const FrameKey_t *key; // NULL for a node without a key: rejected
+    int result;            // Out: as Frame_Unseal would return
+} FrameUnsealJob_t;
+
+// Frame_Unseal on every job
+void Frame_UnsealBatch(FrameUnsealJob_t *jobs, size_t n);
+
+#endif // SEAL_H
@@ -0,0 +1,63 @@
+#ifndef MQTT_H
+/*
+ * File: mqtt.h
+ * Description: The part of MQTT 3.1.1 a telemetry publisher needs: CONNECT,
+ *              PUBLISH at QoS 0 or 1, PUBACK, PINGREQ and DISCONNECT, plus
+ *              a parser for whole packets read from a stream. Also used by
+ *              the loopback broker stand-in in the benchmarks.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define MQTT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MQTT_MAX_REMAINING (1u << 20) // Larger packets are treated as malformed
+#define MQTT_FIXED_HEADER_MAX 5
+
+typedef enum {
+    MQTT_CONNECT = 1,
+    MQTT_CONNACK = 2,
+    MQTT_PUBLISH = 3,
+    MQTT_PUBACK = 4,
+    MQTT_PINGREQ = 12,
+    MQTT_PINGRESP = 13,
+    MQTT_DISCONNECT = 14,
+} MqttType_t;
+
+typedef struct {
+    MqttType_t type;
+    uint8_t flags;       // Low nibble of the fixed header
+    uint16_t packet_id;  // PUBLISH with QoS > 0, PUBACK
+    uint8_t return_code; // CONNACK
+    const uint8_t *topic;
+    uint16_t topic_len;
+    const uint8_t *payload; // PUBLISH; points into the parsed buffer
+    uint32_t payload_len;
+    const uint8_t *client_id; // CONNECT
+    uint16_t client_id_len;
+    uint16_t keepalive_s;
+} MqttPacket_t;
+
+// Encoders return the packet length written to out, or 0 if cap is too small
+size_t Mqtt_EncodeConnect(uint8_t *out, size_t cap, const char *client_id, uint16_t keepalive_s);
+size_t Mqtt_EncodeConnack(uint8_t *out, size_t cap, uint8_t return_code);
+size_t Mqtt_EncodePublish(uint8_t *out, size_t cap, const char *topic, size_t topic_len, const void *payload,
+                          size_t len, uint8_t qos, uint16_t packet_id, int dup);
+size_t Mqtt_EncodePuback(uint8_t *out, size_t cap, uint16_t packet_id);
+size_t Mqtt_EncodeSimple(uint8_t *out, size_t cap, MqttType_t type); // PINGREQ, PINGRESP, DISCONNECT
+
+// Bytes of a PUBLISH with this topic and payload length
+size_t Mqtt_PublishSize(size_t topic_len, size_t len, uint8_t qos);
+
+// Bytes consumed by one whole packet, 0 if more input is needed, -1 if malformed
+int Mqtt_Parse(const uint8_t *in, size_t len, MqttPacket_t *pkt);
+
+#endif // MQTT_H
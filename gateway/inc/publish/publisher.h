@@ -0,0 +1,95 @@
+#ifndef PUBLISHER_H
+/*
+ * File: publisher.h
+ * Description: MQTT publisher for decoded samples. Ingest hands samples over
+ *              through a bounded ring (common/queue.h) whose policy decides
+ *              what a full ring does. By default it refuses the samples, which
+ *              are counted, so ingest never waits on the broker; spill keeps
+ *              them on disk through a long outage. The publisher thread
+ *              batches them per node into one message on "<prefix>/<node>":
+ *
+ *                  {"node":4096,"samples":[[<ts_ms>,"temperature",21.53],...]}
+ *
+ *              A batch is sent when it holds max_batch samples or its oldest
+ *              sample is interval_ms old. At QoS 1 at most `window` messages
+ *              await PUBACK; the rest queue up to `queue` messages, past which
+ *              the oldest queued message is dropped. Unacknowledged messages
+ *              are resent with DUP after a reconnect, so delivery is at least
+ *              once while the queue holds. Reconnects back off exponentially
+ *              with jitter between backoff_min_ms and backoff_max_ms.
+ *
+ *              Under the block policy a full ring stalls the producer, and so
+ *              ingest, until the broker catches up.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Ring is a common/queue.h queue with a configurable policy.
+ *   - <18-10-2026>: Samples lost to failed allocations counted again.
+ *   - <18-10-2026>: Resends after a reconnect continue as the socket drains.
+ *
+ */
+#define PUBLISHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/queue.h"
+#include "common/sample.h"
+#include "metrics/metrics.h"
+
+typedef struct {
+    const char *host; // IPv4 address
+    uint16_t port;
+    const char *client_id;
+    const char *topic_prefix;
+    uint8_t qos;          // 0 or 1
+    uint32_t max_batch;   // Samples per message
+    uint32_t interval_ms; // Longest a sample waits for its batch to fill
+    uint32_t window;      // QoS 1 messages awaiting PUBACK
+    uint32_t queue;       // Messages waiting for the window
+    uint32_t ring;        // Samples between ingest and the publisher thread
+    QueuePolicy_t ring_policy;
+    const char *spill_path; // QUEUE_SPILL only
+    uint16_t keepalive_s;
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    Metrics_t *metrics; // Optional
+} PublisherConfig_t;
+
+typedef struct {
+    uint64_t offered;
+    uint64_t dropped_samples; // Refused or evicted by the ring policy, or lost to a failed allocation
+    uint64_t messages;        // Batches built
+    uint64_t dropped_messages; // Queue overflow
+    uint64_t published;        // Written to the socket, resends included
+    uint64_t acked;
+    uint64_t retransmits;
+    uint64_t reconnects;
+    uint64_t bytes;
+    uint32_t inflight;
+    uint32_t queued;
+    uint32_t connected;
+} PublisherStats_t;
+
+typedef struct Publisher Publisher_t;
+
+void Publisher_DefaultConfig(PublisherConfig_t *cfg);
+
+// Connects in the background; NULL only on bad configuration or no memory
+Publisher_t *Publisher_Start(const PublisherConfig_t *cfg);
+// Sends what is batched and queued if connected, waiting up to a second
+void Publisher_Stop(Publisher_t *pub);
+
+// Returns the samples accepted, the rest are dropped; blocks only under QUEUE_BLOCK
+size_t Publisher_Offer(Publisher_t *pub, const Sample_t *samples, size_t n);
+
+// IngestTap_t adaptor, ctx is the publisher
+void Publisher_Tap(void *ctx, const Sample_t *samples, size_t n);
+
+void Publisher_GetStats(Publisher_t *pub, PublisherStats_t *stats);
+
+#endif // PUBLISHER_H
@@ -0,0 +1,102 @@
+#ifndef STREAM_H
+/*
+ * File: stream.h
+ * Description: Live samples for dashboards over WebSocket (RFC 6455), on
+ *              127.0.0.1:<port>/stream. Ingest hands samples over through a
+ *              bounded drop-newest ring (common/queue.h), so it never waits
+ *              on a subscriber. The stream thread collects them into updates
+ *              of up to max_batch samples, at most interval_ms apart:
+ *
+ *                  {"samples":[[4096,1704067200000,"temperature",21.53],...]}
+ *
+ *              Each update is encoded once, WebSocket header included, into
+ *              an immutable reference-counted buffer. Every subscriber's send
+ *              queue holds a reference to the same buffer, which is freed
+ *              when the last one has sent it. Sockets are non-blocking and
+ *              written with writev from one epoll loop.
+ *
+ *              A subscriber with more than max_pending bytes queued is slow.
+ *              Under STREAM_SLOW_COALESCE its unsent updates are dropped and
+ *              replaced by one snapshot of the latest value of every series,
+ *              also built once and shared by all subscribers that fell
+ *              behind in the same round:
+ *
+ *                  {"snapshot":[[4096,1704067200000,"temperature",21.53],...]}
+ *
+ *              after which it gets live updates again. Under
+ *              STREAM_SLOW_DROP it is disconnected with status 1008.
+ *              Subscribers may send ping and close; other messages are
+ *              ignored.
+ *
+ *              A close frame gets a second to go out behind whatever was
+ *              half sent; a subscriber that does not read it is cut off
+ *              then, as is one that has not finished its handshake within
+ *              five seconds, so neither keeps its slot or its buffers.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Deadlines for closing and handshaking subscribers.
+ *
+ */
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sample.h"
+#include "metrics/metrics.h"
+
+typedef enum {
+    STREAM_SLOW_COALESCE = 0,
+    STREAM_SLOW_DROP,
+} StreamSlowPolicy_t;
+
+typedef struct {
+    uint16_t port;          // 0 picks a free one, see StreamServer_Port
+    uint32_t max_clients;
+    uint32_t interval_ms;   // Longest a sample waits for its update
+    uint32_t max_batch;     // Samples per update
+    size_t max_pending;     // Bytes queued for one subscriber before it is slow
+    StreamSlowPolicy_t slow;
+    uint32_t ring;          // Samples between ingest and the stream thread
+    Metrics_t *metrics;     // Optional; must outlive the server
+} StreamConfig_t;
+
+typedef struct {
+    uint64_t offered;
+    uint64_t dropped_samples; // Ring full
+    uint64_t updates;         // Encoded, once each
+    uint64_t update_bytes;
+    uint64_t snapshots;
+    uint64_t sent_bytes;      // To all subscribers together
+    uint64_t accepted;        // Handshakes completed
+    uint64_t rejected;        // Bad or unfinished handshakes, or no room
+    uint64_t coalesced;       // Times a slow subscriber's backlog was replaced
+    uint64_t dropped_slow;    // Slow subscribers disconnected
+    uint32_t clients;
+    uint32_t buffers;         // Shared buffers still referenced
+} StreamStats_t;
+
+typedef struct StreamServer StreamServer_t;
+
+void Stream_DefaultConfig(StreamConfig_t *cfg);
+
+// NULL with errno set if the port cannot be bound or on no memory
+StreamServer_t *StreamServer_Start(const StreamConfig_t *cfg);
+void StreamServer_Stop(StreamServer_t *server);
+
+uint16_t StreamServer_Port(const StreamServer_t *server);
+
+// Never blocks; returns the samples accepted, the rest are dropped
+size_t StreamServer_Offer(StreamServer_t *server, const Sample_t *samples, size_t n);
+
+// IngestTap_t adaptor, ctx is the server
+void StreamServer_Tap(void *ctx, const Sample_t *samples, size_t n);
+
+void StreamServer_GetStats(StreamServer_t *server, StreamStats_t *stats);
+
+#endif // STREAM_H
@@ -0,0 +1,40 @@
+#ifndef KERNELS_H
+/*
+ * File: kernels.h
+ * Description: Aggregation kernels over decoded value columns. Each set has a
+ *              scalar reference and SIMD versions (SSE2/AVX2 on x86, NEON on
+ *              the Pi); the best set the CPU supports is picked once at run
+ *              time. Inputs must not contain NaN.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *name;
+    // Accumulates in double so long columns match the scalar result
+    double (*sum)(const float *v, size_t n);
+    // n must be > 0
+    void (*min_max)(const float *v, size_t n, float *min, float *max);
+    // Values strictly above threshold
+    size_t (*count_above)(const float *v, size_t n, float threshold);
+    // bins[i] += values in [lo + i * width, lo + (i + 1) * width), ends clamped
+    void (*histogram)(const float *v, size_t n, float lo, float width, uint32_t *bins, uint32_t n_bins);
+} AggKernels_t;
+
+// Best set for this CPU, or the one named by GATEWAY_KERNELS in the environment
+const AggKernels_t *AggKernels_Get(void);
+const AggKernels_t *AggKernels_Scalar(void);
+// "scalar", "sse2", "avx2" or "neon"; NULL if not built in or not supported
+const AggKernels_t *AggKernels_ByName(const char *name);
+
+#endif // KERNELS_H
@@ -0,0 +1,79 @@
+#ifndef QUERY_H
+/*
+ * File: query.h
+ * Description: Range, aggregate and latest-value queries over one node and
+ *              field. Aggregates are split along bucket boundaries so the
+ *              coarsest rollup covers the middle of the range and raw
+ *              samples are only read for the sub-minute edges. Value filters
+ *              skip chunks whose zone map cannot match. Raw columns are
+ *              reduced with the SIMD kernels from kernels.h.
+ *
+ *              An engine keeps scratch buffers and is used by one thread.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Threshold counts and histograms on SIMD kernels.
+ *
+ */
+#define QUERY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/series.h"
+#include "rollup/rollup.h"
+#include "storage/store.h"
+
+typedef struct QueryEngine QueryEngine_t;
+
+typedef struct {
+    bool enabled;
+    float min; // Keep values (or buckets overlapping) [min, max]
+    float max;
+} QueryFilter_t;
+
+typedef struct {
+    uint64_t chunks_read;
+    uint64_t chunks_pruned; // Skipped by zone map without reading
+    uint64_t records_scanned;
+} QueryStats_t;
+
+// Return non-zero to stop; the value is passed back to the caller
+typedef int (*Query_PointFn)(int64_t ts, float value, void *ctx);
+typedef int (*Query_BucketFn)(const SeriesBucket_t *bucket, void *ctx);
+
+// rollup may be NULL, then only persisted rollup buckets are visible
+QueryEngine_t *Query_Create(SeriesStore_t *store, RollupEngine_t *rollup);
+void Query_Destroy(QueryEngine_t *q);
+
+// Raw samples with ts in [from, to), in time order; filter may be NULL
+int Query_Range(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to,
+                const QueryFilter_t *filter, Query_PointFn fn, void *ctx);
+
+// Rollup buckets with start in [from, to), corrections merged, in time order
+int Query_RangeBuckets(QueryEngine_t *q, uint32_t node, uint8_t field, uint8_t res, int64_t from, int64_t to,
+                       const QueryFilter_t *filter, Query_BucketFn fn, void *ctx);
+
+// Everything in [from, to) folded into one bucket (start = from)
+int Query_Aggregate(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to,
+                    SeriesBucket_t *out);
+
+// Raw samples in [from, to) strictly above threshold
+int Query_CountAbove(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to, float threshold,
+                     uint64_t *count);
+
+// bins[i] += raw samples in [lo + i * width, lo + (i + 1) * width), outliers in the end bins
+int Query_Histogram(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to, float lo, float width,
+                    uint32_t *bins, uint32_t n_bins);
+
+// 1 if found, 0 if the series is empty, -1 on error
+int Query_Latest(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t *ts, float *value);
+
+void Query_GetStats(const QueryEngine_t *q, QueryStats_t *stats);
+void Query_ResetStats(QueryEngine_t *q);
+
+#endif // QUERY_H
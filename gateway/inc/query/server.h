@@ -0,0 +1,46 @@
+#ifndef QUERY_SERVER_H
+/*
+ * File: server.h
+ * Description: Local query service on a Unix stream socket. One request per
+ *              line, answered with "OK <lines>" followed by that many result
+ *              lines, or "ERR <reason>". Times are Unix milliseconds, fields
+ *              are names or numbers, ranges are [from, to).
+ *
+ *                  LATEST <node> <field>
+ *                      -> <ts> <value>
+ *                  RANGE <node> <field> raw <from> <to> [<min> <max>]
+ *                      -> <ts> <value> ...
+ *                  RANGE <node> <field> 1m|1h|1d <from> <to> [<min> <max>]
+ *                      -> <start> <count> <min> <max> <mean> <last> ...
+ *                  AGG <node> <field> <from> <to>
+ *                      -> <count> <min> <max> <mean> <last_ts> <last>
+ *                  ABOVE <node> <field> <from> <to> <threshold>
+ *                      -> <count>
+ *                  HIST <node> <field> <from> <to> <lo> <width> <bins>
+ *                      -> <bin_lo> <count> ...
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: ABOVE and HIST requests.
+ *
+ */
+#define QUERY_SERVER_H
+
+#include "rollup/rollup.h"
+#include "storage/store.h"
+
+#define QUERY_SERVER_MAX_CLIENTS 32
+#define QUERY_SERVER_MAX_LINE 256
+#define QUERY_SERVER_MAX_BINS 256
+
+typedef struct QueryServer QueryServer_t;
+
+// Serves from its own thread until stopped; rollup may be NULL
+QueryServer_t *QueryServer_Start(const char *socket_path, SeriesStore_t *store, RollupEngine_t *rollup);
+void QueryServer_Stop(QueryServer_t *server);
+
+#endif // QUERY_SERVER_H
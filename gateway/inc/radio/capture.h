@@ -0,0 +1,56 @@
+#ifndef CAPTURE_H
+/*
+ * File: capture.h
+ * Description: Append-only capture of frames as received, before decryption
+ *              or deduplication, for replaying field traffic through the
+ *              pipeline. Records are buffered into blocks; each block carries
+ *              a CRC so a capture cut short by a crash reads up to its last
+ *              complete block.
+ *
+ *                  file:   "WCAP" u32 version  i64 created_ms
+ *                  block:  "CBLK" u32 bytes  u32 records  u32 crc  i64 base_ts
+ *                  record: varint zigzag(rx_ts - previous rx_ts)
+ *                          u8 pipe | rpd << 7   u8 len   payload
+ *
+ *              A telemetry frame takes about 4 + len bytes against the
+ *              11 + len of a WAL record.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define CAPTURE_H
+
+#include <stdint.h>
+
+#include "proto/frame.h"
+
+#define CAPTURE_BLOCK_BYTES (64 * 1024)
+
+typedef struct CaptureWriter CaptureWriter_t;
+typedef struct CaptureReader CaptureReader_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t blocks;
+    uint64_t bytes;
+} CaptureStats_t;
+
+// Appends to an existing capture or starts a new one
+CaptureWriter_t *CaptureWriter_Open(const char *path);
+int CaptureWriter_Append(CaptureWriter_t *writer, const Frame_t *frame);
+int CaptureWriter_Flush(CaptureWriter_t *writer); // Writes the open block
+int CaptureWriter_Close(CaptureWriter_t *writer);
+void CaptureWriter_GetStats(const CaptureWriter_t *writer, CaptureStats_t *stats);
+
+CaptureReader_t *CaptureReader_Open(const char *path);
+// 1 with a frame, 0 at the end or a torn tail, -1 on a read error
+int CaptureReader_Next(CaptureReader_t *reader, Frame_t *frame);
+void CaptureReader_Close(CaptureReader_t *reader);
+void CaptureReader_GetStats(const CaptureReader_t *reader, CaptureStats_t *stats);
+
+#endif // CAPTURE_H
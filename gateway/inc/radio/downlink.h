@@ -0,0 +1,98 @@
+#ifndef DOWNLINK_H
+/*
+ * File: downlink.h
+ * Description: Downlink scheduler for nRF24 ACK payloads. A node that wants
+ *              downlink follows its frame with a short poll; the gateway
+ *              has the time between the two to pick a payload for the node
+ *              and load it into the radio, which sends it with the poll's
+ *              auto-ACK. Picking is on the receive thread's critical path,
+ *              so it never takes a lock, allocates or frees.
+ *
+ *              Any thread may enqueue. Messages go onto a lock-free inbox
+ *              that only the receive thread drains into per-node queues,
+ *              one per priority class, each ordered by deadline. A pick
+ *              sorts in at most drain_batch messages, and only from an
+ *              inbox no longer than that; Downlink_Poll takes the rest. A
+ *              pick takes the earliest deadline of the highest priority for
+ *              the node, dropping expired messages on the way. A message
+ *              with a non-zero kind replaces a queued one of the same kind
+ *              for the node, so a newer time stamp or configuration
+ *              supersedes the old one instead of queueing behind it.
+ *
+ *              Messages live in entries allocated up front for the whole
+ *              capacity and recycled through a lock-free free list. Only
+ *              Downlink_Poll grows the node table; a pick leaves a message
+ *              for a new node waiting if the table has no room for it.
+ *
+ *              Bounded in total, and per node so that one node's OTA
+ *              transfer cannot take the space others need: past its quota a
+ *              node's least urgent message is dropped.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Preallocated entries; node table grown only when polling.
+ *
+ */
+#define DOWNLINK_H
+
+#include <stdint.h>
+
+#include "proto/frame.h"
+
+typedef enum {
+    DOWNLINK_PRIO_TIME = 0, // Time sync: worthless once late
+    DOWNLINK_PRIO_CONTROL,  // Configuration, slot assignment, OTA control
+    DOWNLINK_PRIO_BULK,     // OTA chunks
+    DOWNLINK_PRIO_COUNT,
+} DownlinkPrio_t;
+
+typedef struct {
+    uint32_t node;
+    uint8_t prio;        // DownlinkPrio_t
+    uint8_t kind;        // Non-zero: replaces a queued message of the same kind
+    uint8_t len;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    int64_t deadline_ms; // Dropped if not loaded by then; 0 for none
+    int64_t enqueued_ms;
+} DownlinkMsg_t;
+
+typedef struct {
+    uint32_t capacity;    // Messages queued in total, allocated up front
+    uint32_t per_node;    // Messages queued per node
+    uint32_t drain_batch; // Inbox messages sorted in per pick; the rest wait for Downlink_Poll
+    uint32_t expected_nodes;
+} DownlinkConfig_t;
+
+typedef struct {
+    uint64_t enqueued;
+    uint64_t rejected;  // Scheduler full
+    uint64_t replaced;  // Superseded by a message of the same kind
+    uint64_t quota_drops;
+    uint64_t expired;
+    uint64_t loaded;
+    uint64_t queued;
+} DownlinkStats_t;
+
+typedef struct DownlinkScheduler DownlinkScheduler_t;
+
+void Downlink_DefaultConfig(DownlinkConfig_t *cfg);
+
+DownlinkScheduler_t *Downlink_Create(const DownlinkConfig_t *cfg);
+void Downlink_Destroy(DownlinkScheduler_t *sched);
+
+// Any thread. -1 with errno EAGAIN when full, EINVAL for a bad message.
+int Downlink_Enqueue(DownlinkScheduler_t *sched, const DownlinkMsg_t *msg);
+
+// Receive thread only. 1 with the payload to load for node, 0 if none.
+int Downlink_Next(DownlinkScheduler_t *sched, uint32_t node, int64_t now_ms, DownlinkMsg_t *out);
+
+// Receive thread only, when idle: sorts in the whole inbox and drops expired messages
+void Downlink_Poll(DownlinkScheduler_t *sched, int64_t now_ms);
+
+void Downlink_GetStats(DownlinkScheduler_t *sched, DownlinkStats_t *stats);
+
+#endif // DOWNLINK_H
@@ -0,0 +1,67 @@
+#ifndef SLOTS_H
+/*
+ * File: slots.h
+ * Description: TDMA slot planner. Nodes that wake on the same schedule (a
+ *              fleet powered up together, or crystals that happen to agree)
+ *              transmit on top of each other, and ESB's fixed retry delay
+ *              keeps them colliding. The planner splits the reporting period
+ *              into slots and gives each node its own, filling the least used
+ *              slots first and, among those, the one nearest to where the
+ *              node already reports.
+ *
+ *              Every received frame is checked against its node's slot. A new
+ *              node, or one whose frames have drifted more than tolerance_ms
+ *              from the slot centre, gets a CONTROL_TYPE_SLOT message to send
+ *              down; the node moves its RTC wake-up schedule by the delay the
+ *              message carries. Clock drift is corrected the same way, one
+ *              message whenever a node wanders out of tolerance.
+ *
+ *              Receive thread only.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define SLOTS_H
+
+#include <stdint.h>
+
+#include "metrics/metrics.h"
+#include "radio/downlink.h"
+
+typedef struct {
+    uint32_t period_ms;    // Reporting interval the slots divide
+    uint32_t slot_ms;      // One report: airtime, ESB retries and clock error
+    uint32_t tolerance_ms; // Re-time a node whose frames are further than this off its slot centre
+    uint32_t expected_nodes;
+    Metrics_t *metrics;    // Optional
+} SlotConfig_t;
+
+typedef struct {
+    uint64_t in_slot;  // Frames within tolerance
+    uint64_t off_slot;
+    uint64_t assigned; // Slot messages issued to new nodes
+    uint64_t retimed;  // ... and to nodes that drifted
+    uint32_t nodes;
+    uint32_t slots;
+    uint32_t shared;   // Nodes beyond one per slot
+} SlotStats_t;
+
+typedef struct SlotPlanner SlotPlanner_t;
+
+void Slots_DefaultConfig(SlotConfig_t *cfg);
+
+SlotPlanner_t *Slots_Create(const SlotConfig_t *cfg);
+void Slots_Destroy(SlotPlanner_t *planner);
+
+// Frame from node received at rx_ms. 1 with a slot message in msg to enqueue
+// for the node, 0 if it is on time, -1 if out of memory.
+int Slots_Observe(SlotPlanner_t *planner, uint32_t node, int64_t rx_ms, DownlinkMsg_t *msg);
+
+void Slots_GetStats(const SlotPlanner_t *planner, SlotStats_t *stats);
+
+#endif // SLOTS_H
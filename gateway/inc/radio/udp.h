@@ -0,0 +1,47 @@
+#ifndef UDP_RADIO_H
+/*
+ * File: udp.h
+ * Description: UDP stand-in for the nRF24 receiver, used on hosts without a
+ *              radio and by the load tools. One datagram carries one frame:
+ *
+ *                  0  u8  pipe
+ *                  1  u8  rpd
+ *                  2  payload (up to FRAME_MAX_PAYLOAD bytes)
+ *
+ *              The receive time is taken by the gateway, as with the radio.
+ *              An ACK payload goes back to the sender of the last frame as a
+ *              datagram holding just the payload.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: ACK payloads.
+ *
+ */
+#define UDP_RADIO_H
+
+#include <stdint.h>
+
+#include "proto/frame.h"
+
+#define UDP_RADIO_DATAGRAM_MAX (2 + FRAME_MAX_PAYLOAD)
+
+typedef struct UdpRadio UdpRadio_t;
+
+// Binds 127.0.0.1:port
+UdpRadio_t *UdpRadio_Open(uint16_t port);
+void UdpRadio_Close(UdpRadio_t *radio);
+
+// 1 with a frame, 0 on timeout, -1 on error. Short datagrams are skipped.
+int UdpRadio_Receive(UdpRadio_t *radio, Frame_t *frame, int timeout_ms);
+
+// ACK payload for the sender of the last received frame; -1 if there is none
+int UdpRadio_SendAck(UdpRadio_t *radio, const uint8_t *payload, uint8_t len);
+
+// Datagram for frame->payload; returns its length
+int UdpRadio_Pack(const Frame_t *frame, uint8_t *out);
+
+#endif // UDP_RADIO_H
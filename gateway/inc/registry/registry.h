@@ -0,0 +1,96 @@
+#ifndef REGISTRY_H
+/*
+ * File: registry.h
+ * Description: Per-node state, in one flat open-addressing table keyed by
+ *              node address. The probe array holds only addresses, so a
+ *              lookup touches one or two cache lines; the state it finds is
+ *              split into a hot part used by every frame (32 bytes, two per
+ *              cache line) and a cold part (keys, link statistics, firmware
+ *              version, downlink queue) in a parallel array.
+ *
+ *              The table is a single block laid out exactly as in its
+ *              snapshot file, so a restart maps the file and starts using it
+ *              without parsing; a CRC over the whole block rejects a torn or
+ *              damaged snapshot. Pages are copy-on-write; nothing is written
+ *              back until the next Registry_Save.
+ *
+ *              Slots move when the table grows: do not keep a slot across
+ *              Registry_Upsert. Not thread-safe; ingest serialises the calls.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Snapshot tables covered by a CRC; offsets checked on load.
+ *
+ */
+#define REGISTRY_H
+
+#include <stdint.h>
+
+#include "pipeline/dedup.h"
+#include "proto/frame.h"
+
+#define REGISTRY_NO_SLOT (-1)
+#define REGISTRY_KEY_LEN 16
+#define REGISTRY_DOWNLINK_DEPTH 4
+
+// Touched by every frame
+typedef struct {
+    DedupWindow_t window;
+    uint32_t last_seen; // Gateway time, Unix seconds
+    uint32_t frames;
+} NodeHot_t;
+
+typedef struct {
+    uint32_t lost;       // Sequence numbers skipped and never filled in
+    uint32_t duplicates;
+    uint32_t late;
+    uint32_t resets;
+    uint32_t rpd_strong; // Frames received above -64 dBm
+    uint8_t last_pipe;
+} NodeLink_t;
+
+typedef struct {
+    uint8_t len;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+} DownlinkEntry_t;
+
+typedef struct {
+    uint8_t key[REGISTRY_KEY_LEN]; // AES-128 frame key, all zero if unset
+    uint32_t fw_version;
+    uint32_t first_seen;
+    NodeLink_t link;
+    uint8_t downlink_head;
+    uint8_t downlink_count;
+    DownlinkEntry_t downlink[REGISTRY_DOWNLINK_DEPTH];
+} NodeCold_t;
+
+typedef struct NodeRegistry NodeRegistry_t;
+
+NodeRegistry_t *Registry_Create(uint32_t expected_nodes);
+
+// Maps a snapshot; NULL if it is missing, damaged or was written by another layout
+NodeRegistry_t *Registry_Load(const char *path);
+int Registry_Save(const NodeRegistry_t *registry, const char *path); // tmp + fsync + rename
+void Registry_Destroy(NodeRegistry_t *registry);
+
+int32_t Registry_Find(const NodeRegistry_t *registry, uint32_t node); // REGISTRY_NO_SLOT if absent
+int32_t Registry_Upsert(NodeRegistry_t *registry, uint32_t node);     // Zeroed state when new
+
+NodeHot_t *Registry_Hot(NodeRegistry_t *registry, int32_t slot);
+NodeCold_t *Registry_Cold(NodeRegistry_t *registry, int32_t slot);
+uint32_t Registry_Node(const NodeRegistry_t *registry, int32_t slot);
+
+// Occupied slots in table order: start with REGISTRY_NO_SLOT, stop at REGISTRY_NO_SLOT
+int32_t Registry_Next(const NodeRegistry_t *registry, int32_t slot);
+
+uint32_t Registry_Count(const NodeRegistry_t *registry);
+
+// Queue a downlink payload for the node's next ACK; -1 if the queue is full
+int Registry_PushDownlink(NodeCold_t *cold, const uint8_t *payload, uint8_t len);
+int Registry_PopDownlink(NodeCold_t *cold, DownlinkEntry_t *out); // -1 if empty
+
+#endif // REGISTRY_H
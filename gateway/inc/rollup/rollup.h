@@ -0,0 +1,78 @@
+#ifndef ROLLUP_H
+/*
+ * File: rollup.h
+ * Description: Incremental 1-minute, 1-hour and 1-day rollups per node and
+ *              field. Only bucket aggregates are kept in memory: an open
+ *              bucket and the previous one, which stays mergeable for a grace
+ *              period so slightly late samples are folded in before it is
+ *              persisted. Anything later is persisted as a correction bucket
+ *              with the same start and merged on read. All calls are
+ *              thread-safe.
+ *
+ *              The buckets in memory can be saved with a checkpoint and
+ *              loaded into a fresh engine, so a restart does not persist
+ *              partial buckets that later samples would have to correct.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Snapshots for the query engine.
+ *   - <18-10-2026>: Saving and loading the in-memory buckets.
+ *   - <18-10-2026>: Buckets the store refuses stay held for the next tick or flush.
+ *
+ */
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sample.h"
+#include "common/series.h"
+#include "storage/store.h"
+
+typedef struct RollupEngine RollupEngine_t;
+
+typedef struct {
+    int64_t grace_ms[SERIES_RES_COUNT]; // How long past its end a bucket stays in memory
+} RollupConfig_t;
+
+typedef struct {
+    uint64_t samples;
+    uint64_t late_merged;      // Late samples folded into a bucket still in memory
+    uint64_t late_corrections; // Late samples persisted as correction buckets
+    uint64_t buckets_written;
+    uint32_t series;
+} RollupStats_t;
+
+void Rollup_DefaultConfig(RollupConfig_t *cfg);
+
+// cfg may be NULL for defaults
+RollupEngine_t *Rollup_Create(SeriesStore_t *store, const RollupConfig_t *cfg);
+void Rollup_Destroy(RollupEngine_t *engine); // Persists all buckets first
+
+int Rollup_AddSample(RollupEngine_t *engine, const Sample_t *sample);
+
+// Persist buckets whose grace period ended by wall-clock time now_ms
+int Rollup_Tick(RollupEngine_t *engine, int64_t now_ms);
+int Rollup_FlushAll(RollupEngine_t *engine);
+
+// The buckets still in memory, into a malloc'd *buf
+int Rollup_SaveState(RollupEngine_t *engine, void **buf, size_t *len);
+
+// Restore saved buckets, before any sample is added. -1 with errno EBADMSG if buf is not a saved state.
+int Rollup_LoadState(RollupEngine_t *engine, const void *buf, size_t len);
+
+/*
+ * Append persisted and in-memory buckets of one rollup series with start in
+ * [from, to) to snap. Both are captured under the engine lock, so a bucket
+ * being persisted concurrently is seen exactly once.
+ */
+int Rollup_Snapshot(RollupEngine_t *engine, uint32_t node, uint8_t field, uint8_t res,
+                    int64_t from, int64_t to, SeriesSnapshot_t *snap);
+
+void Rollup_GetStats(RollupEngine_t *engine, RollupStats_t *stats);
+
+#endif // ROLLUP_H
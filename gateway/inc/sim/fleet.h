@@ -0,0 +1,68 @@
+#ifndef FLEET_H
+/*
+ * File: fleet.h
+ * Description: Synthetic node fleet for load tests. Every node reports all
+ *              fields on its own interval with jitter; values follow a daily
+ *              cycle plus a random walk. The radio link adds independent and
+ *              bursty (Gilbert-Elliott) loss, ESB retry duplicates, reordering
+ *              and store-and-forward bursts. Frames come out in gateway arrival
+ *              order with rx_ts set to the simulated arrival time.
+ *
+ *              Deterministic for a given seed. Node keys are derived from the
+ *              seed so a gateway can be provisioned for a fleet.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define FLEET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "proto/frame.h"
+
+typedef struct {
+    uint32_t nodes;
+    uint32_t address_base;  // Node i has address address_base + i
+    uint32_t interval_ms;   // Reporting interval
+    double jitter;          // Interval varies by +- this fraction
+    double loss;            // Independent frame loss
+    double burst_enter;     // Gilbert-Elliott: good -> bad per frame
+    double burst_exit;      // bad -> good per frame
+    double burst_loss;      // Loss while bad
+    double duplicate;       // ACK lost, ESB retransmits the same frame
+    double reorder;         // Frame held back behind later traffic
+    uint32_t reorder_max_ms;
+    double backlog;         // Node flushes a store-and-forward backlog
+    uint32_t backlog_frames;
+    bool encrypt;
+    uint64_t seed;
+} FleetConfig_t;
+
+typedef struct {
+    uint64_t frames;     // Handed out, duplicates included
+    uint64_t lost;
+    uint64_t duplicates;
+    uint64_t reordered;
+    uint64_t backlogs;
+} FleetStats_t;
+
+typedef struct Fleet Fleet_t;
+
+void Fleet_DefaultConfig(FleetConfig_t *cfg);
+
+Fleet_t *Fleet_Create(const FleetConfig_t *cfg, int64_t start_ms);
+void Fleet_Destroy(Fleet_t *fleet);
+
+// Next frame in arrival order; never runs dry
+int Fleet_Next(Fleet_t *fleet, Frame_t *frame);
+
+void Fleet_NodeKey(const Fleet_t *fleet, uint32_t node, uint8_t key[16]);
+void Fleet_GetStats(const Fleet_t *fleet, FleetStats_t *stats);
+
+#endif // FLEET_H
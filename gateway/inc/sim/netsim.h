@@ -0,0 +1,107 @@
+#ifndef NETSIM_H
+/*
+ * File: netsim.h
+ * Description: Radio channel simulator for medium access experiments. Nodes
+ *              share one nRF24 channel and wake on their RTC, whose crystal
+ *              runs fast or slow by up to drift_ppm; each report is an ESB
+ *              transmission with auto-retransmit after a fixed delay. Two
+ *              attempts that overlap in time are both lost (no capture
+ *              effect), so nodes that wake together keep colliding through
+ *              all their retries.
+ *
+ *              The gateway side runs the real downlink scheduler and, in
+ *              NETSIM_TDMA, the slot planner. A delivered frame whose node
+ *              has downlink waiting is followed by the node's poll, itself a
+ *              transmission that can collide, and the ACK payload is applied
+ *              by the node as the firmware would. Until it has a slot a TDMA
+ *              node spreads its reports with join_jitter, so that a fleet
+ *              powered up together can get its first frames through.
+ *
+ *              With an OTA server the nodes also run the firmware update
+ *              client: each reports its version at boot and every
+ *              ota_status_ms, and once offered an update pulls it chunk by
+ *              chunk at the pace the offer sets, backing off when a request
+ *              goes unanswered. A slotted node times its requests into the
+ *              gap its own report leaves in each slot, and sends them and
+ *              their polls without auto-retransmit: a lost chunk is simply
+ *              asked for again, and a request that hits a report costs the
+ *              report one retry rather than all of them. A node applies a
+ *              delta to its running build, checks the image CRC and boots the
+ *              new version. A report falling due while the radio is busy
+ *              goes out once it is free.
+ *
+ *              Deterministic for a given seed. Simulated time is in us.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: OTA update client.
+ *
+ */
+#define NETSIM_H
+
+#include <stdint.h>
+
+#include "ota/ota.h"
+#include "radio/slots.h"
+
+typedef enum {
+    NETSIM_ALOHA = 0, // Nodes report on their own schedule
+    NETSIM_TDMA,      // The gateway assigns transmit slots
+} NetsimMode_t;
+
+typedef struct {
+    uint32_t nodes;
+    uint32_t address_base;    // Node i has address address_base + i
+    uint32_t interval_ms;     // Reporting interval
+    double jitter;            // Free-running interval varies by +- this fraction
+    double drift_ppm;         // Crystal error, uniform in +- this
+    uint32_t boot_spread_ms;  // Nodes power up within this much of each other; 0 for a random phase
+    uint32_t airtime_us;      // One ESB attempt with its ACK
+    uint32_t retry_delay_us;  // ESB auto-retransmit delay
+    uint32_t retries;         // ESB auto-retransmit count
+    uint32_t poll_gap_us;     // Frame ACK to downlink poll
+    NetsimMode_t mode;
+    SlotConfig_t slots;       // NETSIM_TDMA; period_ms is taken from interval_ms
+    double join_jitter;       // NETSIM_TDMA: interval jitter of nodes still without a slot
+    OtaServer_t *ota;         // Optional, not owned: nodes report their firmware and fetch updates
+    const uint16_t *versions; // With ota: node i boots versions[i], a stored build; NULL for all on 1
+    uint32_t ota_status_ms;   // With ota: a node reports its version this often, and at boot
+    uint32_t ota_backoff_ms;  // With ota: mean wait after an unanswered chunk request
+    uint64_t seed;
+} NetsimConfig_t;
+
+typedef struct {
+    uint64_t reports;    // Frames the nodes set out to send
+    uint64_t delivered;
+    uint64_t lost;       // All retries used up
+    uint64_t attempts;   // Transmissions, retries and polls included
+    uint64_t collided;   // Attempts that overlapped another
+    uint64_t polls;
+    uint64_t downlink;   // ACK payloads received by nodes
+    uint64_t busy_us;    // Airtime used
+    uint64_t ota_frames; // Version reports and chunk requests
+    uint64_t chunks;     // OTA chunks received by nodes
+    uint64_t updates;    // Nodes that installed an update
+    uint64_t bad_images; // Rebuilt image failed its CRC
+} NetsimStats_t;
+
+typedef struct Netsim Netsim_t;
+
+void Netsim_DefaultConfig(NetsimConfig_t *cfg);
+
+Netsim_t *Netsim_Create(const NetsimConfig_t *cfg);
+void Netsim_Destroy(Netsim_t *sim);
+
+// Advance simulated time by duration_ms; -1 if out of memory
+int Netsim_Run(Netsim_t *sim, int64_t duration_ms);
+
+DownlinkScheduler_t *Netsim_Downlink(Netsim_t *sim);
+void Netsim_GetStats(const Netsim_t *sim, NetsimStats_t *stats);
+// NULL unless NETSIM_TDMA
+const SlotPlanner_t *Netsim_Slots(const Netsim_t *sim);
+
+#endif // NETSIM_H
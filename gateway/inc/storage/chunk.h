@@ -0,0 +1,80 @@
+#ifndef CHUNK_H
+/*
+ * File: chunk.h
+ * Description: On-disk chunk format. A chunk holds records of one series in
+ *              columnar layout, prefixed by a header carrying its time range
+ *              and value zone map so readers can skip it without decoding.
+ *              Raw chunks rewritten by compaction are packed; a packed
+ *              payload is always smaller than the plain one, so buffers sized
+ *              with Chunk_RawSize hold either.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Packed encoding for raw chunks.
+ *
+ */
+#define CHUNK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/series.h"
+
+#define CHUNK_MAGIC 0x4B4E4843u // "CHNK"
+#define CHUNK_VERSION 1
+#define CHUNK_MAX_RECORDS 4096
+
+typedef enum {
+    CHUNK_ENC_PLAIN = 0,
+    CHUNK_ENC_PACKED, // Raw only: delta-of-delta timestamps, XOR-coded values
+} ChunkEncoding_t;
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t res;      // SeriesRes_t
+    uint8_t field;    // SampleField_t
+    uint8_t encoding; // ChunkEncoding_t
+    uint32_t node;
+    uint32_t count;   // Records in the chunk
+    int64_t t_min;    // Zone map: timestamps (bucket starts for rollups)
+    int64_t t_max;
+    float v_min;      // Zone map: values (bucket min/max for rollups)
+    float v_max;
+    uint32_t payload_len;
+    uint32_t crc;     // Over header (crc = 0) and payload
+} ChunkHeader_t;
+
+_Static_assert(sizeof(ChunkHeader_t) == 48, "chunk header layout is part of the file format");
+
+// Encoded size of a chunk including its header
+size_t Chunk_RawSize(uint32_t count);
+size_t Chunk_RollupSize(uint32_t count);
+
+// Timestamps must be sorted; returns bytes written to buf
+size_t Chunk_EncodeRaw(void *buf, uint32_t node, uint8_t field,
+                       const int64_t *ts, const float *values, uint32_t count);
+// As Chunk_EncodeRaw, packed unless that would not be smaller
+size_t Chunk_EncodeRawPacked(void *buf, uint32_t node, uint8_t field,
+                             const int64_t *ts, const float *values, uint32_t count);
+size_t Chunk_EncodeRollup(void *buf, uint32_t node, uint8_t field, uint8_t res,
+                          const SeriesBucket_t *buckets, uint32_t count);
+
+// Cheap structural check, done before the payload is even read
+bool Chunk_HeaderValid(const ChunkHeader_t *hdr);
+bool Chunk_Verify(const ChunkHeader_t *hdr, const void *payload);
+
+static inline size_t Chunk_TotalSize(const ChunkHeader_t *hdr) {
+    return sizeof(ChunkHeader_t) + hdr->payload_len;
+}
+
+// Output arrays must hold hdr->count records. Return 0 or -1 on bad payload.
+int Chunk_DecodeRaw(const ChunkHeader_t *hdr, const void *payload, int64_t *ts, float *values);
+int Chunk_DecodeRollup(const ChunkHeader_t *hdr, const void *payload, SeriesBucket_t *buckets);
+
+#endif // CHUNK_H
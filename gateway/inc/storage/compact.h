@@ -0,0 +1,59 @@
+#ifndef COMPACT_H
+/*
+ * File: compact.h
+ * Description: Background compaction and retention for the series store. A
+ *              thread wakes every interval_ms and, resolution by resolution,
+ *              runs SeriesStore_Compact until no segment is due: segments
+ *              wholly older than the resolution's retention are deleted, and
+ *              segments not compacted yet are rewritten with expired records
+ *              dropped and small chunks merged and packed. Defaults keep raw
+ *              samples 30 days, minute rollups a year and coarser ones for
+ *              ever.
+ *
+ *              Reads and writes are paced by a token bucket of bytes_per_s
+ *              with a second's burst, so the disk stays free for ingest; the
+ *              store lock is only taken to swap a finished segment in.
+ *              Stopping abandons a rewrite in progress, which is done again
+ *              on the next start.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define COMPACT_H
+
+#include <stdint.h>
+
+#include "metrics/metrics.h"
+#include "storage/store.h"
+
+typedef struct {
+    int64_t retention_ms[SERIES_RES_COUNT]; // 0 keeps everything
+    uint64_t bytes_per_s;                   // Read and written; 0 for no limit
+    uint32_t interval_ms;
+    Metrics_t *metrics; // Optional
+} CompactorConfig_t;
+
+typedef struct {
+    SeriesCompactStats_t store;
+    uint64_t passes;
+    uint64_t errors;
+    uint64_t busy_ns;      // Compacting, throttle waits included
+    uint64_t throttled_ns; // Waiting on the token bucket
+} CompactorStats_t;
+
+typedef struct Compactor Compactor_t;
+
+void Compactor_DefaultConfig(CompactorConfig_t *cfg);
+
+// The store must outlive the compactor
+Compactor_t *Compactor_Start(SeriesStore_t *store, const CompactorConfig_t *cfg);
+void Compactor_Stop(Compactor_t *c);
+
+void Compactor_GetStats(Compactor_t *c, CompactorStats_t *stats);
+
+#endif // COMPACT_H
@@ -0,0 +1,86 @@
+#ifndef INDEX_H
+/*
+ * File: index.h
+ * Description: Sparse time index: one entry per sealed chunk, kept per series
+ *              and sorted by start time, carrying the chunk zone map. A
+ *              running maximum of chunk end times lets range lookups binary
+ *              search both ends even when late data makes chunks overlap.
+ *              Not thread-safe; the store guards it with its own lock.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Series walk for exports.
+ *   - <18-10-2026>: Segment replacement for compaction.
+ *
+ */
+#define INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/series.h"
+#include "storage/chunk.h"
+
+typedef struct {
+    uint8_t res;
+    uint16_t gen; // Segment rewrites by compaction; locations in an older file stay readable for a while
+    uint32_t segment;
+    uint64_t offset;
+} ChunkLocation_t;
+
+typedef struct {
+    ChunkLocation_t loc;
+    int64_t t_min;
+    int64_t t_max;
+    float v_min;
+    float v_max;
+    uint32_t count;
+} ChunkRef_t;
+
+typedef struct {
+    ChunkRef_t *refs;
+    uint32_t count;
+    uint32_t cap;
+} ChunkRefList_t;
+
+typedef struct TimeIndex TimeIndex_t;
+
+TimeIndex_t *TimeIndex_Create(void);
+void TimeIndex_Destroy(TimeIndex_t *index);
+
+int TimeIndex_Add(TimeIndex_t *index, SeriesKey_t key, const ChunkRef_t *ref);
+
+// Swap the chunks of key in one generation of a segment for refs[0..n), sorted by t_min, in one pass.
+// The series is left as it was on -1.
+int TimeIndex_Replace(TimeIndex_t *index, SeriesKey_t key, uint32_t segment, uint16_t gen, const ChunkRef_t *refs,
+                      uint32_t n);
+
+// Append chunks of key overlapping [from, to) to out
+int TimeIndex_Find(const TimeIndex_t *index, SeriesKey_t key, int64_t from, int64_t to, ChunkRefList_t *out);
+
+// Chunk holding the newest record of key; false if the series has none
+bool TimeIndex_Last(const TimeIndex_t *index, SeriesKey_t key, ChunkRef_t *out);
+
+uint64_t TimeIndex_ChunkCount(const TimeIndex_t *index);
+
+// Calls fn for every series with chunks, in no particular order; non-zero stops the walk and is returned
+typedef int (*TimeIndex_SeriesFn)(SeriesKey_t key, void *ctx);
+int TimeIndex_ForEachSeries(const TimeIndex_t *index, TimeIndex_SeriesFn fn, void *ctx);
+
+static inline void ChunkRef_FromHeader(ChunkRef_t *ref, const ChunkHeader_t *hdr, const ChunkLocation_t *loc) {
+    ref->loc = *loc;
+    ref->t_min = hdr->t_min;
+    ref->t_max = hdr->t_max;
+    ref->v_min = hdr->v_min;
+    ref->v_max = hdr->v_max;
+    ref->count = hdr->count;
+}
+
+int ChunkRefList_Push(ChunkRefList_t *list, const ChunkRef_t *ref);
+void ChunkRefList_Free(ChunkRefList_t *list);
+
+#endif // INDEX_H
@@ -0,0 +1,69 @@
+#ifndef IOWRITER_H
+/*
+ * File: iowriter.h
+ * Description: Asynchronous file writer for segments and the WAL. Writes are
+ *              copied into a registered buffer arena and queued on an
+ *              io_uring; IoWriter_Submit hands all queued writes to the kernel
+ *              in one system call and the caller carries on. Completions are
+ *              reaped from the shared ring without system calls.
+ *
+ *              Kernels without io_uring (or where it is blocked, e.g. by a
+ *              seccomp profile) get a pwrite backend with the same interface.
+ *              GATEWAY_IO=pwrite|uring forces a backend.
+ *
+ *              Not thread-safe: each writer has one owner, which serialises
+ *              its calls.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#define IOWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    IO_BACKEND_AUTO = 0,
+    IO_BACKEND_URING,
+    IO_BACKEND_PWRITE,
+} IoBackend_t;
+
+typedef struct {
+    uint64_t writes;
+    uint64_t bytes;
+    uint64_t syncs;
+    uint64_t syscalls;    // io_uring_enter, or pwrite + fdatasync
+    uint64_t space_waits; // Times a write had to wait for arena space
+} IoWriterStats_t;
+
+typedef struct IoWriter IoWriter_t;
+
+// arena_bytes bounds the data in flight; a larger write is done synchronously
+IoWriter_t *IoWriter_Create(IoBackend_t backend, uint32_t queue_depth, size_t arena_bytes);
+void IoWriter_Destroy(IoWriter_t *writer); // Drains first
+
+const char *IoWriter_BackendName(const IoWriter_t *writer);
+
+// Queue a write; data may be reused as soon as this returns
+int IoWriter_Write(IoWriter_t *writer, int fd, const void *data, size_t len, uint64_t offset);
+
+// Queue an fdatasync of fd ordered after every write queued before it
+int IoWriter_Sync(IoWriter_t *writer, int fd);
+
+// Hand queued operations to the kernel without waiting for them
+int IoWriter_Submit(IoWriter_t *writer);
+
+// Submit and wait until nothing is in flight; -1 if any operation failed
+int IoWriter_Drain(IoWriter_t *writer);
+
+// Operations queued or in flight, after reaping finished ones
+uint32_t IoWriter_Pending(IoWriter_t *writer);
+
+void IoWriter_GetStats(const IoWriter_t *writer, IoWriterStats_t *stats);
+
+#endif // IOWRITER_H
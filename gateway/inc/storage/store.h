@@ -0,0 +1,171 @@
+#ifndef STORE_H
+/*
+ * File: store.h
+ * Description: Series store. Appends go to a per-series head chunk in memory;
+ *              full heads are sealed into append-only segment files, one
+ *              directory per resolution:
+ *
+ *                  <dir>/raw/00000001.seg
+ *                  <dir>/1m/00000001.seg ...
+ *
+ *              Sealed chunks are tracked in a sparse time index. All calls
+ *              are thread-safe.
+ *
+ *              A segment is finished with a footer listing its chunks, and
+ *              SeriesStore_SaveIndex writes the same list for the open
+ *              segments to <dir>/index.snap, so an open reads footers and the
+ *              checkpoint and verifies only the chunks written after it.
+ *              Segments without a footer are scanned as before.
+ *
+ *              SeriesStore_Compact rewrites one finished segment at a time
+ *              to <id>-<gen>.seg: chunks past retention dropped, each
+ *              series' chunks merged into full ones, raw ones packed. A
+ *              segment wholly past retention is deleted. Only segments
+ *              older than the last index checkpoint are touched, so a
+ *              rewind never meets a rewritten one. Queries holding locations
+ *              of a replaced file read it for a grace period, and a read in
+ *              flight keeps the file open past it; a chunk scan running
+ *              across a rewrite may fail on the replaced file.
+ *
+ *              A read-only store sees the chunks sealed when it was opened,
+ *              creates and cuts nothing, and refuses appends, so a tool can
+ *              open the directory of a running gateway.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Time index and series snapshots for queries.
+ *   - <18-10-2026>: Store marks for rewinding to a WAL checkpoint.
+ *   - <18-10-2026>: Sealed chunks written through IoWriter.
+ *   - <18-10-2026>: Node listing and read-only opening for exports.
+ *   - <18-10-2026>: Segment footers and index checkpoints for fast opens.
+ *   - <18-10-2026>: Segment compaction and retention.
+ *   - <18-10-2026>: Reads in flight hold a reference on their segment file.
+ *
+ */
+#define STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sample.h"
+#include "common/series.h"
+#include "storage/chunk.h"
+#include "storage/index.h"
+#include "storage/iowriter.h"
+
+typedef struct SeriesStore SeriesStore_t;
+
+typedef struct {
+    uint32_t raw_chunk_records;    // Samples per series buffered before sealing
+    uint32_t rollup_chunk_records; // Buckets per series buffered before sealing
+    uint64_t segment_bytes;        // Start a new segment file past this size
+    IoBackend_t io_backend;
+    bool read_only;
+} SeriesStoreConfig_t;
+
+/*
+ * Everything a query needs from one series, captured under the store lock so
+ * no record is missed or seen twice while heads are sealed concurrently.
+ * Sealed chunks are only referenced; unsealed records are copied.
+ */
+typedef struct {
+    ChunkRefList_t chunks;
+    int64_t *ts;             // Unsealed raw samples
+    float *values;
+    uint32_t n_raw;
+    uint32_t cap_raw;
+    SeriesBucket_t *buckets; // Unsealed or in-memory rollup buckets
+    uint32_t n_buckets;
+    uint32_t cap_buckets;
+} SeriesSnapshot_t;
+
+// End of the sealed data of every resolution; see SeriesStore_Rewind
+typedef struct {
+    uint32_t segment[SERIES_RES_COUNT];
+    uint64_t offset[SERIES_RES_COUNT];
+} StoreMark_t;
+
+// Return non-zero to stop the scan; the value is passed back to the caller
+typedef int (*SeriesStore_ChunkFn)(const ChunkHeader_t *hdr, const ChunkLocation_t *loc, void *ctx);
+
+// Called as a compaction goes with the bytes it read and wrote since; return non-zero to abandon it
+typedef int (*SeriesStore_ThrottleFn)(void *ctx, size_t bytes);
+
+// Added to by SeriesStore_Compact
+typedef struct {
+    uint64_t segments; // Rewritten or dropped
+    uint64_t dropped;  // Wholly past retention
+    uint64_t chunks_in;
+    uint64_t chunks_out;
+    uint64_t records_in;
+    uint64_t records_expired;
+    uint64_t bytes_read; // Chunks read
+    uint64_t bytes_written;
+    uint64_t bytes_reclaimed;
+} SeriesCompactStats_t;
+
+void SeriesStore_DefaultConfig(SeriesStoreConfig_t *cfg);
+
+// cfg may be NULL for defaults. Torn chunks at the tail of a segment are cut off.
+SeriesStore_t *SeriesStore_Open(const char *dir, const SeriesStoreConfig_t *cfg);
+void SeriesStore_Close(SeriesStore_t *store); // Seals all head chunks
+
+// -1 with errno EROFS on a read-only store
+int SeriesStore_AppendSample(SeriesStore_t *store, const Sample_t *sample);
+int SeriesStore_AppendBucket(SeriesStore_t *store, uint32_t node, uint8_t field, uint8_t res,
+                             const SeriesBucket_t *bucket);
+
+int SeriesStore_Flush(SeriesStore_t *store); // Seal all head chunks
+int SeriesStore_Sync(SeriesStore_t *store);  // fsync the open segments
+
+// Checkpoint the index of the open segments; take after SeriesStore_Sync.
+// -1 with errno EROFS on a read-only store.
+int SeriesStore_SaveIndex(SeriesStore_t *store);
+
+// Compact the oldest segment of res not compacted yet, or wholly older than cutoff_ms; records older than it
+// are dropped (INT64_MIN keeps everything). Returns 1 if a segment was done, 0 if none is due, -1 with errno
+// set on error: ECANCELED when the throttle abandoned it, EROFS on a read-only store.
+int SeriesStore_Compact(SeriesStore_t *store, uint8_t res, int64_t cutoff_ms, SeriesStore_ThrottleFn throttle,
+                        void *ctx, SeriesCompactStats_t *stats);
+
+// Walk chunk headers of one resolution in write order
+int SeriesStore_ScanChunks(SeriesStore_t *store, uint8_t res, SeriesStore_ChunkFn fn, void *ctx);
+
+// payload must hold hdr->payload_len bytes; cap guards against corrupt headers
+int SeriesStore_ReadChunk(SeriesStore_t *store, const ChunkLocation_t *loc,
+                          ChunkHeader_t *hdr, void *payload, size_t cap);
+
+// Append chunks and unsealed records of key overlapping [from, to) to snap
+int SeriesStore_Snapshot(SeriesStore_t *store, SeriesKey_t key, int64_t from, int64_t to,
+                         SeriesSnapshot_t *snap);
+
+// Append the newest chunk and all unsealed records of key to snap
+int SeriesStore_SnapshotLatest(SeriesStore_t *store, SeriesKey_t key, SeriesSnapshot_t *snap);
+
+// Take after SeriesStore_Flush to cover everything appended so far
+void SeriesStore_GetMark(SeriesStore_t *store, StoreMark_t *mark);
+
+// Drop everything written after mark. Works on a closed store directory.
+int SeriesStore_Rewind(const char *dir, const StoreMark_t *mark);
+
+void SeriesStore_GetIoStats(SeriesStore_t *store, IoWriterStats_t *stats);
+const char *SeriesStore_IoBackend(const SeriesStore_t *store);
+
+uint64_t SeriesStore_ChunkCount(SeriesStore_t *store);
+
+// Nodes with data of one resolution, sealed or not, in ascending order; *nodes is malloc'd
+int SeriesStore_ListNodes(SeriesStore_t *store, uint8_t res, uint32_t **nodes, uint32_t *count);
+
+const char *SeriesStore_Dir(const SeriesStore_t *store);
+
+void SeriesSnapshot_Reset(SeriesSnapshot_t *snap); // Keeps the allocations
+void SeriesSnapshot_Free(SeriesSnapshot_t *snap);
+int SeriesSnapshot_PushRaw(SeriesSnapshot_t *snap, int64_t ts, float value);
+int SeriesSnapshot_PushBucket(SeriesSnapshot_t *snap, const SeriesBucket_t *bucket);
+
+#endif // STORE_H
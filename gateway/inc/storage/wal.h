@@ -0,0 +1,83 @@
+#ifndef WAL_H
+/*
+ * File: wal.h
+ * Description: Write-ahead log for ingest. Appends only copy the record into
+ *              a buffer; a flusher thread writes and syncs whole batches, so
+ *              many frames share one fdatasync (group commit). A batch is
+ *              closed when its oldest record has waited max_delay_us or when
+ *              max_batch_bytes are pending.
+ *
+ *              Records carry a sequence number (LSN). A checkpoint stores the
+ *              LSN up to which the caller has made everything durable, plus
+ *              an opaque blob, and lets older segments be deleted. Replay
+ *              returns only records after the last checkpoint.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *   - <18-10-2026>: Batches written through IoWriter.
+ *
+ */
+#define WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "storage/iowriter.h"
+
+typedef enum {
+    WAL_SYNC_NONE = 0, // write() only: survives a daemon crash, not a power cut
+    WAL_SYNC_GROUP,    // fdatasync per batch
+    WAL_SYNC_EACH,     // write and fdatasync inside every append
+} WalSync_t;
+
+typedef struct {
+    WalSync_t sync;
+    uint32_t max_delay_us;    // Latency bound for a record to become durable
+    uint32_t max_batch_bytes; // Close a batch early once this much is pending
+    uint64_t segment_bytes;   // Start a new segment file past this size
+    IoBackend_t io_backend;
+} WalConfig_t;
+
+typedef struct {
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t batches;
+    uint64_t syncs;
+    uint64_t max_delay_ns; // Worst wait from append to durable
+} WalStats_t;
+
+typedef struct Wal Wal_t;
+
+// Return non-zero to stop replay; the value is passed back to the caller
+typedef int (*Wal_RecordFn)(uint64_t lsn, const void *data, uint32_t len, void *ctx);
+
+void Wal_DefaultConfig(WalConfig_t *cfg);
+
+// cfg may be NULL for defaults. A torn record at the tail is cut off.
+Wal_t *Wal_Open(const char *dir, const WalConfig_t *cfg);
+void Wal_Close(Wal_t *wal); // Flushes and syncs pending records
+
+// Returns the record's LSN, 0 on error. Blocks only if the buffer is full.
+uint64_t Wal_Append(Wal_t *wal, const void *data, uint32_t len);
+
+// Block until lsn is durable under the configured sync mode
+int Wal_WaitDurable(Wal_t *wal, uint64_t lsn);
+uint64_t Wal_DurableLsn(Wal_t *wal);
+uint64_t Wal_LastLsn(Wal_t *wal);
+
+// Records after the last checkpoint, in order. Call before appending.
+int Wal_Replay(Wal_t *wal, Wal_RecordFn fn, void *ctx);
+
+// Everything up to lsn is durable elsewhere; blob is handed back after restart
+int Wal_Checkpoint(Wal_t *wal, uint64_t lsn, const void *blob, size_t len);
+uint64_t Wal_CheckpointLsn(const Wal_t *wal);
+const void *Wal_CheckpointBlob(const Wal_t *wal, size_t *len); // NULL if none
+
+void Wal_GetStats(Wal_t *wal, WalStats_t *stats);
+void Wal_GetIoStats(Wal_t *wal, IoWriterStats_t *stats);
+
+#endif // WAL_H
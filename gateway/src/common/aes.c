@@ -0,0 +1,277 @@
+#include "common/aes.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AES_X86 1
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define AES_ARMV8 1
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#endif
+
+// Blocks in flight at once: enough to cover the round instruction latency. The
+// loops over them are unrolled so the states stay in registers.
+#define AES_INTERLEAVE 8
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static uint8_t xtime(uint8_t x) {
+    return (uint8_t)((x << 1) ^ ((x >> 7) * 0x1b));
+}
+
+void Aes128_Init(Aes128_t *aes, const uint8_t key[AES_KEY_LEN]) {
+    uint8_t *rk = aes->round_keys;
+    uint8_t rcon = 1;
+
+    memcpy(rk, key, AES_KEY_LEN);
+    for (int i = 16; i < 176; i += 4) {
+        uint8_t t[4] = {rk[i - 4], rk[i - 3], rk[i - 2], rk[i - 1]};
+        if (i % 16 == 0) {
+            uint8_t first = t[0];
+            t[0] = (uint8_t)(sbox[t[1]] ^ rcon);
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[first];
+            rcon = xtime(rcon);
+        }
+        for (int k = 0; k < 4; ++k) {
+            rk[i + k] = rk[i - 16 + k] ^ t[k];
+        }
+    }
+}
+
+/*
+ * Portable reference
+ */
+
+static void encrypt_portable(const Aes128_t *aes, const uint8_t in[AES_BLOCK_LEN], uint8_t out[AES_BLOCK_LEN]) {
+    const uint8_t *rk = aes->round_keys;
+    uint8_t s[16];
+
+    for (int i = 0; i < 16; ++i) {
+        s[i] = in[i] ^ rk[i];
+    }
+    for (int round = 1; round <= 10; ++round) {
+        uint8_t t[16];
+        // SubBytes and ShiftRows; the state is column-major
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                t[c * 4 + r] = sbox[s[((c + r) % 4) * 4 + r]];
+            }
+        }
+        if (round < 10) {
+            for (int c = 0; c < 4; ++c) {
+                uint8_t *col = &t[c * 4];
+                uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+                uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+                col[0] ^= all ^ xtime(a0 ^ a1);
+                col[1] ^= all ^ xtime(a1 ^ a2);
+                col[2] ^= all ^ xtime(a2 ^ a3);
+                col[3] ^= all ^ xtime(a3 ^ a0);
+            }
+        }
+        for (int i = 0; i < 16; ++i) {
+            s[i] = t[i] ^ rk[round * 16 + i];
+        }
+    }
+    memcpy(out, s, sizeof(s));
+}
+
+static void encrypt_blocks_portable(const Aes128_t *const *keys, const uint8_t (*in)[AES_BLOCK_LEN],
+                                    uint8_t (*out)[AES_BLOCK_LEN], size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        encrypt_portable(keys[i], in[i], out[i]);
+    }
+}
+
+static const AesBackend_t backend_portable = {
+    .name = "portable",
+    .encrypt = encrypt_portable,
+    .encrypt_blocks = encrypt_blocks_portable,
+};
+
+/*
+ * AES-NI
+ */
+
+#ifdef AES_X86
+
+__attribute__((target("aes,sse2"))) static void encrypt_aesni(const Aes128_t *aes, const uint8_t in[AES_BLOCK_LEN],
+                                                              uint8_t out[AES_BLOCK_LEN]) {
+    const __m128i *rk = (const __m128i *)aes->round_keys;
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128(&rk[0]));
+
+    for (int round = 1; round < 10; ++round) {
+        s = _mm_aesenc_si128(s, _mm_loadu_si128(&rk[round]));
+    }
+    s = _mm_aesenclast_si128(s, _mm_loadu_si128(&rk[10]));
+    _mm_storeu_si128((__m128i *)out, s);
+}
+
+__attribute__((target("aes,sse2"))) static void encrypt_blocks_aesni(const Aes128_t *const *keys,
+                                                                     const uint8_t (*in)[AES_BLOCK_LEN],
+                                                                     uint8_t (*out)[AES_BLOCK_LEN], size_t n) {
+    size_t i = 0;
+
+    for (; i + AES_INTERLEAVE <= n; i += AES_INTERLEAVE) {
+        __m128i s[AES_INTERLEAVE];
+        const __m128i *rk[AES_INTERLEAVE];
+        #pragma GCC unroll 8
+        for (int b = 0; b < AES_INTERLEAVE; ++b) {
+            rk[b] = (const __m128i *)keys[i + b]->round_keys;
+            s[b] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in[i + b]), _mm_loadu_si128(&rk[b][0]));
+        }
+        for (int round = 1; round < 10; ++round) {
+            #pragma GCC unroll 8
+            for (int b = 0; b < AES_INTERLEAVE; ++b) {
+                s[b] = _mm_aesenc_si128(s[b], _mm_loadu_si128(&rk[b][round]));
+            }
+        }
+        #pragma GCC unroll 8
+        for (int b = 0; b < AES_INTERLEAVE; ++b) {
+            _mm_storeu_si128((__m128i *)out[i + b], _mm_aesenclast_si128(s[b], _mm_loadu_si128(&rk[b][10])));
+        }
+    }
+    for (; i < n; ++i) {
+        encrypt_aesni(keys[i], in[i], out[i]);
+    }
+}
+
+static const AesBackend_t backend_aesni = {
+    .name = "aesni",
+    .encrypt = encrypt_aesni,
+    .encrypt_blocks = encrypt_blocks_aesni,
+};
+
+#endif // AES_X86
+
+/*
+ * ARMv8 Crypto Extension. AESE does AddRoundKey before SubBytes and
+ * ShiftRows, so the round keys line up one round earlier than AES-NI's.
+ */
+
+#ifdef AES_ARMV8
+
+__attribute__((target("+crypto"))) static void encrypt_armv8(const Aes128_t *aes, const uint8_t in[AES_BLOCK_LEN],
+                                                             uint8_t out[AES_BLOCK_LEN]) {
+    const uint8_t *rk = aes->round_keys;
+    uint8x16_t s = vld1q_u8(in);
+
+    for (int round = 0; round < 9; ++round) {
+        s = vaesmcq_u8(vaeseq_u8(s, vld1q_u8(rk + round * 16)));
+    }
+    s = veorq_u8(vaeseq_u8(s, vld1q_u8(rk + 9 * 16)), vld1q_u8(rk + 10 * 16));
+    vst1q_u8(out, s);
+}
+
+__attribute__((target("+crypto"))) static void encrypt_blocks_armv8(const Aes128_t *const *keys,
+                                                                    const uint8_t (*in)[AES_BLOCK_LEN],
+                                                                    uint8_t (*out)[AES_BLOCK_LEN], size_t n) {
+    size_t i = 0;
+
+    for (; i + AES_INTERLEAVE <= n; i += AES_INTERLEAVE) {
+        uint8x16_t s[AES_INTERLEAVE];
+        #pragma GCC unroll 8
+        for (int b = 0; b < AES_INTERLEAVE; ++b) {
+            s[b] = vld1q_u8(in[i + b]);
+        }
+        for (int round = 0; round < 9; ++round) {
+            #pragma GCC unroll 8
+            for (int b = 0; b < AES_INTERLEAVE; ++b) {
+                s[b] = vaesmcq_u8(vaeseq_u8(s[b], vld1q_u8(keys[i + b]->round_keys + round * 16)));
+            }
+        }
+        #pragma GCC unroll 8
+        for (int b = 0; b < AES_INTERLEAVE; ++b) {
+            const uint8_t *rk = keys[i + b]->round_keys;
+            vst1q_u8(out[i + b], veorq_u8(vaeseq_u8(s[b], vld1q_u8(rk + 9 * 16)), vld1q_u8(rk + 10 * 16)));
+        }
+    }
+    for (; i < n; ++i) {
+        encrypt_armv8(keys[i], in[i], out[i]);
+    }
+}
+
+static const AesBackend_t backend_armv8 = {
+    .name = "armv8",
+    .encrypt = encrypt_armv8,
+    .encrypt_blocks = encrypt_blocks_armv8,
+};
+
+#endif // AES_ARMV8
+
+static const AesBackend_t *selected = &backend_portable;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+const AesBackend_t *Aes_ByName(const char *name) {
+    if (strcmp(name, "portable") == 0) {
+        return &backend_portable;
+    }
+#ifdef AES_X86
+    if (strcmp(name, "aesni") == 0 && __builtin_cpu_supports("aes")) {
+        return &backend_aesni;
+    }
+#endif
+#ifdef AES_ARMV8
+    if (strcmp(name, "armv8") == 0 && (getauxval(AT_HWCAP) & HWCAP_AES)) {
+        return &backend_armv8;
+    }
+#endif
+    return NULL;
+}
+
+static void select_backend(void) {
+    static const char *const preference[] = {"aesni", "armv8"};
+    const char *forced = getenv("GATEWAY_AES");
+
+    if (forced && Aes_ByName(forced)) {
+        selected = Aes_ByName(forced);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); ++i) {
+        if (Aes_ByName(preference[i])) {
+            selected = Aes_ByName(preference[i]);
+            return;
+        }
+    }
+}
+
+const AesBackend_t *Aes_Get(void) {
+    pthread_once(&select_once, select_backend);
+    return selected;
+}
+
+void Aes128_Encrypt(const Aes128_t *aes, const uint8_t in[AES_BLOCK_LEN], uint8_t out[AES_BLOCK_LEN]) {
+    Aes_Get()->encrypt(aes, in, out);
+}
+
+void Aes128_EncryptBlocks(const Aes128_t *const *keys, const uint8_t (*in)[AES_BLOCK_LEN],
+                          uint8_t (*out)[AES_BLOCK_LEN], size_t n) {
+    Aes_Get()->encrypt_blocks(keys, in, out, n);
+}
@@ -0,0 +1,96 @@
+#include "common/arena.h"
+
+#include <stdlib.h>
+
+struct ArenaBlock {
+    ArenaBlock_t *next;
+    size_t size;
+    size_t head;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+void Arena_Init(Arena_t *arena, size_t block_bytes) {
+    arena->blocks = NULL;
+    arena->block_bytes = block_bytes;
+    arena->used = 0;
+    arena->stats = (ArenaStats_t){0};
+}
+
+static void free_blocks(Arena_t *arena, ArenaBlock_t *b) {
+    while (b) {
+        ArenaBlock_t *next = b->next;
+        arena->stats.reserved -= b->size;
+        free(b);
+        b = next;
+    }
+}
+
+void Arena_Free(Arena_t *arena) {
+    free_blocks(arena, arena->blocks);
+    arena->blocks = NULL;
+    arena->used = 0;
+}
+
+static ArenaBlock_t *block_new(Arena_t *arena, size_t size) {
+    ArenaBlock_t *b = malloc(sizeof(*b) + size);
+
+    if (!b) {
+        return NULL;
+    }
+    b->next = arena->blocks;
+    b->size = size;
+    b->head = 0;
+    arena->blocks = b;
+    arena->stats.mallocs++;
+    arena->stats.reserved += size;
+    return b;
+}
+
+void *Arena_Alloc(Arena_t *arena, size_t size) {
+    size_t rounded = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock_t *b = arena->blocks;
+
+    if (!b || b->size - b->head < rounded) {
+        size_t want = arena->block_bytes;
+        // Grow geometrically so an oversized batch takes a few blocks, not one per allocation
+        if (arena->block_bytes > 0 && b && want < b->size * 2) {
+            want = b->size * 2;
+        }
+        if (want < rounded) {
+            want = rounded;
+        }
+        if (!(b = block_new(arena, want))) {
+            return NULL;
+        }
+    }
+    void *p = b->data + b->head;
+    b->head += rounded;
+    arena->used += rounded;
+    arena->stats.allocs++;
+    arena->stats.bytes += size;
+    return p;
+}
+
+void Arena_Reset(Arena_t *arena) {
+    ArenaBlock_t *b = arena->blocks;
+
+    arena->stats.resets++;
+    if (arena->used > arena->stats.high_water) {
+        arena->stats.high_water = arena->used;
+    }
+    if (b && b->next && arena->block_bytes > 0) {
+        // Overflowed: one block the size of this batch from now on
+        size_t size = arena->used > arena->block_bytes ? arena->used : arena->block_bytes;
+        free_blocks(arena, b);
+        arena->blocks = NULL;
+        arena->block_bytes = size;
+        b = NULL;
+    } else if (arena->block_bytes == 0) {
+        free_blocks(arena, b);
+        arena->blocks = b = NULL;
+    }
+    if (b) {
+        b->head = 0;
+    }
+    arena->used = 0;
+}
@@ -0,0 +1,431 @@
+#include "common/queue.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// One ring per priority under drop-low-prio, else one; capacity is shared
+typedef struct {
+    uint8_t *items;
+    uint64_t *seq; // Push order, to merge the rings back on pop
+    uint32_t head;
+    uint32_t count;
+} Level_t;
+
+struct Queue {
+    QueueConfig_t cfg;
+    char *name;
+    char *spill_path;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    Level_t levels[QUEUE_PRIORITIES];
+    uint32_t n_levels;
+    uint32_t count;
+    uint64_t next_seq;
+    bool closed;
+
+    int spill_fd;
+    uint64_t spill_head; // Byte offsets of the oldest and next spilled item
+    uint64_t spill_tail;
+
+    QueueStats_t stats;
+    Metric_t block_ns;
+};
+
+static const char *const policy_names[] = {"block", "drop-newest", "drop-oldest", "drop-low-prio", "spill"};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t spill_items(const Queue_t *q) {
+    return (q->spill_tail - q->spill_head) / q->cfg.item_size;
+}
+
+void Queue_DefaultConfig(QueueConfig_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->name = "stage";
+    cfg->capacity = 4096;
+    cfg->policy = QUEUE_BLOCK;
+    cfg->spill_max = 256ull << 20;
+}
+
+/* --- Rings --- */
+
+static void ring_put(Queue_t *q, Level_t *l, const uint8_t *src, uint32_t k) {
+    uint32_t cap = q->cfg.capacity;
+    size_t size = q->cfg.item_size;
+    uint32_t at = (l->head + l->count) % cap;
+    uint32_t first = k < cap - at ? k : cap - at;
+
+    memcpy(l->items + (size_t)at * size, src, first * size);
+    memcpy(l->items, src + first * size, (k - first) * size);
+    if (l->seq) {
+        for (uint32_t i = 0; i < k; ++i) {
+            l->seq[(at + i) % cap] = q->next_seq++;
+        }
+    }
+    l->count += k;
+    q->count += k;
+}
+
+static void ring_take(Queue_t *q, Level_t *l, uint8_t *dst, uint32_t k) {
+    uint32_t cap = q->cfg.capacity;
+    size_t size = q->cfg.item_size;
+    uint32_t first = k < cap - l->head ? k : cap - l->head;
+
+    if (dst) {
+        memcpy(dst, l->items + (size_t)l->head * size, first * size);
+        memcpy(dst + first * size, l->items, (k - first) * size);
+    }
+    l->head = (l->head + k) % cap;
+    l->count -= k;
+    q->count -= k;
+}
+
+// Level holding the oldest item; the queue must not be empty
+static Level_t *oldest_level(Queue_t *q) {
+    Level_t *best = NULL;
+
+    for (uint32_t i = 0; i < q->n_levels; ++i) {
+        Level_t *l = &q->levels[i];
+        if (l->count > 0 && (!best || !l->seq || l->seq[l->head] < best->seq[best->head])) {
+            best = l;
+        }
+    }
+    return best;
+}
+
+/* --- Spill file --- */
+
+// Items written, up to spill_max
+static size_t spill_write(Queue_t *q, const uint8_t *src, size_t n) {
+    size_t size = q->cfg.item_size;
+    uint64_t room = (q->cfg.spill_max - (q->spill_tail - q->spill_head)) / size;
+    size_t k = n < room ? n : (size_t)room;
+    size_t done = 0, len = k * size;
+
+    while (done < len) {
+        ssize_t w = pwrite(q->spill_fd, src + done, len - done, (off_t)(q->spill_tail + done));
+        if (w <= 0) {
+            break;
+        }
+        done += (size_t)w;
+    }
+    k = done / size;
+    q->spill_tail += k * size;
+    q->stats.spilled += k;
+    return k;
+}
+
+static bool read_at(int fd, uint8_t *dst, size_t len, uint64_t off) {
+    while (len > 0) {
+        ssize_t r = pread(fd, dst, len, (off_t)off);
+        if (r <= 0) {
+            return false;
+        }
+        dst += r;
+        len -= (size_t)r;
+        off += (uint64_t)r;
+    }
+    return true;
+}
+
+// Moves spilled items back into memory as far as it has room
+static void spill_refill(Queue_t *q) {
+    Level_t *l = &q->levels[0];
+    uint32_t cap = q->cfg.capacity;
+    size_t size = q->cfg.item_size;
+    uint64_t avail = spill_items(q);
+    uint32_t k = cap - q->count < avail ? cap - q->count : (uint32_t)avail;
+    uint32_t at = (l->head + l->count) % cap;
+    uint32_t first = k < cap - at ? k : cap - at;
+
+    if (k == 0) {
+        return;
+    }
+    if (read_at(q->spill_fd, l->items + (size_t)at * size, first * size, q->spill_head) &&
+        read_at(q->spill_fd, l->items, (k - first) * size, q->spill_head + first * size)) {
+        l->count += k;
+        q->count += k;
+        q->spill_head += k * size;
+    } else {
+        // Unreadable: what was spilled is lost, and counted so
+        q->stats.evicted += avail;
+        q->spill_head = q->spill_tail;
+    }
+    if (q->spill_head == q->spill_tail) {
+        // Drained: give the space back; it is reused from offset 0 even if this fails
+        q->spill_head = q->spill_tail = 0;
+        int rc = ftruncate(q->spill_fd, 0);
+        (void)rc;
+    }
+}
+
+/* --- Metrics --- */
+
+static void write_stat(FILE *out, const Queue_t *q, const char *suffix, const char *help, MetricType_t type,
+                       uint64_t value) {
+    char name[96];
+
+    snprintf(name, sizeof(name), "gateway_%s_queue_%s", q->name, suffix);
+    Metrics_WriteValue(out, name, help, type, (double)value);
+}
+
+static void collect(void *ctx, FILE *out) {
+    Queue_t *q = ctx;
+    QueueStats_t st;
+
+    Queue_GetStats(q, &st);
+    write_stat(out, q, "pushed_total", "Items accepted", METRIC_COUNTER, st.pushed);
+    write_stat(out, q, "popped_total", "Items taken by the next stage", METRIC_COUNTER, st.popped);
+    write_stat(out, q, "dropped_total", "Items refused with the queue full", METRIC_COUNTER, st.dropped);
+    write_stat(out, q, "evicted_total", "Queued items dropped to make room", METRIC_COUNTER, st.evicted);
+    write_stat(out, q, "spilled_total", "Items written to the spill file", METRIC_COUNTER, st.spilled);
+    write_stat(out, q, "blocked_total", "Pushes that waited for room", METRIC_COUNTER, st.blocked);
+    write_stat(out, q, "depth", "Items in memory", METRIC_GAUGE, st.depth);
+    write_stat(out, q, "spill_depth", "Items in the spill file", METRIC_GAUGE, st.spill_depth);
+}
+
+/* --- Queue --- */
+
+Queue_t *Queue_Create(const QueueConfig_t *cfg) {
+    if (cfg->item_size == 0 || cfg->capacity == 0 || (unsigned)cfg->policy > QUEUE_SPILL ||
+        (cfg->policy == QUEUE_SPILL && !cfg->spill_path)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    Queue_t *q = calloc(1, sizeof(*q));
+    if (!q) {
+        return NULL;
+    }
+    q->cfg = *cfg;
+    q->spill_fd = -1;
+    q->block_ns = (Metric_t){.slot = -1};
+    q->n_levels = cfg->policy == QUEUE_DROP_LOW_PRIO ? QUEUE_PRIORITIES : 1;
+    q->name = strdup(cfg->name ? cfg->name : "stage");
+    if (!q->name) {
+        goto fail;
+    }
+    for (uint32_t i = 0; i < q->n_levels; ++i) {
+        if (!(q->levels[i].items = malloc((size_t)cfg->capacity * cfg->item_size))) {
+            goto fail;
+        }
+        if (q->n_levels > 1 && !(q->levels[i].seq = malloc(cfg->capacity * sizeof(uint64_t)))) {
+            goto fail;
+        }
+    }
+    if (cfg->policy == QUEUE_SPILL) {
+        if (!(q->spill_path = strdup(cfg->spill_path)) ||
+            (q->spill_fd = open(cfg->spill_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0) {
+            goto fail;
+        }
+    }
+    q->cfg.name = q->name;
+    q->cfg.spill_path = q->spill_path;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, &attr);
+    pthread_cond_init(&q->not_full, &attr);
+    pthread_condattr_destroy(&attr);
+    if (cfg->metrics) {
+        char name[96];
+        snprintf(name, sizeof(name), "gateway_%s_queue_block_seconds", q->name);
+        q->block_ns = Metrics_Histogram(cfg->metrics, name, "Time a producer waited for room", 1e-9);
+        Metrics_AddCollector(cfg->metrics, collect, q);
+    }
+    return q;
+
+fail:
+    for (uint32_t i = 0; i < q->n_levels; ++i) {
+        free(q->levels[i].items);
+        free(q->levels[i].seq);
+    }
+    if (q->spill_fd >= 0) {
+        close(q->spill_fd);
+        unlink(q->spill_path);
+    }
+    free(q->spill_path);
+    free(q->name);
+    free(q);
+    return NULL;
+}
+
+void Queue_Destroy(Queue_t *q) {
+    if (!q) {
+        return;
+    }
+    if (q->cfg.metrics) {
+        Metrics_RemoveCollector(q->cfg.metrics, collect, q);
+    }
+    if (q->spill_fd >= 0) {
+        close(q->spill_fd);
+        unlink(q->spill_path);
+    }
+    for (uint32_t i = 0; i < q->n_levels; ++i) {
+        free(q->levels[i].items);
+        free(q->levels[i].seq);
+    }
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->lock);
+    free(q->spill_path);
+    free(q->name);
+    free(q);
+}
+
+// Makes room for one item of priority level l by dropping another; false if the policy refuses it
+static bool make_room(Queue_t *q, uint32_t l, uint64_t *blocked_since) {
+    switch (q->cfg.policy) {
+    case QUEUE_BLOCK:
+        if (*blocked_since == 0) {
+            *blocked_since = now_ns();
+        }
+        pthread_cond_wait(&q->not_full, &q->lock);
+        return true;
+    case QUEUE_DROP_OLDEST:
+        ring_take(q, oldest_level(q), NULL, 1);
+        q->stats.evicted++;
+        return true;
+    case QUEUE_DROP_LOW_PRIO:
+        for (uint32_t i = 0; i <= l; ++i) {
+            if (q->levels[i].count > 0) {
+                ring_take(q, &q->levels[i], NULL, 1);
+                q->stats.evicted++;
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+size_t Queue_Push(Queue_t *q, const void *items, size_t n, uint8_t prio) {
+    const uint8_t *src = items;
+    uint32_t l = prio < q->n_levels ? prio : q->n_levels - 1;
+    uint64_t blocked_since = 0;
+    size_t done = 0;
+
+    pthread_mutex_lock(&q->lock);
+    bool was_empty = q->count == 0 && q->spill_tail == q->spill_head;
+    while (done < n && !q->closed) {
+        // Once anything is spilled, later items follow it into the file to keep the order
+        if (q->spill_fd >= 0 && (q->spill_tail > q->spill_head || q->count == q->cfg.capacity)) {
+            done += spill_write(q, src + done * q->cfg.item_size, n - done);
+            break;
+        }
+        uint32_t room = q->cfg.capacity - q->count;
+        if (room > 0) {
+            uint32_t k = n - done < room ? (uint32_t)(n - done) : room;
+            ring_put(q, &q->levels[l], src + done * q->cfg.item_size, k);
+            done += k;
+        } else if (!make_room(q, l, &blocked_since)) {
+            break;
+        }
+    }
+    q->stats.pushed += done;
+    q->stats.dropped += n - done;
+    if (q->count > q->stats.high_water) {
+        q->stats.high_water = q->count;
+    }
+    if (blocked_since) {
+        uint64_t waited = now_ns() - blocked_since;
+        q->stats.blocked++;
+        q->stats.blocked_ns += waited;
+        Metrics_Observe(q->block_ns, waited);
+    }
+    if (done > 0) {
+        pthread_cond_broadcast(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    if (done > 0 && was_empty && q->cfg.notify) {
+        q->cfg.notify(q->cfg.notify_ctx);
+    }
+    return done;
+}
+
+size_t Queue_Pop(Queue_t *q, void *out, size_t max, int timeout_ms) {
+    uint8_t *dst = out;
+    size_t taken = 0;
+    struct timespec deadline;
+
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && q->spill_tail == q->spill_head && !q->closed && timeout_ms != 0) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&q->not_empty, &q->lock);
+        } else if (pthread_cond_timedwait(&q->not_empty, &q->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (q->count == 0 && q->spill_fd >= 0) {
+        spill_refill(q);
+    }
+    if (q->n_levels == 1) {
+        taken = max < q->count ? max : q->count;
+        ring_take(q, &q->levels[0], dst, (uint32_t)taken);
+    } else {
+        for (; taken < max && q->count > 0; ++taken) {
+            ring_take(q, oldest_level(q), dst + taken * q->cfg.item_size, 1);
+        }
+    }
+    if (q->spill_fd >= 0) {
+        spill_refill(q);
+    }
+    q->stats.popped += taken;
+    if (taken > 0) {
+        pthread_cond_broadcast(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return taken;
+}
+
+void Queue_Close(Queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void Queue_GetStats(Queue_t *q, QueueStats_t *stats) {
+    pthread_mutex_lock(&q->lock);
+    *stats = q->stats;
+    stats->depth = q->count;
+    stats->spill_depth = spill_items(q);
+    pthread_mutex_unlock(&q->lock);
+}
+
+const char *Queue_PolicyName(QueuePolicy_t policy) {
+    return (unsigned)policy <= QUEUE_SPILL ? policy_names[policy] : "unknown";
+}
+
+int Queue_PolicyFromName(const char *name) {
+    for (int i = 0; i <= QUEUE_SPILL; ++i) {
+        if (strcmp(name, policy_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,26 @@
+#include "common/sample.h"
+
+#include <string.h>
+
+static const char *const field_names[FIELD_COUNT] = {
+    [FIELD_TEMPERATURE] = "temperature",
+    [FIELD_HUMIDITY] = "humidity",
+    [FIELD_PRESSURE] = "pressure",
+    [FIELD_BATTERY] = "battery",
+};
+
+const char *Sample_FieldName(SampleField_t field) {
+    if ((unsigned)field >= FIELD_COUNT) {
+        return "unknown";
+    }
+    return field_names[field];
+}
+
+int Sample_FieldFromName(const char *name) {
+    for (int i = 0; i < FIELD_COUNT; ++i) {
+        if (strcmp(name, field_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,39 @@
+#include "common/series.h"
+
+#include <string.h>
+
+static const char *const res_names[SERIES_RES_COUNT] = {
+    [SERIES_RES_RAW] = "raw",
+    [SERIES_RES_1M] = "1m",
+    [SERIES_RES_1H] = "1h",
+    [SERIES_RES_1D] = "1d",
+};
+
+int64_t Series_ResolutionMs(SeriesRes_t res) {
+    switch (res) {
+    case SERIES_RES_1M:
+        return SERIES_MS_PER_MINUTE;
+    case SERIES_RES_1H:
+        return SERIES_MS_PER_HOUR;
+    case SERIES_RES_1D:
+        return SERIES_MS_PER_DAY;
+    default:
+        return 0;
+    }
+}
+
+const char *Series_ResolutionName(SeriesRes_t res) {
+    if ((unsigned)res >= SERIES_RES_COUNT) {
+        return "unknown";
+    }
+    return res_names[res];
+}
+
+int Series_ResolutionFromName(const char *name) {
+    for (int i = 0; i < SERIES_RES_COUNT; ++i) {
+        if (strcmp(name, res_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
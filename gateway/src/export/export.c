@@ -0,0 +1,774 @@
+#include "export/export.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/sample.h"
+#include "export/parquet.h"
+#include "storage/chunk.h"
+
+#define COLUMNS (2 + FIELD_COUNT)
+#define CSV_ROW_MAX 128 // node, ts and four floats with separators, at their longest
+
+typedef struct Batch {
+    struct Batch *next;
+    uint32_t node;
+    uint32_t rows;
+    int64_t *ts;
+    int32_t *node_col; // Parquet node column, every row the batch's node
+    float *values[FIELD_COUNT];
+    uint8_t *present[FIELD_COUNT];
+    uint32_t missing[FIELD_COUNT];
+    uint8_t *out;      // Encoded rows
+    size_t out_len;
+    ParquetChunk_t chunks[COLUMNS];
+    uint64_t samples;
+    uint64_t chunks_read;
+} Batch_t;
+
+// One decoded chunk, or a series' unsealed records, being merged
+typedef struct {
+    uint8_t field;
+    const int64_t *ts;
+    const float *values;
+    uint32_t pos;
+    uint32_t end;
+    int64_t *buf_ts; // Owned decode buffers, kept for reuse
+    float *buf_values;
+} Cursor_t;
+
+typedef struct {
+    int64_t t_min;
+    uint8_t field;
+    int32_t chunk; // Index into the field's snapshot chunks, -1 for its unsealed records
+} Source_t;
+
+typedef struct Export Export_t;
+
+// A worker's merge state for the node it is on
+typedef struct {
+    Export_t *exp;
+    pthread_t thread;
+    SeriesSnapshot_t snaps[FIELD_COUNT];
+    Source_t *sources;
+    uint32_t n_sources;
+    uint32_t cap_sources;
+    uint32_t next_source;
+    Cursor_t *cursors; // [0, n_active) in use
+    uint32_t n_active;
+    uint32_t cap_cursors;
+    uint8_t *payload;
+} Reader_t;
+
+struct Export {
+    SeriesStore_t *store;
+    ExportConfig_t cfg;
+    const uint32_t *nodes;
+    uint32_t n_nodes;
+    pthread_mutex_t lock;
+    pthread_cond_t freed;  // A batch went back to the pool
+    pthread_cond_t filled; // A batch is ready, or a worker finished
+    Batch_t *pool;
+    Batch_t *ready;
+    Batch_t *ready_tail;
+    uint32_t next_node;
+    uint32_t running;
+    int error;             // errno of the first failure
+};
+
+static const ParquetColumn_t parquet_cols[COLUMNS] = {
+    {"node", PARQUET_INT32, PARQUET_UINT32, false},
+    {"ts", PARQUET_INT64, PARQUET_TIMESTAMP_MS, false},
+    {"temperature", PARQUET_FLOAT, PARQUET_PLAIN_TYPE, true},
+    {"humidity", PARQUET_FLOAT, PARQUET_PLAIN_TYPE, true},
+    {"pressure", PARQUET_FLOAT, PARQUET_PLAIN_TYPE, true},
+    {"battery", PARQUET_FLOAT, PARQUET_PLAIN_TYPE, true},
+};
+
+_Static_assert(FIELD_COUNT == 4, "export columns follow SampleField_t");
+
+void Export_DefaultConfig(ExportConfig_t *cfg) {
+    cfg->format = EXPORT_CSV;
+    cfg->from = INT64_MIN;
+    cfg->to = INT64_MAX;
+    cfg->nodes = NULL;
+    cfg->n_nodes = 0;
+    cfg->threads = 4;
+    cfg->batch_rows = 32768;
+    cfg->batches = 8;
+}
+
+const char *Export_FormatName(ExportFormat_t format) {
+    return format == EXPORT_PARQUET ? "parquet" : "csv";
+}
+
+int Export_FormatFromName(const char *name) {
+    if (strcmp(name, "csv") == 0) {
+        return EXPORT_CSV;
+    }
+    if (strcmp(name, "parquet") == 0) {
+        return EXPORT_PARQUET;
+    }
+    return -1;
+}
+
+static void fail(Export_t *exp, int err) {
+    pthread_mutex_lock(&exp->lock);
+    if (!exp->error) {
+        exp->error = err ? err : EIO;
+    }
+    pthread_cond_broadcast(&exp->freed);
+    pthread_cond_broadcast(&exp->filled);
+    pthread_mutex_unlock(&exp->lock);
+}
+
+/*
+ * Batches
+ */
+
+static size_t out_bound(const ExportConfig_t *cfg) {
+    if (cfg->format == EXPORT_CSV) {
+        return (size_t)cfg->batch_rows * CSV_ROW_MAX;
+    }
+    size_t n = 0;
+    for (int c = 0; c < COLUMNS; ++c) {
+        n += Parquet_ColumnBound(&parquet_cols[c], cfg->batch_rows);
+    }
+    return n;
+}
+
+static void batch_free(Batch_t *b) {
+    if (!b) {
+        return;
+    }
+    free(b->ts);
+    free(b->node_col);
+    for (int f = 0; f < FIELD_COUNT; ++f) {
+        free(b->values[f]);
+        free(b->present[f]);
+    }
+    free(b->out);
+    free(b);
+}
+
+static Batch_t *batch_create(const ExportConfig_t *cfg) {
+    Batch_t *b = calloc(1, sizeof(*b));
+    size_t rows = cfg->batch_rows;
+    bool ok;
+
+    if (!b) {
+        return NULL;
+    }
+    b->ts = malloc(rows * sizeof(*b->ts));
+    b->node_col = malloc(rows * sizeof(*b->node_col));
+    b->out = malloc(out_bound(cfg));
+    ok = b->ts && b->node_col && b->out;
+    for (int f = 0; f < FIELD_COUNT; ++f) {
+        b->values[f] = malloc(rows * sizeof(float));
+        b->present[f] = malloc(rows);
+        ok = ok && b->values[f] && b->present[f];
+    }
+    if (!ok) {
+        batch_free(b);
+        return NULL;
+    }
+    return b;
+}
+
+/*
+ * CSV text. Each float prints as the shortest fixed-point decimal that reads
+ * back to the same value; nine significant digits always do.
+ */
+
+static char *put_u64(char *p, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n > 0) {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+static char *put_i64(char *p, int64_t v) {
+    if (v < 0) {
+        *p++ = '-';
+        return put_u64(p, 0 - (uint64_t)v);
+    }
+    return put_u64(p, (uint64_t)v);
+}
+
+static char *put_float(char *p, float v) {
+    double scale = 1.0;
+
+    // Past 1e15 the scaled value is no longer an exact integer in a double
+    for (int d = 0; d <= 15 && fabs((double)v) * scale < 1e15; ++d, scale *= 10.0) {
+        double m = nearbyint((double)v * scale);
+        if ((float)(m / scale) != v) {
+            continue;
+        }
+        uint64_t u = (uint64_t)fabs(m), div = (uint64_t)scale;
+        if (signbit(v) && u != 0) {
+            *p++ = '-';
+        }
+        p = put_u64(p, u / div);
+        if (d > 0) {
+            uint64_t frac = u % div;
+            *p++ = '.';
+            for (uint64_t q = div / 10; q > 0; q /= 10) {
+                *p++ = (char)('0' + frac / q % 10);
+            }
+        }
+        return p;
+    }
+    return p + sprintf(p, "%.9g", (double)v);
+}
+
+static void encode_csv(Batch_t *b) {
+    char *p = (char *)b->out;
+    char prefix[16];
+    size_t prefix_len = (size_t)(put_u64(prefix, b->node) - prefix);
+
+    for (uint32_t r = 0; r < b->rows; ++r) {
+        memcpy(p, prefix, prefix_len);
+        p += prefix_len;
+        *p++ = ',';
+        p = put_i64(p, b->ts[r]);
+        for (int f = 0; f < FIELD_COUNT; ++f) {
+            *p++ = ',';
+            if (b->present[f][r]) {
+                p = put_float(p, b->values[f][r]);
+            }
+        }
+        *p++ = '\n';
+    }
+    b->out_len = (size_t)(p - (char *)b->out);
+}
+
+static void encode_parquet(Batch_t *b) {
+    uint8_t *p = b->out;
+
+    for (uint32_t r = 0; r < b->rows; ++r) {
+        b->node_col[r] = (int32_t)b->node;
+    }
+    p += Parquet_EncodeColumn(&parquet_cols[0], b->node_col, NULL, b->rows, p, &b->chunks[0]);
+    p += Parquet_EncodeColumn(&parquet_cols[1], b->ts, NULL, b->rows, p, &b->chunks[1]);
+    for (int f = 0; f < FIELD_COUNT; ++f) {
+        const uint8_t *present = b->missing[f] ? b->present[f] : NULL;
+        p += Parquet_EncodeColumn(&parquet_cols[2 + f], b->values[f], present, b->rows, p, &b->chunks[2 + f]);
+    }
+    b->out_len = (size_t)(p - b->out);
+}
+
+/*
+ * Merging one node's series
+ */
+
+static int cmp_source(const void *a, const void *b) {
+    int64_t x = ((const Source_t *)a)->t_min, y = ((const Source_t *)b)->t_min;
+    return (x > y) - (x < y);
+}
+
+static uint32_t lower_bound(const int64_t *ts, uint32_t n, int64_t key) {
+    uint32_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ts[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Unsealed records arrive in append order, which is close to time order
+static void sort_raw(int64_t *ts, float *values, uint32_t n) {
+    for (uint32_t i = 1; i < n; ++i) {
+        int64_t t = ts[i];
+        float v = values[i];
+        uint32_t j = i;
+        while (j > 0 && ts[j - 1] > t) {
+            ts[j] = ts[j - 1];
+            values[j] = values[j - 1];
+            --j;
+        }
+        ts[j] = t;
+        values[j] = v;
+    }
+}
+
+static int push_source(Reader_t *r, int64_t t_min, uint8_t field, int32_t chunk) {
+    if (r->n_sources == r->cap_sources) {
+        uint32_t cap = r->cap_sources ? r->cap_sources * 2 : 256;
+        Source_t *sources = realloc(r->sources, cap * sizeof(*sources));
+        if (!sources) {
+            return -1;
+        }
+        r->sources = sources;
+        r->cap_sources = cap;
+    }
+    r->sources[r->n_sources++] = (Source_t){.t_min = t_min, .field = field, .chunk = chunk};
+    return 0;
+}
+
+static int reader_open(Reader_t *r, uint32_t node) {
+    const ExportConfig_t *cfg = &r->exp->cfg;
+
+    r->n_sources = 0;
+    r->next_source = 0;
+    r->n_active = 0;
+    for (uint8_t f = 0; f < FIELD_COUNT; ++f) {
+        SeriesSnapshot_t *snap = &r->snaps[f];
+        SeriesSnapshot_Reset(snap);
+        if (SeriesStore_Snapshot(r->exp->store, Series_Key(node, f, SERIES_RES_RAW), cfg->from, cfg->to, snap) != 0) {
+            return -1;
+        }
+        for (uint32_t c = 0; c < snap->chunks.count; ++c) {
+            if (push_source(r, snap->chunks.refs[c].t_min, f, (int32_t)c) != 0) {
+                return -1;
+            }
+        }
+        if (snap->n_raw > 0) {
+            sort_raw(snap->ts, snap->values, snap->n_raw);
+            if (push_source(r, snap->ts[0], f, -1) != 0) {
+                return -1;
+            }
+        }
+    }
+    qsort(r->sources, r->n_sources, sizeof(*r->sources), cmp_source);
+    return 0;
+}
+
+// Starts merging a source; its rows outside [from, to) are skipped
+static int open_source(Reader_t *r, const Source_t *src, Batch_t *b) {
+    const ExportConfig_t *cfg = &r->exp->cfg;
+    const SeriesSnapshot_t *snap = &r->snaps[src->field];
+
+    if (r->n_active == r->cap_cursors) {
+        uint32_t cap = r->cap_cursors ? r->cap_cursors * 2 : 8;
+        Cursor_t *cursors = realloc(r->cursors, cap * sizeof(*cursors));
+        if (!cursors) {
+            return -1;
+        }
+        memset(cursors + r->cap_cursors, 0, (cap - r->cap_cursors) * sizeof(*cursors));
+        r->cursors = cursors;
+        r->cap_cursors = cap;
+    }
+    Cursor_t *c = &r->cursors[r->n_active];
+    uint32_t n;
+    c->field = src->field;
+    if (src->chunk < 0) {
+        c->ts = snap->ts;
+        c->values = snap->values;
+        n = snap->n_raw;
+    } else {
+        ChunkHeader_t hdr;
+        if (!c->buf_ts) {
+            c->buf_ts = malloc(CHUNK_MAX_RECORDS * sizeof(*c->buf_ts));
+            c->buf_values = malloc(CHUNK_MAX_RECORDS * sizeof(*c->buf_values));
+            if (!c->buf_ts || !c->buf_values) {
+                return -1;
+            }
+        }
+        if (SeriesStore_ReadChunk(r->exp->store, &snap->chunks.refs[src->chunk].loc, &hdr, r->payload,
+                                  Chunk_RawSize(CHUNK_MAX_RECORDS)) != 0 ||
+            hdr.count > CHUNK_MAX_RECORDS || Chunk_DecodeRaw(&hdr, r->payload, c->buf_ts, c->buf_values) != 0) {
+            errno = EIO;
+            return -1;
+        }
+        b->chunks_read++;
+        c->ts = c->buf_ts;
+        c->values = c->buf_values;
+        n = hdr.count;
+    }
+    c->pos = lower_bound(c->ts, n, cfg->from);
+    c->end = lower_bound(c->ts, n, cfg->to);
+    if (c->pos < c->end) {
+        r->n_active++;
+    }
+    return 0;
+}
+
+// Fills b with the node's next rows: 1 if it has more, 0 if done, -1 on error
+static int reader_fill(Reader_t *r, Batch_t *b) {
+    uint32_t cap = r->exp->cfg.batch_rows;
+
+    while (b->rows < cap) {
+        int64_t next = INT64_MAX;
+        for (uint32_t i = 0; i < r->n_active; ++i) {
+            const Cursor_t *c = &r->cursors[i];
+            next = c->ts[c->pos] < next ? c->ts[c->pos] : next;
+        }
+        // Every source that could hold a row at or before next joins the merge first
+        while (r->next_source < r->n_sources && r->sources[r->next_source].t_min <= next) {
+            uint32_t before = r->n_active;
+            if (open_source(r, &r->sources[r->next_source++], b) != 0) {
+                return -1;
+            }
+            if (r->n_active > before) {
+                const Cursor_t *c = &r->cursors[before];
+                next = c->ts[c->pos] < next ? c->ts[c->pos] : next;
+            }
+        }
+        if (r->n_active == 0) {
+            return 0;
+        }
+
+        uint32_t row = b->rows++;
+        b->ts[row] = next;
+        for (int f = 0; f < FIELD_COUNT; ++f) {
+            b->present[f][row] = 0;
+        }
+        for (uint32_t i = 0; i < r->n_active;) {
+            Cursor_t *c = &r->cursors[i];
+            // A duplicate timestamp within a field goes to the next row
+            if (c->ts[c->pos] != next || b->present[c->field][row]) {
+                ++i;
+                continue;
+            }
+            b->values[c->field][row] = c->values[c->pos];
+            b->present[c->field][row] = 1;
+            if (++c->pos == c->end) {
+                // Swap in the last active cursor; the spent one keeps its buffers for reuse
+                Cursor_t spent = *c;
+                *c = r->cursors[--r->n_active];
+                r->cursors[r->n_active] = spent;
+            } else {
+                ++i;
+            }
+        }
+    }
+    return 1;
+}
+
+static void reader_free(Reader_t *r) {
+    for (int f = 0; f < FIELD_COUNT; ++f) {
+        SeriesSnapshot_Free(&r->snaps[f]);
+    }
+    for (uint32_t i = 0; i < r->cap_cursors; ++i) {
+        free(r->cursors[i].buf_ts);
+        free(r->cursors[i].buf_values);
+    }
+    free(r->cursors);
+    free(r->sources);
+    free(r->payload);
+}
+
+/*
+ * Workers
+ */
+
+static Batch_t *take_free(Export_t *exp) {
+    Batch_t *b = NULL;
+
+    pthread_mutex_lock(&exp->lock);
+    while (!exp->pool && !exp->error) {
+        pthread_cond_wait(&exp->freed, &exp->lock);
+    }
+    if (!exp->error) {
+        b = exp->pool;
+        exp->pool = b->next;
+    }
+    pthread_mutex_unlock(&exp->lock);
+    return b;
+}
+
+// Hands a batch to the writer, or back to the pool if it is empty
+static void put_batch(Export_t *exp, Batch_t *b) {
+    pthread_mutex_lock(&exp->lock);
+    b->next = NULL;
+    if (b->rows == 0) {
+        b->next = exp->pool;
+        exp->pool = b;
+        pthread_cond_signal(&exp->freed);
+    } else {
+        if (exp->ready_tail) {
+            exp->ready_tail->next = b;
+        } else {
+            exp->ready = b;
+        }
+        exp->ready_tail = b;
+        pthread_cond_signal(&exp->filled);
+    }
+    pthread_mutex_unlock(&exp->lock);
+}
+
+static int export_node(Reader_t *r, uint32_t node) {
+    Export_t *exp = r->exp;
+    int more = 1;
+
+    if (reader_open(r, node) != 0) {
+        return -1;
+    }
+    while (more == 1) {
+        Batch_t *b = take_free(exp);
+        if (!b) {
+            return 0; // Stopped by an error elsewhere
+        }
+        b->node = node;
+        b->rows = 0;
+        b->chunks_read = 0;
+        more = reader_fill(r, b);
+        if (more < 0) {
+            b->rows = 0;
+            put_batch(exp, b);
+            return -1;
+        }
+        if (b->rows > 0) {
+            b->samples = 0;
+            for (int f = 0; f < FIELD_COUNT; ++f) {
+                uint32_t have = 0;
+                for (uint32_t i = 0; i < b->rows; ++i) {
+                    have += b->present[f][i];
+                }
+                b->missing[f] = b->rows - have;
+                b->samples += have;
+            }
+            if (exp->cfg.format == EXPORT_PARQUET) {
+                encode_parquet(b);
+            } else {
+                encode_csv(b);
+            }
+        }
+        put_batch(exp, b);
+    }
+    return more;
+}
+
+static void *worker(void *arg) {
+    Reader_t *r = arg;
+    Export_t *exp = r->exp;
+
+    for (;;) {
+        uint32_t i;
+        pthread_mutex_lock(&exp->lock);
+        i = exp->error ? exp->n_nodes : exp->next_node++;
+        pthread_mutex_unlock(&exp->lock);
+        if (i >= exp->n_nodes) {
+            break;
+        }
+        if (export_node(r, exp->nodes[i]) != 0) {
+            fail(exp, errno);
+            break;
+        }
+    }
+    pthread_mutex_lock(&exp->lock);
+    exp->running--;
+    pthread_cond_signal(&exp->filled);
+    pthread_mutex_unlock(&exp->lock);
+    return NULL;
+}
+
+/*
+ * Writing
+ */
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_batch(ParquetWriter_t *pq, int fd, const Batch_t *b, ExportStats_t *stats) {
+    if (pq) {
+        if (Parquet_WriteRowGroup(pq, b->out, b->chunks, b->rows) != 0) {
+            return -1;
+        }
+    } else {
+        if (write_all(fd, b->out, b->out_len) != 0) {
+            return -1;
+        }
+        stats->bytes += b->out_len;
+    }
+    stats->rows += b->rows;
+    stats->samples += b->samples;
+    stats->chunks += b->chunks_read;
+    stats->batches++;
+    return 0;
+}
+
+static int write_output(Export_t *exp, int fd, ExportStats_t *stats) {
+    ParquetWriter_t *pq = NULL;
+    int rc = 0;
+
+    if (exp->cfg.format == EXPORT_PARQUET) {
+        pq = Parquet_Open(fd, parquet_cols, COLUMNS);
+        if (!pq) {
+            fail(exp, errno);
+            return -1;
+        }
+    } else {
+        char header[128];
+        int n = snprintf(header, sizeof(header), "node,ts");
+        for (int f = 0; f < FIELD_COUNT; ++f) {
+            n += snprintf(header + n, sizeof(header) - (size_t)n, ",%s", Sample_FieldName(f));
+        }
+        header[n++] = '\n';
+        if (write_all(fd, header, (size_t)n) != 0) {
+            fail(exp, errno);
+            return -1;
+        }
+        stats->bytes += (uint64_t)n;
+    }
+
+    pthread_mutex_lock(&exp->lock);
+    for (;;) {
+        while (!exp->ready && exp->running > 0 && !exp->error) {
+            pthread_cond_wait(&exp->filled, &exp->lock);
+        }
+        if (exp->error || !exp->ready) {
+            break;
+        }
+        Batch_t *b = exp->ready;
+        exp->ready = b->next;
+        if (!exp->ready) {
+            exp->ready_tail = NULL;
+        }
+        pthread_mutex_unlock(&exp->lock);
+
+        rc = write_batch(pq, fd, b, stats);
+
+        pthread_mutex_lock(&exp->lock);
+        b->next = exp->pool;
+        exp->pool = b;
+        pthread_cond_signal(&exp->freed);
+        if (rc != 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&exp->lock);
+    if (rc != 0) {
+        fail(exp, errno);
+    }
+
+    if (pq) {
+        // A failed export is left without a footer, so readers reject it rather than see a partial table
+        if (rc == 0 && !exp->error && Parquet_Finish(pq) != 0) {
+            fail(exp, errno);
+            rc = -1;
+        }
+        stats->bytes = Parquet_Bytes(pq);
+        Parquet_Free(pq);
+    }
+    return rc;
+}
+
+int Export_Run(SeriesStore_t *store, const ExportConfig_t *cfg, int fd, ExportStats_t *stats) {
+    Export_t exp = {.store = store, .cfg = *cfg};
+    ExportStats_t local;
+    Reader_t *readers = NULL;
+    uint32_t *listed = NULL;
+    uint32_t started = 0;
+    int rc = -1;
+
+    if (!stats) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (cfg->threads == 0 || cfg->batch_rows == 0 || cfg->from >= cfg->to) {
+        errno = EINVAL;
+        return -1;
+    }
+    // Every worker holds one batch while filling it; the rest queue for the writer
+    if (exp.cfg.batches < cfg->threads + 1) {
+        exp.cfg.batches = cfg->threads + 1;
+    }
+    if (cfg->nodes) {
+        exp.nodes = cfg->nodes;
+        exp.n_nodes = cfg->n_nodes;
+    } else {
+        if (SeriesStore_ListNodes(store, SERIES_RES_RAW, &listed, &exp.n_nodes) != 0) {
+            return -1;
+        }
+        exp.nodes = listed;
+    }
+    pthread_mutex_init(&exp.lock, NULL);
+    pthread_cond_init(&exp.freed, NULL);
+    pthread_cond_init(&exp.filled, NULL);
+
+    for (uint32_t i = 0; i < exp.cfg.batches; ++i) {
+        Batch_t *b = batch_create(&exp.cfg);
+        if (!b) {
+            goto out;
+        }
+        b->next = exp.pool;
+        exp.pool = b;
+    }
+    readers = calloc(cfg->threads, sizeof(*readers));
+    if (!readers) {
+        goto out;
+    }
+    for (uint32_t t = 0; t < cfg->threads; ++t) {
+        readers[t].exp = &exp;
+        readers[t].payload = malloc(Chunk_RawSize(CHUNK_MAX_RECORDS));
+        if (!readers[t].payload) {
+            goto out;
+        }
+    }
+    exp.running = cfg->threads;
+    for (; started < cfg->threads; ++started) {
+        int err = pthread_create(&readers[started].thread, NULL, worker, &readers[started]);
+        if (err != 0) {
+            pthread_mutex_lock(&exp.lock);
+            exp.running -= cfg->threads - started;
+            pthread_mutex_unlock(&exp.lock);
+            fail(&exp, err);
+            break;
+        }
+    }
+
+    rc = write_output(&exp, fd, stats);
+    for (uint32_t t = 0; t < started; ++t) {
+        pthread_join(readers[t].thread, NULL);
+    }
+    if (exp.error) {
+        errno = exp.error;
+        rc = -1;
+    }
+
+out:
+    if (readers) {
+        for (uint32_t t = 0; t < cfg->threads; ++t) {
+            reader_free(&readers[t]);
+        }
+        free(readers);
+    }
+    while (exp.pool) {
+        Batch_t *b = exp.pool;
+        exp.pool = b->next;
+        batch_free(b);
+    }
+    while (exp.ready) {
+        Batch_t *b = exp.ready;
+        exp.ready = b->next;
+        batch_free(b);
+    }
+    pthread_cond_destroy(&exp.filled);
+    pthread_cond_destroy(&exp.freed);
+    pthread_mutex_destroy(&exp.lock);
+    free(listed);
+    return rc;
+}
@@ -0,0 +1,507 @@
+#include "export/parquet.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAGIC "PAR1"
+#define PAGE_HEADER_MAX 64
+#define DELTA_BLOCK 128
+#define DELTA_MINIBLOCKS 4
+#define DELTA_MINIBLOCK (DELTA_BLOCK / DELTA_MINIBLOCKS)
+#define CREATED_BY "weather-gateway version 1.0"
+
+// Format enums
+#define PAGE_DATA 0
+#define ENC_PLAIN 0
+#define ENC_RLE 3
+#define ENC_DELTA_BINARY_PACKED 5
+#define REP_REQUIRED 0
+#define REP_OPTIONAL 1
+#define CONVERTED_TIMESTAMP_MILLIS 9
+#define CONVERTED_UINT_32 13
+
+// Thrift compact protocol types
+#define TC_I32 5
+#define TC_I64 6
+#define TC_BINARY 8
+#define TC_LIST 9
+#define TC_STRUCT 12
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} Buf_t;
+
+struct ParquetWriter {
+    int fd;
+    const ParquetColumn_t *cols;
+    uint32_t n_cols;
+    uint64_t offset;
+    uint64_t rows;
+    uint32_t n_groups;
+    Buf_t groups; // RowGroup structs, serialised as they are written
+    bool failed;
+};
+
+static uint8_t *buf_reserve(Buf_t *b, size_t n) {
+    if (b->failed) {
+        return NULL;
+    }
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap * 2 > b->len + n ? b->cap * 2 : b->len + n;
+        uint8_t *data = realloc(b->data, cap);
+        if (!data) {
+            b->failed = true;
+            return NULL;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+    return b->data + b->len;
+}
+
+/*
+ * Thrift compact protocol. Callers reserve room first; a struct tracks the
+ * last field id written, as ids are sent as deltas.
+ */
+
+static uint8_t *tc_varint(uint8_t *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static uint8_t *tc_field(uint8_t *p, int16_t *last, int16_t id, uint8_t type) {
+    if (id > *last && id - *last <= 15) {
+        *p++ = (uint8_t)(((id - *last) << 4) | type);
+    } else {
+        *p++ = type;
+        p = tc_varint(p, zigzag(id));
+    }
+    *last = id;
+    return p;
+}
+
+static uint8_t *tc_i32(uint8_t *p, int16_t *last, int16_t id, int32_t v) {
+    return tc_varint(tc_field(p, last, id, TC_I32), zigzag(v));
+}
+
+static uint8_t *tc_i64(uint8_t *p, int16_t *last, int16_t id, int64_t v) {
+    return tc_varint(tc_field(p, last, id, TC_I64), zigzag(v));
+}
+
+static uint8_t *tc_bytes(uint8_t *p, const void *data, size_t len) {
+    p = tc_varint(p, len);
+    memcpy(p, data, len);
+    return p + len;
+}
+
+static uint8_t *tc_binary(uint8_t *p, int16_t *last, int16_t id, const void *data, size_t len) {
+    return tc_bytes(tc_field(p, last, id, TC_BINARY), data, len);
+}
+
+static uint8_t *tc_list(uint8_t *p, uint8_t elem, uint32_t n) {
+    if (n < 15) {
+        *p++ = (uint8_t)((n << 4) | elem);
+        return p;
+    }
+    *p++ = (uint8_t)(0xF0 | elem);
+    return tc_varint(p, n);
+}
+
+static uint8_t *tc_stop(uint8_t *p) {
+    *p++ = 0;
+    return p;
+}
+
+/*
+ * Column encodings
+ */
+
+typedef struct {
+    uint8_t *p;
+    uint64_t acc;
+    unsigned n;
+} BitWriter_t;
+
+static void bits_put(BitWriter_t *w, uint64_t v, unsigned width) {
+    if (width > 32) {
+        bits_put(w, v & 0xFFFFFFFFu, 32);
+        bits_put(w, v >> 32, width - 32);
+        return;
+    }
+    w->acc |= v << w->n;
+    w->n += width;
+    while (w->n >= 8) {
+        *w->p++ = (uint8_t)w->acc;
+        w->acc >>= 8;
+        w->n -= 8;
+    }
+}
+
+static unsigned bit_width(uint64_t v) {
+    return v ? 64 - (unsigned)__builtin_clzll(v) : 0;
+}
+
+// The present values of an integer column in row order, widened; UINT_32 zero-extended
+typedef struct {
+    const ParquetColumn_t *col;
+    const void *values;
+    const uint8_t *present;
+    uint32_t row;
+} IntReader_t;
+
+static int64_t next_int(IntReader_t *r) {
+    while (r->present && !r->present[r->row]) {
+        r->row++;
+    }
+    uint32_t i = r->row++;
+    if (r->col->type == PARQUET_INT64) {
+        return ((const int64_t *)r->values)[i];
+    }
+    int32_t v = ((const int32_t *)r->values)[i];
+    return r->col->logical == PARQUET_UINT32 ? (int64_t)(uint32_t)v : (int64_t)v;
+}
+
+// DELTA_BINARY_PACKED over n values; 32-bit columns take their deltas modulo 2^32
+static uint8_t *encode_delta(uint8_t *p, IntReader_t *r, uint32_t n, ParquetChunk_t *chunk) {
+    bool wide = r->col->type == PARQUET_INT64;
+    uint64_t mask = wide ? UINT64_MAX : 0xFFFFFFFFu;
+    int64_t prev = n ? next_int(r) : 0, lo = prev, hi = prev;
+
+    p = tc_varint(p, DELTA_BLOCK);
+    p = tc_varint(p, DELTA_MINIBLOCKS);
+    p = tc_varint(p, n);
+    p = tc_varint(p, zigzag(wide ? prev : (int32_t)(uint32_t)prev));
+    for (uint32_t start = 1; start < n; start += DELTA_BLOCK) {
+        uint32_t count = n - start < DELTA_BLOCK ? n - start : DELTA_BLOCK;
+        int64_t deltas[DELTA_BLOCK];
+        int64_t min = INT64_MAX;
+        for (uint32_t i = 0; i < count; ++i) {
+            int64_t v = next_int(r);
+            uint64_t d = ((uint64_t)v - (uint64_t)prev) & mask;
+            deltas[i] = wide ? (int64_t)d : (int64_t)(int32_t)(uint32_t)d;
+            min = deltas[i] < min ? deltas[i] : min;
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+            prev = v;
+        }
+        p = tc_varint(p, zigzag(min));
+        uint8_t *widths = p;
+        p += DELTA_MINIBLOCKS;
+        for (uint32_t m = 0; m < DELTA_MINIBLOCKS; ++m) {
+            uint32_t first = m * DELTA_MINIBLOCK;
+            if (first >= count) {
+                widths[m] = 0;
+                continue;
+            }
+            uint64_t top = 0;
+            for (uint32_t i = first; i < first + DELTA_MINIBLOCK && i < count; ++i) {
+                top |= ((uint64_t)deltas[i] - (uint64_t)min) & mask;
+            }
+            unsigned width = bit_width(top);
+            widths[m] = (uint8_t)width;
+            // A short last miniblock is padded out to full length
+            BitWriter_t w = {.p = p};
+            for (uint32_t i = first; i < first + DELTA_MINIBLOCK; ++i) {
+                bits_put(&w, i < count ? ((uint64_t)deltas[i] - (uint64_t)min) & mask : 0, width);
+            }
+            p = w.p;
+        }
+    }
+    if (n > 0) {
+        size_t len = wide ? 8 : 4;
+        for (size_t i = 0; i < len; ++i) {
+            chunk->min[i] = (uint8_t)((uint64_t)lo >> (8 * i));
+            chunk->max[i] = (uint8_t)((uint64_t)hi >> (8 * i));
+        }
+        chunk->has_stats = true;
+    }
+    return p;
+}
+
+// Definition levels, bit width 1, behind their length: one RLE run when every row has a value, else bit-packed
+static uint8_t *encode_levels(uint8_t *p, const uint8_t *present, uint32_t rows, uint32_t nulls) {
+    uint8_t *len = p, *start = p + 4;
+
+    p = start;
+    if (nulls == 0) {
+        p = tc_varint(p, (uint64_t)rows << 1);
+        *p++ = 1;
+    } else {
+        uint32_t groups = (rows + 7) / 8;
+        p = tc_varint(p, ((uint64_t)groups << 1) | 1);
+        memset(p, 0, groups);
+        for (uint32_t i = 0; i < rows; ++i) {
+            p[i / 8] |= (uint8_t)((present[i] != 0) << (i % 8));
+        }
+        p += groups;
+    }
+    uint32_t n = (uint32_t)(p - start);
+    len[0] = (uint8_t)n;
+    len[1] = (uint8_t)(n >> 8);
+    len[2] = (uint8_t)(n >> 16);
+    len[3] = (uint8_t)(n >> 24);
+    return p;
+}
+
+size_t Parquet_ColumnBound(const ParquetColumn_t *col, uint32_t rows) {
+    size_t values = col->type == PARQUET_FLOAT ? (size_t)rows * 4
+                                               : 40 + ((size_t)rows + DELTA_MINIBLOCK) * 8 + ((size_t)rows / DELTA_BLOCK + 1) * 16;
+    size_t levels = col->optional ? 16 + (size_t)rows / 8 : 0;
+    return PAGE_HEADER_MAX + levels + values;
+}
+
+static void stats_float(const float *v, const uint8_t *present, uint32_t rows, ParquetChunk_t *chunk) {
+    float min = INFINITY, max = -INFINITY;
+    bool any = false;
+
+    for (uint32_t i = 0; i < rows; ++i) {
+        if ((!present || present[i]) && !isnan(v[i])) {
+            min = v[i] < min ? v[i] : min;
+            max = v[i] > max ? v[i] : max;
+            any = true;
+        }
+    }
+    if (any) {
+        memcpy(chunk->min, &min, 4);
+        memcpy(chunk->max, &max, 4);
+        chunk->has_stats = true;
+    }
+}
+
+size_t Parquet_EncodeColumn(const ParquetColumn_t *col, const void *values, const uint8_t *present, uint32_t rows,
+                            uint8_t *out, ParquetChunk_t *chunk) {
+    uint8_t *body = out + PAGE_HEADER_MAX, *p = body;
+    uint32_t n = rows;
+
+    memset(chunk, 0, sizeof(*chunk));
+    for (uint32_t i = 0; present && i < rows; ++i) {
+        n -= !present[i];
+    }
+    if (col->optional) {
+        p = encode_levels(p, present, rows, rows - n);
+    }
+    if (col->type == PARQUET_FLOAT) {
+        const float *v = values;
+        if (!present) {
+            memcpy(p, v, (size_t)rows * 4);
+            p += (size_t)rows * 4;
+        }
+        for (uint32_t i = 0; present && i < rows; ++i) {
+            if (present[i]) {
+                memcpy(p, &v[i], 4);
+                p += 4;
+            }
+        }
+        stats_float(v, present, rows, chunk);
+    } else {
+        IntReader_t r = {.col = col, .values = values, .present = present};
+        p = encode_delta(p, &r, n, chunk);
+    }
+    chunk->values = rows;
+    chunk->nulls = rows - n;
+
+    uint32_t page = (uint32_t)(p - body);
+    uint8_t hdr[PAGE_HEADER_MAX], *h = hdr;
+    int16_t last = 0, last_dp = 0;
+    h = tc_i32(h, &last, 1, PAGE_DATA);
+    h = tc_i32(h, &last, 2, (int32_t)page);
+    h = tc_i32(h, &last, 3, (int32_t)page);
+    h = tc_field(h, &last, 5, TC_STRUCT);
+    h = tc_i32(h, &last_dp, 1, (int32_t)rows);
+    h = tc_i32(h, &last_dp, 2, col->type == PARQUET_FLOAT ? ENC_PLAIN : ENC_DELTA_BINARY_PACKED);
+    h = tc_i32(h, &last_dp, 3, ENC_RLE);
+    h = tc_i32(h, &last_dp, 4, ENC_RLE);
+    h = tc_stop(h);
+    h = tc_stop(h);
+    size_t hlen = (size_t)(h - hdr);
+    memcpy(out, hdr, hlen);
+    memmove(out + hlen, body, page);
+    chunk->size = hlen + page;
+    return (size_t)chunk->size;
+}
+
+static int write_all(ParquetWriter_t *w, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    while (len > 0 && !w->failed) {
+        ssize_t n = write(w->fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            w->failed = true;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        w->offset += (uint64_t)n;
+    }
+    return w->failed ? -1 : 0;
+}
+
+ParquetWriter_t *Parquet_Open(int fd, const ParquetColumn_t *cols, uint32_t n_cols) {
+    ParquetWriter_t *w = calloc(1, sizeof(*w));
+
+    if (!w) {
+        return NULL;
+    }
+    w->fd = fd;
+    w->cols = cols;
+    w->n_cols = n_cols;
+    if (write_all(w, MAGIC, 4) != 0) {
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+int Parquet_WriteRowGroup(ParquetWriter_t *w, const uint8_t *data, const ParquetChunk_t *chunks, uint32_t rows) {
+    uint64_t start = w->offset, total = 0;
+    size_t bound = 64;
+
+    for (uint32_t c = 0; c < w->n_cols; ++c) {
+        total += chunks[c].size;
+        bound += 160 + strlen(w->cols[c].name);
+    }
+    if (write_all(w, data, total) != 0) {
+        return -1;
+    }
+    uint8_t *p = buf_reserve(&w->groups, bound), *begin = p;
+    if (!p) {
+        w->failed = true;
+        return -1;
+    }
+    int16_t last = 0;
+    p = tc_field(p, &last, 1, TC_LIST);
+    p = tc_list(p, TC_STRUCT, w->n_cols);
+    uint64_t off = start;
+    for (uint32_t c = 0; c < w->n_cols; ++c) {
+        const ParquetColumn_t *col = &w->cols[c];
+        const ParquetChunk_t *ch = &chunks[c];
+        int16_t last_cc = 0, last_md = 0;
+        p = tc_i64(p, &last_cc, 2, (int64_t)off);
+        p = tc_field(p, &last_cc, 3, TC_STRUCT);
+        p = tc_i32(p, &last_md, 1, col->type);
+        p = tc_field(p, &last_md, 2, TC_LIST);
+        if (col->optional) {
+            p = tc_list(p, TC_I32, 2);
+            p = tc_varint(p, zigzag(ENC_RLE));
+        } else {
+            p = tc_list(p, TC_I32, 1);
+        }
+        p = tc_varint(p, zigzag(col->type == PARQUET_FLOAT ? ENC_PLAIN : ENC_DELTA_BINARY_PACKED));
+        p = tc_field(p, &last_md, 3, TC_LIST);
+        p = tc_list(p, TC_BINARY, 1);
+        p = tc_bytes(p, col->name, strlen(col->name));
+        p = tc_i32(p, &last_md, 4, 0); // UNCOMPRESSED
+        p = tc_i64(p, &last_md, 5, (int64_t)ch->values);
+        p = tc_i64(p, &last_md, 6, (int64_t)ch->size);
+        p = tc_i64(p, &last_md, 7, (int64_t)ch->size);
+        p = tc_i64(p, &last_md, 9, (int64_t)off);
+        p = tc_field(p, &last_md, 12, TC_STRUCT);
+        int16_t last_st = 0;
+        p = tc_i64(p, &last_st, 3, (int64_t)ch->nulls);
+        if (ch->has_stats) {
+            size_t len = col->type == PARQUET_INT64 ? 8 : 4;
+            p = tc_binary(p, &last_st, 5, ch->max, len);
+            p = tc_binary(p, &last_st, 6, ch->min, len);
+        }
+        p = tc_stop(p); // Statistics
+        p = tc_stop(p); // ColumnMetaData
+        p = tc_stop(p); // ColumnChunk
+        off += ch->size;
+    }
+    p = tc_i64(p, &last, 2, (int64_t)total);
+    p = tc_i64(p, &last, 3, rows);
+    p = tc_i64(p, &last, 5, (int64_t)start);
+    p = tc_i64(p, &last, 6, (int64_t)total);
+    p = tc_stop(p);
+    w->groups.len += (size_t)(p - begin);
+    w->n_groups++;
+    w->rows += rows;
+    return 0;
+}
+
+int Parquet_Finish(ParquetWriter_t *w) {
+    Buf_t meta = {0};
+    size_t bound = 128 + w->groups.len + strlen(CREATED_BY);
+    int rc = -1;
+
+    for (uint32_t c = 0; c < w->n_cols; ++c) {
+        bound += 32 + strlen(w->cols[c].name);
+    }
+    uint8_t *p = buf_reserve(&meta, bound), *begin = p;
+    if (p && !w->groups.failed && !w->failed) {
+        int16_t last = 0;
+        p = tc_i32(p, &last, 1, 1);
+        p = tc_field(p, &last, 2, TC_LIST);
+        p = tc_list(p, TC_STRUCT, w->n_cols + 1);
+        int16_t last_se = 0;
+        p = tc_binary(p, &last_se, 4, "schema", 6);
+        p = tc_i32(p, &last_se, 5, (int32_t)w->n_cols);
+        p = tc_stop(p);
+        for (uint32_t c = 0; c < w->n_cols; ++c) {
+            const ParquetColumn_t *col = &w->cols[c];
+            last_se = 0;
+            p = tc_i32(p, &last_se, 1, col->type);
+            p = tc_i32(p, &last_se, 3, col->optional ? REP_OPTIONAL : REP_REQUIRED);
+            p = tc_binary(p, &last_se, 4, col->name, strlen(col->name));
+            if (col->logical == PARQUET_UINT32) {
+                p = tc_i32(p, &last_se, 6, CONVERTED_UINT_32);
+            } else if (col->logical == PARQUET_TIMESTAMP_MS) {
+                p = tc_i32(p, &last_se, 6, CONVERTED_TIMESTAMP_MILLIS);
+            }
+            p = tc_stop(p);
+        }
+        p = tc_i64(p, &last, 3, (int64_t)w->rows);
+        p = tc_field(p, &last, 4, TC_LIST);
+        p = tc_list(p, TC_STRUCT, w->n_groups);
+        memcpy(p, w->groups.data, w->groups.len);
+        p += w->groups.len;
+        p = tc_binary(p, &last, 6, CREATED_BY, strlen(CREATED_BY));
+        // Type-defined order for every column, so readers trust min_value and max_value
+        p = tc_field(p, &last, 7, TC_LIST);
+        p = tc_list(p, TC_STRUCT, w->n_cols);
+        for (uint32_t c = 0; c < w->n_cols; ++c) {
+            int16_t last_co = 0;
+            p = tc_field(p, &last_co, 1, TC_STRUCT);
+            p = tc_stop(p);
+            p = tc_stop(p);
+        }
+        p = tc_stop(p);
+        uint32_t len = (uint32_t)(p - begin);
+        uint8_t tail[8] = {(uint8_t)len, (uint8_t)(len >> 8), (uint8_t)(len >> 16), (uint8_t)(len >> 24),
+                           'P', 'A', 'R', '1'};
+        if (write_all(w, begin, len) == 0 && write_all(w, tail, sizeof(tail)) == 0) {
+            rc = 0;
+        }
+    }
+    free(meta.data);
+    return rc;
+}
+
+void Parquet_Free(ParquetWriter_t *w) {
+    if (!w) {
+        return;
+    }
+    free(w->groups.data);
+    free(w);
+}
+
+uint64_t Parquet_Bytes(const ParquetWriter_t *w) {
+    return w->offset;
+}
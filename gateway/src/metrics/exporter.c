@@ -0,0 +1,170 @@
+#include "metrics/exporter.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define EXPORTER_REQUEST_MAX 2048
+#define EXPORTER_TIMEOUT_MS 2000
+
+struct MetricsExporter {
+    int listen_fd;
+    int wake[2];
+    pthread_t thread;
+    Metrics_t *metrics;
+};
+
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Reads up to the end of the request headers; -1 on timeout or disconnect
+static int read_request(int fd, char *buf, size_t cap) {
+    size_t len = 0;
+
+    while (len < cap - 1) {
+        struct pollfd p = {.fd = fd, .events = POLLIN};
+        if (poll(&p, 1, EXPORTER_TIMEOUT_MS) <= 0) {
+            return -1;
+        }
+        ssize_t n = recv(fd, buf + len, cap - 1 - len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        len += (size_t)n;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void serve(MetricsExporter_t *exporter, int fd) {
+    char req[EXPORTER_REQUEST_MAX], head[160];
+    char *body = NULL;
+    size_t body_len = 0;
+
+    if (read_request(fd, req, sizeof(req)) != 0) {
+        return;
+    }
+    if (strncmp(req, "GET /metrics ", 13) != 0 && strncmp(req, "GET /metrics?", 13) != 0) {
+        static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+    FILE *out = open_memstream(&body, &body_len);
+    if (!out) {
+        return;
+    }
+    Metrics_Write(exporter->metrics, out);
+    fclose(out);
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n",
+                     body_len);
+    if (send_all(fd, head, (size_t)n) == 0) {
+        send_all(fd, body, body_len);
+    }
+    free(body);
+}
+
+static void *exporter_thread(void *arg) {
+    MetricsExporter_t *exporter = arg;
+
+    for (;;) {
+        struct pollfd fds[2] = {
+            {.fd = exporter->wake[0], .events = POLLIN},
+            {.fd = exporter->listen_fd, .events = POLLIN},
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+        if (fds[1].revents) {
+            int fd = accept4(exporter->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                serve(exporter, fd);
+                close(fd);
+            }
+        }
+    }
+    return NULL;
+}
+
+MetricsExporter_t *MetricsExporter_Start(Metrics_t *metrics, uint16_t port) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    MetricsExporter_t *exporter = calloc(1, sizeof(*exporter));
+    int one = 1;
+
+    if (!exporter) {
+        return NULL;
+    }
+    exporter->metrics = metrics;
+    exporter->wake[0] = exporter->wake[1] = -1;
+    exporter->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (exporter->listen_fd < 0 || pipe2(exporter->wake, O_CLOEXEC) != 0) {
+        goto fail;
+    }
+    setsockopt(exporter->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(exporter->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(exporter->listen_fd, 8) != 0 ||
+        pthread_create(&exporter->thread, NULL, exporter_thread, exporter) != 0) {
+        goto fail;
+    }
+    return exporter;
+
+fail:
+    if (exporter->listen_fd >= 0) {
+        close(exporter->listen_fd);
+    }
+    if (exporter->wake[0] >= 0) {
+        close(exporter->wake[0]);
+        close(exporter->wake[1]);
+    }
+    free(exporter);
+    return NULL;
+}
+
+void MetricsExporter_Stop(MetricsExporter_t *exporter) {
+    if (!exporter) {
+        return;
+    }
+    ssize_t n = write(exporter->wake[1], "x", 1);
+    (void)n;
+    pthread_join(exporter->thread, NULL);
+    close(exporter->listen_fd);
+    close(exporter->wake[0]);
+    close(exporter->wake[1]);
+    free(exporter);
+}
@@ -0,0 +1,368 @@
+#include "metrics/metrics.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define METRICS_NAME_MAX 128
+#define METRICS_HELP_MAX 160
+
+typedef struct {
+    char name[METRICS_NAME_MAX];
+    char help[METRICS_HELP_MAX];
+    MetricType_t type;
+    int32_t slot; // Shard slot, or gauge index
+    double scale;
+} MetricDesc_t;
+
+typedef struct MetricsShard {
+    struct MetricsShard *next;
+    Metrics_t *metrics;
+    bool in_use;
+    uint64_t slots[METRICS_MAX_SLOTS];
+} MetricsShard_t;
+
+typedef struct {
+    MetricsCollector_t fn;
+    void *ctx;
+} Collector_t;
+
+struct Metrics {
+    pthread_mutex_t lock;         // Registration, shard list and scrapes
+    pthread_mutex_t collect_lock; // Collectors; they take their modules' locks
+    pthread_key_t key;    // Calling thread's shard
+    MetricDesc_t descs[METRICS_MAX];
+    uint32_t n_descs;
+    uint32_t slots_used;
+    uint32_t gauges_used;
+    uint64_t gauges[METRICS_MAX]; // double bits
+    MetricsShard_t *shards;
+    Collector_t collectors[METRICS_MAX_COLLECTORS];
+    uint32_t n_collectors;
+};
+
+__thread MetricsThreadCache_t metrics_thread_cache;
+
+// Thread exit: keep the counts, let the next thread take the shard over
+static void release_shard(void *arg) {
+    MetricsShard_t *shard = arg;
+
+    pthread_mutex_lock(&shard->metrics->lock);
+    shard->in_use = false;
+    pthread_mutex_unlock(&shard->metrics->lock);
+}
+
+Metrics_t *Metrics_Create(void) {
+    Metrics_t *metrics = calloc(1, sizeof(*metrics));
+
+    if (!metrics) {
+        return NULL;
+    }
+    if (pthread_key_create(&metrics->key, release_shard) != 0) {
+        free(metrics);
+        return NULL;
+    }
+    pthread_mutex_init(&metrics->lock, NULL);
+    pthread_mutex_init(&metrics->collect_lock, NULL);
+    return metrics;
+}
+
+void Metrics_Destroy(Metrics_t *metrics) {
+    if (!metrics) {
+        return;
+    }
+    pthread_key_delete(metrics->key);
+    if (metrics_thread_cache.owner == metrics) {
+        metrics_thread_cache = (MetricsThreadCache_t){0};
+    }
+    while (metrics->shards) {
+        MetricsShard_t *next = metrics->shards->next;
+        free(metrics->shards);
+        metrics->shards = next;
+    }
+    pthread_mutex_destroy(&metrics->lock);
+    pthread_mutex_destroy(&metrics->collect_lock);
+    free(metrics);
+}
+
+uint64_t *Metrics_ThreadSlots(Metrics_t *metrics) {
+    MetricsShard_t *shard = pthread_getspecific(metrics->key);
+
+    if (!shard) {
+        pthread_mutex_lock(&metrics->lock);
+        for (shard = metrics->shards; shard && shard->in_use; shard = shard->next) {
+        }
+        if (!shard) {
+            shard = calloc(1, sizeof(*shard));
+            if (shard) {
+                shard->metrics = metrics;
+                shard->next = metrics->shards;
+                metrics->shards = shard;
+            }
+        }
+        if (shard) {
+            shard->in_use = true;
+        }
+        pthread_mutex_unlock(&metrics->lock);
+        if (!shard || pthread_setspecific(metrics->key, shard) != 0) {
+            // Out of memory: count into a throwaway shard rather than crash the caller
+            static __thread uint64_t sink[METRICS_MAX_SLOTS];
+            return sink;
+        }
+    }
+    metrics_thread_cache.owner = metrics;
+    metrics_thread_cache.slots = shard->slots;
+    return shard->slots;
+}
+
+static Metric_t add_desc(Metrics_t *metrics, const char *name, const char *help, MetricType_t type, double scale) {
+    Metric_t m = {.metrics = metrics, .slot = -1};
+    uint32_t need = type == METRIC_HISTOGRAM ? METRICS_HIST_SLOTS : type == METRIC_COUNTER ? 1 : 0;
+
+    if (strlen(name) >= METRICS_NAME_MAX) {
+        return m;
+    }
+    pthread_mutex_lock(&metrics->lock);
+    if (metrics->n_descs < METRICS_MAX && metrics->slots_used + need <= METRICS_MAX_SLOTS) {
+        MetricDesc_t *d = &metrics->descs[metrics->n_descs++];
+        snprintf(d->name, sizeof(d->name), "%s", name);
+        snprintf(d->help, sizeof(d->help), "%s", help ? help : "");
+        d->type = type;
+        d->scale = scale;
+        if (type == METRIC_GAUGE) {
+            d->slot = (int32_t)metrics->gauges_used++;
+        } else {
+            d->slot = (int32_t)metrics->slots_used;
+            metrics->slots_used += need;
+        }
+        m.slot = d->slot;
+    }
+    pthread_mutex_unlock(&metrics->lock);
+    return m;
+}
+
+Metric_t Metrics_Counter(Metrics_t *metrics, const char *name, const char *help) {
+    return add_desc(metrics, name, help, METRIC_COUNTER, 1.0);
+}
+
+Metric_t Metrics_Gauge(Metrics_t *metrics, const char *name, const char *help) {
+    return add_desc(metrics, name, help, METRIC_GAUGE, 1.0);
+}
+
+Metric_t Metrics_Histogram(Metrics_t *metrics, const char *name, const char *help, double scale) {
+    return add_desc(metrics, name, help, METRIC_HISTOGRAM, scale);
+}
+
+int Metrics_AddCollector(Metrics_t *metrics, MetricsCollector_t fn, void *ctx) {
+    int rc = -1;
+
+    pthread_mutex_lock(&metrics->collect_lock);
+    if (metrics->n_collectors < METRICS_MAX_COLLECTORS) {
+        metrics->collectors[metrics->n_collectors++] = (Collector_t){fn, ctx};
+        rc = 0;
+    }
+    pthread_mutex_unlock(&metrics->collect_lock);
+    return rc;
+}
+
+void Metrics_RemoveCollector(Metrics_t *metrics, MetricsCollector_t fn, void *ctx) {
+    pthread_mutex_lock(&metrics->collect_lock);
+    for (uint32_t i = 0; i < metrics->n_collectors; ++i) {
+        if (metrics->collectors[i].fn == fn && metrics->collectors[i].ctx == ctx) {
+            memmove(&metrics->collectors[i], &metrics->collectors[i + 1],
+                    (metrics->n_collectors - i - 1) * sizeof(metrics->collectors[0]));
+            metrics->n_collectors--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&metrics->collect_lock);
+}
+
+static uint64_t double_bits(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+void Metrics_Set(Metric_t gauge, double value) {
+    if (gauge.slot >= 0) {
+        __atomic_store_n(&gauge.metrics->gauges[gauge.slot], double_bits(value), __ATOMIC_RELAXED);
+    }
+}
+
+void Metrics_GaugeAdd(Metric_t gauge, double delta) {
+    if (gauge.slot < 0) {
+        return;
+    }
+    uint64_t *g = &gauge.metrics->gauges[gauge.slot];
+    uint64_t old = __atomic_load_n(g, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(g, &old, double_bits(bits_double(old) + delta), true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+    }
+}
+
+double Metrics_GaugeValue(Metric_t gauge) {
+    return gauge.slot >= 0 ? bits_double(__atomic_load_n(&gauge.metrics->gauges[gauge.slot], __ATOMIC_RELAXED)) : 0.0;
+}
+
+// Sums n slots from every shard; lock held
+static void merge_slots(const Metrics_t *metrics, int32_t slot, uint32_t n, uint64_t *out) {
+    memset(out, 0, n * sizeof(*out));
+    for (const MetricsShard_t *s = metrics->shards; s; s = s->next) {
+        for (uint32_t i = 0; i < n; ++i) {
+            out[i] += __atomic_load_n(&s->slots[slot + (int32_t)i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+uint64_t Metrics_CounterValue(Metric_t counter) {
+    uint64_t v = 0;
+
+    if (counter.slot >= 0) {
+        pthread_mutex_lock(&counter.metrics->lock);
+        merge_slots(counter.metrics, counter.slot, 1, &v);
+        pthread_mutex_unlock(&counter.metrics->lock);
+    }
+    return v;
+}
+
+// Largest value that lands in bucket b
+static uint64_t bucket_upper(uint32_t b) {
+    if (b < (1u << METRICS_HIST_SUB_BITS)) {
+        return b;
+    }
+    uint32_t exp = (b >> METRICS_HIST_SUB_BITS) + METRICS_HIST_SUB_BITS - 1;
+    uint64_t sub = b & ((1u << METRICS_HIST_SUB_BITS) - 1);
+    uint32_t shift = exp - METRICS_HIST_SUB_BITS;
+    return (((1ull << METRICS_HIST_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+uint64_t Metrics_Quantile(Metric_t hist, double q) {
+    uint64_t buckets[METRICS_HIST_SLOTS], total = 0, seen = 0;
+
+    if (hist.slot < 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&hist.metrics->lock);
+    merge_slots(hist.metrics, hist.slot, METRICS_HIST_BUCKETS, buckets);
+    pthread_mutex_unlock(&hist.metrics->lock);
+    for (uint32_t b = 0; b < METRICS_HIST_BUCKETS; ++b) {
+        total += buckets[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)(total - 1)) + 1;
+    for (uint32_t b = 0; b < METRICS_HIST_BUCKETS; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return bucket_upper(b);
+        }
+    }
+    return bucket_upper(METRICS_HIST_BUCKETS - 1);
+}
+
+// "name{labels}" -> family length and the labels without braces
+static size_t split_name(const char *name, const char **labels, size_t *labels_len) {
+    const char *brace = strchr(name, '{');
+
+    if (!brace) {
+        *labels = "";
+        *labels_len = 0;
+        return strlen(name);
+    }
+    *labels = brace + 1;
+    *labels_len = strlen(brace + 1);
+    if (*labels_len > 0 && brace[*labels_len] == '}') {
+        (*labels_len)--;
+    }
+    return (size_t)(brace - name);
+}
+
+static const char *type_name(MetricType_t type) {
+    return type == METRIC_COUNTER ? "counter" : type == METRIC_GAUGE ? "gauge" : "histogram";
+}
+
+static void write_histogram(FILE *out, const MetricDesc_t *d, const uint64_t *merged, int family_len,
+                            const char *labels, int labels_len) {
+    const char *sep = labels_len > 0 ? "," : "";
+    uint64_t cumulative = 0, total = 0;
+    uint32_t b = 0;
+
+    for (uint32_t i = 0; i < METRICS_HIST_BUCKETS; ++i) {
+        total += merged[i];
+    }
+    // Bucket edges at each power of two: values below 2^k
+    for (uint32_t k = 1; k <= METRICS_HIST_MAX_EXP + 1; ++k) {
+        uint32_t end = k <= METRICS_HIST_SUB_BITS ? (1u << k) : (k - METRICS_HIST_SUB_BITS + 1) << METRICS_HIST_SUB_BITS;
+        for (; b < end; ++b) {
+            cumulative += merged[b];
+        }
+        fprintf(out, "%.*s_bucket{%.*s%sle=\"%.9g\"} %llu\n", family_len, d->name, labels_len, labels, sep,
+                (double)(1ull << k) * d->scale, (unsigned long long)cumulative);
+    }
+    fprintf(out, "%.*s_bucket{%.*s%sle=\"+Inf\"} %llu\n", family_len, d->name, labels_len, labels, sep,
+            (unsigned long long)total);
+    if (labels_len > 0) {
+        fprintf(out, "%.*s_sum{%.*s} %.9g\n", family_len, d->name, labels_len, labels,
+                (double)merged[METRICS_HIST_BUCKETS] * d->scale);
+        fprintf(out, "%.*s_count{%.*s} %llu\n", family_len, d->name, labels_len, labels, (unsigned long long)total);
+    } else {
+        fprintf(out, "%.*s_sum %.9g\n", family_len, d->name, (double)merged[METRICS_HIST_BUCKETS] * d->scale);
+        fprintf(out, "%.*s_count %llu\n", family_len, d->name, (unsigned long long)total);
+    }
+}
+
+int Metrics_Write(Metrics_t *metrics, FILE *out) {
+    uint64_t merged[METRICS_HIST_SLOTS];
+    const MetricDesc_t *prev = NULL;
+    size_t prev_len = 0;
+
+    pthread_mutex_lock(&metrics->lock);
+    for (uint32_t i = 0; i < metrics->n_descs; ++i) {
+        const MetricDesc_t *d = &metrics->descs[i];
+        const char *labels;
+        size_t labels_len;
+        size_t family_len = split_name(d->name, &labels, &labels_len);
+
+        if (!prev || prev_len != family_len || strncmp(prev->name, d->name, family_len) != 0) {
+            fprintf(out, "# HELP %.*s %s\n# TYPE %.*s %s\n", (int)family_len, d->name, d->help, (int)family_len,
+                    d->name, type_name(d->type));
+        }
+        prev = d;
+        prev_len = family_len;
+
+        if (d->type == METRIC_GAUGE) {
+            fprintf(out, "%s %.9g\n", d->name, bits_double(__atomic_load_n(&metrics->gauges[d->slot], __ATOMIC_RELAXED)));
+        } else if (d->type == METRIC_COUNTER) {
+            merge_slots(metrics, d->slot, 1, merged);
+            fprintf(out, "%s %llu\n", d->name, (unsigned long long)merged[0]);
+        } else {
+            merge_slots(metrics, d->slot, METRICS_HIST_SLOTS, merged);
+            write_histogram(out, d, merged, (int)family_len, labels, (int)labels_len);
+        }
+    }
+    pthread_mutex_unlock(&metrics->lock);
+
+    // Not under the registry lock: a module may register or update metrics
+    // while holding its own lock, which its collector takes
+    pthread_mutex_lock(&metrics->collect_lock);
+    for (uint32_t i = 0; i < metrics->n_collectors; ++i) {
+        metrics->collectors[i].fn(metrics->collectors[i].ctx, out);
+    }
+    pthread_mutex_unlock(&metrics->collect_lock);
+    return ferror(out) ? -1 : 0;
+}
+
+void Metrics_WriteValue(FILE *out, const char *name, const char *help, MetricType_t type, double value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type_name(type));
+    // Counts print exactly; other values need no more than gauge precision
+    fprintf(out, value == (double)(int64_t)value ? "%s %.0f\n" : "%s %.9g\n", name, value);
+}
@@ -0,0 +1,214 @@
+#include "ota/delta.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hash.h"
+
+#define OP_COPY 0x80
+#define OP_LEN_EXT 0x7F
+#define NO_POS UINT32_MAX
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} Buf_t;
+
+static bool buf_reserve(Buf_t *b, size_t n) {
+    if (b->failed) {
+        return false;
+    }
+    if (b->len + n <= b->cap) {
+        return true;
+    }
+    size_t cap = b->cap * 2 > b->len + n ? b->cap * 2 : b->len + n;
+    uint8_t *data = realloc(b->data, cap);
+    if (!data) {
+        b->failed = true;
+        return false;
+    }
+    b->data = data;
+    b->cap = cap;
+    return true;
+}
+
+static void put_bytes(Buf_t *b, const uint8_t *p, size_t n) {
+    if (buf_reserve(b, n)) {
+        memcpy(b->data + b->len, p, n);
+        b->len += n;
+    }
+}
+
+static void put_varint(Buf_t *b, uint64_t v) {
+    uint8_t tmp[10];
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        tmp[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    tmp[n++] = (uint8_t)v;
+    put_bytes(b, tmp, n);
+}
+
+static void put_op(Buf_t *b, uint8_t op, size_t x) {
+    uint8_t byte = (uint8_t)(op | (x < OP_LEN_EXT ? x : OP_LEN_EXT));
+
+    put_bytes(b, &byte, 1);
+    if (x >= OP_LEN_EXT) {
+        put_varint(b, x - OP_LEN_EXT);
+    }
+}
+
+static void emit_insert(Buf_t *b, const uint8_t *p, size_t n) {
+    if (n > 0) {
+        put_op(b, 0, n - 1);
+        put_bytes(b, p, n);
+    }
+}
+
+static void emit_copy(Buf_t *b, size_t len, int64_t offset) {
+    put_op(b, OP_COPY, len - DELTA_MIN_MATCH);
+    put_varint(b, ((uint64_t)offset << 1) ^ (uint64_t)(offset >> 63));
+}
+
+static uint32_t window_hash(const uint8_t *p, uint32_t mask) {
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)Hash_U64(v) & mask;
+}
+
+static size_t match_len(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len) {
+    size_t n = a_len < b_len ? a_len : b_len, i = 0;
+
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+int Delta_Encode(const uint8_t *old, size_t old_len, const uint8_t *img, size_t img_len, uint8_t **out,
+                 size_t *out_len) {
+    Buf_t b = {0};
+    uint32_t *table = NULL, mask = 0;
+
+    if (old_len >= UINT32_MAX / 2 || img_len >= UINT32_MAX / 2) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (old_len >= DELTA_MIN_MATCH) {
+        mask = Hash_RoundUpPow2((uint32_t)old_len) - 1;
+        if (!(table = malloc(((size_t)mask + 1) * sizeof(*table)))) {
+            return -1;
+        }
+        memset(table, 0xff, ((size_t)mask + 1) * sizeof(*table));
+        for (size_t i = 0; i + DELTA_MIN_MATCH <= old_len; ++i) {
+            table[window_hash(old + i, mask)] = (uint32_t)i;
+        }
+    }
+    buf_reserve(&b, img_len / 8 + 64);
+
+    // lit: start of the pending literals; last_end/new_end: where the last copy ended in old and img
+    size_t pos = 0, lit = 0, last_end = 0, new_end = 0;
+    while (pos + DELTA_MIN_MATCH <= img_len) {
+        size_t best = 0, src = 0, step = last_end + (pos - new_end);
+        if (step < old_len) {
+            best = match_len(old + step, old_len - step, img + pos, img_len - pos);
+            src = step;
+        }
+        if (table) {
+            uint32_t cand = table[window_hash(img + pos, mask)];
+            size_t n = cand == NO_POS ? 0 : match_len(old + cand, old_len - cand, img + pos, img_len - pos);
+            if (n > best) {
+                best = n;
+                src = cand;
+            }
+        }
+        if (best < DELTA_MIN_MATCH) {
+            pos++;
+            continue;
+        }
+        while (pos > lit && src > 0 && old[src - 1] == img[pos - 1]) {
+            pos--;
+            src--;
+            best++;
+        }
+        emit_insert(&b, img + lit, pos - lit);
+        emit_copy(&b, best, (int64_t)src - (int64_t)last_end);
+        pos += best;
+        lit = new_end = pos;
+        last_end = src + best;
+    }
+    emit_insert(&b, img + lit, img_len - lit);
+    free(table);
+    if (b.failed) {
+        free(b.data);
+        return -1;
+    }
+    *out = b.data;
+    *out_len = b.len;
+    return 0;
+}
+
+static int get_varint(const uint8_t *p, size_t len, size_t *i, uint64_t *v) {
+    *v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (*i >= len) {
+            return -1;
+        }
+        uint8_t byte = p[(*i)++];
+        *v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+ptrdiff_t Delta_Apply(const uint8_t *old, size_t old_len, const uint8_t *delta, size_t delta_len, uint8_t *out,
+                      size_t out_cap) {
+    size_t i = 0, o = 0, last_end = 0;
+
+    while (i < delta_len) {
+        uint8_t op = delta[i++];
+        uint64_t x = op & OP_LEN_EXT, ext;
+        if (x == OP_LEN_EXT) {
+            if (get_varint(delta, delta_len, &i, &ext) != 0 || ext > SIZE_MAX / 2) {
+                goto bad;
+            }
+            x += ext;
+        }
+        if (op & OP_COPY) {
+            uint64_t z;
+            if (get_varint(delta, delta_len, &i, &z) != 0) {
+                goto bad;
+            }
+            int64_t src = (int64_t)last_end + ((int64_t)(z >> 1) ^ -(int64_t)(z & 1));
+            uint64_t len = x + DELTA_MIN_MATCH;
+            if (src < 0 || (uint64_t)src > old_len || len > old_len - (uint64_t)src || len > out_cap - o) {
+                goto bad;
+            }
+            memcpy(out + o, old + src, len);
+            o += len;
+            last_end = (size_t)src + len;
+        } else {
+            uint64_t len = x + 1;
+            if (len > delta_len - i || len > out_cap - o) {
+                goto bad;
+            }
+            memcpy(out + o, delta + i, len);
+            i += len;
+            o += len;
+        }
+    }
+    return (ptrdiff_t)o;
+
+bad:
+    errno = EINVAL;
+    return -1;
+}
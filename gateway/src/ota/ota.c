@@ -0,0 +1,697 @@
+#include "ota/ota.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/crc32.h"
+#include "common/hash.h"
+#include "ota/delta.h"
+#include "proto/control.h"
+
+#define OFFER_RETRY_MS 30000  // Active without a request this long: the offer's ACK may have been lost
+#define CHUNK_DEADLINE_MS 2000 // A chunk goes with the request's poll or not at all; the node asks again
+#define TOKEN 1000             // Bucket counts thousandths of a chunk
+
+typedef enum {
+    NODE_CURRENT = 0,
+    NODE_WAITING,
+    NODE_ACTIVE,
+} NodeState_t;
+
+typedef struct {
+    bool used;
+    uint8_t state;   // NodeState_t
+    uint16_t version;
+    uint32_t node;
+    int64_t last_ms; // Last offer or request while active
+} OtaNode_t;
+
+typedef struct {
+    uint16_t version;
+    uint32_t crc;
+    size_t len;
+    uint8_t *image;
+} Build_t;
+
+typedef struct {
+    uint16_t from;
+    uint16_t to;
+    bool full;     // Saves too little: the whole image goes instead
+    size_t len;
+    uint8_t *data; // NULL once dropped from memory; still on disk
+    uint64_t used; // LRU clock
+} Delta_t;
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t len;
+    uint16_t from; // 0 for the whole image
+} Transfer_t;
+
+struct OtaServer {
+    OtaConfig_t cfg;
+    char *dir;
+    Build_t *builds;
+    uint32_t n_builds;
+    Delta_t *deltas;
+    uint32_t n_deltas;
+    size_t delta_bytes;
+    uint64_t clock;
+    uint16_t target;
+    uint16_t pace_ms;
+    OtaNode_t *nodes;
+    uint32_t mask;
+    uint32_t *active; // Addresses of the active nodes
+    uint32_t n_active;
+    int64_t tokens;
+    int64_t refill_ms;
+    OtaStats_t stats;
+    Metric_t offers;
+    Metric_t sent;
+    Metric_t throttled;
+    Metric_t updated;
+    Metric_t hits;
+    Metric_t misses;
+    Metric_t g_active;
+    Metric_t g_waiting;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void Ota_DefaultConfig(OtaConfig_t *cfg) {
+    cfg->max_active = 10;
+    cfg->chunk_rate = 20;
+    cfg->stall_ms = 600000;
+    cfg->min_saving = 25;
+    cfg->slot_ms = 0;
+    cfg->cache_bytes = 16u << 20;
+    cfg->expected_nodes = 1024;
+    cfg->metrics = NULL;
+}
+
+/* --- Files --- */
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Whole file or nothing: written aside and renamed into place
+static int write_file(const OtaServer_t *ota, const char *name, const uint8_t *data, size_t len) {
+    char path[PATH_MAX], tmp[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", ota->dir, name);
+    snprintf(tmp, sizeof(tmp), "%s/%s.tmp", ota->dir, name);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (write_all(fd, data, len) != 0 || fsync(fd) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static int read_file(const OtaServer_t *ota, const char *name, uint8_t **data, size_t *len) {
+    char path[PATH_MAX];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s", ota->dir, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    *len = (size_t)st.st_size;
+    *data = malloc(*len ? *len : 1);
+    size_t got = 0;
+    while (*data && got < *len) {
+        ssize_t n = read(fd, *data + got, *len - got);
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    close(fd);
+    if (!*data || got != *len) {
+        free(*data);
+        return -1;
+    }
+    return 0;
+}
+
+/* --- Builds and deltas --- */
+
+static Build_t *build_find(const OtaServer_t *ota, uint16_t version) {
+    for (uint32_t i = 0; i < ota->n_builds; ++i) {
+        if (ota->builds[i].version == version) {
+            return &ota->builds[i];
+        }
+    }
+    return NULL;
+}
+
+// Takes ownership of image
+static int build_add(OtaServer_t *ota, uint16_t version, uint8_t *image, size_t len) {
+    Build_t *builds = realloc(ota->builds, (ota->n_builds + 1) * sizeof(*builds));
+
+    if (!builds) {
+        return -1;
+    }
+    ota->builds = builds;
+    builds[ota->n_builds++] = (Build_t){
+        .version = version,
+        .crc = Crc32_Update(0, image, len),
+        .len = len,
+        .image = image,
+    };
+    return 0;
+}
+
+static void delta_name(char *name, size_t size, uint16_t from, uint16_t to) {
+    snprintf(name, size, "delta-%u-%u.bin", from, to);
+}
+
+// The delta must rebuild the target exactly: a node would only find out after the whole transfer
+static bool delta_valid(const Build_t *src, const Build_t *dst, const uint8_t *delta, size_t len) {
+    uint8_t *out = malloc(dst->len ? dst->len : 1);
+    bool ok = out && Delta_Apply(src->image, src->len, delta, len, out, dst->len) == (ptrdiff_t)dst->len &&
+              memcmp(out, dst->image, dst->len) == 0;
+
+    free(out);
+    return ok;
+}
+
+// Least recently used deltas out of memory until under the budget, keeping keep
+static void delta_trim(OtaServer_t *ota, const Delta_t *keep) {
+    while (ota->delta_bytes > ota->cfg.cache_bytes) {
+        Delta_t *lru = NULL;
+        for (uint32_t i = 0; i < ota->n_deltas; ++i) {
+            Delta_t *d = &ota->deltas[i];
+            if (d != keep && d->data && (!lru || d->used < lru->used)) {
+                lru = d;
+            }
+        }
+        if (!lru) {
+            return;
+        }
+        free(lru->data);
+        lru->data = NULL;
+        ota->delta_bytes -= lru->len;
+    }
+}
+
+static int delta_load(OtaServer_t *ota, Delta_t *d, const Build_t *src, const Build_t *dst) {
+    char name[64];
+    uint8_t *data;
+    size_t len;
+
+    delta_name(name, sizeof(name), d->from, d->to);
+    if (read_file(ota, name, &data, &len) == 0) {
+        if (delta_valid(src, dst, data, len)) {
+            d->data = data;
+            d->len = len;
+            return 0;
+        }
+        free(data);
+    }
+    uint64_t t0 = now_ns();
+    if (Delta_Encode(src->image, src->len, dst->image, dst->len, &data, &len) != 0) {
+        return -1;
+    }
+    ota->stats.delta_ns += now_ns() - t0;
+    ota->stats.delta_made++;
+    if ((uint64_t)len * 100 > (uint64_t)dst->len * (100 - ota->cfg.min_saving) ||
+        !delta_valid(src, dst, data, len)) {
+        free(data);
+        d->full = true;
+        return 0;
+    }
+    // A delta that cannot be saved is still good for this run
+    write_file(ota, name, data, len);
+    d->data = data;
+    d->len = len;
+    return 0;
+}
+
+static Delta_t *delta_get(OtaServer_t *ota, const Build_t *src, const Build_t *dst) {
+    Delta_t *d = NULL;
+
+    for (uint32_t i = 0; i < ota->n_deltas && !d; ++i) {
+        if (ota->deltas[i].from == src->version && ota->deltas[i].to == dst->version) {
+            d = &ota->deltas[i];
+        }
+    }
+    if (!d) {
+        Delta_t *deltas = realloc(ota->deltas, (ota->n_deltas + 1) * sizeof(*deltas));
+        if (!deltas) {
+            return NULL;
+        }
+        ota->deltas = deltas;
+        d = &deltas[ota->n_deltas++];
+        *d = (Delta_t){.from = src->version, .to = dst->version};
+    }
+    d->used = ++ota->clock;
+    if (d->full || d->data) {
+        ota->stats.delta_hits++;
+        Metrics_Inc(ota->hits);
+        return d;
+    }
+    ota->stats.delta_misses++;
+    Metrics_Inc(ota->misses);
+    if (delta_load(ota, d, src, dst) != 0) {
+        return NULL;
+    }
+    if (d->data) {
+        ota->delta_bytes += d->len;
+        delta_trim(ota, d);
+    }
+    return d;
+}
+
+static int transfer(OtaServer_t *ota, uint16_t from, Transfer_t *t) {
+    const Build_t *dst = build_find(ota, ota->target), *src = from != ota->target ? build_find(ota, from) : NULL;
+
+    *t = (Transfer_t){.data = dst->image, .len = (uint32_t)dst->len, .from = 0};
+    if (!src) {
+        return 0;
+    }
+    const Delta_t *d = delta_get(ota, src, dst);
+    if (!d) {
+        return -1;
+    }
+    if (!d->full) {
+        *t = (Transfer_t){.data = d->data, .len = (uint32_t)d->len, .from = from};
+    }
+    return 0;
+}
+
+/* --- Nodes --- */
+
+static int table_alloc(OtaServer_t *ota, uint32_t cap) {
+    OtaNode_t *nodes = calloc(cap, sizeof(*nodes));
+
+    if (!nodes) {
+        return -1;
+    }
+    if (ota->nodes) {
+        for (uint32_t i = 0; i <= ota->mask; ++i) {
+            if (!ota->nodes[i].used) {
+                continue;
+            }
+            uint32_t h = (uint32_t)Hash_U64(ota->nodes[i].node) & (cap - 1);
+            while (nodes[h].used) {
+                h = (h + 1) & (cap - 1);
+            }
+            nodes[h] = ota->nodes[i];
+        }
+        free(ota->nodes);
+    }
+    ota->nodes = nodes;
+    ota->mask = cap - 1;
+    return 0;
+}
+
+static OtaNode_t *node_find(const OtaServer_t *ota, uint32_t node) {
+    uint32_t h = (uint32_t)Hash_U64(node) & ota->mask;
+
+    while (ota->nodes[h].used) {
+        if (ota->nodes[h].node == node) {
+            return &ota->nodes[h];
+        }
+        h = (h + 1) & ota->mask;
+    }
+    return NULL;
+}
+
+// New nodes start current, with an unknown version
+static OtaNode_t *node_get(OtaServer_t *ota, uint32_t node) {
+    OtaNode_t *on = node_find(ota, node);
+
+    if (on) {
+        return on;
+    }
+    if ((ota->stats.nodes + 1) * 10 > (ota->mask + 1) * 7 && table_alloc(ota, (ota->mask + 1) * 2) != 0) {
+        return NULL;
+    }
+    uint32_t h = (uint32_t)Hash_U64(node) & ota->mask;
+    while (ota->nodes[h].used) {
+        h = (h + 1) & ota->mask;
+    }
+    on = &ota->nodes[h];
+    *on = (OtaNode_t){.used = true, .state = NODE_CURRENT, .node = node};
+    ota->stats.nodes++;
+    ota->stats.current++;
+    return on;
+}
+
+static uint32_t *state_count(OtaServer_t *ota, uint8_t state) {
+    return state == NODE_ACTIVE ? &ota->stats.active : state == NODE_WAITING ? &ota->stats.waiting
+                                                                             : &ota->stats.current;
+}
+
+static void set_state(OtaServer_t *ota, OtaNode_t *on, uint8_t state) {
+    if (on->state == state) {
+        return;
+    }
+    if (on->state == NODE_ACTIVE) {
+        for (uint32_t i = 0; i < ota->n_active; ++i) {
+            if (ota->active[i] == on->node) {
+                ota->active[i] = ota->active[--ota->n_active];
+                break;
+            }
+        }
+    } else if (state == NODE_ACTIVE) {
+        ota->active[ota->n_active++] = on->node;
+    }
+    (*state_count(ota, on->state))--;
+    (*state_count(ota, state))++;
+    on->state = state;
+    Metrics_Set(ota->g_active, ota->stats.active);
+    Metrics_Set(ota->g_waiting, ota->stats.waiting);
+}
+
+static uint8_t wanted_state(const OtaServer_t *ota, const OtaNode_t *on) {
+    return !ota->target || on->version == ota->target ? NODE_CURRENT : NODE_WAITING;
+}
+
+static void update_version(OtaServer_t *ota, OtaNode_t *on, uint16_t version) {
+    on->version = version;
+    if (wanted_state(ota, on) == NODE_CURRENT) {
+        if (on->state != NODE_CURRENT) {
+            ota->stats.updated++;
+            Metrics_Inc(ota->updated);
+        }
+        set_state(ota, on, NODE_CURRENT);
+    } else if (on->state == NODE_CURRENT) {
+        set_state(ota, on, NODE_WAITING);
+    }
+}
+
+// A place among the active nodes, freeing those that went quiet if all are taken
+static bool admit(OtaServer_t *ota, OtaNode_t *on, int64_t rx_ms) {
+    if (on->state == NODE_ACTIVE) {
+        return true;
+    }
+    for (uint32_t i = 0; i < ota->n_active && ota->n_active >= ota->cfg.max_active;) {
+        OtaNode_t *a = node_find(ota, ota->active[i]);
+        if (rx_ms - a->last_ms > (int64_t)ota->cfg.stall_ms) {
+            ota->stats.stalled++;
+            set_state(ota, a, NODE_WAITING); // Moves the last entry into i
+            continue;
+        }
+        i++;
+    }
+    if (ota->n_active >= ota->cfg.max_active) {
+        ota->stats.deferred++;
+        return false;
+    }
+    set_state(ota, on, NODE_ACTIVE);
+    return true;
+}
+
+static bool take_token(OtaServer_t *ota, int64_t now_ms) {
+    int64_t cap = (int64_t)ota->cfg.chunk_rate * TOKEN;
+
+    if (now_ms > ota->refill_ms) {
+        ota->tokens += (now_ms - ota->refill_ms) * (int64_t)ota->cfg.chunk_rate;
+        ota->tokens = ota->tokens < cap ? ota->tokens : cap;
+        ota->refill_ms = now_ms;
+    }
+    if (ota->tokens < TOKEN) {
+        return false;
+    }
+    ota->tokens -= TOKEN;
+    return true;
+}
+
+static int offer(OtaServer_t *ota, OtaNode_t *on, int64_t rx_ms, DownlinkMsg_t *msg) {
+    const Build_t *dst = build_find(ota, ota->target);
+    Transfer_t t;
+
+    if (transfer(ota, on->version, &t) != 0) {
+        return -1;
+    }
+    ControlOtaOffer_t o = {
+        .flags = t.from ? CONTROL_OTA_DELTA : 0,
+        .from = t.from,
+        .to = ota->target,
+        .transfer_len = t.len,
+        .image_len = (uint32_t)dst->len,
+        .image_crc = dst->crc,
+        .pace_ms = ota->pace_ms,
+        .slot_ms = (uint8_t)ota->cfg.slot_ms,
+    };
+    memset(msg, 0, sizeof(*msg));
+    msg->node = on->node;
+    msg->prio = DOWNLINK_PRIO_CONTROL;
+    msg->kind = CONTROL_TYPE_OTA_OFFER;
+    msg->len = (uint8_t)Control_EncodeOtaOffer(msg->payload, &o);
+    msg->deadline_ms = rx_ms + OFFER_RETRY_MS;
+    msg->enqueued_ms = rx_ms;
+    on->last_ms = rx_ms;
+    ota->stats.offers++;
+    Metrics_Inc(ota->offers);
+    return 1;
+}
+
+static int chunk(OtaServer_t *ota, OtaNode_t *on, uint32_t offset, int64_t rx_ms, DownlinkMsg_t *msg) {
+    Transfer_t t;
+
+    if (transfer(ota, on->version, &t) != 0) {
+        return -1;
+    }
+    if (offset >= t.len) {
+        return 0; // Has it all, and is checking and installing it
+    }
+    if (!take_token(ota, rx_ms)) {
+        ota->stats.throttled++;
+        Metrics_Inc(ota->throttled);
+        return 0;
+    }
+    uint32_t left = t.len - offset;
+    ControlOtaChunk_t c = {
+        .to = ota->target,
+        .offset = offset,
+        .len = (uint8_t)(left < CONTROL_OTA_CHUNK_DATA ? left : CONTROL_OTA_CHUNK_DATA),
+        .data = t.data + offset,
+    };
+    memset(msg, 0, sizeof(*msg));
+    msg->node = on->node;
+    msg->prio = DOWNLINK_PRIO_BULK;
+    msg->kind = CONTROL_TYPE_OTA_CHUNK;
+    msg->len = (uint8_t)Control_EncodeOtaChunk(msg->payload, &c);
+    msg->deadline_ms = rx_ms + CHUNK_DEADLINE_MS;
+    msg->enqueued_ms = rx_ms;
+    ota->stats.chunks++;
+    ota->stats.chunk_bytes += c.len;
+    Metrics_Inc(ota->sent);
+    return 1;
+}
+
+/* --- API --- */
+
+static int load_builds(OtaServer_t *ota) {
+    DIR *d = opendir(ota->dir);
+
+    if (!d) {
+        return -1;
+    }
+    struct dirent *de;
+    int rc = 0;
+    while (rc == 0 && (de = readdir(d)) != NULL) {
+        unsigned version;
+        char tail[8];
+        uint8_t *image;
+        size_t len;
+        if (sscanf(de->d_name, "fw-%5u.%7s", &version, tail) != 2 || strcmp(tail, "bin") != 0 || version == 0 ||
+            version > UINT16_MAX || build_find(ota, (uint16_t)version)) {
+            continue;
+        }
+        if (read_file(ota, de->d_name, &image, &len) != 0 || build_add(ota, (uint16_t)version, image, len) != 0) {
+            rc = -1;
+        }
+    }
+    closedir(d);
+    return rc;
+}
+
+OtaServer_t *Ota_Open(const char *dir, const OtaConfig_t *cfg) {
+    if (cfg->max_active == 0 || cfg->chunk_rate == 0 || cfg->min_saving > 100 || cfg->slot_ms > UINT8_MAX) {
+        errno = EINVAL;
+        return NULL;
+    }
+    OtaServer_t *ota = calloc(1, sizeof(*ota));
+    if (!ota) {
+        return NULL;
+    }
+    ota->cfg = *cfg;
+    ota->dir = strdup(dir);
+    ota->active = malloc(cfg->max_active * sizeof(*ota->active));
+    if (!ota->dir || !ota->active ||
+        table_alloc(ota, Hash_RoundUpPow2(cfg->expected_nodes + cfg->expected_nodes / 2)) != 0 ||
+        (mkdir(dir, 0755) != 0 && errno != EEXIST) || load_builds(ota) != 0) {
+        Ota_Close(ota);
+        return NULL;
+    }
+    // Spacing that has the active nodes ask for chunk_rate between them, in whole slots
+    uint64_t pace = (uint64_t)cfg->max_active * 1000 / cfg->chunk_rate;
+    pace = cfg->slot_ms ? (pace + cfg->slot_ms - 1) / cfg->slot_ms * cfg->slot_ms : pace;
+    ota->pace_ms = (uint16_t)(pace < UINT16_MAX ? pace : UINT16_MAX);
+    ota->tokens = (int64_t)cfg->chunk_rate * TOKEN;
+
+    ota->offers = ota->sent = ota->throttled = ota->updated = (Metric_t){.slot = -1};
+    ota->hits = ota->misses = ota->g_active = ota->g_waiting = (Metric_t){.slot = -1};
+    if (cfg->metrics) {
+        const char *chunks = "OTA chunk requests";
+        const char *cache = "OTA delta lookups";
+        ota->offers = Metrics_Counter(cfg->metrics, "gateway_ota_offers_total", "OTA updates offered to nodes");
+        ota->sent = Metrics_Counter(cfg->metrics, "gateway_ota_chunks_total{result=\"sent\"}", chunks);
+        ota->throttled = Metrics_Counter(cfg->metrics, "gateway_ota_chunks_total{result=\"throttled\"}", chunks);
+        ota->updated = Metrics_Counter(cfg->metrics, "gateway_ota_updates_total", "Nodes updated to the target");
+        ota->hits = Metrics_Counter(cfg->metrics, "gateway_ota_delta_cache_total{result=\"hit\"}", cache);
+        ota->misses = Metrics_Counter(cfg->metrics, "gateway_ota_delta_cache_total{result=\"miss\"}", cache);
+        ota->g_active = Metrics_Gauge(cfg->metrics, "gateway_ota_active_nodes", "Nodes fetching an update");
+        ota->g_waiting = Metrics_Gauge(cfg->metrics, "gateway_ota_waiting_nodes", "Nodes waiting for an update");
+    }
+    return ota;
+}
+
+void Ota_Close(OtaServer_t *ota) {
+    if (!ota) {
+        return;
+    }
+    for (uint32_t i = 0; i < ota->n_builds; ++i) {
+        free(ota->builds[i].image);
+    }
+    for (uint32_t i = 0; i < ota->n_deltas; ++i) {
+        free(ota->deltas[i].data);
+    }
+    free(ota->builds);
+    free(ota->deltas);
+    free(ota->nodes);
+    free(ota->active);
+    free(ota->dir);
+    free(ota);
+}
+
+int Ota_AddBuild(OtaServer_t *ota, uint16_t version, const void *image, size_t len) {
+    const Build_t *b = build_find(ota, version);
+    char name[32];
+
+    if (version == 0 || len == 0 || len > UINT32_MAX / 2) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (b) {
+        if (b->len == len && memcmp(b->image, image, len) == 0) {
+            return 0;
+        }
+        errno = EEXIST;
+        return -1;
+    }
+    uint8_t *copy = malloc(len);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, image, len);
+    snprintf(name, sizeof(name), "fw-%u.bin", version);
+    if (write_file(ota, name, copy, len) != 0 || build_add(ota, version, copy, len) != 0) {
+        free(copy);
+        return -1;
+    }
+    return 0;
+}
+
+const uint8_t *Ota_Build(const OtaServer_t *ota, uint16_t version, size_t *len) {
+    const Build_t *b = build_find(ota, version);
+
+    if (!b) {
+        return NULL;
+    }
+    *len = b->len;
+    return b->image;
+}
+
+int Ota_SetTarget(OtaServer_t *ota, uint16_t version) {
+    if (version && !build_find(ota, version)) {
+        errno = ENOENT;
+        return -1;
+    }
+    ota->target = version;
+    for (uint32_t i = 0; i <= ota->mask; ++i) {
+        if (ota->nodes[i].used) {
+            set_state(ota, &ota->nodes[i], wanted_state(ota, &ota->nodes[i]));
+        }
+    }
+    return 0;
+}
+
+int Ota_Observe(OtaServer_t *ota, uint32_t node, int64_t rx_ms, DownlinkMsg_t *msg) {
+    OtaNode_t *on = node_find(ota, node);
+    int64_t retry = 4 * (int64_t)ota->pace_ms > OFFER_RETRY_MS ? 4 * (int64_t)ota->pace_ms : OFFER_RETRY_MS;
+
+    if (!on || on->state == NODE_CURRENT) {
+        return 0;
+    }
+    if (on->state == NODE_ACTIVE ? rx_ms - on->last_ms < retry : !admit(ota, on, rx_ms)) {
+        return 0;
+    }
+    return offer(ota, on, rx_ms, msg);
+}
+
+int Ota_Request(OtaServer_t *ota, uint32_t node, const FrameOta_t *req, int64_t rx_ms, DownlinkMsg_t *msg) {
+    OtaNode_t *on = node_get(ota, node);
+
+    if (!on) {
+        return -1;
+    }
+    update_version(ota, on, req->version);
+    if (on->state == NODE_CURRENT || !admit(ota, on, rx_ms)) {
+        return 0;
+    }
+    if (req->fetching != ota->target || req->offset == FRAME_OTA_STATUS) {
+        return offer(ota, on, rx_ms, msg);
+    }
+    on->last_ms = rx_ms;
+    return chunk(ota, on, req->offset, rx_ms, msg);
+}
+
+void Ota_GetStats(const OtaServer_t *ota, OtaStats_t *stats) {
+    *stats = ota->stats;
+}
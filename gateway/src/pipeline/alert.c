@@ -0,0 +1,805 @@
+#include "pipeline/alert.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "common/hash.h"
+
+#define EMPTY_FIELD 0xFF
+#define MAX_CODE (2 * ALERT_MAX_TESTS - 1)
+
+typedef enum {
+    OP_TEST = 0,
+    OP_AND,
+    OP_OR,
+} OpCode_t;
+
+typedef enum {
+    SRC_VALUE = 0,
+    SRC_RISE,
+    SRC_DROP,
+    SRC_CHANGE,
+    SRC_AVG,
+    SRC_MIN,
+    SRC_MAX,
+    SRC_COUNT,
+} Source_t;
+
+typedef enum {
+    CMP_LT = 0,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE,
+    CMP_EQ,
+    CMP_NE,
+} Cmp_t;
+
+// One instruction: a fused "source cmp constant" test, or and/or of the two tests below it
+typedef struct {
+    uint8_t op;     // OpCode_t
+    uint8_t src;    // Source_t
+    uint8_t window; // Index into the rule's windows
+    uint8_t cmp;    // Cmp_t
+    float k;
+} Op_t;
+
+_Static_assert(sizeof(Op_t) == 8, "instruction grew");
+
+typedef struct {
+    uint32_t node;
+    bool any_node;
+    uint8_t field;
+    uint8_t n_code;
+    uint8_t n_windows;
+    uint32_t for_ms;
+    uint32_t bucket_ms[ALERT_MAX_WINDOWS];
+    Op_t code[MAX_CODE];
+    char *text;
+} Rule_t;
+
+typedef struct {
+    float first; // Earliest arrival in the bucket
+    float min;
+    float max;
+    float sum;
+    uint32_t count;
+} Bucket_t;
+
+typedef struct {
+    int64_t head; // ts / bucket_ms of the newest bucket
+    Bucket_t buckets[ALERT_WINDOW_BUCKETS];
+} Window_t;
+
+typedef struct {
+    uint32_t rule;
+    bool holding;
+    bool raised;
+    int64_t since;      // When the rule started holding
+    Window_t *windows;  // The rule's n_windows, NULL if it has none
+} Instance_t;
+
+typedef struct {
+    uint32_t node;
+    uint8_t field; // EMPTY_FIELD in a free slot
+    bool seen;
+    uint32_t n_inst;
+    uint32_t cap;
+    int64_t last_ts;
+    Instance_t *inst;
+} Series_t;
+
+struct AlertEngine {
+    AlertConfig_t cfg;
+    Rule_t *rules;
+    uint32_t n_rules;
+    uint32_t rules_cap;
+    uint32_t *any[FIELD_COUNT]; // Rules on every node, by field
+    uint32_t n_any[FIELD_COUNT];
+    Series_t *table;
+    uint32_t mask;
+    uint32_t used;
+    AlertStats_t stats;
+    Metric_t raised;
+    Metric_t cleared;
+    Metric_t rules_gauge;
+    Metric_t instances;
+};
+
+static const struct {
+    uint8_t field;
+    const char *name;
+    float scale;
+} units[] = {
+    {FIELD_TEMPERATURE, "degC", 1.0f}, {FIELD_TEMPERATURE, "C", 1.0f}, {FIELD_HUMIDITY, "%RH", 1.0f},
+    {FIELD_HUMIDITY, "%", 1.0f},       {FIELD_PRESSURE, "hPa", 1.0f},  {FIELD_PRESSURE, "mbar", 1.0f},
+    {FIELD_BATTERY, "V", 1.0f},        {FIELD_BATTERY, "mV", 0.001f},
+};
+
+static const struct {
+    const char *name;
+    uint32_t ms;
+} durations[] = {
+    {"ms", 1}, {"s", 1000}, {"sec", 1000}, {"m", 60000}, {"min", 60000}, {"h", 3600000}, {"d", 86400000},
+};
+
+static const char *const source_names[SRC_COUNT] = {
+    [SRC_VALUE] = "value", [SRC_RISE] = "rise", [SRC_DROP] = "drop", [SRC_CHANGE] = "change",
+    [SRC_AVG] = "avg",     [SRC_MIN] = "min",   [SRC_MAX] = "max",
+};
+
+void Alert_DefaultConfig(AlertConfig_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->expected_series = 4096;
+}
+
+// --- Compiler ---
+
+typedef enum {
+    TOK_END = 0,
+    TOK_WORD,
+    TOK_NUMBER,
+    TOK_CMP,
+    TOK_SLASH,
+    TOK_COLON,
+    TOK_BAD,
+} TokenKind_t;
+
+typedef struct {
+    TokenKind_t kind;
+    const char *start;
+    size_t len;
+    double num;
+    uint8_t cmp; // Cmp_t
+} Token_t;
+
+typedef struct {
+    const char *text;
+    const char *p;
+    Token_t tok;
+    Rule_t *rule;
+    bool have_field;
+    char *err;
+    size_t err_len;
+} Parser_t;
+
+static int fail(Parser_t *ps, const char *fmt, ...) {
+    char msg[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    if (ps->err && ps->err_len) {
+        snprintf(ps->err, ps->err_len, "column %d: %s", (int)(ps->tok.start - ps->text) + 1, msg);
+    }
+    return -1;
+}
+
+static void advance(Parser_t *ps) {
+    Token_t *t = &ps->tok;
+    const char *p = ps->p;
+
+    while (isspace((unsigned char)*p)) {
+        p++;
+    }
+    t->start = p;
+    if (*p == '\0') {
+        t->kind = TOK_END;
+    } else if (isdigit((unsigned char)*p) ||
+               ((*p == '-' || *p == '+' || *p == '.') && (isdigit((unsigned char)p[1]) || p[1] == '.'))) {
+        char *end;
+        t->num = strtod(p, &end);
+        t->kind = TOK_NUMBER;
+        p = end;
+    } else if (isalpha((unsigned char)*p) || *p == '%') {
+        while (isalpha((unsigned char)*p) || *p == '%' || *p == '_') {
+            p++;
+        }
+        t->kind = TOK_WORD;
+    } else if (*p == '<' || *p == '>' || *p == '=' || *p == '!') {
+        bool eq = p[1] == '=';
+        t->kind = TOK_CMP;
+        switch (*p) {
+        case '<':
+            t->cmp = eq ? CMP_LE : CMP_LT;
+            break;
+        case '>':
+            t->cmp = eq ? CMP_GE : CMP_GT;
+            break;
+        case '=':
+            t->cmp = CMP_EQ;
+            break;
+        default:
+            t->cmp = CMP_NE;
+            t->kind = eq ? TOK_CMP : TOK_BAD;
+            break;
+        }
+        p += 1 + eq;
+    } else {
+        t->kind = *p == '/' ? TOK_SLASH : *p == ':' ? TOK_COLON : TOK_BAD;
+        p++;
+    }
+    t->len = (size_t)(p - t->start);
+    ps->p = p;
+}
+
+static bool word_is(const Token_t *t, const char *word) {
+    return t->kind == TOK_WORD && t->len == strlen(word) && strncasecmp(t->start, word, t->len) == 0;
+}
+
+static bool keyword(const Token_t *t) {
+    return word_is(t, "and") || word_is(t, "or") || word_is(t, "for");
+}
+
+static int parse_duration(Parser_t *ps, uint32_t *ms) {
+    if (ps->tok.kind != TOK_NUMBER || ps->tok.num <= 0) {
+        return fail(ps, "expected a duration");
+    }
+    double n = ps->tok.num;
+    advance(ps);
+    for (size_t i = 0; i < sizeof(durations) / sizeof(durations[0]); ++i) {
+        if (word_is(&ps->tok, durations[i].name)) {
+            double v = n * durations[i].ms;
+            if (v < 1 || v > UINT32_MAX) {
+                return fail(ps, "duration out of range");
+            }
+            *ms = (uint32_t)v;
+            advance(ps);
+            return 0;
+        }
+    }
+    return fail(ps, "expected ms, s, m, min, h or d");
+}
+
+static int parse_test(Parser_t *ps) {
+    Rule_t *rule = ps->rule;
+    char name[16];
+    uint32_t window_ms = 0;
+    Op_t op = {.op = OP_TEST, .src = SRC_VALUE};
+
+    if (ps->tok.kind != TOK_WORD || ps->tok.len >= sizeof(name)) {
+        return fail(ps, "expected a field");
+    }
+    for (size_t i = 0; i < ps->tok.len; ++i) {
+        name[i] = (char)tolower((unsigned char)ps->tok.start[i]);
+    }
+    name[ps->tok.len] = '\0';
+    int field = Sample_FieldFromName(name);
+    if (field < 0) {
+        return fail(ps, "unknown field '%s'", name);
+    }
+    if (ps->have_field && field != rule->field) {
+        return fail(ps, "a rule watches one field, %s", Sample_FieldName(rule->field));
+    }
+    rule->field = (uint8_t)field;
+    ps->have_field = true;
+    advance(ps);
+
+    for (int s = SRC_RISE; s < SRC_COUNT; ++s) {
+        if (word_is(&ps->tok, source_names[s])) {
+            op.src = (uint8_t)s;
+            advance(ps);
+            if (ps->tok.kind == TOK_NUMBER && parse_duration(ps, &window_ms) != 0) {
+                return -1;
+            }
+            break;
+        }
+    }
+    if (ps->tok.kind != TOK_CMP) {
+        return fail(ps, "expected a comparison");
+    }
+    op.cmp = ps->tok.cmp;
+    advance(ps);
+    if (ps->tok.kind != TOK_NUMBER) {
+        return fail(ps, "expected a number");
+    }
+    double k = ps->tok.num;
+    advance(ps);
+    if (ps->tok.kind == TOK_WORD && !keyword(&ps->tok)) {
+        size_t i = 0;
+        while (i < sizeof(units) / sizeof(units[0]) &&
+               !(units[i].field == field && ps->tok.len == strlen(units[i].name) &&
+                 strncmp(ps->tok.start, units[i].name, ps->tok.len) == 0)) {
+            ++i;
+        }
+        if (i == sizeof(units) / sizeof(units[0])) {
+            return fail(ps, "not a unit of %s", name);
+        }
+        k *= units[i].scale;
+        advance(ps);
+    }
+    op.k = (float)k;
+    if (ps->tok.kind == TOK_SLASH) {
+        advance(ps);
+        if (op.src == SRC_VALUE || window_ms) {
+            return fail(ps, op.src == SRC_VALUE ? "only a window takes a /duration" : "the window has a duration");
+        }
+        if (parse_duration(ps, &window_ms) != 0) {
+            return -1;
+        }
+    }
+    if (op.src != SRC_VALUE) {
+        if (!window_ms) {
+            return fail(ps, "%s needs a duration", source_names[op.src]);
+        }
+        // Windows of one length are shared by the rule's tests
+        uint32_t bucket_ms = window_ms / ALERT_WINDOW_BUCKETS ? window_ms / ALERT_WINDOW_BUCKETS : 1;
+        uint8_t w = 0;
+        while (w < rule->n_windows && rule->bucket_ms[w] != bucket_ms) {
+            ++w;
+        }
+        if (w == rule->n_windows) {
+            if (w == ALERT_MAX_WINDOWS) {
+                return fail(ps, "more than %d windows", ALERT_MAX_WINDOWS);
+            }
+            rule->bucket_ms[rule->n_windows++] = bucket_ms;
+        }
+        op.window = w;
+    }
+    if (rule->n_code == MAX_CODE) {
+        return fail(ps, "more than %d tests", ALERT_MAX_TESTS);
+    }
+    rule->code[rule->n_code++] = op;
+    return 0;
+}
+
+// Postfix: a b and c or for "a and b or c"
+static int parse_conj(Parser_t *ps) {
+    if (parse_test(ps) != 0) {
+        return -1;
+    }
+    while (word_is(&ps->tok, "and")) {
+        advance(ps);
+        if (parse_test(ps) != 0) {
+            return -1;
+        }
+        ps->rule->code[ps->rule->n_code++] = (Op_t){.op = OP_AND};
+    }
+    return 0;
+}
+
+static int parse_rule(Parser_t *ps) {
+    Rule_t *rule = ps->rule;
+
+    advance(ps);
+    rule->any_node = true;
+    if (word_is(&ps->tok, "node")) {
+        advance(ps);
+        if (ps->tok.kind != TOK_NUMBER || ps->tok.num < 0 || ps->tok.num > UINT32_MAX ||
+            ps->tok.num != (double)(uint32_t)ps->tok.num) {
+            return fail(ps, "expected a node address");
+        }
+        rule->node = (uint32_t)ps->tok.num;
+        rule->any_node = false;
+        advance(ps);
+        if (ps->tok.kind == TOK_COLON) {
+            advance(ps);
+        }
+    }
+    if (parse_conj(ps) != 0) {
+        return -1;
+    }
+    while (word_is(&ps->tok, "or")) {
+        advance(ps);
+        if (parse_conj(ps) != 0) {
+            return -1;
+        }
+        ps->rule->code[ps->rule->n_code++] = (Op_t){.op = OP_OR};
+    }
+    if (word_is(&ps->tok, "for")) {
+        advance(ps);
+        if (parse_duration(ps, &rule->for_ms) != 0) {
+            return -1;
+        }
+    }
+    if (ps->tok.kind != TOK_END) {
+        return fail(ps, "unexpected '%.*s'", (int)ps->tok.len, ps->tok.start);
+    }
+    return 0;
+}
+
+// --- Series index ---
+
+static int table_alloc(AlertEngine_t *eng, uint32_t cap) {
+    Series_t *table = malloc(cap * sizeof(*table));
+
+    if (!table) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < cap; ++i) {
+        table[i].field = EMPTY_FIELD;
+    }
+    if (eng->table) {
+        for (uint32_t i = 0; i <= eng->mask; ++i) {
+            const Series_t *s = &eng->table[i];
+            if (s->field == EMPTY_FIELD) {
+                continue;
+            }
+            uint32_t h = (uint32_t)Hash_U64((uint64_t)s->node << 8 | s->field) & (cap - 1);
+            while (table[h].field != EMPTY_FIELD) {
+                h = (h + 1) & (cap - 1);
+            }
+            table[h] = *s;
+        }
+        free(eng->table);
+    }
+    eng->table = table;
+    eng->mask = cap - 1;
+    return 0;
+}
+
+static int add_instance(AlertEngine_t *eng, Series_t *s, uint32_t rule) {
+    const Rule_t *r = &eng->rules[rule];
+
+    if (s->n_inst == s->cap) {
+        uint32_t cap = s->cap ? s->cap * 2 : 4;
+        Instance_t *inst = realloc(s->inst, cap * sizeof(*inst));
+        if (!inst) {
+            return -1;
+        }
+        s->inst = inst;
+        s->cap = cap;
+    }
+    Instance_t *in = &s->inst[s->n_inst];
+    *in = (Instance_t){.rule = rule};
+    if (r->n_windows && !(in->windows = calloc(r->n_windows, sizeof(Window_t)))) {
+        return -1;
+    }
+    s->n_inst++;
+    eng->stats.instances++;
+    Metrics_Set(eng->instances, eng->stats.instances);
+    return 0;
+}
+
+// A new series starts with the rules that watch its field on every node
+static Series_t *lookup(AlertEngine_t *eng, uint32_t node, uint8_t field) {
+    uint32_t h = (uint32_t)Hash_U64((uint64_t)node << 8 | field) & eng->mask;
+
+    for (;;) {
+        Series_t *s = &eng->table[h];
+        if (s->node == node && s->field == field) {
+            return s;
+        }
+        if (s->field == EMPTY_FIELD) {
+            break;
+        }
+        h = (h + 1) & eng->mask;
+    }
+    if ((eng->used + 1) * 10 > (eng->mask + 1) * 7) {
+        if (table_alloc(eng, (eng->mask + 1) * 2) != 0) {
+            return NULL;
+        }
+        return lookup(eng, node, field);
+    }
+    Series_t *s = &eng->table[h];
+    *s = (Series_t){.node = node, .field = field};
+    eng->used++;
+    eng->stats.series = eng->used;
+    for (uint32_t i = 0; i < eng->n_any[field]; ++i) {
+        if (add_instance(eng, s, eng->any[field][i]) != 0) {
+            return NULL;
+        }
+    }
+    return s;
+}
+
+AlertEngine_t *Alert_Create(const AlertConfig_t *cfg) {
+    AlertEngine_t *eng = calloc(1, sizeof(*eng));
+
+    if (!eng) {
+        return NULL;
+    }
+    eng->cfg = *cfg;
+    eng->raised = eng->cleared = eng->rules_gauge = eng->instances = (Metric_t){.slot = -1};
+    if (table_alloc(eng, Hash_RoundUpPow2(cfg->expected_series + cfg->expected_series / 2)) != 0) {
+        free(eng);
+        return NULL;
+    }
+    if (cfg->metrics) {
+        const char *help = "Alert rule transitions";
+        eng->raised = Metrics_Counter(cfg->metrics, "gateway_alerts_total{state=\"raised\"}", help);
+        eng->cleared = Metrics_Counter(cfg->metrics, "gateway_alerts_total{state=\"cleared\"}", help);
+        eng->rules_gauge = Metrics_Gauge(cfg->metrics, "gateway_alert_rules", "Alert rules compiled");
+        eng->instances = Metrics_Gauge(cfg->metrics, "gateway_alert_instances", "Alert rule states, per rule and node");
+    }
+    return eng;
+}
+
+void Alert_Destroy(AlertEngine_t *eng) {
+    if (!eng) {
+        return;
+    }
+    for (uint32_t i = 0; i <= eng->mask; ++i) {
+        Series_t *s = &eng->table[i];
+        if (s->field == EMPTY_FIELD) {
+            continue;
+        }
+        for (uint32_t k = 0; k < s->n_inst; ++k) {
+            free(s->inst[k].windows);
+        }
+        free(s->inst);
+    }
+    for (uint32_t r = 0; r < eng->n_rules; ++r) {
+        free(eng->rules[r].text);
+    }
+    for (int f = 0; f < FIELD_COUNT; ++f) {
+        free(eng->any[f]);
+    }
+    free(eng->rules);
+    free(eng->table);
+    free(eng);
+}
+
+int Alert_AddRule(AlertEngine_t *eng, const char *text, char *err, size_t err_len) {
+    Rule_t rule = {0};
+    Parser_t ps = {.text = text, .p = text, .rule = &rule, .err = err, .err_len = err_len};
+
+    if (parse_rule(&ps) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (eng->n_rules == eng->rules_cap) {
+        uint32_t cap = eng->rules_cap ? eng->rules_cap * 2 : 64;
+        Rule_t *rules = realloc(eng->rules, cap * sizeof(*rules));
+        if (!rules) {
+            return -1;
+        }
+        eng->rules = rules;
+        eng->rules_cap = cap;
+    }
+    if (!(rule.text = strdup(text))) {
+        return -1;
+    }
+    uint32_t id = eng->n_rules;
+    eng->rules[eng->n_rules++] = rule;
+
+    // Instances for the series already seen; later ones pick the rule up in lookup
+    if (rule.any_node) {
+        uint32_t *any = realloc(eng->any[rule.field], (eng->n_any[rule.field] + 1) * sizeof(*any));
+        if (!any) {
+            return -1;
+        }
+        any[eng->n_any[rule.field]++] = id;
+        eng->any[rule.field] = any;
+        for (uint32_t i = 0; i <= eng->mask; ++i) {
+            if (eng->table[i].field == rule.field && add_instance(eng, &eng->table[i], id) != 0) {
+                return -1;
+            }
+        }
+    } else {
+        Series_t *s = lookup(eng, rule.node, rule.field);
+        if (!s || add_instance(eng, s, id) != 0) {
+            return -1;
+        }
+    }
+    eng->stats.rules = eng->n_rules;
+    Metrics_Set(eng->rules_gauge, eng->n_rules);
+    return (int)id;
+}
+
+int Alert_LoadRules(AlertEngine_t *eng, const char *path, char *err, size_t err_len) {
+    FILE *f = fopen(path, "r");
+    char line[512], why[160];
+    int loaded = 0, lineno = 0;
+
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        const char *p = line;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            continue;
+        }
+        if (Alert_AddRule(eng, p, why, sizeof(why)) < 0) {
+            int saved = errno;
+            if (err && err_len) {
+                snprintf(err, err_len, "line %d: %s", lineno, saved == EINVAL ? why : strerror(saved));
+            }
+            fclose(f);
+            errno = saved;
+            return -1;
+        }
+        loaded++;
+    }
+    fclose(f);
+    return loaded;
+}
+
+const char *Alert_RuleText(const AlertEngine_t *eng, uint32_t rule) {
+    return rule < eng->n_rules ? eng->rules[rule].text : NULL;
+}
+
+// --- Evaluation ---
+
+// Buckets are numbered from the epoch, so a time before it has none
+static void window_add(Window_t *w, uint32_t bucket_ms, int64_t ts, float x) {
+    int64_t idx = ts / bucket_ms;
+
+    if (idx < 0) {
+        return;
+    }
+    if (idx > w->head) {
+        int64_t steps = idx - w->head < ALERT_WINDOW_BUCKETS ? idx - w->head : ALERT_WINDOW_BUCKETS;
+        for (int64_t s = 1; s <= steps; ++s) {
+            w->buckets[(w->head + s) % ALERT_WINDOW_BUCKETS].count = 0;
+        }
+        w->head = idx;
+    } else if (idx <= w->head - ALERT_WINDOW_BUCKETS) {
+        return; // Older than the window
+    }
+    Bucket_t *b = &w->buckets[idx % ALERT_WINDOW_BUCKETS];
+    if (b->count == 0) {
+        *b = (Bucket_t){x, x, x, x, 1};
+        return;
+    }
+    b->min = x < b->min ? x : b->min;
+    b->max = x > b->max ? x : b->max;
+    b->sum += x;
+    b->count++;
+}
+
+static float window_value(const Window_t *w, uint8_t src, float x) {
+    float first = x, min = x, max = x, sum = 0;
+    uint32_t count = 0;
+
+    // Near the epoch the window is shorter, never a negative index
+    int64_t oldest = w->head >= ALERT_WINDOW_BUCKETS - 1 ? w->head - ALERT_WINDOW_BUCKETS + 1 : 0;
+    for (int64_t i = oldest; i <= w->head; ++i) {
+        const Bucket_t *b = &w->buckets[i % ALERT_WINDOW_BUCKETS];
+        if (b->count == 0) {
+            continue;
+        }
+        if (count == 0) {
+            first = b->first;
+        }
+        min = b->min < min ? b->min : min;
+        max = b->max > max ? b->max : max;
+        sum += b->sum;
+        count += b->count;
+    }
+    switch (src) {
+    case SRC_RISE:
+        return x - first;
+    case SRC_DROP:
+        return first - x;
+    case SRC_CHANGE:
+        return x > first ? x - first : first - x;
+    case SRC_AVG:
+        return count ? sum / (float)count : x;
+    case SRC_MIN:
+        return min;
+    default:
+        return max;
+    }
+}
+
+// Tests push a bit each, and/or fold the top two
+static bool evaluate(const Rule_t *rule, const Instance_t *in, float x) {
+    uint32_t stack = 0;
+
+    for (uint8_t i = 0; i < rule->n_code; ++i) {
+        const Op_t *op = &rule->code[i];
+        uint32_t top = stack & 1;
+        bool t;
+        switch (op->op) {
+        case OP_TEST: {
+            float v = op->src == SRC_VALUE ? x : window_value(&in->windows[op->window], op->src, x);
+            switch (op->cmp) {
+            case CMP_LT:
+                t = v < op->k;
+                break;
+            case CMP_LE:
+                t = v <= op->k;
+                break;
+            case CMP_GT:
+                t = v > op->k;
+                break;
+            case CMP_GE:
+                t = v >= op->k;
+                break;
+            case CMP_EQ:
+                t = v == op->k;
+                break;
+            default:
+                t = v != op->k;
+                break;
+            }
+            stack = stack << 1 | t;
+            break;
+        }
+        case OP_AND:
+            stack >>= 1;
+            stack = (stack & ~1u) | (stack & top);
+            break;
+        default:
+            stack >>= 1;
+            stack |= top;
+            break;
+        }
+    }
+    return stack & 1;
+}
+
+static size_t check(AlertEngine_t *eng, const Sample_t *sample) {
+    if (sample->field >= FIELD_COUNT) {
+        return 0;
+    }
+    Series_t *s = lookup(eng, sample->node, sample->field);
+    if (!s) {
+        return 0;
+    }
+    bool late = s->seen && sample->ts <= s->last_ts;
+    size_t changed = 0;
+
+    for (uint32_t i = 0; i < s->n_inst; ++i) {
+        Instance_t *in = &s->inst[i];
+        const Rule_t *rule = &eng->rules[in->rule];
+        for (uint8_t w = 0; w < rule->n_windows; ++w) {
+            window_add(&in->windows[w], rule->bucket_ms[w], sample->ts, sample->value);
+        }
+        if (late) {
+            continue;
+        }
+        eng->stats.evaluations++;
+        bool holds = evaluate(rule, in, sample->value);
+        if (holds && !in->holding) {
+            in->holding = true;
+            in->since = sample->ts;
+        }
+        in->holding = holds;
+        // Raised once it has held for for_ms, cleared on the first sample it does not
+        bool raise = holds && !in->raised && sample->ts - in->since >= rule->for_ms;
+        bool clear = !holds && in->raised;
+        if (!raise && !clear) {
+            continue;
+        }
+        in->raised = raise;
+        changed++;
+        if (raise) {
+            eng->stats.raised++;
+            Metrics_Inc(eng->raised);
+        } else {
+            eng->stats.cleared++;
+            Metrics_Inc(eng->cleared);
+        }
+        if (eng->cfg.sink) {
+            Alert_t a = {sample->ts, in->rule, sample->node, sample->field, raise, sample->value, rule->text};
+            eng->cfg.sink(eng->cfg.sink_ctx, &a);
+        }
+    }
+    if (late) {
+        eng->stats.late++;
+    } else {
+        s->seen = true;
+        s->last_ts = sample->ts;
+    }
+    return changed;
+}
+
+size_t Alert_Feed(AlertEngine_t *eng, const Sample_t *samples, size_t n) {
+    size_t changed = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        changed += check(eng, &samples[i]);
+    }
+    eng->stats.samples += n;
+    return changed;
+}
+
+void Alert_Tap(void *ctx, const Sample_t *samples, size_t n) {
+    Alert_Feed(ctx, samples, n);
+}
+
+void Alert_GetStats(const AlertEngine_t *eng, AlertStats_t *stats) {
+    *stats = eng->stats;
+}
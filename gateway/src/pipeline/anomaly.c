@@ -0,0 +1,248 @@
+#include "pipeline/anomaly.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hash.h"
+
+#define EMPTY_FIELD 0xFF
+
+typedef struct {
+    uint32_t node;
+    uint8_t field;  // EMPTY_FIELD in a free slot
+    uint8_t active; // Bit per AnomalyKind_t that has already alerted
+    uint16_t count; // Samples seen, saturating
+    float mean;
+    float var;
+    float last;
+    int64_t last_ts;
+    int64_t changed_ts; // When the value last differed from the one before
+} Series_t;
+
+_Static_assert(sizeof(Series_t) == 40, "series state grew");
+
+struct AnomalyDetector {
+    AnomalyConfig_t cfg;
+    float min_var[FIELD_COUNT];
+    Series_t *table;
+    uint32_t mask;
+    uint32_t used;
+    AnomalyStats_t stats;
+    Metric_t alerts[ANOMALY_KIND_COUNT];
+    Metric_t series;
+};
+
+static const char *const kind_names[ANOMALY_KIND_COUNT] = {
+    [ANOMALY_OUTLIER] = "outlier",
+    [ANOMALY_RATE] = "rate",
+    [ANOMALY_STUCK] = "stuck",
+};
+
+const char *Anomaly_KindName(AnomalyKind_t kind) {
+    return (unsigned)kind < ANOMALY_KIND_COUNT ? kind_names[kind] : "unknown";
+}
+
+void Anomaly_DefaultConfig(AnomalyConfig_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->alpha = 0.05f;
+    cfg->z = 6.0f;
+    cfg->warmup = 20;
+    cfg->max_gap_ms = 10 * 60 * 1000;
+    // Sensor noise, the fastest change weather produces, and how long a live reading can hold still
+    cfg->limits[FIELD_TEMPERATURE] = (AnomalyLimits_t){0.2f, 0.1f, 2 * 3600 * 1000};
+    cfg->limits[FIELD_HUMIDITY] = (AnomalyLimits_t){1.0f, 0.5f, 2 * 3600 * 1000};
+    cfg->limits[FIELD_PRESSURE] = (AnomalyLimits_t){0.3f, 0.05f, 6 * 3600 * 1000};
+    cfg->limits[FIELD_BATTERY] = (AnomalyLimits_t){0.02f, 0.01f, 0}; // Held flat by the regulator
+    cfg->expected_series = 4096;
+}
+
+static int table_alloc(AnomalyDetector_t *det, uint32_t cap) {
+    Series_t *table = malloc(cap * sizeof(*table));
+
+    if (!table) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < cap; ++i) {
+        table[i].field = EMPTY_FIELD;
+    }
+    if (det->table) {
+        for (uint32_t i = 0; i <= det->mask; ++i) {
+            const Series_t *s = &det->table[i];
+            if (s->field == EMPTY_FIELD) {
+                continue;
+            }
+            uint32_t h = (uint32_t)Hash_U64((uint64_t)s->node << 8 | s->field) & (cap - 1);
+            while (table[h].field != EMPTY_FIELD) {
+                h = (h + 1) & (cap - 1);
+            }
+            table[h] = *s;
+        }
+        free(det->table);
+    }
+    det->table = table;
+    det->mask = cap - 1;
+    return 0;
+}
+
+AnomalyDetector_t *Anomaly_Create(const AnomalyConfig_t *cfg) {
+    AnomalyDetector_t *det = calloc(1, sizeof(*det));
+
+    if (!det) {
+        return NULL;
+    }
+    det->cfg = *cfg;
+    for (int f = 0; f < FIELD_COUNT; ++f) {
+        det->min_var[f] = cfg->limits[f].min_std * cfg->limits[f].min_std;
+    }
+    for (int k = 0; k < ANOMALY_KIND_COUNT; ++k) {
+        det->alerts[k] = (Metric_t){.slot = -1};
+    }
+    det->series = (Metric_t){.slot = -1};
+    if (table_alloc(det, Hash_RoundUpPow2(cfg->expected_series + cfg->expected_series / 2)) != 0) {
+        free(det);
+        return NULL;
+    }
+    if (cfg->metrics) {
+        for (int k = 0; k < ANOMALY_KIND_COUNT; ++k) {
+            char name[64];
+            snprintf(name, sizeof(name), "gateway_anomalies_total{kind=\"%s\"}", kind_names[k]);
+            det->alerts[k] = Metrics_Counter(cfg->metrics, name, "Anomalies raised");
+        }
+        det->series = Metrics_Gauge(cfg->metrics, "gateway_anomaly_series", "Series tracked by the detector");
+    }
+    return det;
+}
+
+void Anomaly_Destroy(AnomalyDetector_t *det) {
+    if (!det) {
+        return;
+    }
+    free(det->table);
+    free(det);
+}
+
+static Series_t *lookup(AnomalyDetector_t *det, uint32_t node, uint8_t field) {
+    uint32_t h = (uint32_t)Hash_U64((uint64_t)node << 8 | field) & det->mask;
+
+    for (;;) {
+        Series_t *s = &det->table[h];
+        if (s->node == node && s->field == field) {
+            return s;
+        }
+        if (s->field == EMPTY_FIELD) {
+            break;
+        }
+        h = (h + 1) & det->mask;
+    }
+    if ((det->used + 1) * 10 > (det->mask + 1) * 7) {
+        if (table_alloc(det, (det->mask + 1) * 2) != 0) {
+            return NULL;
+        }
+        return lookup(det, node, field);
+    }
+    Series_t *s = &det->table[h];
+    memset(s, 0, sizeof(*s));
+    s->node = node;
+    s->field = field;
+    det->used++;
+    det->stats.series = det->used;
+    Metrics_Set(det->series, det->used);
+    return s;
+}
+
+// Edge-triggered: true only when the check starts failing
+static bool alert(AnomalyDetector_t *det, Series_t *s, const Sample_t *sample, AnomalyKind_t kind, bool failing,
+                  float expected, float score) {
+    uint8_t bit = (uint8_t)(1u << kind);
+
+    if (!failing) {
+        s->active &= (uint8_t)~bit;
+        return false;
+    }
+    if (s->active & bit) {
+        return false;
+    }
+    s->active |= bit;
+    det->stats.alerts[kind]++;
+    Metrics_Inc(det->alerts[kind]);
+    if (det->cfg.sink) {
+        Anomaly_t a = {sample->ts, sample->node, sample->field, (uint8_t)kind, sample->value, expected, score};
+        det->cfg.sink(det->cfg.sink_ctx, &a);
+    }
+    return true;
+}
+
+static size_t check(AnomalyDetector_t *det, const Sample_t *sample) {
+    if (sample->field >= FIELD_COUNT) {
+        return 0;
+    }
+    Series_t *s = lookup(det, sample->node, sample->field);
+    if (!s) {
+        return 0;
+    }
+    const AnomalyLimits_t *lim = &det->cfg.limits[sample->field];
+    float x = sample->value;
+    size_t raised = 0;
+
+    if (s->count == 0) {
+        s->mean = x;
+        s->last = x;
+        s->last_ts = s->changed_ts = sample->ts;
+        s->count = 1;
+        return 0;
+    }
+
+    // Compared before the update so a spike does not pull its own threshold up
+    float d = x - s->mean;
+    float var = s->var > det->min_var[sample->field] ? s->var : det->min_var[sample->field];
+    if (s->count >= det->cfg.warmup) {
+        bool outlier = d * d > det->cfg.z * det->cfg.z * var;
+        raised += alert(det, s, sample, ANOMALY_OUTLIER, outlier, s->mean, outlier ? d / __builtin_sqrtf(var) : 0);
+    }
+    s->mean += det->cfg.alpha * d;
+    s->var = (1.0f - det->cfg.alpha) * (s->var + det->cfg.alpha * d * d);
+    s->count += s->count < UINT16_MAX;
+
+    if (sample->ts <= s->last_ts) {
+        det->stats.late++; // A backlog sample: no order to take a rate or a run from
+        return raised;
+    }
+    int64_t dt = sample->ts - s->last_ts;
+    if (lim->max_rate > 0 && dt <= det->cfg.max_gap_ms) {
+        // Noise allowance on top of the limit: over short gaps the noise alone exceeds any sane rate
+        float dx = x - s->last;
+        float allowed = lim->max_rate * (float)dt / 1000.0f + 3.0f * lim->min_std;
+        bool fast = dx > allowed || dx < -allowed;
+        raised += alert(det, s, sample, ANOMALY_RATE, fast, s->last, dx * 1000.0f / (float)dt);
+    }
+    if (x != s->last) {
+        s->changed_ts = sample->ts;
+    }
+    if (lim->stuck_ms) {
+        int64_t held = sample->ts - s->changed_ts;
+        raised += alert(det, s, sample, ANOMALY_STUCK, held >= lim->stuck_ms, s->last, (float)held / 1000.0f);
+    }
+    s->last = x;
+    s->last_ts = sample->ts;
+    return raised;
+}
+
+size_t Anomaly_Feed(AnomalyDetector_t *det, const Sample_t *samples, size_t n) {
+    size_t raised = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        raised += check(det, &samples[i]);
+    }
+    det->stats.samples += n;
+    return raised;
+}
+
+void Anomaly_Tap(void *ctx, const Sample_t *samples, size_t n) {
+    Anomaly_Feed(ctx, samples, n);
+}
+
+void Anomaly_GetStats(const AnomalyDetector_t *det, AnomalyStats_t *stats) {
+    *stats = det->stats;
+}
@@ -0,0 +1,45 @@
+#include "pipeline/dedup.h"
+
+static void shift_window(DedupWindow_t *w, uint32_t n) {
+    if (n >= 128) {
+        w->bits[0] = w->bits[1] = 0;
+    } else if (n >= 64) {
+        w->bits[1] = w->bits[0] << (n - 64);
+        w->bits[0] = 0;
+    } else if (n > 0) {
+        w->bits[1] = (w->bits[1] << n) | (w->bits[0] >> (64 - n));
+        w->bits[0] <<= n;
+    }
+}
+
+DedupResult_t DedupWindow_Check(DedupWindow_t *window, uint16_t seq, uint32_t *skipped) {
+    *skipped = 0;
+    if (window->bits[0] == 0 && window->bits[1] == 0) {
+        window->top = seq;
+        window->bits[0] = 1;
+        return DEDUP_NEW;
+    }
+
+    int16_t ahead = (int16_t)(uint16_t)(seq - window->top); // Wraps at 2^16
+    if (ahead > 0) {
+        shift_window(window, (uint32_t)ahead);
+        window->bits[0] |= 1;
+        window->top = seq;
+        *skipped = (uint32_t)ahead - 1;
+        return DEDUP_NEW;
+    }
+    uint32_t back = (uint32_t)-ahead;
+    if (back >= DEDUP_WINDOW) {
+        window->top = seq;
+        window->bits[0] = 1;
+        window->bits[1] = 0;
+        return DEDUP_RESET;
+    }
+    uint64_t *word = &window->bits[back / 64];
+    uint64_t bit = 1ull << (back % 64);
+    if (*word & bit) {
+        return DEDUP_DUPLICATE;
+    }
+    *word |= bit;
+    return DEDUP_LATE;
+}
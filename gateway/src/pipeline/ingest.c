@@ -0,0 +1,711 @@
+#include "pipeline/ingest.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "common/arena.h"
+#include "pipeline/dedup.h"
+#include "pipeline/keycache.h"
+#include "proto/seal.h"
+#include "registry/registry.h"
+
+typedef struct ScratchArena {
+    struct ScratchArena *next;
+    Arena_t arena;
+} ScratchArena_t;
+
+struct Ingest {
+    pthread_mutex_t lock; // Keeps WAL order and apply order the same
+    Wal_t *wal;
+    SeriesStore_t *store;
+    RollupEngine_t *rollup;
+    NodeRegistry_t *registry;
+    KeyCache_t *keys;         // Expanded copies of the registry's keys
+    pthread_mutex_t arena_lock;
+    ScratchArena_t *arenas;   // Idle batch scratch arenas
+    size_t arena_bytes;
+    ReorderBuffer_t *reorder; // NULL when the stage is off
+    char *registry_path;
+    bool opened;              // Replayed and checkpointed; until then a close must not move the checkpoint
+    IngestStats_t stats;
+    struct {
+        IngestTap_t fn;
+        void *ctx;
+    } taps[INGEST_MAX_TAPS];
+    uint32_t n_taps;
+    Metrics_t *metrics;
+    Metric_t lock_wait; // Time spent waiting for the ingest lock
+    Metric_t unseal_ns; // Verification and decryption, shared out over the batch
+    Metric_t admit_ns;  // Header and duplicate check
+    Metric_t wal_ns;    // Append to the WAL (not the sync)
+    Metric_t apply_ns;  // Decode into the store and rollup
+};
+
+void Ingest_DefaultConfig(IngestConfig_t *cfg) {
+    Wal_DefaultConfig(&cfg->wal);
+    SeriesStore_DefaultConfig(&cfg->store);
+    Rollup_DefaultConfig(&cfg->rollup);
+    Reorder_DefaultConfig(&cfg->reorder);
+    cfg->reorder.lateness_ms = 0; // Off: held samples are not visible to queries until released
+    cfg->expected_nodes = 1024;
+    cfg->arena_bytes = 32 * 1024;
+    cfg->metrics = NULL;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t stamp(const Ingest_t *ingest) {
+    return ingest->metrics ? now_ns() : 0;
+}
+
+static void write_u64(FILE *out, const char *name, const char *help, MetricType_t type, uint64_t value) {
+    Metrics_WriteValue(out, name, help, type, (double)value);
+}
+
+// Counters that ingest, WAL and store keep anyway, read at scrape time
+static void collect(void *ctx, FILE *out) {
+    Ingest_t *ingest = ctx;
+    IngestStats_t st;
+    WalStats_t wal;
+    IoWriterStats_t store_io, wal_io;
+    ReorderStats_t reorder = {0};
+    uint32_t nodes;
+
+    pthread_mutex_lock(&ingest->lock);
+    st = ingest->stats;
+    if (ingest->reorder) {
+        Reorder_GetStats(ingest->reorder, &reorder);
+    }
+    nodes = Registry_Count(ingest->registry);
+    SeriesStore_GetIoStats(ingest->store, &store_io);
+    pthread_mutex_unlock(&ingest->lock);
+    Wal_GetStats(ingest->wal, &wal);
+    Wal_GetIoStats(ingest->wal, &wal_io);
+
+    write_u64(out, "gateway_ingest_frames_total", "Frames applied", METRIC_COUNTER, st.frames);
+    write_u64(out, "gateway_ingest_samples_total", "Samples written", METRIC_COUNTER, st.samples);
+    write_u64(out, "gateway_ingest_malformed_total", "Frames that failed to decode", METRIC_COUNTER, st.malformed);
+    write_u64(out, "gateway_ingest_duplicates_total", "Frames dropped as duplicates", METRIC_COUNTER, st.duplicates);
+    write_u64(out, "gateway_ingest_late_total", "Frames accepted out of order", METRIC_COUNTER, st.late);
+    write_u64(out, "gateway_ingest_seq_resets_total", "Node sequence restarts", METRIC_COUNTER, st.seq_resets);
+    write_u64(out, "gateway_ingest_auth_failures_total", "Frames failing authentication", METRIC_COUNTER,
+              st.auth_failures);
+    write_u64(out, "gateway_ingest_out_of_window_total", "Samples older than the reorder window", METRIC_COUNTER,
+              st.out_of_window);
+    write_u64(out, "gateway_ingest_reorder_held", "Samples held by the reorder stage", METRIC_GAUGE, reorder.held);
+    write_u64(out, "gateway_ingest_replayed_total", "WAL records applied at recovery", METRIC_COUNTER, st.replayed);
+    write_u64(out, "gateway_nodes", "Nodes in the registry", METRIC_GAUGE, nodes);
+    write_u64(out, "gateway_wal_records_total", "WAL records appended", METRIC_COUNTER, wal.records);
+    write_u64(out, "gateway_wal_bytes_total", "WAL bytes appended", METRIC_COUNTER, wal.bytes);
+    write_u64(out, "gateway_wal_batches_total", "WAL group commit batches", METRIC_COUNTER, wal.batches);
+    write_u64(out, "gateway_wal_syncs_total", "WAL syncs", METRIC_COUNTER, wal.syncs);
+    Metrics_WriteValue(out, "gateway_wal_max_delay_seconds", "Worst append to durable delay", METRIC_GAUGE,
+                       (double)wal.max_delay_ns * 1e-9);
+    write_u64(out, "gateway_wal_syscalls_total", "WAL write and sync syscalls", METRIC_COUNTER, wal_io.syscalls);
+    write_u64(out, "gateway_store_write_bytes_total", "Series store bytes written", METRIC_COUNTER, store_io.bytes);
+    write_u64(out, "gateway_store_syscalls_total", "Series store write and sync syscalls", METRIC_COUNTER,
+              store_io.syscalls);
+}
+
+static void register_metrics(Ingest_t *ingest, Metrics_t *metrics) {
+    static const char help[] = "Ingest time per frame by stage";
+
+    ingest->metrics = metrics;
+    ingest->lock_wait = Metrics_Histogram(metrics, "gateway_ingest_lock_wait_seconds",
+                                          "Time a frame waited for the ingest lock", 1e-9);
+    ingest->unseal_ns = Metrics_Histogram(metrics, "gateway_ingest_stage_seconds{stage=\"unseal\"}", help, 1e-9);
+    ingest->admit_ns = Metrics_Histogram(metrics, "gateway_ingest_stage_seconds{stage=\"admit\"}", help, 1e-9);
+    ingest->wal_ns = Metrics_Histogram(metrics, "gateway_ingest_stage_seconds{stage=\"wal\"}", help, 1e-9);
+    ingest->apply_ns = Metrics_Histogram(metrics, "gateway_ingest_stage_seconds{stage=\"apply\"}", help, 1e-9);
+    Metrics_AddCollector(metrics, collect, ingest);
+}
+
+static bool key_set(const NodeCold_t *cold) {
+    uint8_t any = 0;
+    for (int i = 0; i < REGISTRY_KEY_LEN; ++i) {
+        any |= cold->key[i];
+    }
+    return any != 0;
+}
+
+// The duplicate window as it was before a frame, put back if the frame does not make it into the WAL
+typedef struct {
+    DedupWindow_t *window; // NULL when admit did not touch one
+    DedupWindow_t prev;
+} WindowUndo_t;
+
+/*
+ * False for a frame already seen. sealed says the frame came in encrypted
+ * and passed authentication; a clear one is from a node without a key.
+ * Malformed headers pass and are counted when decoded. undo stays valid
+ * until the next admit, which may move registry slots.
+ */
+static bool admit(Ingest_t *ingest, const Frame_t *frame, bool sealed, WindowUndo_t *undo) {
+    FrameHeader_t hdr;
+    uint32_t skipped;
+
+    undo->window = NULL;
+    if (Frame_ParseHeader(frame, &hdr) != 0) {
+        return true;
+    }
+    // Only provisioned nodes have keys, so unknown senders are not added
+    int32_t slot = sealed ? Registry_Find(ingest->registry, hdr.node) : Registry_Upsert(ingest->registry, hdr.node);
+    if (slot == REGISTRY_NO_SLOT) {
+        return true;
+    }
+    NodeHot_t *hot = Registry_Hot(ingest->registry, slot);
+    undo->window = &hot->window;
+    undo->prev = hot->window;
+    DedupResult_t result = DedupWindow_Check(&hot->window, hdr.seq, &skipped);
+    if (hot->frames++ == 0) {
+        Registry_Cold(ingest->registry, slot)->first_seen = (uint32_t)(frame->rx_ts / 1000);
+    }
+    hot->last_seen = (uint32_t)(frame->rx_ts / 1000);
+    if (result == DEDUP_NEW && skipped == 0 && !frame->rpd) {
+        return true; // The common case never touches the cold part
+    }
+
+    NodeLink_t *link = &Registry_Cold(ingest->registry, slot)->link;
+    link->rpd_strong += frame->rpd != 0;
+    link->last_pipe = frame->pipe;
+    switch (result) {
+    case DEDUP_NEW:
+        link->lost += skipped;
+        break;
+    case DEDUP_DUPLICATE:
+        link->duplicates++;
+        ingest->stats.duplicates++;
+        return false;
+    case DEDUP_LATE:
+        link->lost -= link->lost > 0; // A gap filled in after all
+        link->late++;
+        ingest->stats.late++;
+        break;
+    case DEDUP_RESET:
+        link->resets++;
+        ingest->stats.seq_resets++;
+        break;
+    }
+    return true;
+}
+
+// Samples on to the store and rollup, straight from apply or released by the reorder stage
+static int store_samples(void *ctx, const Sample_t *samples, size_t n, bool late) {
+    Ingest_t *ingest = ctx;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (SeriesStore_AppendSample(ingest->store, &samples[i]) != 0 ||
+            Rollup_AddSample(ingest->rollup, &samples[i]) != 0) {
+            return -1;
+        }
+    }
+    ingest->stats.samples += n;
+    if (late) {
+        ingest->stats.out_of_window += n;
+    }
+    for (uint32_t t = 0; t < ingest->n_taps; ++t) {
+        ingest->taps[t].fn(ingest->taps[t].ctx, samples, n);
+    }
+    return 0;
+}
+
+/*
+ * Decodes a logged frame. Samples go to the reorder stage now, or are added
+ * at out[*n_out] for the caller to store with the rest of its batch.
+ */
+static int apply(Ingest_t *ingest, const Frame_t *frame, Sample_t *out, size_t *n_out) {
+    int n = Frame_Decode(frame, out + *n_out, FRAME_MAX_READINGS);
+
+    ingest->stats.frames++;
+    if (n < 0) {
+        ingest->stats.malformed++;
+        return 0; // Still logged: the raw frame is kept for inspection
+    }
+    if (ingest->reorder) {
+        return Reorder_Push(ingest->reorder, out + *n_out, (size_t)n, frame->rx_ts);
+    }
+    *n_out += (size_t)n;
+    return 0;
+}
+
+static int replay_record(uint64_t lsn, const void *data, uint32_t len, void *ctx) {
+    Ingest_t *ingest = ctx;
+    Frame_t frame;
+    WindowUndo_t undo;
+
+    (void)lsn;
+    ingest->stats.replayed++;
+    if (Frame_Deserialize(data, len, &frame) != 0) {
+        ingest->stats.malformed++;
+        return 0;
+    }
+    // Logged frames passed the check once; this rebuilds the windows
+    Sample_t samples[FRAME_MAX_READINGS];
+    size_t n = 0;
+    if (!admit(ingest, &frame, false, &undo)) {
+        return 0;
+    }
+    if (apply(ingest, &frame, samples, &n) != 0) {
+        return -1;
+    }
+    return n > 0 ? store_samples(ingest, samples, n, false) : 0;
+}
+
+Ingest_t *Ingest_Open(const char *dir, const IngestConfig_t *cfg) {
+    IngestConfig_t defaults;
+    char path[PATH_MAX];
+    Ingest_t *ingest = calloc(1, sizeof(*ingest));
+
+    if (!ingest) {
+        return NULL;
+    }
+    if (!cfg) {
+        Ingest_DefaultConfig(&defaults);
+        cfg = &defaults;
+    }
+    pthread_mutex_init(&ingest->lock, NULL);
+    pthread_mutex_init(&ingest->arena_lock, NULL);
+    ingest->arena_bytes = cfg->arena_bytes;
+    ingest->lock_wait = ingest->unseal_ns = ingest->admit_ns = ingest->wal_ns = ingest->apply_ns =
+        (Metric_t){.slot = -1};
+    snprintf(path, sizeof(path), "%s/nodes.snap", dir);
+    ingest->registry_path = strdup(path);
+    // The snapshot matches the checkpoint; WAL replay brings it up to date
+    ingest->registry = Registry_Load(path);
+    if (!ingest->registry) {
+        ingest->registry = Registry_Create(cfg->expected_nodes);
+    }
+    ingest->keys = KeyCache_Create(cfg->expected_nodes);
+    snprintf(path, sizeof(path), "%s/wal", dir);
+    if (!ingest->registry || !ingest->keys || !ingest->registry_path ||
+        (mkdir(dir, 0755) != 0 && errno != EEXIST)) {
+        Ingest_Close(ingest);
+        return NULL;
+    }
+    for (int32_t slot = Registry_Next(ingest->registry, REGISTRY_NO_SLOT); slot != REGISTRY_NO_SLOT;
+         slot = Registry_Next(ingest->registry, slot)) {
+        const NodeCold_t *cold = Registry_Cold(ingest->registry, slot);
+        if (key_set(cold) && KeyCache_Put(ingest->keys, Registry_Node(ingest->registry, slot), cold->key) != 0) {
+            Ingest_Close(ingest);
+            return NULL;
+        }
+    }
+    ingest->wal = Wal_Open(path, &cfg->wal);
+    if (!ingest->wal) {
+        Ingest_Close(ingest);
+        return NULL;
+    }
+
+    // Segments past the checkpoint hold records the WAL tail will rebuild
+    size_t len;
+    const uint8_t *blob = Wal_CheckpointBlob(ingest->wal, &len);
+    if (blob && len >= sizeof(StoreMark_t) && SeriesStore_Rewind(dir, (const StoreMark_t *)blob) != 0) {
+        Ingest_Close(ingest);
+        return NULL;
+    }
+    ingest->store = SeriesStore_Open(dir, &cfg->store);
+    ingest->rollup = ingest->store ? Rollup_Create(ingest->store, &cfg->rollup) : NULL;
+    // The buckets in memory at the checkpoint, which the replayed tail continues
+    if (ingest->rollup && blob && len > sizeof(StoreMark_t) &&
+        Rollup_LoadState(ingest->rollup, blob + sizeof(StoreMark_t), len - sizeof(StoreMark_t)) != 0) {
+        Ingest_Close(ingest);
+        return NULL;
+    }
+    if (ingest->rollup && cfg->reorder.lateness_ms > 0) {
+        ReorderConfig_t reorder = cfg->reorder;
+        reorder.expected_nodes = cfg->expected_nodes;
+        if (!(ingest->reorder = Reorder_Create(&reorder, store_samples, ingest))) {
+            Ingest_Close(ingest);
+            return NULL;
+        }
+    }
+    if (!ingest->rollup || Wal_Replay(ingest->wal, replay_record, ingest) != 0 || Ingest_Checkpoint(ingest) != 0) {
+        Ingest_Close(ingest);
+        return NULL;
+    }
+    ingest->opened = true;
+    if (cfg->metrics) {
+        register_metrics(ingest, cfg->metrics);
+    }
+    return ingest;
+}
+
+void Ingest_Close(Ingest_t *ingest) {
+    if (!ingest) {
+        return;
+    }
+    if (ingest->metrics) {
+        Metrics_RemoveCollector(ingest->metrics, collect, ingest);
+    }
+    // A checkpoint of a half-replayed tail would skip the records not applied yet
+    if (ingest->opened) {
+        Ingest_Checkpoint(ingest);
+    }
+    Reorder_Destroy(ingest->reorder);
+    Rollup_Destroy(ingest->rollup);
+    SeriesStore_Close(ingest->store);
+    Wal_Close(ingest->wal);
+    Registry_Destroy(ingest->registry);
+    KeyCache_Destroy(ingest->keys);
+    free(ingest->registry_path);
+    while (ingest->arenas) {
+        ScratchArena_t *a = ingest->arenas;
+        ingest->arenas = a->next;
+        Arena_Free(&a->arena);
+        free(a);
+    }
+    pthread_mutex_destroy(&ingest->arena_lock);
+    pthread_mutex_destroy(&ingest->lock);
+    free(ingest);
+}
+
+#define UNSEAL_CLEAR -1  // Clear frame from a node without a key
+#define UNSEAL_REJECT -2 // Clear frame from a keyed node, or a stale sealed one: refused like a forgery
+
+/*
+ * Verifies and decrypts the sealed frames of a batch into plain. sealed[i]
+ * is the frame's crypto job, UNSEAL_CLEAR, or UNSEAL_REJECT for a frame
+ * refused before any crypto. Every node is looked up, since a keyed node
+ * may only send sealed.
+ */
+static int unseal_batch(Ingest_t *ingest, Arena_t *arena, const Frame_t *frames, size_t n, Frame_t *plain,
+                        int8_t *sealed, FrameUnsealJob_t *jobs) {
+    uint32_t *nodes = Arena_Alloc(arena, n * sizeof(*nodes));
+    int8_t *at = Arena_Alloc(arena, n * sizeof(*at));
+    FrameKey_t *keys = Arena_Alloc(arena, n * sizeof(*keys));
+    bool *found = Arena_Alloc(arena, n * sizeof(*found));
+    size_t n_nodes = 0, n_jobs = 0;
+
+    if (!nodes || !at || !keys || !found) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        FrameHeader_t hdr;
+        plain[i] = frames[i];
+        sealed[i] = UNSEAL_CLEAR;
+        at[i] = -1;
+        if (Frame_ParseHeader(&plain[i], &hdr) != 0) {
+            continue;
+        }
+        at[i] = (int8_t)n_nodes;
+        nodes[n_nodes++] = hdr.node;
+        if ((hdr.flags & FRAME_FLAG_ENCRYPTED) && !Frame_SealFresh(&plain[i])) {
+            sealed[i] = UNSEAL_REJECT;
+        } else if (hdr.flags & FRAME_FLAG_ENCRYPTED) {
+            jobs[n_jobs] = (FrameUnsealJob_t){.payload = plain[i].payload, .len = plain[i].len};
+            sealed[i] = (int8_t)n_jobs++;
+        }
+    }
+    if (n_nodes == 0) {
+        return 0;
+    }
+    KeyCache_Get(ingest->keys, nodes, n_nodes, keys, found);
+    for (size_t i = 0; i < n; ++i) {
+        if (at[i] < 0) {
+            continue;
+        }
+        if (sealed[i] >= 0) {
+            jobs[sealed[i]].key = found[at[i]] ? &keys[at[i]] : NULL;
+        } else if (found[at[i]]) {
+            sealed[i] = UNSEAL_REJECT;
+        }
+    }
+    if (n_jobs == 0) {
+        return 0;
+    }
+    Frame_UnsealBatch(jobs, n_jobs);
+    for (size_t i = 0; i < n; ++i) {
+        if (sealed[i] >= 0 && jobs[sealed[i]].result >= 0) {
+            plain[i].len = (uint8_t)jobs[sealed[i]].result;
+        }
+    }
+    return 0;
+}
+
+/*
+ * One batch, with its scratch state in arena: decrypted copies, crypto jobs
+ * and keys, and the decoded samples, which are stored together after the
+ * last frame is logged.
+ */
+static int ingest_batch(Ingest_t *ingest, Arena_t *arena, const Frame_t *frames, size_t n) {
+    uint8_t record[FRAME_RECORD_MAX];
+    Frame_t *plain = Arena_Alloc(arena, n * sizeof(*plain));
+    FrameUnsealJob_t *jobs = Arena_Alloc(arena, n * sizeof(*jobs));
+    int8_t *sealed = Arena_Alloc(arena, n * sizeof(*sealed));
+    Sample_t *samples = Arena_Alloc(arena, n * FRAME_MAX_READINGS * sizeof(*samples));
+    size_t n_samples = 0, admitted = 0;
+    uint64_t decode_ns = 0;
+    int rc = 0;
+
+    // Stage timing costs a clock read per stage, so only with metrics
+    uint64_t t0 = stamp(ingest);
+    if (!plain || !jobs || !sealed || !samples || unseal_batch(ingest, arena, frames, n, plain, sealed, jobs) != 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    uint64_t t1 = stamp(ingest);
+    pthread_mutex_lock(&ingest->lock);
+    uint64_t t2 = stamp(ingest);
+    for (size_t i = 0; i < n && rc == 0; ++i) {
+        Metrics_Observe(ingest->unseal_ns, (t1 - t0) / n);
+        // Forged frames, and clear ones from keyed nodes, never reach the duplicate window
+        if (sealed[i] == UNSEAL_REJECT || (sealed[i] >= 0 && jobs[sealed[i]].result < 0)) {
+            ingest->stats.auth_failures++;
+            continue;
+        }
+        WindowUndo_t undo;
+        uint64_t ta = stamp(ingest);
+        bool admit_it = admit(ingest, &plain[i], sealed[i] >= 0, &undo);
+        uint64_t tb = stamp(ingest);
+        if (admit_it) {
+            // Logged decrypted: replay needs no keys and does no crypto
+            size_t len = Frame_Serialize(&plain[i], record);
+            uint64_t lsn = Wal_Append(ingest->wal, record, (uint32_t)len);
+            uint64_t tc = stamp(ingest);
+            // Unlogged, the frame is lost unless the node's resend of it is taken as new
+            if (lsn == 0 && undo.window) {
+                *undo.window = undo.prev;
+            }
+            rc = lsn != 0 ? apply(ingest, &plain[i], samples, &n_samples) : -1;
+            Metrics_Observe(ingest->wal_ns, tc - tb);
+            decode_ns += stamp(ingest) - tc;
+            admitted++;
+        }
+        Metrics_Observe(ingest->admit_ns, tb - ta);
+    }
+    // Frames logged before a failure are stored all the same, as replay would
+    uint64_t t3 = stamp(ingest);
+    if (n_samples > 0 && store_samples(ingest, samples, n_samples, false) != 0) {
+        rc = -1;
+    }
+    uint64_t store_ns = stamp(ingest) - t3;
+    pthread_mutex_unlock(&ingest->lock);
+    Metrics_Observe(ingest->lock_wait, t2 - t1);
+    for (size_t i = 0; i < admitted; ++i) {
+        Metrics_Observe(ingest->apply_ns, (decode_ns + store_ns) / admitted);
+    }
+    return rc;
+}
+
+// Scratch arenas are pooled, one per thread inside Ingest_Frames at a time
+static Arena_t *arena_take(Ingest_t *ingest) {
+    pthread_mutex_lock(&ingest->arena_lock);
+    ScratchArena_t *a = ingest->arenas;
+    if (a) {
+        ingest->arenas = a->next;
+    }
+    pthread_mutex_unlock(&ingest->arena_lock);
+    if (!a && (a = calloc(1, sizeof(*a)))) {
+        Arena_Init(&a->arena, ingest->arena_bytes);
+    }
+    return a ? &a->arena : NULL;
+}
+
+static void arena_give(Ingest_t *ingest, Arena_t *arena) {
+    ScratchArena_t *a = (ScratchArena_t *)((char *)arena - offsetof(ScratchArena_t, arena));
+
+    pthread_mutex_lock(&ingest->arena_lock);
+    a->next = ingest->arenas;
+    ingest->arenas = a;
+    pthread_mutex_unlock(&ingest->arena_lock);
+}
+
+int Ingest_Frame(Ingest_t *ingest, const Frame_t *frame) {
+    return Ingest_Frames(ingest, frame, 1);
+}
+
+int Ingest_Frames(Ingest_t *ingest, const Frame_t *frames, size_t n) {
+    Arena_t *arena = arena_take(ingest);
+    int rc = 0;
+
+    if (!arena) {
+        return -1;
+    }
+    for (size_t i = 0; i < n && rc == 0; i += INGEST_BATCH) {
+        rc = ingest_batch(ingest, arena, frames + i, n - i < INGEST_BATCH ? n - i : INGEST_BATCH);
+        Arena_Reset(arena);
+    }
+    arena_give(ingest, arena);
+    return rc;
+}
+
+int Ingest_SetKey(Ingest_t *ingest, uint32_t node, const uint8_t key[16]) {
+    int rc = -1;
+
+    pthread_mutex_lock(&ingest->lock);
+    int32_t slot = Registry_Upsert(ingest->registry, node);
+    // Under the ingest lock, so the registry and the cache change together
+    if (slot != REGISTRY_NO_SLOT && KeyCache_Put(ingest->keys, node, key) == 0) {
+        memcpy(Registry_Cold(ingest->registry, slot)->key, key, REGISTRY_KEY_LEN);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&ingest->lock);
+    return rc;
+}
+
+int Ingest_LoadKeys(Ingest_t *ingest, const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[128];
+    int loaded = 0;
+
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long node;
+        char hex[33];
+        uint8_t key[REGISTRY_KEY_LEN];
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%lu %32s", &node, hex) != 2 || strlen(hex) != 2 * REGISTRY_KEY_LEN) {
+            fclose(f);
+            errno = EINVAL;
+            return -1;
+        }
+        for (int i = 0; i < REGISTRY_KEY_LEN; ++i) {
+            unsigned byte;
+            if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+                fclose(f);
+                errno = EINVAL;
+                return -1;
+            }
+            key[i] = (uint8_t)byte;
+        }
+        if (Ingest_SetKey(ingest, (uint32_t)node, key) != 0) {
+            fclose(f);
+            return -1;
+        }
+        loaded++;
+    }
+    fclose(f);
+    return loaded;
+}
+
+int Ingest_AddTap(Ingest_t *ingest, IngestTap_t fn, void *ctx) {
+    int rc = -1;
+
+    pthread_mutex_lock(&ingest->lock);
+    if (ingest->n_taps < INGEST_MAX_TAPS) {
+        ingest->taps[ingest->n_taps].fn = fn;
+        ingest->taps[ingest->n_taps].ctx = ctx;
+        ingest->n_taps++;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&ingest->lock);
+    return rc;
+}
+
+// The store mark followed by the rollup buckets still in memory
+static uint8_t *checkpoint_blob(Ingest_t *ingest, size_t *len) {
+    StoreMark_t mark;
+    void *state;
+    size_t state_len;
+
+    if (Rollup_SaveState(ingest->rollup, &state, &state_len) != 0) {
+        return NULL;
+    }
+    uint8_t *blob = malloc(sizeof(mark) + state_len);
+    if (blob) {
+        SeriesStore_GetMark(ingest->store, &mark);
+        memcpy(blob, &mark, sizeof(mark));
+        memcpy(blob + sizeof(mark), state, state_len);
+        *len = sizeof(mark) + state_len;
+    }
+    free(state);
+    return blob;
+}
+
+int Ingest_Checkpoint(Ingest_t *ingest) {
+    uint8_t *blob = NULL;
+    size_t len;
+    int rc = -1;
+
+    pthread_mutex_lock(&ingest->lock);
+    uint64_t lsn = Wal_LastLsn(ingest->wal);
+    // Held samples are covered by the checkpoint, so they must be stored by it
+    if ((!ingest->reorder || Reorder_Flush(ingest->reorder) == 0) && SeriesStore_Flush(ingest->store) == 0 &&
+        SeriesStore_Sync(ingest->store) == 0 && (blob = checkpoint_blob(ingest, &len)) != NULL) {
+        rc = Wal_Checkpoint(ingest->wal, lsn, blob, len);
+        // Saved after: a snapshot newer than the checkpoint would reject replayed frames as duplicates.
+        // The index too, as the store is rewound to the checkpoint before it is read.
+        if (rc == 0) {
+            rc = Registry_Save(ingest->registry, ingest->registry_path);
+        }
+        if (rc == 0) {
+            rc = SeriesStore_SaveIndex(ingest->store);
+        }
+    }
+    pthread_mutex_unlock(&ingest->lock);
+    free(blob);
+    return rc;
+}
+
+int Ingest_Tick(Ingest_t *ingest, int64_t now_ms) {
+    int rc = 0;
+
+    // Under the lock too: buckets persisted between taking the store mark and the rollup state would be lost
+    pthread_mutex_lock(&ingest->lock);
+    if (ingest->reorder) {
+        rc = Reorder_Tick(ingest->reorder, now_ms);
+    }
+    rc |= Rollup_Tick(ingest->rollup, now_ms);
+    pthread_mutex_unlock(&ingest->lock);
+    return rc;
+}
+
+SeriesStore_t *Ingest_Store(Ingest_t *ingest) {
+    return ingest->store;
+}
+
+RollupEngine_t *Ingest_Rollup(Ingest_t *ingest) {
+    return ingest->rollup;
+}
+
+Wal_t *Ingest_Wal(Ingest_t *ingest) {
+    return ingest->wal;
+}
+
+NodeRegistry_t *Ingest_Registry(Ingest_t *ingest) {
+    return ingest->registry;
+}
+
+int Ingest_GetReorderStats(Ingest_t *ingest, ReorderStats_t *stats) {
+    if (!ingest->reorder) {
+        return -1;
+    }
+    pthread_mutex_lock(&ingest->lock);
+    Reorder_GetStats(ingest->reorder, stats);
+    pthread_mutex_unlock(&ingest->lock);
+    return 0;
+}
+
+void Ingest_GetStats(Ingest_t *ingest, IngestStats_t *stats) {
+    pthread_mutex_lock(&ingest->lock);
+    *stats = ingest->stats;
+    pthread_mutex_unlock(&ingest->lock);
+    pthread_mutex_lock(&ingest->arena_lock);
+    for (const ScratchArena_t *a = ingest->arenas; a; a = a->next) {
+        stats->scratch_allocs += a->arena.stats.allocs;
+        stats->scratch_mallocs += a->arena.stats.mallocs;
+        stats->scratch_reserved += a->arena.stats.reserved;
+        if (a->arena.stats.high_water > stats->scratch_peak) {
+            stats->scratch_peak = a->arena.stats.high_water;
+        }
+    }
+    pthread_mutex_unlock(&ingest->arena_lock);
+}
@@ -0,0 +1,138 @@
+#include "pipeline/keycache.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "common/hash.h"
+
+typedef struct {
+    uint32_t node;
+    bool used;
+    bool set; // False once cleared; the slot stays so probe chains hold
+    FrameKey_t key;
+} KeyEntry_t;
+
+struct KeyCache {
+    pthread_mutex_t lock;
+    KeyEntry_t *entries;
+    uint32_t mask;
+    uint32_t used;
+    uint32_t set;
+};
+
+static int table_alloc(KeyCache_t *cache, uint32_t cap) {
+    KeyEntry_t *entries = calloc(cap, sizeof(*entries));
+
+    if (!entries) {
+        return -1;
+    }
+    if (cache->entries) {
+        for (uint32_t i = 0; i <= cache->mask; ++i) {
+            if (!cache->entries[i].used) {
+                continue;
+            }
+            uint32_t h = (uint32_t)Hash_U64(cache->entries[i].node) & (cap - 1);
+            while (entries[h].used) {
+                h = (h + 1) & (cap - 1);
+            }
+            entries[h] = cache->entries[i];
+        }
+        free(cache->entries);
+    }
+    cache->entries = entries;
+    cache->mask = cap - 1;
+    return 0;
+}
+
+KeyCache_t *KeyCache_Create(uint32_t expected_nodes) {
+    KeyCache_t *cache = calloc(1, sizeof(*cache));
+
+    if (!cache) {
+        return NULL;
+    }
+    if (table_alloc(cache, Hash_RoundUpPow2(expected_nodes + expected_nodes / 2)) != 0) {
+        free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void KeyCache_Destroy(KeyCache_t *cache) {
+    if (!cache) {
+        return;
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache);
+}
+
+static KeyEntry_t *find(const KeyCache_t *cache, uint32_t node) {
+    uint32_t h = (uint32_t)Hash_U64(node) & cache->mask;
+
+    while (cache->entries[h].used) {
+        if (cache->entries[h].node == node) {
+            return &cache->entries[h];
+        }
+        h = (h + 1) & cache->mask;
+    }
+    return NULL;
+}
+
+int KeyCache_Put(KeyCache_t *cache, uint32_t node, const uint8_t raw[AES_KEY_LEN]) {
+    FrameKey_t key;
+    uint8_t any = 0;
+    int rc = 0;
+
+    for (int i = 0; i < AES_KEY_LEN; ++i) {
+        any |= raw[i];
+    }
+    // Expanded outside the lock: lookups on other threads do not wait for the key schedule
+    if (any) {
+        FrameKey_Init(&key, raw);
+    }
+    pthread_mutex_lock(&cache->lock);
+    KeyEntry_t *e = find(cache, node);
+    if (!e && any) {
+        if ((cache->used + 1) * 10 > (cache->mask + 1) * 7 && table_alloc(cache, (cache->mask + 1) * 2) != 0) {
+            rc = -1;
+        } else {
+            uint32_t h = (uint32_t)Hash_U64(node) & cache->mask;
+            while (cache->entries[h].used) {
+                h = (h + 1) & cache->mask;
+            }
+            e = &cache->entries[h];
+            e->used = true;
+            e->node = node;
+            cache->used++;
+        }
+    }
+    if (e) {
+        cache->set += (uint32_t)(any && !e->set) - (uint32_t)(!any && e->set);
+        e->set = any != 0;
+        if (any) {
+            e->key = key;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return rc;
+}
+
+void KeyCache_Get(KeyCache_t *cache, const uint32_t *nodes, size_t n, FrameKey_t *keys, bool *found) {
+    pthread_mutex_lock(&cache->lock);
+    for (size_t i = 0; i < n; ++i) {
+        const KeyEntry_t *e = find(cache, nodes[i]);
+        found[i] = e && e->set;
+        if (found[i]) {
+            keys[i] = e->key;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+uint32_t KeyCache_Count(KeyCache_t *cache) {
+    pthread_mutex_lock(&cache->lock);
+    uint32_t n = cache->set;
+    pthread_mutex_unlock(&cache->lock);
+    return n;
+}
@@ -0,0 +1,274 @@
+#include "pipeline/reorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hash.h"
+
+#define SCRATCH_SAMPLES 256
+#define HEAP_MIN 8
+
+typedef struct {
+    bool used;
+    uint32_t node;
+    uint32_t count;
+    uint32_t cap;
+    int64_t newest_ts;   // Event time high-water mark
+    int64_t released_ts; // Newest sample released; older ones are late
+    int64_t last_arrival;
+    Sample_t *heap;      // Min-heap on ts
+} NodeBuf_t;
+
+struct ReorderBuffer {
+    ReorderConfig_t cfg;
+    ReorderEmit_t emit;
+    void *ctx;
+    NodeBuf_t *nodes;
+    uint32_t mask;
+    uint32_t used;
+    Sample_t scratch[SCRATCH_SAMPLES];
+    uint32_t n_scratch;
+    ReorderStats_t stats;
+};
+
+void Reorder_DefaultConfig(ReorderConfig_t *cfg) {
+    cfg->lateness_ms = 30000;
+    cfg->hold_ms = 120000;
+    cfg->per_node = 64;
+    cfg->expected_nodes = 1024;
+}
+
+static int table_alloc(ReorderBuffer_t *rb, uint32_t cap) {
+    NodeBuf_t *nodes = calloc(cap, sizeof(*nodes));
+
+    if (!nodes) {
+        return -1;
+    }
+    if (rb->nodes) {
+        for (uint32_t i = 0; i <= rb->mask; ++i) {
+            if (!rb->nodes[i].used) {
+                continue;
+            }
+            uint32_t h = (uint32_t)Hash_U64(rb->nodes[i].node) & (cap - 1);
+            while (nodes[h].used) {
+                h = (h + 1) & (cap - 1);
+            }
+            nodes[h] = rb->nodes[i];
+        }
+        rb->stats.bytes -= (rb->mask + 1) * sizeof(*nodes);
+        free(rb->nodes);
+    }
+    rb->nodes = nodes;
+    rb->mask = cap - 1;
+    rb->stats.bytes += cap * sizeof(*nodes);
+    return 0;
+}
+
+ReorderBuffer_t *Reorder_Create(const ReorderConfig_t *cfg, ReorderEmit_t emit, void *ctx) {
+    if (cfg->per_node == 0) {
+        return NULL;
+    }
+    ReorderBuffer_t *rb = calloc(1, sizeof(*rb));
+    if (!rb) {
+        return NULL;
+    }
+    rb->cfg = *cfg;
+    rb->emit = emit;
+    rb->ctx = ctx;
+    if (table_alloc(rb, Hash_RoundUpPow2(cfg->expected_nodes + cfg->expected_nodes / 2)) != 0) {
+        free(rb);
+        return NULL;
+    }
+    return rb;
+}
+
+void Reorder_Destroy(ReorderBuffer_t *rb) {
+    if (!rb) {
+        return;
+    }
+    for (uint32_t i = 0; i <= rb->mask; ++i) {
+        free(rb->nodes[i].heap);
+    }
+    free(rb->nodes);
+    free(rb);
+}
+
+static NodeBuf_t *node_get(ReorderBuffer_t *rb, uint32_t node) {
+    uint32_t h = (uint32_t)Hash_U64(node) & rb->mask;
+
+    while (rb->nodes[h].used) {
+        if (rb->nodes[h].node == node) {
+            return &rb->nodes[h];
+        }
+        h = (h + 1) & rb->mask;
+    }
+    if ((rb->used + 1) * 10 > (rb->mask + 1) * 7) {
+        if (table_alloc(rb, (rb->mask + 1) * 2) != 0) {
+            return NULL;
+        }
+        return node_get(rb, node);
+    }
+    NodeBuf_t *nb = &rb->nodes[h];
+    nb->used = true;
+    nb->node = node;
+    nb->newest_ts = INT64_MIN;
+    nb->released_ts = INT64_MIN;
+    rb->used++;
+    return nb;
+}
+
+static int scratch_flush(ReorderBuffer_t *rb) {
+    uint32_t n = rb->n_scratch;
+
+    rb->n_scratch = 0;
+    rb->stats.released += n;
+    return n ? rb->emit(rb->ctx, rb->scratch, n, false) : 0;
+}
+
+static void heap_push(NodeBuf_t *nb, const Sample_t *s) {
+    uint32_t i = nb->count++;
+
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (nb->heap[parent].ts <= s->ts) {
+            break;
+        }
+        nb->heap[i] = nb->heap[parent];
+        i = parent;
+    }
+    nb->heap[i] = *s;
+}
+
+static Sample_t heap_pop(NodeBuf_t *nb) {
+    Sample_t top = nb->heap[0];
+    Sample_t last = nb->heap[--nb->count];
+    uint32_t i = 0;
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= nb->count) {
+            break;
+        }
+        if (child + 1 < nb->count && nb->heap[child + 1].ts < nb->heap[child].ts) {
+            child++;
+        }
+        if (last.ts <= nb->heap[child].ts) {
+            break;
+        }
+        nb->heap[i] = nb->heap[child];
+        i = child;
+    }
+    if (nb->count > 0) {
+        nb->heap[i] = last;
+    }
+    return top;
+}
+
+// Oldest held sample out to the scratch batch
+static int release_one(ReorderBuffer_t *rb, NodeBuf_t *nb) {
+    Sample_t s = heap_pop(nb);
+
+    nb->released_ts = s.ts;
+    rb->stats.held--;
+    rb->scratch[rb->n_scratch++] = s;
+    return rb->n_scratch == SCRATCH_SAMPLES ? scratch_flush(rb) : 0;
+}
+
+static int heap_reserve(ReorderBuffer_t *rb, NodeBuf_t *nb) {
+    if (nb->count < nb->cap) {
+        return 0;
+    }
+    uint32_t cap = nb->cap ? nb->cap * 2 : HEAP_MIN;
+    cap = cap < rb->cfg.per_node ? cap : rb->cfg.per_node;
+    Sample_t *heap = realloc(nb->heap, cap * sizeof(*heap));
+    if (!heap) {
+        return -1;
+    }
+    rb->stats.bytes += (cap - nb->cap) * sizeof(*heap);
+    nb->heap = heap;
+    nb->cap = cap;
+    return 0;
+}
+
+static int push_one(ReorderBuffer_t *rb, NodeBuf_t *nb, const Sample_t *s) {
+    int rc = 0;
+
+    if (nb->count == rb->cfg.per_node) {
+        rb->stats.forced++;
+        rc = release_one(rb, nb);
+    }
+    // Also true when the forced release just passed it
+    if (s->ts < nb->released_ts) {
+        rb->stats.late++;
+        rb->stats.released++;
+        return rc | rb->emit(rb->ctx, s, 1, true);
+    }
+    if (heap_reserve(rb, nb) != 0) {
+        // No memory to hold it: pass it on now rather than lose it
+        rb->stats.released++;
+        return rc | rb->emit(rb->ctx, s, 1, false);
+    }
+    heap_push(nb, s);
+    rb->stats.held++;
+    if (s->ts > nb->newest_ts) {
+        nb->newest_ts = s->ts;
+    }
+    return rc;
+}
+
+int Reorder_Push(ReorderBuffer_t *rb, const Sample_t *samples, size_t n, int64_t arrival_ms) {
+    NodeBuf_t *nb = NULL;
+    int rc = 0;
+
+    rb->stats.pushed += n;
+    for (size_t i = 0; i < n; ++i) {
+        if (!nb || nb->node != samples[i].node) {
+            if (nb) {
+                while (rc == 0 && nb->count > 0 && nb->heap[0].ts <= nb->newest_ts - rb->cfg.lateness_ms) {
+                    rc = release_one(rb, nb);
+                }
+            }
+            if (!(nb = node_get(rb, samples[i].node))) {
+                return -1;
+            }
+        }
+        nb->last_arrival = arrival_ms;
+        rc |= push_one(rb, nb, &samples[i]);
+    }
+    if (nb) {
+        while (rc == 0 && nb->count > 0 && nb->heap[0].ts <= nb->newest_ts - rb->cfg.lateness_ms) {
+            rc = release_one(rb, nb);
+        }
+    }
+    return rc | scratch_flush(rb);
+}
+
+static int release_all(ReorderBuffer_t *rb, bool expired_only, int64_t now_ms) {
+    int rc = 0;
+
+    for (uint32_t i = 0; i <= rb->mask && rc == 0; ++i) {
+        NodeBuf_t *nb = &rb->nodes[i];
+        if (!nb->used || nb->count == 0 || (expired_only && nb->last_arrival + rb->cfg.hold_ms > now_ms)) {
+            continue;
+        }
+        if (expired_only) {
+            rb->stats.expired += nb->count;
+        }
+        while (rc == 0 && nb->count > 0) {
+            rc = release_one(rb, nb);
+        }
+    }
+    return rc | scratch_flush(rb);
+}
+
+int Reorder_Tick(ReorderBuffer_t *rb, int64_t now_ms) {
+    return release_all(rb, true, now_ms);
+}
+
+int Reorder_Flush(ReorderBuffer_t *rb) {
+    return release_all(rb, false, 0);
+}
+
+void Reorder_GetStats(const ReorderBuffer_t *rb, ReorderStats_t *stats) {
+    *stats = rb->stats;
+}
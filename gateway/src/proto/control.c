@@ -0,0 +1,121 @@
+#include "proto/control.h"
+
+#include <string.h>
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+size_t Control_EncodeSlot(uint8_t *payload, const ControlSlot_t *slot) {
+    payload[0] = CONTROL_TYPE_SLOT;
+    payload[1] = 0;
+    put_u16(payload + 2, slot->slot);
+    put_u32(payload + 4, slot->period_ms);
+    put_u32(payload + 8, slot->delay_ms);
+    return CONTROL_SLOT_LEN;
+}
+
+int Control_DecodeSlot(const uint8_t *payload, size_t len, ControlSlot_t *slot) {
+    if (len < CONTROL_SLOT_LEN || payload[0] != CONTROL_TYPE_SLOT) {
+        return -1;
+    }
+    slot->slot = get_u16(payload + 2);
+    slot->period_ms = get_u32(payload + 4);
+    slot->delay_ms = get_u32(payload + 8);
+    return slot->period_ms ? 0 : -1;
+}
+
+size_t Control_EncodeTime(uint8_t *payload, const ControlTime_t *time) {
+    payload[0] = CONTROL_TYPE_TIME;
+    payload[1] = 0;
+    put_u32(payload + 2, time->seconds);
+    put_u16(payload + 6, time->ms);
+    return CONTROL_TIME_LEN;
+}
+
+int Control_DecodeTime(const uint8_t *payload, size_t len, ControlTime_t *time) {
+    if (len < CONTROL_TIME_LEN || payload[0] != CONTROL_TYPE_TIME) {
+        return -1;
+    }
+    time->seconds = get_u32(payload + 2);
+    time->ms = get_u16(payload + 6);
+    return time->ms < 1000 ? 0 : -1;
+}
+
+size_t Control_EncodeOtaOffer(uint8_t *payload, const ControlOtaOffer_t *offer) {
+    payload[0] = CONTROL_TYPE_OTA_OFFER;
+    payload[1] = offer->flags;
+    put_u16(payload + 2, offer->from);
+    put_u16(payload + 4, offer->to);
+    put_u32(payload + 6, offer->transfer_len);
+    put_u32(payload + 10, offer->image_len);
+    put_u32(payload + 14, offer->image_crc);
+    put_u16(payload + 18, offer->pace_ms);
+    payload[20] = offer->slot_ms;
+    return CONTROL_OTA_OFFER_LEN;
+}
+
+int Control_DecodeOtaOffer(const uint8_t *payload, size_t len, ControlOtaOffer_t *offer) {
+    if (len < CONTROL_OTA_OFFER_LEN || payload[0] != CONTROL_TYPE_OTA_OFFER) {
+        return -1;
+    }
+    offer->flags = payload[1];
+    offer->from = get_u16(payload + 2);
+    offer->to = get_u16(payload + 4);
+    offer->transfer_len = get_u32(payload + 6);
+    offer->image_len = get_u32(payload + 10);
+    offer->image_crc = get_u32(payload + 14);
+    offer->pace_ms = get_u16(payload + 18);
+    offer->slot_ms = payload[20];
+    return offer->to && offer->transfer_len ? 0 : -1;
+}
+
+size_t Control_EncodeOtaChunk(uint8_t *payload, const ControlOtaChunk_t *chunk) {
+    uint8_t n = chunk->len < CONTROL_OTA_CHUNK_DATA ? chunk->len : CONTROL_OTA_CHUNK_DATA;
+
+    payload[0] = CONTROL_TYPE_OTA_CHUNK;
+    payload[1] = 0;
+    put_u16(payload + 2, chunk->to);
+    put_u32(payload + 4, chunk->offset);
+    memcpy(payload + CONTROL_OTA_CHUNK_HEADER, chunk->data, n);
+    return CONTROL_OTA_CHUNK_HEADER + n;
+}
+
+int Control_DecodeOtaChunk(const uint8_t *payload, size_t len, ControlOtaChunk_t *chunk) {
+    if (len <= CONTROL_OTA_CHUNK_HEADER || len > CONTROL_OTA_CHUNK_HEADER + CONTROL_OTA_CHUNK_DATA ||
+        payload[0] != CONTROL_TYPE_OTA_CHUNK) {
+        return -1;
+    }
+    chunk->to = get_u16(payload + 2);
+    chunk->offset = get_u32(payload + 4);
+    chunk->len = (uint8_t)(len - CONTROL_OTA_CHUNK_HEADER);
+    chunk->data = payload + CONTROL_OTA_CHUNK_HEADER;
+    return 0;
+}
+
+void Control_Stamp(uint8_t *payload, size_t len, int64_t rx_ms) {
+    ControlSlot_t slot;
+
+    if (len >= CONTROL_TIME_LEN && payload[0] == CONTROL_TYPE_TIME) {
+        ControlTime_t time = {.seconds = (uint32_t)(rx_ms / 1000), .ms = (uint16_t)(rx_ms % 1000)};
+        Control_EncodeTime(payload, &time);
+    } else if (Control_DecodeSlot(payload, len, &slot) == 0) {
+        // The phase becomes the wait from this frame to the next slot start
+        int64_t wait = ((int64_t)slot.delay_ms - rx_ms) % slot.period_ms;
+        put_u32(payload + 8, (uint32_t)(wait < 0 ? wait + slot.period_ms : wait));
+    }
+}
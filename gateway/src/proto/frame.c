@@ -0,0 +1,143 @@
+#include "proto/frame.h"
+
+#include <math.h>
+#include <string.h>
+
+// Value = raw * scale; chosen so each field's range fits an i16
+static const float field_scale[FIELD_COUNT] = {
+    [FIELD_TEMPERATURE] = 0.01f, // -327.68..327.67 degC
+    [FIELD_HUMIDITY] = 0.01f,    // 0..100 %RH
+    [FIELD_PRESSURE] = 0.1f,     // up to 3276.7 hPa
+    [FIELD_BATTERY] = 0.001f,    // up to 32.767 V
+};
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static void put_header(uint8_t *payload, const FrameHeader_t *hdr) {
+    payload[0] = hdr->type;
+    payload[1] = hdr->flags;
+    put_u32(payload + 2, hdr->node);
+    put_u16(payload + 6, hdr->seq);
+    put_u32(payload + 8, hdr->node_time);
+}
+
+size_t Frame_Encode(uint8_t *payload, const FrameHeader_t *hdr, const FrameReading_t *readings, size_t n) {
+    if (n > FRAME_MAX_READINGS) {
+        return 0;
+    }
+    put_header(payload, hdr);
+
+    uint8_t *p = payload + FRAME_HEADER_LEN;
+    for (size_t i = 0; i < n; ++i, p += FRAME_READING_LEN) {
+        if (readings[i].field >= FIELD_COUNT) {
+            return 0;
+        }
+        float raw = roundf(readings[i].value / field_scale[readings[i].field]);
+        raw = raw > 32767.0f ? 32767.0f : raw < -32768.0f ? -32768.0f : raw;
+        p[0] = readings[i].field;
+        put_u16(p + 1, (uint16_t)(int16_t)raw);
+    }
+    return (size_t)(p - payload);
+}
+
+int Frame_ParseHeader(const Frame_t *frame, FrameHeader_t *hdr) {
+    if (frame->len < FRAME_HEADER_LEN || frame->len > FRAME_MAX_PAYLOAD) {
+        return -1;
+    }
+    hdr->type = frame->payload[0];
+    hdr->flags = frame->payload[1];
+    hdr->node = get_u32(frame->payload + 2);
+    hdr->seq = get_u16(frame->payload + 6);
+    hdr->node_time = get_u32(frame->payload + 8);
+    return hdr->type == FRAME_TYPE_TELEMETRY || hdr->type == FRAME_TYPE_OTA ? 0 : -1;
+}
+
+int Frame_Decode(const Frame_t *frame, Sample_t *out, size_t max) {
+    FrameHeader_t hdr;
+
+    if (Frame_ParseHeader(frame, &hdr) != 0 || hdr.type != FRAME_TYPE_TELEMETRY ||
+        (frame->len - FRAME_HEADER_LEN) % FRAME_READING_LEN != 0) {
+        return -1;
+    }
+    int64_t ts = frame->rx_ts;
+    if ((hdr.flags & (FRAME_FLAG_NODE_TIME | FRAME_FLAG_TIME_MS)) == (FRAME_FLAG_NODE_TIME | FRAME_FLAG_TIME_MS)) {
+        // Nearest time to rx_ts with these low 32 bits
+        ts -= (int32_t)((uint32_t)frame->rx_ts - hdr.node_time);
+    } else if (hdr.flags & FRAME_FLAG_NODE_TIME) {
+        ts = (int64_t)hdr.node_time * 1000;
+    }
+    size_t n = (size_t)(frame->len - FRAME_HEADER_LEN) / FRAME_READING_LEN;
+    const uint8_t *p = frame->payload + FRAME_HEADER_LEN;
+    int count = 0;
+
+    for (size_t i = 0; i < n && (size_t)count < max; ++i, p += FRAME_READING_LEN) {
+        if (p[0] >= FIELD_COUNT) {
+            return -1;
+        }
+        out[count++] = (Sample_t){
+            .ts = ts,
+            .node = hdr.node,
+            .field = p[0],
+            .value = (float)(int16_t)get_u16(p + 1) * field_scale[p[0]],
+        };
+    }
+    return count;
+}
+
+size_t Frame_EncodeOta(uint8_t *payload, const FrameHeader_t *hdr, const FrameOta_t *ota) {
+    FrameHeader_t h = *hdr;
+
+    h.type = FRAME_TYPE_OTA;
+    put_header(payload, &h);
+    put_u16(payload + 12, ota->version);
+    put_u16(payload + 14, ota->fetching);
+    put_u32(payload + 16, ota->offset);
+    return FRAME_OTA_LEN;
+}
+
+int Frame_DecodeOta(const Frame_t *frame, FrameOta_t *ota) {
+    if (frame->len != FRAME_OTA_LEN || frame->payload[0] != FRAME_TYPE_OTA) {
+        return -1;
+    }
+    ota->version = get_u16(frame->payload + 12);
+    ota->fetching = get_u16(frame->payload + 14);
+    ota->offset = get_u32(frame->payload + 16);
+    return 0;
+}
+
+size_t Frame_Serialize(const Frame_t *frame, uint8_t *out) {
+    memcpy(out, &frame->rx_ts, sizeof(frame->rx_ts));
+    out[8] = frame->pipe;
+    out[9] = frame->rpd;
+    out[10] = frame->len;
+    memcpy(out + 11, frame->payload, frame->len);
+    return 11u + frame->len;
+}
+
+int Frame_Deserialize(const uint8_t *in, size_t len, Frame_t *frame) {
+    if (len < 11 || in[10] > FRAME_MAX_PAYLOAD || len != 11u + in[10]) {
+        return -1;
+    }
+    memcpy(&frame->rx_ts, in, sizeof(frame->rx_ts));
+    frame->pipe = in[8];
+    frame->rpd = in[9];
+    frame->len = in[10];
+    memcpy(frame->payload, in + 11, frame->len);
+    return 0;
+}
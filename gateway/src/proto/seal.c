@@ -0,0 +1,204 @@
+#include "proto/seal.h"
+
+#include <string.h>
+
+#define UNSEAL_GROUP 16 // Frames whose blocks are interleaved
+#define SEALED_FLAGS (FRAME_FLAG_ENCRYPTED | FRAME_FLAG_NODE_TIME)
+
+// Frames up to FRAME_MAX_PAYLOAD take at most two CMAC blocks and one CTR block
+_Static_assert(FRAME_MAX_PAYLOAD - FRAME_TAG_LEN <= 2 * AES_BLOCK_LEN, "frame CMAC is at most two blocks");
+
+static void shift_left(const uint8_t in[AES_BLOCK_LEN], uint8_t out[AES_BLOCK_LEN]) {
+    uint8_t carry = in[0] >> 7;
+
+    for (int i = 0; i < AES_BLOCK_LEN - 1; ++i) {
+        out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+    }
+    out[AES_BLOCK_LEN - 1] = (uint8_t)((in[AES_BLOCK_LEN - 1] << 1) ^ (carry * 0x87));
+}
+
+void FrameKey_Init(FrameKey_t *key, const uint8_t raw[AES_KEY_LEN]) {
+    uint8_t zero[AES_BLOCK_LEN] = {0}, l[AES_BLOCK_LEN];
+
+    Aes128_Init(&key->aes, raw);
+    Aes128_Encrypt(&key->aes, zero, l);
+    shift_left(l, key->k1);
+    shift_left(key->k1, key->k2);
+}
+
+static size_t cmac_blocks(size_t len) {
+    return len == 0 ? 1 : (len + AES_BLOCK_LEN - 1) / AES_BLOCK_LEN;
+}
+
+// Last CMAC block, padded and masked with its subkey
+static void cmac_last(const FrameKey_t *key, const uint8_t *msg, size_t len, uint8_t last[AES_BLOCK_LEN]) {
+    size_t blocks = cmac_blocks(len);
+    size_t tail = len - (blocks - 1) * AES_BLOCK_LEN;
+    const uint8_t *sub = key->k1;
+
+    memset(last, 0, AES_BLOCK_LEN);
+    memcpy(last, msg + (blocks - 1) * AES_BLOCK_LEN, tail);
+    if (tail < AES_BLOCK_LEN) {
+        last[tail] = 0x80;
+        sub = key->k2;
+    }
+    for (int i = 0; i < AES_BLOCK_LEN; ++i) {
+        last[i] ^= sub[i];
+    }
+}
+
+// RFC 4493 CMAC over at most two blocks (frames are at most 32 bytes)
+static void cmac(const FrameKey_t *key, const uint8_t *msg, size_t len, uint8_t mac[AES_BLOCK_LEN]) {
+    uint8_t x[AES_BLOCK_LEN] = {0}, last[AES_BLOCK_LEN];
+    size_t blocks = cmac_blocks(len);
+
+    for (size_t b = 0; b + 1 < blocks; ++b) {
+        for (int i = 0; i < AES_BLOCK_LEN; ++i) {
+            x[i] ^= msg[b * AES_BLOCK_LEN + i];
+        }
+        Aes128_Encrypt(&key->aes, x, x);
+    }
+    cmac_last(key, msg, len, last);
+    for (int i = 0; i < AES_BLOCK_LEN; ++i) {
+        x[i] ^= last[i];
+    }
+    Aes128_Encrypt(&key->aes, x, mac);
+}
+
+static bool tag_matches(const uint8_t mac[AES_BLOCK_LEN], const uint8_t *tag) {
+    uint8_t diff = 0;
+
+    for (int i = 0; i < FRAME_TAG_LEN; ++i) {
+        diff |= (uint8_t)(mac[i] ^ tag[i]);
+    }
+    return diff == 0;
+}
+
+// Length and flags; without node time the nonce could repeat
+static bool sealed_len_ok(const uint8_t *payload, size_t len) {
+    return len >= FRAME_HEADER_LEN + FRAME_TAG_LEN && len <= FRAME_MAX_PAYLOAD &&
+           (payload[1] & SEALED_FLAGS) == SEALED_FLAGS;
+}
+
+static void ctr_xor(const FrameKey_t *key, uint8_t *payload, size_t len) {
+    uint8_t nonce[AES_BLOCK_LEN] = {0}, stream[AES_BLOCK_LEN];
+
+    memcpy(nonce, payload, FRAME_HEADER_LEN);
+    // Readings fit in one block: (32 - 12 - 4) bytes at most
+    Aes128_Encrypt(&key->aes, nonce, stream);
+    for (size_t i = FRAME_HEADER_LEN; i < len; ++i) {
+        payload[i] ^= stream[i - FRAME_HEADER_LEN];
+    }
+}
+
+size_t Frame_Seal(uint8_t *payload, size_t len, const FrameKey_t *key) {
+    uint8_t mac[AES_BLOCK_LEN];
+
+    if (len < FRAME_HEADER_LEN || len + FRAME_TAG_LEN > FRAME_MAX_PAYLOAD || !(payload[1] & FRAME_FLAG_NODE_TIME)) {
+        return 0;
+    }
+    payload[1] |= FRAME_FLAG_ENCRYPTED;
+    ctr_xor(key, payload, len);
+    cmac(key, payload, len, mac);
+    memcpy(payload + len, mac, FRAME_TAG_LEN);
+    return len + FRAME_TAG_LEN;
+}
+
+int Frame_Unseal(uint8_t *payload, size_t len, const FrameKey_t *key) {
+    uint8_t mac[AES_BLOCK_LEN];
+
+    if (!sealed_len_ok(payload, len)) {
+        return -1;
+    }
+    len -= FRAME_TAG_LEN;
+    cmac(key, payload, len, mac);
+    if (!tag_matches(mac, payload + len)) {
+        return -1;
+    }
+    ctr_xor(key, payload, len);
+    payload[1] &= (uint8_t)~FRAME_FLAG_ENCRYPTED;
+    return (int)len;
+}
+
+bool Frame_SealFresh(const Frame_t *frame) {
+    FrameHeader_t hdr;
+    int64_t age;
+
+    if (Frame_ParseHeader(frame, &hdr) != 0 || !(hdr.flags & FRAME_FLAG_NODE_TIME)) {
+        return false;
+    }
+    if (hdr.flags & FRAME_FLAG_TIME_MS) {
+        age = (int32_t)((uint32_t)frame->rx_ts - hdr.node_time);
+    } else {
+        age = frame->rx_ts - (int64_t)hdr.node_time * 1000;
+    }
+    return age <= FRAME_SEAL_MAX_AGE_MS && age >= -FRAME_SEAL_MAX_AHEAD_MS;
+}
+
+/*
+ * Two passes over a group: the first encrypts every frame's CTR block and
+ * its first CMAC block, the second the final CMAC block of the frames that
+ * have two.
+ */
+static void unseal_group(FrameUnsealJob_t *jobs, size_t n) {
+    const Aes128_t *keys[2 * UNSEAL_GROUP], *keys2[UNSEAL_GROUP];
+    uint8_t blocks[2 * UNSEAL_GROUP][AES_BLOCK_LEN], blocks2[UNSEAL_GROUP][AES_BLOCK_LEN];
+    uint8_t last[UNSEAL_GROUP][AES_BLOCK_LEN];
+    int8_t mac_at[UNSEAL_GROUP], stream_at[UNSEAL_GROUP], mac2_at[UNSEAL_GROUP];
+    size_t k = 0, k2 = 0;
+
+    for (size_t j = 0; j < n; ++j) {
+        FrameUnsealJob_t *job = &jobs[j];
+        mac_at[j] = -1;
+        if (!job->key || !sealed_len_ok(job->payload, job->len)) {
+            job->result = -1;
+            continue;
+        }
+        size_t len = job->len - FRAME_TAG_LEN;
+        cmac_last(job->key, job->payload, len, last[j]);
+        keys[k] = &job->key->aes;
+        memcpy(blocks[k], cmac_blocks(len) == 1 ? last[j] : job->payload, AES_BLOCK_LEN);
+        mac_at[j] = (int8_t)k++;
+        keys[k] = &job->key->aes;
+        memset(blocks[k], 0, AES_BLOCK_LEN);
+        memcpy(blocks[k], job->payload, FRAME_HEADER_LEN);
+        stream_at[j] = (int8_t)k++;
+    }
+    Aes128_EncryptBlocks(keys, (const uint8_t(*)[AES_BLOCK_LEN])blocks, blocks, k);
+
+    for (size_t j = 0; j < n; ++j) {
+        mac2_at[j] = -1;
+        if (mac_at[j] >= 0 && cmac_blocks(jobs[j].len - FRAME_TAG_LEN) == 2) {
+            keys2[k2] = &jobs[j].key->aes;
+            for (int i = 0; i < AES_BLOCK_LEN; ++i) {
+                blocks2[k2][i] = blocks[mac_at[j]][i] ^ last[j][i];
+            }
+            mac2_at[j] = (int8_t)k2++;
+        }
+    }
+    Aes128_EncryptBlocks(keys2, (const uint8_t(*)[AES_BLOCK_LEN])blocks2, blocks2, k2);
+
+    for (size_t j = 0; j < n; ++j) {
+        FrameUnsealJob_t *job = &jobs[j];
+        if (mac_at[j] < 0) {
+            continue;
+        }
+        size_t len = job->len - FRAME_TAG_LEN;
+        const uint8_t *mac = mac2_at[j] >= 0 ? blocks2[mac2_at[j]] : blocks[mac_at[j]];
+        if (!tag_matches(mac, job->payload + len)) {
+            job->result = -1;
+            continue;
+        }
+        for (size_t i = FRAME_HEADER_LEN; i < len; ++i) {
+            job->payload[i] ^= blocks[stream_at[j]][i - FRAME_HEADER_LEN];
+        }
+        job->payload[1] &= (uint8_t)~FRAME_FLAG_ENCRYPTED;
+        job->result = (int)len;
+    }
+}
+
+void Frame_UnsealBatch(FrameUnsealJob_t *jobs, size_t n) {
+    for (size_t i = 0; i < n; i += UNSEAL_GROUP) {
+        unseal_group(jobs + i, n - i < UNSEAL_GROUP ? n - i : UNSEAL_GROUP);
+    }
+}
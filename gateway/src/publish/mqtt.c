@@ -0,0 +1,196 @@
+#include "publish/mqtt.h"
+
+#include <string.h>
+
+static size_t remaining_len_size(size_t n) {
+    return n < 128 ? 1 : n < 16384 ? 2 : n < 2097152 ? 3 : 4;
+}
+
+// Fixed header; returns its length
+static size_t put_fixed(uint8_t *out, uint8_t first, size_t remaining) {
+    size_t i = 0;
+
+    out[i++] = first;
+    do {
+        uint8_t b = (uint8_t)(remaining & 0x7f);
+        remaining >>= 7;
+        out[i++] = (uint8_t)(b | (remaining ? 0x80 : 0));
+    } while (remaining);
+    return i;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+    return p + 2;
+}
+
+static uint8_t *put_str(uint8_t *p, const void *s, size_t len) {
+    p = put_u16(p, (uint16_t)len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+size_t Mqtt_EncodeConnect(uint8_t *out, size_t cap, const char *client_id, uint16_t keepalive_s) {
+    size_t id_len = strlen(client_id);
+    size_t remaining = 10 + 2 + id_len;
+
+    if (id_len > 0xffff || 1 + remaining_len_size(remaining) + remaining > cap) {
+        return 0;
+    }
+    uint8_t *p = out + put_fixed(out, MQTT_CONNECT << 4, remaining);
+    p = put_str(p, "MQTT", 4);
+    *p++ = 4;    // Protocol level 3.1.1
+    *p++ = 0x02; // Clean session
+    p = put_u16(p, keepalive_s);
+    p = put_str(p, client_id, id_len);
+    return (size_t)(p - out);
+}
+
+size_t Mqtt_EncodeConnack(uint8_t *out, size_t cap, uint8_t return_code) {
+    if (cap < 4) {
+        return 0;
+    }
+    out[0] = MQTT_CONNACK << 4;
+    out[1] = 2;
+    out[2] = 0;
+    out[3] = return_code;
+    return 4;
+}
+
+size_t Mqtt_PublishSize(size_t topic_len, size_t len, uint8_t qos) {
+    size_t remaining = 2 + topic_len + (qos ? 2 : 0) + len;
+    return 1 + remaining_len_size(remaining) + remaining;
+}
+
+size_t Mqtt_EncodePublish(uint8_t *out, size_t cap, const char *topic, size_t topic_len, const void *payload,
+                          size_t len, uint8_t qos, uint16_t packet_id, int dup) {
+    size_t remaining = 2 + topic_len + (qos ? 2 : 0) + len;
+
+    if (topic_len > 0xffff || remaining > MQTT_MAX_REMAINING || Mqtt_PublishSize(topic_len, len, qos) > cap) {
+        return 0;
+    }
+    uint8_t first = (uint8_t)(MQTT_PUBLISH << 4 | (dup ? 0x08 : 0) | (qos & 3) << 1);
+    uint8_t *p = out + put_fixed(out, first, remaining);
+    p = put_str(p, topic, topic_len);
+    if (qos) {
+        p = put_u16(p, packet_id);
+    }
+    memcpy(p, payload, len);
+    return (size_t)(p + len - out);
+}
+
+size_t Mqtt_EncodePuback(uint8_t *out, size_t cap, uint16_t packet_id) {
+    if (cap < 4) {
+        return 0;
+    }
+    out[0] = MQTT_PUBACK << 4;
+    out[1] = 2;
+    put_u16(out + 2, packet_id);
+    return 4;
+}
+
+size_t Mqtt_EncodeSimple(uint8_t *out, size_t cap, MqttType_t type) {
+    if (cap < 2) {
+        return 0;
+    }
+    out[0] = (uint8_t)(type << 4);
+    out[1] = 0;
+    return 2;
+}
+
+int Mqtt_Parse(const uint8_t *in, size_t len, MqttPacket_t *pkt) {
+    size_t remaining = 0, i = 1;
+    int shift = 0;
+
+    if (len < 2) {
+        return 0;
+    }
+    for (;;) {
+        if (i >= len) {
+            return 0;
+        }
+        if (i > 4) {
+            return -1;
+        }
+        remaining |= (size_t)(in[i] & 0x7f) << shift;
+        shift += 7;
+        if (!(in[i++] & 0x80)) {
+            break;
+        }
+    }
+    if (remaining > MQTT_MAX_REMAINING) {
+        return -1;
+    }
+    if (len - i < remaining) {
+        return 0;
+    }
+
+    const uint8_t *body = in + i, *end = body + remaining;
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->type = (MqttType_t)(in[0] >> 4);
+    pkt->flags = in[0] & 0x0f;
+    switch (pkt->type) {
+    case MQTT_CONNECT: {
+        // Protocol name, level, flags, keepalive, then the client id
+        if (remaining < 12 || get_u16(body) != 4 || memcmp(body + 2, "MQTT", 4) != 0) {
+            return -1;
+        }
+        pkt->keepalive_s = get_u16(body + 8);
+        pkt->client_id_len = get_u16(body + 10);
+        pkt->client_id = body + 12;
+        if (pkt->client_id + pkt->client_id_len > end) {
+            return -1;
+        }
+        break;
+    }
+    case MQTT_CONNACK:
+        if (remaining != 2) {
+            return -1;
+        }
+        pkt->return_code = body[1];
+        break;
+    case MQTT_PUBLISH: {
+        uint8_t qos = (pkt->flags >> 1) & 3;
+        if (remaining < 2) {
+            return -1;
+        }
+        pkt->topic_len = get_u16(body);
+        pkt->topic = body + 2;
+        const uint8_t *p = pkt->topic + pkt->topic_len;
+        if (qos) {
+            if (p + 2 > end) {
+                return -1;
+            }
+            pkt->packet_id = get_u16(p);
+            p += 2;
+        }
+        if (p > end) {
+            return -1;
+        }
+        pkt->payload = p;
+        pkt->payload_len = (uint32_t)(end - p);
+        break;
+    }
+    case MQTT_PUBACK:
+        if (remaining != 2) {
+            return -1;
+        }
+        pkt->packet_id = get_u16(body);
+        break;
+    case MQTT_PINGREQ:
+    case MQTT_PINGRESP:
+    case MQTT_DISCONNECT:
+        if (remaining != 0) {
+            return -1;
+        }
+        break;
+    default:
+        break; // Skipped by the caller
+    }
+    return (int)(i + remaining);
+}
@@ -0,0 +1,816 @@
+#include "publish/publisher.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/hash.h"
+#include "publish/mqtt.h"
+
+#define NO_BATCH (-1)
+#define EMPTY_NODE 0xFFFFFFFFu
+#define TOPIC_MAX 64
+#define OUT_BUF_BYTES (256 * 1024)
+#define IN_BUF_BYTES 4096
+#define CONNECT_TIMEOUT_MS 5000
+#define STOP_DRAIN_MS 1000
+#define DRAIN_SAMPLES 256
+
+typedef enum {
+    LINK_DOWN,
+    LINK_CONNECTING, // TCP connect in progress
+    LINK_HANDSHAKE,  // CONNECT sent, waiting for CONNACK
+    LINK_UP,
+} LinkState_t;
+
+typedef struct {
+    int64_t ts;
+    float value;
+    uint8_t field;
+} BatchSample_t;
+
+typedef struct {
+    uint32_t node;
+    uint32_t count;
+    int64_t opened_ms;
+    int32_t prev; // Open batches, oldest first
+    int32_t next;
+} Batch_t;
+
+typedef struct {
+    uint32_t node;
+    int32_t batch;
+} NodeEntry_t;
+
+typedef struct {
+    uint64_t created_ns;
+    uint16_t topic_len;
+    uint32_t len;
+    char topic[TOPIC_MAX];
+    uint8_t payload[];
+} Message_t;
+
+typedef struct {
+    Message_t *msg; // NULL when free
+    uint16_t id;
+} Inflight_t;
+
+struct Publisher {
+    PublisherConfig_t cfg;
+    char *host;
+    char *client_id;
+    char *topic_prefix;
+    pthread_t thread;
+    int wake_fd;
+    int stop;
+
+    Queue_t *ring; // Samples from ingest
+
+    // Open batches, per node
+    NodeEntry_t *nodes;
+    uint32_t nodes_cap;
+    uint32_t nodes_used;
+    Batch_t *batches;
+    BatchSample_t *batch_samples; // max_batch per batch
+    uint32_t batches_cap;
+    int32_t free_batch;
+    int32_t oldest;
+    int32_t newest;
+
+    // Built messages waiting for the window
+    Message_t **queue;
+    uint32_t q_head;
+    uint32_t q_count;
+
+    Inflight_t *inflight;
+    uint32_t n_inflight;
+    uint32_t resend; // Next inflight slot to send again after a reconnect; window once all went
+    uint16_t *id_slot; // Packet id -> inflight slot
+    uint16_t next_id;
+
+    int fd;
+    LinkState_t state;
+    int64_t state_since_ms;
+    int64_t retry_at_ms;
+    uint32_t attempts;
+    bool was_up;
+    int64_t last_send_ms;
+    uint8_t *out;
+    size_t out_len;
+    uint8_t in[IN_BUF_BYTES];
+    size_t in_len;
+    uint64_t rng;
+
+    PublisherStats_t stats;
+    Metric_t ack_latency;
+};
+
+static int64_t mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void stat_add(uint64_t *counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+// Ring notify hook: the thread sleeps in poll, so samples arriving in an empty ring wake it there
+static void wake(void *ctx) {
+    Publisher_t *pub = ctx;
+    uint64_t one = 1;
+    ssize_t n = write(pub->wake_fd, &one, sizeof(one));
+    (void)n;
+}
+
+void Publisher_DefaultConfig(PublisherConfig_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->host = "127.0.0.1";
+    cfg->port = 1883;
+    cfg->client_id = "weather-gateway";
+    cfg->topic_prefix = "weather";
+    cfg->qos = 1;
+    cfg->max_batch = 32;
+    cfg->interval_ms = 1000;
+    cfg->window = 64;
+    cfg->queue = 4096;
+    cfg->ring = 1 << 16;
+    cfg->ring_policy = QUEUE_DROP_NEWEST;
+    cfg->keepalive_s = 30;
+    cfg->backoff_min_ms = 100;
+    cfg->backoff_max_ms = 30000;
+}
+
+/* --- Batching --- */
+
+static int nodes_grow(Publisher_t *pub) {
+    uint32_t cap = pub->nodes_cap ? pub->nodes_cap * 2 : 1024;
+    NodeEntry_t *nodes = malloc(cap * sizeof(*nodes));
+
+    if (!nodes) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < cap; ++i) {
+        nodes[i] = (NodeEntry_t){EMPTY_NODE, NO_BATCH};
+    }
+    for (uint32_t i = 0; i < pub->nodes_cap; ++i) {
+        if (pub->nodes[i].node == EMPTY_NODE) {
+            continue;
+        }
+        uint32_t h = (uint32_t)Hash_U64(pub->nodes[i].node) & (cap - 1);
+        while (nodes[h].node != EMPTY_NODE) {
+            h = (h + 1) & (cap - 1);
+        }
+        nodes[h] = pub->nodes[i];
+    }
+    free(pub->nodes);
+    pub->nodes = nodes;
+    pub->nodes_cap = cap;
+    return 0;
+}
+
+// The entry of node, or the empty one where it would go
+static NodeEntry_t *node_slot(Publisher_t *pub, uint32_t node) {
+    uint32_t h = (uint32_t)Hash_U64(node) & (pub->nodes_cap - 1);
+    while (pub->nodes[h].node != node && pub->nodes[h].node != EMPTY_NODE) {
+        h = (h + 1) & (pub->nodes_cap - 1);
+    }
+    return &pub->nodes[h];
+}
+
+// NULL when the table cannot grow to take a new node
+static NodeEntry_t *node_entry(Publisher_t *pub, uint32_t node) {
+    if ((pub->nodes_used + 1) * 10 > pub->nodes_cap * 7 && nodes_grow(pub) != 0) {
+        return NULL;
+    }
+    NodeEntry_t *e = node_slot(pub, node);
+    if (e->node == EMPTY_NODE) {
+        e->node = node;
+        pub->nodes_used++;
+    }
+    return e;
+}
+
+static int32_t batch_alloc(Publisher_t *pub) {
+    if (pub->free_batch == NO_BATCH) {
+        uint32_t cap = pub->batches_cap ? pub->batches_cap * 2 : 256;
+        Batch_t *b = realloc(pub->batches, cap * sizeof(*b));
+        if (!b) {
+            return NO_BATCH;
+        }
+        pub->batches = b;
+        BatchSample_t *s = realloc(pub->batch_samples, (size_t)cap * pub->cfg.max_batch * sizeof(*s));
+        if (!s) {
+            return NO_BATCH;
+        }
+        pub->batch_samples = s;
+        for (uint32_t i = cap; i-- > pub->batches_cap;) {
+            pub->batches[i].next = pub->free_batch;
+            pub->free_batch = (int32_t)i;
+        }
+        pub->batches_cap = cap;
+    }
+    int32_t idx = pub->free_batch;
+    pub->free_batch = pub->batches[idx].next;
+    return idx;
+}
+
+static void queue_push(Publisher_t *pub, Message_t *msg) {
+    if (pub->q_count == pub->cfg.queue) {
+        // Oldest first: fresh data is worth more downstream
+        free(pub->queue[pub->q_head]);
+        pub->q_head = (pub->q_head + 1) % pub->cfg.queue;
+        pub->q_count--;
+        stat_add(&pub->stats.dropped_messages, 1);
+    }
+    pub->queue[(pub->q_head + pub->q_count) % pub->cfg.queue] = msg;
+    pub->q_count++;
+}
+
+static Message_t *build_message(Publisher_t *pub, const Batch_t *b, const BatchSample_t *s) {
+    // [ts,"humidity",-12345.6] is at most ~48 bytes
+    size_t cap = 48 + (size_t)b->count * 48;
+    Message_t *msg = malloc(sizeof(*msg) + cap);
+
+    if (!msg) {
+        return NULL;
+    }
+    int n = snprintf(msg->topic, sizeof(msg->topic), "%s/%u", pub->topic_prefix, b->node);
+    msg->topic_len = (uint16_t)(n < (int)sizeof(msg->topic) ? n : (int)sizeof(msg->topic) - 1);
+    char *p = (char *)msg->payload, *end = p + cap;
+    p += snprintf(p, (size_t)(end - p), "{\"node\":%u,\"samples\":[", b->node);
+    for (uint32_t i = 0; i < b->count; ++i) {
+        p += snprintf(p, (size_t)(end - p), "%s[%lld,\"%s\",%.6g]", i ? "," : "", (long long)s[i].ts,
+                      Sample_FieldName((SampleField_t)s[i].field), s[i].value);
+    }
+    p += snprintf(p, (size_t)(end - p), "]}");
+    msg->len = (uint32_t)(p - (char *)msg->payload);
+    msg->created_ns = mono_ns();
+    return msg;
+}
+
+static void batch_finish(Publisher_t *pub, int32_t idx) {
+    Batch_t *b = &pub->batches[idx];
+    Message_t *msg = build_message(pub, b, &pub->batch_samples[(size_t)idx * pub->cfg.max_batch]);
+
+    if (msg) {
+        queue_push(pub, msg);
+        stat_add(&pub->stats.messages, 1);
+    } else {
+        stat_add(&pub->stats.dropped_samples, b->count);
+    }
+    if (b->prev != NO_BATCH) {
+        pub->batches[b->prev].next = b->next;
+    } else {
+        pub->oldest = b->next;
+    }
+    if (b->next != NO_BATCH) {
+        pub->batches[b->next].prev = b->prev;
+    } else {
+        pub->newest = b->prev;
+    }
+    // A node with an open batch is in the table already, so the lookup needs no growth that could fail
+    node_slot(pub, b->node)->batch = NO_BATCH;
+    b->next = pub->free_batch;
+    pub->free_batch = idx;
+}
+
+static void batch_add(Publisher_t *pub, const Sample_t *sample, int64_t now) {
+    NodeEntry_t *e = node_entry(pub, sample->node);
+
+    if (!e) {
+        stat_add(&pub->stats.dropped_samples, 1);
+        return;
+    }
+    if (e->batch == NO_BATCH) {
+        int32_t idx = batch_alloc(pub);
+        if (idx == NO_BATCH) {
+            stat_add(&pub->stats.dropped_samples, 1);
+            return;
+        }
+        e->batch = idx;
+        pub->batches[idx] = (Batch_t){.node = sample->node, .opened_ms = now, .prev = pub->newest, .next = NO_BATCH};
+        if (pub->newest != NO_BATCH) {
+            pub->batches[pub->newest].next = idx;
+        } else {
+            pub->oldest = idx;
+        }
+        pub->newest = idx;
+    }
+    int32_t idx = e->batch;
+    Batch_t *b = &pub->batches[idx];
+    pub->batch_samples[(size_t)idx * pub->cfg.max_batch + b->count++] =
+        (BatchSample_t){sample->ts, sample->value, sample->field};
+    if (b->count == pub->cfg.max_batch) {
+        batch_finish(pub, idx);
+    }
+}
+
+static void drain_ring(Publisher_t *pub, int64_t now) {
+    Sample_t samples[DRAIN_SAMPLES];
+    size_t n;
+
+    while ((n = Queue_Pop(pub->ring, samples, DRAIN_SAMPLES, 0)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            batch_add(pub, &samples[i], now);
+        }
+    }
+}
+
+static void flush_expired(Publisher_t *pub, int64_t now, bool all) {
+    while (pub->oldest != NO_BATCH && (all || pub->batches[pub->oldest].opened_ms + pub->cfg.interval_ms <= now)) {
+        batch_finish(pub, pub->oldest);
+    }
+}
+
+/* --- Connection --- */
+
+static int out_flush(Publisher_t *pub) {
+    size_t sent = 0;
+
+    while (sent < pub->out_len) {
+        ssize_t n = send(pub->fd, pub->out + sent, pub->out_len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        sent += (size_t)n;
+    }
+    memmove(pub->out, pub->out + sent, pub->out_len - sent);
+    pub->out_len -= sent;
+    return 0;
+}
+
+static void link_down(Publisher_t *pub, int64_t now) {
+    if (pub->fd >= 0) {
+        close(pub->fd);
+        pub->fd = -1;
+    }
+    pub->state = LINK_DOWN;
+    pub->out_len = 0;
+    pub->in_len = 0;
+    __atomic_store_n(&pub->stats.connected, 0, __ATOMIC_RELAXED);
+
+    // Full jitter over [delay / 2, delay] so a restarted broker is not hit by every gateway at once
+    uint32_t shift = pub->attempts < 16 ? pub->attempts : 16;
+    uint64_t delay = (uint64_t)pub->cfg.backoff_min_ms << shift;
+    if (delay > pub->cfg.backoff_max_ms) {
+        delay = pub->cfg.backoff_max_ms;
+    }
+    pub->rng ^= pub->rng << 13;
+    pub->rng ^= pub->rng >> 7;
+    pub->rng ^= pub->rng << 17;
+    pub->retry_at_ms = now + (int64_t)(delay / 2 + pub->rng % (delay / 2 + 1));
+    pub->attempts++;
+}
+
+static void link_start(Publisher_t *pub, int64_t now) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(pub->cfg.port)};
+    int one = 1;
+
+    if (inet_pton(AF_INET, pub->host, &addr.sin_addr) != 1) {
+        link_down(pub, now);
+        return;
+    }
+    pub->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (pub->fd < 0) {
+        link_down(pub, now);
+        return;
+    }
+    setsockopt(pub->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    pub->state_since_ms = now;
+    if (connect(pub->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        pub->state = LINK_CONNECTING; // Completed at once on loopback; handled the same way
+    } else if (errno == EINPROGRESS) {
+        pub->state = LINK_CONNECTING;
+    } else {
+        link_down(pub, now);
+    }
+}
+
+static void link_connected(Publisher_t *pub, int64_t now) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(pub->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+        link_down(pub, now);
+        return;
+    }
+    pub->out_len = Mqtt_EncodeConnect(pub->out, OUT_BUF_BYTES, pub->client_id, pub->cfg.keepalive_s);
+    pub->state = LINK_HANDSHAKE;
+    pub->state_since_ms = now;
+    if (out_flush(pub) != 0) {
+        link_down(pub, now);
+    }
+}
+
+static bool write_publish(Publisher_t *pub, const Message_t *msg, uint16_t id, int dup) {
+    size_t need = Mqtt_PublishSize(msg->topic_len, msg->len, pub->cfg.qos);
+
+    if (pub->out_len + need > OUT_BUF_BYTES) {
+        return false;
+    }
+    pub->out_len += Mqtt_EncodePublish(pub->out + pub->out_len, OUT_BUF_BYTES - pub->out_len, msg->topic,
+                                       msg->topic_len, msg->payload, msg->len, pub->cfg.qos, id, dup);
+    stat_add(&pub->stats.published, 1);
+    stat_add(&pub->stats.bytes, need);
+    return true;
+}
+
+static void link_up(Publisher_t *pub, int64_t now) {
+    pub->state = LINK_UP;
+    pub->attempts = 0;
+    pub->last_send_ms = now;
+    __atomic_store_n(&pub->stats.connected, 1, __ATOMIC_RELAXED);
+    if (pub->was_up) {
+        stat_add(&pub->stats.reconnects, 1);
+    }
+    pub->was_up = true;
+    pub->resend = 0;
+}
+
+// The broker started a clean session: everything unacknowledged goes again, as far as the out buffer takes it
+static void resend_inflight(Publisher_t *pub) {
+    for (; pub->resend < pub->cfg.window; ++pub->resend) {
+        Inflight_t *f = &pub->inflight[pub->resend];
+        if (f->msg) {
+            if (!write_publish(pub, f->msg, f->id, 1)) {
+                return; // The rest follow once the socket takes the buffer
+            }
+            stat_add(&pub->stats.retransmits, 1);
+        }
+    }
+}
+
+static void send_queued(Publisher_t *pub) {
+    while (pub->q_count > 0 && (pub->cfg.qos == 0 || pub->n_inflight < pub->cfg.window)) {
+        Message_t *msg = pub->queue[pub->q_head];
+        uint16_t id = 0;
+        uint32_t slot = 0;
+
+        if (pub->cfg.qos) {
+            do {
+                id = ++pub->next_id;
+            } while (id == 0);
+            while (pub->inflight[slot].msg) {
+                slot++;
+            }
+        }
+        if (!write_publish(pub, msg, id, 0)) {
+            break;
+        }
+        pub->q_head = (pub->q_head + 1) % pub->cfg.queue;
+        pub->q_count--;
+        if (pub->cfg.qos) {
+            pub->inflight[slot] = (Inflight_t){msg, id};
+            pub->id_slot[id] = (uint16_t)slot;
+            pub->n_inflight++;
+        } else {
+            free(msg);
+        }
+    }
+}
+
+static void handle_packet(Publisher_t *pub, const MqttPacket_t *pkt, int64_t now) {
+    switch (pkt->type) {
+    case MQTT_CONNACK:
+        if (pub->state != LINK_HANDSHAKE || pkt->return_code != 0) {
+            link_down(pub, now);
+        } else {
+            link_up(pub, now);
+        }
+        break;
+    case MQTT_PUBACK: {
+        Inflight_t *f = &pub->inflight[pub->id_slot[pkt->packet_id] % pub->cfg.window];
+        if (f->msg && f->id == pkt->packet_id) {
+            Metrics_Observe(pub->ack_latency, mono_ns() - f->msg->created_ns);
+            free(f->msg);
+            f->msg = NULL;
+            pub->n_inflight--;
+            stat_add(&pub->stats.acked, 1);
+        }
+        break;
+    }
+    default:
+        break; // PINGRESP and anything unexpected
+    }
+}
+
+static void link_read(Publisher_t *pub, int64_t now) {
+    for (;;) {
+        ssize_t n = recv(pub->fd, pub->in + pub->in_len, sizeof(pub->in) - pub->in_len, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            link_down(pub, now);
+            return;
+        }
+        pub->in_len += (size_t)n;
+
+        size_t off = 0;
+        for (;;) {
+            MqttPacket_t pkt;
+            int used = Mqtt_Parse(pub->in + off, pub->in_len - off, &pkt);
+            if (used < 0) {
+                link_down(pub, now);
+                return;
+            }
+            if (used == 0) {
+                break;
+            }
+            handle_packet(pub, &pkt, now);
+            if (pub->state == LINK_DOWN) {
+                return;
+            }
+            off += (size_t)used;
+        }
+        memmove(pub->in, pub->in + off, pub->in_len - off);
+        pub->in_len -= off;
+    }
+}
+
+/* --- Thread --- */
+
+// One pass of work; returns the poll timeout until the next deadline
+static int step(Publisher_t *pub, int64_t now, bool stopping) {
+    drain_ring(pub, now);
+    flush_expired(pub, now, stopping);
+
+    switch (pub->state) {
+    case LINK_DOWN:
+        if (now >= pub->retry_at_ms) {
+            link_start(pub, now);
+        }
+        break;
+    case LINK_CONNECTING:
+    case LINK_HANDSHAKE:
+        if (now - pub->state_since_ms > CONNECT_TIMEOUT_MS) {
+            link_down(pub, now);
+        }
+        break;
+    case LINK_UP: {
+        // New messages would take the buffer space and window slots the resends are waiting for
+        resend_inflight(pub);
+        if (pub->resend == pub->cfg.window) {
+            send_queued(pub);
+        }
+        // Ping at half the keepalive so the broker never sees a silent client
+        if (pub->cfg.keepalive_s && pub->out_len == 0 && now - pub->last_send_ms >= pub->cfg.keepalive_s * 500) {
+            pub->out_len = Mqtt_EncodeSimple(pub->out, OUT_BUF_BYTES, MQTT_PINGREQ);
+        }
+        if (pub->out_len > 0) {
+            pub->last_send_ms = now;
+        }
+        if (out_flush(pub) != 0) {
+            link_down(pub, now);
+        }
+        break;
+    }
+    }
+
+    int64_t deadline = now + 1000;
+    if (pub->oldest != NO_BATCH) {
+        int64_t due = pub->batches[pub->oldest].opened_ms + pub->cfg.interval_ms;
+        deadline = due < deadline ? due : deadline;
+    }
+    if (pub->state == LINK_DOWN) {
+        deadline = pub->retry_at_ms < deadline ? pub->retry_at_ms : deadline;
+    }
+    return deadline > now ? (int)(deadline - now) : 0;
+}
+
+static void wait_events(Publisher_t *pub, int timeout_ms) {
+    struct pollfd fds[2] = {{.fd = pub->wake_fd, .events = POLLIN}, {.fd = -1}};
+
+    if (pub->fd >= 0) {
+        fds[1].fd = pub->fd;
+        fds[1].events = POLLIN;
+        if (pub->state == LINK_CONNECTING || pub->out_len > 0 ||
+            (pub->state == LINK_UP && pub->q_count > 0 && pub->n_inflight < pub->cfg.window)) {
+            fds[1].events |= POLLOUT;
+        }
+    }
+    // A push into the drained ring writes wake_fd, so nothing offered since drain_ring is missed
+    poll(fds, 2, timeout_ms);
+
+    int64_t now = mono_ms();
+    if (fds[0].revents & POLLIN) {
+        uint64_t v;
+        ssize_t n = read(pub->wake_fd, &v, sizeof(v));
+        (void)n;
+    }
+    if (pub->fd >= 0 && fds[1].revents) {
+        if (pub->state == LINK_CONNECTING && (fds[1].revents & (POLLOUT | POLLERR | POLLHUP))) {
+            link_connected(pub, now);
+        }
+        if (pub->fd >= 0 && (fds[1].revents & (POLLIN | POLLERR | POLLHUP))) {
+            link_read(pub, now);
+        }
+    }
+}
+
+static void *publisher_thread(void *arg) {
+    Publisher_t *pub = arg;
+
+    while (!__atomic_load_n(&pub->stop, __ATOMIC_ACQUIRE)) {
+        wait_events(pub, step(pub, mono_ms(), false));
+    }
+    // Last batches out, then give the broker a moment to take the queue
+    int64_t until = mono_ms() + STOP_DRAIN_MS;
+    for (int64_t now = mono_ms(); now < until; now = mono_ms()) {
+        int timeout = step(pub, now, true);
+        if (pub->state == LINK_UP && pub->q_count == 0 && pub->n_inflight == 0 && pub->out_len == 0) {
+            break;
+        }
+        wait_events(pub, timeout < 50 ? timeout : 50);
+    }
+    if (pub->state == LINK_UP) {
+        pub->out_len = Mqtt_EncodeSimple(pub->out, OUT_BUF_BYTES, MQTT_DISCONNECT);
+        out_flush(pub);
+    }
+    return NULL;
+}
+
+static void collect(void *ctx, FILE *out) {
+    PublisherStats_t st;
+
+    Publisher_GetStats(ctx, &st);
+    Metrics_WriteValue(out, "gateway_mqtt_offered_total", "Samples offered to the publisher", METRIC_COUNTER,
+                       (double)st.offered);
+    Metrics_WriteValue(out, "gateway_mqtt_dropped_samples_total",
+                       "Samples dropped by the ring policy or a failed allocation", METRIC_COUNTER,
+                       (double)st.dropped_samples);
+    Metrics_WriteValue(out, "gateway_mqtt_messages_total", "Batches built", METRIC_COUNTER, (double)st.messages);
+    Metrics_WriteValue(out, "gateway_mqtt_dropped_messages_total", "Messages dropped with the queue full",
+                       METRIC_COUNTER, (double)st.dropped_messages);
+    Metrics_WriteValue(out, "gateway_mqtt_acked_total", "Messages acknowledged", METRIC_COUNTER, (double)st.acked);
+    Metrics_WriteValue(out, "gateway_mqtt_retransmits_total", "Messages resent after a reconnect", METRIC_COUNTER,
+                       (double)st.retransmits);
+    Metrics_WriteValue(out, "gateway_mqtt_reconnects_total", "Broker reconnects", METRIC_COUNTER,
+                       (double)st.reconnects);
+    Metrics_WriteValue(out, "gateway_mqtt_queued", "Messages waiting for the window", METRIC_GAUGE, st.queued);
+    Metrics_WriteValue(out, "gateway_mqtt_connected", "Broker connection up", METRIC_GAUGE, st.connected);
+}
+
+Publisher_t *Publisher_Start(const PublisherConfig_t *cfg) {
+    if (cfg->qos > 1 || cfg->max_batch == 0 || cfg->window == 0 || cfg->window > 65535 || cfg->queue == 0 ||
+        cfg->ring == 0 || cfg->backoff_min_ms == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    Publisher_t *pub = calloc(1, sizeof(*pub));
+    if (!pub) {
+        return NULL;
+    }
+    pub->cfg = *cfg;
+    pub->fd = -1;
+    pub->wake_fd = -1;
+    pub->free_batch = pub->oldest = pub->newest = NO_BATCH;
+    pub->rng = (uint64_t)mono_ns() | 1;
+    pub->ack_latency = (Metric_t){.slot = -1};
+    pub->host = strdup(cfg->host);
+    pub->client_id = strdup(cfg->client_id);
+    pub->topic_prefix = strdup(cfg->topic_prefix);
+    pub->queue = malloc(cfg->queue * sizeof(*pub->queue));
+    pub->inflight = calloc(cfg->window, sizeof(*pub->inflight));
+    pub->id_slot = calloc(65536, sizeof(*pub->id_slot));
+    pub->out = malloc(OUT_BUF_BYTES);
+    pub->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    QueueConfig_t ring_cfg;
+    Queue_DefaultConfig(&ring_cfg);
+    ring_cfg.name = "mqtt";
+    ring_cfg.item_size = sizeof(Sample_t);
+    ring_cfg.capacity = cfg->ring;
+    ring_cfg.policy = cfg->ring_policy;
+    ring_cfg.spill_path = cfg->spill_path;
+    ring_cfg.notify = wake;
+    ring_cfg.notify_ctx = pub;
+    ring_cfg.metrics = cfg->metrics;
+    pub->ring = pub->wake_fd >= 0 ? Queue_Create(&ring_cfg) : NULL;
+    if (!pub->host || !pub->client_id || !pub->topic_prefix || !pub->ring || !pub->queue || !pub->inflight ||
+        !pub->id_slot || !pub->out || pub->wake_fd < 0 || nodes_grow(pub) != 0) {
+        goto fail;
+    }
+    pub->cfg.host = pub->host;
+    pub->cfg.client_id = pub->client_id;
+    pub->cfg.topic_prefix = pub->topic_prefix;
+    if (cfg->metrics) {
+        pub->ack_latency = Metrics_Histogram(cfg->metrics, "gateway_mqtt_ack_seconds",
+                                             "Message built to PUBACK received", 1e-9);
+    }
+    if (pthread_create(&pub->thread, NULL, publisher_thread, pub) != 0) {
+        goto fail;
+    }
+    if (cfg->metrics) {
+        Metrics_AddCollector(cfg->metrics, collect, pub);
+    }
+    return pub;
+
+fail:
+    if (pub->wake_fd >= 0) {
+        close(pub->wake_fd);
+    }
+    free(pub->out);
+    free(pub->id_slot);
+    free(pub->inflight);
+    free(pub->queue);
+    Queue_Destroy(pub->ring);
+    free(pub->nodes);
+    free(pub->topic_prefix);
+    free(pub->client_id);
+    free(pub->host);
+    free(pub);
+    return NULL;
+}
+
+void Publisher_Stop(Publisher_t *pub) {
+    if (!pub) {
+        return;
+    }
+    if (pub->cfg.metrics) {
+        Metrics_RemoveCollector(pub->cfg.metrics, collect, pub);
+    }
+    // Producers blocked on a full ring give up; the thread drains what is left
+    Queue_Close(pub->ring);
+    __atomic_store_n(&pub->stop, 1, __ATOMIC_RELEASE);
+    wake(pub);
+    pthread_join(pub->thread, NULL);
+
+    if (pub->fd >= 0) {
+        close(pub->fd);
+    }
+    close(pub->wake_fd);
+    for (uint32_t i = 0; i < pub->q_count; ++i) {
+        free(pub->queue[(pub->q_head + i) % pub->cfg.queue]);
+    }
+    for (uint32_t i = 0; i < pub->cfg.window; ++i) {
+        free(pub->inflight[i].msg);
+    }
+    free(pub->out);
+    free(pub->id_slot);
+    free(pub->inflight);
+    free(pub->queue);
+    Queue_Destroy(pub->ring);
+    free(pub->nodes);
+    free(pub->batches);
+    free(pub->batch_samples);
+    free(pub->topic_prefix);
+    free(pub->client_id);
+    free(pub->host);
+    free(pub);
+}
+
+size_t Publisher_Offer(Publisher_t *pub, const Sample_t *samples, size_t n) {
+    return Queue_Push(pub->ring, samples, n, 0);
+}
+
+void Publisher_Tap(void *ctx, const Sample_t *samples, size_t n) {
+    Publisher_Offer(ctx, samples, n);
+}
+
+void Publisher_GetStats(Publisher_t *pub, PublisherStats_t *stats) {
+    PublisherStats_t *s = &pub->stats;
+
+    QueueStats_t ring;
+    Queue_GetStats(pub->ring, &ring);
+    stats->offered = ring.pushed + ring.dropped;
+    stats->dropped_samples = ring.dropped + ring.evicted + __atomic_load_n(&s->dropped_samples, __ATOMIC_RELAXED);
+    stats->messages = __atomic_load_n(&s->messages, __ATOMIC_RELAXED);
+    stats->dropped_messages = __atomic_load_n(&s->dropped_messages, __ATOMIC_RELAXED);
+    stats->published = __atomic_load_n(&s->published, __ATOMIC_RELAXED);
+    stats->acked = __atomic_load_n(&s->acked, __ATOMIC_RELAXED);
+    stats->retransmits = __atomic_load_n(&s->retransmits, __ATOMIC_RELAXED);
+    stats->reconnects = __atomic_load_n(&s->reconnects, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&s->bytes, __ATOMIC_RELAXED);
+    stats->inflight = __atomic_load_n(&pub->n_inflight, __ATOMIC_RELAXED);
+    stats->queued = __atomic_load_n(&pub->q_count, __ATOMIC_RELAXED);
+    stats->connected = __atomic_load_n(&s->connected, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,973 @@
+#include "publish/stream.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/hash.h"
+#include "common/queue.h"
+
+#define REQUEST_MAX 2048
+#define CLIENT_QUEUE 256 // Buffers queued per subscriber
+#define SEND_IOV 64
+#define DRAIN_SAMPLES 256
+#define SAMPLE_JSON_MAX 64
+#define EPOLL_EVENTS 64
+#define EV_WAKE UINT32_MAX
+#define EV_LISTEN (UINT32_MAX - 1)
+#define EMPTY_NODE 0xFFFFFFFFu
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_TEXT 0x1
+#define WS_CLOSE 0x8
+#define WS_PING 0x9
+#define WS_PONG 0xA
+#define WS_POLICY_VIOLATION 1008
+#define HANDSHAKE_TIMEOUT_MS 5000
+#define CLOSE_LINGER_MS 1000 // For the close frame to go out; a stalled reader is cut off after it
+#define SWEEP_INTERVAL_MS 250
+
+// Bytes ready for the socket, shared read-only by every queue that holds it
+typedef struct {
+    uint32_t refs;
+    uint32_t len;
+    uint8_t data[];
+} StreamBuf_t;
+
+typedef enum {
+    CLIENT_FREE = 0,
+    CLIENT_HANDSHAKE,
+    CLIENT_OPEN,
+    CLIENT_CLOSING, // Closes once its queue is sent, or at its deadline
+} ClientState_t;
+
+typedef struct {
+    int fd;
+    ClientState_t state;
+    bool want_out; // EPOLLOUT armed
+    bool lagging;  // Coalesced: gets the next snapshot, then updates again
+    StreamBuf_t *queue[CLIENT_QUEUE];
+    uint32_t q_head;
+    uint32_t q_count;
+    size_t head_off;     // Bytes of the head buffer already sent
+    size_t pending;      // Bytes queued and not yet sent
+    int64_t deadline_ms; // Closed then if still shaking hands or closing
+    size_t in_len;
+    uint8_t in[REQUEST_MAX]; // The handshake request, then frames from the client
+} Client_t;
+
+// Latest value of each field of a node, for snapshots
+typedef struct {
+    uint32_t node;
+    uint8_t have; // A bit per field
+    int64_t ts[FIELD_COUNT];
+    float value[FIELD_COUNT];
+} Latest_t;
+
+struct StreamServer {
+    StreamConfig_t cfg;
+    int listen_fd;
+    int wake_fd;
+    int epoll_fd;
+    uint16_t port;
+    pthread_t thread;
+    int stop;
+    Queue_t *ring;
+
+    Client_t *clients;
+    uint32_t n_clients;
+    int64_t next_sweep_ms;
+
+    // Update being collected
+    Sample_t *batch;
+    uint32_t batch_len;
+    int64_t batch_opened_ms;
+    char *json;
+    size_t json_cap;
+
+    Latest_t *latest;
+    uint32_t latest_cap;
+    uint32_t latest_used;
+
+    StreamStats_t stats; // Written by the stream thread only
+    Metric_t fanout_ns;
+};
+
+static int64_t mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void stat_add(uint64_t *counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+void Stream_DefaultConfig(StreamConfig_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->port = 8081;
+    cfg->max_clients = 1024;
+    cfg->interval_ms = 100;
+    cfg->max_batch = 512;
+    cfg->max_pending = 1 << 20;
+    cfg->slow = STREAM_SLOW_COALESCE;
+    cfg->ring = 1 << 16;
+}
+
+/* --- Handshake --- */
+
+static uint32_t rol32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+// Only for Sec-WebSocket-Accept, so short messages and no streaming
+static void sha1(const uint8_t *msg, size_t len, uint8_t out[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t blocks = (len + 9 + 63) / 64;
+
+    for (size_t b = 0; b < blocks; ++b) {
+        uint8_t block[64];
+        uint32_t w[80];
+        // Message, then 0x80, zeros and the length in bits at the very end
+        for (size_t i = 0; i < 64; ++i) {
+            size_t at = b * 64 + i;
+            block[i] = at < len ? msg[at] : at == len ? 0x80 : 0;
+        }
+        if (b == blocks - 1) {
+            uint64_t bits = (uint64_t)len * 8;
+            for (int i = 0; i < 8; ++i) {
+                block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+            }
+        }
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 |
+                   block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (bb & c) | (~bb & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = bb ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (bb & c) | (bb & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = bb ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol32(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol32(bb, 30);
+            bb = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += bb;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 5; ++i) {
+        out[4 * i] = (uint8_t)(h[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(h[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(h[i] >> 8);
+        out[4 * i + 3] = (uint8_t)h[i];
+    }
+}
+
+static void base64(const uint8_t *in, size_t len, char *out) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        *out++ = digits[v >> 18];
+        *out++ = digits[(v >> 12) & 63];
+        *out++ = i + 1 < len ? digits[(v >> 6) & 63] : '=';
+        *out++ = i + 2 < len ? digits[v & 63] : '=';
+    }
+    *out = '\0';
+}
+
+// Value of a request header, case-insensitive; NULL if absent or too long
+static const char *header(const char *req, const char *name, char *value, size_t cap) {
+    size_t name_len = strlen(name);
+
+    for (const char *line = strchr(req, '\n'); line; line = strchr(line, '\n')) {
+        line++;
+        if (strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+            continue;
+        }
+        const char *v = line + name_len + 1;
+        while (*v == ' ' || *v == '\t') {
+            v++;
+        }
+        size_t len = strcspn(v, "\r\n");
+        if (len >= cap) {
+            return NULL;
+        }
+        memcpy(value, v, len);
+        value[len] = '\0';
+        return value;
+    }
+    return NULL;
+}
+
+/* --- Buffers and send queues --- */
+
+static StreamBuf_t *buf_raw(const void *data, size_t len) {
+    StreamBuf_t *b = malloc(sizeof(*b) + len);
+
+    if (b) {
+        b->refs = 0;
+        b->len = (uint32_t)len;
+        memcpy(b->data, data, len);
+    }
+    return b;
+}
+
+// One unmasked frame, as the server sends them
+static StreamBuf_t *buf_frame(uint8_t opcode, const void *payload, size_t len) {
+    size_t hdr = len < 126 ? 2 : len < 65536 ? 4 : 10;
+    StreamBuf_t *b = malloc(sizeof(*b) + hdr + len);
+
+    if (!b) {
+        return NULL;
+    }
+    b->refs = 0;
+    b->len = (uint32_t)(hdr + len);
+    b->data[0] = 0x80 | opcode;
+    if (hdr == 2) {
+        b->data[1] = (uint8_t)len;
+    } else if (hdr == 4) {
+        b->data[1] = 126;
+        b->data[2] = (uint8_t)(len >> 8);
+        b->data[3] = (uint8_t)len;
+    } else {
+        b->data[1] = 127;
+        for (int i = 0; i < 8; ++i) {
+            b->data[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        }
+    }
+    memcpy(b->data + hdr, payload, len);
+    return b;
+}
+
+static void buf_unref(StreamServer_t *server, StreamBuf_t *b) {
+    if (--b->refs == 0) {
+        free(b);
+        __atomic_store_n(&server->stats.buffers, server->stats.buffers - 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void client_push(StreamServer_t *server, Client_t *c, StreamBuf_t *b) {
+    if (b->refs++ == 0) {
+        __atomic_store_n(&server->stats.buffers, server->stats.buffers + 1, __ATOMIC_RELAXED);
+    }
+    c->queue[(c->q_head + c->q_count++) % CLIENT_QUEUE] = b;
+    c->pending += b->len;
+}
+
+// Drops what has not started to go out; a half-sent buffer stays, or the stream would break
+static void client_drop_unsent(StreamServer_t *server, Client_t *c) {
+    uint32_t keep = c->head_off > 0;
+
+    while (c->q_count > keep) {
+        StreamBuf_t *b = c->queue[(c->q_head + --c->q_count) % CLIENT_QUEUE];
+        c->pending -= b->len;
+        buf_unref(server, b);
+    }
+}
+
+static void client_close(StreamServer_t *server, Client_t *c) {
+    c->head_off = 0;
+    client_drop_unsent(server, c);
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->state = CLIENT_FREE;
+    c->in_len = 0;
+    c->pending = 0;
+    c->q_head = 0;
+    c->lagging = false;
+    c->want_out = false;
+    __atomic_store_n(&server->stats.clients, --server->n_clients, __ATOMIC_RELAXED);
+}
+
+static void client_want_out(StreamServer_t *server, Client_t *c, bool want) {
+    if (c->want_out != want) {
+        struct epoll_event ev = {.events = EPOLLIN | (want ? EPOLLOUT : 0), .data.u32 = (uint32_t)(c - server->clients)};
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_out = want;
+    }
+}
+
+static void client_closing(Client_t *c) {
+    c->state = CLIENT_CLOSING;
+    c->deadline_ms = mono_ms() + CLOSE_LINGER_MS;
+}
+
+// Sends what the socket takes without waiting; -1 once the client is closed
+static int client_flush(StreamServer_t *server, Client_t *c) {
+    while (c->q_count > 0) {
+        struct iovec iov[SEND_IOV];
+        uint32_t k = c->q_count < SEND_IOV ? c->q_count : SEND_IOV;
+        for (uint32_t i = 0; i < k; ++i) {
+            StreamBuf_t *b = c->queue[(c->q_head + i) % CLIENT_QUEUE];
+            size_t off = i == 0 ? c->head_off : 0;
+            iov[i] = (struct iovec){b->data + off, b->len - off};
+        }
+        struct msghdr msg = {.msg_iov = iov, .msg_iovlen = k};
+        ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            client_want_out(server, c, true);
+            return 0;
+        }
+        if (n <= 0) {
+            client_close(server, c);
+            return -1;
+        }
+        stat_add(&server->stats.sent_bytes, (uint64_t)n);
+        c->pending -= (size_t)n;
+        while (n > 0) {
+            StreamBuf_t *b = c->queue[c->q_head];
+            size_t left = b->len - c->head_off;
+            if ((size_t)n < left) {
+                c->head_off += (size_t)n;
+                break;
+            }
+            n -= (ssize_t)left;
+            c->head_off = 0;
+            c->q_head = (c->q_head + 1) % CLIENT_QUEUE;
+            c->q_count--;
+            buf_unref(server, b);
+        }
+    }
+    client_want_out(server, c, false);
+    if (c->state == CLIENT_CLOSING) {
+        client_close(server, c);
+        return -1;
+    }
+    return 0;
+}
+
+// Control frames and handshake replies skip the slow check: they are small and rare
+static void client_send(StreamServer_t *server, Client_t *c, StreamBuf_t *b) {
+    if (!b) {
+        client_close(server, c);
+        return;
+    }
+    client_push(server, c, b);
+    client_flush(server, c);
+}
+
+static void client_close_with(StreamServer_t *server, Client_t *c, uint16_t status) {
+    uint8_t payload[2] = {(uint8_t)(status >> 8), (uint8_t)status};
+
+    client_closing(c);
+    client_send(server, c, buf_frame(WS_CLOSE, payload, sizeof(payload)));
+}
+
+// An update for one subscriber, subject to its backlog limit
+static void client_update(StreamServer_t *server, Client_t *c, StreamBuf_t *b) {
+    if (c->lagging) {
+        return; // The snapshot covers it
+    }
+    if (c->q_count < CLIENT_QUEUE && c->pending + b->len <= server->cfg.max_pending) {
+        client_push(server, c, b);
+        return;
+    }
+    client_drop_unsent(server, c);
+    if (server->cfg.slow == STREAM_SLOW_DROP) {
+        stat_add(&server->stats.dropped_slow, 1);
+        client_closing(c);
+        uint8_t payload[2] = {WS_POLICY_VIOLATION >> 8, WS_POLICY_VIOLATION & 0xFF};
+        StreamBuf_t *close_frame = buf_frame(WS_CLOSE, payload, sizeof(payload));
+        if (close_frame) {
+            client_push(server, c, close_frame);
+        }
+    } else {
+        stat_add(&server->stats.coalesced, 1);
+        c->lagging = true;
+    }
+}
+
+/* --- Requests from subscribers --- */
+
+static void handshake(StreamServer_t *server, Client_t *c, size_t req_len) {
+    char *req = (char *)c->in;
+    char key[64], upgrade[64], reply[256];
+    uint8_t digest[20];
+    char accept_key[32];
+
+    req[req_len - 1] = '\0'; // The final '\n'
+    bool path_ok = strncmp(req, "GET /stream", 11) == 0 && (req[11] == ' ' || req[11] == '?');
+    if (!path_ok || !header(req, "Upgrade", upgrade, sizeof(upgrade)) || !strcasestr(upgrade, "websocket") ||
+        !header(req, "Sec-WebSocket-Key", key, sizeof(key) - sizeof(WS_GUID))) {
+        static const char bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        stat_add(&server->stats.rejected, 1);
+        client_closing(c);
+        client_send(server, c, buf_raw(bad, sizeof(bad) - 1));
+        return;
+    }
+    strcat(key, WS_GUID);
+    sha1((const uint8_t *)key, strlen(key), digest);
+    base64(digest, sizeof(digest), accept_key);
+    int n = snprintf(reply, sizeof(reply),
+                     "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\n\r\n",
+                     accept_key);
+    // Frames sent right behind the request stay in the buffer
+    memmove(c->in, c->in + req_len, c->in_len - req_len);
+    c->in_len -= req_len;
+    c->state = CLIENT_OPEN;
+    stat_add(&server->stats.accepted, 1);
+    client_send(server, c, buf_raw(reply, (size_t)n));
+}
+
+// Handles complete frames in c->in; -1 once the client is closed
+static int client_frames(StreamServer_t *server, Client_t *c) {
+    while (c->state == CLIENT_OPEN && c->in_len >= 2) {
+        uint8_t *p = c->in;
+        uint8_t opcode = p[0] & 0x0F;
+        uint64_t len = p[1] & 0x7F;
+        size_t hdr = 2;
+        if (len == 126) {
+            if (c->in_len < 4) {
+                return 0;
+            }
+            len = (uint64_t)p[2] << 8 | p[3];
+            hdr = 4;
+        } else if (len == 127) {
+            if (c->in_len < 10) {
+                return 0;
+            }
+            len = 0;
+            for (int i = 0; i < 8; ++i) {
+                len = len << 8 | p[2 + i];
+            }
+            hdr = 10;
+        }
+        // Clients must mask; and nothing a dashboard sends needs to be large
+        if (!(p[1] & 0x80) || len > sizeof(c->in) - hdr - 4) {
+            client_close_with(server, c, 1002);
+            return c->state == CLIENT_FREE ? -1 : 0;
+        }
+        if (c->in_len < hdr + 4 + len) {
+            return 0;
+        }
+        uint8_t *mask = p + hdr, *payload = p + hdr + 4;
+        for (uint64_t i = 0; i < len; ++i) {
+            payload[i] ^= mask[i & 3];
+        }
+        if (opcode == WS_CLOSE) {
+            client_closing(c);
+            client_drop_unsent(server, c);
+            client_send(server, c, buf_frame(WS_CLOSE, payload, len < 2 ? len : 2));
+        } else if (opcode == WS_PING) {
+            client_send(server, c, buf_frame(WS_PONG, payload, (size_t)len));
+        }
+        if (c->state == CLIENT_FREE) {
+            return -1;
+        }
+        size_t used = hdr + 4 + (size_t)len;
+        memmove(c->in, c->in + used, c->in_len - used);
+        c->in_len -= used;
+    }
+    return 0;
+}
+
+static void client_read(StreamServer_t *server, Client_t *c) {
+    for (;;) {
+        if (c->in_len == sizeof(c->in)) {
+            if (c->state == CLIENT_HANDSHAKE) {
+                stat_add(&server->stats.rejected, 1);
+            }
+            client_close(server, c);
+            return;
+        }
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            client_close(server, c);
+            return;
+        }
+        c->in_len += (size_t)n;
+        if (c->state == CLIENT_HANDSHAKE) {
+            c->in[c->in_len < sizeof(c->in) ? c->in_len : sizeof(c->in) - 1] = '\0';
+            char *end = strstr((char *)c->in, "\r\n\r\n");
+            if (!end) {
+                continue;
+            }
+            handshake(server, c, (size_t)(end + 4 - (char *)c->in));
+            if (c->state == CLIENT_FREE) {
+                return;
+            }
+        }
+        if (c->state == CLIENT_OPEN && client_frames(server, c) != 0) {
+            return;
+        }
+        if (c->state == CLIENT_CLOSING) {
+            c->in_len = 0; // Whatever else it says is ignored
+        }
+    }
+}
+
+static void accept_clients(StreamServer_t *server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        uint32_t slot = 0;
+        while (slot < server->cfg.max_clients && server->clients[slot].state != CLIENT_FREE) {
+            slot++;
+        }
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = slot};
+        if (slot == server->cfg.max_clients || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            stat_add(&server->stats.rejected, 1);
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        Client_t *c = &server->clients[slot];
+        c->fd = fd;
+        c->state = CLIENT_HANDSHAKE;
+        c->deadline_ms = mono_ms() + HANDSHAKE_TIMEOUT_MS;
+        __atomic_store_n(&server->stats.clients, ++server->n_clients, __ATOMIC_RELAXED);
+    }
+}
+
+/* --- Updates --- */
+
+static int latest_grow(StreamServer_t *server) {
+    uint32_t cap = server->latest_cap ? server->latest_cap * 2 : 1024;
+    Latest_t *t = malloc(cap * sizeof(*t));
+
+    if (!t) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < cap; ++i) {
+        t[i].node = EMPTY_NODE;
+    }
+    for (uint32_t i = 0; i < server->latest_cap; ++i) {
+        if (server->latest[i].node == EMPTY_NODE) {
+            continue;
+        }
+        uint32_t h = (uint32_t)Hash_U64(server->latest[i].node) & (cap - 1);
+        while (t[h].node != EMPTY_NODE) {
+            h = (h + 1) & (cap - 1);
+        }
+        t[h] = server->latest[i];
+    }
+    free(server->latest);
+    server->latest = t;
+    server->latest_cap = cap;
+    return 0;
+}
+
+static void latest_put(StreamServer_t *server, const Sample_t *s) {
+    if (s->field >= FIELD_COUNT || ((server->latest_used + 1) * 10 > server->latest_cap * 7 && latest_grow(server) != 0)) {
+        return;
+    }
+    uint32_t h = (uint32_t)Hash_U64(s->node) & (server->latest_cap - 1);
+    while (server->latest[h].node != s->node) {
+        if (server->latest[h].node == EMPTY_NODE) {
+            server->latest[h] = (Latest_t){.node = s->node};
+            server->latest_used++;
+            break;
+        }
+        h = (h + 1) & (server->latest_cap - 1);
+    }
+    Latest_t *l = &server->latest[h];
+    if (!(l->have & (1u << s->field)) || s->ts >= l->ts[s->field]) {
+        l->have |= (uint8_t)(1u << s->field);
+        l->ts[s->field] = s->ts;
+        l->value[s->field] = s->value;
+    }
+}
+
+static char *json_reserve(StreamServer_t *server, size_t need) {
+    if (need > server->json_cap) {
+        char *json = realloc(server->json, need);
+        if (!json) {
+            return NULL;
+        }
+        server->json = json;
+        server->json_cap = need;
+    }
+    return server->json;
+}
+
+static size_t json_sample(char *p, uint32_t node, int64_t ts, uint8_t field, float value, bool first) {
+    return (size_t)snprintf(p, SAMPLE_JSON_MAX, "%s[%u,%lld,\"%s\",%.6g]", first ? "" : ",", node, (long long)ts,
+                            Sample_FieldName((SampleField_t)field), value);
+}
+
+static StreamBuf_t *encode_snapshot(StreamServer_t *server) {
+    char *json = json_reserve(server, 32 + (size_t)server->latest_used * FIELD_COUNT * SAMPLE_JSON_MAX);
+    size_t len = 0;
+    bool first = true;
+
+    if (!json) {
+        return NULL;
+    }
+    len += (size_t)sprintf(json, "{\"snapshot\":[");
+    for (uint32_t i = 0; i < server->latest_cap; ++i) {
+        const Latest_t *l = &server->latest[i];
+        for (uint8_t f = 0; l->node != EMPTY_NODE && f < FIELD_COUNT; ++f) {
+            if (l->have & (1u << f)) {
+                len += json_sample(json + len, l->node, l->ts[f], f, l->value[f], first);
+                first = false;
+            }
+        }
+    }
+    len += (size_t)sprintf(json + len, "]}");
+    return buf_frame(WS_TEXT, json, len);
+}
+
+// Encodes the collected samples once and queues the result for every subscriber
+static void publish(StreamServer_t *server) {
+    uint64_t start = mono_ns();
+    char *json = json_reserve(server, 32 + (size_t)server->batch_len * SAMPLE_JSON_MAX);
+    size_t len = 0;
+
+    if (!json) {
+        server->batch_len = 0;
+        return;
+    }
+    len += (size_t)sprintf(json, "{\"samples\":[");
+    for (uint32_t i = 0; i < server->batch_len; ++i) {
+        const Sample_t *s = &server->batch[i];
+        len += json_sample(json + len, s->node, s->ts, s->field, s->value, i == 0);
+        latest_put(server, s);
+    }
+    len += (size_t)sprintf(json + len, "]}");
+    server->batch_len = 0;
+
+    StreamBuf_t *b = buf_frame(WS_TEXT, json, len);
+    if (!b) {
+        return;
+    }
+    stat_add(&server->stats.updates, 1);
+    stat_add(&server->stats.update_bytes, b->len);
+    bool lagging = false;
+    for (uint32_t i = 0; i < server->cfg.max_clients; ++i) {
+        Client_t *c = &server->clients[i];
+        if (c->state == CLIENT_OPEN) {
+            client_update(server, c, b);
+            lagging |= c->lagging;
+        }
+    }
+    if (b->refs == 0) {
+        free(b);
+    }
+    // One snapshot for everyone who fell behind this round
+    StreamBuf_t *snapshot = lagging ? encode_snapshot(server) : NULL;
+    if (snapshot) {
+        stat_add(&server->stats.snapshots, 1);
+        for (uint32_t i = 0; i < server->cfg.max_clients; ++i) {
+            Client_t *c = &server->clients[i];
+            if (c->state == CLIENT_OPEN && c->lagging && c->q_count < CLIENT_QUEUE) {
+                client_push(server, c, snapshot);
+                c->lagging = false;
+            }
+        }
+        if (snapshot->refs == 0) {
+            free(snapshot);
+        }
+    }
+    // Sockets with room take the update now; the others wait for EPOLLOUT
+    for (uint32_t i = 0; i < server->cfg.max_clients; ++i) {
+        Client_t *c = &server->clients[i];
+        if (c->state >= CLIENT_OPEN && c->q_count > 0 && !c->want_out) {
+            client_flush(server, c);
+        }
+    }
+    Metrics_Observe(server->fanout_ns, mono_ns() - start);
+}
+
+static void drain_ring(StreamServer_t *server) {
+    size_t n;
+
+    while ((n = Queue_Pop(server->ring, server->batch + server->batch_len, server->cfg.max_batch - server->batch_len,
+                          0)) > 0) {
+        if (server->batch_len == 0) {
+            server->batch_opened_ms = mono_ms();
+        }
+        server->batch_len += (uint32_t)n;
+        if (server->batch_len == server->cfg.max_batch) {
+            publish(server);
+        }
+    }
+}
+
+/* --- Thread --- */
+
+// Closes subscribers that never finished their handshake or would not take their close frame
+static void sweep(StreamServer_t *server) {
+    int64_t now = mono_ms();
+
+    if (now < server->next_sweep_ms) {
+        return;
+    }
+    server->next_sweep_ms = now + SWEEP_INTERVAL_MS;
+    for (uint32_t i = 0; i < server->cfg.max_clients; ++i) {
+        Client_t *c = &server->clients[i];
+        if ((c->state == CLIENT_HANDSHAKE || c->state == CLIENT_CLOSING) && now >= c->deadline_ms) {
+            if (c->state == CLIENT_HANDSHAKE) {
+                stat_add(&server->stats.rejected, 1);
+            }
+            client_close(server, c);
+        }
+    }
+}
+
+static void *stream_thread(void *arg) {
+    StreamServer_t *server = arg;
+    struct epoll_event events[EPOLL_EVENTS];
+
+    while (!__atomic_load_n(&server->stop, __ATOMIC_ACQUIRE)) {
+        int timeout = SWEEP_INTERVAL_MS;
+        if (server->batch_len > 0) {
+            int64_t left = server->batch_opened_ms + server->cfg.interval_ms - mono_ms();
+            timeout = left > 0 ? (int)left : 0;
+        }
+        int n = epoll_wait(server->epoll_fd, events, EPOLL_EVENTS, timeout);
+        for (int i = 0; i < n; ++i) {
+            uint32_t id = events[i].data.u32;
+            if (id == EV_WAKE) {
+                uint64_t v;
+                ssize_t r = read(server->wake_fd, &v, sizeof(v));
+                (void)r;
+                continue;
+            }
+            if (id == EV_LISTEN) {
+                accept_clients(server);
+                continue;
+            }
+            Client_t *c = &server->clients[id];
+            if (c->state == CLIENT_FREE) {
+                continue; // Closed earlier in this round
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                client_close(server, c);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                client_read(server, c);
+            }
+            if (c->state != CLIENT_FREE && (events[i].events & EPOLLOUT)) {
+                client_flush(server, c);
+            }
+        }
+        drain_ring(server);
+        if (server->batch_len > 0 && mono_ms() >= server->batch_opened_ms + server->cfg.interval_ms) {
+            publish(server);
+        }
+        sweep(server);
+    }
+    return NULL;
+}
+
+// Ring notify hook: wakes the thread from epoll_wait
+static void wake(void *ctx) {
+    StreamServer_t *server = ctx;
+    uint64_t one = 1;
+    ssize_t n = write(server->wake_fd, &one, sizeof(one));
+    (void)n;
+}
+
+static void collect(void *ctx, FILE *out) {
+    StreamStats_t st;
+
+    StreamServer_GetStats(ctx, &st);
+    Metrics_WriteValue(out, "gateway_stream_updates_total", "Updates encoded", METRIC_COUNTER, (double)st.updates);
+    Metrics_WriteValue(out, "gateway_stream_update_bytes_total", "Bytes of updates encoded", METRIC_COUNTER,
+                       (double)st.update_bytes);
+    Metrics_WriteValue(out, "gateway_stream_sent_bytes_total", "Bytes sent to all subscribers", METRIC_COUNTER,
+                       (double)st.sent_bytes);
+    Metrics_WriteValue(out, "gateway_stream_dropped_samples_total", "Samples dropped with the ring full",
+                       METRIC_COUNTER, (double)st.dropped_samples);
+    Metrics_WriteValue(out, "gateway_stream_coalesced_total", "Slow subscriber backlogs replaced by a snapshot",
+                       METRIC_COUNTER, (double)st.coalesced);
+    Metrics_WriteValue(out, "gateway_stream_dropped_slow_total", "Slow subscribers disconnected", METRIC_COUNTER,
+                       (double)st.dropped_slow);
+    Metrics_WriteValue(out, "gateway_stream_clients", "Connected subscribers", METRIC_GAUGE, st.clients);
+    Metrics_WriteValue(out, "gateway_stream_buffers", "Shared update buffers still queued", METRIC_GAUGE,
+                       st.buffers);
+}
+
+StreamServer_t *StreamServer_Start(const StreamConfig_t *cfg) {
+    if (cfg->max_clients == 0 || cfg->max_clients >= EV_LISTEN || cfg->max_batch == 0 || cfg->ring == 0 ||
+        cfg->max_pending == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    StreamServer_t *server = calloc(1, sizeof(*server));
+    if (!server) {
+        return NULL;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(cfg->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+
+    server->cfg = *cfg;
+    server->fanout_ns = (Metric_t){.slot = -1};
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    server->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->clients = calloc(cfg->max_clients, sizeof(*server->clients));
+    server->batch = malloc(cfg->max_batch * sizeof(*server->batch));
+    if (server->listen_fd < 0 || server->wake_fd < 0 || server->epoll_fd < 0 || !server->clients || !server->batch ||
+        latest_grow(server) != 0) {
+        goto fail;
+    }
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server->listen_fd, 128) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        goto fail;
+    }
+    server->port = ntohs(addr.sin_port);
+
+    QueueConfig_t ring_cfg;
+    Queue_DefaultConfig(&ring_cfg);
+    ring_cfg.name = "stream";
+    ring_cfg.item_size = sizeof(Sample_t);
+    ring_cfg.capacity = cfg->ring;
+    ring_cfg.policy = QUEUE_DROP_NEWEST;
+    ring_cfg.notify = wake;
+    ring_cfg.notify_ctx = server;
+    ring_cfg.metrics = cfg->metrics;
+    if (!(server->ring = Queue_Create(&ring_cfg))) {
+        goto fail;
+    }
+    struct epoll_event wake_ev = {.events = EPOLLIN, .data.u32 = EV_WAKE};
+    struct epoll_event listen_ev = {.events = EPOLLIN, .data.u32 = EV_LISTEN};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &wake_ev) != 0 ||
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &listen_ev) != 0) {
+        goto fail;
+    }
+    if (cfg->metrics) {
+        server->fanout_ns = Metrics_Histogram(cfg->metrics, "gateway_stream_fanout_seconds",
+                                              "Encoding an update and queueing it for every subscriber", 1e-9);
+    }
+    if (pthread_create(&server->thread, NULL, stream_thread, server) != 0) {
+        goto fail;
+    }
+    if (cfg->metrics) {
+        Metrics_AddCollector(cfg->metrics, collect, server);
+    }
+    return server;
+
+fail:
+    Queue_Destroy(server->ring);
+    if (server->epoll_fd >= 0) {
+        close(server->epoll_fd);
+    }
+    if (server->wake_fd >= 0) {
+        close(server->wake_fd);
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    free(server->latest);
+    free(server->batch);
+    free(server->clients);
+    free(server);
+    return NULL;
+}
+
+void StreamServer_Stop(StreamServer_t *server) {
+    if (!server) {
+        return;
+    }
+    if (server->cfg.metrics) {
+        Metrics_RemoveCollector(server->cfg.metrics, collect, server);
+    }
+    __atomic_store_n(&server->stop, 1, __ATOMIC_RELEASE);
+    wake(server);
+    pthread_join(server->thread, NULL);
+
+    for (uint32_t i = 0; i < server->cfg.max_clients; ++i) {
+        if (server->clients[i].state != CLIENT_FREE) {
+            client_close(server, &server->clients[i]);
+        }
+    }
+    Queue_Destroy(server->ring);
+    close(server->epoll_fd);
+    close(server->wake_fd);
+    close(server->listen_fd);
+    free(server->json);
+    free(server->latest);
+    free(server->batch);
+    free(server->clients);
+    free(server);
+}
+
+uint16_t StreamServer_Port(const StreamServer_t *server) {
+    return server->port;
+}
+
+size_t StreamServer_Offer(StreamServer_t *server, const Sample_t *samples, size_t n) {
+    return Queue_Push(server->ring, samples, n, 0);
+}
+
+void StreamServer_Tap(void *ctx, const Sample_t *samples, size_t n) {
+    StreamServer_Offer(ctx, samples, n);
+}
+
+void StreamServer_GetStats(StreamServer_t *server, StreamStats_t *stats) {
+    StreamStats_t *s = &server->stats;
+    QueueStats_t ring;
+
+    Queue_GetStats(server->ring, &ring);
+    stats->offered = ring.pushed + ring.dropped;
+    stats->dropped_samples = ring.dropped;
+    stats->updates = __atomic_load_n(&s->updates, __ATOMIC_RELAXED);
+    stats->update_bytes = __atomic_load_n(&s->update_bytes, __ATOMIC_RELAXED);
+    stats->snapshots = __atomic_load_n(&s->snapshots, __ATOMIC_RELAXED);
+    stats->sent_bytes = __atomic_load_n(&s->sent_bytes, __ATOMIC_RELAXED);
+    stats->accepted = __atomic_load_n(&s->accepted, __ATOMIC_RELAXED);
+    stats->rejected = __atomic_load_n(&s->rejected, __ATOMIC_RELAXED);
+    stats->coalesced = __atomic_load_n(&s->coalesced, __ATOMIC_RELAXED);
+    stats->dropped_slow = __atomic_load_n(&s->dropped_slow, __ATOMIC_RELAXED);
+    stats->clients = __atomic_load_n(&s->clients, __ATOMIC_RELAXED);
+    stats->buffers = __atomic_load_n(&s->buffers, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,431 @@
+#include "query/kernels.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KERNELS_NEON 1
+#endif
+
+/*
+ * Scalar reference
+ */
+
+static double sum_scalar(const float *v, size_t n) {
+    double s = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        s += v[i];
+    }
+    return s;
+}
+
+static void min_max_scalar(const float *v, size_t n, float *min, float *max) {
+    float lo = v[0], hi = v[0];
+    for (size_t i = 1; i < n; ++i) {
+        lo = v[i] < lo ? v[i] : lo;
+        hi = v[i] > hi ? v[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static size_t count_above_scalar(const float *v, size_t n, float threshold) {
+    size_t c = 0;
+    for (size_t i = 0; i < n; ++i) {
+        c += v[i] > threshold;
+    }
+    return c;
+}
+
+// Same float operations as the SIMD versions so bin edges agree exactly
+static inline uint32_t bin_index(float x, float lo, float inv_width, float top) {
+    float f = (x - lo) * inv_width;
+    f = f < 0.0f ? 0.0f : f;
+    f = f > top ? top : f;
+    return (uint32_t)f;
+}
+
+static void histogram_scalar(const float *v, size_t n, float lo, float width, uint32_t *bins, uint32_t n_bins) {
+    float inv = 1.0f / width;
+    float top = (float)(n_bins - 1);
+    for (size_t i = 0; i < n; ++i) {
+        bins[bin_index(v[i], lo, inv, top)]++;
+    }
+}
+
+/*
+ * Neighbouring samples usually land in the same bin, so SIMD lanes spread
+ * their increments over separate copies to avoid a store-to-load chain on
+ * one counter. Copies are folded into the caller's bins at the end.
+ */
+#define HIST_COPIES 4
+#define HIST_MAX_SPREAD_BINS 256
+
+typedef struct {
+    uint32_t counts[HIST_COPIES][HIST_MAX_SPREAD_BINS];
+} HistSpread_t;
+
+static inline void hist_spread_fold(const HistSpread_t *h, uint32_t *bins, uint32_t n_bins) {
+    for (uint32_t b = 0; b < n_bins; ++b) {
+        bins[b] += h->counts[0][b] + h->counts[1][b] + h->counts[2][b] + h->counts[3][b];
+    }
+}
+
+static const AggKernels_t kernels_scalar = {
+    .name = "scalar",
+    .sum = sum_scalar,
+    .min_max = min_max_scalar,
+    .count_above = count_above_scalar,
+    .histogram = histogram_scalar,
+};
+
+/*
+ * x86: SSE2 is baseline on x86-64, AVX2 is compiled per function and only
+ * called after the CPU reports it.
+ */
+
+#ifdef KERNELS_X86
+
+static double sum_sse2(const float *v, size_t n) {
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(v + i);
+        a0 = _mm_add_pd(a0, _mm_cvtps_pd(x));
+        a1 = _mm_add_pd(a1, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(a0, a1));
+    return lanes[0] + lanes[1] + sum_scalar(v + i, n - i);
+}
+
+static void min_max_sse2(const float *v, size_t n, float *min, float *max) {
+    if (n < 4) {
+        min_max_scalar(v, n, min, max);
+        return;
+    }
+    __m128 lo = _mm_loadu_ps(v), hi = lo;
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(v + i);
+        lo = _mm_min_ps(lo, x);
+        hi = _mm_max_ps(hi, x);
+    }
+    float l[4], h[4];
+    _mm_storeu_ps(l, lo);
+    _mm_storeu_ps(h, hi);
+    for (int k = 1; k < 4; ++k) {
+        l[0] = l[k] < l[0] ? l[k] : l[0];
+        h[0] = h[k] > h[0] ? h[k] : h[0];
+    }
+    for (; i < n; ++i) {
+        l[0] = v[i] < l[0] ? v[i] : l[0];
+        h[0] = v[i] > h[0] ? v[i] : h[0];
+    }
+    *min = l[0];
+    *max = h[0];
+}
+
+static size_t count_above_sse2(const float *v, size_t n, float threshold) {
+    __m128 t = _mm_set1_ps(threshold);
+    __m128i acc = _mm_setzero_si128();
+    size_t c = 0, i = 0;
+    while (i + 4 <= n) {
+        // Lanes count down by one per match; flush before 32-bit lanes could wrap
+        size_t stop = n - i > (1u << 30) ? i + (1u << 30) : n;
+        for (; i + 4 <= stop; i += 4) {
+            acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(v + i), t)));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        c += (size_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        acc = _mm_setzero_si128();
+    }
+    return c + count_above_scalar(v + i, n - i, threshold);
+}
+
+static void histogram_sse2(const float *v, size_t n, float lo, float width, uint32_t *bins, uint32_t n_bins) {
+    __m128 vlo = _mm_set1_ps(lo), inv = _mm_set1_ps(1.0f / width);
+    __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps((float)(n_bins - 1));
+    HistSpread_t h;
+    uint32_t idx[4];
+    size_t i = 0;
+
+    if (n_bins > HIST_MAX_SPREAD_BINS) {
+        histogram_scalar(v, n, lo, width, bins, n_bins);
+        return;
+    }
+    memset(&h, 0, sizeof(h));
+    for (; i + 4 <= n; i += 4) {
+        __m128 f = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(v + i), vlo), inv);
+        f = _mm_min_ps(_mm_max_ps(f, zero), top);
+        _mm_storeu_si128((__m128i *)idx, _mm_cvttps_epi32(f));
+        h.counts[0][idx[0]]++;
+        h.counts[1][idx[1]]++;
+        h.counts[2][idx[2]]++;
+        h.counts[3][idx[3]]++;
+    }
+    hist_spread_fold(&h, bins, n_bins);
+    histogram_scalar(v + i, n - i, lo, width, bins, n_bins);
+}
+
+static const AggKernels_t kernels_sse2 = {
+    .name = "sse2",
+    .sum = sum_sse2,
+    .min_max = min_max_sse2,
+    .count_above = count_above_sse2,
+    .histogram = histogram_sse2,
+};
+
+__attribute__((target("avx2"))) static double sum_avx2(const float *v, size_t n) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(v + i);
+        a0 = _mm256_add_pd(a0, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+        a1 = _mm256_add_pd(a1, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(a0, a1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_scalar(v + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void min_max_avx2(const float *v, size_t n, float *min, float *max) {
+    if (n < 8) {
+        min_max_scalar(v, n, min, max);
+        return;
+    }
+    __m256 lo = _mm256_loadu_ps(v), hi = lo;
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(v + i);
+        lo = _mm256_min_ps(lo, x);
+        hi = _mm256_max_ps(hi, x);
+    }
+    float l[8], h[8];
+    _mm256_storeu_ps(l, lo);
+    _mm256_storeu_ps(h, hi);
+    for (int k = 1; k < 8; ++k) {
+        l[0] = l[k] < l[0] ? l[k] : l[0];
+        h[0] = h[k] > h[0] ? h[k] : h[0];
+    }
+    for (; i < n; ++i) {
+        l[0] = v[i] < l[0] ? v[i] : l[0];
+        h[0] = v[i] > h[0] ? v[i] : h[0];
+    }
+    *min = l[0];
+    *max = h[0];
+}
+
+__attribute__((target("avx2"))) static size_t count_above_avx2(const float *v, size_t n, float threshold) {
+    __m256 t = _mm256_set1_ps(threshold);
+    size_t c = 0, i = 0;
+    while (i + 8 <= n) {
+        __m256i acc = _mm256_setzero_si256();
+        size_t stop = n - i > (1u << 30) ? i + (1u << 30) : n;
+        for (; i + 8 <= stop; i += 8) {
+            __m256 m = _mm256_cmp_ps(_mm256_loadu_ps(v + i), t, _CMP_GT_OQ);
+            acc = _mm256_sub_epi32(acc, _mm256_castps_si256(m));
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, acc);
+        for (int k = 0; k < 8; ++k) {
+            c += lanes[k];
+        }
+    }
+    return c + count_above_scalar(v + i, n - i, threshold);
+}
+
+__attribute__((target("avx2"))) static void histogram_avx2(const float *v, size_t n, float lo, float width,
+                                                           uint32_t *bins, uint32_t n_bins) {
+    __m256 vlo = _mm256_set1_ps(lo), inv = _mm256_set1_ps(1.0f / width);
+    __m256 zero = _mm256_setzero_ps(), top = _mm256_set1_ps((float)(n_bins - 1));
+    HistSpread_t h;
+    uint32_t idx[8];
+    size_t i = 0;
+
+    if (n_bins > HIST_MAX_SPREAD_BINS) {
+        histogram_scalar(v, n, lo, width, bins, n_bins);
+        return;
+    }
+    memset(&h, 0, sizeof(h));
+    for (; i + 8 <= n; i += 8) {
+        __m256 f = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(v + i), vlo), inv);
+        f = _mm256_min_ps(_mm256_max_ps(f, zero), top);
+        _mm256_storeu_si256((__m256i *)idx, _mm256_cvttps_epi32(f));
+        h.counts[0][idx[0]]++;
+        h.counts[1][idx[1]]++;
+        h.counts[2][idx[2]]++;
+        h.counts[3][idx[3]]++;
+        h.counts[0][idx[4]]++;
+        h.counts[1][idx[5]]++;
+        h.counts[2][idx[6]]++;
+        h.counts[3][idx[7]]++;
+    }
+    hist_spread_fold(&h, bins, n_bins);
+    histogram_scalar(v + i, n - i, lo, width, bins, n_bins);
+}
+
+static const AggKernels_t kernels_avx2 = {
+    .name = "avx2",
+    .sum = sum_avx2,
+    .min_max = min_max_avx2,
+    .count_above = count_above_avx2,
+    .histogram = histogram_avx2,
+};
+
+#endif // KERNELS_X86
+
+/*
+ * NEON: mandatory on AArch64 (Pi 3/4/5 running a 64-bit OS)
+ */
+
+#ifdef KERNELS_NEON
+
+static double sum_neon(const float *v, size_t n) {
+#if defined(__aarch64__)
+    float64x2_t a0 = vdupq_n_f64(0.0), a1 = vdupq_n_f64(0.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vld1q_f32(v + i);
+        a0 = vaddq_f64(a0, vcvt_f64_f32(vget_low_f32(x)));
+        a1 = vaddq_f64(a1, vcvt_high_f64_f32(x));
+    }
+    return vaddvq_f64(vaddq_f64(a0, a1)) + sum_scalar(v + i, n - i);
+#else
+    return sum_scalar(v, n);
+#endif
+}
+
+static void min_max_neon(const float *v, size_t n, float *min, float *max) {
+    if (n < 4) {
+        min_max_scalar(v, n, min, max);
+        return;
+    }
+    float32x4_t lo = vld1q_f32(v), hi = lo;
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vld1q_f32(v + i);
+        lo = vminq_f32(lo, x);
+        hi = vmaxq_f32(hi, x);
+    }
+    float l[4], h[4];
+    vst1q_f32(l, lo);
+    vst1q_f32(h, hi);
+    for (int k = 1; k < 4; ++k) {
+        l[0] = l[k] < l[0] ? l[k] : l[0];
+        h[0] = h[k] > h[0] ? h[k] : h[0];
+    }
+    for (; i < n; ++i) {
+        l[0] = v[i] < l[0] ? v[i] : l[0];
+        h[0] = v[i] > h[0] ? v[i] : h[0];
+    }
+    *min = l[0];
+    *max = h[0];
+}
+
+static size_t count_above_neon(const float *v, size_t n, float threshold) {
+    float32x4_t t = vdupq_n_f32(threshold);
+    size_t c = 0, i = 0;
+    while (i + 4 <= n) {
+        uint32x4_t acc = vdupq_n_u32(0);
+        size_t stop = n - i > (1u << 30) ? i + (1u << 30) : n;
+        for (; i + 4 <= stop; i += 4) {
+            acc = vsubq_u32(acc, vcgtq_f32(vld1q_f32(v + i), t));
+        }
+        uint32_t lanes[4];
+        vst1q_u32(lanes, acc);
+        c += (size_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return c + count_above_scalar(v + i, n - i, threshold);
+}
+
+static void histogram_neon(const float *v, size_t n, float lo, float width, uint32_t *bins, uint32_t n_bins) {
+    float32x4_t vlo = vdupq_n_f32(lo), inv = vdupq_n_f32(1.0f / width);
+    float32x4_t zero = vdupq_n_f32(0.0f), top = vdupq_n_f32((float)(n_bins - 1));
+    HistSpread_t h;
+    uint32_t idx[4];
+    size_t i = 0;
+
+    if (n_bins > HIST_MAX_SPREAD_BINS) {
+        histogram_scalar(v, n, lo, width, bins, n_bins);
+        return;
+    }
+    memset(&h, 0, sizeof(h));
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t f = vmulq_f32(vsubq_f32(vld1q_f32(v + i), vlo), inv);
+        f = vminq_f32(vmaxq_f32(f, zero), top);
+        vst1q_u32(idx, vcvtq_u32_f32(f));
+        h.counts[0][idx[0]]++;
+        h.counts[1][idx[1]]++;
+        h.counts[2][idx[2]]++;
+        h.counts[3][idx[3]]++;
+    }
+    hist_spread_fold(&h, bins, n_bins);
+    histogram_scalar(v + i, n - i, lo, width, bins, n_bins);
+}
+
+static const AggKernels_t kernels_neon = {
+    .name = "neon",
+    .sum = sum_neon,
+    .min_max = min_max_neon,
+    .count_above = count_above_neon,
+    .histogram = histogram_neon,
+};
+
+#endif // KERNELS_NEON
+
+static const AggKernels_t *selected = &kernels_scalar;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+const AggKernels_t *AggKernels_ByName(const char *name) {
+    if (strcmp(name, "scalar") == 0) {
+        return &kernels_scalar;
+    }
+#ifdef KERNELS_X86
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        return &kernels_sse2;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return &kernels_avx2;
+    }
+#endif
+#ifdef KERNELS_NEON
+    if (strcmp(name, "neon") == 0) {
+        return &kernels_neon;
+    }
+#endif
+    return NULL;
+}
+
+static void select_kernels(void) {
+    static const char *const preference[] = {"avx2", "neon", "sse2"};
+    const char *forced = getenv("GATEWAY_KERNELS");
+
+    if (forced && AggKernels_ByName(forced)) {
+        selected = AggKernels_ByName(forced);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); ++i) {
+        if (AggKernels_ByName(preference[i])) {
+            selected = AggKernels_ByName(preference[i]);
+            return;
+        }
+    }
+}
+
+const AggKernels_t *AggKernels_Get(void) {
+    pthread_once(&select_once, select_kernels);
+    return selected;
+}
+
+const AggKernels_t *AggKernels_Scalar(void) {
+    return &kernels_scalar;
+}
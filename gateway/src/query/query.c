@@ -0,0 +1,451 @@
+#include "query/query.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "query/kernels.h"
+
+typedef struct {
+    int64_t ts;
+    float value;
+} QueryPoint_t;
+
+// In-range part of one chunk (sorted) or of the unsealed head (unsorted)
+typedef int (*SliceFn)(const int64_t *ts, const float *values, uint32_t n, bool sorted, void *ctx);
+// Return true if the chunk was fully accounted for from its zone map alone
+typedef bool (*ZoneFn)(const ChunkRef_t *ref, bool inside, void *ctx);
+
+struct QueryEngine {
+    SeriesStore_t *store;
+    RollupEngine_t *rollup;
+    const AggKernels_t *kernels;
+    SeriesSnapshot_t snap;
+    uint8_t *payload;
+    int64_t *ts;
+    float *values;
+    SeriesBucket_t *decoded;
+    QueryPoint_t *points;
+    uint32_t n_points;
+    uint32_t cap_points;
+    SeriesBucket_t *buckets;
+    uint32_t n_buckets;
+    uint32_t cap_buckets;
+    QueryStats_t stats;
+};
+
+QueryEngine_t *Query_Create(SeriesStore_t *store, RollupEngine_t *rollup) {
+    QueryEngine_t *q = calloc(1, sizeof(*q));
+
+    if (!q) {
+        return NULL;
+    }
+    q->store = store;
+    q->rollup = rollup;
+    q->kernels = AggKernels_Get();
+    q->payload = malloc(Chunk_RollupSize(CHUNK_MAX_RECORDS));
+    q->ts = malloc(CHUNK_MAX_RECORDS * sizeof(int64_t));
+    q->values = malloc(CHUNK_MAX_RECORDS * sizeof(float));
+    q->decoded = malloc(CHUNK_MAX_RECORDS * sizeof(SeriesBucket_t));
+    if (!q->payload || !q->ts || !q->values || !q->decoded) {
+        Query_Destroy(q);
+        return NULL;
+    }
+    return q;
+}
+
+void Query_Destroy(QueryEngine_t *q) {
+    if (!q) {
+        return;
+    }
+    SeriesSnapshot_Free(&q->snap);
+    free(q->payload);
+    free(q->ts);
+    free(q->values);
+    free(q->decoded);
+    free(q->points);
+    free(q->buckets);
+    free(q);
+}
+
+static bool filter_prunes(const QueryFilter_t *filter, float lo, float hi) {
+    return filter && filter->enabled && (hi < filter->min || lo > filter->max);
+}
+
+static int push_point(QueryEngine_t *q, int64_t ts, float value) {
+    if (q->n_points == q->cap_points) {
+        uint32_t cap = q->cap_points ? q->cap_points * 2 : 1024;
+        QueryPoint_t *p = realloc(q->points, cap * sizeof(*p));
+        if (!p) {
+            return -1;
+        }
+        q->points = p;
+        q->cap_points = cap;
+    }
+    q->points[q->n_points++] = (QueryPoint_t){.ts = ts, .value = value};
+    return 0;
+}
+
+static int push_bucket(QueryEngine_t *q, const SeriesBucket_t *b) {
+    if (q->n_buckets == q->cap_buckets) {
+        uint32_t cap = q->cap_buckets ? q->cap_buckets * 2 : 256;
+        SeriesBucket_t *p = realloc(q->buckets, cap * sizeof(*p));
+        if (!p) {
+            return -1;
+        }
+        q->buckets = p;
+        q->cap_buckets = cap;
+    }
+    q->buckets[q->n_buckets++] = *b;
+    return 0;
+}
+
+// Raw samples of [from, to) into q->points, unsorted
+static int collect_points(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to,
+                          const QueryFilter_t *filter) {
+    bool filtered = filter && filter->enabled;
+
+    q->n_points = 0;
+    SeriesSnapshot_Reset(&q->snap);
+    if (SeriesStore_Snapshot(q->store, Series_Key(node, field, SERIES_RES_RAW), from, to, &q->snap) != 0) {
+        return -1;
+    }
+    for (uint32_t c = 0; c < q->snap.chunks.count; ++c) {
+        const ChunkRef_t *ref = &q->snap.chunks.refs[c];
+        ChunkHeader_t hdr;
+
+        if (filter_prunes(filter, ref->v_min, ref->v_max)) {
+            q->stats.chunks_pruned++;
+            continue;
+        }
+        if (SeriesStore_ReadChunk(q->store, &ref->loc, &hdr, q->payload, Chunk_RawSize(CHUNK_MAX_RECORDS)) != 0 ||
+            Chunk_DecodeRaw(&hdr, q->payload, q->ts, q->values) != 0) {
+            return -1;
+        }
+        q->stats.chunks_read++;
+        q->stats.records_scanned += hdr.count;
+        for (uint32_t i = 0; i < hdr.count; ++i) {
+            if (q->ts[i] < from || q->ts[i] >= to) {
+                continue;
+            }
+            if (filtered && (q->values[i] < filter->min || q->values[i] > filter->max)) {
+                continue;
+            }
+            if (push_point(q, q->ts[i], q->values[i]) != 0) {
+                return -1;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < q->snap.n_raw; ++i) {
+        if (filtered && (q->snap.values[i] < filter->min || q->snap.values[i] > filter->max)) {
+            continue;
+        }
+        if (push_point(q, q->snap.ts[i], q->snap.values[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Rollup buckets with start in [from, to) into q->buckets, unsorted and unmerged
+static int collect_buckets(QueryEngine_t *q, uint32_t node, uint8_t field, uint8_t res, int64_t from, int64_t to,
+                           const QueryFilter_t *filter) {
+    int rc;
+
+    q->n_buckets = 0;
+    SeriesSnapshot_Reset(&q->snap);
+    if (q->rollup) {
+        rc = Rollup_Snapshot(q->rollup, node, field, res, from, to, &q->snap);
+    } else {
+        rc = SeriesStore_Snapshot(q->store, Series_Key(node, field, res), from, to, &q->snap);
+    }
+    if (rc != 0) {
+        return -1;
+    }
+    for (uint32_t c = 0; c < q->snap.chunks.count; ++c) {
+        const ChunkRef_t *ref = &q->snap.chunks.refs[c];
+        ChunkHeader_t hdr;
+
+        if (filter_prunes(filter, ref->v_min, ref->v_max)) {
+            q->stats.chunks_pruned++;
+            continue;
+        }
+        if (SeriesStore_ReadChunk(q->store, &ref->loc, &hdr, q->payload, Chunk_RollupSize(CHUNK_MAX_RECORDS)) != 0 ||
+            Chunk_DecodeRollup(&hdr, q->payload, q->decoded) != 0) {
+            return -1;
+        }
+        q->stats.chunks_read++;
+        q->stats.records_scanned += hdr.count;
+        for (uint32_t i = 0; i < hdr.count; ++i) {
+            if (q->decoded[i].start >= from && q->decoded[i].start < to && push_bucket(q, &q->decoded[i]) != 0) {
+                return -1;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < q->snap.n_buckets; ++i) {
+        if (push_bucket(q, &q->snap.buckets[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int cmp_point(const void *a, const void *b) {
+    int64_t x = ((const QueryPoint_t *)a)->ts, y = ((const QueryPoint_t *)b)->ts;
+    return (x > y) - (x < y);
+}
+
+static int cmp_bucket(const void *a, const void *b) {
+    int64_t x = ((const SeriesBucket_t *)a)->start, y = ((const SeriesBucket_t *)b)->start;
+    return (x > y) - (x < y);
+}
+
+int Query_Range(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to,
+                const QueryFilter_t *filter, Query_PointFn fn, void *ctx) {
+    if (collect_points(q, node, field, from, to, filter) != 0) {
+        return -1;
+    }
+    qsort(q->points, q->n_points, sizeof(*q->points), cmp_point);
+    for (uint32_t i = 0; i < q->n_points; ++i) {
+        int rc = fn(q->points[i].ts, q->points[i].value, ctx);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+int Query_RangeBuckets(QueryEngine_t *q, uint32_t node, uint8_t field, uint8_t res, int64_t from, int64_t to,
+                       const QueryFilter_t *filter, Query_BucketFn fn, void *ctx) {
+    if (res == SERIES_RES_RAW || res >= SERIES_RES_COUNT ||
+        collect_buckets(q, node, field, res, from, to, filter) != 0) {
+        return -1;
+    }
+    qsort(q->buckets, q->n_buckets, sizeof(*q->buckets), cmp_bucket);
+
+    // Correction buckets share a start with the bucket they amend
+    uint32_t i = 0;
+    while (i < q->n_buckets) {
+        SeriesBucket_t merged = q->buckets[i++];
+        while (i < q->n_buckets && q->buckets[i].start == merged.start) {
+            SeriesBucket_Merge(&merged, &q->buckets[i++]);
+        }
+        if (filter_prunes(filter, merged.min, merged.max)) {
+            continue;
+        }
+        int rc = fn(&merged, ctx);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+static uint32_t lower_bound(const int64_t *ts, uint32_t n, int64_t key) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ts[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int scan_raw(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to, ZoneFn zone,
+                    SliceFn fn, void *ctx) {
+    SeriesSnapshot_Reset(&q->snap);
+    if (SeriesStore_Snapshot(q->store, Series_Key(node, field, SERIES_RES_RAW), from, to, &q->snap) != 0) {
+        return -1;
+    }
+    for (uint32_t c = 0; c < q->snap.chunks.count; ++c) {
+        const ChunkRef_t *ref = &q->snap.chunks.refs[c];
+        ChunkHeader_t hdr;
+
+        if (zone && zone(ref, ref->t_min >= from && ref->t_max < to, ctx)) {
+            q->stats.chunks_pruned++;
+            continue;
+        }
+        if (SeriesStore_ReadChunk(q->store, &ref->loc, &hdr, q->payload, Chunk_RawSize(CHUNK_MAX_RECORDS)) != 0 ||
+            Chunk_DecodeRaw(&hdr, q->payload, q->ts, q->values) != 0) {
+            return -1;
+        }
+        q->stats.chunks_read++;
+        q->stats.records_scanned += hdr.count;
+        uint32_t lo = lower_bound(q->ts, hdr.count, from);
+        uint32_t hi = lower_bound(q->ts, hdr.count, to);
+        if (hi > lo && fn(q->ts + lo, q->values + lo, hi - lo, true, ctx) != 0) {
+            return -1;
+        }
+    }
+    if (q->snap.n_raw > 0) {
+        return fn(q->snap.ts, q->snap.values, q->snap.n_raw, false, ctx);
+    }
+    return 0;
+}
+
+typedef struct {
+    const AggKernels_t *kernels;
+    SeriesBucket_t *out;
+} AggregateCtx_t;
+
+static int aggregate_slice(const int64_t *ts, const float *values, uint32_t n, bool sorted, void *arg) {
+    AggregateCtx_t *ctx = arg;
+    SeriesBucket_t b = {.start = ctx->out->start, .count = n};
+
+    b.sum = ctx->kernels->sum(values, n);
+    ctx->kernels->min_max(values, n, &b.min, &b.max);
+    if (sorted) {
+        b.last_ts = ts[n - 1];
+        b.last = values[n - 1];
+    } else {
+        b.last_ts = INT64_MIN;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (ts[i] >= b.last_ts) {
+                b.last_ts = ts[i];
+                b.last = values[i];
+            }
+        }
+    }
+    SeriesBucket_Merge(ctx->out, &b);
+    return 0;
+}
+
+static int aggregate_level(QueryEngine_t *q, uint32_t node, uint8_t field, uint8_t res, int64_t from, int64_t to,
+                           SeriesBucket_t *out) {
+    if (from >= to) {
+        return 0;
+    }
+    if (res == SERIES_RES_RAW) {
+        AggregateCtx_t ctx = {.kernels = q->kernels, .out = out};
+        return scan_raw(q, node, field, from, to, NULL, aggregate_slice, &ctx);
+    }
+
+    int64_t width = Series_ResolutionMs(res);
+    int64_t lo = Series_BucketStart(from + width - 1, width);
+    int64_t hi = Series_BucketStart(to, width);
+    if (lo >= hi) {
+        return aggregate_level(q, node, field, res - 1, from, to, out);
+    }
+    if (collect_buckets(q, node, field, res, lo, hi, NULL) != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < q->n_buckets; ++i) {
+        SeriesBucket_Merge(out, &q->buckets[i]);
+    }
+    if (aggregate_level(q, node, field, res - 1, from, lo, out) != 0) {
+        return -1;
+    }
+    return aggregate_level(q, node, field, res - 1, hi, to, out);
+}
+
+int Query_Aggregate(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to,
+                    SeriesBucket_t *out) {
+    SeriesBucket_Init(out, from);
+    return aggregate_level(q, node, field, SERIES_RES_1D, from, to, out);
+}
+
+typedef struct {
+    const AggKernels_t *kernels;
+    float threshold;
+    uint64_t count;
+} CountCtx_t;
+
+static bool count_zone(const ChunkRef_t *ref, bool inside, void *arg) {
+    CountCtx_t *ctx = arg;
+
+    if (ref->v_max <= ctx->threshold) {
+        return true;
+    }
+    if (inside && ref->v_min > ctx->threshold) {
+        ctx->count += ref->count;
+        return true;
+    }
+    return false;
+}
+
+static int count_slice(const int64_t *ts, const float *values, uint32_t n, bool sorted, void *arg) {
+    CountCtx_t *ctx = arg;
+    (void)ts;
+    (void)sorted;
+    ctx->count += ctx->kernels->count_above(values, n, ctx->threshold);
+    return 0;
+}
+
+int Query_CountAbove(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to, float threshold,
+                     uint64_t *count) {
+    CountCtx_t ctx = {.kernels = q->kernels, .threshold = threshold};
+
+    if (scan_raw(q, node, field, from, to, count_zone, count_slice, &ctx) != 0) {
+        return -1;
+    }
+    *count = ctx.count;
+    return 0;
+}
+
+typedef struct {
+    const AggKernels_t *kernels;
+    float lo;
+    float width;
+    uint32_t *bins;
+    uint32_t n_bins;
+} HistogramCtx_t;
+
+static int histogram_slice(const int64_t *ts, const float *values, uint32_t n, bool sorted, void *arg) {
+    HistogramCtx_t *ctx = arg;
+    (void)ts;
+    (void)sorted;
+    ctx->kernels->histogram(values, n, ctx->lo, ctx->width, ctx->bins, ctx->n_bins);
+    return 0;
+}
+
+int Query_Histogram(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t from, int64_t to, float lo, float width,
+                    uint32_t *bins, uint32_t n_bins) {
+    HistogramCtx_t ctx = {.kernels = q->kernels, .lo = lo, .width = width, .bins = bins, .n_bins = n_bins};
+
+    if (n_bins == 0 || !(width > 0.0f)) {
+        return -1;
+    }
+    return scan_raw(q, node, field, from, to, NULL, histogram_slice, &ctx);
+}
+
+int Query_Latest(QueryEngine_t *q, uint32_t node, uint8_t field, int64_t *ts, float *value) {
+    bool found = false;
+
+    SeriesSnapshot_Reset(&q->snap);
+    if (SeriesStore_SnapshotLatest(q->store, Series_Key(node, field, SERIES_RES_RAW), &q->snap) != 0) {
+        return -1;
+    }
+    for (uint32_t c = 0; c < q->snap.chunks.count; ++c) {
+        ChunkHeader_t hdr;
+
+        if (SeriesStore_ReadChunk(q->store, &q->snap.chunks.refs[c].loc, &hdr, q->payload,
+                                  Chunk_RawSize(CHUNK_MAX_RECORDS)) != 0 ||
+            Chunk_DecodeRaw(&hdr, q->payload, q->ts, q->values) != 0) {
+            return -1;
+        }
+        q->stats.chunks_read++;
+        if (hdr.count > 0 && (!found || q->ts[hdr.count - 1] >= *ts)) {
+            *ts = q->ts[hdr.count - 1];
+            *value = q->values[hdr.count - 1];
+            found = true;
+        }
+    }
+    for (uint32_t i = 0; i < q->snap.n_raw; ++i) {
+        if (!found || q->snap.ts[i] >= *ts) {
+            *ts = q->snap.ts[i];
+            *value = q->snap.values[i];
+            found = true;
+        }
+    }
+    return found ? 1 : 0;
+}
+
+void Query_GetStats(const QueryEngine_t *q, QueryStats_t *stats) {
+    *stats = q->stats;
+}
+
+void Query_ResetStats(QueryEngine_t *q) {
+    memset(&q->stats, 0, sizeof(q->stats));
+}
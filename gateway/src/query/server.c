@@ -0,0 +1,332 @@
+#include "query/server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common/sample.h"
+#include "query/query.h"
+
+typedef struct {
+    int fd;
+    size_t len;
+    char buf[QUERY_SERVER_MAX_LINE];
+} QueryClient_t;
+
+struct QueryServer {
+    int listen_fd;
+    int wake[2];
+    char *path;
+    pthread_t thread;
+    QueryEngine_t *engine;
+    QueryClient_t clients[QUERY_SERVER_MAX_CLIENTS];
+    int n_clients;
+};
+
+typedef struct {
+    FILE *out;
+    uint32_t lines;
+} ResultSink_t;
+
+static int emit_point(int64_t ts, float value, void *ctx) {
+    ResultSink_t *sink = ctx;
+    fprintf(sink->out, "%" PRId64 " %.3f\n", ts, value);
+    sink->lines++;
+    return 0;
+}
+
+static int emit_bucket(const SeriesBucket_t *b, void *ctx) {
+    ResultSink_t *sink = ctx;
+    fprintf(sink->out, "%" PRId64 " %u %.3f %.3f %.3f %.3f\n", b->start, b->count, b->min, b->max,
+            SeriesBucket_Mean(b), b->last);
+    sink->lines++;
+    return 0;
+}
+
+static int parse_field(const char *s) {
+    char *end;
+    long v = strtol(s, &end, 10);
+
+    if (*end == '\0') {
+        return v >= 0 && v < FIELD_COUNT ? (int)v : -1;
+    }
+    return Sample_FieldFromName(s);
+}
+
+// Runs one request into sink; returns an error status line or NULL on success
+static const char *execute(QueryEngine_t *engine, char *line, ResultSink_t *sink) {
+    char *argv[9];
+    int argc = 0;
+
+    for (char *tok = strtok(line, " \t\r"); tok && argc < 9; tok = strtok(NULL, " \t\r")) {
+        argv[argc++] = tok;
+    }
+    if (argc < 3) {
+        return "ERR expected <command> <node> <field> ...";
+    }
+    uint32_t node = (uint32_t)strtoul(argv[1], NULL, 0);
+    int field = parse_field(argv[2]);
+    if (field < 0) {
+        return "ERR unknown field";
+    }
+
+    if (strcmp(argv[0], "LATEST") == 0) {
+        int64_t ts;
+        float value;
+        int rc = Query_Latest(engine, node, (uint8_t)field, &ts, &value);
+        if (rc < 0) {
+            return "ERR storage";
+        }
+        if (rc > 0) {
+            emit_point(ts, value, sink);
+        }
+        return NULL;
+    }
+    if (strcmp(argv[0], "AGG") == 0 && argc == 5) {
+        SeriesBucket_t b;
+        if (Query_Aggregate(engine, node, (uint8_t)field, strtoll(argv[3], NULL, 10), strtoll(argv[4], NULL, 10),
+                            &b) != 0) {
+            return "ERR storage";
+        }
+        fprintf(sink->out, "%u %.3f %.3f %.3f %" PRId64 " %.3f\n", b.count, b.min, b.max, SeriesBucket_Mean(&b),
+                b.count ? b.last_ts : 0, b.last);
+        sink->lines++;
+        return NULL;
+    }
+    if (strcmp(argv[0], "ABOVE") == 0 && argc == 6) {
+        uint64_t count;
+        if (Query_CountAbove(engine, node, (uint8_t)field, strtoll(argv[3], NULL, 10), strtoll(argv[4], NULL, 10),
+                             strtof(argv[5], NULL), &count) != 0) {
+            return "ERR storage";
+        }
+        fprintf(sink->out, "%" PRIu64 "\n", count);
+        sink->lines++;
+        return NULL;
+    }
+    if (strcmp(argv[0], "HIST") == 0 && argc == 8) {
+        uint32_t bins[QUERY_SERVER_MAX_BINS] = {0};
+        float lo = strtof(argv[5], NULL);
+        float width = strtof(argv[6], NULL);
+        long n_bins = strtol(argv[7], NULL, 10);
+        if (n_bins <= 0 || n_bins > QUERY_SERVER_MAX_BINS || !(width > 0.0f)) {
+            return "ERR bad histogram shape";
+        }
+        if (Query_Histogram(engine, node, (uint8_t)field, strtoll(argv[3], NULL, 10), strtoll(argv[4], NULL, 10), lo,
+                            width, bins, (uint32_t)n_bins) != 0) {
+            return "ERR storage";
+        }
+        for (long i = 0; i < n_bins; ++i) {
+            fprintf(sink->out, "%.3f %u\n", lo + (float)i * width, bins[i]);
+            sink->lines++;
+        }
+        return NULL;
+    }
+    if (strcmp(argv[0], "RANGE") == 0 && (argc == 6 || argc == 8)) {
+        int res = Series_ResolutionFromName(argv[3]);
+        int64_t from = strtoll(argv[4], NULL, 10);
+        int64_t to = strtoll(argv[5], NULL, 10);
+        QueryFilter_t filter = {.enabled = argc == 8};
+        int rc;
+
+        if (res < 0) {
+            return "ERR unknown resolution";
+        }
+        if (filter.enabled) {
+            filter.min = strtof(argv[6], NULL);
+            filter.max = strtof(argv[7], NULL);
+        }
+        if (res == SERIES_RES_RAW) {
+            rc = Query_Range(engine, node, (uint8_t)field, from, to, &filter, emit_point, sink);
+        } else {
+            rc = Query_RangeBuckets(engine, node, (uint8_t)field, (uint8_t)res, from, to, &filter, emit_bucket, sink);
+        }
+        return rc == 0 ? NULL : "ERR storage";
+    }
+    return "ERR unknown command";
+}
+
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EAGAIN) {
+            struct pollfd p = {.fd = fd, .events = POLLOUT};
+            if (poll(&p, 1, 1000) <= 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int handle_line(QueryServer_t *server, int fd, char *line) {
+    ResultSink_t sink = {0};
+    char *body = NULL;
+    size_t body_len = 0;
+    char status[64];
+
+    sink.out = open_memstream(&body, &body_len);
+    if (!sink.out) {
+        return -1;
+    }
+    const char *err = execute(server->engine, line, &sink);
+    fclose(sink.out);
+    if (err) {
+        snprintf(status, sizeof(status), "%s\n", err);
+        body_len = 0;
+    } else {
+        snprintf(status, sizeof(status), "OK %u\n", sink.lines);
+    }
+    int rc = send_all(fd, status, strlen(status));
+    if (rc == 0 && body_len > 0) {
+        rc = send_all(fd, body, body_len);
+    }
+    free(body);
+    return rc;
+}
+
+// Returns -1 when the client should be dropped
+static int client_read(QueryServer_t *server, QueryClient_t *c) {
+    ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len, 0);
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return 0;
+    }
+    if (n <= 0) {
+        return -1;
+    }
+    c->len += (size_t)n;
+    c->buf[c->len] = '\0';
+
+    char *start = c->buf;
+    char *nl;
+    while ((nl = strchr(start, '\n')) != NULL) {
+        *nl = '\0';
+        if (handle_line(server, c->fd, start) != 0) {
+            return -1;
+        }
+        start = nl + 1;
+    }
+    c->len -= (size_t)(start - c->buf);
+    memmove(c->buf, start, c->len);
+    if (c->len == sizeof(c->buf) - 1) {
+        send_all(c->fd, "ERR line too long\n", 18);
+        return -1;
+    }
+    return 0;
+}
+
+static void *server_thread(void *arg) {
+    QueryServer_t *server = arg;
+    struct pollfd fds[2 + QUERY_SERVER_MAX_CLIENTS];
+
+    for (;;) {
+        fds[0] = (struct pollfd){.fd = server->wake[0], .events = POLLIN};
+        fds[1] = (struct pollfd){.fd = server->listen_fd, .events = POLLIN};
+        for (int i = 0; i < server->n_clients; ++i) {
+            fds[2 + i] = (struct pollfd){.fd = server->clients[i].fd, .events = POLLIN};
+        }
+        if (poll(fds, 2 + (nfds_t)server->n_clients, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+        // Walk backwards so dropping a client does not skip the next one
+        for (int i = server->n_clients - 1; i >= 0; --i) {
+            if (fds[2 + i].revents && client_read(server, &server->clients[i]) != 0) {
+                close(server->clients[i].fd);
+                server->clients[i] = server->clients[--server->n_clients];
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0 && server->n_clients < QUERY_SERVER_MAX_CLIENTS) {
+                server->clients[server->n_clients++] = (QueryClient_t){.fd = fd};
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+    for (int i = 0; i < server->n_clients; ++i) {
+        close(server->clients[i].fd);
+    }
+    server->n_clients = 0;
+    return NULL;
+}
+
+QueryServer_t *QueryServer_Start(const char *socket_path, SeriesStore_t *store, RollupEngine_t *rollup) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    QueryServer_t *server = calloc(1, sizeof(*server));
+
+    if (!server || strlen(socket_path) >= sizeof(addr.sun_path)) {
+        free(server);
+        return NULL;
+    }
+    strcpy(addr.sun_path, socket_path);
+    server->listen_fd = -1;
+    server->wake[0] = server->wake[1] = -1;
+    server->path = strdup(socket_path);
+    server->engine = Query_Create(store, rollup);
+    if (!server->path || !server->engine || pipe2(server->wake, O_CLOEXEC) != 0) {
+        goto fail;
+    }
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(socket_path);
+    if (server->listen_fd < 0 || bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, 16) != 0) {
+        goto fail;
+    }
+    if (pthread_create(&server->thread, NULL, server_thread, server) != 0) {
+        goto fail;
+    }
+    return server;
+
+fail:
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    if (server->wake[0] >= 0) {
+        close(server->wake[0]);
+        close(server->wake[1]);
+    }
+    Query_Destroy(server->engine);
+    free(server->path);
+    free(server);
+    return NULL;
+}
+
+void QueryServer_Stop(QueryServer_t *server) {
+    if (!server) {
+        return;
+    }
+    ssize_t n = write(server->wake[1], "x", 1);
+    (void)n;
+    pthread_join(server->thread, NULL);
+    close(server->listen_fd);
+    close(server->wake[0]);
+    close(server->wake[1]);
+    unlink(server->path);
+    Query_Destroy(server->engine);
+    free(server->path);
+    free(server);
+}
@@ -0,0 +1,317 @@
+#include "radio/capture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/crc32.h"
+
+#define CAPTURE_MAGIC 0x50414357u // "WCAP"
+#define BLOCK_MAGIC 0x4b4c4243u   // "CBLK"
+#define CAPTURE_VERSION 1
+#define FILE_HEADER_LEN 16
+#define BLOCK_HEADER_LEN 24
+#define RECORD_MAX (10 + 2 + FRAME_MAX_PAYLOAD)
+
+struct CaptureWriter {
+    int fd;
+    uint8_t *buf;
+    size_t used;
+    uint32_t records;
+    int64_t prev_ts;
+    CaptureStats_t stats;
+};
+
+struct CaptureReader {
+    int fd;
+    uint8_t *buf;
+    size_t pos;
+    size_t end;
+    uint32_t left; // Records left in the current block
+    int64_t prev_ts;
+    CaptureStats_t stats;
+};
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static int write_all(int fd, const uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Bytes read; short only at end of file
+static ssize_t read_full(int fd, uint8_t *p, size_t len) {
+    size_t got = 0;
+
+    while (got < len) {
+        ssize_t n = read(fd, p + got, len - got);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    return (ssize_t)got;
+}
+
+// Reads the next block into buf; 1 if valid, 0 at the end or a torn block, -1 on error
+static int read_block(int fd, uint8_t *buf, uint32_t *bytes, uint32_t *records) {
+    ssize_t n = read_full(fd, buf, BLOCK_HEADER_LEN);
+
+    if (n < 0) {
+        return -1;
+    }
+    if (n < BLOCK_HEADER_LEN || get_u32(buf) != BLOCK_MAGIC) {
+        return 0;
+    }
+    *bytes = get_u32(buf + 4);
+    *records = get_u32(buf + 8);
+    if (*bytes < BLOCK_HEADER_LEN || *bytes > CAPTURE_BLOCK_BYTES) {
+        return 0;
+    }
+    n = read_full(fd, buf + BLOCK_HEADER_LEN, *bytes - BLOCK_HEADER_LEN);
+    if (n < 0) {
+        return -1;
+    }
+    if ((size_t)n < *bytes - BLOCK_HEADER_LEN) {
+        return 0;
+    }
+    uint32_t crc = Crc32_Update(0, buf + 16, *bytes - 16);
+    crc = Crc32_Update(crc, buf + 4, 8);
+    return crc == get_u32(buf + 12) ? 1 : 0;
+}
+
+static int check_file_header(int fd) {
+    uint8_t hdr[FILE_HEADER_LEN];
+
+    if (read_full(fd, hdr, sizeof(hdr)) != sizeof(hdr) || get_u32(hdr) != CAPTURE_MAGIC ||
+        get_u32(hdr + 4) != CAPTURE_VERSION) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+CaptureWriter_t *CaptureWriter_Open(const char *path) {
+    CaptureWriter_t *writer = calloc(1, sizeof(*writer));
+    struct stat st;
+
+    if (!writer) {
+        return NULL;
+    }
+    writer->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    writer->buf = malloc(CAPTURE_BLOCK_BYTES);
+    if (writer->fd < 0 || !writer->buf || fstat(writer->fd, &st) != 0) {
+        goto fail;
+    }
+    writer->used = BLOCK_HEADER_LEN;
+
+    if (st.st_size == 0) {
+        uint8_t hdr[FILE_HEADER_LEN] = {0};
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        int64_t created = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        put_u32(hdr, CAPTURE_MAGIC);
+        put_u32(hdr + 4, CAPTURE_VERSION);
+        memcpy(hdr + 8, &created, sizeof(created));
+        if (write_all(writer->fd, hdr, sizeof(hdr)) != 0) {
+            goto fail;
+        }
+        return writer;
+    }
+
+    // Appending: cut any torn block left by a crash so new blocks stay reachable
+    if (check_file_header(writer->fd) != 0) {
+        goto fail;
+    }
+    off_t valid = FILE_HEADER_LEN;
+    uint32_t bytes, records;
+    int rc;
+    while ((rc = read_block(writer->fd, writer->buf, &bytes, &records)) == 1) {
+        valid += bytes;
+    }
+    if (rc < 0 || ftruncate(writer->fd, valid) != 0 || lseek(writer->fd, valid, SEEK_SET) != valid) {
+        goto fail;
+    }
+    return writer;
+
+fail:
+    CaptureWriter_Close(writer);
+    return NULL;
+}
+
+int CaptureWriter_Flush(CaptureWriter_t *writer) {
+    uint8_t *b = writer->buf;
+
+    if (writer->records == 0) {
+        return 0;
+    }
+    put_u32(b, BLOCK_MAGIC);
+    put_u32(b + 4, (uint32_t)writer->used);
+    put_u32(b + 8, writer->records);
+    uint32_t crc = Crc32_Update(0, b + 16, writer->used - 16);
+    put_u32(b + 12, Crc32_Update(crc, b + 4, 8));
+    int rc = write_all(writer->fd, b, writer->used);
+    if (rc == 0) {
+        writer->stats.blocks++;
+        writer->stats.bytes += writer->used;
+    }
+    writer->used = BLOCK_HEADER_LEN;
+    writer->records = 0;
+    return rc;
+}
+
+int CaptureWriter_Append(CaptureWriter_t *writer, const Frame_t *frame) {
+    if (frame->len > FRAME_MAX_PAYLOAD) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (writer->used + RECORD_MAX > CAPTURE_BLOCK_BYTES && CaptureWriter_Flush(writer) != 0) {
+        return -1;
+    }
+    uint8_t *p = writer->buf + writer->used;
+    if (writer->records == 0) {
+        memcpy(writer->buf + 16, &frame->rx_ts, sizeof(frame->rx_ts));
+        writer->prev_ts = frame->rx_ts;
+    }
+    int64_t delta = frame->rx_ts - writer->prev_ts;
+    uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    while (zz >= 0x80) {
+        *p++ = (uint8_t)(zz | 0x80);
+        zz >>= 7;
+    }
+    *p++ = (uint8_t)zz;
+    *p++ = (uint8_t)((frame->pipe & 0x7f) | (frame->rpd ? 0x80 : 0));
+    *p++ = frame->len;
+    memcpy(p, frame->payload, frame->len);
+    p += frame->len;
+
+    writer->used = (size_t)(p - writer->buf);
+    writer->records++;
+    writer->prev_ts = frame->rx_ts;
+    writer->stats.frames++;
+    return 0;
+}
+
+int CaptureWriter_Close(CaptureWriter_t *writer) {
+    int rc = 0;
+
+    if (!writer) {
+        return 0;
+    }
+    if (writer->fd >= 0) {
+        if (writer->buf && CaptureWriter_Flush(writer) != 0) {
+            rc = -1;
+        }
+        if (close(writer->fd) != 0) {
+            rc = -1;
+        }
+    }
+    free(writer->buf);
+    free(writer);
+    return rc;
+}
+
+void CaptureWriter_GetStats(const CaptureWriter_t *writer, CaptureStats_t *stats) {
+    *stats = writer->stats;
+}
+
+CaptureReader_t *CaptureReader_Open(const char *path) {
+    CaptureReader_t *reader = calloc(1, sizeof(*reader));
+
+    if (!reader) {
+        return NULL;
+    }
+    reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+    reader->buf = malloc(CAPTURE_BLOCK_BYTES);
+    if (reader->fd < 0 || !reader->buf || check_file_header(reader->fd) != 0) {
+        CaptureReader_Close(reader);
+        return NULL;
+    }
+    posix_fadvise(reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return reader;
+}
+
+int CaptureReader_Next(CaptureReader_t *reader, Frame_t *frame) {
+    while (reader->left == 0) {
+        uint32_t bytes, records;
+        int rc = read_block(reader->fd, reader->buf, &bytes, &records);
+        if (rc <= 0) {
+            return rc;
+        }
+        memcpy(&reader->prev_ts, reader->buf + 16, sizeof(reader->prev_ts));
+        reader->pos = BLOCK_HEADER_LEN;
+        reader->end = bytes;
+        reader->left = records;
+        reader->stats.blocks++;
+        reader->stats.bytes += bytes;
+    }
+
+    const uint8_t *p = reader->buf + reader->pos, *end = reader->buf + reader->end;
+    uint64_t zz = 0;
+    int shift = 0;
+    while (p < end && (*p & 0x80) && shift < 63) {
+        zz |= (uint64_t)(*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    if (end - p < 3 || p[2] > FRAME_MAX_PAYLOAD || end - p < 3 + p[2]) {
+        // The CRC matched, so this is a writer bug rather than a torn write
+        errno = EINVAL;
+        return -1;
+    }
+    zz |= (uint64_t)*p++ << shift;
+    reader->prev_ts += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+    frame->rx_ts = reader->prev_ts;
+    frame->pipe = *p & 0x7f;
+    frame->rpd = *p++ >> 7;
+    frame->len = *p++;
+    memcpy(frame->payload, p, frame->len);
+    p += frame->len;
+
+    reader->pos = (size_t)(p - reader->buf);
+    reader->left--;
+    reader->stats.frames++;
+    return 1;
+}
+
+void CaptureReader_Close(CaptureReader_t *reader) {
+    if (!reader) {
+        return;
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    free(reader->buf);
+    free(reader);
+}
+
+void CaptureReader_GetStats(const CaptureReader_t *reader, CaptureStats_t *stats) {
+    *stats = reader->stats;
+}
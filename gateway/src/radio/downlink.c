@@ -0,0 +1,390 @@
+#include "radio/downlink.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hash.h"
+
+#define SWEEP_INTERVAL_MS 100
+#define FREE_END UINT32_MAX
+#define PICK_LOAD_MAX 9 // Tenths of the node table a pick may fill; Downlink_Poll grows it past 7
+
+typedef struct Entry {
+    struct Entry *next;
+    uint32_t free_next; // Next entry on the free list
+    DownlinkMsg_t msg;
+} Entry_t;
+
+typedef struct {
+    bool used;
+    uint32_t node;
+    uint32_t count;
+    Entry_t *queue[DOWNLINK_PRIO_COUNT]; // Earliest deadline first
+} NodeQueue_t;
+
+struct DownlinkScheduler {
+    DownlinkConfig_t cfg;
+    Entry_t *entries;                            // capacity of them, allocated up front
+    Entry_t *inbox __attribute__((aligned(64))); // Lock-free stack, newest first
+    int32_t inbox_len;                           // About how many: counted after the push
+    uint32_t total;                              // Queued anywhere, for the capacity check
+    uint64_t free_head __attribute__((aligned(64))); // Free entry index, tagged against ABA
+
+    // Receive thread only from here
+    Entry_t *pending __attribute__((aligned(64))); // Drained from the inbox, oldest first
+    Entry_t *pending_tail;
+    NodeQueue_t *nodes;
+    uint32_t mask;
+    uint32_t used;
+    int64_t next_sweep_ms;
+    DownlinkStats_t stats;
+};
+
+static void stat_add(uint64_t *counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+void Downlink_DefaultConfig(DownlinkConfig_t *cfg) {
+    cfg->capacity = 65536;
+    cfg->per_node = 16;
+    cfg->drain_batch = 64;
+    cfg->expected_nodes = 1024;
+}
+
+static int table_alloc(DownlinkScheduler_t *sched, uint32_t cap) {
+    NodeQueue_t *nodes = calloc(cap, sizeof(*nodes));
+
+    if (!nodes) {
+        return -1;
+    }
+    if (sched->nodes) {
+        for (uint32_t i = 0; i <= sched->mask; ++i) {
+            if (!sched->nodes[i].used) {
+                continue;
+            }
+            uint32_t h = (uint32_t)Hash_U64(sched->nodes[i].node) & (cap - 1);
+            while (nodes[h].used) {
+                h = (h + 1) & (cap - 1);
+            }
+            nodes[h] = sched->nodes[i];
+        }
+        free(sched->nodes);
+    }
+    sched->nodes = nodes;
+    sched->mask = cap - 1;
+    return 0;
+}
+
+DownlinkScheduler_t *Downlink_Create(const DownlinkConfig_t *cfg) {
+    if (cfg->capacity == 0 || cfg->per_node == 0 || cfg->drain_batch == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    DownlinkScheduler_t *sched = aligned_alloc(64, (sizeof(*sched) + 63) & ~(size_t)63);
+    if (!sched) {
+        return NULL;
+    }
+    memset(sched, 0, sizeof(*sched));
+    sched->cfg = *cfg;
+    sched->entries = malloc(cfg->capacity * sizeof(*sched->entries));
+    if (!sched->entries ||
+        table_alloc(sched, Hash_RoundUpPow2(cfg->expected_nodes + cfg->expected_nodes / 2)) != 0) {
+        free(sched->entries);
+        free(sched);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < cfg->capacity; ++i) {
+        sched->entries[i].free_next = i + 1 < cfg->capacity ? i + 1 : FREE_END;
+    }
+    sched->free_head = 0;
+    return sched;
+}
+
+void Downlink_Destroy(DownlinkScheduler_t *sched) {
+    if (!sched) {
+        return;
+    }
+    free(sched->entries);
+    free(sched->nodes);
+    free(sched);
+}
+
+/*
+ * The free list is a stack of entry indices. The head's upper half counts
+ * every change, so a pop whose entry was taken and given back meanwhile
+ * fails its exchange instead of linking in a stale next.
+ */
+static Entry_t *entry_take(DownlinkScheduler_t *sched) {
+    uint64_t head = __atomic_load_n(&sched->free_head, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+        uint32_t i = (uint32_t)head;
+        if (i == FREE_END) {
+            return NULL;
+        }
+        uint64_t next = __atomic_load_n(&sched->entries[i].free_next, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&sched->free_head, &head, ((head >> 32) + 1) << 32 | next, true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            return &sched->entries[i];
+        }
+    }
+}
+
+static void entry_give(DownlinkScheduler_t *sched, Entry_t *e) {
+    uint64_t head = __atomic_load_n(&sched->free_head, __ATOMIC_RELAXED);
+    uint64_t i = (uint64_t)(e - sched->entries);
+
+    do {
+        __atomic_store_n(&e->free_next, (uint32_t)head, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&sched->free_head, &head, ((head >> 32) + 1) << 32 | i, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+int Downlink_Enqueue(DownlinkScheduler_t *sched, const DownlinkMsg_t *msg) {
+    if (msg->prio >= DOWNLINK_PRIO_COUNT || msg->len == 0 || msg->len > FRAME_MAX_PAYLOAD) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (__atomic_add_fetch(&sched->total, 1, __ATOMIC_RELAXED) > sched->cfg.capacity) {
+        __atomic_sub_fetch(&sched->total, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&sched->stats.rejected, 1, __ATOMIC_RELAXED);
+        errno = EAGAIN;
+        return -1;
+    }
+    // Entries go back before total drops, so one is free whenever total was below capacity
+    Entry_t *e = entry_take(sched);
+    if (!e) {
+        __atomic_sub_fetch(&sched->total, 1, __ATOMIC_RELAXED);
+        errno = EAGAIN;
+        return -1;
+    }
+    e->msg = *msg;
+    e->next = __atomic_load_n(&sched->inbox, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&sched->inbox, &e->next, e, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    __atomic_add_fetch(&sched->inbox_len, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sched->stats.enqueued, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void release(DownlinkScheduler_t *sched, Entry_t *e) {
+    entry_give(sched, e);
+    __atomic_sub_fetch(&sched->total, 1, __ATOMIC_RELAXED);
+}
+
+static NodeQueue_t *node_find(DownlinkScheduler_t *sched, uint32_t node) {
+    uint32_t h = (uint32_t)Hash_U64(node) & sched->mask;
+
+    while (sched->nodes[h].used) {
+        if (sched->nodes[h].node == node) {
+            return &sched->nodes[h];
+        }
+        h = (h + 1) & sched->mask;
+    }
+    return NULL;
+}
+
+static bool table_over(const DownlinkScheduler_t *sched, uint32_t tenths) {
+    return (uint64_t)(sched->used + 1) * 10 > (uint64_t)(sched->mask + 1) * tenths;
+}
+
+// A new node's queue; NULL when the table is too full and may not grow on this path
+static NodeQueue_t *node_get(DownlinkScheduler_t *sched, uint32_t node, bool may_grow) {
+    NodeQueue_t *nq = node_find(sched, node);
+
+    if (nq) {
+        return nq;
+    }
+    if (!may_grow && table_over(sched, PICK_LOAD_MAX)) {
+        return NULL;
+    }
+    if (may_grow && table_over(sched, 7) && table_alloc(sched, (sched->mask + 1) * 2) != 0) {
+        return NULL;
+    }
+    uint32_t h = (uint32_t)Hash_U64(node) & sched->mask;
+    while (sched->nodes[h].used) {
+        h = (h + 1) & sched->mask;
+    }
+    nq = &sched->nodes[h];
+    nq->used = true;
+    nq->node = node;
+    sched->used++;
+    return nq;
+}
+
+static int64_t deadline_key(const DownlinkMsg_t *msg) {
+    return msg->deadline_ms ? msg->deadline_ms : INT64_MAX;
+}
+
+static bool expired(const DownlinkMsg_t *msg, int64_t now_ms) {
+    return msg->deadline_ms != 0 && msg->deadline_ms <= now_ms;
+}
+
+static void unlink_entry(NodeQueue_t *nq, Entry_t **link) {
+    *link = (*link)->next;
+    nq->count--;
+}
+
+// Least urgent queued message: lowest priority, latest deadline
+static Entry_t **least_urgent(NodeQueue_t *nq) {
+    for (int p = DOWNLINK_PRIO_COUNT; p-- > 0;) {
+        Entry_t **link = &nq->queue[p], **last = NULL;
+        for (; *link; link = &(*link)->next) {
+            last = link;
+        }
+        if (last) {
+            return last;
+        }
+    }
+    return NULL;
+}
+
+// False, with e left alone, if its node needs a table slot that only a grow could give
+static bool insert(DownlinkScheduler_t *sched, Entry_t *e, bool may_grow) {
+    NodeQueue_t *nq = node_get(sched, e->msg.node, may_grow);
+
+    if (!nq && !may_grow) {
+        return false;
+    }
+    if (!nq) {
+        stat_add(&sched->stats.quota_drops, 1);
+        release(sched, e);
+        return true;
+    }
+    if (e->msg.kind) {
+        for (int p = 0; p < DOWNLINK_PRIO_COUNT; ++p) {
+            for (Entry_t **link = &nq->queue[p]; *link; link = &(*link)->next) {
+                if ((*link)->msg.kind == e->msg.kind) {
+                    Entry_t *old = *link;
+                    unlink_entry(nq, link);
+                    release(sched, old);
+                    stat_add(&sched->stats.replaced, 1);
+                    p = DOWNLINK_PRIO_COUNT;
+                    break;
+                }
+            }
+        }
+    }
+    if (nq->count >= sched->cfg.per_node) {
+        Entry_t **victim = least_urgent(nq);
+        const DownlinkMsg_t *v = &(*victim)->msg;
+        stat_add(&sched->stats.quota_drops, 1);
+        if (e->msg.prio > v->prio || (e->msg.prio == v->prio && deadline_key(&e->msg) >= deadline_key(v))) {
+            release(sched, e);
+            return true;
+        }
+        Entry_t *old = *victim;
+        unlink_entry(nq, victim);
+        release(sched, old);
+    }
+    // Ties keep arrival order
+    Entry_t **link = &nq->queue[e->msg.prio];
+    while (*link && deadline_key(&(*link)->msg) <= deadline_key(&e->msg)) {
+        link = &(*link)->next;
+    }
+    e->next = *link;
+    *link = e;
+    nq->count++;
+    return true;
+}
+
+/*
+ * Sort in up to limit inbox messages, oldest first. The inbox is a stack,
+ * so taking it means walking all of it: a pick leaves one of more than
+ * limit messages to polling. Only polling may grow the node table; a
+ * pick stops at a message that would need it.
+ */
+static void drain(DownlinkScheduler_t *sched, uint32_t limit, bool polling) {
+    if (__atomic_load_n(&sched->inbox, __ATOMIC_RELAXED) &&
+        (polling || __atomic_load_n(&sched->inbox_len, __ATOMIC_RELAXED) <= (int64_t)limit)) {
+        Entry_t *stack = __atomic_exchange_n(&sched->inbox, NULL, __ATOMIC_ACQUIRE), *fifo = NULL, *tail = stack;
+        int32_t n = 0;
+        while (stack) {
+            Entry_t *next = stack->next;
+            stack->next = fifo;
+            fifo = stack;
+            stack = next;
+            n++;
+        }
+        __atomic_sub_fetch(&sched->inbox_len, n, __ATOMIC_RELAXED);
+        if (sched->pending) {
+            sched->pending_tail->next = fifo;
+        } else {
+            sched->pending = fifo;
+        }
+        sched->pending_tail = tail;
+    }
+    for (uint32_t i = 0; i < limit && sched->pending; ++i) {
+        Entry_t *e = sched->pending, *next = e->next;
+        if (!insert(sched, e, polling)) {
+            break;
+        }
+        sched->pending = next;
+    }
+}
+
+int Downlink_Next(DownlinkScheduler_t *sched, uint32_t node, int64_t now_ms, DownlinkMsg_t *out) {
+    drain(sched, sched->cfg.drain_batch, false);
+
+    NodeQueue_t *nq = node_find(sched, node);
+    if (!nq || nq->count == 0) {
+        return 0;
+    }
+    for (int p = 0; p < DOWNLINK_PRIO_COUNT; ++p) {
+        while (nq->queue[p]) {
+            Entry_t *e = nq->queue[p];
+            unlink_entry(nq, &nq->queue[p]);
+            if (expired(&e->msg, now_ms)) {
+                stat_add(&sched->stats.expired, 1);
+                release(sched, e);
+                continue;
+            }
+            *out = e->msg;
+            release(sched, e);
+            stat_add(&sched->stats.loaded, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void Downlink_Poll(DownlinkScheduler_t *sched, int64_t now_ms) {
+    // Grown here so that picks keep finding room; a failure waits for the next poll
+    if (table_over(sched, 7)) {
+        table_alloc(sched, (sched->mask + 1) * 2);
+    }
+    drain(sched, UINT32_MAX, true);
+    if (now_ms < sched->next_sweep_ms) {
+        return;
+    }
+    sched->next_sweep_ms = now_ms + SWEEP_INTERVAL_MS;
+    for (uint32_t i = 0; i <= sched->mask; ++i) {
+        NodeQueue_t *nq = &sched->nodes[i];
+        if (!nq->used || nq->count == 0) {
+            continue;
+        }
+        for (int p = 0; p < DOWNLINK_PRIO_COUNT; ++p) {
+            // Deadline order: expired messages are at the front
+            while (nq->queue[p] && expired(&nq->queue[p]->msg, now_ms)) {
+                Entry_t *e = nq->queue[p];
+                unlink_entry(nq, &nq->queue[p]);
+                stat_add(&sched->stats.expired, 1);
+                release(sched, e);
+            }
+        }
+    }
+}
+
+void Downlink_GetStats(DownlinkScheduler_t *sched, DownlinkStats_t *stats) {
+    DownlinkStats_t *s = &sched->stats;
+
+    stats->enqueued = __atomic_load_n(&s->enqueued, __ATOMIC_RELAXED);
+    stats->rejected = __atomic_load_n(&s->rejected, __ATOMIC_RELAXED);
+    stats->replaced = __atomic_load_n(&s->replaced, __ATOMIC_RELAXED);
+    stats->quota_drops = __atomic_load_n(&s->quota_drops, __ATOMIC_RELAXED);
+    stats->expired = __atomic_load_n(&s->expired, __ATOMIC_RELAXED);
+    stats->loaded = __atomic_load_n(&s->loaded, __ATOMIC_RELAXED);
+    stats->queued = __atomic_load_n(&sched->total, __ATOMIC_RELAXED);
+}
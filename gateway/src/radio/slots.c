@@ -0,0 +1,209 @@
+#include "radio/slots.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hash.h"
+#include "proto/control.h"
+
+typedef struct {
+    bool used;
+    bool pending;      // Message issued, no frame in the slot since
+    uint16_t slot;
+    uint32_t node;
+    int64_t issued_ms;
+} SlotNode_t;
+
+struct SlotPlanner {
+    SlotConfig_t cfg;
+    uint32_t n_slots;
+    uint32_t *load;    // Nodes per slot
+    SlotNode_t *nodes;
+    uint32_t mask;
+    uint32_t used;
+    SlotStats_t stats;
+    Metric_t in_slot;
+    Metric_t off_slot;
+    Metric_t assigned;
+    Metric_t retimed;
+    Metric_t n_nodes;
+};
+
+void Slots_DefaultConfig(SlotConfig_t *cfg) {
+    cfg->period_ms = 10000;
+    cfg->slot_ms = 10;
+    cfg->tolerance_ms = 2;
+    cfg->expected_nodes = 1024;
+    cfg->metrics = NULL;
+}
+
+static int table_alloc(SlotPlanner_t *planner, uint32_t cap) {
+    SlotNode_t *nodes = calloc(cap, sizeof(*nodes));
+
+    if (!nodes) {
+        return -1;
+    }
+    if (planner->nodes) {
+        for (uint32_t i = 0; i <= planner->mask; ++i) {
+            if (!planner->nodes[i].used) {
+                continue;
+            }
+            uint32_t h = (uint32_t)Hash_U64(planner->nodes[i].node) & (cap - 1);
+            while (nodes[h].used) {
+                h = (h + 1) & (cap - 1);
+            }
+            nodes[h] = planner->nodes[i];
+        }
+        free(planner->nodes);
+    }
+    planner->nodes = nodes;
+    planner->mask = cap - 1;
+    return 0;
+}
+
+SlotPlanner_t *Slots_Create(const SlotConfig_t *cfg) {
+    if (cfg->slot_ms == 0 || cfg->period_ms < cfg->slot_ms || cfg->period_ms / cfg->slot_ms > UINT16_MAX) {
+        errno = EINVAL;
+        return NULL;
+    }
+    SlotPlanner_t *planner = calloc(1, sizeof(*planner));
+    if (!planner) {
+        return NULL;
+    }
+    planner->cfg = *cfg;
+    planner->n_slots = cfg->period_ms / cfg->slot_ms;
+    planner->load = calloc(planner->n_slots, sizeof(*planner->load));
+    if (!planner->load || table_alloc(planner, Hash_RoundUpPow2(cfg->expected_nodes + cfg->expected_nodes / 2)) != 0) {
+        free(planner->load);
+        free(planner);
+        return NULL;
+    }
+    planner->in_slot = planner->off_slot = planner->assigned = planner->retimed = (Metric_t){.slot = -1};
+    planner->n_nodes = (Metric_t){.slot = -1};
+    if (cfg->metrics) {
+        const char *frames = "Frames checked against their node's transmit slot";
+        const char *messages = "Slot messages issued";
+        planner->in_slot = Metrics_Counter(cfg->metrics, "gateway_slot_frames_total{timing=\"in_slot\"}", frames);
+        planner->off_slot = Metrics_Counter(cfg->metrics, "gateway_slot_frames_total{timing=\"off_slot\"}", frames);
+        planner->assigned = Metrics_Counter(cfg->metrics, "gateway_slot_messages_total{reason=\"new\"}", messages);
+        planner->retimed = Metrics_Counter(cfg->metrics, "gateway_slot_messages_total{reason=\"drift\"}", messages);
+        planner->n_nodes = Metrics_Gauge(cfg->metrics, "gateway_slot_nodes", "Nodes with a transmit slot");
+    }
+    return planner;
+}
+
+void Slots_Destroy(SlotPlanner_t *planner) {
+    if (!planner) {
+        return;
+    }
+    free(planner->nodes);
+    free(planner->load);
+    free(planner);
+}
+
+// Least used slot nearest to the one the node reports in now
+static uint16_t pick_slot(SlotPlanner_t *planner, uint32_t natural) {
+    uint32_t n = planner->n_slots, level = planner->used / n;
+
+    for (uint32_t d = 0; d <= n / 2; ++d) {
+        uint32_t up = (natural + d) % n, down = (natural + n - d) % n;
+        if (planner->load[up] <= level) {
+            return (uint16_t)up;
+        }
+        if (planner->load[down] <= level) {
+            return (uint16_t)down;
+        }
+    }
+    return (uint16_t)natural; // Not reached: some slot is always at the fill level
+}
+
+static SlotNode_t *node_get(SlotPlanner_t *planner, uint32_t node, bool *created) {
+    uint32_t h = (uint32_t)Hash_U64(node) & planner->mask;
+
+    *created = false;
+    while (planner->nodes[h].used) {
+        if (planner->nodes[h].node == node) {
+            return &planner->nodes[h];
+        }
+        h = (h + 1) & planner->mask;
+    }
+    if ((planner->used + 1) * 10 > (planner->mask + 1) * 7) {
+        if (table_alloc(planner, (planner->mask + 1) * 2) != 0) {
+            return NULL;
+        }
+        return node_get(planner, node, created);
+    }
+    *created = true;
+    planner->nodes[h].used = true;
+    planner->nodes[h].node = node;
+    return &planner->nodes[h];
+}
+
+static void make_msg(const SlotPlanner_t *planner, SlotNode_t *sn, int64_t rx_ms, DownlinkMsg_t *msg) {
+    // Aim the frames' arrival at the slot centre, leaving half a slot either side for retries and drift
+    ControlSlot_t slot = {
+        .slot = sn->slot,
+        .period_ms = planner->cfg.period_ms,
+        .delay_ms = sn->slot * planner->cfg.slot_ms + planner->cfg.slot_ms / 2,
+    };
+
+    memset(msg, 0, sizeof(*msg));
+    msg->node = sn->node;
+    msg->prio = DOWNLINK_PRIO_CONTROL;
+    msg->kind = CONTROL_TYPE_SLOT;
+    msg->len = (uint8_t)Control_EncodeSlot(msg->payload, &slot);
+    msg->enqueued_ms = rx_ms;
+    sn->pending = true;
+    sn->issued_ms = rx_ms;
+}
+
+int Slots_Observe(SlotPlanner_t *planner, uint32_t node, int64_t rx_ms, DownlinkMsg_t *msg) {
+    int64_t period = planner->cfg.period_ms, phase = rx_ms % period;
+    bool created;
+
+    phase += phase < 0 ? period : 0;
+    SlotNode_t *sn = node_get(planner, node, &created);
+    if (!sn) {
+        return -1;
+    }
+    if (created) {
+        sn->slot = pick_slot(planner, (uint32_t)(phase / planner->cfg.slot_ms));
+        if (planner->load[sn->slot]++ > 0) {
+            planner->stats.shared++;
+        }
+        planner->used++;
+        planner->stats.assigned++;
+        Metrics_Inc(planner->assigned);
+        Metrics_Set(planner->n_nodes, planner->used);
+        make_msg(planner, sn, rx_ms, msg);
+        return 1;
+    }
+
+    int64_t off = phase - (int64_t)(sn->slot * planner->cfg.slot_ms + planner->cfg.slot_ms / 2);
+    off += off > period / 2 ? -period : off <= -period / 2 ? period : 0;
+    if (off <= (int64_t)planner->cfg.tolerance_ms && off >= -(int64_t)planner->cfg.tolerance_ms) {
+        planner->stats.in_slot++;
+        Metrics_Inc(planner->in_slot);
+        sn->pending = false;
+        return 0;
+    }
+    planner->stats.off_slot++;
+    Metrics_Inc(planner->off_slot);
+    // The last message is still queued, or the node has not reported since it got it; the
+    // ACK carrying it may have been lost, so re-issue after two periods
+    if (sn->pending && rx_ms - sn->issued_ms < 2 * period) {
+        return 0;
+    }
+    planner->stats.retimed++;
+    Metrics_Inc(planner->retimed);
+    make_msg(planner, sn, rx_ms, msg);
+    return 1;
+}
+
+void Slots_GetStats(const SlotPlanner_t *planner, SlotStats_t *stats) {
+    *stats = planner->stats;
+    stats->nodes = planner->used;
+    stats->slots = planner->n_slots;
+}
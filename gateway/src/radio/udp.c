@@ -0,0 +1,102 @@
+#include "radio/udp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+struct UdpRadio {
+    int fd;
+    struct sockaddr_in peer; // Sender of the last frame
+    bool has_peer;
+};
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+UdpRadio_t *UdpRadio_Open(uint16_t port) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    UdpRadio_t *radio = calloc(1, sizeof(*radio));
+
+    if (!radio) {
+        return NULL;
+    }
+    radio->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (radio->fd < 0 || bind(radio->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        UdpRadio_Close(radio);
+        return NULL;
+    }
+    return radio;
+}
+
+void UdpRadio_Close(UdpRadio_t *radio) {
+    if (!radio) {
+        return;
+    }
+    if (radio->fd >= 0) {
+        close(radio->fd);
+    }
+    free(radio);
+}
+
+int UdpRadio_Receive(UdpRadio_t *radio, Frame_t *frame, int timeout_ms) {
+    uint8_t buf[UDP_RADIO_DATAGRAM_MAX + 1];
+
+    for (;;) {
+        struct pollfd pfd = {.fd = radio->fd, .events = POLLIN};
+        int rc = poll(&pfd, 1, timeout_ms);
+        if (rc < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        if (rc == 0) {
+            return 0;
+        }
+        socklen_t peer_len = sizeof(radio->peer);
+        ssize_t n = recvfrom(radio->fd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&radio->peer, &peer_len);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n < 2 || n > UDP_RADIO_DATAGRAM_MAX) {
+            continue;
+        }
+        radio->has_peer = true;
+        frame->rx_ts = now_ms();
+        frame->pipe = buf[0];
+        frame->rpd = buf[1];
+        frame->len = (uint8_t)(n - 2);
+        memcpy(frame->payload, buf + 2, frame->len);
+        return 1;
+    }
+}
+
+int UdpRadio_SendAck(UdpRadio_t *radio, const uint8_t *payload, uint8_t len) {
+    if (!radio->has_peer || len > FRAME_MAX_PAYLOAD) {
+        errno = EINVAL;
+        return -1;
+    }
+    ssize_t n = sendto(radio->fd, payload, len, MSG_DONTWAIT, (struct sockaddr *)&radio->peer, sizeof(radio->peer));
+    return n == len ? 0 : -1;
+}
+
+int UdpRadio_Pack(const Frame_t *frame, uint8_t *out) {
+    out[0] = frame->pipe;
+    out[1] = frame->rpd;
+    memcpy(out + 2, frame->payload, frame->len);
+    return 2 + frame->len;
+}
@@ -0,0 +1,320 @@
+#include "registry/registry.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/crc32.h"
+#include "common/hash.h"
+
+#define REGISTRY_MAGIC 0x4745524Eu // "NREG"
+#define REGISTRY_VERSION 2
+#define REGISTRY_EMPTY 0xFFFFFFFFu // Broadcast address, never a node
+#define REGISTRY_ALIGN 64
+
+// First 64 bytes of the block and of the snapshot file
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t cap;
+    uint32_t count;
+    uint32_t hot_size; // sizeof(NodeHot_t) and sizeof(NodeCold_t) when written,
+    uint32_t cold_size; // so a snapshot from another build is rejected
+    uint64_t keys_off;
+    uint64_t hot_off;
+    uint64_t cold_off;
+    uint64_t block_size;
+    uint32_t crc;        // Over the header with crc = 0
+    uint32_t tables_crc; // Over the block past the header
+} RegistryHeader_t;
+
+struct NodeRegistry {
+    uint8_t *block;
+    bool mapped;
+    RegistryHeader_t *hdr;
+    uint32_t *keys;
+    NodeHot_t *hot;
+    NodeCold_t *cold;
+    uint32_t mask;
+};
+
+static uint64_t align_up(uint64_t v) {
+    return (v + REGISTRY_ALIGN - 1) & ~(uint64_t)(REGISTRY_ALIGN - 1);
+}
+
+static void layout(RegistryHeader_t *hdr, uint32_t cap) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = REGISTRY_MAGIC;
+    hdr->version = REGISTRY_VERSION;
+    hdr->cap = cap;
+    hdr->hot_size = sizeof(NodeHot_t);
+    hdr->cold_size = sizeof(NodeCold_t);
+    hdr->keys_off = align_up(sizeof(RegistryHeader_t));
+    hdr->hot_off = align_up(hdr->keys_off + (uint64_t)cap * sizeof(uint32_t));
+    hdr->cold_off = align_up(hdr->hot_off + (uint64_t)cap * sizeof(NodeHot_t));
+    hdr->block_size = align_up(hdr->cold_off + (uint64_t)cap * sizeof(NodeCold_t));
+}
+
+static uint32_t tables_crc(const uint8_t *block, const RegistryHeader_t *hdr) {
+    return Crc32_Update(0, block + sizeof(*hdr), hdr->block_size - sizeof(*hdr));
+}
+
+static uint32_t header_crc(const RegistryHeader_t *hdr) {
+    RegistryHeader_t tmp = *hdr;
+    tmp.crc = 0;
+    return Crc32_Update(0, &tmp, sizeof(tmp));
+}
+
+static void attach(NodeRegistry_t *registry, uint8_t *block) {
+    registry->block = block;
+    registry->hdr = (RegistryHeader_t *)block;
+    registry->keys = (uint32_t *)(block + registry->hdr->keys_off);
+    registry->hot = (NodeHot_t *)(block + registry->hdr->hot_off);
+    registry->cold = (NodeCold_t *)(block + registry->hdr->cold_off);
+    registry->mask = registry->hdr->cap - 1;
+}
+
+static uint8_t *block_alloc(uint32_t cap) {
+    RegistryHeader_t hdr;
+
+    layout(&hdr, cap);
+    uint8_t *block = aligned_alloc(REGISTRY_ALIGN, hdr.block_size);
+    if (!block) {
+        return NULL;
+    }
+    memset(block, 0, hdr.block_size);
+    memcpy(block, &hdr, sizeof(hdr));
+    memset(block + hdr.keys_off, 0xFF, (size_t)cap * sizeof(uint32_t));
+    return block;
+}
+
+static void block_free(NodeRegistry_t *registry) {
+    if (registry->mapped) {
+        munmap(registry->block, registry->hdr->block_size);
+    } else {
+        free(registry->block);
+    }
+}
+
+NodeRegistry_t *Registry_Create(uint32_t expected_nodes) {
+    NodeRegistry_t *registry = calloc(1, sizeof(*registry));
+    uint32_t cap = Hash_RoundUpPow2(expected_nodes * 2 > 64 ? expected_nodes * 2 : 64);
+    uint8_t *block = registry ? block_alloc(cap) : NULL;
+
+    if (!block) {
+        free(registry);
+        return NULL;
+    }
+    attach(registry, block);
+    return registry;
+}
+
+NodeRegistry_t *Registry_Load(const char *path) {
+    RegistryHeader_t hdr, expect;
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(hdr) || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+        close(fd);
+        return NULL;
+    }
+    layout(&expect, hdr.cap);
+    // The offsets must be the layout's own: aligned, in order and inside the file; probing needs an empty slot
+    if (hdr.magic != REGISTRY_MAGIC || hdr.version != REGISTRY_VERSION || hdr.cap < 2 ||
+        (hdr.cap & (hdr.cap - 1)) != 0 || hdr.count >= hdr.cap || hdr.hot_size != expect.hot_size ||
+        hdr.cold_size != expect.cold_size || hdr.keys_off != expect.keys_off || hdr.hot_off != expect.hot_off ||
+        hdr.cold_off != expect.cold_off || hdr.block_size != expect.block_size ||
+        hdr.block_size != (uint64_t)st.st_size || hdr.crc != header_crc(&hdr)) {
+        close(fd);
+        errno = EBADMSG;
+        return NULL;
+    }
+    // Private mapping: pages are read on first touch and never written back
+    void *block = mmap(NULL, hdr.block_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (block == MAP_FAILED) {
+        return NULL;
+    }
+    // Slot contents index the tables and the downlink queues, so they are checked before use
+    if (tables_crc(block, &hdr) != hdr.tables_crc) {
+        munmap(block, hdr.block_size);
+        errno = EBADMSG;
+        return NULL;
+    }
+    NodeRegistry_t *registry = calloc(1, sizeof(*registry));
+    if (!registry) {
+        munmap(block, hdr.block_size);
+        return NULL;
+    }
+    registry->mapped = true;
+    attach(registry, block);
+    return registry;
+}
+
+static int write_all(int fd, const uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int Registry_Save(const NodeRegistry_t *registry, const char *path) {
+    char tmp[PATH_MAX], dir[PATH_MAX];
+
+    registry->hdr->tables_crc = tables_crc(registry->block, registry->hdr);
+    registry->hdr->crc = header_crc(registry->hdr);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (write_all(fd, registry->block, registry->hdr->block_size) != 0 || fsync(fd) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp, path) != 0) {
+        return -1;
+    }
+    snprintf(dir, sizeof(dir), "%s", path);
+    int dfd = open(dirname(dir), O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    return 0;
+}
+
+void Registry_Destroy(NodeRegistry_t *registry) {
+    if (!registry) {
+        return;
+    }
+    block_free(registry);
+    free(registry);
+}
+
+static uint32_t probe(const NodeRegistry_t *registry, uint32_t node) {
+    uint32_t i = (uint32_t)Hash_U64(node) & registry->mask;
+
+    while (registry->keys[i] != node && registry->keys[i] != REGISTRY_EMPTY) {
+        i = (i + 1) & registry->mask;
+    }
+    return i;
+}
+
+int32_t Registry_Find(const NodeRegistry_t *registry, uint32_t node) {
+    uint32_t i = probe(registry, node);
+    return registry->keys[i] == node && node != REGISTRY_EMPTY ? (int32_t)i : REGISTRY_NO_SLOT;
+}
+
+static int grow(NodeRegistry_t *registry) {
+    NodeRegistry_t next = {0};
+    uint8_t *block = block_alloc(registry->hdr->cap * 2);
+
+    if (!block) {
+        return -1;
+    }
+    attach(&next, block);
+    for (uint32_t i = 0; i <= registry->mask; ++i) {
+        if (registry->keys[i] != REGISTRY_EMPTY) {
+            uint32_t j = probe(&next, registry->keys[i]);
+            next.keys[j] = registry->keys[i];
+            next.hot[j] = registry->hot[i];
+            next.cold[j] = registry->cold[i];
+        }
+    }
+    next.hdr->count = registry->hdr->count;
+    block_free(registry);
+    registry->mapped = false;
+    attach(registry, block);
+    return 0;
+}
+
+int32_t Registry_Upsert(NodeRegistry_t *registry, uint32_t node) {
+    if (node == REGISTRY_EMPTY) {
+        return REGISTRY_NO_SLOT;
+    }
+    uint32_t i = probe(registry, node);
+    if (registry->keys[i] == node) {
+        return (int32_t)i;
+    }
+    // Linear probing degrades quickly past 70 % load
+    if ((uint64_t)(registry->hdr->count + 1) * 10 > (uint64_t)registry->hdr->cap * 7) {
+        if (grow(registry) != 0) {
+            return REGISTRY_NO_SLOT;
+        }
+        i = probe(registry, node);
+    }
+    registry->keys[i] = node;
+    memset(&registry->hot[i], 0, sizeof(NodeHot_t));
+    memset(&registry->cold[i], 0, sizeof(NodeCold_t));
+    registry->hdr->count++;
+    return (int32_t)i;
+}
+
+NodeHot_t *Registry_Hot(NodeRegistry_t *registry, int32_t slot) {
+    return &registry->hot[slot];
+}
+
+NodeCold_t *Registry_Cold(NodeRegistry_t *registry, int32_t slot) {
+    return &registry->cold[slot];
+}
+
+uint32_t Registry_Node(const NodeRegistry_t *registry, int32_t slot) {
+    return registry->keys[slot];
+}
+
+int32_t Registry_Next(const NodeRegistry_t *registry, int32_t slot) {
+    for (uint32_t i = (uint32_t)(slot + 1); i <= registry->mask; ++i) {
+        if (registry->keys[i] != REGISTRY_EMPTY) {
+            return (int32_t)i;
+        }
+    }
+    return REGISTRY_NO_SLOT;
+}
+
+uint32_t Registry_Count(const NodeRegistry_t *registry) {
+    return registry->hdr->count;
+}
+
+int Registry_PushDownlink(NodeCold_t *cold, const uint8_t *payload, uint8_t len) {
+    if (cold->downlink_count == REGISTRY_DOWNLINK_DEPTH || len > FRAME_MAX_PAYLOAD) {
+        return -1;
+    }
+    DownlinkEntry_t *e = &cold->downlink[(cold->downlink_head + cold->downlink_count) % REGISTRY_DOWNLINK_DEPTH];
+    e->len = len;
+    memcpy(e->payload, payload, len);
+    cold->downlink_count++;
+    return 0;
+}
+
+int Registry_PopDownlink(NodeCold_t *cold, DownlinkEntry_t *out) {
+    if (cold->downlink_count == 0) {
+        return -1;
+    }
+    *out = cold->downlink[cold->downlink_head];
+    cold->downlink_head = (uint8_t)((cold->downlink_head + 1) % REGISTRY_DOWNLINK_DEPTH);
+    cold->downlink_count--;
+    return 0;
+}
@@ -0,0 +1,359 @@
+#include "rollup/rollup.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hash.h"
+
+#define ROLLUP_LEVELS (SERIES_RES_COUNT - 1) // 1m, 1h, 1d
+#define STATE_MAGIC 0x31544C52u              // "RLT1"
+
+typedef struct {
+    SeriesBucket_t open;
+    SeriesBucket_t closed; // Previous bucket, mergeable until its grace ends
+} RollupLevel_t;
+
+typedef struct {
+    uint32_t node;
+    uint8_t field;
+    bool used;
+    RollupLevel_t level[ROLLUP_LEVELS];
+} RollupSeries_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+} RollupStateHeader_t;
+
+typedef struct {
+    uint32_t node;
+    uint8_t field;
+    uint8_t reserved[3];
+    RollupLevel_t level[ROLLUP_LEVELS];
+} RollupStateEntry_t;
+
+struct RollupEngine {
+    SeriesStore_t *store;
+    pthread_mutex_t lock;
+    RollupConfig_t cfg;
+    RollupSeries_t *series;
+    uint32_t cap;
+    RollupStats_t stats;
+};
+
+void Rollup_DefaultConfig(RollupConfig_t *cfg) {
+    cfg->grace_ms[SERIES_RES_RAW] = 0;
+    cfg->grace_ms[SERIES_RES_1M] = 5 * SERIES_MS_PER_MINUTE;
+    cfg->grace_ms[SERIES_RES_1H] = 15 * SERIES_MS_PER_MINUTE;
+    cfg->grace_ms[SERIES_RES_1D] = SERIES_MS_PER_HOUR;
+}
+
+RollupEngine_t *Rollup_Create(SeriesStore_t *store, const RollupConfig_t *cfg) {
+    RollupEngine_t *engine = calloc(1, sizeof(*engine));
+
+    if (!engine) {
+        return NULL;
+    }
+    engine->store = store;
+    if (cfg) {
+        engine->cfg = *cfg;
+    } else {
+        Rollup_DefaultConfig(&engine->cfg);
+    }
+    engine->cap = 1024;
+    engine->series = calloc(engine->cap, sizeof(RollupSeries_t));
+    if (!engine->series) {
+        free(engine);
+        return NULL;
+    }
+    pthread_mutex_init(&engine->lock, NULL);
+    return engine;
+}
+
+static uint64_t series_hash(uint32_t node, uint8_t field) {
+    return Hash_U64(((uint64_t)node << 8) | field);
+}
+
+static RollupSeries_t *series_find(const RollupEngine_t *engine, uint32_t node, uint8_t field) {
+    uint32_t mask = engine->cap - 1;
+    uint32_t slot = (uint32_t)series_hash(node, field) & mask;
+
+    while (engine->series[slot].used) {
+        RollupSeries_t *s = &engine->series[slot];
+        if (s->node == node && s->field == field) {
+            return s;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+static int table_grow(RollupEngine_t *engine) {
+    uint32_t cap = engine->cap * 2;
+    RollupSeries_t *series = calloc(cap, sizeof(*series));
+
+    if (!series) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < engine->cap; ++i) {
+        RollupSeries_t *s = &engine->series[i];
+        if (!s->used) {
+            continue;
+        }
+        uint32_t slot = (uint32_t)series_hash(s->node, s->field) & (cap - 1);
+        while (series[slot].used) {
+            slot = (slot + 1) & (cap - 1);
+        }
+        series[slot] = *s;
+    }
+    free(engine->series);
+    engine->series = series;
+    engine->cap = cap;
+    return 0;
+}
+
+static RollupSeries_t *series_get(RollupEngine_t *engine, uint32_t node, uint8_t field) {
+    RollupSeries_t *s = series_find(engine, node, field);
+
+    if (s) {
+        return s;
+    }
+    if ((engine->stats.series + 1) * 10 > engine->cap * 7 && table_grow(engine) != 0) {
+        return NULL;
+    }
+    uint32_t mask = engine->cap - 1;
+    uint32_t slot = (uint32_t)series_hash(node, field) & mask;
+    while (engine->series[slot].used) {
+        slot = (slot + 1) & mask;
+    }
+
+    s = &engine->series[slot];
+    s->node = node;
+    s->field = field;
+    s->used = true;
+    for (int l = 0; l < ROLLUP_LEVELS; ++l) {
+        SeriesBucket_Init(&s->level[l].open, 0);
+        SeriesBucket_Init(&s->level[l].closed, 0);
+    }
+    engine->stats.series++;
+    return s;
+}
+
+// A bucket the store refuses stays held, so the next tick or flush tries it again
+static int bucket_persist(RollupEngine_t *engine, const RollupSeries_t *s, uint8_t res, SeriesBucket_t *b) {
+    if (b->count == 0) {
+        return 0;
+    }
+    if (SeriesStore_AppendBucket(engine->store, s->node, s->field, res, b) != 0) {
+        return -1;
+    }
+    engine->stats.buckets_written++;
+    b->count = 0;
+    return 0;
+}
+
+// A sample with no held bucket to go into, written on its own; queries merge it with the bucket it amends
+static int correction_persist(RollupEngine_t *engine, const RollupSeries_t *s, uint8_t res, int64_t start,
+                              const Sample_t *sample) {
+    SeriesBucket_t fix;
+
+    SeriesBucket_Init(&fix, start);
+    SeriesBucket_Add(&fix, sample->ts, sample->value);
+    return bucket_persist(engine, s, res, &fix);
+}
+
+static int level_add(RollupEngine_t *engine, RollupSeries_t *s, uint8_t res, const Sample_t *sample) {
+    RollupLevel_t *lvl = &s->level[res - 1];
+    int64_t width = Series_ResolutionMs(res);
+    int64_t grace = engine->cfg.grace_ms[res];
+    int64_t start = Series_BucketStart(sample->ts, width);
+    int rc = 0;
+
+    if (lvl->open.count == 0 || start == lvl->open.start) {
+        if (lvl->open.count == 0) {
+            SeriesBucket_Init(&lvl->open, start);
+        }
+        SeriesBucket_Add(&lvl->open, sample->ts, sample->value);
+    } else if (start > lvl->open.start) {
+        if (bucket_persist(engine, s, res, &lvl->closed) == 0) {
+            lvl->closed = lvl->open;
+            SeriesBucket_Init(&lvl->open, start);
+            SeriesBucket_Add(&lvl->open, sample->ts, sample->value);
+        } else {
+            // Both held buckets stay for a retry, so there is no room for the new one
+            correction_persist(engine, s, res, start, sample);
+            rc = -1;
+        }
+    } else if (lvl->closed.count > 0 && start == lvl->closed.start) {
+        SeriesBucket_Add(&lvl->closed, sample->ts, sample->value);
+        engine->stats.late_merged++;
+    } else {
+        rc = correction_persist(engine, s, res, start, sample);
+        engine->stats.late_corrections++;
+    }
+
+    // Event time moved past the grace period of the previous bucket
+    if (lvl->closed.count > 0 && sample->ts >= lvl->closed.start + width + grace) {
+        rc |= bucket_persist(engine, s, res, &lvl->closed);
+    }
+    return rc;
+}
+
+int Rollup_AddSample(RollupEngine_t *engine, const Sample_t *sample) {
+    int rc = 0;
+
+    pthread_mutex_lock(&engine->lock);
+    RollupSeries_t *s = series_get(engine, sample->node, sample->field);
+    if (s) {
+        for (uint8_t res = SERIES_RES_1M; res < SERIES_RES_COUNT; ++res) {
+            rc |= level_add(engine, s, res, sample);
+        }
+        engine->stats.samples++;
+    } else {
+        rc = -1;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return rc;
+}
+
+int Rollup_Tick(RollupEngine_t *engine, int64_t now_ms) {
+    int rc = 0;
+
+    pthread_mutex_lock(&engine->lock);
+    for (uint32_t i = 0; i < engine->cap; ++i) {
+        RollupSeries_t *s = &engine->series[i];
+        if (!s->used) {
+            continue;
+        }
+        for (uint8_t res = SERIES_RES_1M; res < SERIES_RES_COUNT; ++res) {
+            RollupLevel_t *lvl = &s->level[res - 1];
+            int64_t hold = Series_ResolutionMs(res) + engine->cfg.grace_ms[res];
+            if (lvl->closed.count > 0 && now_ms >= lvl->closed.start + hold) {
+                rc |= bucket_persist(engine, s, res, &lvl->closed);
+            }
+            if (lvl->open.count > 0 && now_ms >= lvl->open.start + hold) {
+                rc |= bucket_persist(engine, s, res, &lvl->open);
+            }
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return rc;
+}
+
+int Rollup_FlushAll(RollupEngine_t *engine) {
+    int rc = 0;
+
+    pthread_mutex_lock(&engine->lock);
+    for (uint32_t i = 0; i < engine->cap; ++i) {
+        RollupSeries_t *s = &engine->series[i];
+        if (!s->used) {
+            continue;
+        }
+        for (uint8_t res = SERIES_RES_1M; res < SERIES_RES_COUNT; ++res) {
+            rc |= bucket_persist(engine, s, res, &s->level[res - 1].closed);
+            rc |= bucket_persist(engine, s, res, &s->level[res - 1].open);
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return rc;
+}
+
+int Rollup_SaveState(RollupEngine_t *engine, void **buf, size_t *len) {
+    RollupStateHeader_t hdr = {.magic = STATE_MAGIC};
+
+    pthread_mutex_lock(&engine->lock);
+    uint8_t *out = malloc(sizeof(hdr) + (size_t)engine->stats.series * sizeof(RollupStateEntry_t));
+    for (uint32_t i = 0; out && i < engine->cap; ++i) {
+        const RollupSeries_t *s = &engine->series[i];
+        bool held = false;
+        for (int l = 0; s->used && l < ROLLUP_LEVELS; ++l) {
+            held |= s->level[l].open.count > 0 || s->level[l].closed.count > 0;
+        }
+        if (held) {
+            RollupStateEntry_t e = {.node = s->node, .field = s->field};
+            memcpy(e.level, s->level, sizeof(e.level));
+            memcpy(out + sizeof(hdr) + (size_t)hdr.count++ * sizeof(e), &e, sizeof(e));
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    if (!out) {
+        return -1;
+    }
+    memcpy(out, &hdr, sizeof(hdr));
+    *buf = out;
+    *len = sizeof(hdr) + (size_t)hdr.count * sizeof(RollupStateEntry_t);
+    return 0;
+}
+
+int Rollup_LoadState(RollupEngine_t *engine, const void *buf, size_t len) {
+    const uint8_t *in = buf;
+    RollupStateHeader_t hdr;
+    int rc = 0;
+
+    if (len < sizeof(hdr)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    memcpy(&hdr, in, sizeof(hdr));
+    if (hdr.magic != STATE_MAGIC || len != sizeof(hdr) + (size_t)hdr.count * sizeof(RollupStateEntry_t)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    pthread_mutex_lock(&engine->lock);
+    for (uint32_t i = 0; i < hdr.count && rc == 0; ++i) {
+        RollupStateEntry_t e;
+        memcpy(&e, in + sizeof(hdr) + (size_t)i * sizeof(e), sizeof(e));
+        RollupSeries_t *s = series_get(engine, e.node, e.field);
+        if (s) {
+            memcpy(s->level, e.level, sizeof(s->level));
+        } else {
+            rc = -1;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return rc;
+}
+
+int Rollup_Snapshot(RollupEngine_t *engine, uint32_t node, uint8_t field, uint8_t res,
+                    int64_t from, int64_t to, SeriesSnapshot_t *snap) {
+    int rc = 0;
+
+    if (res == SERIES_RES_RAW || res >= SERIES_RES_COUNT) {
+        return -1;
+    }
+    pthread_mutex_lock(&engine->lock);
+    const RollupSeries_t *s = series_find(engine, node, field);
+    if (s) {
+        const RollupLevel_t *lvl = &s->level[res - 1];
+        const SeriesBucket_t *mem[2] = {&lvl->closed, &lvl->open};
+        for (int i = 0; i < 2 && rc == 0; ++i) {
+            if (mem[i]->count > 0 && mem[i]->start >= from && mem[i]->start < to) {
+                rc = SeriesSnapshot_PushBucket(snap, mem[i]);
+            }
+        }
+    }
+    if (rc == 0) {
+        rc = SeriesStore_Snapshot(engine->store, Series_Key(node, field, res), from, to, snap);
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return rc;
+}
+
+void Rollup_GetStats(RollupEngine_t *engine, RollupStats_t *stats) {
+    pthread_mutex_lock(&engine->lock);
+    *stats = engine->stats;
+    pthread_mutex_unlock(&engine->lock);
+}
+
+void Rollup_Destroy(RollupEngine_t *engine) {
+    if (!engine) {
+        return;
+    }
+    Rollup_FlushAll(engine);
+    pthread_mutex_destroy(&engine->lock);
+    free(engine->series);
+    free(engine);
+}
@@ -0,0 +1,300 @@
+#include "sim/fleet.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/aes.h"
+#include "proto/seal.h"
+
+#define DAY_MS 86400000.0
+
+typedef struct {
+    int64_t next_ms;
+    uint32_t node;
+    uint16_t seq;
+    bool bad;          // Gilbert-Elliott channel state
+    uint32_t held;     // Reports still to go into the current backlog
+    int64_t flush_ms;  // When the backlog is delivered
+    float phase;       // Daily cycle offset, radians
+    float temp_base;
+    float hum_base;
+    float pressure;
+    float battery;
+    FrameKey_t key;
+} SimNode_t;
+
+typedef struct {
+    Frame_t *items;
+    size_t count;
+    size_t cap;
+} FrameHeap_t;
+
+struct Fleet {
+    FleetConfig_t cfg;
+    SimNode_t *nodes;
+    uint32_t *heap; // Node indices, min-heap on next_ms
+    FrameHeap_t delayed;
+    Aes128_t master;
+    uint64_t rng;
+    FleetStats_t stats;
+};
+
+static uint64_t fleet_rand(Fleet_t *fleet) {
+    uint64_t x = fleet->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    fleet->rng = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double fleet_unit(Fleet_t *fleet) {
+    return (double)(fleet_rand(fleet) >> 11) / (double)(1ull << 53);
+}
+
+static bool chance(Fleet_t *fleet, double p) {
+    return p > 0.0 && fleet_unit(fleet) < p;
+}
+
+void Fleet_DefaultConfig(FleetConfig_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->nodes = 1000;
+    cfg->address_base = 0x1000;
+    cfg->interval_ms = 10000;
+    cfg->jitter = 0.1;
+    cfg->burst_exit = 0.3;
+    cfg->burst_loss = 0.8;
+    cfg->reorder_max_ms = 2000;
+    cfg->backlog_frames = 8;
+    cfg->seed = 1;
+}
+
+static bool node_before(const Fleet_t *fleet, uint32_t a, uint32_t b) {
+    return fleet->nodes[a].next_ms < fleet->nodes[b].next_ms;
+}
+
+static void node_sift_down(Fleet_t *fleet, size_t i) {
+    size_t n = fleet->cfg.nodes;
+
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && node_before(fleet, fleet->heap[l], fleet->heap[m])) {
+            m = l;
+        }
+        if (r < n && node_before(fleet, fleet->heap[r], fleet->heap[m])) {
+            m = r;
+        }
+        if (m == i) {
+            return;
+        }
+        uint32_t t = fleet->heap[i];
+        fleet->heap[i] = fleet->heap[m];
+        fleet->heap[m] = t;
+        i = m;
+    }
+}
+
+static int delayed_push(FrameHeap_t *h, const Frame_t *frame) {
+    if (h->count == h->cap) {
+        size_t cap = h->cap ? h->cap * 2 : 256;
+        Frame_t *items = realloc(h->items, cap * sizeof(*items));
+        if (!items) {
+            return -1;
+        }
+        h->items = items;
+        h->cap = cap;
+    }
+    size_t i = h->count++;
+    while (i > 0 && h->items[(i - 1) / 2].rx_ts > frame->rx_ts) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = *frame;
+    return 0;
+}
+
+static void delayed_pop(FrameHeap_t *h, Frame_t *out) {
+    *out = h->items[0];
+    Frame_t last = h->items[--h->count];
+    size_t i = 0, n = h->count;
+
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = l;
+        if (l >= n) {
+            break;
+        }
+        if (r < n && h->items[r].rx_ts < h->items[l].rx_ts) {
+            m = r;
+        }
+        if (last.rx_ts <= h->items[m].rx_ts) {
+            break;
+        }
+        h->items[i] = h->items[m];
+        i = m;
+    }
+    if (n > 0) {
+        h->items[i] = last;
+    }
+}
+
+static void derive_key(const Fleet_t *fleet, uint32_t node, uint8_t key[AES_KEY_LEN]) {
+    uint8_t block[AES_BLOCK_LEN] = {'n', 'o', 'd', 'e'};
+
+    memcpy(block + 4, &node, sizeof(node));
+    Aes128_Encrypt(&fleet->master, block, key);
+}
+
+Fleet_t *Fleet_Create(const FleetConfig_t *cfg, int64_t start_ms) {
+    if (cfg->nodes == 0 || cfg->interval_ms == 0) {
+        return NULL;
+    }
+    Fleet_t *fleet = calloc(1, sizeof(*fleet));
+    if (!fleet) {
+        return NULL;
+    }
+    fleet->cfg = *cfg;
+    fleet->rng = cfg->seed ? cfg->seed : 1;
+    fleet->nodes = calloc(cfg->nodes, sizeof(*fleet->nodes));
+    fleet->heap = malloc(cfg->nodes * sizeof(*fleet->heap));
+    if (!fleet->nodes || !fleet->heap) {
+        Fleet_Destroy(fleet);
+        return NULL;
+    }
+
+    uint8_t master[AES_KEY_LEN] = {0};
+    memcpy(master, &cfg->seed, sizeof(cfg->seed));
+    Aes128_Init(&fleet->master, master);
+
+    for (uint32_t i = 0; i < cfg->nodes; ++i) {
+        SimNode_t *n = &fleet->nodes[i];
+        n->node = cfg->address_base + i;
+        // Spread the first reports over one interval so the fleet starts evenly
+        n->next_ms = start_ms + (int64_t)(fleet_unit(fleet) * cfg->interval_ms);
+        n->seq = (uint16_t)fleet_rand(fleet);
+        n->phase = (float)(fleet_unit(fleet) * 0.5);
+        n->temp_base = (float)(15.0 + fleet_unit(fleet) * 10.0);
+        n->hum_base = (float)(40.0 + fleet_unit(fleet) * 30.0);
+        n->pressure = (float)(1000.0 + fleet_unit(fleet) * 25.0);
+        n->battery = (float)(3.0 + fleet_unit(fleet) * 0.3);
+        if (cfg->encrypt) {
+            uint8_t key[AES_KEY_LEN];
+            derive_key(fleet, n->node, key);
+            FrameKey_Init(&n->key, key);
+        }
+        fleet->heap[i] = i;
+    }
+    for (size_t i = cfg->nodes / 2; i-- > 0;) {
+        node_sift_down(fleet, i);
+    }
+    return fleet;
+}
+
+void Fleet_Destroy(Fleet_t *fleet) {
+    if (!fleet) {
+        return;
+    }
+    free(fleet->delayed.items);
+    free(fleet->heap);
+    free(fleet->nodes);
+    free(fleet);
+}
+
+static void build_frame(Fleet_t *fleet, SimNode_t *n, int64_t now_ms, Frame_t *frame) {
+    double day = 2.0 * M_PI * fmod((double)now_ms, DAY_MS) / DAY_MS;
+    double cycle = sin(day - M_PI / 2 + n->phase);
+
+    n->pressure += (float)((fleet_unit(fleet) - 0.5) * 0.2);
+    n->battery -= (float)(fleet_unit(fleet) * 2e-6);
+    FrameReading_t readings[4] = {
+        {FIELD_TEMPERATURE, (float)(n->temp_base + 6.0 * cycle + (fleet_unit(fleet) - 0.5) * 0.2)},
+        {FIELD_HUMIDITY, (float)(n->hum_base - 15.0 * cycle + (fleet_unit(fleet) - 0.5))},
+        {FIELD_PRESSURE, n->pressure},
+        {FIELD_BATTERY, n->battery},
+    };
+    FrameHeader_t hdr = {
+        .type = FRAME_TYPE_TELEMETRY,
+        .flags = FRAME_FLAG_NODE_TIME,
+        .node = n->node,
+        .seq = n->seq++,
+        .node_time = (uint32_t)(now_ms / 1000),
+    };
+
+    frame->rx_ts = now_ms;
+    frame->pipe = (uint8_t)(1 + n->node % 5);
+    frame->rpd = chance(fleet, 0.8);
+    frame->len = (uint8_t)Frame_Encode(frame->payload, &hdr, readings, 4);
+    if (fleet->cfg.encrypt) {
+        frame->len = (uint8_t)Frame_Seal(frame->payload, frame->len, &n->key);
+    }
+}
+
+// One report from the node at the top of the heap; true if it reached the air
+static bool report(Fleet_t *fleet, Frame_t *frame) {
+    const FleetConfig_t *cfg = &fleet->cfg;
+    SimNode_t *n = &fleet->nodes[fleet->heap[0]];
+    int64_t now = n->next_ms;
+
+    build_frame(fleet, n, now, frame);
+    double jitter = (fleet_unit(fleet) * 2.0 - 1.0) * cfg->jitter;
+    n->next_ms = now + (int64_t)(cfg->interval_ms * (1.0 + jitter));
+    node_sift_down(fleet, 0);
+
+    // A node that lost its link keeps buffering and flushes everything at once
+    if (n->held == 0 && chance(fleet, cfg->backlog)) {
+        n->held = cfg->backlog_frames;
+        n->flush_ms = now + (int64_t)cfg->backlog_frames * cfg->interval_ms;
+        fleet->stats.backlogs++;
+    }
+    if (n->held > 0) {
+        frame->rx_ts = n->flush_ms + (int64_t)(cfg->backlog_frames - n->held);
+        n->held--;
+        delayed_push(&fleet->delayed, frame);
+        return false;
+    }
+
+    n->bad = n->bad ? !chance(fleet, cfg->burst_exit) : chance(fleet, cfg->burst_enter);
+    if (chance(fleet, cfg->loss) || (n->bad && chance(fleet, cfg->burst_loss))) {
+        fleet->stats.lost++;
+        return false;
+    }
+    if (chance(fleet, cfg->duplicate)) {
+        // Retransmit after the ESB auto-retry delay
+        Frame_t dup = *frame;
+        dup.rx_ts += 1 + (int64_t)(fleet_rand(fleet) % 4);
+        if (delayed_push(&fleet->delayed, &dup) == 0) {
+            fleet->stats.duplicates++;
+        }
+    }
+    if (chance(fleet, cfg->reorder) && cfg->reorder_max_ms > 0) {
+        frame->rx_ts += 1 + (int64_t)(fleet_rand(fleet) % cfg->reorder_max_ms);
+        if (delayed_push(&fleet->delayed, frame) == 0) {
+            fleet->stats.reordered++;
+            return false;
+        }
+    }
+    return true;
+}
+
+int Fleet_Next(Fleet_t *fleet, Frame_t *frame) {
+    for (;;) {
+        const SimNode_t *top = &fleet->nodes[fleet->heap[0]];
+        if (fleet->delayed.count > 0 && fleet->delayed.items[0].rx_ts <= top->next_ms) {
+            delayed_pop(&fleet->delayed, frame);
+            break;
+        }
+        if (report(fleet, frame)) {
+            break;
+        }
+    }
+    fleet->stats.frames++;
+    return 0;
+}
+
+void Fleet_NodeKey(const Fleet_t *fleet, uint32_t node, uint8_t key[16]) {
+    derive_key(fleet, node, key);
+}
+
+void Fleet_GetStats(const Fleet_t *fleet, FleetStats_t *stats) {
+    *stats = fleet->stats;
+}
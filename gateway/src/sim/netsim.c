@@ -0,0 +1,534 @@
+#include "sim/netsim.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/crc32.h"
+#include "ota/delta.h"
+#include "proto/control.h"
+
+#define TICK_US 100000        // Downlink_Poll, as the gateway loop does when idle
+#define OTA_BOOT_US 50000     // Version report after the first frame of a boot
+#define OTA_REBOOT_US 2000000 // Installing an update and booting it
+
+typedef enum {
+    EV_WAKE = 0,
+    EV_ATTEMPT,  // Start of a retry or poll
+    EV_END,      // End of an attempt
+    EV_TICK,
+    EV_OTA,      // OTA frame due: version report or chunk request
+} EventType_t;
+
+typedef enum {
+    TX_IDLE = 0,
+    TX_FRAME,
+    TX_OTA,
+    TX_POLL,
+} TxState_t;
+
+typedef struct {
+    int64_t t;
+    uint32_t node;
+    uint32_t gen;
+    uint8_t type;
+} Event_t;
+
+typedef struct {
+    double rate;             // Local clock us per true us
+    double next_wake;        // Local us
+    uint32_t gen;            // Bumped when the wake schedule moves
+    bool slotted;            // Reporting on an assigned slot
+    bool collided;
+    uint8_t tx;              // TxState_t
+    uint8_t attempt;
+    int64_t tx_start;        // True us, current attempt
+    int64_t frame_start;     // True us, attempt that delivered the last frame
+    DownlinkMsg_t msg;       // Loaded for the poll
+    bool report_due;         // Waiting for the radio
+    bool ota_due;
+    bool ota_exchange;       // The current frame and poll are an OTA request
+    uint16_t version;
+    uint32_t ota_gen;        // Bumped when the next OTA frame moves
+    ControlOtaOffer_t fetch; // Update being fetched; to is 0 if none
+    uint32_t fetched;
+    uint8_t *buf;
+} Node_t;
+
+struct Netsim {
+    NetsimConfig_t cfg;
+    Node_t *nodes;
+    Event_t *events; // Min-heap on t
+    size_t n_events;
+    size_t cap_events;
+    uint32_t *active; // Nodes on the air
+    size_t n_active;
+    int64_t now;
+    uint64_t rng;
+    DownlinkScheduler_t *downlink;
+    SlotPlanner_t *slots;
+    NetsimStats_t stats;
+};
+
+static uint64_t sim_rand(Netsim_t *sim) {
+    uint64_t x = sim->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sim->rng = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [-1, 1)
+static double sim_sym(Netsim_t *sim) {
+    return (double)(sim_rand(sim) >> 11) / (double)(1ull << 52) - 1.0;
+}
+
+void Netsim_DefaultConfig(NetsimConfig_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->nodes = 1000;
+    cfg->address_base = 0x1000;
+    cfg->interval_ms = 10000;
+    cfg->drift_ppm = 20.0;
+    cfg->airtime_us = 1300; // 32-byte payload and ACK at 250 kbit/s
+    cfg->retry_delay_us = 1000;
+    cfg->retries = 3;
+    cfg->poll_gap_us = 500;
+    cfg->mode = NETSIM_ALOHA;
+    Slots_DefaultConfig(&cfg->slots);
+    cfg->join_jitter = 0.5;
+    cfg->ota_status_ms = 3600000;
+    cfg->ota_backoff_ms = 1000;
+    cfg->seed = 1;
+}
+
+static int push(Netsim_t *sim, int64_t t, uint32_t node, uint8_t type) {
+    if (sim->n_events == sim->cap_events) {
+        size_t cap = sim->cap_events ? sim->cap_events * 2 : 1024;
+        Event_t *events = realloc(sim->events, cap * sizeof(*events));
+        if (!events) {
+            return -1;
+        }
+        sim->events = events;
+        sim->cap_events = cap;
+    }
+    uint32_t gen = type == EV_TICK ? 0 : type == EV_OTA ? sim->nodes[node].ota_gen : sim->nodes[node].gen;
+    Event_t ev = {.t = t, .node = node, .gen = gen, .type = type};
+    size_t i = sim->n_events++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (sim->events[parent].t <= t) {
+            break;
+        }
+        sim->events[i] = sim->events[parent];
+        i = parent;
+    }
+    sim->events[i] = ev;
+    return 0;
+}
+
+static Event_t pop(Netsim_t *sim) {
+    Event_t top = sim->events[0], last = sim->events[--sim->n_events];
+    size_t i = 0;
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= sim->n_events) {
+            break;
+        }
+        if (child + 1 < sim->n_events && sim->events[child + 1].t < sim->events[child].t) {
+            child++;
+        }
+        if (last.t <= sim->events[child].t) {
+            break;
+        }
+        sim->events[i] = sim->events[child];
+        i = child;
+    }
+    if (sim->n_events > 0) {
+        sim->events[i] = last;
+    }
+    return top;
+}
+
+static int64_t true_time(const Node_t *n, double local) {
+    return (int64_t)(local / n->rate);
+}
+
+Netsim_t *Netsim_Create(const NetsimConfig_t *cfg) {
+    if (cfg->nodes == 0 || cfg->interval_ms == 0 || cfg->airtime_us == 0) {
+        return NULL;
+    }
+    Netsim_t *sim = calloc(1, sizeof(*sim));
+    if (!sim) {
+        return NULL;
+    }
+    sim->cfg = *cfg;
+    sim->rng = cfg->seed ? cfg->seed : 1;
+    sim->nodes = calloc(cfg->nodes, sizeof(*sim->nodes));
+    sim->active = malloc(cfg->nodes * sizeof(*sim->active));
+
+    DownlinkConfig_t dl_cfg;
+    Downlink_DefaultConfig(&dl_cfg);
+    dl_cfg.expected_nodes = cfg->nodes;
+    sim->downlink = Downlink_Create(&dl_cfg);
+    if (cfg->mode == NETSIM_TDMA) {
+        SlotConfig_t slot_cfg = cfg->slots;
+        slot_cfg.period_ms = cfg->interval_ms;
+        slot_cfg.expected_nodes = cfg->nodes;
+        sim->slots = Slots_Create(&slot_cfg);
+    }
+    if (!sim->nodes || !sim->active || !sim->downlink || (cfg->mode == NETSIM_TDMA && !sim->slots)) {
+        Netsim_Destroy(sim);
+        return NULL;
+    }
+    double spread = (double)(cfg->boot_spread_ms ? cfg->boot_spread_ms : cfg->interval_ms) * 1000.0;
+    for (uint32_t i = 0; i < cfg->nodes; ++i) {
+        Node_t *n = &sim->nodes[i];
+        n->rate = 1.0 + cfg->drift_ppm * 1e-6 * sim_sym(sim);
+        n->next_wake = (sim_sym(sim) + 1.0) / 2.0 * spread;
+        n->version = cfg->versions ? cfg->versions[i] : 1;
+        if (push(sim, true_time(n, n->next_wake), i, EV_WAKE) != 0 ||
+            (cfg->ota && push(sim, true_time(n, n->next_wake) + OTA_BOOT_US, i, EV_OTA) != 0)) {
+            Netsim_Destroy(sim);
+            return NULL;
+        }
+    }
+    if (push(sim, TICK_US, 0, EV_TICK) != 0) {
+        Netsim_Destroy(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+void Netsim_Destroy(Netsim_t *sim) {
+    if (!sim) {
+        return;
+    }
+    for (uint32_t i = 0; sim->nodes && i < sim->cfg.nodes; ++i) {
+        free(sim->nodes[i].buf);
+    }
+    Slots_Destroy(sim->slots);
+    Downlink_Destroy(sim->downlink);
+    free(sim->events);
+    free(sim->active);
+    free(sim->nodes);
+    free(sim);
+}
+
+static int start_attempt(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+
+    n->tx_start = sim->now;
+    n->collided = false;
+    for (size_t i = 0; i < sim->n_active; ++i) {
+        sim->nodes[sim->active[i]].collided = true;
+        n->collided = true;
+    }
+    sim->active[sim->n_active++] = node;
+    sim->stats.attempts++;
+    sim->stats.busy_us += sim->cfg.airtime_us;
+    return push(sim, sim->now + sim->cfg.airtime_us, node, EV_END);
+}
+
+// Node side of a slot message: the delay counts from the start of the delivered frame, on the node's clock
+static int apply_slot(Netsim_t *sim, uint32_t node, const ControlSlot_t *slot) {
+    Node_t *n = &sim->nodes[node];
+    double now_local = (double)sim->now * n->rate, period = (double)slot->period_ms * 1000.0;
+
+    n->next_wake = (double)n->frame_start * n->rate + (double)slot->delay_ms * 1000.0;
+    while (n->next_wake <= now_local) {
+        n->next_wake += period;
+    }
+    n->slotted = true;
+    n->gen++;
+    return push(sim, true_time(n, n->next_wake), node, EV_WAKE);
+}
+
+static int ota_schedule(Netsim_t *sim, uint32_t node, int64_t delay_us) {
+    sim->nodes[node].ota_gen++;
+    return push(sim, sim->now + delay_us, node, EV_OTA);
+}
+
+static int64_t ota_backoff(Netsim_t *sim) {
+    return (int64_t)((double)sim->cfg.ota_backoff_ms * 1000.0 * (1.0 + 0.5 * sim_sym(sim)));
+}
+
+// Next chunk request: at the offer's pace after an answer, after a random backoff if none came.
+// A slotted node moves it on so the request and its poll sit in the middle of the gap its own
+// report leaves in each slot, on its clock.
+static int fetch_next(Netsim_t *sim, uint32_t node, bool answered) {
+    Node_t *n = &sim->nodes[node];
+    int64_t delay = answered ? (int64_t)n->fetch.pace_ms * 1000 : ota_backoff(sim);
+
+    if (!n->fetch.to) {
+        return 0;
+    }
+    if (n->slotted && n->fetch.slot_ms) {
+        double exchange = 3.0 * sim->cfg.airtime_us + sim->cfg.poll_gap_us;
+        double slot = (double)n->fetch.slot_ms * 1000.0;
+        double base = n->next_wake + (slot + sim->cfg.airtime_us - exchange) / 2;
+        double t = (double)sim->now * n->rate + (double)delay;
+        t = base + ceil((t - base) / slot) * slot;
+        delay = true_time(n, t) - sim->now;
+    }
+    return ota_schedule(sim, node, delay);
+}
+
+static int start_tx(Netsim_t *sim, uint32_t node, uint8_t tx) {
+    Node_t *n = &sim->nodes[node];
+
+    n->tx = tx;
+    n->attempt = 0;
+    n->ota_exchange = tx == TX_OTA;
+    sim->stats.ota_frames += tx == TX_OTA;
+    return start_attempt(sim, node);
+}
+
+// The radio is free: what fell due meanwhile goes out, the report first
+static int go_idle(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+
+    n->tx = TX_IDLE;
+    if (n->report_due) {
+        n->report_due = false;
+        return start_tx(sim, node, TX_FRAME);
+    }
+    if (n->ota_due) {
+        n->ota_due = false;
+        return start_tx(sim, node, TX_OTA);
+    }
+    return 0;
+}
+
+static int gateway_receive(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+    uint32_t addr = sim->cfg.address_base + node;
+    int64_t rx_ms = sim->now / 1000;
+    DownlinkMsg_t msg;
+    int rc = 0;
+
+    if (n->tx == TX_OTA) {
+        FrameOta_t req = {.version = n->version, .fetching = n->fetch.to, .offset = FRAME_OTA_STATUS};
+        req.offset = n->fetch.to ? n->fetched : req.offset;
+        rc = Ota_Request(sim->cfg.ota, addr, &req, rx_ms, &msg);
+    } else {
+        // OTA requests are off-slot by nature, so only reports are checked against the slots
+        rc = sim->slots ? Slots_Observe(sim->slots, addr, rx_ms, &msg) : 0;
+        if (rc == 1 && Downlink_Enqueue(sim->downlink, &msg) != 0) {
+            return -1;
+        }
+        rc = rc < 0 ? rc : sim->cfg.ota ? Ota_Observe(sim->cfg.ota, addr, rx_ms, &msg) : 0;
+    }
+    if (rc < 0 || (rc == 1 && Downlink_Enqueue(sim->downlink, &msg) != 0)) {
+        return -1;
+    }
+    if (Downlink_Next(sim->downlink, addr, rx_ms, &n->msg) != 1) {
+        rc = n->ota_exchange ? fetch_next(sim, node, false) : 0;
+        return rc | go_idle(sim, node);
+    }
+    Control_Stamp(n->msg.payload, n->msg.len, rx_ms);
+    n->tx = TX_POLL;
+    n->attempt = 0;
+    return push(sim, sim->now + sim->cfg.airtime_us + sim->cfg.poll_gap_us, node, EV_ATTEMPT);
+}
+
+// Rebuild the image, check it, and boot it: the node reports its version once up
+static int install(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+    size_t old_len = 0, len = n->fetch.image_len;
+    const uint8_t *old = Ota_Build(sim->cfg.ota, n->version, &old_len);
+    uint8_t *img = malloc(len ? len : 1);
+    bool ok;
+
+    if (!img) {
+        return -1;
+    }
+    if (n->fetch.flags & CONTROL_OTA_DELTA) {
+        ok = old && Delta_Apply(old, old_len, n->buf, n->fetched, img, len) == (ptrdiff_t)len;
+    } else {
+        ok = n->fetched == len;
+        memcpy(img, n->buf, ok ? len : 0);
+    }
+    ok = ok && Crc32_Update(0, img, len) == n->fetch.image_crc;
+    free(img);
+    if (ok) {
+        n->version = n->fetch.to;
+        sim->stats.updates++;
+    } else {
+        sim->stats.bad_images++;
+    }
+    free(n->buf);
+    n->buf = NULL;
+    memset(&n->fetch, 0, sizeof(n->fetch));
+    n->fetched = 0;
+    return ota_schedule(sim, node, OTA_REBOOT_US);
+}
+
+static int apply_offer(Netsim_t *sim, uint32_t node, const ControlOtaOffer_t *offer) {
+    Node_t *n = &sim->nodes[node];
+
+    // Repeated while it is being fetched
+    if (n->fetch.to == offer->to && n->fetch.from == offer->from) {
+        return n->ota_exchange ? fetch_next(sim, node, true) : 0;
+    }
+    // The gateway has missed a version report: the node already runs it, or not the delta's base
+    if (offer->to == n->version || ((offer->flags & CONTROL_OTA_DELTA) && offer->from != n->version)) {
+        return n->fetch.to ? fetch_next(sim, node, true) : ota_schedule(sim, node, ota_backoff(sim));
+    }
+    uint8_t *buf = realloc(n->buf, offer->transfer_len);
+    if (!buf) {
+        return -1;
+    }
+    n->buf = buf;
+    n->fetch = *offer;
+    n->fetched = 0;
+    return fetch_next(sim, node, true);
+}
+
+static int apply_chunk(Netsim_t *sim, uint32_t node, const ControlOtaChunk_t *chunk) {
+    Node_t *n = &sim->nodes[node];
+
+    // Stale, from an earlier request
+    if (!n->fetch.to || chunk->to != n->fetch.to || chunk->offset != n->fetched ||
+        chunk->len > n->fetch.transfer_len - n->fetched) {
+        return n->ota_exchange ? fetch_next(sim, node, true) : 0;
+    }
+    memcpy(n->buf + n->fetched, chunk->data, chunk->len);
+    n->fetched += chunk->len;
+    sim->stats.chunks++;
+    return n->fetched < n->fetch.transfer_len ? fetch_next(sim, node, true) : install(sim, node);
+}
+
+static int apply_downlink(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+    ControlOtaOffer_t offer;
+    ControlOtaChunk_t chunk;
+    ControlSlot_t slot;
+
+    if (Control_DecodeOtaOffer(n->msg.payload, n->msg.len, &offer) == 0) {
+        return apply_offer(sim, node, &offer);
+    }
+    if (Control_DecodeOtaChunk(n->msg.payload, n->msg.len, &chunk) == 0) {
+        return apply_chunk(sim, node, &chunk);
+    }
+    int rc = Control_DecodeSlot(n->msg.payload, n->msg.len, &slot) == 0 ? apply_slot(sim, node, &slot) : 0;
+    // Another message took the ACK payload: ask for the chunk again
+    return rc | (n->ota_exchange ? fetch_next(sim, node, true) : 0);
+}
+
+static int attempt_end(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+
+    for (size_t i = 0; i < sim->n_active; ++i) {
+        if (sim->active[i] == node) {
+            sim->active[i] = sim->active[--sim->n_active];
+            break;
+        }
+    }
+    if (n->collided) {
+        sim->stats.collided++;
+        // OTA exchanges are single attempts, see netsim.h
+        if (n->attempt < (n->ota_exchange ? 0 : sim->cfg.retries)) {
+            n->attempt++;
+            return push(sim, sim->now + sim->cfg.retry_delay_us, node, EV_ATTEMPT);
+        }
+        // A lost poll loses its payload with it, as the gateway has handed it to the radio.
+        // A lost version report is sent again.
+        sim->stats.lost += n->tx == TX_FRAME;
+        int rc = 0;
+        if (n->ota_exchange) {
+            rc = n->fetch.to ? fetch_next(sim, node, false) : ota_schedule(sim, node, ota_backoff(sim));
+        }
+        return rc | go_idle(sim, node);
+    }
+    if (n->tx == TX_FRAME || n->tx == TX_OTA) {
+        sim->stats.delivered += n->tx == TX_FRAME;
+        n->frame_start = n->tx_start;
+        return gateway_receive(sim, node);
+    }
+    sim->stats.downlink++;
+    int rc = apply_downlink(sim, node);
+    return rc | go_idle(sim, node);
+}
+
+static int wake(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+    double interval = (double)sim->cfg.interval_ms * 1000.0;
+    double jitter = n->slotted ? 0.0 : sim->cfg.mode == NETSIM_TDMA ? sim->cfg.join_jitter : sim->cfg.jitter;
+
+    n->next_wake += interval * (1.0 + jitter * sim_sym(sim));
+    if (push(sim, true_time(n, n->next_wake), node, EV_WAKE) != 0) {
+        return -1;
+    }
+    sim->stats.reports++;
+    if (n->tx != TX_IDLE) {
+        n->report_due = true;
+        return 0;
+    }
+    return start_tx(sim, node, TX_FRAME);
+}
+
+// Version report, on its own schedule while not fetching, or the next chunk request
+static int ota_due(Netsim_t *sim, uint32_t node) {
+    Node_t *n = &sim->nodes[node];
+
+    if (!n->fetch.to && ota_schedule(sim, node, (int64_t)sim->cfg.ota_status_ms * 1000) != 0) {
+        return -1;
+    }
+    if (n->tx != TX_IDLE) {
+        n->ota_due = true;
+        return 0;
+    }
+    return start_tx(sim, node, TX_OTA);
+}
+
+int Netsim_Run(Netsim_t *sim, int64_t duration_ms) {
+    int64_t end = sim->now + duration_ms * 1000;
+
+    while (sim->n_events > 0 && sim->events[0].t <= end) {
+        Event_t ev = pop(sim);
+        int rc = 0;
+        sim->now = ev.t;
+        switch (ev.type) {
+        case EV_WAKE:
+            // Superseded by a slot assignment
+            rc = ev.gen == sim->nodes[ev.node].gen ? wake(sim, ev.node) : 0;
+            break;
+        case EV_ATTEMPT:
+            if (sim->nodes[ev.node].tx == TX_POLL && sim->nodes[ev.node].attempt == 0) {
+                sim->stats.polls++;
+            }
+            rc = start_attempt(sim, ev.node);
+            break;
+        case EV_END:
+            rc = attempt_end(sim, ev.node);
+            break;
+        case EV_OTA:
+            rc = ev.gen == sim->nodes[ev.node].ota_gen ? ota_due(sim, ev.node) : 0;
+            break;
+        case EV_TICK:
+            Downlink_Poll(sim->downlink, sim->now / 1000);
+            rc = push(sim, sim->now + TICK_US, 0, EV_TICK);
+            break;
+        }
+        if (rc != 0) {
+            return -1;
+        }
+    }
+    sim->now = end;
+    return 0;
+}
+
+DownlinkScheduler_t *Netsim_Downlink(Netsim_t *sim) {
+    return sim->downlink;
+}
+
+void Netsim_GetStats(const Netsim_t *sim, NetsimStats_t *stats) {
+    *stats = sim->stats;
+}
+
+const SlotPlanner_t *Netsim_Slots(const Netsim_t *sim) {
+    return sim->slots;
+}
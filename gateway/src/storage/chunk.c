@@ -0,0 +1,374 @@
+#include "storage/chunk.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "common/crc32.h"
+
+#define RAW_RECORD_BYTES (sizeof(int64_t) + sizeof(float))
+#define ROLLUP_RECORD_BYTES (2 * sizeof(int64_t) + sizeof(double) + sizeof(uint32_t) + 3 * sizeof(float))
+
+size_t Chunk_RawSize(uint32_t count) {
+    return sizeof(ChunkHeader_t) + (size_t)count * RAW_RECORD_BYTES;
+}
+
+size_t Chunk_RollupSize(uint32_t count) {
+    return sizeof(ChunkHeader_t) + (size_t)count * ROLLUP_RECORD_BYTES;
+}
+
+static void header_init(ChunkHeader_t *hdr, uint32_t node, uint8_t field, uint8_t res, uint32_t count) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = CHUNK_MAGIC;
+    hdr->version = CHUNK_VERSION;
+    hdr->res = res;
+    hdr->field = field;
+    hdr->encoding = CHUNK_ENC_PLAIN;
+    hdr->node = node;
+    hdr->count = count;
+}
+
+static void header_seal(ChunkHeader_t *hdr, const uint8_t *payload) {
+    hdr->crc = 0;
+    uint32_t crc = Crc32_Update(0, hdr, sizeof(*hdr));
+    hdr->crc = Crc32_Update(crc, payload, hdr->payload_len);
+}
+
+// Columns are copied one after another; p advances past each
+static uint8_t *put(uint8_t *p, const void *src, size_t len) {
+    memcpy(p, src, len);
+    return p + len;
+}
+
+static void raw_header(ChunkHeader_t *hdr, uint32_t node, uint8_t field, const int64_t *ts, const float *values,
+                       uint32_t count) {
+    header_init(hdr, node, field, SERIES_RES_RAW, count);
+    if (count > 0) {
+        hdr->t_min = ts[0];
+        hdr->t_max = ts[count - 1];
+        hdr->v_min = hdr->v_max = values[0];
+        for (uint32_t i = 1; i < count; ++i) {
+            if (values[i] < hdr->v_min) {
+                hdr->v_min = values[i];
+            }
+            if (values[i] > hdr->v_max) {
+                hdr->v_max = values[i];
+            }
+        }
+    }
+}
+
+size_t Chunk_EncodeRaw(void *buf, uint32_t node, uint8_t field,
+                       const int64_t *ts, const float *values, uint32_t count) {
+    ChunkHeader_t hdr;
+    uint8_t *payload = (uint8_t *)buf + sizeof(hdr);
+    uint8_t *p = payload;
+
+    raw_header(&hdr, node, field, ts, values, count);
+    p = put(p, ts, count * sizeof(int64_t));
+    p = put(p, values, count * sizeof(float));
+    hdr.payload_len = (uint32_t)(p - payload);
+    header_seal(&hdr, payload);
+    memcpy(buf, &hdr, sizeof(hdr));
+    return (size_t)(p - (uint8_t *)buf);
+}
+
+// MSB first; overflow is sticky and stops all further writes
+typedef struct {
+    uint8_t *p;
+    uint8_t *end;
+    uint64_t acc; // Pending bits, right-aligned
+    uint32_t n;
+    bool overflow;
+} BitWriter_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t acc;
+    uint32_t n;
+    bool overflow;
+} BitReader_t;
+
+static void byte_put(BitWriter_t *w, uint8_t b) {
+    if (w->p == w->end) {
+        w->overflow = true;
+        return;
+    }
+    *w->p++ = b;
+}
+
+// n <= 32
+static void bits_put(BitWriter_t *w, uint32_t v, uint32_t n) {
+    if (w->overflow) {
+        return;
+    }
+    w->acc = (w->acc << n) | (v & ((1ull << n) - 1));
+    w->n += n;
+    while (w->n >= 8) {
+        w->n -= 8;
+        byte_put(w, (uint8_t)(w->acc >> w->n));
+    }
+}
+
+static void bits_flush(BitWriter_t *w) {
+    if (w->n > 0 && !w->overflow) {
+        byte_put(w, (uint8_t)(w->acc << (8 - w->n)));
+        w->n = 0;
+    }
+}
+
+static uint32_t bits_get(BitReader_t *r, uint32_t n) {
+    while (r->n < n) {
+        if (r->p == r->end) {
+            r->overflow = true;
+            return 0;
+        }
+        r->acc = (r->acc << 8) | *r->p++;
+        r->n += 8;
+    }
+    r->n -= n;
+    return (uint32_t)((r->acc >> r->n) & ((1ull << n) - 1));
+}
+
+static void varint_put(BitWriter_t *w, uint64_t v) {
+    while (v >= 0x80) {
+        byte_put(w, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    byte_put(w, (uint8_t)v);
+}
+
+static uint64_t varint_get(BitReader_t *r) {
+    uint64_t v = 0;
+
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (r->p == r->end) {
+            break;
+        }
+        uint8_t b = *r->p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    r->overflow = true;
+    return 0;
+}
+
+/*
+ * Timestamps as zigzag varints of their delta-of-delta after the first, then
+ * values XORed with the previous one in a bit stream: 0 for a repeat, 10 and
+ * the meaningful bits when they fit the previous window, else 11, 5 bits of
+ * leading zeros, 5 of length - 1 and the bits. Regular samples of a slowly
+ * moving value take a byte or two of time and a few bits of value.
+ */
+size_t Chunk_EncodeRawPacked(void *buf, uint32_t node, uint8_t field,
+                             const int64_t *ts, const float *values, uint32_t count) {
+    ChunkHeader_t hdr;
+    uint8_t *payload = (uint8_t *)buf + sizeof(hdr);
+    BitWriter_t w = {.p = payload, .end = payload + count * RAW_RECORD_BYTES};
+    uint64_t prev_delta = 0;
+    uint32_t prev, cur;
+    int lead = -1, trail = 0;
+
+    if (count == 0) {
+        return Chunk_EncodeRaw(buf, node, field, ts, values, count);
+    }
+    raw_header(&hdr, node, field, ts, values, count);
+    for (size_t i = 0; i < sizeof(int64_t); ++i) {
+        byte_put(&w, (uint8_t)((uint64_t)ts[0] >> (8 * i)));
+    }
+    for (uint32_t i = 1; i < count && !w.overflow; ++i) {
+        uint64_t delta = (uint64_t)ts[i] - (uint64_t)ts[i - 1];
+        int64_t dod = (int64_t)(delta - prev_delta);
+        prev_delta = delta;
+        varint_put(&w, ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63));
+    }
+    memcpy(&prev, &values[0], sizeof(prev));
+    bits_put(&w, prev, 32);
+    for (uint32_t i = 1; i < count && !w.overflow; ++i) {
+        memcpy(&cur, &values[i], sizeof(cur));
+        uint32_t x = cur ^ prev;
+        prev = cur;
+        if (x == 0) {
+            bits_put(&w, 0, 1);
+            continue;
+        }
+        int l = __builtin_clz(x), t = __builtin_ctz(x);
+        if (lead >= 0 && l >= lead && t >= trail) {
+            bits_put(&w, 2, 2);
+            bits_put(&w, x >> trail, (uint32_t)(32 - lead - trail));
+        } else {
+            lead = l;
+            trail = t;
+            bits_put(&w, 3, 2);
+            bits_put(&w, (uint32_t)l, 5);
+            bits_put(&w, (uint32_t)(32 - l - t - 1), 5);
+            bits_put(&w, x >> t, (uint32_t)(32 - l - t));
+        }
+    }
+    bits_flush(&w);
+    // Noise that does not pack is kept plain, so a chunk never outgrows Chunk_RawSize
+    if (w.overflow || w.p == w.end) {
+        return Chunk_EncodeRaw(buf, node, field, ts, values, count);
+    }
+    hdr.encoding = CHUNK_ENC_PACKED;
+    hdr.payload_len = (uint32_t)(w.p - payload);
+    header_seal(&hdr, payload);
+    memcpy(buf, &hdr, sizeof(hdr));
+    return sizeof(hdr) + hdr.payload_len;
+}
+
+static int decode_packed(const ChunkHeader_t *hdr, const uint8_t *payload, int64_t *ts, float *values) {
+    BitReader_t r = {.p = payload, .end = payload + hdr->payload_len};
+    uint64_t t0 = 0, delta = 0;
+    uint32_t prev;
+    int lead = 0, trail = 0;
+
+    if (hdr->count == 0 || hdr->payload_len < sizeof(int64_t)) {
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(int64_t); ++i) {
+        t0 |= (uint64_t)*r.p++ << (8 * i);
+    }
+    ts[0] = (int64_t)t0;
+    for (uint32_t i = 1; i < hdr->count; ++i) {
+        uint64_t z = varint_get(&r);
+        delta += (z >> 1) ^ (0 - (z & 1));
+        ts[i] = (int64_t)((uint64_t)ts[i - 1] + delta);
+    }
+    prev = bits_get(&r, 32);
+    memcpy(&values[0], &prev, sizeof(prev));
+    for (uint32_t i = 1; i < hdr->count && !r.overflow; ++i) {
+        if (bits_get(&r, 1)) {
+            if (bits_get(&r, 1)) {
+                lead = (int)bits_get(&r, 5);
+                int len = (int)bits_get(&r, 5) + 1;
+                if (lead + len > 32) {
+                    return -1;
+                }
+                trail = 32 - lead - len;
+            }
+            prev ^= bits_get(&r, (uint32_t)(32 - lead - trail)) << trail;
+        }
+        memcpy(&values[i], &prev, sizeof(prev));
+    }
+    return r.overflow ? -1 : 0;
+}
+
+size_t Chunk_EncodeRollup(void *buf, uint32_t node, uint8_t field, uint8_t res,
+                          const SeriesBucket_t *buckets, uint32_t count) {
+    ChunkHeader_t hdr;
+    uint8_t *payload = (uint8_t *)buf + sizeof(hdr);
+    uint8_t *p = payload;
+
+    header_init(&hdr, node, field, res, count);
+    if (count > 0) {
+        hdr.t_min = buckets[0].start;
+        hdr.t_max = buckets[count - 1].start;
+        hdr.v_min = buckets[0].min;
+        hdr.v_max = buckets[0].max;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        p = put(p, &buckets[i].start, sizeof(int64_t));
+        if (buckets[i].min < hdr.v_min) {
+            hdr.v_min = buckets[i].min;
+        }
+        if (buckets[i].max > hdr.v_max) {
+            hdr.v_max = buckets[i].max;
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        p = put(p, &buckets[i].last_ts, sizeof(int64_t));
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        p = put(p, &buckets[i].sum, sizeof(double));
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        p = put(p, &buckets[i].count, sizeof(uint32_t));
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        p = put(p, &buckets[i].min, sizeof(float));
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        p = put(p, &buckets[i].max, sizeof(float));
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        p = put(p, &buckets[i].last, sizeof(float));
+    }
+    hdr.payload_len = (uint32_t)(p - payload);
+    header_seal(&hdr, payload);
+    memcpy(buf, &hdr, sizeof(hdr));
+    return (size_t)(p - (uint8_t *)buf);
+}
+
+bool Chunk_HeaderValid(const ChunkHeader_t *hdr) {
+    if (hdr->magic != CHUNK_MAGIC || hdr->version != CHUNK_VERSION) {
+        return false;
+    }
+    if (hdr->res >= SERIES_RES_COUNT || hdr->count > CHUNK_MAX_RECORDS) {
+        return false;
+    }
+    size_t expect = hdr->res == SERIES_RES_RAW ? Chunk_RawSize(hdr->count) : Chunk_RollupSize(hdr->count);
+    if (hdr->encoding == CHUNK_ENC_PACKED) {
+        return hdr->res == SERIES_RES_RAW && hdr->count > 0 && hdr->payload_len < expect - sizeof(*hdr);
+    }
+    return hdr->encoding == CHUNK_ENC_PLAIN && hdr->payload_len == expect - sizeof(*hdr);
+}
+
+bool Chunk_Verify(const ChunkHeader_t *hdr, const void *payload) {
+    ChunkHeader_t tmp = *hdr;
+
+    tmp.crc = 0;
+    uint32_t crc = Crc32_Update(0, &tmp, sizeof(tmp));
+    return Crc32_Update(crc, payload, hdr->payload_len) == hdr->crc;
+}
+
+int Chunk_DecodeRaw(const ChunkHeader_t *hdr, const void *payload, int64_t *ts, float *values) {
+    const uint8_t *p = payload;
+
+    if (hdr->res != SERIES_RES_RAW) {
+        return -1;
+    }
+    if (hdr->encoding == CHUNK_ENC_PACKED) {
+        return decode_packed(hdr, p, ts, values);
+    }
+    if (hdr->encoding != CHUNK_ENC_PLAIN) {
+        return -1;
+    }
+    memcpy(ts, p, hdr->count * sizeof(int64_t));
+    p += hdr->count * sizeof(int64_t);
+    memcpy(values, p, hdr->count * sizeof(float));
+    return 0;
+}
+
+int Chunk_DecodeRollup(const ChunkHeader_t *hdr, const void *payload, SeriesBucket_t *buckets) {
+    const uint8_t *p = payload;
+    uint32_t n = hdr->count;
+
+    if (hdr->res == SERIES_RES_RAW || hdr->encoding != CHUNK_ENC_PLAIN) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(int64_t)) {
+        memcpy(&buckets[i].start, p, sizeof(int64_t));
+    }
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(int64_t)) {
+        memcpy(&buckets[i].last_ts, p, sizeof(int64_t));
+    }
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(double)) {
+        memcpy(&buckets[i].sum, p, sizeof(double));
+    }
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(uint32_t)) {
+        memcpy(&buckets[i].count, p, sizeof(uint32_t));
+    }
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(float)) {
+        memcpy(&buckets[i].min, p, sizeof(float));
+    }
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(float)) {
+        memcpy(&buckets[i].max, p, sizeof(float));
+    }
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(float)) {
+        memcpy(&buckets[i].last, p, sizeof(float));
+    }
+    return 0;
+}
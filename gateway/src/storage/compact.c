@@ -0,0 +1,210 @@
+#include "storage/compact.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BURST_S 1
+
+struct Compactor {
+    SeriesStore_t *store;
+    CompactorConfig_t cfg;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stop;
+    double tokens; // Bytes that may go before the next wait
+    uint64_t refill_ns;
+    CompactorStats_t stats;
+};
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Sleeps until ns from now or a stop; returns true if stopping. Called with the lock held.
+static bool wait_for(Compactor_t *c, uint64_t ns) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t t = (uint64_t)ts.tv_nsec + ns;
+    ts.tv_sec += (time_t)(t / 1000000000ull);
+    ts.tv_nsec = (long)(t % 1000000000ull);
+    while (!c->stop && pthread_cond_timedwait(&c->wake, &c->lock, &ts) != ETIMEDOUT) {
+    }
+    return c->stop;
+}
+
+// SeriesStore_ThrottleFn: a token bucket over the bytes read and written
+static int throttle(void *ctx, size_t bytes) {
+    Compactor_t *c = ctx;
+    double rate = (double)c->cfg.bytes_per_s;
+
+    pthread_mutex_lock(&c->lock);
+    if (rate > 0) {
+        uint64_t now = mono_ns();
+        c->tokens += rate * (double)(now - c->refill_ns) / 1e9;
+        if (c->tokens > rate * BURST_S) {
+            c->tokens = rate * BURST_S;
+        }
+        c->refill_ns = now;
+        c->tokens -= (double)bytes;
+        if (c->tokens < 0) {
+            uint64_t ns = (uint64_t)(-c->tokens / rate * 1e9);
+            c->stats.throttled_ns += ns;
+            wait_for(c, ns);
+        }
+    }
+    int rc = c->stop ? -1 : 0;
+    pthread_mutex_unlock(&c->lock);
+    return rc;
+}
+
+// Everything due in every resolution, one segment at a time
+static void pass(Compactor_t *c) {
+    int64_t now = wall_ms();
+
+    for (uint8_t r = 0; r < SERIES_RES_COUNT; ++r) {
+        int64_t cutoff = c->cfg.retention_ms[r] > 0 ? now - c->cfg.retention_ms[r] : INT64_MIN;
+        for (;;) {
+            SeriesCompactStats_t st = {0};
+            uint64_t start = mono_ns();
+            int rc = SeriesStore_Compact(c->store, r, cutoff, throttle, c, &st);
+            int err = errno;
+
+            pthread_mutex_lock(&c->lock);
+            SeriesCompactStats_t *t = &c->stats.store;
+            t->segments += st.segments;
+            t->dropped += st.dropped;
+            t->chunks_in += st.chunks_in;
+            t->chunks_out += st.chunks_out;
+            t->records_in += st.records_in;
+            t->records_expired += st.records_expired;
+            t->bytes_read += st.bytes_read;
+            t->bytes_written += st.bytes_written;
+            t->bytes_reclaimed += st.bytes_reclaimed;
+            c->stats.busy_ns += mono_ns() - start;
+            c->stats.errors += rc < 0 && err != ECANCELED;
+            bool stop = c->stop;
+            pthread_mutex_unlock(&c->lock);
+            // A failed segment is skipped by the next call, but one past retention would be tried again
+            if (rc != 1 || stop) {
+                break;
+            }
+        }
+    }
+}
+
+static void *compactor_thread(void *arg) {
+    Compactor_t *c = arg;
+
+    pthread_mutex_lock(&c->lock);
+    while (!c->stop) {
+        pthread_mutex_unlock(&c->lock);
+        pass(c);
+        pthread_mutex_lock(&c->lock);
+        c->stats.passes++;
+        wait_for(c, (uint64_t)c->cfg.interval_ms * 1000000ull);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+static void collect(void *ctx, FILE *out) {
+    CompactorStats_t st;
+
+    Compactor_GetStats(ctx, &st);
+    Metrics_WriteValue(out, "gateway_compact_segments_total", "Segments compacted or dropped", METRIC_COUNTER,
+                       (double)st.store.segments);
+    Metrics_WriteValue(out, "gateway_compact_dropped_segments_total", "Segments dropped past retention",
+                       METRIC_COUNTER, (double)st.store.dropped);
+    Metrics_WriteValue(out, "gateway_compact_expired_records_total", "Records dropped past retention",
+                       METRIC_COUNTER, (double)st.store.records_expired);
+    Metrics_WriteValue(out, "gateway_compact_read_bytes_total", "Chunk bytes read by compaction", METRIC_COUNTER,
+                       (double)st.store.bytes_read);
+    Metrics_WriteValue(out, "gateway_compact_written_bytes_total", "Segment bytes written by compaction",
+                       METRIC_COUNTER, (double)st.store.bytes_written);
+    Metrics_WriteValue(out, "gateway_compact_reclaimed_bytes_total", "Disk space freed by compaction",
+                       METRIC_COUNTER, (double)st.store.bytes_reclaimed);
+    Metrics_WriteValue(out, "gateway_compact_errors_total", "Segments that failed to compact", METRIC_COUNTER,
+                       (double)st.errors);
+    Metrics_WriteValue(out, "gateway_compact_busy_seconds_total", "Time spent compacting", METRIC_COUNTER,
+                       (double)st.busy_ns / 1e9);
+    Metrics_WriteValue(out, "gateway_compact_throttled_seconds_total", "Time compaction waited on its rate limit",
+                       METRIC_COUNTER, (double)st.throttled_ns / 1e9);
+}
+
+void Compactor_DefaultConfig(CompactorConfig_t *cfg) {
+    cfg->retention_ms[SERIES_RES_RAW] = 30 * SERIES_MS_PER_DAY;
+    cfg->retention_ms[SERIES_RES_1M] = 365 * SERIES_MS_PER_DAY;
+    cfg->retention_ms[SERIES_RES_1H] = 0;
+    cfg->retention_ms[SERIES_RES_1D] = 0;
+    cfg->bytes_per_s = 4u << 20;
+    cfg->interval_ms = 60000;
+    cfg->metrics = NULL;
+}
+
+Compactor_t *Compactor_Start(SeriesStore_t *store, const CompactorConfig_t *cfg) {
+    pthread_condattr_t attr;
+
+    if (cfg->interval_ms == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    Compactor_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        return NULL;
+    }
+    c->store = store;
+    c->cfg = *cfg;
+    c->tokens = (double)cfg->bytes_per_s * BURST_S;
+    c->refill_ns = mono_ns();
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&c->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&c->thread, NULL, compactor_thread, c) != 0) {
+        pthread_cond_destroy(&c->wake);
+        pthread_mutex_destroy(&c->lock);
+        free(c);
+        return NULL;
+    }
+    if (cfg->metrics) {
+        Metrics_AddCollector(cfg->metrics, collect, c);
+    }
+    return c;
+}
+
+void Compactor_Stop(Compactor_t *c) {
+    if (!c) {
+        return;
+    }
+    if (c->cfg.metrics) {
+        Metrics_RemoveCollector(c->cfg.metrics, collect, c);
+    }
+    pthread_mutex_lock(&c->lock);
+    c->stop = true;
+    pthread_cond_broadcast(&c->wake);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+    pthread_cond_destroy(&c->wake);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+void Compactor_GetStats(Compactor_t *c, CompactorStats_t *stats) {
+    pthread_mutex_lock(&c->lock);
+    *stats = c->stats;
+    pthread_mutex_unlock(&c->lock);
+}
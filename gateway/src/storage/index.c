@@ -0,0 +1,285 @@
+#include "storage/index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hash.h"
+
+typedef struct {
+    SeriesKey_t key;
+    bool used;
+    uint32_t count;
+    uint32_t cap;
+    ChunkRef_t *refs;    // Sorted by t_min
+    int64_t *t_max_run;  // t_max_run[i] = max(refs[0..i].t_max)
+} IndexSeries_t;
+
+struct TimeIndex {
+    IndexSeries_t *series;
+    uint32_t cap;
+    uint32_t used;
+    uint64_t chunks;
+};
+
+TimeIndex_t *TimeIndex_Create(void) {
+    TimeIndex_t *index = calloc(1, sizeof(*index));
+
+    if (!index) {
+        return NULL;
+    }
+    index->cap = 1024;
+    index->series = calloc(index->cap, sizeof(IndexSeries_t));
+    if (!index->series) {
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+void TimeIndex_Destroy(TimeIndex_t *index) {
+    if (!index) {
+        return;
+    }
+    for (uint32_t i = 0; i < index->cap; ++i) {
+        free(index->series[i].refs);
+        free(index->series[i].t_max_run);
+    }
+    free(index->series);
+    free(index);
+}
+
+static IndexSeries_t *series_find(const TimeIndex_t *index, SeriesKey_t key) {
+    uint32_t mask = index->cap - 1;
+    uint32_t slot = (uint32_t)Hash_U64(key) & mask;
+
+    while (index->series[slot].used) {
+        if (index->series[slot].key == key) {
+            return &index->series[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+static int table_grow(TimeIndex_t *index) {
+    uint32_t cap = index->cap * 2;
+    IndexSeries_t *series = calloc(cap, sizeof(*series));
+
+    if (!series) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < index->cap; ++i) {
+        if (!index->series[i].used) {
+            continue;
+        }
+        uint32_t slot = (uint32_t)Hash_U64(index->series[i].key) & (cap - 1);
+        while (series[slot].used) {
+            slot = (slot + 1) & (cap - 1);
+        }
+        series[slot] = index->series[i];
+    }
+    free(index->series);
+    index->series = series;
+    index->cap = cap;
+    return 0;
+}
+
+static IndexSeries_t *series_get(TimeIndex_t *index, SeriesKey_t key) {
+    IndexSeries_t *s = series_find(index, key);
+
+    if (s) {
+        return s;
+    }
+    if ((index->used + 1) * 10 > index->cap * 7 && table_grow(index) != 0) {
+        return NULL;
+    }
+    uint32_t slot = (uint32_t)Hash_U64(key) & (index->cap - 1);
+    while (index->series[slot].used) {
+        slot = (slot + 1) & (index->cap - 1);
+    }
+    s = &index->series[slot];
+    s->key = key;
+    s->used = true;
+    index->used++;
+    return s;
+}
+
+// Recompute the running end from position from on
+static void run_update(IndexSeries_t *s, uint32_t from) {
+    for (uint32_t i = from; i < s->count; ++i) {
+        int64_t prev = i > 0 ? s->t_max_run[i - 1] : INT64_MIN;
+        s->t_max_run[i] = s->refs[i].t_max > prev ? s->refs[i].t_max : prev;
+    }
+}
+
+static int series_reserve(IndexSeries_t *s, uint32_t want) {
+    if (want <= s->cap) {
+        return 0;
+    }
+    uint32_t cap = s->cap ? s->cap * 2 : 8;
+    while (cap < want) {
+        cap *= 2;
+    }
+    ChunkRef_t *refs = realloc(s->refs, cap * sizeof(*refs));
+    if (!refs) {
+        return -1;
+    }
+    s->refs = refs;
+    int64_t *run = realloc(s->t_max_run, cap * sizeof(*run));
+    if (!run) {
+        return -1;
+    }
+    s->t_max_run = run;
+    s->cap = cap;
+    return 0;
+}
+
+int TimeIndex_Add(TimeIndex_t *index, SeriesKey_t key, const ChunkRef_t *ref) {
+    IndexSeries_t *s = series_get(index, key);
+
+    if (!s || series_reserve(s, s->count + 1) != 0) {
+        return -1;
+    }
+
+    // Chunks are sealed roughly in time order, so the slot is almost always the tail
+    uint32_t pos = s->count;
+    while (pos > 0 && s->refs[pos - 1].t_min > ref->t_min) {
+        --pos;
+    }
+    memmove(&s->refs[pos + 1], &s->refs[pos], (s->count - pos) * sizeof(*s->refs));
+    s->refs[pos] = *ref;
+    s->count++;
+    run_update(s, pos);
+    index->chunks++;
+    return 0;
+}
+
+int TimeIndex_Replace(TimeIndex_t *index, SeriesKey_t key, uint32_t segment, uint16_t gen, const ChunkRef_t *refs,
+                      uint32_t n) {
+    IndexSeries_t *s = n > 0 ? series_get(index, key) : series_find(index, key);
+    uint32_t old = 0, kept = 0, from;
+
+    if (!s) {
+        return n > 0 ? -1 : 0;
+    }
+    for (uint32_t i = 0; i < s->count; ++i) {
+        old += s->refs[i].loc.segment == segment && s->refs[i].loc.gen == gen;
+    }
+    if (series_reserve(s, s->count - old + n) != 0) {
+        return -1;
+    }
+    from = s->count;
+    for (uint32_t i = 0; i < s->count; ++i) {
+        if (s->refs[i].loc.segment == segment && s->refs[i].loc.gen == gen) {
+            from = from < kept ? from : kept;
+            continue;
+        }
+        s->refs[kept++] = s->refs[i];
+    }
+    index->chunks -= s->count - kept;
+
+    // Merged in from the back, one pass for the whole run
+    uint32_t i = kept, j = n, k = kept + n;
+    while (j > 0) {
+        if (i > 0 && s->refs[i - 1].t_min > refs[j - 1].t_min) {
+            s->refs[--k] = s->refs[--i];
+        } else {
+            s->refs[--k] = refs[--j];
+        }
+    }
+    from = from < k ? from : k;
+    s->count = kept + n;
+    index->chunks += n;
+    run_update(s, from);
+    return 0;
+}
+
+int TimeIndex_Find(const TimeIndex_t *index, SeriesKey_t key, int64_t from, int64_t to, ChunkRefList_t *out) {
+    const IndexSeries_t *s = series_find(index, key);
+
+    if (!s || from >= to) {
+        return 0;
+    }
+    // First chunk whose running end reaches from
+    uint32_t lo = 0, hi = s->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (s->t_max_run[mid] < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    uint32_t first = lo;
+
+    // First chunk starting at or after to
+    lo = first;
+    hi = s->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (s->refs[mid].t_min < to) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (uint32_t i = first; i < lo; ++i) {
+        if (s->refs[i].t_max >= from && ChunkRefList_Push(out, &s->refs[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+bool TimeIndex_Last(const TimeIndex_t *index, SeriesKey_t key, ChunkRef_t *out) {
+    const IndexSeries_t *s = series_find(index, key);
+
+    if (!s || s->count == 0) {
+        return false;
+    }
+    int64_t newest = s->t_max_run[s->count - 1];
+    for (uint32_t i = s->count; i-- > 0;) {
+        if (s->refs[i].t_max == newest) {
+            *out = s->refs[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t TimeIndex_ChunkCount(const TimeIndex_t *index) {
+    return index->chunks;
+}
+
+int TimeIndex_ForEachSeries(const TimeIndex_t *index, TimeIndex_SeriesFn fn, void *ctx) {
+    for (uint32_t i = 0; i < index->cap; ++i) {
+        if (index->series[i].used && index->series[i].count > 0) {
+            int rc = fn(index->series[i].key, ctx);
+            if (rc != 0) {
+                return rc;
+            }
+        }
+    }
+    return 0;
+}
+
+int ChunkRefList_Push(ChunkRefList_t *list, const ChunkRef_t *ref) {
+    if (list->count == list->cap) {
+        uint32_t cap = list->cap ? list->cap * 2 : 16;
+        ChunkRef_t *refs = realloc(list->refs, cap * sizeof(*refs));
+        if (!refs) {
+            return -1;
+        }
+        list->refs = refs;
+        list->cap = cap;
+    }
+    list->refs[list->count++] = *ref;
+    return 0;
+}
+
+void ChunkRefList_Free(ChunkRefList_t *list) {
+    free(list->refs);
+    list->refs = NULL;
+    list->count = 0;
+    list->cap = 0;
+}
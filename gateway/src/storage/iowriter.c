@@ -0,0 +1,438 @@
+#include "storage/iowriter.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// One queued or in-flight operation, kept until it and all before it finish
+typedef struct {
+    size_t consumed; // Arena bytes released when retired, including wrap gap
+    uint8_t *data;   // NULL for syncs
+    size_t len;
+    uint64_t offset;
+    int fd;
+    bool done;
+} IoOp_t;
+
+typedef struct {
+    int fd;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+} Ring_t;
+
+struct IoWriter {
+    IoBackend_t backend;
+    Ring_t ring;
+    bool fixed; // Arena registered with the kernel
+    int error;
+
+    uint8_t *arena;
+    size_t arena_size;
+    size_t arena_head; // Next allocation
+    size_t arena_used;
+
+    IoOp_t *ops;
+    uint32_t ops_cap;
+    uint64_t head_seq; // Oldest operation not yet retired
+    uint64_t tail_seq; // Next operation
+    uint32_t queued;   // Prepared but not submitted
+    uint32_t inflight; // Not completed yet, queued included
+
+    IoWriterStats_t stats;
+};
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned op, const void *arg, unsigned n) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+static int pwrite_all(IoWriter_t *writer, int fd, const uint8_t *p, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        writer->stats.syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static void ring_unmap(Ring_t *ring) {
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+}
+
+static int ring_setup(Ring_t *ring, unsigned entries) {
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = sys_setup(entries, &p);
+    if (ring->fd < 0) {
+        return -1;
+    }
+    ring->sq_entries = p.sq_entries;
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_size = ring->cq_size > ring->sq_size ? ring->cq_size : ring->sq_size;
+    }
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return -1;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+    uint8_t *sq = ring->sq_ptr, *cq = ring->cq_ptr;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static IoBackend_t pick_backend(IoBackend_t backend) {
+    const char *forced = getenv("GATEWAY_IO");
+
+    if (forced && strcmp(forced, "pwrite") == 0) {
+        return IO_BACKEND_PWRITE;
+    }
+    if (forced && strcmp(forced, "uring") == 0) {
+        return IO_BACKEND_URING;
+    }
+    return backend;
+}
+
+IoWriter_t *IoWriter_Create(IoBackend_t backend, uint32_t queue_depth, size_t arena_bytes) {
+    IoWriter_t *writer = calloc(1, sizeof(*writer));
+
+    if (!writer) {
+        return NULL;
+    }
+    writer->ring.fd = -1;
+    writer->backend = pick_backend(backend);
+    if (writer->backend == IO_BACKEND_PWRITE) {
+        return writer;
+    }
+    if (ring_setup(&writer->ring, queue_depth ? queue_depth : 64) != 0 ||
+        posix_memalign((void **)&writer->arena, 4096, arena_bytes) != 0) {
+        // Old kernel or io_uring disabled: keep going with pwrite
+        ring_unmap(&writer->ring);
+        writer->ring = (Ring_t){.fd = -1};
+        writer->arena = NULL;
+        writer->backend = IO_BACKEND_PWRITE;
+        return writer;
+    }
+    writer->backend = IO_BACKEND_URING;
+    writer->arena_size = arena_bytes;
+    writer->ops_cap = writer->ring.sq_entries * 2;
+    writer->ops = calloc(writer->ops_cap, sizeof(IoOp_t));
+    if (!writer->ops) {
+        IoWriter_Destroy(writer);
+        return NULL;
+    }
+    // Registration pins the arena; it fails under a low RLIMIT_MEMLOCK, plain writes still work
+    struct iovec iov = {.iov_base = writer->arena, .iov_len = arena_bytes};
+    writer->fixed = sys_register(writer->ring.fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+    return writer;
+}
+
+const char *IoWriter_BackendName(const IoWriter_t *writer) {
+    if (writer->backend == IO_BACKEND_PWRITE) {
+        return "pwrite";
+    }
+    return writer->fixed ? "io_uring (fixed buffers)" : "io_uring";
+}
+
+static void retire(IoWriter_t *writer) {
+    while (writer->head_seq < writer->tail_seq) {
+        IoOp_t *op = &writer->ops[writer->head_seq % writer->ops_cap];
+        if (!op->done) {
+            break;
+        }
+        writer->arena_used -= op->consumed;
+        writer->head_seq++;
+    }
+    if (writer->head_seq == writer->tail_seq) {
+        writer->arena_head = 0; // Empty: restart at the front to avoid wrap gaps
+    }
+}
+
+static void reap(IoWriter_t *writer) {
+    Ring_t *ring = &writer->ring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        IoOp_t *op = &writer->ops[cqe->user_data % writer->ops_cap];
+        if (cqe->res < 0) {
+            writer->error = -cqe->res;
+        } else if (op->data && (size_t)cqe->res < op->len) {
+            // Short write: finish the rest from the arena copy
+            size_t done = (size_t)cqe->res;
+            if (pwrite_all(writer, op->fd, op->data + done, op->len - done, op->offset + done) != 0) {
+                writer->error = errno;
+            }
+        }
+        op->done = true;
+        writer->inflight--;
+        head++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    retire(writer);
+}
+
+static int enter(IoWriter_t *writer, unsigned min_complete) {
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+    for (;;) {
+        int n = sys_enter(writer->ring.fd, writer->queued, min_complete, flags);
+        writer->stats.syscalls++;
+        if (n >= 0) {
+            writer->queued -= (uint32_t)n < writer->queued ? (uint32_t)n : writer->queued;
+            reap(writer);
+            return 0;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EBUSY) {
+            reap(writer);
+            continue;
+        }
+        writer->error = errno;
+        return -1;
+    }
+}
+
+static struct io_uring_sqe *next_sqe(IoWriter_t *writer) {
+    Ring_t *ring = &writer->ring;
+
+    if (writer->queued == ring->sq_entries && enter(writer, 0) != 0) {
+        return NULL;
+    }
+    unsigned tail = *ring->sq_tail;
+    unsigned idx = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    return sqe;
+}
+
+static void push_sqe(IoWriter_t *writer) {
+    Ring_t *ring = &writer->ring;
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    writer->queued++;
+    writer->inflight++;
+    writer->tail_seq++;
+}
+
+// Where len bytes go next; returns the bytes used, including a gap skipped at the end
+static size_t arena_place(const IoWriter_t *writer, size_t len, size_t *pos) {
+    if (writer->arena_head + len <= writer->arena_size) {
+        *pos = writer->arena_head;
+        return len;
+    }
+    *pos = 0;
+    return writer->arena_size - writer->arena_head + len;
+}
+
+// Wait until an operation slot and consumed bytes of arena are free
+static int reserve(IoWriter_t *writer, size_t consumed) {
+    bool waited = false;
+
+    reap(writer);
+    while (writer->tail_seq - writer->head_seq >= writer->ops_cap ||
+           writer->arena_size - writer->arena_used < consumed) {
+        waited = true;
+        if (enter(writer, 1) != 0) {
+            return -1;
+        }
+    }
+    writer->stats.space_waits += waited;
+    return 0;
+}
+
+int IoWriter_Write(IoWriter_t *writer, int fd, const void *data, size_t len, uint64_t offset) {
+    if (writer->error) {
+        errno = writer->error;
+        return -1;
+    }
+    writer->stats.writes++;
+    writer->stats.bytes += len;
+    if (writer->backend == IO_BACKEND_PWRITE) {
+        return pwrite_all(writer, fd, data, len, offset);
+    }
+    if (len > writer->arena_size) {
+        if (IoWriter_Drain(writer) != 0) {
+            return -1;
+        }
+        return pwrite_all(writer, fd, data, len, offset);
+    }
+
+    size_t pos;
+    if (reserve(writer, arena_place(writer, len, &pos)) != 0) {
+        return -1;
+    }
+    // reserve may have emptied the arena and moved its head back to the front
+    size_t consumed = arena_place(writer, len, &pos);
+
+    struct io_uring_sqe *sqe = next_sqe(writer);
+    if (!sqe) {
+        return -1;
+    }
+    uint8_t *dst = writer->arena + pos;
+    memcpy(dst, data, len);
+    sqe->opcode = writer->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)dst;
+    sqe->len = (uint32_t)len;
+    sqe->off = offset;
+    sqe->buf_index = 0;
+    sqe->user_data = writer->tail_seq;
+    writer->ops[writer->tail_seq % writer->ops_cap] = (IoOp_t){
+        .consumed = consumed, .data = dst, .len = len, .offset = offset, .fd = fd};
+    writer->arena_head = pos + len;
+    writer->arena_used += consumed;
+    push_sqe(writer);
+    return 0;
+}
+
+int IoWriter_Sync(IoWriter_t *writer, int fd) {
+    if (writer->error) {
+        errno = writer->error;
+        return -1;
+    }
+    writer->stats.syncs++;
+    if (writer->backend == IO_BACKEND_PWRITE) {
+        writer->stats.syscalls++;
+        return fdatasync(fd);
+    }
+    if (reserve(writer, 0) != 0) {
+        return -1;
+    }
+    struct io_uring_sqe *sqe = next_sqe(writer);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->flags = IOSQE_IO_DRAIN; // Starts only after every earlier write completed
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = writer->tail_seq;
+    writer->ops[writer->tail_seq % writer->ops_cap] = (IoOp_t){.fd = fd};
+    push_sqe(writer);
+    return 0;
+}
+
+int IoWriter_Submit(IoWriter_t *writer) {
+    if (writer->backend == IO_BACKEND_PWRITE || writer->queued == 0) {
+        return writer->error ? -1 : 0;
+    }
+    return enter(writer, 0);
+}
+
+int IoWriter_Drain(IoWriter_t *writer) {
+    if (writer->backend == IO_BACKEND_URING) {
+        reap(writer);
+        // Submit and wait for everything in one call when the kernel allows
+        while (writer->inflight > 0) {
+            if (enter(writer, writer->inflight) != 0) {
+                break;
+            }
+        }
+    }
+    if (writer->error) {
+        errno = writer->error;
+        return -1;
+    }
+    return 0;
+}
+
+uint32_t IoWriter_Pending(IoWriter_t *writer) {
+    if (writer->backend == IO_BACKEND_PWRITE) {
+        return 0;
+    }
+    reap(writer);
+    return (uint32_t)(writer->tail_seq - writer->head_seq);
+}
+
+void IoWriter_GetStats(const IoWriter_t *writer, IoWriterStats_t *stats) {
+    *stats = writer->stats;
+}
+
+void IoWriter_Destroy(IoWriter_t *writer) {
+    if (!writer) {
+        return;
+    }
+    if (writer->backend == IO_BACKEND_URING) {
+        IoWriter_Drain(writer);
+        ring_unmap(&writer->ring);
+    }
+    free(writer->ops);
+    free(writer->arena);
+    free(writer);
+}
@@ -0,0 +1,1990 @@
+#include "storage/store.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/crc32.h"
+#include "common/hash.h"
+#include "storage/iowriter.h"
+
+#define SEGMENT_MAGIC 0x4D474553u // "SEGM"
+#define SEGMENT_VERSION 1
+#define SEGMENT_COMPACTED 0x01
+#define FOOTER_MAGIC 0x52544F46u // "FOTR"
+#define INDEX_MAGIC 0x58444E49u  // "INDX"
+#define INDEX_VERSION 1
+#define SCAN_BUFFER_BYTES (1u << 20)
+#define IO_QUEUE_DEPTH 256
+#define IO_ARENA_BYTES (2u << 20)
+#define RETIRE_GRACE_NS (60ull * 1000000000ull) // Longest a query holds chunk locations
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t res;
+    uint8_t flags;    // SEGMENT_COMPACTED
+    uint64_t created; // Unix seconds
+} SegmentHeader_t;
+
+// One sealed chunk, as listed in a segment footer and in the index checkpoint
+typedef struct {
+    uint32_t node;
+    uint8_t field;
+    uint8_t res;
+    uint16_t gen;
+    uint32_t segment;
+    uint32_t count;
+    uint64_t offset;
+    int64_t t_min;
+    int64_t t_max;
+    float v_min;
+    float v_max;
+} IndexEntry_t;
+
+_Static_assert(sizeof(IndexEntry_t) == 48, "index entry layout is part of the file format");
+
+/*
+ * A finished segment ends in the entries of its chunks between two copies of
+ * this record: a scan from the front stops at the first, an open finds the
+ * second at the end of the file.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t chunks_end; // Where the chunks end and the footer starts
+    uint32_t crc;        // Over the entries
+    uint32_t reserved;
+} SegmentFooter_t;
+
+// <dir>/index.snap: the chunks of every open segment as of the last checkpoint
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t segment[SERIES_RES_COUNT];
+    uint64_t offset[SERIES_RES_COUNT]; // End of the chunks listed
+    uint32_t count[SERIES_RES_COUNT];  // Entries, resolutions one after another
+    uint32_t crc;                      // Over the header (crc = 0) and entries
+    uint32_t reserved2;
+} IndexSnapHeader_t;
+
+typedef struct {
+    IndexSnapHeader_t hdr;
+    IndexEntry_t *entries; // NULL if there is no usable checkpoint
+} IndexSnap_t;
+
+// Unsealed records of one series
+typedef struct {
+    SeriesKey_t key;
+    bool used;
+    uint32_t count;
+    int64_t *ts;             // Raw series
+    float *values;           // Raw series
+    SeriesBucket_t *buckets; // Rollup series
+} HeadChunk_t;
+
+// What compaction needs to know of a segment without reading it
+typedef struct {
+    uint16_t gen; // Rewrites so far; gen 0 is <id>.seg, later ones <id>-<gen>.seg
+    bool compacted;
+    int64_t t_min; // Over its chunks
+    int64_t t_max;
+    uint64_t bytes;
+} SegmentMeta_t;
+
+// Read descriptor of a segment, held by the log or the retired list and by each read in flight; the last closes it
+typedef struct {
+    int fd;
+    uint32_t refs;
+} SegmentFile_t;
+
+// A file replaced or dropped by compaction, unlinked but still open for queries holding its locations
+typedef struct {
+    uint8_t res;
+    uint16_t gen;
+    uint32_t id;
+    SegmentFile_t *file;
+    uint64_t reap_ns;
+} RetiredSegment_t;
+
+// Segment files of one resolution; only the last one is appended to
+typedef struct {
+    int fd;
+    uint32_t current;
+    uint64_t offset;
+    uint32_t stable; // Segments before it are covered by the last index checkpoint
+    uint32_t *ids;
+    SegmentFile_t **files; // Opened lazily for chunk reads, parallel to ids
+    SegmentMeta_t *meta;
+    uint32_t n_ids;
+    uint32_t cap_ids;
+    IndexEntry_t *entries; // Chunks of the current segment, for its footer
+    uint32_t n_entries;
+    uint32_t cap_entries;
+} SegmentLog_t;
+
+struct SeriesStore {
+    char *dir;
+    SeriesStoreConfig_t cfg;
+    pthread_mutex_t lock;
+    HeadChunk_t *heads;
+    uint32_t heads_cap;
+    uint32_t heads_used;
+    SegmentLog_t logs[SERIES_RES_COUNT];
+    TimeIndex_t *index;
+    uint8_t *scratch;
+    IoWriter_t *io; // Sealed chunks go out asynchronously
+    pthread_mutex_t compact_lock; // One compaction at a time; taken before lock
+    RetiredSegment_t *retired;
+    uint32_t n_retired;
+    uint32_t cap_retired;
+};
+
+// Segment walk that also records the time span of what it indexed
+typedef struct {
+    SeriesStore_t *store;
+    SegmentMeta_t *meta;
+} IndexCtx_t;
+
+void SeriesStore_DefaultConfig(SeriesStoreConfig_t *cfg) {
+    cfg->raw_chunk_records = 256;
+    cfg->rollup_chunk_records = 256;
+    cfg->segment_bytes = 64ull << 20;
+    cfg->io_backend = IO_BACKEND_AUTO;
+    cfg->read_only = false;
+}
+
+static void segment_path(const SeriesStore_t *store, uint8_t res, uint32_t id, uint16_t gen, char *out, size_t len) {
+    if (gen == 0) {
+        snprintf(out, len, "%s/%s/%08u.seg", store->dir, Series_ResolutionName(res), id);
+    } else {
+        snprintf(out, len, "%s/%s/%08u-%u.seg", store->dir, Series_ResolutionName(res), id, gen);
+    }
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *buf, size_t len, uint64_t offset) {
+    const uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len, uint64_t offset) {
+    uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static void fsync_dir(const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static int log_push_id(SegmentLog_t *log, uint32_t id, uint16_t gen) {
+    if (log->n_ids == log->cap_ids) {
+        uint32_t cap = log->cap_ids ? log->cap_ids * 2 : 16;
+        uint32_t *ids = realloc(log->ids, cap * sizeof(*ids));
+        if (!ids) {
+            return -1;
+        }
+        log->ids = ids;
+        SegmentFile_t **files = realloc(log->files, cap * sizeof(*files));
+        if (!files) {
+            return -1;
+        }
+        log->files = files;
+        SegmentMeta_t *meta = realloc(log->meta, cap * sizeof(*meta));
+        if (!meta) {
+            return -1;
+        }
+        log->meta = meta;
+        log->cap_ids = cap;
+    }
+    log->files[log->n_ids] = NULL;
+    log->meta[log->n_ids] = (SegmentMeta_t){.gen = gen, .t_min = INT64_MAX, .t_max = INT64_MIN};
+    log->ids[log->n_ids++] = id;
+    return 0;
+}
+
+static void meta_note(SegmentMeta_t *meta, int64_t t_min, int64_t t_max) {
+    if (t_min < meta->t_min) {
+        meta->t_min = t_min;
+    }
+    if (t_max > meta->t_max) {
+        meta->t_max = t_max;
+    }
+}
+
+static void entry_from_header(IndexEntry_t *e, const ChunkHeader_t *hdr, const ChunkLocation_t *loc) {
+    *e = (IndexEntry_t){
+        .node = hdr->node,
+        .field = hdr->field,
+        .res = hdr->res,
+        .gen = loc->gen,
+        .segment = loc->segment,
+        .count = hdr->count,
+        .offset = loc->offset,
+        .t_min = hdr->t_min,
+        .t_max = hdr->t_max,
+        .v_min = hdr->v_min,
+        .v_max = hdr->v_max,
+    };
+}
+
+static void entry_ref(ChunkRef_t *ref, const IndexEntry_t *e) {
+    *ref = (ChunkRef_t){
+        .loc = {.res = e->res, .gen = e->gen, .segment = e->segment, .offset = e->offset},
+        .t_min = e->t_min,
+        .t_max = e->t_max,
+        .v_min = e->v_min,
+        .v_max = e->v_max,
+        .count = e->count,
+    };
+}
+
+static int index_entry(SeriesStore_t *store, const IndexEntry_t *e) {
+    ChunkRef_t ref;
+
+    entry_ref(&ref, e);
+    return TimeIndex_Add(store->index, Series_Key(e->node, e->field, e->res), &ref);
+}
+
+static int log_push_entry(SegmentLog_t *log, const IndexEntry_t *e) {
+    if (log->n_entries == log->cap_entries) {
+        uint32_t cap = log->cap_entries ? log->cap_entries * 2 : 256;
+        IndexEntry_t *entries = realloc(log->entries, cap * sizeof(*entries));
+        if (!entries) {
+            return -1;
+        }
+        log->entries = entries;
+        log->cap_entries = cap;
+    }
+    log->entries[log->n_entries++] = *e;
+    return 0;
+}
+
+// A chunk of the current segment: indexed, and kept for the segment's footer
+static int track_chunk(const ChunkHeader_t *hdr, const ChunkLocation_t *loc, void *ctx) {
+    SeriesStore_t *store = ctx;
+    SegmentLog_t *log = &store->logs[loc->res];
+    IndexEntry_t e;
+
+    entry_from_header(&e, hdr, loc);
+    meta_note(&log->meta[log->n_ids - 1], e.t_min, e.t_max);
+    return index_entry(store, &e) == 0 ? log_push_entry(log, &e) : -1;
+}
+
+static int index_chunk(const ChunkHeader_t *hdr, const ChunkLocation_t *loc, void *ctx) {
+    IndexCtx_t *ictx = ctx;
+    IndexEntry_t e;
+
+    entry_from_header(&e, hdr, loc);
+    meta_note(ictx->meta, e.t_min, e.t_max);
+    return index_entry(ictx->store, &e);
+}
+
+static size_t footer_size(uint32_t n) {
+    return 2 * sizeof(SegmentFooter_t) + (size_t)n * sizeof(IndexEntry_t);
+}
+
+static int footer_write(int fd, const IndexEntry_t *entries, uint32_t n, uint64_t chunks_end) {
+    size_t bytes = (size_t)n * sizeof(IndexEntry_t);
+    SegmentFooter_t ftr = {
+        .magic = FOOTER_MAGIC,
+        .count = n,
+        .chunks_end = chunks_end,
+        .crc = Crc32_Update(0, entries, bytes),
+    };
+
+    if (write_all(fd, &ftr, sizeof(ftr), chunks_end) != 0 || write_all(fd, entries, bytes, chunks_end + sizeof(ftr)) != 0) {
+        return -1;
+    }
+    return write_all(fd, &ftr, sizeof(ftr), chunks_end + sizeof(ftr) + bytes);
+}
+
+static int segment_create(SeriesStore_t *store, uint8_t res, uint32_t id) {
+    SegmentLog_t *log = &store->logs[res];
+    SegmentHeader_t hdr = {
+        .magic = SEGMENT_MAGIC,
+        .version = SEGMENT_VERSION,
+        .res = res,
+        .created = (uint64_t)time(NULL),
+    };
+    char path[PATH_MAX];
+
+    segment_path(store, res, id, 0, path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (write_all(fd, &hdr, sizeof(hdr), 0) != 0 || log_push_id(log, id, 0) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (log->fd >= 0) {
+        // Writes to the old segment may still be in flight; its chunks reach the disk before the footer listing them.
+        // Best effort: a segment without a valid footer is scanned instead.
+        IoWriter_Drain(store->io);
+        if (fdatasync(log->fd) == 0) {
+            footer_write(log->fd, log->entries, log->n_entries, log->offset);
+        }
+        close(log->fd);
+        log->meta[log->n_ids - 2].bytes = log->offset + footer_size(log->n_entries);
+    }
+    log->fd = fd;
+    log->current = id;
+    log->offset = sizeof(hdr);
+    log->n_entries = 0;
+
+    snprintf(path, sizeof(path), "%s/%s", store->dir, Series_ResolutionName(res));
+    fsync_dir(path);
+    return 0;
+}
+
+static int fill(int fd, uint8_t *buf, uint64_t off, uint64_t end, uint64_t *buf_off, size_t *buf_len) {
+    size_t want = end - off < SCAN_BUFFER_BYTES ? (size_t)(end - off) : SCAN_BUFFER_BYTES;
+
+    if (read_all(fd, buf, want, off) != 0) {
+        return -1;
+    }
+    *buf_off = off;
+    *buf_len = want;
+    return 0;
+}
+
+/*
+ * Chunk headers from start up to end, read through buf (SCAN_BUFFER_BYTES).
+ * With verify the payloads are checked as well, for a tail that may be torn.
+ * *stop is the end of the last chunk walked.
+ */
+static int walk_segment(int fd, uint8_t res, uint32_t id, uint16_t gen, uint64_t start, uint64_t end, bool verify,
+                        uint8_t *buf, SeriesStore_ChunkFn fn, void *ctx, uint64_t *stop) {
+    uint64_t off = start, buf_off = 0;
+    size_t buf_len = 0;
+    int rc = 0;
+
+    while (rc == 0 && off + sizeof(ChunkHeader_t) <= end) {
+        ChunkHeader_t hdr;
+        if ((off < buf_off || off + sizeof(hdr) > buf_off + buf_len) &&
+            fill(fd, buf, off, end, &buf_off, &buf_len) != 0) {
+            rc = -1;
+            break;
+        }
+        memcpy(&hdr, buf + (off - buf_off), sizeof(hdr));
+        if (!Chunk_HeaderValid(&hdr) || off + Chunk_TotalSize(&hdr) > end) {
+            break;
+        }
+        if (verify) {
+            if (off + Chunk_TotalSize(&hdr) > buf_off + buf_len && fill(fd, buf, off, end, &buf_off, &buf_len) != 0) {
+                rc = -1;
+                break;
+            }
+            if (!Chunk_Verify(&hdr, buf + (off - buf_off) + sizeof(hdr))) {
+                break;
+            }
+        }
+        ChunkLocation_t loc = {.res = res, .gen = gen, .segment = id, .offset = off};
+        if ((rc = fn(&hdr, &loc, ctx)) == 0) {
+            off += Chunk_TotalSize(&hdr);
+        }
+    }
+    if (stop) {
+        *stop = off;
+    }
+    return rc;
+}
+
+// Only the header is bounded: a packed raw chunk is shorter than its record count implies
+static bool entries_valid(const IndexEntry_t *e, uint32_t n, uint8_t res, uint32_t id, uint16_t gen, uint64_t end) {
+    for (uint32_t i = 0; i < n; ++i) {
+        if (e[i].res != res || e[i].segment != id || e[i].gen != gen || e[i].count > CHUNK_MAX_RECORDS ||
+            e[i].offset < sizeof(SegmentHeader_t) || e[i].offset + sizeof(ChunkHeader_t) > end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int index_entries(SeriesStore_t *store, const IndexEntry_t *e, uint32_t n, bool current, SegmentMeta_t *meta) {
+    for (uint32_t i = 0; i < n; ++i) {
+        if (index_entry(store, &e[i]) != 0 || (current && log_push_entry(&store->logs[e[i].res], &e[i]) != 0)) {
+            return -1;
+        }
+        meta_note(meta, e[i].t_min, e[i].t_max);
+    }
+    return 0;
+}
+
+// 0 with the footer's entries in *entries (malloc'd), 1 if there is no usable footer, -1 on error
+static int footer_read(int fd, uint8_t res, uint32_t id, uint16_t gen, uint64_t size, IndexEntry_t **entries,
+                       uint32_t *count, uint64_t *chunks_end) {
+    SegmentFooter_t head, tail;
+
+    if (size < sizeof(SegmentHeader_t) + 2 * sizeof(tail) ||
+        read_all(fd, &tail, sizeof(tail), size - sizeof(tail)) != 0 || tail.magic != FOOTER_MAGIC) {
+        return 1;
+    }
+    uint64_t bytes = (uint64_t)tail.count * sizeof(IndexEntry_t);
+    if (tail.chunks_end < sizeof(SegmentHeader_t) || tail.chunks_end + 2 * sizeof(tail) + bytes != size) {
+        return 1;
+    }
+    IndexEntry_t *e = malloc(bytes ? bytes : 1);
+    if (!e) {
+        return -1;
+    }
+    if (read_all(fd, &head, sizeof(head), tail.chunks_end) != 0 || memcmp(&head, &tail, sizeof(head)) != 0 ||
+        read_all(fd, e, bytes, tail.chunks_end + sizeof(head)) != 0 || Crc32_Update(0, e, bytes) != tail.crc ||
+        !entries_valid(e, tail.count, res, id, gen, tail.chunks_end)) {
+        free(e);
+        return 1;
+    }
+    *entries = e;
+    *count = tail.count;
+    *chunks_end = tail.chunks_end;
+    return 0;
+}
+
+// 0 if the segment was indexed from its footer, 1 if it has no usable one, -1 on error
+static int footer_load(SeriesStore_t *store, int fd, uint8_t res, uint32_t id, SegmentMeta_t *meta, uint64_t size,
+                       bool current, uint64_t *chunks_end) {
+    IndexEntry_t *entries;
+    uint32_t count;
+
+    int rc = footer_read(fd, res, id, meta->gen, size, &entries, &count, chunks_end);
+    if (rc == 0) {
+        rc = index_entries(store, entries, count, current, meta);
+        free(entries);
+    }
+    return rc;
+}
+
+static void snap_load(const char *dir, IndexSnap_t *snap) {
+    char path[PATH_MAX];
+    struct stat st;
+    uint64_t total = 0;
+
+    snap->entries = NULL;
+    snprintf(path, sizeof(path), "%s/index.snap", dir);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) == 0 && read_all(fd, &snap->hdr, sizeof(snap->hdr), 0) == 0 &&
+        snap->hdr.magic == INDEX_MAGIC && snap->hdr.version == INDEX_VERSION) {
+        for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+            total += snap->hdr.count[r];
+        }
+        size_t bytes = (size_t)total * sizeof(IndexEntry_t);
+        if ((uint64_t)st.st_size == sizeof(snap->hdr) + bytes && (snap->entries = malloc(bytes ? bytes : 1)) &&
+            read_all(fd, snap->entries, bytes, sizeof(snap->hdr)) == 0) {
+            IndexSnapHeader_t hdr = snap->hdr;
+            hdr.crc = 0;
+            if (Crc32_Update(Crc32_Update(0, &hdr, sizeof(hdr)), snap->entries, bytes) != snap->hdr.crc) {
+                free(snap->entries);
+                snap->entries = NULL;
+            }
+        } else {
+            free(snap->entries);
+            snap->entries = NULL;
+        }
+    }
+    close(fd);
+}
+
+// The checkpoint's entries for the open segment of res, if they still describe it
+static const IndexEntry_t *snap_entries(const IndexSnap_t *snap, int fd, uint8_t res, uint32_t id, uint64_t size) {
+    const IndexEntry_t *e = snap->entries;
+    ChunkHeader_t hdr;
+
+    if (!e || snap->hdr.segment[res] != id || snap->hdr.offset[res] > size ||
+        snap->hdr.offset[res] < sizeof(SegmentHeader_t)) {
+        return NULL;
+    }
+    for (uint8_t r = 0; r < res; ++r) {
+        e += snap->hdr.count[r];
+    }
+    uint32_t n = snap->hdr.count[res];
+    if (!entries_valid(e, n, res, id, 0, snap->hdr.offset[res])) {
+        return NULL;
+    }
+    // The newest chunk it lists must be the one on disk
+    if (n > 0 && (read_all(fd, &hdr, sizeof(hdr), e[n - 1].offset) != 0 || !Chunk_HeaderValid(&hdr) ||
+                  hdr.node != e[n - 1].node || hdr.field != e[n - 1].field || hdr.count != e[n - 1].count ||
+                  hdr.t_min != e[n - 1].t_min)) {
+        return NULL;
+    }
+    return e;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// <id>.seg or <id>-<gen>.seg; 1 for <id>-<gen>.tmp, a rewrite that was never renamed into place
+static int segment_name(const char *name, uint32_t *id, uint16_t *gen) {
+    unsigned i, g = 0;
+    int n = 0, m = 0;
+
+    if (sscanf(name, "%8u%n", &i, &n) != 1 || n != 8) {
+        return -1;
+    }
+    if (name[n] == '-') {
+        if (sscanf(name + n, "-%5u%n", &g, &m) != 1 || g == 0 || g > UINT16_MAX) {
+            return -1;
+        }
+        n += m;
+    }
+    *id = i;
+    *gen = (uint16_t)g;
+    if (strcmp(name + n, ".seg") == 0) {
+        return 0;
+    }
+    return g > 0 && strcmp(name + n, ".tmp") == 0 ? 1 : -1;
+}
+
+typedef struct {
+    uint32_t id;
+    uint16_t gen;
+} SegmentName_t;
+
+static int cmp_name(const void *a, const void *b) {
+    const SegmentName_t *x = a, *y = b;
+    if (x->id != y->id) {
+        return (x->id > y->id) - (x->id < y->id);
+    }
+    return (x->gen > y->gen) - (x->gen < y->gen);
+}
+
+static int log_open(SeriesStore_t *store, uint8_t res) {
+    SegmentLog_t *log = &store->logs[res];
+    char path[PATH_MAX];
+
+    log->fd = -1;
+    snprintf(path, sizeof(path), "%s/%s", store->dir, Series_ResolutionName(res));
+    if (!store->cfg.read_only && mkdir(path, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    DIR *d = opendir(path);
+    if (!d) {
+        return store->cfg.read_only && errno == ENOENT ? 0 : -1;
+    }
+    // A compaction that crashed leaves its output as .tmp, or both generations if it got as far as the rename
+    SegmentName_t *names = NULL;
+    uint32_t n_names = 0, cap_names = 0;
+    struct dirent *de;
+    int rc = 0;
+    while ((de = readdir(d)) != NULL && rc == 0) {
+        SegmentName_t name;
+        char file[PATH_MAX + sizeof(de->d_name)];
+        switch (segment_name(de->d_name, &name.id, &name.gen)) {
+        case 0:
+            if (n_names == cap_names) {
+                cap_names = cap_names ? cap_names * 2 : 64;
+                SegmentName_t *grown = realloc(names, cap_names * sizeof(*names));
+                if (!grown) {
+                    rc = -1;
+                    break;
+                }
+                names = grown;
+            }
+            names[n_names++] = name;
+            break;
+        case 1:
+            snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+            if (!store->cfg.read_only) {
+                unlink(file);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    closedir(d);
+    if (n_names > 0) {
+        qsort(names, n_names, sizeof(*names), cmp_name);
+    }
+    for (uint32_t i = 0; i < n_names && rc == 0; ++i) {
+        if (i + 1 < n_names && names[i + 1].id == names[i].id) {
+            char file[PATH_MAX];
+            segment_path(store, res, names[i].id, names[i].gen, file, sizeof(file));
+            if (!store->cfg.read_only) {
+                unlink(file);
+            }
+            continue;
+        }
+        rc = log_push_id(log, names[i].id, names[i].gen);
+    }
+    free(names);
+    if (rc != 0) {
+        return -1;
+    }
+
+    if (log->n_ids == 0) {
+        return store->cfg.read_only ? 0 : segment_create(store, res, 1);
+    }
+    log->current = log->ids[log->n_ids - 1];
+    segment_path(store, res, log->current, log->meta[log->n_ids - 1].gen, path, sizeof(path));
+    log->fd = open(path, (store->cfg.read_only ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+    return log->fd < 0 ? -1 : 0;
+}
+
+// Ask for every footer up front, so the disk reads them while earlier ones are indexed
+static void footers_prefetch(const SeriesStore_t *store, uint8_t res) {
+    const SegmentLog_t *log = &store->logs[res];
+
+    for (uint32_t i = 0; i + 1 < log->n_ids; ++i) {
+        char path[PATH_MAX];
+        struct stat st;
+        SegmentFooter_t tail;
+
+        segment_path(store, res, log->ids[i], log->meta[i].gen, path, sizeof(path));
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        if (fstat(fd, &st) == 0 && (uint64_t)st.st_size > sizeof(tail) &&
+            read_all(fd, &tail, sizeof(tail), (uint64_t)st.st_size - sizeof(tail)) == 0 && tail.magic == FOOTER_MAGIC &&
+            tail.chunks_end < (uint64_t)st.st_size) {
+            off_t len = (off_t)((uint64_t)st.st_size - tail.chunks_end);
+            posix_fadvise(fd, (off_t)tail.chunks_end, len, POSIX_FADV_WILLNEED);
+        }
+        close(fd);
+    }
+}
+
+/*
+ * Finished segments are indexed from their footers, or scanned with every
+ * chunk verified if they have none: a segment cut off by a crash before its
+ * footer may end torn. The open one takes what the index checkpoint lists
+ * and is verified only past it, with a torn tail cut off.
+ */
+static int log_index(SeriesStore_t *store, uint8_t res, const IndexSnap_t *snap, uint8_t *buf) {
+    SegmentLog_t *log = &store->logs[res];
+
+    // Compaction waits for the next checkpoint to cover segments finished since this one
+    log->stable = snap->entries ? snap->hdr.segment[res] : 0;
+    footers_prefetch(store, res);
+    for (uint32_t i = 0; i < log->n_ids; ++i) {
+        bool current = i + 1 == log->n_ids;
+        uint32_t id = log->ids[i];
+        SegmentMeta_t *meta = &log->meta[i];
+        char path[PATH_MAX];
+        struct stat st;
+        SegmentHeader_t shdr;
+        uint64_t start = sizeof(shdr), end;
+
+        segment_path(store, res, id, meta->gen, path, sizeof(path));
+        int fd = current ? log->fd : open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || fstat(fd, &st) != 0 || read_all(fd, &shdr, sizeof(shdr), 0) != 0 || shdr.magic != SEGMENT_MAGIC) {
+            if (fd >= 0 && !current) {
+                close(fd);
+            }
+            return -1;
+        }
+        meta->compacted = (shdr.flags & SEGMENT_COMPACTED) != 0;
+        meta->bytes = (uint64_t)st.st_size;
+        int rc = footer_load(store, fd, res, id, meta, (uint64_t)st.st_size, current, &end);
+        if (rc == 1 && !current) {
+            IndexCtx_t ictx = {store, meta};
+            rc = walk_segment(fd, res, id, meta->gen, start, (uint64_t)st.st_size, true, buf, index_chunk, &ictx, NULL);
+        } else if (rc == 1) {
+            const IndexEntry_t *e = snap_entries(snap, fd, res, id, (uint64_t)st.st_size);
+            if (e && index_entries(store, e, snap->hdr.count[res], true, meta) != 0) {
+                return -1;
+            }
+            start = e ? snap->hdr.offset[res] : start;
+            rc = walk_segment(fd, res, id, 0, start, (uint64_t)st.st_size, true, buf, track_chunk, store, &end);
+        }
+        if (!current) {
+            close(fd);
+        }
+        if (rc != 0) {
+            return -1;
+        }
+        if (current) {
+            // A footer found here was written just before a crash; appends go where it starts
+            if (!store->cfg.read_only && end != (uint64_t)st.st_size && ftruncate(fd, (off_t)end) != 0) {
+                return -1;
+            }
+            log->offset = end;
+        }
+    }
+    return 0;
+}
+
+SeriesStore_t *SeriesStore_Open(const char *dir, const SeriesStoreConfig_t *cfg) {
+    SeriesStore_t *store = calloc(1, sizeof(*store));
+    IndexSnap_t snap;
+
+    if (!store) {
+        return NULL;
+    }
+    if (cfg) {
+        store->cfg = *cfg;
+    } else {
+        SeriesStore_DefaultConfig(&store->cfg);
+    }
+    if (store->cfg.raw_chunk_records == 0 || store->cfg.raw_chunk_records > CHUNK_MAX_RECORDS) {
+        store->cfg.raw_chunk_records = CHUNK_MAX_RECORDS;
+    }
+    if (store->cfg.rollup_chunk_records == 0 || store->cfg.rollup_chunk_records > CHUNK_MAX_RECORDS) {
+        store->cfg.rollup_chunk_records = CHUNK_MAX_RECORDS;
+    }
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_mutex_init(&store->compact_lock, NULL);
+    for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+        store->logs[r].fd = -1;
+    }
+    store->dir = strdup(dir);
+    store->heads_cap = 1024;
+    store->heads = calloc(store->heads_cap, sizeof(HeadChunk_t));
+    store->scratch = malloc(Chunk_RollupSize(CHUNK_MAX_RECORDS));
+    store->index = TimeIndex_Create();
+    store->io = IoWriter_Create(store->cfg.io_backend, IO_QUEUE_DEPTH, IO_ARENA_BYTES);
+    uint8_t *buf = malloc(SCAN_BUFFER_BYTES);
+    if (!store->dir || !store->heads || !store->scratch || !store->index || !store->io || !buf ||
+        (!store->cfg.read_only && mkdir(dir, 0755) != 0 && errno != EEXIST)) {
+        free(buf);
+        SeriesStore_Close(store);
+        return NULL;
+    }
+    snap_load(dir, &snap);
+    int rc = 0;
+    for (int r = 0; r < SERIES_RES_COUNT && rc == 0; ++r) {
+        rc = log_open(store, (uint8_t)r) != 0 || log_index(store, (uint8_t)r, &snap, buf) != 0 ? -1 : 0;
+    }
+    free(snap.entries);
+    free(buf);
+    if (rc != 0) {
+        SeriesStore_Close(store);
+        return NULL;
+    }
+    return store;
+}
+
+// Write a sealed chunk and make it visible in the index
+static int log_append(SeriesStore_t *store, uint8_t res, const void *buf, size_t len) {
+    SegmentLog_t *log = &store->logs[res];
+    ChunkHeader_t hdr;
+
+    if (log->offset + len > store->cfg.segment_bytes && log->offset > sizeof(SegmentHeader_t)) {
+        if (segment_create(store, res, log->current + 1) != 0) {
+            return -1;
+        }
+    }
+    if (IoWriter_Write(store->io, log->fd, buf, len, log->offset) != 0) {
+        return -1;
+    }
+    ChunkLocation_t loc = {.res = res, .segment = log->current, .offset = log->offset};
+    log->offset += len;
+    memcpy(&hdr, buf, sizeof(hdr));
+    return track_chunk(&hdr, &loc, store);
+}
+
+// Heads are appended mostly in order, so insertion sort is close to linear
+static void sort_raw(int64_t *ts, float *values, uint32_t n) {
+    for (uint32_t i = 1; i < n; ++i) {
+        int64_t t = ts[i];
+        float v = values[i];
+        uint32_t j = i;
+        while (j > 0 && ts[j - 1] > t) {
+            ts[j] = ts[j - 1];
+            values[j] = values[j - 1];
+            --j;
+        }
+        ts[j] = t;
+        values[j] = v;
+    }
+}
+
+static void sort_buckets(SeriesBucket_t *b, uint32_t n) {
+    for (uint32_t i = 1; i < n; ++i) {
+        SeriesBucket_t x = b[i];
+        uint32_t j = i;
+        while (j > 0 && b[j - 1].start > x.start) {
+            b[j] = b[j - 1];
+            --j;
+        }
+        b[j] = x;
+    }
+}
+
+static int head_seal(SeriesStore_t *store, HeadChunk_t *head) {
+    uint8_t res = Series_KeyRes(head->key);
+    size_t len;
+
+    if (head->count == 0) {
+        return 0;
+    }
+    if (res == SERIES_RES_RAW) {
+        sort_raw(head->ts, head->values, head->count);
+        len = Chunk_EncodeRaw(store->scratch, Series_KeyNode(head->key), Series_KeyField(head->key),
+                              head->ts, head->values, head->count);
+    } else {
+        sort_buckets(head->buckets, head->count);
+        len = Chunk_EncodeRollup(store->scratch, Series_KeyNode(head->key), Series_KeyField(head->key), res,
+                                 head->buckets, head->count);
+    }
+    head->count = 0;
+    return log_append(store, res, store->scratch, len);
+}
+
+static int heads_grow(SeriesStore_t *store) {
+    uint32_t cap = store->heads_cap * 2;
+    HeadChunk_t *heads = calloc(cap, sizeof(*heads));
+
+    if (!heads) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < store->heads_cap; ++i) {
+        HeadChunk_t *h = &store->heads[i];
+        if (!h->used) {
+            continue;
+        }
+        uint32_t slot = (uint32_t)Hash_U64(h->key) & (cap - 1);
+        while (heads[slot].used) {
+            slot = (slot + 1) & (cap - 1);
+        }
+        heads[slot] = *h;
+    }
+    free(store->heads);
+    store->heads = heads;
+    store->heads_cap = cap;
+    return 0;
+}
+
+static HeadChunk_t *head_find(SeriesStore_t *store, SeriesKey_t key) {
+    uint32_t mask = store->heads_cap - 1;
+    uint32_t slot = (uint32_t)Hash_U64(key) & mask;
+
+    while (store->heads[slot].used) {
+        if (store->heads[slot].key == key) {
+            return &store->heads[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+static HeadChunk_t *head_get(SeriesStore_t *store, SeriesKey_t key) {
+    HeadChunk_t *head = head_find(store, key);
+
+    if (head) {
+        return head;
+    }
+    if ((store->heads_used + 1) * 10 > store->heads_cap * 7 && heads_grow(store) != 0) {
+        return NULL;
+    }
+    uint32_t mask = store->heads_cap - 1;
+    uint32_t slot = (uint32_t)Hash_U64(key) & mask;
+    while (store->heads[slot].used) {
+        slot = (slot + 1) & mask;
+    }
+
+    head = &store->heads[slot];
+    if (Series_KeyRes(key) == SERIES_RES_RAW) {
+        head->ts = malloc(store->cfg.raw_chunk_records * sizeof(int64_t));
+        head->values = malloc(store->cfg.raw_chunk_records * sizeof(float));
+        if (!head->ts || !head->values) {
+            free(head->ts);
+            free(head->values);
+            head->ts = NULL;
+            head->values = NULL;
+            return NULL;
+        }
+    } else {
+        head->buckets = malloc(store->cfg.rollup_chunk_records * sizeof(SeriesBucket_t));
+        if (!head->buckets) {
+            return NULL;
+        }
+    }
+    head->key = key;
+    head->used = true;
+    head->count = 0;
+    store->heads_used++;
+    return head;
+}
+
+int SeriesStore_AppendSample(SeriesStore_t *store, const Sample_t *sample) {
+    int rc = -1;
+
+    if (store->cfg.read_only) {
+        errno = EROFS;
+        return -1;
+    }
+    pthread_mutex_lock(&store->lock);
+    HeadChunk_t *head = head_get(store, Series_Key(sample->node, sample->field, SERIES_RES_RAW));
+    if (head) {
+        head->ts[head->count] = sample->ts;
+        head->values[head->count] = sample->value;
+        if (++head->count == store->cfg.raw_chunk_records) {
+            rc = head_seal(store, head) == 0 ? IoWriter_Submit(store->io) : -1;
+        } else {
+            rc = 0;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return rc;
+}
+
+int SeriesStore_AppendBucket(SeriesStore_t *store, uint32_t node, uint8_t field, uint8_t res,
+                             const SeriesBucket_t *bucket) {
+    int rc = -1;
+
+    if (res == SERIES_RES_RAW || res >= SERIES_RES_COUNT) {
+        return -1;
+    }
+    if (store->cfg.read_only) {
+        errno = EROFS;
+        return -1;
+    }
+    pthread_mutex_lock(&store->lock);
+    HeadChunk_t *head = head_get(store, Series_Key(node, field, res));
+    if (head) {
+        head->buckets[head->count] = *bucket;
+        if (++head->count == store->cfg.rollup_chunk_records) {
+            rc = head_seal(store, head) == 0 ? IoWriter_Submit(store->io) : -1;
+        } else {
+            rc = 0;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return rc;
+}
+
+int SeriesStore_Flush(SeriesStore_t *store) {
+    int rc = 0;
+
+    pthread_mutex_lock(&store->lock);
+    for (uint32_t i = 0; i < store->heads_cap; ++i) {
+        if (store->heads[i].used && head_seal(store, &store->heads[i]) != 0) {
+            rc = -1;
+        }
+    }
+    if (IoWriter_Submit(store->io) != 0) {
+        rc = -1;
+    }
+    pthread_mutex_unlock(&store->lock);
+    return rc;
+}
+
+int SeriesStore_Sync(SeriesStore_t *store) {
+    int rc = 0;
+
+    pthread_mutex_lock(&store->lock);
+    if (IoWriter_Drain(store->io) != 0) {
+        rc = -1;
+    }
+    for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+        if (store->logs[r].fd >= 0 && fdatasync(store->logs[r].fd) != 0) {
+            rc = -1;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return rc;
+}
+
+int SeriesStore_SaveIndex(SeriesStore_t *store) {
+    IndexSnapHeader_t hdr = {.magic = INDEX_MAGIC, .version = INDEX_VERSION};
+    char path[PATH_MAX], tmp[PATH_MAX];
+    size_t bytes = 0, off = 0;
+    int rc = -1;
+
+    if (store->cfg.read_only) {
+        errno = EROFS;
+        return -1;
+    }
+    // Copied under the lock, written without it
+    pthread_mutex_lock(&store->lock);
+    for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+        hdr.segment[r] = store->logs[r].current;
+        hdr.offset[r] = store->logs[r].offset;
+        hdr.count[r] = store->logs[r].n_entries;
+        bytes += (size_t)hdr.count[r] * sizeof(IndexEntry_t);
+    }
+    IndexEntry_t *entries = malloc(bytes ? bytes : 1);
+    for (int r = 0; entries && r < SERIES_RES_COUNT; ++r) {
+        if (hdr.count[r] > 0) {
+            memcpy(entries + off, store->logs[r].entries, hdr.count[r] * sizeof(IndexEntry_t));
+            off += hdr.count[r];
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    if (!entries) {
+        return -1;
+    }
+    hdr.crc = Crc32_Update(Crc32_Update(0, &hdr, sizeof(hdr)), entries, bytes);
+
+    snprintf(path, sizeof(path), "%s/index.snap", store->dir);
+    snprintf(tmp, sizeof(tmp), "%s/index.snap.tmp", store->dir);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        if (write_all(fd, &hdr, sizeof(hdr), 0) == 0 && write_all(fd, entries, bytes, sizeof(hdr)) == 0 &&
+            fsync(fd) == 0) {
+            rc = 0;
+        }
+        close(fd);
+    }
+    if (rc == 0 && rename(tmp, path) != 0) {
+        rc = -1;
+    }
+    if (rc == 0) {
+        fsync_dir(store->dir);
+        pthread_mutex_lock(&store->lock);
+        for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+            store->logs[r].stable = hdr.segment[r];
+        }
+        pthread_mutex_unlock(&store->lock);
+    } else {
+        unlink(tmp);
+    }
+    free(entries);
+    return rc;
+}
+
+int SeriesStore_ScanChunks(SeriesStore_t *store, uint8_t res, SeriesStore_ChunkFn fn, void *ctx) {
+    uint32_t *ids;
+    uint16_t *gens;
+    uint32_t n_ids;
+    uint64_t current_end;
+    int rc = 0;
+
+    if (res >= SERIES_RES_COUNT) {
+        return -1;
+    }
+    // Sealed bytes never change once written, so only the segment list needs the lock
+    pthread_mutex_lock(&store->lock);
+    if (IoWriter_Pending(store->io) > 0) {
+        IoWriter_Drain(store->io);
+    }
+    SegmentLog_t *log = &store->logs[res];
+    n_ids = log->n_ids;
+    current_end = log->offset;
+    ids = malloc(n_ids * sizeof(*ids));
+    gens = malloc(n_ids * sizeof(*gens));
+    if (ids && gens) {
+        memcpy(ids, log->ids, n_ids * sizeof(*ids));
+        for (uint32_t i = 0; i < n_ids; ++i) {
+            gens[i] = log->meta[i].gen;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    uint8_t *buf = malloc(SCAN_BUFFER_BYTES);
+    if (!ids || !gens || !buf) {
+        free(ids);
+        free(gens);
+        free(buf);
+        return -1;
+    }
+    for (uint32_t i = 0; i < n_ids && rc == 0; ++i) {
+        char path[PATH_MAX];
+        struct stat st;
+
+        segment_path(store, res, ids[i], gens[i], path, sizeof(path));
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            rc = -1;
+            break;
+        }
+        // A finished segment's footer stops the walk like a torn tail would
+        uint64_t end = i + 1 == n_ids ? current_end : (uint64_t)st.st_size;
+        rc = walk_segment(fd, res, ids[i], gens[i], sizeof(SegmentHeader_t), end, false, buf, fn, ctx, NULL);
+        close(fd);
+    }
+    free(buf);
+    free(gens);
+    free(ids);
+    return rc;
+}
+
+// Position of segment id in log->ids, or n_ids
+static uint32_t log_find(const SegmentLog_t *log, uint32_t id) {
+    uint32_t lo = 0, hi = log->n_ids;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (log->ids[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < log->n_ids && log->ids[lo] == id ? lo : log->n_ids;
+}
+
+static SegmentFile_t *file_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    SegmentFile_t *file = fd >= 0 ? malloc(sizeof(*file)) : NULL;
+
+    if (!file) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    file->fd = fd;
+    file->refs = 1;
+    return file;
+}
+
+// Taken under the lock; dropped anywhere
+static SegmentFile_t *file_ref(SegmentFile_t *file) {
+    __atomic_add_fetch(&file->refs, 1, __ATOMIC_RELAXED);
+    return file;
+}
+
+static void file_unref(SegmentFile_t *file) {
+    if (file && __atomic_sub_fetch(&file->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        close(file->fd);
+        free(file);
+    }
+}
+
+/*
+ * Cached read-only descriptor of a segment, with a reference for the
+ * caller: pread on it needs no lock, and the file stays open until
+ * file_unref even if compaction retires and reaps it meanwhile. A location
+ * of a generation compaction has replaced is served from the retired file
+ * while it lasts, and fails with ESTALE after.
+ */
+static SegmentFile_t *segment_file(SeriesStore_t *store, const ChunkLocation_t *loc) {
+    SegmentLog_t *log = &store->logs[loc->res];
+    SegmentFile_t *file = NULL;
+
+    pthread_mutex_lock(&store->lock);
+    // The chunk may be one whose write is still in flight
+    if (IoWriter_Pending(store->io) > 0) {
+        IoWriter_Drain(store->io);
+    }
+    uint32_t i = log_find(log, loc->segment);
+    if (i < log->n_ids && log->meta[i].gen == loc->gen) {
+        if (!log->files[i]) {
+            char path[PATH_MAX];
+            segment_path(store, loc->res, loc->segment, loc->gen, path, sizeof(path));
+            log->files[i] = file_open(path);
+        }
+        file = log->files[i] ? file_ref(log->files[i]) : NULL;
+    } else {
+        errno = ESTALE;
+        for (uint32_t r = 0; r < store->n_retired; ++r) {
+            const RetiredSegment_t *old = &store->retired[r];
+            if (old->res == loc->res && old->id == loc->segment && old->gen == loc->gen) {
+                file = file_ref(old->file);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return file;
+}
+
+int SeriesStore_ReadChunk(SeriesStore_t *store, const ChunkLocation_t *loc,
+                          ChunkHeader_t *hdr, void *payload, size_t cap) {
+    if (loc->res >= SERIES_RES_COUNT) {
+        return -1;
+    }
+    SegmentFile_t *file = segment_file(store, loc);
+    if (!file) {
+        return -1;
+    }
+    int rc = 0;
+    if (read_all(file->fd, hdr, sizeof(*hdr), loc->offset) != 0 || !Chunk_HeaderValid(hdr) ||
+        hdr->payload_len > cap || read_all(file->fd, payload, hdr->payload_len, loc->offset + sizeof(*hdr)) != 0 ||
+        !Chunk_Verify(hdr, payload)) {
+        rc = -1;
+    }
+    file_unref(file);
+    return rc;
+}
+
+// Chunk entries of a segment being compacted
+typedef struct {
+    IndexEntry_t *entries;
+    uint32_t count;
+    uint32_t cap;
+} EntryList_t;
+
+static int entries_push(EntryList_t *list, const IndexEntry_t *e) {
+    if (list->count == list->cap) {
+        uint32_t cap = list->cap ? list->cap * 2 : 256;
+        IndexEntry_t *entries = realloc(list->entries, cap * sizeof(*entries));
+        if (!entries) {
+            return -1;
+        }
+        list->entries = entries;
+        list->cap = cap;
+    }
+    list->entries[list->count++] = *e;
+    return 0;
+}
+
+static int collect_chunk(const ChunkHeader_t *hdr, const ChunkLocation_t *loc, void *ctx) {
+    IndexEntry_t e;
+
+    entry_from_header(&e, hdr, loc);
+    return entries_push(ctx, &e);
+}
+
+// The chunks of a finished segment, from its footer or by walking it
+static int segment_entries(int fd, uint8_t res, uint32_t id, uint16_t gen, uint64_t size, EntryList_t *list) {
+    uint64_t end;
+
+    int rc = footer_read(fd, res, id, gen, size, &list->entries, &list->count, &end);
+    if (rc == 1) {
+        uint8_t *buf = malloc(SCAN_BUFFER_BYTES);
+        if (!buf) {
+            return -1;
+        }
+        rc = walk_segment(fd, res, id, gen, sizeof(SegmentHeader_t), size, false, buf, collect_chunk, list, NULL);
+        free(buf);
+    }
+    list->cap = list->count;
+    return rc;
+}
+
+static int cmp_entry(const void *a, const void *b) {
+    const IndexEntry_t *x = a, *y = b;
+    if (x->node != y->node) {
+        return (x->node > y->node) - (x->node < y->node);
+    }
+    if (x->field != y->field) {
+        return (x->field > y->field) - (x->field < y->field);
+    }
+    return (x->t_min > y->t_min) - (x->t_min < y->t_min);
+}
+
+typedef struct {
+    int64_t ts;
+    float value;
+} RawRecord_t;
+
+static int cmp_raw(const void *a, const void *b) {
+    const RawRecord_t *x = a, *y = b;
+    return (x->ts > y->ts) - (x->ts < y->ts);
+}
+
+static int cmp_bucket(const void *a, const void *b) {
+    const SeriesBucket_t *x = a, *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+// State of one segment rewrite
+typedef struct {
+    SeriesStore_t *store;
+    uint8_t res;
+    uint32_t id;
+    uint16_t gen; // Of the output
+    int src;
+    int dst;
+    uint64_t offset; // Next chunk in dst
+    int64_t cutoff;
+    EntryList_t out;
+    uint8_t *buf; // One encoded chunk, either way
+    RawRecord_t *raw;
+    SeriesBucket_t *buckets;
+    uint32_t n_records;
+    uint32_t cap_records;
+    int64_t *ts; // CHUNK_MAX_RECORDS, for decoding and encoding
+    float *values;
+    SeriesCompactStats_t *stats;
+} Rewrite_t;
+
+static int rewrite_grow(Rewrite_t *rw, uint32_t more) {
+    if (rw->n_records + more <= rw->cap_records) {
+        return 0;
+    }
+    uint32_t cap = rw->cap_records ? rw->cap_records : 4096;
+    while (cap < rw->n_records + more) {
+        cap *= 2;
+    }
+    if (rw->res == SERIES_RES_RAW) {
+        RawRecord_t *raw = realloc(rw->raw, cap * sizeof(*raw));
+        if (!raw) {
+            return -1;
+        }
+        rw->raw = raw;
+    } else {
+        SeriesBucket_t *buckets = realloc(rw->buckets, cap * sizeof(*buckets));
+        if (!buckets) {
+            return -1;
+        }
+        rw->buckets = buckets;
+    }
+    rw->cap_records = cap;
+    return 0;
+}
+
+// Read, check and decode one input chunk onto the series' records
+static int rewrite_read(Rewrite_t *rw, const IndexEntry_t *e) {
+    ChunkHeader_t hdr;
+    size_t cap = Chunk_RollupSize(CHUNK_MAX_RECORDS) - sizeof(hdr);
+
+    if (read_all(rw->src, &hdr, sizeof(hdr), e->offset) != 0) {
+        return -1;
+    }
+    if (!Chunk_HeaderValid(&hdr) || hdr.node != e->node || hdr.field != e->field || hdr.count != e->count ||
+        hdr.payload_len > cap || read_all(rw->src, rw->buf, hdr.payload_len, e->offset + sizeof(hdr)) != 0 ||
+        !Chunk_Verify(&hdr, rw->buf) || rewrite_grow(rw, hdr.count) != 0) {
+        errno = errno == ENOMEM ? ENOMEM : EBADMSG;
+        return -1;
+    }
+    if (rw->res == SERIES_RES_RAW) {
+        if (Chunk_DecodeRaw(&hdr, rw->buf, rw->ts, rw->values) != 0) {
+            errno = EBADMSG;
+            return -1;
+        }
+        for (uint32_t i = 0; i < hdr.count; ++i) {
+            rw->raw[rw->n_records + i] = (RawRecord_t){rw->ts[i], rw->values[i]};
+        }
+    } else if (Chunk_DecodeRollup(&hdr, rw->buf, rw->buckets + rw->n_records) != 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+    rw->n_records += hdr.count;
+    rw->stats->chunks_in++;
+    rw->stats->records_in += hdr.count;
+    rw->stats->bytes_read += Chunk_TotalSize(&hdr);
+    return 0;
+}
+
+static int rewrite_chunk(Rewrite_t *rw, size_t len) {
+    ChunkHeader_t hdr;
+    IndexEntry_t e;
+
+    if (write_all(rw->dst, rw->buf, len, rw->offset) != 0) {
+        return -1;
+    }
+    memcpy(&hdr, rw->buf, sizeof(hdr));
+    ChunkLocation_t loc = {.res = rw->res, .gen = rw->gen, .segment = rw->id, .offset = rw->offset};
+    entry_from_header(&e, &hdr, &loc);
+    rw->offset += len;
+    rw->stats->chunks_out++;
+    return entries_push(&rw->out, &e);
+}
+
+/*
+ * Write the series' records back sorted, without those older than the
+ * cutoff, in chunks as full as they go. Rollup buckets sharing a start, a
+ * late sample written after its bucket, are folded into one.
+ */
+static int rewrite_series(Rewrite_t *rw, uint32_t node, uint8_t field) {
+    uint32_t n = rw->n_records, keep = 0;
+
+    if (rw->res == SERIES_RES_RAW) {
+        for (uint32_t i = 1; i < n; ++i) {
+            if (rw->raw[i].ts < rw->raw[i - 1].ts) {
+                qsort(rw->raw, n, sizeof(*rw->raw), cmp_raw);
+                break;
+            }
+        }
+        uint32_t from = 0;
+        while (from < n && rw->raw[from].ts < rw->cutoff) {
+            ++from;
+        }
+        rw->stats->records_expired += from;
+        for (uint32_t i = from; i < n; i += CHUNK_MAX_RECORDS) {
+            uint32_t count = n - i < CHUNK_MAX_RECORDS ? n - i : CHUNK_MAX_RECORDS;
+            for (uint32_t j = 0; j < count; ++j) {
+                rw->ts[j] = rw->raw[i + j].ts;
+                rw->values[j] = rw->raw[i + j].value;
+            }
+            if (rewrite_chunk(rw, Chunk_EncodeRawPacked(rw->buf, node, field, rw->ts, rw->values, count)) != 0) {
+                return -1;
+            }
+        }
+    } else {
+        for (uint32_t i = 1; i < n; ++i) {
+            if (rw->buckets[i].start < rw->buckets[i - 1].start) {
+                qsort(rw->buckets, n, sizeof(*rw->buckets), cmp_bucket);
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            if (rw->buckets[i].start < rw->cutoff) {
+                rw->stats->records_expired++;
+            } else if (keep > 0 && rw->buckets[keep - 1].start == rw->buckets[i].start) {
+                SeriesBucket_Merge(&rw->buckets[keep - 1], &rw->buckets[i]);
+            } else {
+                rw->buckets[keep++] = rw->buckets[i];
+            }
+        }
+        for (uint32_t i = 0; i < keep; i += CHUNK_MAX_RECORDS) {
+            uint32_t count = keep - i < CHUNK_MAX_RECORDS ? keep - i : CHUNK_MAX_RECORDS;
+            if (rewrite_chunk(rw, Chunk_EncodeRollup(rw->buf, node, field, rw->res, rw->buckets + i, count)) != 0) {
+                return -1;
+            }
+        }
+    }
+    rw->n_records = 0;
+    return 0;
+}
+
+/*
+ * Rewrite the chunks in e[0..n) of a segment, sorted by series, to
+ * <id>-<gen>.tmp series by series, and rename it into place once it is
+ * complete and synced. A non-zero throttle abandons it with errno ECANCELED.
+ */
+static int rewrite_segment(Rewrite_t *rw, IndexEntry_t *e, uint32_t n, SeriesStore_ThrottleFn throttle, void *ctx) {
+    SegmentHeader_t hdr = {
+        .magic = SEGMENT_MAGIC,
+        .version = SEGMENT_VERSION,
+        .res = rw->res,
+        .flags = SEGMENT_COMPACTED,
+        .created = (uint64_t)time(NULL),
+    };
+    char path[PATH_MAX], tmp[PATH_MAX + 8];
+    int rc = 0;
+
+    segment_path(rw->store, rw->res, rw->id, rw->gen, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%.*s.tmp", (int)(strlen(path) - 4), path);
+    rw->dst = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (rw->dst < 0 || write_all(rw->dst, &hdr, sizeof(hdr), 0) != 0) {
+        rc = -1;
+    }
+    rw->offset = sizeof(hdr);
+    for (uint32_t i = 0; i < n && rc == 0;) {
+        uint32_t j = i;
+        uint64_t before = rw->stats->bytes_read + rw->offset;
+        for (; j < n && e[j].node == e[i].node && e[j].field == e[i].field && rc == 0; ++j) {
+            // A chunk wholly past retention is not even read
+            if (e[j].t_max < rw->cutoff) {
+                rw->stats->chunks_in++;
+                rw->stats->records_in += e[j].count;
+                rw->stats->records_expired += e[j].count;
+            } else {
+                rc = rewrite_read(rw, &e[j]);
+            }
+        }
+        if (rc == 0) {
+            rc = rewrite_series(rw, e[i].node, e[i].field);
+        }
+        if (rc == 0 && throttle && throttle(ctx, (size_t)(rw->stats->bytes_read + rw->offset - before)) != 0) {
+            errno = ECANCELED;
+            rc = -1;
+        }
+        i = j;
+    }
+    if (rc == 0 && (footer_write(rw->dst, rw->out.entries, rw->out.count, rw->offset) != 0 || fdatasync(rw->dst) != 0 ||
+                    rename(tmp, path) != 0)) {
+        rc = -1;
+    }
+    if (rw->dst >= 0) {
+        close(rw->dst);
+    }
+    if (rc != 0) {
+        int err = errno;
+        unlink(tmp);
+        errno = err;
+    }
+    return rc;
+}
+
+// Keep a replaced or dropped file open for queries still holding its locations; called with the lock held
+static void segment_retire(SeriesStore_t *store, uint8_t res, uint32_t i) {
+    SegmentLog_t *log = &store->logs[res];
+    SegmentFile_t *file = log->files[i];
+
+    if (!file) {
+        char path[PATH_MAX];
+        segment_path(store, res, log->ids[i], log->meta[i].gen, path, sizeof(path));
+        file = file_open(path);
+    }
+    log->files[i] = NULL;
+    if (!file) {
+        return;
+    }
+    if (store->n_retired == store->cap_retired) {
+        uint32_t cap = store->cap_retired ? store->cap_retired * 2 : 8;
+        RetiredSegment_t *retired = realloc(store->retired, cap * sizeof(*retired));
+        if (!retired) {
+            file_unref(file);
+            return;
+        }
+        store->retired = retired;
+        store->cap_retired = cap;
+    }
+    store->retired[store->n_retired++] = (RetiredSegment_t){
+        .res = res,
+        .gen = log->meta[i].gen,
+        .id = log->ids[i],
+        .file = file,
+        .reap_ns = mono_ns() + RETIRE_GRACE_NS,
+    };
+}
+
+// A reaped file still being read closes when its last read is done
+static void retired_reap(SeriesStore_t *store) {
+    uint64_t now = mono_ns();
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < store->n_retired; ++i) {
+        if (store->retired[i].reap_ns <= now) {
+            file_unref(store->retired[i].file);
+        } else {
+            store->retired[n++] = store->retired[i];
+        }
+    }
+    store->n_retired = n;
+}
+
+/*
+ * Swap the chunks of a segment in the index for their rewrite; both lists
+ * are sorted by series and out may be empty. The lock is taken per series,
+ * so appends never wait on a whole segment, and a query sees one generation
+ * of a series or the other, both readable. A series never ends up with more
+ * chunks than it had, so nothing is allocated and nothing fails.
+ */
+static void index_replace(SeriesStore_t *store, const EntryList_t *in, const EntryList_t *out, const ChunkRef_t *refs) {
+    uint32_t j = 0;
+
+    for (uint32_t i = 0; i < in->count;) {
+        const IndexEntry_t *e = &in->entries[i];
+        uint32_t first = j;
+        while (j < out->count && out->entries[j].node == e->node && out->entries[j].field == e->field) {
+            ++j;
+        }
+        pthread_mutex_lock(&store->lock);
+        TimeIndex_Replace(store->index, Series_Key(e->node, e->field, e->res), e->segment, e->gen, refs + first,
+                          j - first);
+        pthread_mutex_unlock(&store->lock);
+        while (i < in->count && in->entries[i].node == e->node && in->entries[i].field == e->field) {
+            ++i;
+        }
+    }
+}
+
+// Take a dropped segment out of the log, under the lock
+static void log_remove(SegmentLog_t *log, uint32_t i) {
+    uint32_t tail = log->n_ids - i - 1;
+
+    memmove(&log->ids[i], &log->ids[i + 1], tail * sizeof(*log->ids));
+    memmove(&log->files[i], &log->files[i + 1], tail * sizeof(*log->files));
+    memmove(&log->meta[i], &log->meta[i + 1], tail * sizeof(*log->meta));
+    log->n_ids--;
+}
+
+int SeriesStore_Compact(SeriesStore_t *store, uint8_t res, int64_t cutoff_ms, SeriesStore_ThrottleFn throttle,
+                        void *ctx, SeriesCompactStats_t *stats) {
+    SegmentLog_t *log = &store->logs[res];
+    EntryList_t in = {0};
+    char path[PATH_MAX], dir[PATH_MAX];
+    struct stat st;
+    uint32_t id = 0;
+    uint16_t gen = 0;
+    bool drop = false, found = false;
+
+    if (res >= SERIES_RES_COUNT) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (store->cfg.read_only) {
+        errno = EROFS;
+        return -1;
+    }
+    pthread_mutex_lock(&store->compact_lock);
+    // Segments the index checkpoint does not cover yet may still be rewound, and the open one is appended to
+    pthread_mutex_lock(&store->lock);
+    retired_reap(store);
+    for (uint32_t i = 0; i + 1 < log->n_ids && log->ids[i] < log->stable; ++i) {
+        if (log->meta[i].t_max < cutoff_ms || !log->meta[i].compacted) {
+            id = log->ids[i];
+            gen = log->meta[i].gen;
+            drop = log->meta[i].t_max < cutoff_ms;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    if (!found) {
+        pthread_mutex_unlock(&store->compact_lock);
+        return 0;
+    }
+
+    // Sealed bytes never change, so the segment is read without the lock
+    segment_path(store, res, id, gen, path, sizeof(path));
+    Rewrite_t rw = {.store = store, .res = res, .id = id, .gen = (uint16_t)(gen + 1), .src = -1, .dst = -1,
+                    .cutoff = cutoff_ms, .stats = stats};
+    uint64_t src_bytes = 0, bytes = 0;
+    int rc = -1;
+    if ((rw.src = open(path, O_RDONLY | O_CLOEXEC)) >= 0 && fstat(rw.src, &st) == 0) {
+        src_bytes = (uint64_t)st.st_size;
+        rc = segment_entries(rw.src, res, id, gen, src_bytes, &in);
+    }
+    if (rc == 0) {
+        qsort(in.entries, in.count, sizeof(*in.entries), cmp_entry);
+    }
+    if (rc == 0 && !drop) {
+        rw.buf = malloc(Chunk_RollupSize(CHUNK_MAX_RECORDS));
+        rw.ts = malloc(CHUNK_MAX_RECORDS * sizeof(*rw.ts));
+        rw.values = malloc(CHUNK_MAX_RECORDS * sizeof(*rw.values));
+        rc = rw.buf && rw.ts && rw.values && gen < UINT16_MAX ? rewrite_segment(&rw, in.entries, in.count, throttle, ctx)
+                                                               : -1;
+        bytes = rw.offset + footer_size(rw.out.count);
+    }
+    ChunkRef_t *refs = NULL;
+    if (rc == 0 && !drop && !(refs = malloc((rw.out.count ? rw.out.count : 1) * sizeof(*refs)))) {
+        rc = -1;
+    }
+    SegmentMeta_t meta = {.gen = rw.gen, .compacted = true, .t_min = INT64_MAX, .t_max = INT64_MIN, .bytes = bytes};
+    for (uint32_t k = 0; refs && k < rw.out.count; ++k) {
+        entry_ref(&refs[k], &rw.out.entries[k]);
+        meta_note(&meta, refs[k].t_min, refs[k].t_max);
+    }
+    int err = errno;
+
+    // The old file is retired before the index moves off it, so its locations stay readable throughout
+    pthread_mutex_lock(&store->lock);
+    uint32_t i = log_find(log, id);
+    if (rc == 0) {
+        segment_retire(store, res, i);
+        if (drop) {
+            log_remove(log, i);
+        } else {
+            log->meta[i] = meta;
+        }
+    } else if (err != ECANCELED) {
+        // A segment that cannot be rewritten is left as it is until the next open
+        log->meta[i].compacted = true;
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    if (rc == 0) {
+        index_replace(store, &in, &rw.out, refs);
+        unlink(path);
+        snprintf(dir, sizeof(dir), "%s/%s", store->dir, Series_ResolutionName(res));
+        fsync_dir(dir);
+        stats->segments++;
+        stats->bytes_written += bytes;
+        stats->bytes_reclaimed += src_bytes > bytes ? src_bytes - bytes : 0;
+        if (drop) {
+            stats->dropped++;
+            for (uint32_t k = 0; k < in.count; ++k) {
+                stats->records_in += in.entries[k].count;
+                stats->records_expired += in.entries[k].count;
+            }
+            stats->chunks_in += in.count;
+        }
+    } else if (!drop) {
+        // Renamed into place but not swapped in: the old generation stays
+        char out[PATH_MAX];
+        segment_path(store, res, id, rw.gen, out, sizeof(out));
+        unlink(out);
+    }
+    if (rw.src >= 0) {
+        close(rw.src);
+    }
+    free(rw.buf);
+    free(rw.ts);
+    free(rw.values);
+    free(rw.raw);
+    free(rw.buckets);
+    free(rw.out.entries);
+    free(refs);
+    free(in.entries);
+    pthread_mutex_unlock(&store->compact_lock);
+    errno = err;
+    return rc == 0 ? 1 : -1;
+}
+
+static int snapshot_head(const HeadChunk_t *head, int64_t from, int64_t to, SeriesSnapshot_t *snap) {
+    if (!head) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < head->count; ++i) {
+        if (Series_KeyRes(head->key) == SERIES_RES_RAW) {
+            if (head->ts[i] >= from && head->ts[i] < to && SeriesSnapshot_PushRaw(snap, head->ts[i], head->values[i]) != 0) {
+                return -1;
+            }
+        } else if (head->buckets[i].start >= from && head->buckets[i].start < to &&
+                   SeriesSnapshot_PushBucket(snap, &head->buckets[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int SeriesStore_Snapshot(SeriesStore_t *store, SeriesKey_t key, int64_t from, int64_t to,
+                         SeriesSnapshot_t *snap) {
+    int rc;
+
+    pthread_mutex_lock(&store->lock);
+    rc = TimeIndex_Find(store->index, key, from, to, &snap->chunks);
+    if (rc == 0) {
+        rc = snapshot_head(head_find(store, key), from, to, snap);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return rc;
+}
+
+int SeriesStore_SnapshotLatest(SeriesStore_t *store, SeriesKey_t key, SeriesSnapshot_t *snap) {
+    ChunkRef_t ref;
+    int rc = 0;
+
+    pthread_mutex_lock(&store->lock);
+    if (TimeIndex_Last(store->index, key, &ref)) {
+        rc = ChunkRefList_Push(&snap->chunks, &ref);
+    }
+    if (rc == 0) {
+        rc = snapshot_head(head_find(store, key), INT64_MIN, INT64_MAX, snap);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return rc;
+}
+
+void SeriesStore_GetMark(SeriesStore_t *store, StoreMark_t *mark) {
+    pthread_mutex_lock(&store->lock);
+    for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+        mark->segment[r] = store->logs[r].current;
+        mark->offset[r] = store->logs[r].offset;
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+int SeriesStore_Rewind(const char *dir, const StoreMark_t *mark) {
+    char path[PATH_MAX];
+
+    for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+        snprintf(path, sizeof(path), "%s/%s", dir, Series_ResolutionName((uint8_t)r));
+        DIR *d = opendir(path);
+        if (!d) {
+            if (errno == ENOENT) {
+                continue;
+            }
+            return -1;
+        }
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            uint32_t id;
+            uint16_t gen;
+            if (segment_name(de->d_name, &id, &gen) != 0) {
+                continue;
+            }
+            char seg[PATH_MAX + sizeof(de->d_name)];
+            snprintf(seg, sizeof(seg), "%s/%s", path, de->d_name);
+            if (id > mark->segment[r]) {
+                unlink(seg);
+            } else if (id == mark->segment[r]) {
+                struct stat st;
+                if (stat(seg, &st) == 0 && (uint64_t)st.st_size > mark->offset[r] &&
+                    truncate(seg, (off_t)mark->offset[r]) != 0) {
+                    closedir(d);
+                    return -1;
+                }
+            }
+        }
+        closedir(d);
+        fsync_dir(path);
+    }
+    return 0;
+}
+
+void SeriesStore_GetIoStats(SeriesStore_t *store, IoWriterStats_t *stats) {
+    pthread_mutex_lock(&store->lock);
+    IoWriter_GetStats(store->io, stats);
+    pthread_mutex_unlock(&store->lock);
+}
+
+const char *SeriesStore_IoBackend(const SeriesStore_t *store) {
+    return IoWriter_BackendName(store->io);
+}
+
+uint64_t SeriesStore_ChunkCount(SeriesStore_t *store) {
+    pthread_mutex_lock(&store->lock);
+    uint64_t n = TimeIndex_ChunkCount(store->index);
+    pthread_mutex_unlock(&store->lock);
+    return n;
+}
+
+typedef struct {
+    uint8_t res;
+    uint32_t *nodes;
+    uint32_t count;
+    uint32_t cap;
+} NodeList_t;
+
+static int list_node(SeriesKey_t key, void *ctx) {
+    NodeList_t *list = ctx;
+
+    if (Series_KeyRes(key) != list->res) {
+        return 0;
+    }
+    if (list->count == list->cap) {
+        uint32_t cap = list->cap ? list->cap * 2 : 64;
+        uint32_t *nodes = realloc(list->nodes, cap * sizeof(*nodes));
+        if (!nodes) {
+            return -1;
+        }
+        list->nodes = nodes;
+        list->cap = cap;
+    }
+    list->nodes[list->count++] = Series_KeyNode(key);
+    return 0;
+}
+
+int SeriesStore_ListNodes(SeriesStore_t *store, uint8_t res, uint32_t **nodes, uint32_t *count) {
+    NodeList_t list = {.res = res};
+    int rc;
+
+    pthread_mutex_lock(&store->lock);
+    rc = TimeIndex_ForEachSeries(store->index, list_node, &list);
+    for (uint32_t i = 0; rc == 0 && i < store->heads_cap; ++i) {
+        if (store->heads[i].used && store->heads[i].count > 0) {
+            rc = list_node(store->heads[i].key, &list);
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    if (rc != 0) {
+        free(list.nodes);
+        return -1;
+    }
+    // One entry per field so far
+    qsort(list.nodes, list.count, sizeof(*list.nodes), cmp_u32);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < list.count; ++i) {
+        if (n == 0 || list.nodes[n - 1] != list.nodes[i]) {
+            list.nodes[n++] = list.nodes[i];
+        }
+    }
+    *nodes = list.nodes;
+    *count = n;
+    return 0;
+}
+
+void SeriesSnapshot_Reset(SeriesSnapshot_t *snap) {
+    snap->chunks.count = 0;
+    snap->n_raw = 0;
+    snap->n_buckets = 0;
+}
+
+void SeriesSnapshot_Free(SeriesSnapshot_t *snap) {
+    ChunkRefList_Free(&snap->chunks);
+    free(snap->ts);
+    free(snap->values);
+    free(snap->buckets);
+    memset(snap, 0, sizeof(*snap));
+}
+
+int SeriesSnapshot_PushRaw(SeriesSnapshot_t *snap, int64_t ts, float value) {
+    if (snap->n_raw == snap->cap_raw) {
+        uint32_t cap = snap->cap_raw ? snap->cap_raw * 2 : 256;
+        int64_t *t = realloc(snap->ts, cap * sizeof(*t));
+        if (!t) {
+            return -1;
+        }
+        snap->ts = t;
+        float *v = realloc(snap->values, cap * sizeof(*v));
+        if (!v) {
+            return -1;
+        }
+        snap->values = v;
+        snap->cap_raw = cap;
+    }
+    snap->ts[snap->n_raw] = ts;
+    snap->values[snap->n_raw++] = value;
+    return 0;
+}
+
+int SeriesSnapshot_PushBucket(SeriesSnapshot_t *snap, const SeriesBucket_t *bucket) {
+    if (snap->n_buckets == snap->cap_buckets) {
+        uint32_t cap = snap->cap_buckets ? snap->cap_buckets * 2 : 64;
+        SeriesBucket_t *b = realloc(snap->buckets, cap * sizeof(*b));
+        if (!b) {
+            return -1;
+        }
+        snap->buckets = b;
+        snap->cap_buckets = cap;
+    }
+    snap->buckets[snap->n_buckets++] = *bucket;
+    return 0;
+}
+
+const char *SeriesStore_Dir(const SeriesStore_t *store) {
+    return store->dir;
+}
+
+void SeriesStore_Close(SeriesStore_t *store) {
+    if (!store) {
+        return;
+    }
+    if (store->heads && store->scratch && store->io) {
+        SeriesStore_Flush(store);
+        SeriesStore_Sync(store);
+    }
+    for (int r = 0; r < SERIES_RES_COUNT; ++r) {
+        SegmentLog_t *log = &store->logs[r];
+        if (log->fd >= 0) {
+            close(log->fd);
+        }
+        for (uint32_t i = 0; i < log->n_ids; ++i) {
+            file_unref(log->files[i]);
+        }
+        free(log->ids);
+        free(log->files);
+        free(log->meta);
+        free(log->entries);
+    }
+    for (uint32_t i = 0; i < store->n_retired; ++i) {
+        file_unref(store->retired[i].file);
+    }
+    free(store->retired);
+    for (uint32_t i = 0; store->heads && i < store->heads_cap; ++i) {
+        free(store->heads[i].ts);
+        free(store->heads[i].values);
+        free(store->heads[i].buckets);
+    }
+    IoWriter_Destroy(store->io);
+    pthread_mutex_destroy(&store->lock);
+    pthread_mutex_destroy(&store->compact_lock);
+    TimeIndex_Destroy(store->index);
+    free(store->heads);
+    free(store->scratch);
+    free(store->dir);
+    free(store);
+}
@@ -0,0 +1,588 @@
+#include "storage/wal.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/crc32.h"
+#include "storage/iowriter.h"
+
+#define WAL_MAX_RECORD (64u << 10)
+#define CHECKPOINT_MAGIC 0x5450434Bu // "KCPT"
+
+typedef struct {
+    uint32_t len;
+    uint32_t crc; // Over lsn and data
+    uint64_t lsn;
+} WalRecordHeader_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t blob_len;
+    uint64_t lsn;
+    uint32_t crc; // Over lsn and blob
+    uint32_t reserved;
+} CheckpointHeader_t;
+
+struct Wal {
+    char *dir;
+    WalConfig_t cfg;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // Flusher: records pending or closing
+    pthread_cond_t durable; // Waiters: durable_lsn advanced
+    pthread_cond_t space;   // Appenders: buffer swapped out
+    pthread_t flusher;
+    bool flusher_running;
+    bool closing;
+    int error;
+
+    uint8_t *active;
+    uint8_t *spare;
+    size_t active_len;
+    size_t cap;
+    uint64_t pending_since_ns;
+
+    uint64_t next_lsn;
+    uint64_t durable_lsn;
+
+    int fd;
+    uint64_t seg_size;
+    IoWriter_t *io;
+    uint64_t *segments; // First LSN of each segment file, ascending
+    uint32_t n_segments;
+    uint32_t cap_segments;
+
+    uint64_t ckpt_lsn;
+    uint8_t *ckpt_blob;
+    size_t ckpt_len;
+
+    WalStats_t stats;
+};
+
+void Wal_DefaultConfig(WalConfig_t *cfg) {
+    cfg->sync = WAL_SYNC_GROUP;
+    cfg->max_delay_us = 5000;
+    cfg->max_batch_bytes = 256u << 10;
+    cfg->segment_bytes = 64ull << 20;
+    cfg->io_backend = IO_BACKEND_AUTO;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t record_crc(uint64_t lsn, const void *data, uint32_t len) {
+    return Crc32_Update(Crc32_Update(0, &lsn, sizeof(lsn)), data, len);
+}
+
+static void segment_path(const Wal_t *wal, uint64_t first_lsn, char *out, size_t len) {
+    snprintf(out, len, "%s/%016" PRIx64 ".wal", wal->dir, first_lsn);
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void fsync_dir(const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static int read_file(const char *path, uint8_t **data, size_t *len) {
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    *len = (size_t)st.st_size;
+    *data = malloc(*len ? *len : 1);
+    size_t got = 0;
+    while (*data && got < *len) {
+        ssize_t n = read(fd, *data + got, *len - got);
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    close(fd);
+    if (!*data || got != *len) {
+        free(*data);
+        return -1;
+    }
+    return 0;
+}
+
+// Walk valid records of one segment; returns the length of the valid prefix
+static size_t segment_walk(const uint8_t *data, size_t len, uint64_t after, uint64_t *last_lsn, Wal_RecordFn fn,
+                           void *ctx, int *rc) {
+    size_t off = 0;
+
+    while (off + sizeof(WalRecordHeader_t) <= len) {
+        WalRecordHeader_t hdr;
+        memcpy(&hdr, data + off, sizeof(hdr));
+        if (hdr.len > WAL_MAX_RECORD || off + sizeof(hdr) + hdr.len > len ||
+            record_crc(hdr.lsn, data + off + sizeof(hdr), hdr.len) != hdr.crc) {
+            break;
+        }
+        if (fn && hdr.lsn > after && *rc == 0) {
+            *rc = fn(hdr.lsn, data + off + sizeof(hdr), hdr.len, ctx);
+        }
+        *last_lsn = hdr.lsn;
+        off += sizeof(hdr) + hdr.len;
+    }
+    return off;
+}
+
+static int push_segment(Wal_t *wal, uint64_t first_lsn) {
+    if (wal->n_segments == wal->cap_segments) {
+        uint32_t cap = wal->cap_segments ? wal->cap_segments * 2 : 16;
+        uint64_t *s = realloc(wal->segments, cap * sizeof(*s));
+        if (!s) {
+            return -1;
+        }
+        wal->segments = s;
+        wal->cap_segments = cap;
+    }
+    wal->segments[wal->n_segments++] = first_lsn;
+    return 0;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int load_checkpoint(Wal_t *wal) {
+    char path[PATH_MAX];
+    uint8_t *data;
+    size_t len;
+    CheckpointHeader_t hdr;
+
+    snprintf(path, sizeof(path), "%s/checkpoint", wal->dir);
+    if (read_file(path, &data, &len) != 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    if (len < sizeof(hdr)) {
+        free(data);
+        errno = EBADMSG;
+        return -1;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+    if (hdr.magic != CHECKPOINT_MAGIC || len != sizeof(hdr) + hdr.blob_len ||
+        Crc32_Update(Crc32_Update(0, &hdr.lsn, sizeof(hdr.lsn)), data + sizeof(hdr), hdr.blob_len) != hdr.crc) {
+        // Written via rename, so a bad file means outside damage, not a torn write
+        free(data);
+        errno = EBADMSG;
+        return -1;
+    }
+    wal->ckpt_lsn = hdr.lsn;
+    wal->ckpt_len = hdr.blob_len;
+    wal->ckpt_blob = malloc(hdr.blob_len ? hdr.blob_len : 1);
+    if (wal->ckpt_blob) {
+        memcpy(wal->ckpt_blob, data + sizeof(hdr), hdr.blob_len);
+    }
+    free(data);
+    return wal->ckpt_blob ? 0 : -1;
+}
+
+// Find segments, cut a torn tail off the last one and work out the next LSN
+static int recover(Wal_t *wal) {
+    DIR *d = opendir(wal->dir);
+    struct dirent *de;
+
+    if (!d) {
+        return -1;
+    }
+    while ((de = readdir(d)) != NULL) {
+        uint64_t first;
+        char tail[8];
+        if (sscanf(de->d_name, "%16" SCNx64 ".%7s", &first, tail) == 2 && strcmp(tail, "wal") == 0 &&
+            push_segment(wal, first) != 0) {
+            closedir(d);
+            return -1;
+        }
+    }
+    closedir(d);
+    qsort(wal->segments, wal->n_segments, sizeof(uint64_t), cmp_u64);
+
+    uint64_t last = wal->ckpt_lsn;
+    if (wal->n_segments > 0) {
+        char path[PATH_MAX];
+        uint8_t *data;
+        size_t len;
+        int rc = 0;
+
+        segment_path(wal, wal->segments[wal->n_segments - 1], path, sizeof(path));
+        if (read_file(path, &data, &len) != 0) {
+            return -1;
+        }
+        uint64_t seg_last = 0;
+        size_t valid = segment_walk(data, len, 0, &seg_last, NULL, NULL, &rc);
+        free(data);
+        if (valid != len && truncate(path, (off_t)valid) != 0) {
+            return -1;
+        }
+        // A crash just after rotation leaves the last segment empty or torn; the records before it are still
+        // taken, so their LSNs must not be handed out again
+        uint64_t before = wal->segments[wal->n_segments - 1] - 1;
+        last = before > last ? before : last;
+        if (seg_last > last) {
+            last = seg_last;
+        }
+    }
+    wal->next_lsn = last + 1;
+    wal->durable_lsn = last;
+    return 0;
+}
+
+// Called with the lock held by the writer: the flusher, or the appender in WAL_SYNC_EACH
+static int segment_ensure(Wal_t *wal, uint64_t first_lsn) {
+    char path[PATH_MAX];
+
+    if (wal->fd >= 0 && wal->seg_size < wal->cfg.segment_bytes) {
+        return 0;
+    }
+    segment_path(wal, first_lsn, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (wal->fd >= 0) {
+        if (wal->cfg.sync != WAL_SYNC_NONE) {
+            fdatasync(wal->fd);
+        }
+        close(wal->fd);
+    }
+    wal->fd = fd;
+    wal->seg_size = 0;
+    if (wal->cfg.sync != WAL_SYNC_NONE) {
+        fsync_dir(wal->dir);
+    }
+    // After a crash the first write may reopen the recovered last segment, emptied to its valid prefix
+    if (wal->n_segments > 0 && wal->segments[wal->n_segments - 1] == first_lsn) {
+        return 0;
+    }
+    return push_segment(wal, first_lsn);
+}
+
+// Write and sync go to the kernel together; with io_uring that is one system call
+static int write_batch(Wal_t *wal, const uint8_t *buf, size_t len) {
+    if (IoWriter_Write(wal->io, wal->fd, buf, len, wal->seg_size) != 0 ||
+        (wal->cfg.sync != WAL_SYNC_NONE && IoWriter_Sync(wal->io, wal->fd) != 0) || IoWriter_Drain(wal->io) != 0) {
+        return -1;
+    }
+    wal->seg_size += len;
+    return 0;
+}
+
+static void *flusher_thread(void *arg) {
+    Wal_t *wal = arg;
+
+    pthread_mutex_lock(&wal->lock);
+    for (;;) {
+        while (wal->active_len == 0 && !wal->closing) {
+            pthread_cond_wait(&wal->wake, &wal->lock);
+        }
+        if (wal->active_len == 0) {
+            break;
+        }
+        // Let the batch grow until its oldest record reaches the latency bound
+        uint64_t deadline = wal->pending_since_ns + (uint64_t)wal->cfg.max_delay_us * 1000u;
+        for (;;) {
+            uint64_t now = now_ns();
+            if (wal->closing || wal->active_len >= wal->cfg.max_batch_bytes || now >= deadline) {
+                break;
+            }
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            uint64_t t = (uint64_t)ts.tv_nsec + (deadline - now);
+            ts.tv_sec += (time_t)(t / 1000000000ull);
+            ts.tv_nsec = (long)(t % 1000000000ull);
+            pthread_cond_timedwait(&wal->wake, &wal->lock, &ts);
+        }
+
+        uint8_t *buf = wal->active;
+        size_t len = wal->active_len;
+        uint64_t first = wal->durable_lsn + 1;
+        uint64_t last = wal->next_lsn - 1;
+        uint64_t since = wal->pending_since_ns;
+        wal->active = wal->spare;
+        wal->spare = buf;
+        wal->active_len = 0;
+        pthread_cond_broadcast(&wal->space);
+        // Rotation edits the segment list, which Wal_Checkpoint also trims
+        int rc = segment_ensure(wal, first);
+        pthread_mutex_unlock(&wal->lock);
+
+        if (rc == 0) {
+            rc = write_batch(wal, buf, len);
+        }
+
+        pthread_mutex_lock(&wal->lock);
+        uint64_t delay = now_ns() - since;
+        if (rc != 0) {
+            wal->error = errno ? errno : EIO;
+        }
+        wal->durable_lsn = last;
+        wal->stats.batches++;
+        wal->stats.syncs += wal->cfg.sync != WAL_SYNC_NONE;
+        wal->stats.max_delay_ns = delay > wal->stats.max_delay_ns ? delay : wal->stats.max_delay_ns;
+        pthread_cond_broadcast(&wal->durable);
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return NULL;
+}
+
+Wal_t *Wal_Open(const char *dir, const WalConfig_t *cfg) {
+    Wal_t *wal = calloc(1, sizeof(*wal));
+
+    if (!wal) {
+        return NULL;
+    }
+    if (cfg) {
+        wal->cfg = *cfg;
+    } else {
+        Wal_DefaultConfig(&wal->cfg);
+    }
+    wal->fd = -1;
+    wal->dir = strdup(dir);
+    wal->cap = wal->cfg.max_batch_bytes * 2 > (1u << 20) ? wal->cfg.max_batch_bytes * 2 : (1u << 20);
+    wal->active = malloc(wal->cap);
+    wal->spare = malloc(wal->cap);
+    wal->io = IoWriter_Create(wal->cfg.io_backend, 8, wal->cap);
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->wake, NULL);
+    pthread_cond_init(&wal->durable, NULL);
+    pthread_cond_init(&wal->space, NULL);
+    if (!wal->dir || !wal->active || !wal->spare || !wal->io || (mkdir(dir, 0755) != 0 && errno != EEXIST) ||
+        load_checkpoint(wal) != 0 || recover(wal) != 0) {
+        Wal_Close(wal);
+        return NULL;
+    }
+    if (wal->cfg.sync != WAL_SYNC_EACH) {
+        if (pthread_create(&wal->flusher, NULL, flusher_thread, wal) != 0) {
+            Wal_Close(wal);
+            return NULL;
+        }
+        wal->flusher_running = true;
+    }
+    return wal;
+}
+
+void Wal_Close(Wal_t *wal) {
+    if (!wal) {
+        return;
+    }
+    if (wal->flusher_running) {
+        pthread_mutex_lock(&wal->lock);
+        wal->closing = true;
+        pthread_cond_signal(&wal->wake);
+        pthread_mutex_unlock(&wal->lock);
+        pthread_join(wal->flusher, NULL);
+    }
+    IoWriter_Destroy(wal->io);
+    if (wal->fd >= 0) {
+        fdatasync(wal->fd);
+        close(wal->fd);
+    }
+    pthread_mutex_destroy(&wal->lock);
+    pthread_cond_destroy(&wal->wake);
+    pthread_cond_destroy(&wal->durable);
+    pthread_cond_destroy(&wal->space);
+    free(wal->active);
+    free(wal->spare);
+    free(wal->segments);
+    free(wal->ckpt_blob);
+    free(wal->dir);
+    free(wal);
+}
+
+uint64_t Wal_Append(Wal_t *wal, const void *data, uint32_t len) {
+    size_t need = sizeof(WalRecordHeader_t) + len;
+    uint64_t lsn = 0;
+
+    if (len > WAL_MAX_RECORD) {
+        return 0;
+    }
+    pthread_mutex_lock(&wal->lock);
+    while (wal->active_len + need > wal->cap && !wal->error) {
+        pthread_cond_wait(&wal->space, &wal->lock);
+    }
+    if (!wal->error) {
+        WalRecordHeader_t hdr = {.len = len, .lsn = wal->next_lsn};
+        hdr.crc = record_crc(hdr.lsn, data, len);
+        memcpy(wal->active + wal->active_len, &hdr, sizeof(hdr));
+        memcpy(wal->active + wal->active_len + sizeof(hdr), data, len);
+        if (wal->active_len == 0) {
+            wal->pending_since_ns = now_ns();
+        }
+        wal->active_len += need;
+        lsn = wal->next_lsn++;
+        wal->stats.records++;
+        wal->stats.bytes += need;
+
+        if (wal->cfg.sync == WAL_SYNC_EACH) {
+            if (segment_ensure(wal, lsn) != 0 || write_batch(wal, wal->active, wal->active_len) != 0) {
+                wal->error = errno ? errno : EIO;
+                lsn = 0;
+            }
+            uint64_t delay = now_ns() - wal->pending_since_ns;
+            wal->active_len = 0;
+            wal->durable_lsn = wal->next_lsn - 1;
+            wal->stats.batches++;
+            wal->stats.syncs++;
+            wal->stats.max_delay_ns = delay > wal->stats.max_delay_ns ? delay : wal->stats.max_delay_ns;
+        } else if (wal->active_len == need || wal->active_len >= wal->cfg.max_batch_bytes) {
+            pthread_cond_signal(&wal->wake);
+        }
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+int Wal_WaitDurable(Wal_t *wal, uint64_t lsn) {
+    int rc;
+
+    pthread_mutex_lock(&wal->lock);
+    while (wal->durable_lsn < lsn && !wal->error) {
+        pthread_cond_wait(&wal->durable, &wal->lock);
+    }
+    rc = wal->error ? -1 : 0;
+    pthread_mutex_unlock(&wal->lock);
+    return rc;
+}
+
+uint64_t Wal_DurableLsn(Wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    uint64_t lsn = wal->durable_lsn;
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+uint64_t Wal_LastLsn(Wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    uint64_t lsn = wal->next_lsn - 1;
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+int Wal_Replay(Wal_t *wal, Wal_RecordFn fn, void *ctx) {
+    int rc = 0;
+
+    for (uint32_t i = 0; i < wal->n_segments && rc == 0; ++i) {
+        char path[PATH_MAX];
+        uint8_t *data;
+        size_t len;
+        uint64_t last = 0;
+
+        // Segments entirely before the checkpoint hold nothing to replay
+        if (i + 1 < wal->n_segments && wal->segments[i + 1] <= wal->ckpt_lsn + 1) {
+            continue;
+        }
+        segment_path(wal, wal->segments[i], path, sizeof(path));
+        if (read_file(path, &data, &len) != 0) {
+            return -1;
+        }
+        segment_walk(data, len, wal->ckpt_lsn, &last, fn, ctx, &rc);
+        free(data);
+    }
+    return rc;
+}
+
+int Wal_Checkpoint(Wal_t *wal, uint64_t lsn, const void *blob, size_t len) {
+    char path[PATH_MAX], tmp[PATH_MAX];
+    CheckpointHeader_t hdr = {.magic = CHECKPOINT_MAGIC, .blob_len = (uint32_t)len, .lsn = lsn};
+
+    hdr.crc = Crc32_Update(Crc32_Update(0, &hdr.lsn, sizeof(hdr.lsn)), blob, len);
+    snprintf(path, sizeof(path), "%s/checkpoint", wal->dir);
+    snprintf(tmp, sizeof(tmp), "%s/checkpoint.tmp", wal->dir);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (write_all(fd, &hdr, sizeof(hdr)) != 0 || write_all(fd, blob, len) != 0 || fsync(fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp, path) != 0) {
+        return -1;
+    }
+    fsync_dir(wal->dir);
+
+    uint8_t *copy = malloc(len ? len : 1);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, blob, len);
+
+    // Drop segments whose records all precede the checkpoint; keep the newest
+    pthread_mutex_lock(&wal->lock);
+    free(wal->ckpt_blob);
+    wal->ckpt_blob = copy;
+    wal->ckpt_len = len;
+    wal->ckpt_lsn = lsn;
+    uint32_t drop = 0;
+    while (drop + 1 < wal->n_segments && wal->segments[drop + 1] <= lsn + 1) {
+        segment_path(wal, wal->segments[drop], path, sizeof(path));
+        unlink(path);
+        drop++;
+    }
+    memmove(wal->segments, wal->segments + drop, (wal->n_segments - drop) * sizeof(uint64_t));
+    wal->n_segments -= drop;
+    pthread_mutex_unlock(&wal->lock);
+    return 0;
+}
+
+uint64_t Wal_CheckpointLsn(const Wal_t *wal) {
+    return wal->ckpt_lsn;
+}
+
+const void *Wal_CheckpointBlob(const Wal_t *wal, size_t *len) {
+    *len = wal->ckpt_len;
+    return wal->ckpt_len ? wal->ckpt_blob : NULL;
+}
+
+void Wal_GetStats(Wal_t *wal, WalStats_t *stats) {
+    pthread_mutex_lock(&wal->lock);
+    *stats = wal->stats;
+    pthread_mutex_unlock(&wal->lock);
+}
+
+void Wal_GetIoStats(Wal_t *wal, IoWriterStats_t *stats) {
+    // Only the writer touches the counters; a torn read is harmless for reporting
+    IoWriter_GetStats(wal->io, stats);
+}
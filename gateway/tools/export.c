@@ -0,0 +1,162 @@
+/*
+ * File: export.c
+ * Description: Exports raw series from a gateway data directory to CSV or
+ *              Parquet (export/export.h), to a file or stdout.
+ *
+ *              usage: export [-d data_dir] [-f csv|parquet] [-n node,...]
+ *                            [-F from_ms] [-T to_ms] [-j threads] [-o file]
+ *
+ *              The store is opened read-only, so the tool can run next to a
+ *              live gatewayd; it sees the chunks sealed so far. Samples still
+ *              in the WAL and in-memory heads of the running gateway are not
+ *              exported.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "export/export.h"
+
+static double mono_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Comma separated node ids; NULL on a malformed list
+static uint32_t *parse_nodes(const char *list, uint32_t *count) {
+    uint32_t cap = 1;
+    for (const char *p = list; *p; ++p) {
+        cap += *p == ',';
+    }
+    uint32_t *nodes = malloc(cap * sizeof(*nodes));
+    const char *p = list;
+
+    *count = 0;
+    while (nodes) {
+        char *end;
+        errno = 0;
+        unsigned long v = strtoul(p, &end, 0);
+        if (end == p || errno || v > UINT32_MAX || (*end != ',' && *end != '\0')) {
+            free(nodes);
+            return NULL;
+        }
+        nodes[(*count)++] = (uint32_t)v;
+        if (*end == '\0') {
+            break;
+        }
+        p = end + 1;
+    }
+    return nodes;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-d data_dir] [-f csv|parquet] [-n node,...] [-F from_ms] [-T to_ms] [-j threads] "
+            "[-o file]\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    const char *data_dir = "data", *out_path = NULL;
+    uint32_t *nodes = NULL;
+    ExportConfig_t cfg;
+    int opt, format;
+
+    Export_DefaultConfig(&cfg);
+    while ((opt = getopt(argc, argv, "d:f:n:F:T:j:o:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            data_dir = optarg;
+            break;
+        case 'f':
+            format = Export_FormatFromName(optarg);
+            if (format < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            cfg.format = (ExportFormat_t)format;
+            break;
+        case 'n':
+            free(nodes);
+            nodes = parse_nodes(optarg, &cfg.n_nodes);
+            if (!nodes) {
+                usage(argv[0]);
+                return 1;
+            }
+            cfg.nodes = nodes;
+            break;
+        case 'F':
+            cfg.from = strtoll(optarg, NULL, 10);
+            break;
+        case 'T':
+            cfg.to = strtoll(optarg, NULL, 10);
+            break;
+        case 'j':
+            cfg.threads = (uint32_t)atoi(optarg);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            free(nodes);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc || cfg.threads == 0 || cfg.from >= cfg.to) {
+        usage(argv[0]);
+        free(nodes);
+        return 1;
+    }
+
+    SeriesStoreConfig_t store_cfg;
+    SeriesStore_DefaultConfig(&store_cfg);
+    store_cfg.read_only = true;
+    SeriesStore_t *store = SeriesStore_Open(data_dir, &store_cfg);
+    if (!store) {
+        perror(data_dir);
+        free(nodes);
+        return 1;
+    }
+    int fd = out_path ? open(out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : STDOUT_FILENO;
+    if (fd < 0) {
+        perror(out_path);
+        SeriesStore_Close(store);
+        free(nodes);
+        return 1;
+    }
+
+    ExportStats_t stats;
+    double start = mono_s();
+    int rc = Export_Run(store, &cfg, fd, &stats);
+    double elapsed = mono_s() - start;
+    if (rc != 0) {
+        perror("export");
+    }
+    if (out_path && close(fd) != 0 && rc == 0) {
+        perror(out_path);
+        rc = -1;
+    }
+    if (rc == 0) {
+        fprintf(stderr, "%s: %llu rows, %llu samples, %llu chunks, %.1f MB in %.2f s (%.0f rows/s)\n",
+                Export_FormatName(cfg.format), (unsigned long long)stats.rows, (unsigned long long)stats.samples,
+                (unsigned long long)stats.chunks, (double)stats.bytes / 1e6, elapsed,
+                elapsed > 0.0 ? (double)stats.rows / elapsed : 0.0);
+    }
+    SeriesStore_Close(store);
+    free(nodes);
+    return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,396 @@
+/*
+ * File: loadgen.c
+ * Description: Drives a gateway with a synthetic fleet (sim/fleet.h) over the
+ *              UDP radio stand-in. Simulated time runs at a multiple of wall
+ *              time, or as fast as the socket allows. With -q, a probe node
+ *              reports a counter alongside the fleet and the tool polls the
+ *              query socket for it to measure frame-to-queryable latency.
+ *
+ *              usage: loadgen [-n nodes] [-i interval_ms] [-r rate | -m]
+ *                             [-d seconds | -f frames] [-p port] [-l loss]
+ *                             [-b burst] [-D dup] [-o reorder] [-B backlog]
+ *                             [-e] [-s seed] [-q query_socket] [-K keyfile]
+ *                             [-w capture_file]
+ *
+ *              -K writes the fleet keys for gatewayd -k and exits. -w writes
+ *              the frames to a capture (radio/capture.h) for tools/replay
+ *              instead of sending them, at maximum speed.
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "radio/capture.h"
+#include "radio/udp.h"
+#include "sim/fleet.h"
+
+#define PROBE_NODE 0xFFFF0001u
+#define PROBE_PERIOD_MS 100
+#define PROBE_TIMEOUT_MS 2000
+#define PROBE_MAX 100000
+
+typedef struct {
+    int sock;
+    struct sockaddr_in addr;
+    const char *query_socket;
+    atomic_bool stop;
+    uint64_t *latency_ns;
+    size_t count;
+    uint64_t timeouts;
+} Probe_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = {.tv_sec = (time_t)(ns / 1000000000ull), .tv_nsec = (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+}
+
+static int send_frame(int sock, const struct sockaddr_in *addr, const Frame_t *frame) {
+    uint8_t dgram[UDP_RADIO_DATAGRAM_MAX];
+    int len = UdpRadio_Pack(frame, dgram);
+
+    return sendto(sock, dgram, (size_t)len, 0, (const struct sockaddr *)addr, sizeof(*addr)) == len ? 0 : -1;
+}
+
+static int write_keys(const Fleet_t *fleet, const FleetConfig_t *cfg, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < cfg->nodes; ++i) {
+        uint8_t key[16];
+        Fleet_NodeKey(fleet, cfg->address_base + i, key);
+        fprintf(f, "%u ", cfg->address_base + i);
+        for (int k = 0; k < 16; ++k) {
+            fprintf(f, "%02x", key[k]);
+        }
+        fputc('\n', f);
+    }
+    return fclose(f);
+}
+
+static int query_connect(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Latest battery value of the probe node, or a negative value if none
+static float query_latest(int fd) {
+    char req[64], resp[256];
+    size_t len = 0;
+
+    int n = snprintf(req, sizeof(req), "LATEST %u battery\n", PROBE_NODE);
+    if (write(fd, req, (size_t)n) != n) {
+        return -2.0f;
+    }
+    // "OK <lines>\n" followed by "<ts> <value>\n" lines
+    for (;;) {
+        ssize_t r = read(fd, resp + len, sizeof(resp) - 1 - len);
+        if (r <= 0) {
+            return -2.0f;
+        }
+        len += (size_t)r;
+        resp[len] = '\0';
+        unsigned lines;
+        if (sscanf(resp, "OK %u", &lines) != 1) {
+            return -2.0f;
+        }
+        char *body = strchr(resp, '\n');
+        if (!body) {
+            continue;
+        }
+        if (lines == 0) {
+            return -1.0f;
+        }
+        long long ts;
+        float value;
+        if (strchr(body + 1, '\n') && sscanf(body + 1, "%lld %f", &ts, &value) == 2) {
+            return value;
+        }
+    }
+}
+
+static void *probe_thread(void *arg) {
+    Probe_t *probe = arg;
+    int fd = query_connect(probe->query_socket);
+    // Fresh sequence per run so the gateway does not drop probes as duplicates of an earlier run
+    uint16_t seq = (uint16_t)(mono_ns() >> 10);
+    uint32_t counter = 0;
+
+    if (fd < 0) {
+        perror(probe->query_socket);
+        return NULL;
+    }
+    while (!atomic_load(&probe->stop) && probe->count < PROBE_MAX) {
+        // Counter in the battery field: 1..30000 mV, well inside its range
+        counter = counter % 30000 + 1;
+        FrameReading_t reading = {FIELD_BATTERY, (float)counter * 0.001f};
+        FrameHeader_t hdr = {.type = FRAME_TYPE_TELEMETRY, .node = PROBE_NODE, .seq = seq++};
+        Frame_t frame = {.pipe = 1};
+        frame.len = (uint8_t)Frame_Encode(frame.payload, &hdr, &reading, 1);
+
+        uint64_t sent = mono_ns();
+        if (send_frame(probe->sock, &probe->addr, &frame) != 0) {
+            break;
+        }
+        bool seen = false;
+        while (mono_ns() - sent < PROBE_TIMEOUT_MS * 1000000ull) {
+            float v = query_latest(fd);
+            if (v < -1.5f) {
+                break;
+            }
+            if (v >= 0.0f && (uint32_t)(v * 1000.0f + 0.5f) == counter) {
+                probe->latency_ns[probe->count++] = mono_ns() - sent;
+                seen = true;
+                break;
+            }
+            sleep_ns(200000);
+        }
+        if (!seen) {
+            probe->timeouts++;
+        }
+        uint64_t spent = mono_ns() - sent;
+        if (spent < PROBE_PERIOD_MS * 1000000ull) {
+            sleep_ns(PROBE_PERIOD_MS * 1000000ull - spent);
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-n nodes] [-i interval_ms] [-r rate | -m] [-d seconds | -f frames] [-p port] [-l loss] "
+            "[-b burst] [-D dup] [-o reorder] [-B backlog] [-e] [-s seed] [-q query_socket] [-K keyfile] "
+            "[-w capture_file]\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    FleetConfig_t cfg;
+    double rate = 1.0, seconds = 10.0;
+    bool max_speed = false;
+    uint64_t max_frames = 0;
+    uint16_t port = 7524;
+    const char *query_socket = NULL, *keyfile = NULL, *capture_path = NULL;
+    int opt;
+
+    Fleet_DefaultConfig(&cfg);
+    while ((opt = getopt(argc, argv, "n:i:r:md:f:p:l:b:D:o:B:es:q:K:w:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            cfg.nodes = (uint32_t)atoi(optarg);
+            break;
+        case 'i':
+            cfg.interval_ms = (uint32_t)atoi(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'm':
+            max_speed = true;
+            break;
+        case 'd':
+            seconds = atof(optarg);
+            break;
+        case 'f':
+            max_frames = strtoull(optarg, NULL, 10);
+            break;
+        case 'p':
+            port = (uint16_t)atoi(optarg);
+            break;
+        case 'l':
+            cfg.loss = atof(optarg);
+            break;
+        case 'b':
+            cfg.burst_enter = atof(optarg);
+            break;
+        case 'D':
+            cfg.duplicate = atof(optarg);
+            break;
+        case 'o':
+            cfg.reorder = atof(optarg);
+            break;
+        case 'B':
+            cfg.backlog = atof(optarg);
+            break;
+        case 'e':
+            cfg.encrypt = true;
+            break;
+        case 's':
+            cfg.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'q':
+            query_socket = optarg;
+            break;
+        case 'K':
+            keyfile = optarg;
+            break;
+        case 'w':
+            capture_path = optarg;
+            max_speed = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (rate <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int64_t sim_start = wall_ms();
+    Fleet_t *fleet = Fleet_Create(&cfg, sim_start);
+    if (!fleet) {
+        fprintf(stderr, "invalid fleet configuration\n");
+        return 1;
+    }
+    if (keyfile) {
+        int rc = write_keys(fleet, &cfg, keyfile);
+        if (rc != 0) {
+            perror(keyfile);
+        }
+        Fleet_Destroy(fleet);
+        return rc == 0 ? 0 : 1;
+    }
+
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    CaptureWriter_t *capture = NULL;
+    if (capture_path && !(capture = CaptureWriter_Open(capture_path))) {
+        perror(capture_path);
+        Fleet_Destroy(fleet);
+        return 1;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (sock < 0) {
+        perror("socket");
+        CaptureWriter_Close(capture);
+        Fleet_Destroy(fleet);
+        return 1;
+    }
+
+    Probe_t probe = {.sock = sock, .addr = addr, .query_socket = query_socket};
+    pthread_t probe_tid;
+    bool probing = false;
+    if (query_socket) {
+        probe.latency_ns = malloc(PROBE_MAX * sizeof(*probe.latency_ns));
+        probing = probe.latency_ns && pthread_create(&probe_tid, NULL, probe_thread, &probe) == 0;
+    }
+
+    uint64_t start = mono_ns(), end = start + (uint64_t)(seconds * 1e9);
+    uint64_t next_report = start + 1000000000ull;
+    uint64_t sent = 0, errors = 0, last_sent = 0;
+    while (running) {
+        Frame_t frame;
+        Fleet_Next(fleet, &frame);
+        if (!max_speed) {
+            uint64_t due = start + (uint64_t)((double)(frame.rx_ts - sim_start) * 1e6 / rate);
+            uint64_t now = mono_ns();
+            if (due > now) {
+                sleep_ns(due - now);
+            }
+        }
+        if (capture ? CaptureWriter_Append(capture, &frame) == 0 : send_frame(sock, &addr, &frame) == 0) {
+            sent++;
+        } else if (errno != EINTR) {
+            errors++;
+        }
+        uint64_t now = mono_ns();
+        if (now >= next_report) {
+            fprintf(stderr, "%.0fs %llu frames/s\n", (double)(now - start) / 1e9,
+                    (unsigned long long)(sent - last_sent));
+            last_sent = sent;
+            next_report += 1000000000ull;
+        }
+        if (max_frames ? sent >= max_frames : now >= end) {
+            break;
+        }
+    }
+    double elapsed = (double)(mono_ns() - start) / 1e9;
+
+    FleetStats_t stats;
+    Fleet_GetStats(fleet, &stats);
+    printf("sent %llu frames in %.2fs (%.0f/s), %llu send errors\n", (unsigned long long)sent, elapsed,
+           (double)sent / elapsed, (unsigned long long)errors);
+    printf("fleet: %u nodes, lost %llu, duplicated %llu, reordered %llu, backlogs %llu\n", cfg.nodes,
+           (unsigned long long)stats.lost, (unsigned long long)stats.duplicates, (unsigned long long)stats.reordered,
+           (unsigned long long)stats.backlogs);
+
+    if (probing) {
+        atomic_store(&probe.stop, true);
+        pthread_join(probe_tid, NULL);
+        if (probe.count > 0) {
+            qsort(probe.latency_ns, probe.count, sizeof(*probe.latency_ns), cmp_u64);
+            printf("latency: %zu probes, p50 %.2fms p99 %.2fms max %.2fms, %llu timeouts\n", probe.count,
+                   (double)probe.latency_ns[probe.count / 2] / 1e6,
+                   (double)probe.latency_ns[(size_t)((double)(probe.count - 1) * 0.99)] / 1e6,
+                   (double)probe.latency_ns[probe.count - 1] / 1e6, (unsigned long long)probe.timeouts);
+        } else {
+            printf("latency: no probes answered, %llu timeouts\n", (unsigned long long)probe.timeouts);
+        }
+    }
+    free(probe.latency_ns);
+    if (capture && CaptureWriter_Close(capture) != 0) {
+        perror(capture_path);
+    }
+    close(sock);
+    Fleet_Destroy(fleet);
+    return 0;
+}
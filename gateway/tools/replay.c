@@ -0,0 +1,210 @@
+/*
+ * File: replay.c
+ * Description: Replays a capture (radio/capture.h) through the pipeline at
+ *              its recorded pace, N times faster, or as fast as possible.
+ *
+ *              With -d the frames go through an in-process ingest (WAL, dedup,
+ *              decryption, store, rollup) under data_dir, keeping their
+ *              recorded receive times so runs are repeatable; rollups tick on
+ *              capture time. With -p they are sent to a running gatewayd over
+ *              the UDP radio stand-in instead, which stamps its own time.
+ *
+ *              usage: replay [-x speed | -m] [-d data_dir | -p port]
+ *                            [-k keyfile] [-s none|group|each] capture
+ *
+ * Author: Mateusz Kozlowski
+ * Date: 18-10-2026
+ * License: MIT
+ *
+ * Revision History:
+ *   - <18-10-2026>: Created initial version.
+ *
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pipeline/ingest.h"
+#include "radio/capture.h"
+#include "radio/udp.h"
+
+#define LATENCY_SAMPLES (1u << 20)
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-x speed | -m] [-d data_dir | -p port] [-k keyfile] [-s none|group|each] capture\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    double speed = 1.0;
+    bool max_speed = false;
+    const char *data_dir = NULL, *keyfile = NULL;
+    int port = -1;
+    IngestConfig_t cfg;
+    int opt;
+
+    Ingest_DefaultConfig(&cfg);
+    while ((opt = getopt(argc, argv, "x:md:p:k:s:h")) != -1) {
+        switch (opt) {
+        case 'x':
+            speed = atof(optarg);
+            break;
+        case 'm':
+            max_speed = true;
+            break;
+        case 'd':
+            data_dir = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'k':
+            keyfile = optarg;
+            break;
+        case 's':
+            if (strcmp(optarg, "none") == 0) {
+                cfg.wal.sync = WAL_SYNC_NONE;
+            } else if (strcmp(optarg, "each") == 0) {
+                cfg.wal.sync = WAL_SYNC_EACH;
+            } else {
+                cfg.wal.sync = WAL_SYNC_GROUP;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || speed <= 0.0 || (!data_dir) == (port < 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[optind];
+
+    CaptureReader_t *reader = CaptureReader_Open(path);
+    if (!reader) {
+        perror(path);
+        return 1;
+    }
+
+    Ingest_t *ingest = NULL;
+    int sock = -1;
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons((uint16_t)port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (data_dir) {
+        ingest = Ingest_Open(data_dir, &cfg);
+        if (!ingest || (keyfile && Ingest_LoadKeys(ingest, keyfile) < 0)) {
+            perror(ingest ? keyfile : data_dir);
+            Ingest_Close(ingest);
+            CaptureReader_Close(reader);
+            return 1;
+        }
+    } else if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        perror("socket");
+        CaptureReader_Close(reader);
+        return 1;
+    }
+
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    uint64_t *latency = ingest ? malloc(LATENCY_SAMPLES * sizeof(*latency)) : NULL;
+    uint64_t start = mono_ns(), frames = 0, errors = 0, max_lag_ns = 0;
+    int64_t first_ts = 0, next_tick = 0;
+    Frame_t frame;
+    int rc = 0;
+    while (running && (rc = CaptureReader_Next(reader, &frame)) > 0) {
+        if (frames == 0) {
+            first_ts = frame.rx_ts;
+            next_tick = first_ts + 1000;
+        }
+        if (!max_speed && frame.rx_ts > first_ts) {
+            uint64_t due = start + (uint64_t)((double)(frame.rx_ts - first_ts) * 1e6 / speed);
+            uint64_t now = mono_ns();
+            if (due > now) {
+                struct timespec ts = {.tv_sec = (time_t)((due - now) / 1000000000ull),
+                                      .tv_nsec = (long)((due - now) % 1000000000ull)};
+                nanosleep(&ts, NULL);
+            } else if (now - due > max_lag_ns) {
+                max_lag_ns = now - due;
+            }
+        }
+
+        if (ingest) {
+            if (frame.rx_ts >= next_tick) {
+                Ingest_Tick(ingest, frame.rx_ts);
+                next_tick = frame.rx_ts + 1000;
+            }
+            uint64_t t0 = mono_ns();
+            if (Ingest_Frame(ingest, &frame) != 0) {
+                errors++;
+            }
+            if (latency && frames < LATENCY_SAMPLES) {
+                latency[frames] = mono_ns() - t0;
+            }
+        } else {
+            uint8_t dgram[UDP_RADIO_DATAGRAM_MAX];
+            int len = UdpRadio_Pack(&frame, dgram);
+            if (sendto(sock, dgram, (size_t)len, 0, (struct sockaddr *)&addr, sizeof(addr)) != len) {
+                errors++;
+            }
+        }
+        frames++;
+    }
+    double elapsed = (double)(mono_ns() - start) / 1e9;
+    if (rc < 0) {
+        perror(path);
+    }
+
+    CaptureStats_t cs;
+    CaptureReader_GetStats(reader, &cs);
+    printf("replayed %llu frames (%.1f MB capture) in %.2fs: %.0f frames/s, %llu errors\n", (unsigned long long)frames,
+           (double)cs.bytes / 1e6, elapsed, (double)frames / elapsed, (unsigned long long)errors);
+    if (!max_speed) {
+        printf("pacing: max lag behind schedule %.2fms\n", (double)max_lag_ns / 1e6);
+    }
+    if (ingest) {
+        size_t n = frames < LATENCY_SAMPLES ? (size_t)frames : LATENCY_SAMPLES;
+        if (latency && n > 0) {
+            qsort(latency, n, sizeof(*latency), cmp_u64);
+            printf("ingest: p50 %.2fus p99 %.2fus max %.2fus per frame\n", (double)latency[n / 2] / 1e3,
+                   (double)latency[(size_t)((double)(n - 1) * 0.99)] / 1e3, (double)latency[n - 1] / 1e3);
+        }
+        IngestStats_t st;
+        Ingest_GetStats(ingest, &st);
+        printf("ingest: %llu frames, %llu samples, %llu duplicates, %llu late, %llu malformed, %llu auth failures\n",
+               (unsigned long long)st.frames, (unsigned long long)st.samples, (unsigned long long)st.duplicates,
+               (unsigned long long)st.late, (unsigned long long)st.malformed, (unsigned long long)st.auth_failures);
+        Ingest_Close(ingest);
+    } else {
+        close(sock);
+    }
+    free(latency);
+    CaptureReader_Close(reader);
+    return rc < 0 ? 1 : 0;
+}